@@ -11,12 +11,18 @@
 #'
 #' There are specializations for dense and sparse input matrices, symmetric input matrices, and for rank-1 and rank-2 projections. See documentation for \code{\link{nmf}} for theoretical details and guidance.
 #'
+#' \code{data} may also be the path to a sparse matrix stream written by \code{\link{write_stream}}, which is projected one chunk at a time without loading it into memory. Masking is not supported for streams.
+#'
+#' \code{data} may also be a list of sparse matrices with the same rows, giving consecutive blocks of columns, which are projected one block at a time in place without combining them into one matrix. Masking is not supported for lists of blocks.
+#'
+#' With \code{sink}, \code{h} is not returned but passed to \code{sink} one chunk of \code{chunk_size} columns (default \code{10000}) at a time, so that projections onto many samples never hold more than two chunks of \code{h} in memory. Each chunk is solved on a separate thread while the previous chunk is written to \code{sink}. \code{sink} may be the path of a file, to which \code{h} is written as single-precision values in column-major order (as by \code{\link{write_distance}}), or with \code{sparse = TRUE}, \code{top_k} or \code{threshold}, as a sparse matrix stream (see \code{\link{write_stream}}); a function, called as \code{sink(h, start)} with each chunk of \code{h} and the index of its first column in \code{data}; or a binary connection, to which \code{h} is written as by a path. \code{sink} is returned invisibly. Sinks are not supported with masking other than \code{mask = "zeros"}, or for streams and lists of blocks.
+#'
 #' @importFrom stats predict
 #' @inheritParams nmf
 #' @param object fitted model, class \code{nmf}, generally the result of calling \code{nmf}, with models of equal dimensions as \code{data}
 #' @param L1 a single LASSO penalty in the range (0, 1]
 #' @param L2 a single Ridge penalty greater than zero
-#' @param ... arguments passed to or from other methods
+#' @param ... arguments passed to or from other methods. Specify \code{precision = "float"} to solve in single precision, \code{sparse = TRUE} to return \code{h} as a \code{dgCMatrix} without a dense intermediate, \code{top_k} to keep only the \code{top_k} largest values in each column of a sparse \code{h}, \code{threshold} to keep only values greater than \code{threshold}, \code{solver} to select the least squares solver (see \code{\link{nmf}}), \code{sink} and \code{chunk_size} to write \code{h} by chunks of columns rather than return it, \code{h_precision = "bfloat16"} or \code{"float16"} to return \code{h} as a \code{\link{halfMatrix}} in half precision, encoded from each chunk of \code{chunk_size} columns as it is solved, so that \code{h} is never held in double precision (not supported with masking other than \code{mask = "zeros"}, sparse \code{h}, streams, lists of blocks or sinks), \code{dedup = TRUE} to solve each group of identical samples of a sparse \code{data} once and expand \code{h} to all samples (see \code{\link{nmf}}; not supported with sinks or masking other than \code{mask = "zeros"}), \code{h_init} to begin each column of \code{h} from its solution in \code{h_init} rather than from zero, such as \code{h} of the same samples projected onto an earlier \code{w}, with \code{skip_tol} to keep columns of \code{h_init} that already meet that coordinate descent tolerance without solving them (see \code{\link{project}}; not supported with streams, lists of blocks, sinks or \code{h_precision}), and \code{squared_error = TRUE} to return the squared reconstruction error of each sample, \eqn{||A_j - wh_j||^2}, in the \code{"squared_error"} attribute of \code{h}. The errors are found from the Gram matrix of \code{w} as each column of \code{h} is solved, without a second pass over \code{data}, and are not supported with masking, streams, lists of blocks or sinks.
 #' @param upper_bound maximum value permitted in least squares solutions, essentially a bounded-variable least squares problem between 0 and \code{upper_bound}
 #' @export
 #' @rdname nmf-class-methods
@@ -49,28 +55,74 @@ setMethod("predict", signature = "nmf", function(object, data, L1 = 0, L2 = 0, m
   validObject(object)
 
   if (is.null(upper_bound)) upper_bound <- 0
+  precision <- list(...)$precision
+  if (is.null(precision)) precision <- "double"
+  if (!(precision %in% c("double", "float"))) stop("'precision' must be either \"double\" or \"float\"")
+  sparse <- isTRUE(list(...)$sparse)
+  top_k <- list(...)$top_k
+  threshold <- list(...)$threshold
+  if (is.null(top_k)) top_k <- 0
+  if (is.null(threshold)) threshold <- 0
+  if (length(top_k) != 1 || top_k < 0 || top_k != round(top_k)) stop("'top_k' must be a single non-negative integer")
+  if (length(threshold) != 1 || threshold < 0) stop("'threshold' must be a single non-negative value")
+  if (top_k > 0 || threshold > 0) sparse <- TRUE
+  sink <- list(...)$sink
+  h_precision <- list(...)$h_precision
+  h_format <- if (is.null(h_precision)) 0L else half_format(h_precision)
+  squared_error <- isTRUE(list(...)$squared_error)
+  chunk_size <- list(...)$chunk_size
+  if (is.null(chunk_size)) chunk_size <- 10000
+  if (length(chunk_size) != 1 || chunk_size < 1) stop("'chunk_size' must be a single positive integer")
+  solver <- list(...)$solver
+  if (is.null(solver)) solver <- "auto"
+  if (!(solver %in% c("auto", "cd", "cd_greedy", "cd_random", "active_set"))) stop("'solver' must be one of \"auto\", \"cd\", \"cd_greedy\", \"cd_random\", or \"active_set\"")
+  h_init <- list(...)$h_init
+  skip_tol <- list(...)$skip_tol
+  if (is.null(skip_tol)) skip_tol <- 0
+  if (length(skip_tol) != 1 || skip_tol < 0) stop("'skip_tol' must be a single non-negative value")
   if (length(L1) != 1) stop("'L1' must be a single value giving the penalty on 'h'")
   if (L1 >= 1 || L1 < 0) stop("L1 penalty must be strictly in the range [0,1)")
   if (length(L2) != 1) stop("'L1' must be a single value giving the penalty on 'h'")
   if (L2 < 0) stop("L2 penalty must be strictly >= 0")
+  if (hashed_mask(mask)[2] > 0) stop("a hashed 'mask' is not supported by 'predict'")
 
-  if (is(data, "sparseMatrix")) {
-    if (class(data)[[1]] != "dgCMatrix") data <- as(data, "dgCMatrix")
-    if (any(is.na(data@x))) {
-      if (!is.null(mask) && mask != "NA") stop("data contains 'NA' values. Either remove these values or specify \"mask = 'NA'\"")
-      warning("NA values were detected in the data. Setting \"mask = 'NA'\"")
-      mask <- is.na(data)
-    }
+  prepared <- NULL
+  if (is(data, "prepared_matrix")) {
+    prepared <- data
+    data <- prepared@data
+  }
+  blocks <- is.list(data) && !is.data.frame(data)
+  if (is.character(data)) {
+    if (length(data) != 1 || !file.exists(data)) stop("'data' was a character string but not a path to a sparse matrix stream written by 'write_stream'")
+    if (!is.null(mask)) stop("'mask' is not supported when streaming 'data' from disk")
+  } else if (blocks) {
+    if (!is.null(mask)) stop("'mask' is not supported when 'data' is a list of blocks")
+    data <- sparse_blocks(data)
+  } else if (is(data, "sparseMatrix")) {
+    # pattern matrices and matrices compressed by rows are read in C++ without coercion (see "Rcpp_predict_sparse")
+    if (!(class(data)[[1]] %in% sparse_classes)) data <- as(data, "dgCMatrix")
   } else if (canCoerce(data, "matrix")) {
     data <- as.matrix(data)
-    if (!is.numeric(data)) data <- as.numeric(data)
-    if (any(is.na(data))) {
+    if (!is.double(data)) storage.mode(data) <- "double"
+  } else {
+    stop("'data' was not coercible to a matrix")
+  }
+  # "data" of the original features of a model of hashed features is hashed in the same way (see "nmf"). "data" is of the
+  #   original features if it has their number of rows, even if that is also the number of buckets, or for models that
+  #   do not record it, if it does not have a row for each bucket.
+  hash <- object@misc$hash
+  if (!is.null(hash) && !is.character(data) && !blocks && (if (is.null(hash$features)) nrow(data) != hash$buckets else nrow(data) == hash$features)) {
+    if (!is.null(mask)) stop("'mask' is not supported when 'data' is hashed into the features of the model")
+    data <- hash_features(if (is.matrix(data)) as(data, "CsparseMatrix") else data, hash$buckets, hash$signed, hash$seed)
+    prepared <- NULL
+  }
+  if (!is.character(data) && !blocks) {
+    scan <- scan_input(data, prepared)
+    if (scan$n_na > 0) {
       if (!is.null(mask) && mask != "NA") stop("data contains 'NA' values. Either remove these values or specify \"mask = 'NA'\"")
       warning("NA values were detected in the data. Setting \"mask = 'NA'\"")
-      mask <- is.na(as(data, "dgCMatrix"))
+      mask <- scan$mask
     }
-  } else {
-    stop("'data' was not coercible to a matrix")
   }
 
   if (is.null(mask)) {
@@ -91,23 +143,142 @@ setMethod("predict", signature = "nmf", function(object, data, L1 = 0, L2 = 0, m
     mask_matrix <- as(mask, "dgCMatrix")
   }
 
-  if (nrow(object@w) == nrow(data) && ncol(object@w) != nrow(data)) {
-    w <- t(object@w)
-  } else if (ncol(object@w) == nrow(data)) {
-    w <- object@w
+  n_features <- if (is.character(data)) Rcpp_stream_dim(data)[[1]] else if (blocks) nrow(data[[1]]) else nrow(data)
+  if (nrow(object@w) == n_features && ncol(object@w) != n_features) {
+    w <- t(as.matrix(object@w))
+  } else if (ncol(object@w) == n_features) {
+    w <- as.matrix(object@w)
+  }
+  if (ncol(w) != n_features) stop("dimensions of 'object@w' and 'A' are not compatible")
+  if (!is.null(h_init)) {
+    if (is.character(data) || blocks || !is.null(sink) || h_format > 0) stop("'h_init' is not supported with streams, lists of blocks, sinks or 'h_precision'")
+    h_init <- as.matrix(h_init)
+    if (!is.double(h_init)) storage.mode(h_init) <- "double"
+    if (nrow(h_init) != nrow(w) || ncol(h_init) != ncol(data)) stop("'h_init' must have as many rows as factors in 'object@w' and as many columns as 'data'")
+    if (any(is.na(h_init))) stop("'h_init' must not contain 'NA' values")
+  } else {
+    h_init <- matrix(0, 0, 0)
   }
-  if (ncol(w) != nrow(data)) stop("dimensions of 'object@w' and 'A' are not compatible")
 
-  if (class(data)[[1]] == "dgCMatrix") {
-    h <- Rcpp_predict_sparse(data, mask_matrix, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound)
+  # solve each group of identical samples once, and expand "h" to all samples (see "Rcpp_column_groups")
+  if (isTRUE(list(...)$dedup)) {
+    if (!(class(data)[[1]] %in% c("dgCMatrix", "ngCMatrix")) || (!is.null(mask) && !mask_zeros) || !is.null(sink))
+      stop("'dedup' is only supported for sparse 'data' in memory, without sinks or masking other than \"mask = 'zeros'\"")
+    groups <- Rcpp_column_groups(data, getOption("RcppML.threads"))
+    if (length(groups$unique) < ncol(data)) {
+      args <- list(...)
+      args$dedup <- NULL
+      if (length(h_init) > 0) args$h_init <- h_init[, groups$unique, drop = FALSE]
+      h <- do.call(predict, c(list(object, data[, groups$unique, drop = FALSE], L1 = L1, L2 = L2, mask = mask, upper_bound = upper_bound), args))
+      errors <- attr(h, "squared_error")
+      h <- h[, groups$group, drop = FALSE]
+      colnames(h) <- colnames(data)
+      if (!is.null(errors)) {
+        errors <- errors[groups$group]
+        names(errors) <- colnames(h)
+        attr(h, "squared_error") <- errors
+      }
+      return(h)
+    }
+  }
+
+  if (squared_error && (!is.null(mask) || !is.null(sink) || is.character(data) || blocks)) stop("'squared_error' is not supported with masking, sinks, streams or lists of blocks")
+  if (h_format > 0) {
+    if ((!is.null(mask) && !mask_zeros) || sparse || !is.null(sink) || squared_error || is.character(data) || blocks)
+      stop("'h_precision' is not supported with masking other than \"mask = 'zeros'\", sparse 'h', sinks, 'squared_error', streams or lists of blocks")
+    # chunks of "h" are encoded as they are solved (see "factorSink")
+    if (is(data, "sparseMatrix")) {
+      h <- Rcpp_predict_half_sparse(data, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", solver, chunk_size, h_format)
+    } else {
+      h <- Rcpp_predict_half_dense(data, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", solver, chunk_size, h_format)
+    }
+    dimnames(h) <- list(paste0("nmf", 1:nrow(h)), colnames(data))
+    return(h)
+  }
+  if ((top_k > 0 || threshold > 0) && (is.character(data) || blocks)) stop("'top_k' and 'threshold' are not supported for streams or lists of blocks")
+  if (!is.null(sink)) {
+    if (is.character(data) || blocks) stop("'sink' is not supported for streams or lists of blocks")
+    if (!is.null(mask) && !mask_zeros) stop("'sink' is not supported with masking other than \"mask = 'zeros'\"")
+    # chunks are named and passed to R functions and connections as they are written (see "factorSink")
+    sink_ <- sink
+    if (is.character(sink)) {
+      if (length(sink) != 1) stop("'sink' must be a single path")
+      sink_ <- path.expand(sink)
+    } else if (is(sink, "connection")) {
+      if (sparse) stop("sparse 'h' may be written to a path or a function, but not to a connection")
+      sink_ <- function(h, start) writeBin(as.vector(h), sink, size = 4)
+    } else if (is.function(sink)) {
+      col_names <- colnames(data)
+      sink_ <- function(h, start) {
+        rownames(h) <- paste0("nmf", 1:nrow(h))
+        if (!is.null(col_names)) colnames(h) <- col_names[start:(start + ncol(h) - 1)]
+        sink(h, start)
+      }
+    } else {
+      stop("'sink' must be a path, a function, or a connection")
+    }
+    if (is(data, "sparseMatrix")) {
+      Rcpp_predict_sink_sparse(data, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", sparse, solver, top_k, threshold, chunk_size, sink_)
+    } else {
+      Rcpp_predict_sink_dense(data, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", sparse, solver, top_k, threshold, chunk_size, sink_)
+    }
+    return(invisible(sink))
+  }
+  if (is.character(data)) {
+    h <- Rcpp_predict_stream(data, w, L1[1], L2[1], getOption("RcppML.threads"), upper_bound, precision == "float", sparse, solver)
+  } else if (blocks) {
+    h <- Rcpp_predict_list(data, w, L1[1], L2[1], getOption("RcppML.threads"), upper_bound, precision == "float", sparse, solver)
+  } else if (is(data, "sparseMatrix")) {
+    h <- Rcpp_predict_sparse(data, mask_matrix, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", sparse, solver, top_k, threshold, squared_error, h_init, skip_tol)
   } else {
-    h <- Rcpp_predict_dense(data, mask_matrix, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound)
+    h <- Rcpp_predict_dense(data, mask_matrix, w, L1[1], L2[1], getOption("RcppML.threads"), mask_zeros, upper_bound, precision == "float", sparse, solver, top_k, threshold, squared_error, h_init, skip_tol)
   }
-  if (!is.null(colnames(data))) colnames(h) <- colnames(data)
+  errors <- NULL
+  if (squared_error) {
+    errors <- h$squared_error
+    h <- h$h
+  }
+  col_names <- if (blocks) unlist(lapply(data, colnames)) else colnames(data)
+  if (length(col_names) == ncol(h)) colnames(h) <- col_names
   rownames(h) <- paste0("nmf", 1:nrow(h))
+  if (squared_error) {
+    names(errors) <- colnames(h)
+    attr(h, "squared_error") <- errors
+  }
   h
 })
 
+#' Update an NMF model with new samples
+#'
+#' Update \code{w} of a fitted NMF model with new samples, such as new cells appended to an atlas, without refitting the samples it was fit to.
+#'
+#' @details
+#' An update needs the sufficient statistics \eqn{hh^T}, \eqn{hA^T} and the row sums of \eqn{h} of the samples the model was fit to, which are returned in \code{@misc$online_stats} by \code{\link{nmf}} with \code{keep_stats = TRUE} or \code{batch_size}. Each iteration projects \code{w} onto \code{data} to solve \code{h} for the new samples, and solves \code{w} from the statistics of the previous samples, weighted by \code{decay}, plus those of the new samples. The cost of an update thus depends only on the new samples, and a few iterations usually suffice.
+#'
+#' The returned model has \code{h} of only the new samples, and its \code{@misc$online_stats} include them, so that it can be updated again. \code{h} of previous samples may be found for the updated \code{w} with \code{predict}. Masking and linking are not supported.
+#'
+#' @param object fitted model, class \code{nmf}, with sufficient statistics in \code{@misc$online_stats}
+#' @param data dense or sparse matrix of new samples, with the same features in rows as \code{object@w}
+#' @param maxit maximum number of updates of \code{w}
+#' @param decay weight of the statistics of previous samples, in the range [0, 1]
+#' @param ... arguments passed to \code{\link{nmf}}, such as \code{tol}, \code{L1} and \code{L2}
+#' @importFrom stats update
+#' @export
+#' @returns object of class \code{\link{nmf}}
+#' @seealso \code{\link{nmf}}, \code{\link{predict}}
+#' @examples \dontrun{
+#' A <- r_sparsematrix(1000, 2000, 10)
+#' model <- nmf(A[, 1:1500], 10, keep_stats = TRUE)
+#' model <- update(model, A[, 1501:2000])
+#' }
+setMethod("update", signature = "nmf", function(object, data, maxit = 5, decay = 1, ...) {
+  validObject(object)
+  stats <- object@misc$online_stats
+  if (length(stats) != 3) stop("'object' has no sufficient statistics in '@misc$online_stats', fit it with 'keep_stats = TRUE'")
+  if (nrow(data) != nrow(object@w)) stop("'data' must have the same number of rows as 'object@w'")
+  nmf(data, ncol(object@w), maxit = maxit, seed = as.matrix(object@w), online_stats = stats, decay = decay, ...)
+})
+
 #' Project a model onto new data
 #'
 #' Equivalent to \code{predict} method for NMF, but requires only the \code{w} matrix to be supplied and not the entire NMF model. Use NNLS to project a basis factor model onto new samples.
@@ -115,8 +286,12 @@ setMethod("predict", signature = "nmf", function(object, data, L1 = 0, L2 = 0, m
 #' @details
 #' See \code{\link{nmf}} for more info, as well as the \code{predict} method for NMF.
 #'
+#' \code{w} may also be a list of matrices or \code{nmf} models with the same features, such as models of different ranks. All models are then projected in one pass over \code{data}: their \code{w} are stacked into one matrix, so each non-zero of \code{data} is read once to compute the right-hand sides of every model, and each model's systems are then solved with its own \eqn{w^Tw}. A list of \code{h}, one for each model, is returned. Masking is not supported.
+#'
+#' When the same samples are projected again onto a slightly different \code{w}, such as a model updated every week, \code{h_init = h} of the last projection starts coordinate descent from each previous solution rather than from zero, so that most columns converge in one sweep. With \code{skip_tol}, columns whose previous solution is already within that tolerance are kept without any sweep: the relative change of each coordinate given by its projected gradient \eqn{(b - ax)_i / a_{ii}} at the previous solution is averaged over the coordinates, as in the stopping criterion of coordinate descent, and compared to \code{skip_tol}. \code{h_init} and \code{skip_tol} are accepted for a matrix \code{w} (see \code{predict}) and for a \code{\link{projector}}, but not for a list of models.
+#'
 #' @rdname project
-#' @param w matrix of features (rows) by factors (columns), corresponding to rows in \code{data}
+#' @param w matrix of features (rows) by factors (columns), corresponding to rows in \code{data}, or a list of such matrices or \code{nmf} models
 #' @param data a dense or sparse matrix
 #' @param L1 L1/LASSO penalty
 #' @param L2 L2/Ridge penalty
@@ -124,7 +299,173 @@ setMethod("predict", signature = "nmf", function(object, data, L1 = 0, L2 = 0, m
 #' @param mask masking on data values
 #' @param ... arguments passed to \code{predict.nmf}
 #' @export
+#' @seealso \code{\link{projector}}
 project <- function(w, data, L1 = 0, L2 = 0, mask = NULL, upper_bound = 0, ...) {
+  if (is.list(w) && !is.data.frame(w) && !inherits(w, "projector")) {
+    # several models projected in one pass over "data" (see "Rcpp_project_stacked_sparse")
+    if (!is.null(mask)) stop("masking is not supported when projecting several models")
+    if (!is.null(list(...)$h_init)) stop("'h_init' is not supported when projecting several models")
+    solver <- list(...)$solver
+    if (is.null(solver)) solver <- "auto"
+    w_t <- lapply(w, function(w_m) {
+      if (is(w_m, "nmf")) w_m <- w_m@w
+      w_m <- as.matrix(w_m)
+      if (!is.numeric(w_m) || any(is.na(w_m))) stop("each model in 'w' must be a numeric matrix without 'NA' values")
+      storage.mode(w_m) <- "double"
+      t(w_m)
+    })
+    if (is(data, "sparseMatrix")) {
+      if (!(class(data)[[1]] %in% c("dgCMatrix", "dgRMatrix"))) data <- as(data, "dgCMatrix")
+      h <- Rcpp_project_stacked_sparse(w_t, data, L1, L2, upper_bound, solver, getOption("RcppML.threads"))
+    } else {
+      data <- as.matrix(data)
+      if (!is.double(data)) storage.mode(data) <- "double"
+      h <- Rcpp_project_stacked_dense(w_t, data, L1, L2, upper_bound, solver, getOption("RcppML.threads"))
+    }
+    for (m in seq_along(h)) dimnames(h[[m]]) <- list(paste0("nmf", 1:nrow(h[[m]])), colnames(data))
+    names(h) <- names(w)
+    return(h)
+  }
+  if (inherits(w, "projector")) {
+    if (!is.null(mask)) stop("projectors do not support masking, use 'project' with a matrix 'w'")
+    if (L1 != 0 || L2 != 0 || upper_bound != 0) stop("'L1', 'L2', and 'upper_bound' of a projector are set when it is created")
+    h_init <- list(...)$h_init
+    h_init <- if (is.null(h_init)) matrix(0, 0, 0) else as.matrix(h_init)
+    if (!is.double(h_init)) storage.mode(h_init) <- "double"
+    skip_tol <- list(...)$skip_tol
+    if (is.null(skip_tol)) skip_tol <- 0
+    if (length(skip_tol) != 1 || skip_tol < 0) stop("'skip_tol' must be a single non-negative value")
+    if (is(data, "sparseMatrix")) {
+      if (class(data)[[1]] != "dgCMatrix") data <- as(data, "dgCMatrix")
+      h <- Rcpp_project_sparse(w$ptr, data, getOption("RcppML.threads"), h_init, skip_tol)
+    } else {
+      if (!is.matrix(data)) data <- as.matrix(data)
+      if (!is.double(data)) storage.mode(data) <- "double"
+      h <- Rcpp_project_dense(w$ptr, data, getOption("RcppML.threads"), h_init, skip_tol)
+    }
+    if (!is.null(colnames(data))) colnames(h) <- colnames(data)
+    rownames(h) <- w$factors
+    return(h)
+  }
   m <- new("nmf", w = w, d = rep(1:ncol(w)), h = matrix(0, nrow = ncol(w), 1))
   predict(m, data, L1 = L1, L2 = L2, mask = mask, upper_bound, ...)
 }
+
+#' Prepare a model for repeated projections
+#'
+#' Prepare \code{w} once for many projections onto small batches of new samples with \code{\link{project}}.
+#'
+#' @details
+#' \code{project(w, data)} validates and copies \code{w}, and computes and factorizes \eqn{w^Tw}, on every call. A projector holds \code{w}, \eqn{w^Tw} and its Cholesky factorization in C++ memory, so that \code{project(projector, data)} only computes \eqn{b = wA_j} and solves the NNLS system for each sample \eqn{j} in \code{data}. This makes projections of one or a few samples at a time much faster.
+#'
+#' For serving, \code{storage = "int8"} or \code{"float16"} stores each factor of \code{w} as 8-bit integers or half-precision values scaled by its largest absolute value, in 1/8 or 1/4 the memory of \code{w}. Gathering \code{w} for \eqn{b} is the memory-bound part of a projection, and each scale is applied once to \eqn{b} rather than to each value gathered. \eqn{w^Tw} is computed in double precision from the dequantized \code{w}. The relative error of the stored \code{w} against \code{w}, \eqn{||w - \hat{w}||_F / ||w||_F}, is returned in \code{$error}, and its size in bytes in \code{$bytes}.
+#'
+#' Projectors do not support masking. A projector is only valid in the R session in which it was created, and cannot be saved and reloaded (e.g. with \code{saveRDS}). To serve a model from disk, write it with \code{\link{write_nmf}} and pass the path of the file as \code{w}. With \code{storage = "double"}, \code{w} is then read in place from the memory-mapped file and \eqn{w^Tw} is read from the file rather than computed, so the projector is ready without copying or parsing the model, and R sessions serving the same file share one copy of it in the page cache. \code{$mapped} is \code{TRUE} if \code{w} is read in place.
+#'
+#' @inheritParams project
+#' @param w matrix of features (rows) by factors (columns), an \code{nmf} model, or the path of a model file written by \code{\link{write_nmf}}
+#' @param solver least squares solver, one of \code{"auto"}, \code{"cd"}, \code{"cd_greedy"}, \code{"cd_random"}, or \code{"active_set"} (see \code{\link{nmf}})
+#' @param storage storage of \code{w}, one of \code{"double"}, \code{"int8"}, or \code{"float16"}
+#' @returns object of class \code{projector}, to be passed as \code{w} to \code{\link{project}}
+#' @export
+#' @seealso \code{\link{project}}, \code{\link{write_nmf}}
+#' @examples \dontrun{
+#' w <- matrix(runif(1000 * 10), 1000, 10)
+#' p <- projector(w)
+#' A <- r_sparsematrix(1000, 100, 10)
+#' all.equal(project(p, A), project(w, A))
+#' h_1 <- project(p, A[, 1])
+#' p_int8 <- projector(w, storage = "int8")
+#' p_int8$error
+#' }
+projector <- function(w, L1 = 0, L2 = 0, upper_bound = 0, solver = "auto", storage = "double") {
+  path <- NULL
+  if (is.character(w)) {
+    if (length(w) != 1 || !file.exists(w)) stop("'w' is not the path of an existing model file")
+    path <- path.expand(w)
+  } else {
+    if (is(w, "nmf")) w <- w@w
+    if (!canCoerce(w, "matrix")) stop("'w' was not coercible to a matrix")
+    w <- as.matrix(w)
+    if (!is.numeric(w) || any(is.na(w))) stop("'w' must be a numeric matrix without 'NA' values")
+    storage.mode(w) <- "double"
+  }
+  if (length(L1) != 1 || L1 >= 1 || L1 < 0) stop("'L1' must be a single value in the range [0,1)")
+  if (length(L2) != 1 || L2 < 0) stop("'L2' must be a single value >= 0")
+  if (length(upper_bound) != 1 || upper_bound < 0) stop("'upper_bound' must be a single value >= 0")
+  if (!(solver %in% c("auto", "cd", "cd_greedy", "cd_random", "active_set"))) stop("'solver' must be one of \"auto\", \"cd\", \"cd_greedy\", \"cd_random\", or \"active_set\"")
+  if (!(storage %in% c("double", "int8", "float16"))) stop("'storage' must be one of \"double\", \"int8\", or \"float16\"")
+  if (is.null(path)) {
+    ptr <- Rcpp_projector(t(w), L1, L2, upper_bound, solver, storage)
+  } else {
+    ptr <- Rcpp_projector_file(path, L1, L2, upper_bound, solver, storage)
+  }
+  info <- Rcpp_projector_info(ptr)
+  structure(list(ptr = ptr, factors = paste0("nmf", seq_len(info$rank)), storage = storage, error = info$error, bytes = info$bytes,
+                 mapped = info$mapped), class = "projector")
+}
+
+#' Project one sparse sample
+#'
+#' Project one sample, given by the rows and values of its non-zeros, onto a \code{\link{projector}} with as little overhead as possible, for queries of one sample at a time in tight loops or in a web service.
+#'
+#' @details
+#' \code{project(p, data)} validates and coerces \code{data} into a \code{dgCMatrix} in R, which for a single sample costs far more than the projection itself. \code{project_sample} takes the non-zeros of the sample as two vectors, which are read in place in C++ without building a sparse matrix or any S4 object, and solves the sample on the calling thread from the factorization of \eqn{w^Tw} held by the projector. The result is the same as \code{project(p, data)} of a single column with these non-zeros.
+#'
+#' @param p a \code{projector}
+#' @param i row indices (1-based features of the projector) of the non-zeros of the sample, as an integer vector
+#' @param x values of the non-zeros of the sample, as a double vector of the length of \code{i}
+#' @returns vector of \code{h} of the sample, of length the rank of the projector, without names
+#' @export
+#' @seealso \code{\link{projector}}, \code{\link{project}}
+#' @examples \dontrun{
+#' w <- matrix(runif(1000 * 10), 1000, 10)
+#' p <- projector(w)
+#' h <- project_sample(p, c(3L, 17L, 512L), c(1, 2, 5))
+#' }
+project_sample <- function(p, i, x) Rcpp_project_sample(p$ptr, i, x)
+
+#' Project a model onto a batch of matrices
+#'
+#' Project one model onto each matrix in a list of matrices of the same features, such as one matrix for each donor or well, in a single call.
+#'
+#' @details
+#' \code{lapply(data, function(A) project(w, A))} validates and copies \code{w}, computes and factorizes \eqn{w^Tw}, and starts a team of threads for each matrix, which costs more than the projection of a matrix of a few samples. \code{project_batch} does each of these once for the whole batch: \code{w} is prepared as by \code{\link{projector}} (or a projector is given as \code{w}), and the samples of all matrices are projected in one parallel loop, so that threads are shared across matrices of any size.
+#'
+#' Matrices are all projected as dense matrices if they are all dense, and otherwise as \code{dgCMatrix}. Masking is not supported.
+#'
+#' @inheritParams projector
+#' @param w matrix of features (rows) by factors (columns), an \code{nmf} model, the path of a model file written by \code{\link{write_nmf}}, or a \code{projector}
+#' @param data list of dense or sparse matrices, each with the features of \code{w} in rows
+#' @returns list of \code{h}, one for each matrix in \code{data}, with the names of \code{data}
+#' @export
+#' @seealso \code{\link{project}}, \code{\link{projector}}
+#' @examples \dontrun{
+#' w <- matrix(runif(1000 * 10), 1000, 10)
+#' donors <- lapply(1:100, function(i) r_sparsematrix(1000, 5, 10))
+#' h <- project_batch(w, donors)
+#' all.equal(h[[1]], project(w, donors[[1]]))
+#' }
+project_batch <- function(w, data, L1 = 0, L2 = 0, upper_bound = 0, solver = "auto") {
+  if (!is.list(data) || is.data.frame(data)) stop("'data' must be a list of matrices")
+  if (inherits(w, "projector")) {
+    if (L1 != 0 || L2 != 0 || upper_bound != 0) stop("'L1', 'L2', and 'upper_bound' of a projector are set when it is created")
+    p <- w
+  } else {
+    p <- projector(w, L1 = L1, L2 = L2, upper_bound = upper_bound, solver = solver)
+  }
+  if (length(data) == 0) return(list())
+  if (all(vapply(data, is.matrix, logical(1)))) {
+    data <- lapply(data, function(A) {
+      if (!is.double(A)) storage.mode(A) <- "double"
+      A
+    })
+    h <- Rcpp_project_batch_dense(p$ptr, data, getOption("RcppML.threads"))
+  } else {
+    data <- lapply(data, function(A) if (class(A)[[1]] == "dgCMatrix") A else as(A, "dgCMatrix"))
+    h <- Rcpp_project_batch_sparse(p$ptr, data, getOption("RcppML.threads"))
+  }
+  for (m in seq_along(h)) dimnames(h[[m]]) <- list(p$factors, colnames(data[[m]]))
+  names(h) <- names(data)
+  h
+}
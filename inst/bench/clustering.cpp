@@ -0,0 +1,157 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+// BENCHMARKS OF DIVISIVE CLUSTERING
+//
+// Scaling of "clusterModel::dclust" and of the bipartition of all samples ("c_bipartition_inplace") with the number of
+//   samples and threads, on synthetic sparse data of known clusters. This file is not part of the package build:
+//   "clustering.R" compiles it with "Rcpp::sourceCpp" against the headers in "../include" and runs "bench_clustering"
+//   over a grid of samples, features and clusters (see "clustering.R").
+//  * each sample belongs to one of "clusters" profiles drawn as the factors of "simulateNMF" (see "simulateFactors"),
+//      and its non-zeros are found at a "density" of features by skipping geometric gaps (see "skipSample"), with the
+//      value of its profile and Gaussian noise. All values are hashes of their position, so data do not depend on the
+//      number of threads.
+//  * each run is repeated "reps" times at each number of threads, and the fastest run is reported
+//  * parallel efficiency is the time on one thread over "threads" times the time on "threads" threads, and is only
+//      reported if one thread is among "threads"
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::plugins(cpp11)]]
+#include <RcppML.h>
+#include <RcppML/bipartition.hpp>
+#include <RcppML/cluster.hpp>
+#include <RcppML/simulate.hpp>
+
+#include <chrono>
+#include <sstream>
+
+// "features x samples" sparse matrix of samples in "clusters" clusters, with non-zeros at "density" of features
+//  * values are hashes of their position, so non-zeros are counted in a first pass and written in a second directly
+//      into the vectors of the "dgCMatrix", which are then never copied or grown
+inline Rcpp::SparseMatrix benchClustered(const uint32_t features, const uint32_t samples, const uint32_t clusters, const double density,
+                                         const double noise, const uint32_t seed) {
+    const RcppML::cscMatrix profiles = RcppML::simulateFactors(features, clusters, seed, 0);
+    Eigen::MatrixXd w = Eigen::MatrixXd::Zero(features, clusters);
+    for (uint32_t c = 0; c < clusters; ++c)
+        for (size_t it = profiles.p[c]; it < profiles.p[c + 1]; ++it) w(profiles.i[it], c) = profiles.x[it] * features;
+    const RcppML::rng<false> membership(seed + 1), kept(seed + 2), u1(seed + 3), u2(~(seed + 3));
+    std::vector<uint32_t> col_rows;
+
+    Rcpp::IntegerVector p(samples + 1), i;
+    Rcpp::NumericVector x;
+
+    // count the non-zeros of sample "j", or write them from "p[j]" once "i" and "x" are allocated
+    auto sample = [&](const uint32_t j, const bool write) -> size_t {
+        const uint32_t c = std::min(clusters - 1, (uint32_t)(membership.runif<double>(0, j) * clusters));
+        col_rows.clear();
+        RcppML::skipSample(kept, j, 0, features, density, col_rows);
+        size_t it = write ? (size_t)p[j] : 0;
+        for (const uint32_t r : col_rows) {
+            const double value = w(r, c) + noise * RcppML::normalAt(u1, u2, r, j);
+            if (value <= 0) continue;
+            if (write) {
+                i[it] = r;
+                x[it] = value;
+            }
+            ++it;
+        }
+        return it;
+    };
+    size_t nnz = 0;
+    for (uint32_t j = 0; j < samples; ++j) {
+        nnz += sample(j, false);
+        if (nnz > (size_t)std::numeric_limits<int>::max()) Rcpp::stop("too many non-zeros for a 'dgCMatrix'");
+        p[j + 1] = nnz;
+    }
+    i = Rcpp::IntegerVector(nnz);
+    x = Rcpp::NumericVector(nnz);
+    for (uint32_t j = 0; j < samples; ++j) sample(j, true);
+    return Rcpp::SparseMatrix(x, i, p, Rcpp::IntegerVector::create(features, samples));
+}
+
+// fastest wall time of "reps" calls to "f"
+template <class F>
+inline double fastest(const unsigned int reps, F f) {
+    double best = std::numeric_limits<double>::infinity();
+    for (unsigned int rep = 0; rep < std::max(reps, 1u); ++rep) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// "x" as a JSON number, or null if it is not finite
+inline std::string jsonNumber(const double x) {
+    if (!std::isfinite(x)) return "null";
+    std::ostringstream s;
+    s.precision(6);
+    s << x;
+    return s.str();
+}
+
+// time of "dclust" and of the root bipartition of a "features x samples" matrix of "clusters" clusters at "density",
+//   at each of "threads" (0 for all), as one JSON object per run
+//  * "dclust" splits until clusters have fewer than "min_samples" samples or their bipartition is within "min_dist"
+//  * splits are the internal nodes of the tree, and depth is the greatest number of splits above a leaf
+// [[Rcpp::export]]
+std::vector<std::string> bench_clustering(const unsigned int samples, const unsigned int features, const unsigned int clusters,
+                                          const double density, std::vector<unsigned int> threads, const unsigned int min_samples = 50,
+                                          const double min_dist = 0, const double noise = 0.5, const unsigned int reps = 3,
+                                          const unsigned int seed = 123) {
+    if (clusters == 0 || features == 0 || samples == 0) Rcpp::stop("'samples', 'features' and 'clusters' must be positive");
+    for (unsigned int& t : threads) {
+#ifdef _OPENMP
+        if (t == 0) t = omp_get_max_threads();
+#else
+        t = 1;
+#endif
+    }
+    Rcpp::SparseMatrix A = benchClustered(features, samples, clusters, density, noise, seed);
+    const double nnz = A.i.size();
+    const Eigen::MatrixXd w_init = randomMatrix(2, features, seed);
+
+    std::vector<double> dclust_seconds, split_seconds;
+    std::vector<std::string> json;
+    for (const unsigned int t : threads) {
+        // the whole tree, by a new model in each run so that runs do not share state
+        unsigned int splits = 0, leaves = 0, depth = 0;
+        const double seconds = fastest(reps, [&]() {
+            RcppML::clusterModel<Rcpp::SparseMatrix> m(A, min_samples, min_dist);
+            m.verbose = false;
+            m.seed = seed;
+            m.threads = t;
+            m.dclust();
+            splits = m.getNodes().size();
+            leaves = m.getClusters().size();
+            depth = 0;
+            for (const cluster& c : m.getClusters()) depth = std::max(depth, (unsigned int)c.id.size() - 1);
+        });
+        dclust_seconds.push_back(seconds);
+
+        // the root bipartition of all samples, which uses all threads in each update (see "clusterModel::dclust")
+        unsigned int iter = 0;
+        const double root = fastest(reps, [&]() {
+            std::vector<unsigned int> order(samples);
+            std::iota(order.begin(), order.end(), 0u);
+            iter = c_bipartition_inplace(A, w_init, order.data(), samples, 1e-4, true, min_dist > 0, 100, false, t).iter;
+        });
+        split_seconds.push_back(root);
+
+        const double efficiency = (threads[0] == 1) ? dclust_seconds[0] / (t * seconds) : NAN;
+        const double root_efficiency = (threads[0] == 1) ? split_seconds[0] / (t * root) : NAN;
+        std::ostringstream s;
+        s.precision(6);
+        s << "{\"samples\": " << samples << ", \"features\": " << features << ", \"clusters\": " << clusters << ", \"density\": " << density
+          << ", \"nnz\": " << nnz << ", \"threads\": " << t << ", \"seconds\": " << seconds << ", \"splits\": " << splits
+          << ", \"leaves\": " << leaves << ", \"depth\": " << depth << ", \"seconds_per_split\": " << jsonNumber(seconds / splits)
+          << ", \"splits_per_s\": " << splits / seconds << ", \"efficiency\": " << jsonNumber(efficiency)
+          << ", \"root_seconds\": " << root << ", \"root_iter\": " << iter << ", \"root_efficiency\": " << jsonNumber(root_efficiency) << "}";
+        json.push_back(s.str());
+    }
+    return json;
+}
@@ -0,0 +1,263 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+// BENCHMARKS OF CORE KERNELS
+//
+// Throughput of the kernels behind "nmf", "bipartition", "distance" and the random generators, on synthetic inputs
+//   drawn as by "r_sparsematrix". This file is not part of the package build: "run.R" compiles it with
+//   "Rcpp::sourceCpp" against the headers in "../include" and runs "bench_kernels" over a grid of dimensions, densities,
+//   ranks, and threads (see "run.R").
+//  * each kernel is run "reps" times and the fastest run is reported
+//  * GFLOP/s and GB/s count the arithmetic and the bytes of inputs and results that each kernel must touch, not what
+//      it actually does, so that they change only when the kernel gets faster or slower. Coordinate descent is counted
+//      from its sweeps (see "RcppML::countSolve"), so a solver that needs more sweeps shows more flops.
+//  * kernels over a dense copy of the input are skipped when the copy would exceed "BENCH_MAX_DENSE" values
+//  * kernels that gather a column of the model for each non-zero of the input also report the time that each thread
+//      spends per non-zero, in nanoseconds
+
+// [[Rcpp::plugins(openmp)]]
+// [[Rcpp::plugins(cpp11)]]
+#include <RcppML.h>
+#include <RcppML/bipartition.hpp>
+#include <RcppML/distance.hpp>
+#include <RcppML/nmf.hpp>
+
+#include <chrono>
+#include <sstream>
+
+#ifndef BENCH_MAX_DENSE
+#define BENCH_MAX_DENSE 50000000
+#endif
+
+// number of columns against which all columns are compared in the distance benchmark
+#ifndef BENCH_DISTANCE_COLS
+#define BENCH_DISTANCE_COLS 512
+#endif
+
+// throughput of one kernel, with "flops" of 0 for kernels without a meaningful count, and "nnz" of 0 for kernels that
+//   are not timed per non-zero
+struct benchResult {
+    std::string kernel;
+    double seconds, columns, flops, bytes, nnz;
+};
+
+// "rows x cols" matrix of non-zeros in (0, 1) with probability "density", as "r_sparsematrix". The first columns of a
+//   matrix do not depend on "cols".
+inline Rcpp::SparseMatrix benchSparse(const uint32_t rows, const uint32_t cols, const double density, const uint32_t seed) {
+    const RcppML::rng<false> gaps(seed), values(~seed);
+    std::vector<uint32_t> col_rows;
+    std::vector<int> i;
+    std::vector<double> x;
+    Rcpp::IntegerVector p(cols + 1);
+    for (uint32_t j = 0; j < cols; ++j) {
+        col_rows.clear();
+        RcppML::skipSample(gaps, j, 0, rows, density, col_rows);
+        for (const uint32_t r : col_rows) {
+            i.push_back(r);
+            x.push_back(values.runif<double>(r, j));
+        }
+        p[j + 1] = i.size();
+    }
+    return Rcpp::SparseMatrix(Rcpp::NumericVector(x.begin(), x.end()), Rcpp::IntegerVector(i.begin(), i.end()), p,
+                              Rcpp::IntegerVector::create(rows, cols));
+}
+
+// fastest wall time of "reps" calls to "f"
+template <class F>
+inline double fastest(const unsigned int reps, F f) {
+    double best = std::numeric_limits<double>::infinity();
+    for (unsigned int rep = 0; rep < std::max(reps, 1u); ++rep) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// coordinate descent sweeps of all solves in one of "reps" calls to "f", whose fastest wall time is written to "best"
+template <class F>
+inline double sweepsPerRep(const unsigned int reps, F f, double& best) {
+    const RcppML::profileScope counting(true);
+    const uint64_t sweeps_0 = RcppML::cdCounts().sweeps.load();
+    best = fastest(reps, f);
+    return (double)(RcppML::cdCounts().sweeps.load() - sweeps_0) / std::max(reps, 1u);
+}
+
+// one JSON object for "r" at this point of the grid
+inline std::string benchJson(const benchResult& r, const unsigned int rows, const unsigned int cols, const double density,
+                             const unsigned int k, const unsigned int threads) {
+    std::ostringstream s;
+    s.precision(6);
+    s << "{\"kernel\": \"" << r.kernel << "\", \"rows\": " << rows << ", \"cols\": " << cols << ", \"density\": " << density
+      << ", \"k\": " << k << ", \"threads\": " << threads << ", \"seconds\": " << r.seconds
+      << ", \"columns_per_s\": " << r.columns / r.seconds << ", \"gflops\": ";
+    if (r.flops > 0)
+        s << r.flops / r.seconds / 1e9;
+    else
+        s << "null";
+    s << ", \"gb_per_s\": " << r.bytes / r.seconds / 1e9 << ", \"ns_per_nnz\": ";
+    if (r.nnz > 0)
+        s << r.seconds / r.nnz * 1e9;
+    else
+        s << "null";
+    s << "}";
+    return s.str();
+}
+
+// throughput of each kernel on a "rows x cols" sparse matrix of "density" and models of rank "k", with "threads"
+//   threads (0 for all), as one JSON object per kernel
+// [[Rcpp::export]]
+std::vector<std::string> bench_kernels(const unsigned int rows, const unsigned int cols, const double density, const unsigned int k,
+                                       unsigned int threads, const unsigned int reps = 3, const unsigned int seed = 123) {
+#ifdef _OPENMP
+    if (threads == 0) threads = omp_get_max_threads();
+#else
+    threads = 1;
+#endif
+    Rcpp::SparseMatrix A = benchSparse(rows, cols, density, seed), mask;
+    const double nnz = A.i.size(), sparse_bytes = nnz * (sizeof(double) + sizeof(int)) + (cols + 1) * sizeof(int);
+    const double model_bytes = (double)(rows + cols) * k * sizeof(double);
+    const Eigen::MatrixXd w = randomMatrix(k, rows, seed);
+    Eigen::MatrixXd h(k, cols);
+    const linkIndex no_links;
+    std::vector<benchResult> results;
+    double seconds, sweeps;
+    const double sweep_flops = 2.0 * k * k;
+
+    // coordinate descent from zero for right-hand sides whose unconstrained solutions are half negative
+    {
+        Eigen::MatrixXd a = gram(w);
+        a.diagonal().array() += TINY_NUM;
+        const Eigen::MatrixXd B = a * (randomMatrix(k, cols, seed + 1).array() - 0.5).matrix();
+        sweeps = sweepsPerRep(reps, [&]() {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 64)
+#endif
+            for (unsigned int j = 0; j < cols; ++j) {
+                Eigen::VectorXd b = B.col(j);
+                h.col(j).setZero();
+                c_nnls(a, b, h, j);
+            }
+        }, seconds);
+        results.push_back({"c_nnls", seconds, (double)cols, sweeps * sweep_flops, 2.0 * cols * k * sizeof(double)});
+    }
+
+    // right-hand sides "wA" of all columns in sparse "A", with one iterator per column as before "gatherTile", and with
+    //   columns of "w" prefetched ahead of the non-zeros that read them (see "GATHER_PREFETCH_DISTANCE")
+    {
+        Eigen::MatrixXd B(k, cols);
+        seconds = fastest(reps, [&]() {
+            B.setZero();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+            for (unsigned int j = 0; j < cols; ++j)
+                for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it) B.col(j) += it.value() * w.col(it.row());
+        });
+        results.push_back({"gather_plain", seconds, (double)cols, 2 * k * nnz, sparse_bytes + model_bytes, nnz / threads});
+        seconds = fastest(reps, [&]() {
+            B.setZero();
+            const int tiles = (cols + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+            for (int tile = 0; tile < tiles; ++tile) {
+                const int start = tile * PREDICT_TILE_SIZE, n = std::min((int)PREDICT_TILE_SIZE, (int)cols - start);
+                Eigen::Block<Eigen::MatrixXd> B_tile = B.middleCols(start, n);
+                gatherTile(A, w, B_tile, start, n);
+            }
+        });
+        results.push_back({"gather_prefetch", seconds, (double)cols, 2 * k * nnz, sparse_bytes + model_bytes, nnz / threads});
+    }
+
+    // updates of "h" given sparse "A", without and with masking of zeros
+    sweeps = sweepsPerRep(reps, [&]() { predict(A, mask, no_links, w, h, 0, 0, threads, false, false, false, 0); }, seconds);
+    results.push_back({"predict_sparse", seconds, (double)cols, 2 * k * nnz + sweep_flops * rows + sweeps * sweep_flops, sparse_bytes + model_bytes});
+    sweeps = sweepsPerRep(reps, [&]() { predict(A, mask, no_links, w, h, 0, 0, threads, true, false, false, 0); }, seconds);
+    results.push_back({"predict_masked", seconds, (double)cols, 2 * k * nnz + (double)k * k * nnz + sweeps * sweep_flops, sparse_bytes + model_bytes});
+
+    // updates of "h" given a dense copy of "A"
+    if ((double)rows * cols <= BENCH_MAX_DENSE) {
+        Eigen::MatrixXd A_dense = Eigen::MatrixXd::Zero(rows, cols);
+        for (unsigned int j = 0; j < cols; ++j)
+            for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it) A_dense(it.row(), j) = it.value();
+        sweeps = sweepsPerRep(reps, [&]() { predict(A_dense, mask, no_links, w, h, 0, 0, threads, false, false, false, 0); }, seconds);
+        results.push_back({"predict_dense", seconds, (double)cols, 2.0 * k * rows * cols + sweep_flops * rows + sweeps * sweep_flops,
+                           (double)rows * cols * sizeof(double) + model_bytes});
+    }
+
+    // mean squared error of the model of "A" solved above, from its gram matrices (see "nmf::mse_gram")
+    {
+        RcppML::nmf<Rcpp::SparseMatrix> m(A, w, Eigen::VectorXd::Ones(k), h);
+        m.threads = threads;
+        seconds = fastest(reps, [&]() { m.mse(); });
+        results.push_back({"mse_sparse", seconds, (double)cols, 2 * k * nnz + 2.0 * k * k * (rows + cols), sparse_bytes + model_bytes});
+    }
+
+    // bipartition of all columns, which runs on one thread. Each iteration reads all non-zeros in updates of "h" and "w".
+    {
+        std::vector<unsigned int> samples(cols);
+        for (unsigned int j = 0; j < cols; ++j) samples[j] = j;
+        const Eigen::MatrixXd w2 = randomMatrix(2, rows, seed);
+        unsigned int iter = 0;
+        seconds = fastest(reps, [&]() { iter = c_bipartition_sparse(A, w2, samples, 1e-4, true, false, 100, false).iter; });
+        results.push_back({"bipartition_sparse", seconds, (double)cols, 8.0 * nnz * iter, 2.0 * sparse_bytes * iter});
+    }
+
+    // cosine distances of all columns to the first "BENCH_DISTANCE_COLS" columns. Each pair of non-zeros in the same
+    //   row is multiplied once.
+    {
+        const unsigned int b_cols = std::min(cols, (unsigned int)BENCH_DISTANCE_COLS);
+        Rcpp::SparseMatrix B = benchSparse(rows, b_cols, density, seed);
+        std::vector<double> a_row_nnz(rows, 0), b_row_nnz(rows, 0);
+        for (const int r : A.i) ++a_row_nnz[r];
+        for (const int r : B.i) ++b_row_nnz[r];
+        double pairs = 0;
+        for (unsigned int r = 0; r < rows; ++r) pairs += a_row_nnz[r] * b_row_nnz[r];
+        seconds = fastest(reps, [&]() { distance(A, B, "cosine", threads); });
+        results.push_back({"distance_sparse", seconds, (double)cols, 2 * pairs, sparse_bytes + (double)cols * b_cols * sizeof(double)});
+    }
+
+    // uniform values for every position of "A", as by "rmatrix", into a buffer of one column per thread
+    seconds = fastest(reps, [&]() {
+        const RcppML::rng<true> s(seed);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+        {
+            std::vector<float> column(rows);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (unsigned int j = 0; j < cols; ++j) s.runif<float>(column.data(), 0, rows, j);
+        }
+    });
+    results.push_back({"rng_runif", seconds, (double)cols, 0, (double)rows * cols * sizeof(float)});
+
+    // positions of the non-zeros of "A", as by "r_sparsematrix", which takes time in proportion to the non-zeros
+    seconds = fastest(reps, [&]() {
+        const RcppML::rng<false> gaps(seed);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+        {
+            std::vector<uint32_t> col_rows;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (unsigned int j = 0; j < cols; ++j) {
+                col_rows.clear();
+                RcppML::skipSample(gaps, j, 0, rows, density, col_rows);
+            }
+        }
+    });
+    results.push_back({"rng_sample", seconds, (double)cols, 0, nnz * sizeof(uint32_t)});
+
+    std::vector<std::string> json;
+    for (const benchResult& r : results) json.push_back(benchJson(r, rows, cols, density, k, threads));
+    return json;
+}
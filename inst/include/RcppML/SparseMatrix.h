@@ -3,7 +3,10 @@
 #include <RcppCommon.h>
 
 namespace Rcpp {
-class SparseMatrix;
+struct SparsePattern;
+template <typename Value>
+class SparseMatrixOf;
+typedef SparseMatrixOf<double> SparseMatrix;
 }  // namespace Rcpp
 
 // forward declare Rcpp::as<> Exporter
@@ -15,9 +18,117 @@ class Exporter<Rcpp::SparseMatrix>;
 }  // namespace Rcpp
 
 #include <Rcpp.h>
+#include <cmath>
+#include "core.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace Rcpp {
 
+// tag for the values of a pattern matrix (i.e. Matrix::ngCMatrix), which are all 1
+struct SparsePattern {};
+
+// non-zero values of a "SparseMatrixOf<Value>" stored in a compact type, rather than as the "x" slot of a dgCMatrix
+//  * values are held in C++ memory, shared by copies of this object like R vectors, and read as "double"
+//  * values are converted from "double" on construction, and must be exactly representable in "Value" (see
+//      "sparseValueType")
+template <typename Value>
+class SparseValues {
+   public:
+    SparseValues(const int n = 0) : values(std::make_shared<std::vector<Value>>(n)), ptr(values->data()) {}
+    explicit SparseValues(const NumericVector& x) : SparseValues(x.size()) {
+        for (int k = 0; k < x.size(); ++k) ptr[k] = (Value)x[k];
+    }
+    Value& operator[](const int k) { return ptr[k]; }
+    Value operator[](const int k) const { return ptr[k]; }
+    int size() const { return values->size(); }
+
+   private:
+    std::shared_ptr<std::vector<Value>> values;
+    Value* ptr;
+};
+
+// values of a pattern matrix, which are not stored
+template <>
+class SparseValues<SparsePattern> {
+   public:
+    SparseValues(const int n = 0) : n(n) {}
+    explicit SparseValues(const NumericVector& x) : n(x.size()) {}
+    double operator[](const int k) const { return 1; }
+    int size() const { return n; }
+
+   private:
+    int n;
+};
+
+// storage of non-zero values in "SparseMatrixOf<Value>": the "x" slot of a dgCMatrix for "double", otherwise "SparseValues"
+template <typename Value>
+struct sparse_values {
+    typedef SparseValues<Value> type;
+};
+template <>
+struct sparse_values<double> {
+    typedef NumericVector type;
+};
+
+// copy one non-zero value between value vectors, where pattern values are not stored
+template <class Values>
+inline void copyValue(Values& to, const int k, const Values& from, const int k_from) { to[k] = from[k_from]; }
+inline void copyValue(SparseValues<SparsePattern>&, const int, const SparseValues<SparsePattern>&, const int) {}
+
+// read the values of an S4 sparse matrix with "nnz" non-zeros
+inline void readValues(const S4& s, const int nnz, NumericVector& x) {
+    if (!s.hasSlot("x")) throw std::invalid_argument("Cannot construct SparseMatrix from this S4 object");
+    x = s.slot("x");
+}
+template <typename Value>
+inline void readValues(const S4& s, const int nnz, SparseValues<Value>& x) {
+    if (!s.hasSlot("x")) throw std::invalid_argument("Cannot construct SparseMatrix from this S4 object");
+    x = SparseValues<Value>(NumericVector(s.slot("x")));
+}
+inline void readValues(const S4& s, const int nnz, SparseValues<SparsePattern>& x) { x = SparseValues<SparsePattern>(nnz); }
+
+// values of "from", a "double" value vector of "nnz" non-zeros, stored as the type of "x" (see "readValues")
+inline void castValues(const NumericVector& from, const int nnz, NumericVector& x) { x = from; }
+template <typename Value>
+inline void castValues(const NumericVector& from, const int nnz, SparseValues<Value>& x) { x = SparseValues<Value>(from); }
+inline void castValues(const NumericVector& from, const int nnz, SparseValues<SparsePattern>& x) { x = SparseValues<SparsePattern>(nnz); }
+
+// types in which the non-zero values of a sparse matrix may be stored (see "sparseValueType")
+enum sparse_value_type { SPARSE_DOUBLE = 0,
+                         SPARSE_FLOAT = 1,
+                         SPARSE_UINT16 = 2,
+                         SPARSE_PATTERN = 3 };
+
+// an S4 sparse matrix compressed by rows (e.g. Matrix::dgRMatrix or ngRMatrix), whose row pointers "p" and column
+//   indices "j" are the column pointers and row indices of its transpose
+inline bool isRowCompressed(const S4& s) { return s.hasSlot("j") && s.hasSlot("p"); }
+
+// most compact type that exactly represents all non-zero values of an S4 sparse matrix
+//  * a ngCMatrix, or a matrix of only ones, is a pattern
+//  * whole numbers up to 65535 (e.g. most UMI counts) are "uint16_t", and whole numbers up to 2^24 are exact in "float"
+//  * other values are "float" only if "allow_float", e.g. when all computations are in single precision anyway
+inline sparse_value_type sparseValueType(const S4& s, const bool allow_float = false) {
+    if (!s.hasSlot("x")) return SPARSE_PATTERN;
+    const NumericVector x = s.slot("x");
+    bool ones = true, uint16 = true, whole_float = true;
+    for (int k = 0; k < x.size() && whole_float; ++k) {
+        const double v = x[k];
+        if (v != 1) ones = false;
+        if (v != std::floor(v) || std::abs(v) > 16777216) whole_float = false;
+        else if (v < 0 || v > 65535) uint16 = false;
+    }
+    if (ones) return SPARSE_PATTERN;
+    if (whole_float) return uint16 ? SPARSE_UINT16 : SPARSE_FLOAT;
+    return allow_float ? SPARSE_FLOAT : SPARSE_DOUBLE;
+}
+
 // this class is provided for consistency with Eigen::SparseMatrix, but using
 // R objects (i.e. Rcpp::NumericVector, Rcpp::IntegerVector) that comprise Matrix::dgCMatrix in R.
 // R objects are pointers to underlying memory-mapped SEXP vectors, and are usable in C++ without any
@@ -27,42 +138,168 @@ namespace Rcpp {
 // The class is designed with an `InnerIterator` class that exactly mimics `Eigen::SparseMatrix<T>::InnerIterator`,
 // and also contains `.rows()` and `.cols()` member functions. This allows it to substitute for `Eigen::SparseMatrix`
 // in all SLAM routines.
-class SparseMatrix {
+//
+// "Value" is the type in which non-zero values are stored, and values are always read as "double":
+//  * "double" values are the "x" slot of a dgCMatrix, without a copy (this is "Rcpp::SparseMatrix")
+//  * "float" and "uint16_t" values are a compact copy (see "SparseValues"), which halves or quarters the memory
+//      traffic of iterating over non-zeros, and the size of transposes and submatrices
+//  * "SparsePattern" values are all 1 and are not stored, as in a ngCMatrix
+template <typename Value>
+class SparseMatrixOf {
    public:
-    NumericVector x;
+    typedef typename sparse_values<Value>::type Values;
+    Values x;
     IntegerVector i, p, Dim;
 
     // constructors
-    SparseMatrix(NumericVector x, IntegerVector i, IntegerVector p, IntegerVector Dim) : x(x), i(i), p(p), Dim(Dim) {}
-    SparseMatrix(const S4& s) {
-        if (!s.hasSlot("x") || !s.hasSlot("p") || !s.hasSlot("i") || !s.hasSlot("Dim"))
+    SparseMatrixOf(Values x, IntegerVector i, IntegerVector p, IntegerVector Dim) : x(x), i(i), p(p), Dim(Dim) {}
+    SparseMatrixOf(const S4& s) {
+        if (!s.hasSlot("p") || !s.hasSlot("i") || !s.hasSlot("Dim"))
             throw std::invalid_argument("Cannot construct SparseMatrix from this S4 object");
-        x = s.slot("x");
         i = s.slot("i");
         p = s.slot("p");
         Dim = s.slot("Dim");
+        readValues(s, i.size(), x);
+    }
+    SparseMatrixOf() {}
+
+    // copy of "other" with values stored as "Value", which shares its indices and the structure cached by it or by
+    //   its copies (see "colChunks", "rowIndex", "compressIndices" and "isAppxSymmetric"), e.g. of a matrix held in
+    //   "RcppML::matrixCache"
+    static SparseMatrixOf sharedCopy(const SparseMatrixOf<double>& other) {
+        SparseMatrixOf s;
+        s.i = other.i;
+        s.p = other.p;
+        s.Dim = other.Dim;
+        castValues(other.x, other.i.size(), s.x);
+        s.col_chunks = other.col_chunks;
+        s.row_index = other.row_index;
+        s.delta_index = other.delta_index;
+        s.appx_symmetric = other.appx_symmetric;
+        return s;
+    }
+
+    // transpose of a row-compressed S4 matrix (see "isRowCompressed"), read in place like a dgCMatrix
+    static SparseMatrixOf transposedView(const S4& s) {
+        const IntegerVector Dim_ = s.slot("Dim");
+        SparseMatrixOf t;
+        t.i = s.slot("j");
+        t.p = s.slot("p");
+        t.Dim = IntegerVector::create(Dim_[1], Dim_[0]);
+        readValues(s, t.i.size(), t.x);
+        return t;
+    }
+
+    // an S4 matrix compressed by columns, read in place, or compressed by rows, transposed once from its transposed
+    //   view rather than coerced to a dgCMatrix in R
+    static SparseMatrixOf columnCompressed(const S4& s, const unsigned int threads = 0) {
+        if (!isRowCompressed(s)) return SparseMatrixOf(s);
+        return transposedView(s).transpose(threads);
+    }
+
+    // copy of the non-zeros of a dense matrix or expression (e.g. "m.transpose()"), without a dense intermediate
+    template <class MatrixX>
+    explicit SparseMatrixOf(const Eigen::MatrixBase<MatrixX>& m) {
+        const int n_rows = m.rows(), n_cols = m.cols();
+        p = IntegerVector(n_cols + 1);
+        for (int j = 0; j < n_cols; ++j) {
+            p[j + 1] = p[j];
+            for (int k = 0; k < n_rows; ++k)
+                if (m(k, j) != 0) ++p[j + 1];
+        }
+        x = NumericVector(p[n_cols]);
+        i = IntegerVector(p[n_cols]);
+        for (int j = 0, it = 0; j < n_cols; ++j) {
+            for (int k = 0; k < n_rows; ++k) {
+                if (m(k, j) != 0) {
+                    i[it] = k;
+                    x[it] = (double)m(k, j);
+                    ++it;
+                }
+            }
+        }
+        Dim = IntegerVector::create(n_rows, n_cols);
     }
-    SparseMatrix() {}
 
     unsigned int rows() { return Dim[0]; }
     unsigned int cols() { return Dim[1]; }
 
+    // row indices of non-zeros encoded as 16-bit differences from the previous row index in the same column (the first
+    // row index of each column is its difference from 0), starting at "q[col]" in "d"
+    //  * differences of 65535 or more are written as 65535, followed by the difference in two 16-bit words (low, high)
+    //  * sorted row indices of dense-ish columns have small differences, so this is about half the size of "i"
+    struct DeltaIndex {
+        std::vector<int> q;
+        std::vector<uint16_t> d;
+    };
+
+    // encode row indices once for iteration by "InnerIterator" (see "DeltaIndex"), which then reads about half as many
+    // bytes of indices as from "i". "i" is kept for all other uses.
+    //  * the encoding is cached and shared by copies of this object, and may be requested from several threads
+    void compressIndices() {
+#ifdef _OPENMP
+#pragma omp critical(RcppML_compressIndices)
+#endif
+        {
+            DeltaIndex* index = delta_index.get();
+            if (index->q.empty()) {
+                const int n_cols = Dim[1];
+                index->q.resize(n_cols + 1);
+                index->d.reserve(p[n_cols]);
+                for (int c = 0; c < n_cols; ++c) {
+                    index->q[c] = index->d.size();
+                    int prev = 0;
+                    for (int it = p[c]; it < p[c + 1]; ++it) {
+                        const uint32_t delta = i[it] - prev;
+                        if (delta < 65535) {
+                            index->d.push_back(delta);
+                        } else {
+                            index->d.push_back(65535);
+                            index->d.push_back(delta & 65535);
+                            index->d.push_back(delta >> 16);
+                        }
+                        prev = i[it];
+                    }
+                }
+                index->q[n_cols] = index->d.size();
+            }
+        }
+    }
+
     // const column iterator
+    //  * if indices have been compressed (see "compressIndices"), rows are decoded as the iterator advances
     class InnerIterator {
        public:
-        InnerIterator(SparseMatrix& ptr, int col) : ptr(ptr), col_(col), index(ptr.p[col]), max_index(ptr.p[col + 1]) {}
+        InnerIterator(SparseMatrixOf& ptr, int col) : ptr(ptr), col_(col), index(ptr.p[col]), max_index(ptr.p[col + 1]) {
+            const DeltaIndex& delta = *ptr.delta_index;
+            if (!delta.q.empty() && index < max_index) {
+                d = delta.d.data() + delta.q[col];
+                decode();
+            }
+        }
         operator bool() const { return (index < max_index); }
         InnerIterator& operator++() {
             ++index;
+            if (d && index < max_index) decode();
             return *this;
         }
-        double& value() const { return ptr.x[index]; }
-        int row() const { return ptr.i[index]; }
+        double value() const { return ptr.x[index]; }
+        int row() const { return d ? row_ : ptr.i[index]; }
         int col() const { return col_; }
 
        private:
-        SparseMatrix& ptr;
-        int col_, index, max_index;
+        SparseMatrixOf& ptr;
+        int col_, index, max_index, row_ = 0;
+        const uint16_t* d = nullptr;
+
+        void decode() {
+            uint32_t delta = *d++;
+            if (delta == 65535) {
+                delta = (uint32_t)d[0] | ((uint32_t)d[1] << 16);
+                d += 2;
+            }
+            row_ += delta;
+        }
     };
 
     // equivalent to the "Forward Range" concept in two boost::ForwardTraversalIterator
@@ -70,7 +307,7 @@ class SparseMatrix {
     // `s` must be sorted in ascending order
     class InnerIteratorInRange {
        public:
-        InnerIteratorInRange(SparseMatrix& ptr, int col, std::vector<unsigned int>& s) : ptr(ptr), s(s), col_(col), index(ptr.p[col]), max_index(ptr.p[col + 1] - 1), s_max_index(s.size() - 1) {
+        InnerIteratorInRange(SparseMatrixOf& ptr, int col, std::vector<unsigned int>& s) : ptr(ptr), s(s), col_(col), index(ptr.p[col]), max_index(ptr.p[col + 1] - 1), s_max_index(s.size() - 1) {
             // decrement max_index and s_max_index to last case where ptr.i intersects with s
             while ((unsigned int)ptr.i[max_index] != s[s_max_index] && max_index >= index && s_max_index >= 0)
                 s[s_max_index] > (unsigned int)ptr.i[max_index] ? --s_max_index : --max_index;
@@ -86,47 +323,76 @@ class SparseMatrix {
                 s[s_index] < (unsigned int)ptr.i[index] ? ++s_index : ++index;
             return *this;
         }
-        const double& value() const { return ptr.x[index]; }
+        double value() const { return ptr.x[index]; }
         int row() const { return ptr.i[index]; }
         int col() const { return col_; }
 
        private:
-        SparseMatrix& ptr;
+        SparseMatrixOf& ptr;
         const std::vector<unsigned int>& s;
         int col_, index, max_index, s_max_index, s_index = 0, s_size;
     };
 
-    // const row iterator
-    class InnerRowIterator {
-       public:
-        InnerRowIterator(SparseMatrix& ptr, int j) : ptr(ptr) {
-            for (; index < ptr.Dim[1]; ++index) {
-                if (ptr.i[index] == j) break;
+    // row-major companion index of the non-zeros, giving each row the columns "j" and positions in "x" of its
+    // non-zeros, in the range [p[row], p[row + 1]) and in ascending order of column
+    //  * "built" is set once the index is complete, and may be read without a lock (see "rowIndex")
+    struct RowIndex {
+        std::vector<int> p, j, pos;
+        std::atomic<bool> built{false};
+    };
+
+    // row index, built by a counting sort over row indices on first use
+    //  * the index is cached and shared by copies of this object (like "colChunks"), and may be used from several threads
+    //  * a built index is returned without taking the lock. Otherwise it is built under the lock, by the first thread
+    //      to take it, and published by setting "built" after all of its vectors are written.
+    const RowIndex& rowIndex() {
+        RowIndex* index = row_index.get();
+        if (index->built.load(std::memory_order_acquire)) return *index;
+#ifdef _OPENMP
+#pragma omp critical(RcppML_rowIndex)
+#endif
+        {
+            if (!index->built.load(std::memory_order_relaxed)) {
+                const int n_rows = Dim[0], n_cols = Dim[1], nnz = p[n_cols];
+                index->p.assign(n_rows + 1, 0);
+                for (int it = 0; it < nnz; ++it) ++index->p[i[it] + 1];
+                for (int r = 0; r < n_rows; ++r) index->p[r + 1] += index->p[r];
+                index->j.resize(nnz);
+                index->pos.resize(nnz);
+                std::vector<int> next(index->p.begin(), index->p.end() - 1);
+                for (int c = 0; c < n_cols; ++c) {
+                    for (int it = p[c]; it < p[c + 1]; ++it) {
+                        const int k = next[i[it]]++;
+                        index->j[k] = c;
+                        index->pos[k] = it;
+                    }
+                }
+                index->built.store(true, std::memory_order_release);
             }
-            for (int r = 0; r < ptr.i.size(); ++r)
-                if (ptr.i[r] == j) max_index = r;
         }
-        operator bool() const { return index <= max_index; };
+        return *index;
+    }
+
+    // true if the row index has been built (see "rowIndex")
+    bool hasRowIndex() const { return row_index->built.load(std::memory_order_acquire); }
+
+    // const row iterator, over the row index (see "rowIndex")
+    class InnerRowIterator {
+       public:
+        InnerRowIterator(SparseMatrixOf& ptr, int row) : ptr(ptr), index_(ptr.rowIndex()), row_(row), index(index_.p[row]), max_index(index_.p[row + 1]) {}
+        operator bool() const { return index < max_index; };
         InnerRowIterator& operator++() {
             ++index;
-            for (; index <= max_index; ++index) {
-                if (ptr.i[index] == row_) break;
-            }
             return *this;
         };
-        int col() {
-            int j = 0;
-            for (; j < ptr.p.size(); ++j) {
-                if (ptr.p[j] > index) break;
-            }
-            return j;
-        };
-        int row() { return row_; }
-        double& value() const { return ptr.x[index]; };
+        int col() const { return index_.j[index]; };
+        int row() const { return row_; }
+        double value() const { return ptr.x[index_.pos[index]]; };
 
        private:
-        SparseMatrix& ptr;
-        int row_ = 0, index = 0, max_index = 0;
+        SparseMatrixOf& ptr;
+        const RowIndex& index_;
+        int row_, index, max_index;
     };
 
     // column access (copy)
@@ -144,8 +410,65 @@ class SparseMatrix {
         return res;
     }
 
+    // copy of the columns at "col_indices", in the order given
+    SparseMatrixOf submat(const Eigen::VectorXi& col_indices) {
+        IntegerVector p_(col_indices.size() + 1);
+        for (int j = 0; j < col_indices.size(); ++j)
+            p_[j + 1] = p_[j] + p[col_indices(j) + 1] - p[col_indices(j)];
+        Values x_(p_[col_indices.size()]);
+        IntegerVector i_(p_[col_indices.size()]);
+        for (int j = 0; j < col_indices.size(); ++j) {
+            for (int it = p[col_indices(j)], it_ = p_[j]; it < p[col_indices(j) + 1]; ++it, ++it_) {
+                i_[it_] = i[it];
+                copyValue(x_, it_, x, it);
+            }
+        }
+        IntegerVector Dim_ = IntegerVector::create(Dim[0], (int)col_indices.size());
+        return SparseMatrixOf(x_, i_, p_, Dim_);
+    }
+
+    // boundaries of consecutive chunks of columns with roughly equal numbers of non-zeros, for load-balanced parallel
+    // loops over columns: chunk "c" spans columns [chunks[c], chunks[c + 1])
+    //  * a chunk ends once it has as many non-zeros as "max_cols" columns of average density, or "max_cols" columns,
+    //      so very dense columns are split into chunks of their own without making chunks of sparse columns too large
+    //  * chunks are computed once for each "max_cols" and cached, so repeated loops over the same matrix (e.g. nmf
+    //      iterations) reuse them. The cache is shared by copies of this object, and may be used from several threads.
+    const std::vector<int>& colChunks(const unsigned int max_cols) {
+        std::vector<int>* chunks;
+#ifdef _OPENMP
+#pragma omp critical(RcppML_colChunks)
+#endif
+        {
+            chunks = &(*col_chunks)[max_cols];
+            if (chunks->empty()) *chunks = RcppML::chunkColumns(p.begin(), Dim[1], max_cols);
+        }
+        return *chunks;
+    }
+
+    // non-owning view of the sorted row indices of non-zeros in one column, valid as long as this object is
+    class IndexView {
+       public:
+        IndexView(const int* first, const int* last) : first(first), last(last) {}
+        const int* begin() const { return first; }
+        const int* end() const { return last; }
+        unsigned int size() const { return last - first; }
+        bool empty() const { return first == last; }
+        int operator[](const unsigned int k) const { return first[k]; }
+
+       private:
+        const int* first;
+        const int* last;
+    };
+
+    // row indices of non-zeros in a given column, without a copy (thread-safe)
+    IndexView InnerIndexView(int col) {
+        const int* i_ = i.begin();
+        return IndexView(i_ + p[col], i_ + p[col + 1]);
+    }
+
     // return indices of rows with nonzero values for a given column
     // this function is similar to Rcpp::Range, but unlike Rcpp::Range it is thread-safe
+    //  * prefer "InnerIndexView" in loops over columns, which does not allocate
     std::vector<unsigned int> InnerIndices(int col) {
         std::vector<unsigned int> v(p[col + 1] - p[col]);
         for (int j = 0, it = p[col]; it < p[col + 1]; ++j, ++it)
@@ -153,50 +476,119 @@ class SparseMatrix {
         return v;
     }
 
-    // return indices of rows with zeros values for a given column
+    // return indices of rows with zeros values for a given column, by a merge over its non-zeros
     std::vector<unsigned int> emptyInnerIndices(int col) {
-        // first get indices of non-zeros
-        std::vector<unsigned int> nonzeros = InnerIndices(col);
-        std::vector<unsigned int> all_vals(Dim[0]);
-        std::iota(all_vals.begin(), all_vals.end(), 0);
-        std::vector<unsigned int> zeros;
-        std::set_difference(all_vals.begin(), all_vals.end(), nonzeros.begin(), nonzeros.end(),
-                            std::inserter(zeros, zeros.begin()));
+        std::vector<unsigned int> zeros(Dim[0] - (p[col + 1] - p[col]));
+        int row = 0;
+        unsigned int k = 0;
+        for (const int nz : InnerIndexView(col)) {
+            for (; row < nz; ++row) zeros[k++] = row;
+            row = nz + 1;
+        }
+        for (; row < Dim[0]; ++row) zeros[k++] = row;
         return zeros;
     }
 
-    // is approximately symmetric
+    // is symmetric, if every row has the same non-zeros as the column of the same index
+    //  * all non-zeros are compared against the row index (see "rowIndex"), which is a single pass once the index is
+    //      built, and the index is then reused by "transpose"
+    //  * the result is cached and shared by copies of this object, and may be given by "setAppxSymmetric" if known
     bool isAppxSymmetric() {
-        if (Dim[0] == Dim[1]) {
-            InnerIterator col_it(*this, 0);
-            InnerRowIterator row_it(*this, 0);
-            while (++col_it && ++row_it) {
-                if (col_it.value() != row_it.value())
-                    return false;
+        if (*appx_symmetric < 0) {
+            bool symmetric = Dim[0] == Dim[1];
+            if (symmetric && Dim[0] > 0) {
+                const RowIndex& index = rowIndex();
+                for (int c = 1; c <= Dim[1] && symmetric; ++c) symmetric = index.p[c] == p[c];
+                for (int k = 0, nnz = p[Dim[1]]; k < nnz && symmetric; ++k)
+                    symmetric = index.j[k] == i[k] && x[index.pos[k]] == x[k];
             }
-            return true;
+            *appx_symmetric = symmetric;
         }
-        return false;
+        return *appx_symmetric;
     }
+    void setAppxSymmetric(const bool symmetric) { *appx_symmetric = symmetric; }
 
-    SparseMatrix clone() {
+    SparseMatrixOf clone() {
         NumericVector x_ = Rcpp::clone(x);
         IntegerVector i_ = Rcpp::clone(i);
         IntegerVector p_ = Rcpp::clone(p);
         IntegerVector Dim_ = Rcpp::clone(Dim);
-        return SparseMatrix(x_, i_, p_, Dim_);
+        return SparseMatrixOf(x_, i_, p_, Dim_);
     }
 
-    SparseMatrix transpose() {
-        S4 s(std::string("dgCMatrix"));
-        s.slot("i") = i;
-        s.slot("p") = p;
-        s.slot("x") = x;
-        s.slot("Dim") = Dim;
-        Environment base = Environment::namespace_env("Matrix");
-        Function t_r = base["t"];
-        S4 At = t_r(_["x"] = s);
-        return SparseMatrix(At);
+    // transpose by a counting sort over row indices, entirely in C++
+    //  * columns are split into contiguous chunks, one per thread, and each chunk counts and then scatters its own
+    //    non-zeros, so row indices in each column of the result remain sorted
+    //  * the number of chunks is limited so that per-chunk row counts never need more memory than the matrix itself
+    //  * if the row index has already been built (e.g. by "isAppxSymmetric"), it is the structure of the result, and
+    //    only values are gathered
+    SparseMatrixOf transpose(const unsigned int threads = 0) {
+        const int n_rows = Dim[0], n_cols = Dim[1], nnz = p[n_cols];
+        int n_chunks = 1;
+#ifdef _OPENMP
+        n_chunks = (threads == 0) ? omp_get_max_threads() : threads;
+#endif
+        if (n_rows > 0) n_chunks = std::max(1, std::min(n_chunks, nnz / n_rows));
+        n_chunks = std::max(1, std::min(n_chunks, n_cols));
+
+        if (hasRowIndex()) {
+            const RowIndex& index = rowIndex();
+            IntegerVector p_t(index.p.begin(), index.p.end()), i_t(index.j.begin(), index.j.end());
+            Values x_t(nnz);
+            const int* pos = index.pos.data();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_chunks) schedule(static)
+#endif
+            for (int k = 0; k < nnz; ++k) copyValue(x_t, k, x, pos[k]);
+            return SparseMatrixOf(x_t, i_t, p_t, IntegerVector::create(n_cols, n_rows));
+        }
+
+        // count non-zeros in each row of each chunk
+        std::vector<int> counts((size_t)n_chunks * n_rows, 0);
+        const int* A_p = &p[0];
+        const int* A_i = (nnz > 0) ? &i[0] : nullptr;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_chunks) schedule(static)
+#endif
+        for (int chunk = 0; chunk < n_chunks; ++chunk) {
+            int* c = &counts[(size_t)chunk * n_rows];
+            for (int j = (int)((int64_t)chunk * n_cols / n_chunks); j < (int)((int64_t)(chunk + 1) * n_cols / n_chunks); ++j)
+                for (int it = A_p[j]; it < A_p[j + 1]; ++it)
+                    ++c[A_i[it]];
+        }
+
+        // column pointers of the result, and per-chunk write offsets within each column
+        IntegerVector p_t(n_rows + 1);
+        p_t[0] = 0;
+        for (int r = 0; r < n_rows; ++r) {
+            int offset = p_t[r];
+            for (int chunk = 0; chunk < n_chunks; ++chunk) {
+                const int c = counts[(size_t)chunk * n_rows + r];
+                counts[(size_t)chunk * n_rows + r] = offset;
+                offset += c;
+            }
+            p_t[r + 1] = offset;
+        }
+
+        // scatter values into the result
+        Values x_t(nnz);
+        IntegerVector i_t(nnz);
+        int* T_i = (nnz > 0) ? &i_t[0] : nullptr;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_chunks) schedule(static)
+#endif
+        for (int chunk = 0; chunk < n_chunks; ++chunk) {
+            int* offset = &counts[(size_t)chunk * n_rows];
+            for (int j = (int)((int64_t)chunk * n_cols / n_chunks); j < (int)((int64_t)(chunk + 1) * n_cols / n_chunks); ++j) {
+                for (int it = A_p[j]; it < A_p[j + 1]; ++it) {
+                    const int pos = offset[A_i[it]]++;
+                    T_i[pos] = j;
+                    copyValue(x_t, pos, x, it);
+                }
+            }
+        }
+        IntegerVector Dim_t = IntegerVector::create(n_cols, n_rows);
+        return SparseMatrixOf(x_t, i_t, p_t, Dim_t);
     };
 
     S4 wrap() {
@@ -207,6 +599,24 @@ class SparseMatrix {
         s.slot("Dim") = Dim;
         return s;
     }
+
+    // bytes of the indices and values of this matrix, and of the structure cached for it so far
+    size_t bytes() const {
+        size_t n = (i.size() + p.size()) * sizeof(int) + i.size() * sizeof(Value);
+        for (const auto& chunks : *col_chunks) n += chunks.second.size() * sizeof(int);
+        if (hasRowIndex()) n += (row_index->p.size() + row_index->j.size() + row_index->pos.size()) * sizeof(int);
+        n += delta_index->q.size() * sizeof(int) + delta_index->d.size() * sizeof(uint16_t);
+        return n;
+    }
+
+   private:
+    template <typename>
+    friend class SparseMatrixOf;
+
+    std::shared_ptr<std::map<unsigned int, std::vector<int>>> col_chunks = std::make_shared<std::map<unsigned int, std::vector<int>>>();
+    std::shared_ptr<RowIndex> row_index = std::make_shared<RowIndex>();
+    std::shared_ptr<DeltaIndex> delta_index = std::make_shared<DeltaIndex>();
+    std::shared_ptr<int> appx_symmetric = std::make_shared<int>(-1);  // -1 if not yet known
 };
 
 namespace traits {
@@ -0,0 +1,182 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_ann
+#define RcppML_ann
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#ifndef RcppML_dist
+#include <RcppML/distance.hpp>
+#endif
+
+#include <array>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+// APPROXIMATE NEAREST NEIGHBORS BY A RANDOM PROJECTION FOREST
+//
+// Each tree recursively splits samples by the hyperplane through the origin that separates the directions of two
+//   random samples, "x_p / ||x_p|| - x_q / ||x_q||", until no more than "leaf_size" samples remain. Since hyperplanes
+//   pass through the origin, the side of a sample does not depend on its norm, as is needed for cosine similarity.
+//   Samples are partitioned in place, so that the leaves of each tree are ranges of one permutation of all samples.
+//
+// Nodes of all trees are stored in flat arrays that are R vectors as-is, so that an index is saved and loaded as an R
+//   object and queried without copying:
+//  * "planes": normal of the hyperplane at each internal node
+//  * "children": left and right child of each internal node, and "roots": root of each tree. Non-negative values
+//     are internal nodes, and a negative value "c" is leaf "-c - 1"
+//  * "items": samples in all leaves, where leaf "l" is the range "[leaf_start(l), leaf_start(l + 1))"
+//
+// A query visits leaves of all trees best-first by the smallest margin to any hyperplane on the path to the leaf,
+//   until at least "search_k" candidates are found, and returns the "k" candidates of greatest cosine similarity.
+namespace RcppML {
+struct annForest {
+    Eigen::MatrixXd planes;
+    Eigen::MatrixXi children;
+    Eigen::VectorXi roots, leaf_start, items;
+};
+
+// build "n_trees" trees over columns of "x" in parallel
+inline annForest annBuild(const Eigen::MatrixXd& x, const unsigned int n_trees, const unsigned int leaf_size, const uint32_t seed,
+                          const unsigned int threads) {
+    const int n = x.cols();
+    Eigen::VectorXd inv_norms = x.colwise().norm().transpose();
+    for (int i = 0; i < n; ++i) inv_norms(i) = inv_norms(i) > 0 ? 1 / inv_norms(i) : 0;
+
+    // each tree is built separately, then all are concatenated in order of trees
+    std::vector<std::vector<Eigen::VectorXd>> tree_planes(n_trees);
+    std::vector<std::vector<std::array<int, 2>>> tree_children(n_trees);
+    std::vector<std::vector<int>> tree_leaves(n_trees), tree_items(n_trees);
+    std::vector<int> tree_roots(n_trees);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (unsigned int t = 0; t < n_trees; ++t) {
+        rng<false> r(seed + t);
+        std::vector<int>& items = tree_items[t];
+        items.resize(n);
+        std::iota(items.begin(), items.end(), 0);
+        std::vector<Eigen::VectorXd>& planes = tree_planes[t];
+        std::vector<std::array<int, 2>>& children = tree_children[t];
+        std::vector<int>& leaves = tree_leaves[t];  // start of each leaf in "items"
+
+        // ranges of "items" to split, with the parent and side of the parent that refers to them (-1 for the root)
+        struct range {
+            int begin, end, parent, side;
+        };
+        std::vector<range> stack{range{0, n, -1, 0}};
+        while (!stack.empty()) {
+            const range s = stack.back();
+            stack.pop_back();
+            const int size = s.end - s.begin;
+            int& slot = s.parent < 0 ? tree_roots[t] : children[s.parent][s.side];
+            if (size <= (int)leaf_size) {
+                slot = -(int)leaves.size() - 1;
+                leaves.push_back(s.begin);
+                continue;
+            }
+            const uint32_t node = planes.size();
+            slot = node;
+            const int p = r.sample(node, 0, size);
+            int q = r.sample(node, 1, size - 1);
+            if (q >= p) ++q;
+            Eigen::VectorXd plane = x.col(items[s.begin + p]) * inv_norms(items[s.begin + p]) - x.col(items[s.begin + q]) * inv_norms(items[s.begin + q]);
+            int mid = std::partition(items.begin() + s.begin, items.begin() + s.end, [&](const int i) { return plane.dot(x.col(i)) <= 0; }) - items.begin();
+
+            // samples in the same direction cannot be separated, and are split in half
+            if (mid == s.begin || mid == s.end) {
+                plane.setZero();
+                mid = s.begin + size / 2;
+            }
+            planes.push_back(plane);
+            children.push_back({0, 0});
+            stack.push_back(range{mid, s.end, (int)node, 1});
+            stack.push_back(range{s.begin, mid, (int)node, 0});
+        }
+    }
+
+    // concatenate trees, offsetting nodes, leaves, and items by those of all previous trees
+    int n_nodes = 0, n_leaves = 0;
+    for (unsigned int t = 0; t < n_trees; ++t) {
+        n_nodes += tree_planes[t].size();
+        n_leaves += tree_leaves[t].size();
+    }
+    annForest f{Eigen::MatrixXd(x.rows(), n_nodes), Eigen::MatrixXi(2, n_nodes), Eigen::VectorXi(n_trees), Eigen::VectorXi(n_leaves + 1),
+                Eigen::VectorXi(n_trees * n)};
+    auto offset = [](const int c, const int nodes, const int leaves) { return c >= 0 ? c + nodes : c - leaves; };
+    for (unsigned int t = 0, nodes = 0, leaves = 0; t < n_trees; ++t) {
+        f.roots(t) = offset(tree_roots[t], nodes, leaves);
+        for (size_t i = 0; i < tree_planes[t].size(); ++i) {
+            f.planes.col(nodes + i) = tree_planes[t][i];
+            for (int side = 0; side < 2; ++side) f.children(side, nodes + i) = offset(tree_children[t][i][side], nodes, leaves);
+        }
+        for (size_t l = 0; l < tree_leaves[t].size(); ++l) f.leaf_start(leaves + l) = t * n + tree_leaves[t][l];
+        for (int i = 0; i < n; ++i) f.items(t * n + i) = tree_items[t][i];
+        nodes += tree_planes[t].size();
+        leaves += tree_leaves[t].size();
+    }
+    f.leaf_start(n_leaves) = n_trees * n;
+    return f;
+}
+
+// "k" most similar columns in "x" to each column in "q", as "index" and "dist" (cosine similarity) of "k x q.cols()",
+//   most similar first, where "x_sq_norms" are squared norms of columns in "x"
+template <class MatrixD, class MatrixI, class VectorI, class VectorD>
+knnResult annQuery(const MatrixD& x, const VectorD& x_sq_norms, const MatrixD& planes, const MatrixI& children, const VectorI& roots,
+                   const VectorI& leaf_start, const VectorI& items, const Eigen::MatrixXd& q, unsigned int k, unsigned int search_k,
+                   const unsigned int threads) {
+    k = std::min(k, (unsigned int)x.cols());
+    search_k = std::max(search_k, k);
+    knnResult res{Eigen::MatrixXi(k, q.cols()), Eigen::MatrixXd(k, q.cols())};
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int j = 0; j < q.cols(); ++j) {
+        const Eigen::VectorXd q_j = q.col(j);
+        const double q_sq_norm = q_j.squaredNorm();
+
+        // best-first search of all trees, by the smallest margin on the path to each node
+        std::priority_queue<std::pair<double, int>> queue;
+        for (int t = 0; t < roots.size(); ++t) queue.push(std::make_pair(std::numeric_limits<double>::infinity(), (int)roots(t)));
+        std::vector<int> candidates;
+        while (!queue.empty() && candidates.size() < search_k) {
+            const std::pair<double, int> top = queue.top();
+            queue.pop();
+            if (top.second < 0) {
+                const int leaf = -top.second - 1;
+                for (int i = leaf_start(leaf); i < leaf_start(leaf + 1); ++i) candidates.push_back(items(i));
+            } else {
+                const double margin = planes.col(top.second).dot(q_j);
+                queue.push(std::make_pair(std::min(top.first, -margin), (int)children(0, top.second)));
+                queue.push(std::make_pair(std::min(top.first, margin), (int)children(1, top.second)));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        // cosine similarity of each distinct candidate
+        std::vector<std::pair<double, int>> sims(candidates.size());
+        for (size_t c = 0; c < candidates.size(); ++c) {
+            const int i = candidates[c];
+            sims[c] = std::make_pair(distanceFromCross(x.col(i).dot(q_j), 0, x_sq_norms(i), 0, q_sq_norm, x.rows(), DIST_COSINE), i);
+        }
+        const unsigned int n_found = std::min(k, (unsigned int)sims.size());
+        std::partial_sort(sims.begin(), sims.begin() + n_found, sims.end(), std::greater<std::pair<double, int>>());
+        for (unsigned int r = 0; r < k; ++r) {
+            res.index(r, j) = r < n_found ? sims[r].second : -1;
+            res.dist(r, j) = r < n_found ? sims[r].first : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+    return res;
+}
+}  // namespace RcppML
+
+#endif
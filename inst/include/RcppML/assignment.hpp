@@ -0,0 +1,91 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_assignment
+#define RcppML_assignment
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// LINEAR ASSIGNMENT BY SHORTEST AUGMENTING PATHS
+//
+// Jonker-Volgenant style solver for the rectangular linear assignment problem, as described by Crouse (2016),
+//   "On implementing 2D rectangular assignment algorithms", IEEE Transactions on Aerospace and Electronic Systems.
+//   Each row is assigned in turn by a Dijkstra-like search for the shortest augmenting path in reduced costs, with
+//   dual variables "u" and "v" updated after each search so that reduced costs stay non-negative.
+//
+// "cost" is a flat buffer of "n_rows x n_cols" costs in which each row is contiguous, so that the search over all
+//   columns for a row reads memory in order, with "n_rows <= n_cols". Since R matrices are column-major, the transpose
+//   of an R matrix is such a buffer as-is.
+//
+// Returns the column assigned to each row, or an empty vector if no assignment has finite cost.
+namespace RcppML {
+inline std::vector<int> solveAssignment(const double* cost, const int n_rows, const int n_cols) {
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<double> u(n_rows, 0), v(n_cols, 0), path_costs(n_cols);
+    std::vector<int> path(n_cols, -1), col4row(n_rows, -1), row4col(n_cols, -1), remaining(n_cols);
+    std::vector<char> visited_rows(n_rows), visited_cols(n_cols);
+
+    for (int cur_row = 0; cur_row < n_rows; ++cur_row) {
+        // shortest augmenting path from "cur_row" to an unassigned column
+        double min_val = 0;
+        int n_remaining = n_cols;
+        for (int it = 0; it < n_cols; ++it) remaining[it] = n_cols - it - 1;
+        std::fill(visited_rows.begin(), visited_rows.end(), 0);
+        std::fill(visited_cols.begin(), visited_cols.end(), 0);
+        std::fill(path_costs.begin(), path_costs.end(), inf);
+        int sink = -1, i = cur_row;
+        while (sink == -1) {
+            visited_rows[i] = 1;
+            const double* cost_i = cost + (size_t)i * n_cols;
+            int index = -1;
+            double lowest = inf;
+            for (int it = 0; it < n_remaining; ++it) {
+                const int j = remaining[it];
+                const double r = min_val + cost_i[j] - u[i] - v[j];
+                if (r < path_costs[j]) {
+                    path[j] = i;
+                    path_costs[j] = r;
+                }
+                // prefer unassigned columns on ties, which ends the search sooner
+                if (path_costs[j] < lowest || (path_costs[j] == lowest && row4col[j] == -1)) {
+                    lowest = path_costs[j];
+                    index = it;
+                }
+            }
+            min_val = lowest;
+            if (min_val == inf) return std::vector<int>();
+            const int j = remaining[index];
+            if (row4col[j] == -1)
+                sink = j;
+            else
+                i = row4col[j];
+            visited_cols[j] = 1;
+            remaining[index] = remaining[--n_remaining];
+        }
+
+        // update dual variables
+        u[cur_row] += min_val;
+        for (int r = 0; r < n_rows; ++r)
+            if (visited_rows[r] && r != cur_row) u[r] += min_val - path_costs[col4row[r]];
+        for (int c = 0; c < n_cols; ++c)
+            if (visited_cols[c]) v[c] -= min_val - path_costs[c];
+
+        // augment the assignment along the path
+        for (int j = sink;;) {
+            const int r = path[j];
+            row4col[j] = r;
+            std::swap(col4row[r], j);
+            if (r == cur_row) break;
+        }
+    }
+    return col4row;
+}
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,101 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_async
+#define RcppML_async
+
+#ifndef RcppML_nmfSparse
+#include <RcppML/nmf.hpp>
+#endif
+
+#include <chrono>
+
+namespace RcppML {
+
+// a fit of an nmf model on a background thread, which R polls for progress, may cancel, and collects when done
+//  * "start" does everything that needs the R API on the calling thread (see "nmf::prepareThreaded"), and then runs
+//      "nmf::fit" on another thread, so the R session is free while it runs
+//  * "cancel" asks the fit to stop after its current iteration. The model of that iteration is kept, as for a fit
+//      that reached "maxit".
+//  * the fit must be waited for before the job is destroyed, which the destructor does after cancelling it
+class asyncFit {
+   public:
+    enum fitStatus { RUNNING, DONE, CANCELLED, FAILED };
+
+    virtual ~asyncFit() {}
+    unsigned int iter() const { return progress.iter; }
+    double tol() const { return progress.tol; }
+    void cancel() { progress.cancel = true; }
+
+    fitStatus status() const {
+        if (fitting.valid() && fitting.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return RUNNING;
+        if (!error.empty()) return FAILED;
+        return cancelled ? CANCELLED : DONE;
+    }
+
+    // wait for the fit to finish, and stop with its error if it failed
+    void wait() {
+        if (fitting.valid()) fitting.get();
+        if (!error.empty()) Rcpp::stop(error);
+    }
+
+    // factors of the fitted model, as "w" (factors by features), "d" and "h"; only valid after "wait"
+    virtual Eigen::MatrixXd matrixW() const = 0;
+    virtual Eigen::VectorXd vectorD() const = 0;
+    virtual Eigen::MatrixXd matrixH() const = 0;
+
+   protected:
+    fitProgress progress;
+    std::future<void> fitting;
+    std::string error;  // message of an exception thrown by the fit, which cannot call "Rcpp::stop" off the main thread
+    bool cancelled = false;  // the fit stopped on "cancel" before it converged
+
+    // stop the fit and wait for it, without the R API
+    void join() {
+        cancel();
+        if (fitting.valid()) fitting.wait();
+    }
+};
+
+// "T" is the input matrix type of "nmf", which the job owns so that it outlives the fit. A sparse "Rcpp::SparseMatrix"
+//   refers to and protects the vectors of the R object it was constructed from, rather than copying them.
+template <class T>
+class nmfJob : public asyncFit {
+   public:
+    nmfJob(const T& A_, const Eigen::MatrixXd& w_init) : A(A_), m(A, w_init) {}
+    ~nmfJob() { join(); }
+
+    // the model, to set options before "start"
+    nmf<T>& model() { return m; }
+
+    void start() {
+        m.progress = &progress;
+        m.prepareThreaded();
+        fitting = std::async(std::launch::async, [this]() {
+            try {
+                m.fit();
+                cancelled = progress.cancel && m.fit_tol() >= m.tol;
+            } catch (const std::exception& e) {
+                error = e.what();
+            } catch (...) {
+                error = "nmf fit failed";
+            }
+        });
+    }
+
+    Eigen::MatrixXd matrixW() const { return m.matrixW(); }
+    Eigen::VectorXd vectorD() const { return m.vectorD(); }
+    Eigen::MatrixXd matrixH() const { return m.matrixH(); }
+
+   private:
+    T A;
+    nmf<T> m;
+};
+
+}  // namespace RcppML
+
+#endif
@@ -12,6 +12,64 @@
 #include <RcppML/nnls.hpp>
 #endif
 
+#ifndef RcppML_threads
+#include <RcppML/threads.hpp>
+#endif
+
+// rank-2 "w" over "features" (or all features if empty), which may initialize bipartitions of any subset of the
+//   samples that it was fit to
+struct sparseW {
+    std::vector<unsigned int> features;
+    Eigen::MatrixXd w;
+};
+
+// rule by which a bipartition assigns a sample "x" to its first cluster: "h" of "x" is solved from "w" by "nnls2", scaled
+//   by "h_scale" as "h" of the samples was in the last iteration, and "v" is the difference of its factors in the order
+//   given by "first_factor" (see "bipartitionSamples")
+struct bipartitionRule {
+    sparseW w;
+    Eigen::Matrix2d a;
+    Eigen::VectorXd h_scale;
+    bool first_factor;
+};
+
+// center of a cluster, dense over all "n_rows" features, or sparse over the union of the non-zeros of its samples when
+//   that is much smaller than the number of features (see "SPARSE_CENTER_RATIO"), as in deep trees of wide data
+//  * "rows" holds the sorted features of "values" if "sparse", and "values" holds all features otherwise
+//  * a center of no features ("n_rows = 0") stands for no center
+struct clusterCenter {
+    unsigned int n_rows = 0;
+    bool sparse = false;
+    std::vector<unsigned int> rows;
+    std::vector<double> values;
+
+    double squaredNorm() const { return std::inner_product(values.begin(), values.end(), values.begin(), (double)0); }
+
+    // dot product with column "j" of "A", whose sorted rows are found in a sparse center by searching forward from the
+    //   previous row
+    double dot(Rcpp::SparseMatrix& A, const unsigned int j) const {
+        double x = 0;
+        if (!sparse) {
+            for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it) x += values[it.row()] * it.value();
+            return x;
+        }
+        std::vector<unsigned int>::const_iterator r = rows.begin();
+        for (Rcpp::SparseMatrix::InnerIterator it(A, j); it && r != rows.end(); ++it) {
+            r = std::lower_bound(r, rows.end(), (unsigned int)it.row());
+            if (r != rows.end() && *r == (unsigned int)it.row()) x += values[r - rows.begin()] * it.value();
+        }
+        return x;
+    }
+
+    // values of all "n" features, which are all zero if there is no center
+    std::vector<double> dense(const unsigned int n) const {
+        if (!sparse && n_rows == n) return values;
+        std::vector<double> x(n);
+        for (unsigned int r = 0; r < rows.size(); ++r) x[rows[r]] = values[r];
+        return x;
+    }
+};
+
 struct bipartitionModel {
     std::vector<double> v;
     double dist;
@@ -19,30 +77,94 @@ struct bipartitionModel {
     unsigned int size2;
     std::vector<unsigned int> samples1;
     std::vector<unsigned int> samples2;
-    std::vector<double> center1;
-    std::vector<double> center2;
+    clusterCenter center1;
+    clusterCenter center2;
+    sparseW w;
+    unsigned int iter;
+    bipartitionRule rule;
 };
 
-// compute cluster centroid given an ipx sparse matrix and samples in the cluster center
-inline std::vector<double> centroid(Rcpp::SparseMatrix& A, const std::vector<unsigned int>& samples) {
-    std::vector<double> center(A.rows());
-    for (unsigned int s = 0; s < samples.size(); ++s)
+// compute cluster centroid given an ipx sparse matrix and the "n" samples in the cluster at "samples"
+//  * the center is sparse if its samples have few non-zeros for the number of features, and is then found by sorting and
+//      merging the non-zeros of its samples rather than by adding them into all features
+inline clusterCenter centroid(Rcpp::SparseMatrix& A, const unsigned int* samples, const unsigned int n) {
+    clusterCenter center;
+    center.n_rows = A.rows();
+    size_t nnz = 0;
+    for (unsigned int s = 0; s < n; ++s) nnz += A.p[samples[s] + 1] - A.p[samples[s]];
+    center.sparse = (double)nnz * SPARSE_CENTER_RATIO < A.rows();
+    if (!center.sparse) {
+        center.values.resize(A.rows());
+        for (unsigned int s = 0; s < n; ++s)
+            for (Rcpp::SparseMatrix::InnerIterator it(A, samples[s]); it; ++it)
+                center.values[it.row()] += it.value();
+        for (unsigned int j = 0; j < A.rows(); ++j) center.values[j] /= n;
+        return center;
+    }
+    std::vector<std::pair<unsigned int, double>> nonzeros;
+    nonzeros.reserve(nnz);
+    for (unsigned int s = 0; s < n; ++s)
         for (Rcpp::SparseMatrix::InnerIterator it(A, samples[s]); it; ++it)
-            center[it.row()] += it.value();
-    for (unsigned int j = 0; j < A.rows(); ++j) center[j] /= samples.size();
-
+            nonzeros.push_back(std::make_pair((unsigned int)it.row(), it.value()));
+    std::sort(nonzeros.begin(), nonzeros.end(),
+              [](const std::pair<unsigned int, double>& a, const std::pair<unsigned int, double>& b) { return a.first < b.first; });
+    for (const std::pair<unsigned int, double>& x : nonzeros) {
+        if (center.rows.empty() || center.rows.back() != x.first) {
+            center.rows.push_back(x.first);
+            center.values.push_back(0);
+        }
+        center.values.back() += x.second;
+    }
+    for (double& x : center.values) x /= n;
     return center;
 }
 
+inline clusterCenter centroid(Rcpp::SparseMatrix& A, const std::vector<unsigned int>& samples) {
+    return centroid(A, samples.data(), samples.size());
+}
+
 // dense version
-inline std::vector<double> centroid(const Eigen::MatrixXd& A, const std::vector<unsigned int>& samples) {
-    std::vector<double> center(A.rows());
-    for (unsigned int s = 0; s < samples.size(); ++s)
-        for (int r = 0; r < A.rows(); ++r)
-            center[r] += A(r, samples[s]);
-    for (int j = 0; j < A.rows(); ++j) center[j] /= samples.size();
+inline clusterCenter centroid(const Eigen::Ref<const Eigen::MatrixXd>& A, const unsigned int* samples, const unsigned int n) {
+    Eigen::VectorXd center = Eigen::VectorXd::Zero(A.rows());
+    for (unsigned int s = 0; s < n; ++s) center += A.col(samples[s]);
+    center /= n;
 
-    return center;
+    clusterCenter c;
+    c.n_rows = A.rows();
+    c.values.assign(center.data(), center.data() + center.size());
+    return c;
+}
+
+inline clusterCenter centroid(const Eigen::Ref<const Eigen::MatrixXd>& A, const std::vector<unsigned int>& samples) {
+    return centroid(A, samples.data(), samples.size());
+}
+
+// centroid of the samples of a cluster that are not in a child cluster, given centroids of the cluster ("parent", with
+//   "n" samples) and of the child (with "n1" samples), without passing over the samples
+//  * a sparse parent gives a sparse complement over its own features, which include all features of the child
+inline clusterCenter complement_centroid(const clusterCenter& parent, const clusterCenter& center1, const unsigned int n,
+                                         const unsigned int n1) {
+    clusterCenter center2;
+    center2.n_rows = parent.n_rows;
+    center2.sparse = parent.sparse;
+    center2.rows = parent.rows;
+    center2.values.resize(parent.values.size());
+    if (!parent.sparse) {
+        const std::vector<double> c1 = center1.dense(parent.n_rows);
+        for (unsigned int j = 0; j < parent.values.size(); ++j) center2.values[j] = (n * parent.values[j] - n1 * c1[j]) / (n - n1);
+        return center2;
+    }
+    for (unsigned int j = 0, r = 0; j < parent.rows.size(); ++j) {
+        double c1 = 0;
+        if (center1.sparse) {
+            while (r < center1.rows.size() && center1.rows[r] < parent.rows[j]) ++r;
+            if (r < center1.rows.size() && center1.rows[r] == parent.rows[j]) c1 = center1.values[r];
+        } else {
+            c1 = center1.values[parent.rows[j]];
+        }
+        center2.values[j] = (n * parent.values[j] - n1 * c1) / (n - n1);
+    }
+    return center2;
 }
 
 // cosine distance of cells in a cluster to assigned cluster center (in_center) vs. other cluster center (out_cluster),
@@ -54,49 +176,34 @@ inline std::vector<double> centroid(const Eigen::MatrixXd& A, const std::vector<
 // cosine dist to c_j, dcj = sqrt(x cross c_j) / (sqrt(c_j cross c_j) * sqrt(x cross x))
 // tot_dist = (dci - dcj) / dci
 // this expression simplifies to 1 - (sqrt(c_j cross x) * sqrt(c_i cross c_i)) / (sqrt(c_i cross x) * sqrt(c_j cross c_j))
-inline double rel_cosine(Rcpp::SparseMatrix& A, const std::vector<unsigned int>& samples1, const std::vector<unsigned int>& samples2,
-                         const std::vector<double>& center1, const std::vector<double>& center2) {
-    double center1_innerprod = std::sqrt(std::inner_product(center1.begin(), center1.end(), center1.begin(), (double)0));
-    double center2_innerprod = std::sqrt(std::inner_product(center2.begin(), center2.end(), center2.begin(), (double)0));
+inline double rel_cosine(Rcpp::SparseMatrix& A, const unsigned int* samples1, const unsigned int n1, const unsigned int* samples2,
+                         const unsigned int n2, const clusterCenter& center1, const clusterCenter& center2) {
+    double center1_innerprod = std::sqrt(center1.squaredNorm());
+    double center2_innerprod = std::sqrt(center2.squaredNorm());
     double dist1 = 0, dist2 = 0;
-    for (unsigned int s = 0; s < samples1.size(); ++s) {
-        double x1_center1 = 0, x1_center2 = 0;
-        for (Rcpp::SparseMatrix::InnerIterator it(A, samples1[s]); it; ++it) {
-            x1_center1 += center1[it.row()] * it.value();
-            x1_center2 += center2[it.row()] * it.value();
-        }
+    for (unsigned int s = 0; s < n1; ++s) {
+        const double x1_center1 = center1.dot(A, samples1[s]), x1_center2 = center2.dot(A, samples1[s]);
         dist1 += (std::sqrt(x1_center2) * center1_innerprod) / (std::sqrt(x1_center1) * center2_innerprod);
     }
-    for (unsigned int s = 0; s < samples2.size(); ++s) {
-        double x2_center1 = 0, x2_center2 = 0;
-        for (Rcpp::SparseMatrix::InnerIterator it(A, samples2[s]); it; ++it) {
-            x2_center1 += center1[it.row()] * it.value();
-            x2_center2 += center2[it.row()] * it.value();
-        }
+    for (unsigned int s = 0; s < n2; ++s) {
+        const double x2_center1 = center1.dot(A, samples2[s]), x2_center2 = center2.dot(A, samples2[s]);
         dist2 += (std::sqrt(x2_center1) * center2_innerprod) / (std::sqrt(x2_center2) * center1_innerprod);
     }
     return (dist1 + dist2) / (2 * A.rows());
 }
 
-inline double rel_cosine(const Eigen::MatrixXd& A, const std::vector<unsigned int>& samples1, const std::vector<unsigned int>& samples2,
-                         const std::vector<double>& center1, const std::vector<double>& center2) {
-    double center1_innerprod = std::sqrt(std::inner_product(center1.begin(), center1.end(), center1.begin(), (double)0));
-    double center2_innerprod = std::sqrt(std::inner_product(center2.begin(), center2.end(), center2.begin(), (double)0));
+inline double rel_cosine(const Eigen::Ref<const Eigen::MatrixXd>& A, const unsigned int* samples1, const unsigned int n1,
+                         const unsigned int* samples2, const unsigned int n2, const clusterCenter& center1,
+                         const clusterCenter& center2) {
+    const Eigen::Map<const Eigen::VectorXd> c1(center1.values.data(), center1.values.size()), c2(center2.values.data(), center2.values.size());
+    const double center1_innerprod = c1.norm(), center2_innerprod = c2.norm();
     double dist1 = 0, dist2 = 0;
-    for (unsigned int s = 0; s < samples1.size(); ++s) {
-        double x1_center1 = 0, x1_center2 = 0;
-        for (int r = 0; r < A.rows(); ++r) {
-            x1_center1 += center1[r] * A(r, samples1[s]);
-            x1_center2 += center2[r] * A(r, samples1[s]);
-        }
+    for (unsigned int s = 0; s < n1; ++s) {
+        const double x1_center1 = c1.dot(A.col(samples1[s])), x1_center2 = c2.dot(A.col(samples1[s]));
         dist1 += (std::sqrt(x1_center2) * center1_innerprod) / (std::sqrt(x1_center1) * center2_innerprod);
     }
-    for (unsigned int s = 0; s < samples2.size(); ++s) {
-        double x2_center1 = 0, x2_center2 = 0;
-        for (int r = 0; r < A.rows(); ++r) {
-            x2_center1 += center1[r] * A(r, samples2[s]);
-            x2_center2 += center2[r] * A(r, samples2[s]);
-        }
+    for (unsigned int s = 0; s < n2; ++s) {
+        const double x2_center1 = c1.dot(A.col(samples2[s])), x2_center2 = c2.dot(A.col(samples2[s]));
         dist2 += (std::sqrt(x2_center1) * center2_innerprod) / (std::sqrt(x2_center2) * center1_innerprod);
     }
     return (dist1 + dist2) / (2 * A.rows());
@@ -110,57 +217,43 @@ void scale(Eigen::VectorXd& d, Eigen::MatrixXd& w) {
             w(i, j) /= d(i);
 }
 
-inline bipartitionModel c_bipartition_sparse(
-    Rcpp::SparseMatrix& A,
-    Eigen::MatrixXd w,
-    const std::vector<unsigned int> samples,
-    const double tol,
-    const bool nonneg,
-    const bool calc_dist,
-    const unsigned int maxit,
-    const bool verbose) {
-    // rank-2 nmf
-    Eigen::MatrixXd w_it, h(w.rows(), samples.size());
-    Eigen::VectorXd d = Eigen::VectorXd::Ones(2);
-    if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
-    double tol_ = 1;
-    for (unsigned int iter = 0; iter < maxit && tol_ > tol; ++iter) {
-        w_it = w;
+// side of each sample in the partition given by "h", and the fraction of samples that switched sides in its last update
+//  * a partition and its complement are the same bipartition, so the fraction is of the smaller of the samples that
+//      switched and those that did not, which does not depend on which factor is first (see "bipartitionSamples")
+//  * the first update switches all samples
+class partitionTracker {
+   public:
+    partitionTracker(const unsigned int n) : side(n, 2) {}
 
-        // update h
-        Eigen::Matrix2d a = w * w.transpose();
-        double denom = a(0, 0) * a(1, 1) - a(0, 1) * a(0, 1);
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            Eigen::Vector2d b(0, 0);
-            for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it) {
-                const double val = it.value();
-                const unsigned int r = it.row();
-                b(0) += val * w(0, r);
-                b(1) += val * w(1, r);
-            }
-            nnls2(a, b, denom, h, i, nonneg);
+    double update(const Eigen::MatrixXd& h) {
+        const unsigned int n = side.size();
+        unsigned int switched = 0;
+        for (unsigned int j = 0; j < n; ++j) {
+            const unsigned char s = h(0, j) > h(1, j);
+            if (side[j] != s) ++switched;
+            side[j] = s;
         }
-        scale(d, h);
-
-        // update w
-        a = h * h.transpose();
-        denom = a(0, 0) * a(1, 1) - a(0, 1) * a(0, 1);
-        w.setZero();
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it)
-                for (unsigned int j = 0; j < 2; ++j)
-                    w(j, it.row()) += it.value() * h(j, i);
+        if (first) {
+            first = false;
+            return 1;
         }
-        nnls2InPlace(a, denom, w, nonneg);
-        scale(d, w);
-
-        tol_ = cor(w, w_it);
-        if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
+        return (n == 0) ? 0 : (double)std::min(switched, n - switched) / n;
     }
 
+   private:
+    std::vector<unsigned char> side;
+    bool first = true;
+};
+
+// bipartition "n" samples at "samples" by the difference of their loadings in "h", in the factor of greater "d" minus the
+//   other, partitioning them in place and calculating centers and distance with "calc_dist" (see "c_bipartition_inplace")
+template <class MatrixA>
+inline bipartitionModel bipartitionSamples(MatrixA& A, unsigned int* samples, const unsigned int n, const Eigen::MatrixXd& h,
+                                           const Eigen::VectorXd& d, const bool calc_dist, const clusterCenter& parent_center) {
     // calculate bipartitioning vector
     unsigned int size1 = 0, size2 = 0;
-    std::vector<double> v(h.cols()), center1(w.cols()), center2(w.cols());
+    std::vector<double> v(h.cols());
+    clusterCenter center1, center2;
     if (d(0) > d(1)) {
         for (unsigned int j = 0; j < h.cols(); ++j) {
             v[j] = h(0, j) - h(1, j);
@@ -173,120 +266,449 @@ inline bipartitionModel c_bipartition_sparse(
         }
     }
 
-    std::vector<unsigned int> samples1(size1), samples2(size2);
-    double dist = -1;
-
-    // get indices of samples in both clusters
-    unsigned int s1 = 0, s2 = 0;
-    for (unsigned int j = 0; j < h.cols(); ++j) {
-        if (v[j] > 0) {
-            samples1[s1] = samples[j];
-            ++s1;
+    // partition samples in place, quicksort-style, with samples of the first cluster first
+    std::vector<double> v_ = v;
+    for (unsigned int i = 0, j = n; i < j;) {
+        if (v_[i] > 0) {
+            ++i;
         } else {
-            samples2[s2] = samples[j];
-            ++s2;
+            --j;
+            std::swap(samples[i], samples[j]);
+            std::swap(v_[i], v_[j]);
         }
     }
+    unsigned int* samples1 = samples;
+    unsigned int* samples2 = samples + size1;
+    double dist = -1;
 
     if (calc_dist) {
         // calculate the centers of both clusters
-        center1 = centroid(A, samples1);
-        center2 = centroid(A, samples2);
+        if (parent_center.n_rows != (unsigned int)A.rows() || size1 == 0 || size2 == 0) {
+            center1 = centroid(A, samples1, size1);
+            center2 = centroid(A, samples2, size2);
+        } else if (size1 < size2) {
+            center1 = centroid(A, samples1, size1);
+            center2 = complement_centroid(parent_center, center1, n, size1);
+        } else {
+            center2 = centroid(A, samples2, size2);
+            center1 = complement_centroid(parent_center, center2, n, size2);
+        }
 
         // calculate relative cosine similarity of all samples to ((assigned - other) / assigned) cluster
-        dist = rel_cosine(A, samples1, samples2, center1, center2);
+        dist = rel_cosine(A, samples1, size1, samples2, size2, center1, center2);
     }
 
-    return bipartitionModel{v, dist, size1, size2, samples1, samples2, center1, center2};
+    return bipartitionModel{v, dist, size1, size2, {}, {}, center1, center2, sparseW(), 0};
 }
 
-inline bipartitionModel c_bipartition_dense(
-    const Eigen::MatrixXd& A,
-    Eigen::MatrixXd w,
-    const std::vector<unsigned int> samples,
+// bipartition by the second singular vector of the samples "A_s", found by randomized subspace iteration (Halko,
+//   Martinsson and Tropp 2011) rather than by rank-2 alternating least squares, for bipartitions without non-negativity
+//  * a block of "w" and two random vectors drawn from "seed" is multiplied by "A_s A_s^T" and orthonormalized "iters" times, and the
+//      leading singular vectors "q1" and "q2" of "A_s" and the coordinates "c1" and "c2" of each sample on them are
+//      found from the Gram matrix of the projection of "A_s" onto the block
+//  * samples are split by the sign of "c2", which is the difference of the rank-2 "h" of each sample for
+//      "w = (q1 + q2, q1 - q2)", so that new samples are routed by the same rule as by rank-2 bipartitions
+//  * "rhs(q, y)" gives "y = q A_s" and "lhs(y, z)" gives "z = y A_s^T", over the features of "w"
+template <class MatrixA, class Rhs, class Lhs>
+inline bipartitionModel subspaceBipartition(MatrixA& A, unsigned int* samples, const unsigned int n, const Eigen::MatrixXd& w,
+                                            const unsigned int iters, const bool calc_dist, const clusterCenter& parent_center,
+                                            const unsigned int seed, Rhs rhs, Lhs lhs) {
+    const unsigned int f = w.cols();
+    auto orthonormalize = [f](Eigen::MatrixXd& q) {
+        Eigen::HouseholderQR<Eigen::MatrixXd> qr(q.transpose());
+        q = (qr.householderQ() * Eigen::MatrixXd::Identity(f, q.rows())).transpose();
+    };
+    Eigen::MatrixXd q(4, f), y, z;
+    q.topRows(2) = w;
+    q.bottomRows(2) = randomMatrix(2, f, seed);
+    orthonormalize(q);
+    for (unsigned int iter = 0; iter < iters; ++iter) {
+        rhs(q, y);
+        lhs(y, z);
+        q.swap(z);
+        orthonormalize(q);
+    }
+    rhs(q, y);
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen(y * y.transpose());
+    Eigen::MatrixXd u(4, 2);
+    u.col(0) = eigen.eigenvectors().col(3);
+    u.col(1) = eigen.eigenvectors().col(2);
+    const Eigen::MatrixXd q2 = u.transpose() * q, c = u.transpose() * y;
+    Eigen::MatrixXd w_split(2, f), h(2, n);
+    w_split.row(0) = q2.row(0) + q2.row(1);
+    w_split.row(1) = q2.row(0) - q2.row(1);
+    h.row(0) = (c.row(0) + c.row(1)) / 2;
+    h.row(1) = (c.row(0) - c.row(1)) / 2;
+
+    // the first factor is given the greater "d", so that "v" is "c2"
+    const Eigen::VectorXd d = Eigen::Vector2d(2, 1);
+    bipartitionModel m = bipartitionSamples(A, samples, n, h, d, calc_dist, parent_center);
+    m.w = sparseW{{}, w_split};
+    m.iter = iters;
+    m.rule = bipartitionRule{sparseW{{}, w_split}, gram(w_split), Eigen::VectorXd::Ones(2), true};
+    return m;
+}
+
+// "w" spans all features of "A", but the factorization spans only features with non-zeros in "samples", through a
+//   local index of each non-zero. Other features would be zero in "w" after its first update, so each split costs
+//   time in the number of non-zeros and features of its samples rather than in all features of "A".
+// With "threads", updates are parallelized over samples, and each thread accumulates its own right-hand sides of "w",
+//   unless sums must not depend on the number of threads (see "RcppML::reproducible").
+// With "calc_dist" and the centroid of "samples" in "parent_center", only the centroid of the smaller child is found from
+//   its samples, and the centroid of the larger child is derived from it (see "complement_centroid").
+// The "n" samples at "samples" are partitioned in place into the first "size1" samples of the first cluster and the
+//   remaining samples of the second cluster, and the result does not hold copies of them. Centers are only calculated
+//   with "calc_dist".
+// With "w_parent", the factorization is warm-started from the "w" of a bipartition of a superset of "samples" rather than
+//   from "w_init", e.g. from the bipartition of the parent cluster in "dclust".
+// With "switch_tol", the factorization also stops once fewer than a fraction "switch_tol" of the samples switch sides of
+//   the partition in an update of "h" (see "partitionTracker"), since only the sign of "v" is used by "dclust" and the
+//   partition often settles long before "w" converges to "tol".
+// With "subspace_iters" and without "nonneg", samples are split by "subspaceBipartition" from the same local index of
+//   non-zeros, in "subspace_iters" pairs of sparse products rather than in up to "maxit" updates, and random vectors
+//   of the subspace drawn from "seed".
+inline bipartitionModel c_bipartition_inplace(
+    Rcpp::SparseMatrix& A,
+    const Eigen::MatrixXd& w_init,
+    unsigned int* samples,
+    const unsigned int n,
     const double tol,
     const bool nonneg,
     const bool calc_dist,
     const unsigned int maxit,
-    const bool verbose) {
+    const bool verbose,
+    unsigned int threads = 1,
+    const clusterCenter& parent_center = clusterCenter(),
+    const sparseW* w_parent = nullptr,
+    const double switch_tol = 0,
+    const unsigned int subspace_iters = 0,
+    const unsigned int seed = 0) {
+#ifndef _OPENMP
+    threads = 1;
+#endif
+    // features with non-zeros in "samples", and the local index of the feature of each non-zero in order of iteration
+    std::vector<unsigned int> features, local;
+    for (unsigned int i = 0; i < n; ++i)
+        for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it)
+            features.push_back(it.row());
+    local.reserve(features.size());
+    std::sort(features.begin(), features.end());
+    features.erase(std::unique(features.begin(), features.end()), features.end());
+    std::vector<unsigned int> offsets(n + 1, 0);  // position of the first non-zero of each sample in "local"
+    for (unsigned int i = 0; i < n; ++i) {
+        for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it)
+            local.push_back(std::lower_bound(features.begin(), features.end(), (unsigned int)it.row()) - features.begin());
+        offsets[i + 1] = local.size();
+    }
+    Eigen::MatrixXd w(w_init.rows(), features.size());
+    for (unsigned int j = 0; j < features.size(); ++j) {
+        if (w_parent) {
+            const std::vector<unsigned int>& f = w_parent->features;
+            const unsigned int j_parent = std::lower_bound(f.begin(), f.end(), features[j]) - f.begin();
+            if (j_parent < f.size() && f[j_parent] == features[j]) {
+                w.col(j) = w_parent->w.col(j_parent);
+                continue;
+            }
+        }
+        w.col(j) = w_init.col(features[j]);
+    }
+
+    if (subspace_iters > 0 && !nonneg && n > 0 && !features.empty()) {
+        auto rhs = [&](const Eigen::MatrixXd& q, Eigen::MatrixXd& y) {
+            y.setZero(q.rows(), n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) if (threads > 1)
+#endif
+            for (unsigned int i = 0; i < n; ++i) {
+                unsigned int k = offsets[i];
+                for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it, ++k) y.col(i) += it.value() * q.col(local[k]);
+            }
+        };
+        auto lhs = [&](const Eigen::MatrixXd& y, Eigen::MatrixXd& z) {
+            z.setZero(y.rows(), features.size());
+            auto add_to_z = [&](const unsigned int i, Eigen::MatrixXd& z_) {
+                unsigned int k = offsets[i];
+                for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it, ++k) z_.col(local[k]) += it.value() * y.col(i);
+            };
+            if (threads > 1 && !RcppML::reproducible()) {
+                std::vector<Eigen::MatrixXd> z_threads(threads, Eigen::MatrixXd::Zero(z.rows(), z.cols()));
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+                {
+                    Eigen::MatrixXd& z_thread = z_threads[omp_get_thread_num()];
+#pragma omp for schedule(static)
+                    for (unsigned int i = 0; i < n; ++i) add_to_z(i, z_thread);
+                }
+#endif
+                for (const Eigen::MatrixXd& z_thread : z_threads) z += z_thread;
+            } else {
+                for (unsigned int i = 0; i < n; ++i) add_to_z(i, z);
+            }
+        };
+        bipartitionModel m = subspaceBipartition(A, samples, n, w, subspace_iters, calc_dist, parent_center, seed, rhs, lhs);
+        m.w.features = features;
+        m.rule.w.features = features;
+        return m;
+    }
+
     // rank-2 nmf
-    Eigen::MatrixXd w_it, h(w.rows(), samples.size());
+    Eigen::MatrixXd w_it, h = Eigen::MatrixXd::Zero(w.rows(), n);
     Eigen::VectorXd d = Eigen::VectorXd::Ones(2);
+    std::vector<Eigen::MatrixXd> w_threads(threads > 1 ? threads : 0, Eigen::MatrixXd(w.rows(), w.cols()));
+    auto add_to_w = [&](const unsigned int i, Eigen::MatrixXd& w_) {
+        unsigned int k = offsets[i];
+        for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it, ++k)
+            for (unsigned int j = 0; j < 2; ++j)
+                w_(j, local[k]) += it.value() * h(j, i);
+    };
     if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
-    double tol_ = 1;
-    for (unsigned int iter = 0; iter < maxit && tol_ > tol; ++iter) {
+    Eigen::VectorXd h_scale = Eigen::VectorXd::Ones(2);
+    double tol_ = 1, switched = 1;
+    partitionTracker partition(switch_tol > 0 ? n : 0);
+    unsigned int iter = 0;
+    for (; iter < maxit && tol_ > tol && switched >= switch_tol && !features.empty(); ++iter) {
         w_it = w;
 
-        // update h
-        Eigen::Matrix2d a = w * w.transpose();
-        double denom = a(0, 0) * a(1, 1) - a(0, 1) * a(0, 1);
+        // update h, computing all right-hand sides before solving them together
+        Eigen::Matrix2d a = gram(w);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) if (threads > 1)
+#endif
         for (unsigned int i = 0; i < h.cols(); ++i) {
-            Eigen::Vector2d b(0, 0);
-            for (int j = 0; j < A.rows(); ++j) {
-                const double val = A(j, samples[i]);
-                b(0) += val * w(0, j);
-                b(1) += val * w(1, j);
+            double h0 = 0, h1 = 0;
+            unsigned int k = offsets[i];
+            for (Rcpp::SparseMatrix::InnerIterator it(A, samples[i]); it; ++it, ++k) {
+                const double val = it.value();
+                const unsigned int r = local[k];
+                h0 += val * w(0, r);
+                h1 += val * w(1, r);
             }
-            nnls2(a, b, denom, h, i, nonneg);
+            h(0, i) = h0;
+            h(1, i) = h1;
         }
+        nnls2Batch(a, h, nonneg);
         scale(d, h);
+        h_scale = d;
+        if (switch_tol > 0) switched = partition.update(h);
 
         // update w
-        a = h * h.transpose();
-        denom = a(0, 0) * a(1, 1) - a(0, 1) * a(0, 1);
+        a = gram(h);
         w.setZero();
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            for (int j = 0; j < A.rows(); ++j)
-                for (unsigned int l = 0; l < 2; ++l)
-                    w(l, j) += A(j, samples[i]) * h(l, i);
+        if (threads > 1 && !RcppML::reproducible()) {
+            for (Eigen::MatrixXd& w_thread : w_threads) w_thread.setZero();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+            {
+                Eigen::MatrixXd& w_thread = w_threads[omp_get_thread_num()];
+#pragma omp for schedule(static)
+                for (unsigned int i = 0; i < h.cols(); ++i) add_to_w(i, w_thread);
+            }
+#endif
+            for (const Eigen::MatrixXd& w_thread : w_threads) w += w_thread;
+        } else {
+            for (unsigned int i = 0; i < h.cols(); ++i) add_to_w(i, w);
         }
-        nnls2InPlace(a, denom, w, nonneg);
+        nnls2Batch(a, w, nonneg);
         scale(d, w);
 
         tol_ = cor(w, w_it);
         if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
     }
 
-    // calculate bipartitioning vector
-    unsigned int size1 = 0, size2 = 0;
-    std::vector<double> v(h.cols()), center1(w.cols()), center2(w.cols());
-    if (d(0) > d(1)) {
-        for (unsigned int j = 0; j < h.cols(); ++j) {
-            v[j] = h(0, j) - h(1, j);
-            v[j] > 0 ? ++size1 : ++size2;
-        }
-    } else {
-        for (unsigned int j = 0; j < h.cols(); ++j) {
-            v[j] = h(1, j) - h(0, j);
-            v[j] > 0 ? ++size1 : ++size2;
-        }
+    bipartitionModel m = bipartitionSamples(A, samples, n, h, d, calc_dist, parent_center);
+    m.w = sparseW{features, w};
+    m.iter = iter;
+    if (iter > 0) m.rule = bipartitionRule{sparseW{features, w_it}, gram(w_it), h_scale, d(0) > d(1)};
+    return m;
+}
+
+// bipartition "samples" without modifying them, giving the samples of both clusters in their order in "samples", and
+//   "w" over all features
+inline bipartitionModel c_bipartition_sparse(
+    Rcpp::SparseMatrix& A,
+    const Eigen::MatrixXd& w_init,
+    const std::vector<unsigned int>& samples,
+    const double tol,
+    const bool nonneg,
+    const bool calc_dist,
+    const unsigned int maxit,
+    const bool verbose,
+    const double switch_tol = 0,
+    const unsigned int subspace_iters = 0,
+    const unsigned int seed = 0) {
+    std::vector<unsigned int> partitioned = samples;
+    bipartitionModel m = c_bipartition_inplace(A, w_init, partitioned.data(), partitioned.size(), tol, nonneg,
+                                               calc_dist, maxit, verbose, 1, clusterCenter(), nullptr, switch_tol, subspace_iters, seed);
+    for (unsigned int j = 0; j < samples.size(); ++j)
+        (m.v[j] > 0 ? m.samples1 : m.samples2).push_back(samples[j]);
+    Eigen::MatrixXd w = Eigen::MatrixXd::Zero(w_init.rows(), A.rows());
+    for (unsigned int j = 0; j < m.w.features.size(); ++j) w.col(m.w.features[j]) = m.w.w.col(j);
+    m.w = sparseW{{}, w};
+    return m;
+}
+
+// dense version, where "w" spans all features and the columns of "samples" are gathered into one block so that each
+//   update is one matrix product. With "threads", products are split over blocks of samples.
+inline bipartitionModel c_bipartition_inplace(
+    const Eigen::Ref<const Eigen::MatrixXd>& A,
+    const Eigen::MatrixXd& w_init,
+    unsigned int* samples,
+    const unsigned int n,
+    const double tol,
+    const bool nonneg,
+    const bool calc_dist,
+    const unsigned int maxit,
+    const bool verbose,
+    unsigned int threads = 1,
+    const clusterCenter& parent_center = clusterCenter(),
+    const sparseW* w_parent = nullptr,
+    const double switch_tol = 0,
+    const unsigned int subspace_iters = 0,
+    const unsigned int seed = 0) {
+#ifndef _OPENMP
+    threads = 1;
+#endif
+    // columns of "samples", gathered unless they are all columns of "A" in order
+    bool all_samples = (n == A.cols());
+    for (unsigned int i = 0; i < n && all_samples; ++i)
+        if (samples[i] != i) all_samples = false;
+    Eigen::MatrixXd A_gathered;
+    if (!all_samples) {
+        A_gathered.resize(A.rows(), n);
+        for (unsigned int i = 0; i < n; ++i) A_gathered.col(i) = A.col(samples[i]);
     }
+    const Eigen::Ref<const Eigen::MatrixXd> A_s = all_samples ? A : Eigen::Ref<const Eigen::MatrixXd>(A_gathered);
 
-    std::vector<unsigned int> samples1(size1), samples2(size2);
-    double dist = -1;
+    // rank-2 nmf
+    Eigen::MatrixXd w = w_parent ? w_parent->w : w_init;
+    Eigen::MatrixXd w_it, h = Eigen::MatrixXd::Zero(w.rows(), n);
+    Eigen::VectorXd d = Eigen::VectorXd::Ones(2);
+    const unsigned int n_blocks = std::max(1u, std::min(threads, n));
 
-    // get indices of samples in both clusters
-    unsigned int s1 = 0, s2 = 0;
-    for (unsigned int j = 0; j < h.cols(); ++j) {
-        if (v[j] > 0) {
-            samples1[s1] = samples[j];
-            ++s1;
-        } else {
-            samples2[s2] = samples[j];
-            ++s2;
+    if (subspace_iters > 0 && !nonneg && n > 0) {
+        auto rhs = [&](const Eigen::MatrixXd& q, Eigen::MatrixXd& y) {
+            y.resize(q.rows(), n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_blocks) schedule(static) if (n_blocks > 1)
+#endif
+            for (unsigned int b = 0; b < n_blocks; ++b) {
+                const unsigned int begin = (unsigned long)n * b / n_blocks, end = (unsigned long)n * (b + 1) / n_blocks;
+                y.middleCols(begin, end - begin).noalias() = q * A_s.middleCols(begin, end - begin);
+            }
+        };
+        auto lhs = [&](const Eigen::MatrixXd& y, Eigen::MatrixXd& z) {
+            std::vector<Eigen::MatrixXd> z_blocks(n_blocks);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_blocks) schedule(static) if (n_blocks > 1)
+#endif
+            for (unsigned int b = 0; b < n_blocks; ++b) {
+                const unsigned int begin = (unsigned long)n * b / n_blocks, end = (unsigned long)n * (b + 1) / n_blocks;
+                z_blocks[b].noalias() = y.middleCols(begin, end - begin) * A_s.middleCols(begin, end - begin).transpose();
+            }
+            z = z_blocks[0];
+            for (unsigned int b = 1; b < n_blocks; ++b) z += z_blocks[b];
+        };
+        return subspaceBipartition(A, samples, n, w, subspace_iters, calc_dist, parent_center, seed, rhs, lhs);
+    }
+    std::vector<Eigen::MatrixXd> w_blocks(n_blocks);
+    if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+    Eigen::VectorXd h_scale = Eigen::VectorXd::Ones(2);
+    double tol_ = 1, switched = 1;
+    partitionTracker partition(switch_tol > 0 ? n : 0);
+    unsigned int iter = 0;
+    for (; iter < maxit && tol_ > tol && switched >= switch_tol && n > 0; ++iter) {
+        w_it = w;
+
+        // update h
+        Eigen::Matrix2d a = gram(w);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_blocks) schedule(static) if (n_blocks > 1)
+#endif
+        for (unsigned int b = 0; b < n_blocks; ++b) {
+            const unsigned int begin = (unsigned long)n * b / n_blocks, end = (unsigned long)n * (b + 1) / n_blocks;
+            h.middleCols(begin, end - begin).noalias() = w * A_s.middleCols(begin, end - begin);
+        }
+        nnls2Batch(a, h, nonneg);
+        scale(d, h);
+        h_scale = d;
+        if (switch_tol > 0) switched = partition.update(h);
+
+        // update w, summing the right-hand sides of each block of samples
+        a = gram(h);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_blocks) schedule(static) if (n_blocks > 1)
+#endif
+        for (unsigned int b = 0; b < n_blocks; ++b) {
+            const unsigned int begin = (unsigned long)n * b / n_blocks, end = (unsigned long)n * (b + 1) / n_blocks;
+            w_blocks[b].noalias() = h.middleCols(begin, end - begin) * A_s.middleCols(begin, end - begin).transpose();
         }
+        w = w_blocks[0];
+        for (unsigned int b = 1; b < n_blocks; ++b) w += w_blocks[b];
+        nnls2Batch(a, w, nonneg);
+        scale(d, w);
+
+        tol_ = cor(w, w_it);
+        if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
     }
 
-    if (calc_dist) {
-        // calculate the centers of both clusters
-        center1 = centroid(A, samples1);
-        center2 = centroid(A, samples2);
+    bipartitionModel m = bipartitionSamples(A, samples, n, h, d, calc_dist, parent_center);
+    m.w = sparseW{{}, w};
+    m.iter = iter;
+    if (iter > 0) m.rule = bipartitionRule{sparseW{{}, w_it}, gram(w_it), h_scale, d(0) > d(1)};
+    return m;
+}
 
-        // calculate relative cosine similarity of all samples to ((assigned - other) / assigned) cluster
-        dist = rel_cosine(A, samples1, samples2, center1, center2);
+// bipartition "samples" without modifying them, giving the samples of both clusters in their order in "samples"
+inline bipartitionModel c_bipartition_dense(
+    const Eigen::Ref<const Eigen::MatrixXd>& A,
+    const Eigen::MatrixXd& w_init,
+    const std::vector<unsigned int>& samples,
+    const double tol,
+    const bool nonneg,
+    const bool calc_dist,
+    const unsigned int maxit,
+    const bool verbose,
+    const double switch_tol = 0,
+    const unsigned int subspace_iters = 0,
+    const unsigned int seed = 0) {
+    std::vector<unsigned int> partitioned = samples;
+    bipartitionModel m = c_bipartition_inplace(A, w_init, partitioned.data(), partitioned.size(), tol, nonneg, calc_dist,
+                                               maxit, verbose, 1, clusterCenter(), nullptr, switch_tol, subspace_iters, seed);
+    for (unsigned int j = 0; j < samples.size(); ++j)
+        (m.v[j] > 0 ? m.samples1 : m.samples2).push_back(samples[j]);
+    return m;
+}
+
+// right-hand side "wx" of the rank-2 "h" of column "j" of "A" in a bipartition rule
+inline Eigen::MatrixXd bipartitionRhs(const sparseW& w, Rcpp::SparseMatrix& A, const unsigned int j) {
+    Eigen::MatrixXd b = Eigen::MatrixXd::Zero(2, 1);
+    const std::vector<unsigned int>& f = w.features;
+    for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+        unsigned int r = it.row();
+        if (!f.empty()) {
+            r = std::lower_bound(f.begin(), f.end(), r) - f.begin();
+            if (r == f.size() || f[r] != (unsigned int)it.row()) continue;
+        }
+        b(0, 0) += w.w(0, r) * it.value();
+        b(1, 0) += w.w(1, r) * it.value();
     }
+    return b;
+}
+
+inline Eigen::MatrixXd bipartitionRhs(const sparseW& w, const Eigen::Ref<const Eigen::MatrixXd>& A, const unsigned int j) {
+    if (w.features.empty()) return w.w * A.col(j);
+    Eigen::MatrixXd b = Eigen::MatrixXd::Zero(2, 1);
+    for (unsigned int f = 0; f < w.features.size(); ++f) b += w.w.col(f) * A(w.features[f], j);
+    return b;
+}
 
-    return bipartitionModel{v, dist, size1, size2, samples1, samples2, center1, center2};
+// whether a bipartition rule assigns column "j" of "A" to its first cluster
+template <class MatrixA>
+inline bool bipartitionFirst(const bipartitionRule& rule, MatrixA& A, const unsigned int j, const bool nonneg) {
+    Eigen::MatrixXd h = bipartitionRhs(rule.w, A, j);
+    nnls2Batch(rule.a, h, nonneg);
+    const double h0 = h(0, 0) / rule.h_scale(0), h1 = h(1, 0) / rule.h_scale(1);
+    return (rule.first_factor ? h0 - h1 : h1 - h0) > 0;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_checkpoint
+#define RcppML_checkpoint
+
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <string>
+
+#define RCPPML_CHECKPOINT_MAGIC "RCPPMLC2"
+
+namespace RcppML {
+
+// state of an nmf fit, written to disk periodically so that a fit that is interrupted can be resumed from its last
+//   checkpoint (see "nmf::resume")
+//  * file layout, in native byte order: "RCPPMLC2", uint32 k, rows, cols, iter, restart, int32 best_restart, double tol,
+//      best_tol, best_mse, uint32 n_losses, n_cd_tols, n_best_losses, n_best_cd_tols, double values, target_tol, L1[2],
+//      L2[2], then double w[k * rows], d[k], h[k * cols], losses and cd_tols, and if "best_restart >= 0", w, d, h,
+//      losses and cd_tols of the best restart
+//  * "iter" is the number of iterations completed in restart "restart" of the fit
+//  * "fingerprint" holds the values of "A" (see "nmf::valuesIn") and the tolerance and penalties of the fit, so that a
+//      fit of other data or options refuses to resume from it (see "nmf::resume")
+struct checkpoint {
+    Eigen::MatrixXd w, h, w_best, h_best;
+    Eigen::VectorXd d, d_best;
+    uint32_t iter = 0, restart = 0;
+    int32_t best_restart = -1;
+    double tol = 1, best_tol = 1, best_mse = 0;
+    std::vector<double> losses, cd_tols, best_losses, best_cd_tols;
+    double fingerprint[6] = {0, 0, 0, 0, 0, 0};
+
+    // write to "path + '.tmp'" and then rename it to "path", so that a fit killed while writing leaves the last
+    //   checkpoint intact. This does not use the R API, and may be called from a worker thread.
+    bool write(const std::string& path) const {
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream f(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!f) return false;
+            const uint32_t header[5] = {(uint32_t)w.rows(), (uint32_t)w.cols(), (uint32_t)h.cols(), iter, restart};
+            const double tols[3] = {tol, best_tol, best_mse};
+            const uint32_t n[4] = {(uint32_t)losses.size(), (uint32_t)cd_tols.size(), (uint32_t)best_losses.size(),
+                                   (uint32_t)best_cd_tols.size()};
+            f.write(RCPPML_CHECKPOINT_MAGIC, 8);
+            f.write((const char*)header, sizeof(header));
+            f.write((const char*)&best_restart, sizeof(int32_t));
+            f.write((const char*)tols, sizeof(tols));
+            f.write((const char*)n, sizeof(n));
+            f.write((const char*)fingerprint, sizeof(fingerprint));
+            writeModel(f, w, d, h, losses, cd_tols);
+            if (best_restart >= 0) writeModel(f, w_best, d_best, h_best, best_losses, best_cd_tols);
+            if (!f) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // read from "path", returning false if it is not a checkpoint or could not be read
+    bool read(const std::string& path) {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        char magic[8];
+        uint32_t header[5], n[4];
+        double tols[3];
+        if (!f.read(magic, 8) || std::string(magic, 8) != RCPPML_CHECKPOINT_MAGIC) return false;
+        if (!f.read((char*)header, sizeof(header)) || !f.read((char*)&best_restart, sizeof(int32_t)) ||
+            !f.read((char*)tols, sizeof(tols)) || !f.read((char*)n, sizeof(n)) || !f.read((char*)fingerprint, sizeof(fingerprint)))
+            return false;
+        iter = header[3];
+        restart = header[4];
+        tol = tols[0];
+        best_tol = tols[1];
+        best_mse = tols[2];
+        losses.resize(n[0]);
+        cd_tols.resize(n[1]);
+        best_losses.resize(n[2]);
+        best_cd_tols.resize(n[3]);
+        if (!readModel(f, header[0], header[1], header[2], w, d, h, losses, cd_tols)) return false;
+        return best_restart < 0 || readModel(f, header[0], header[1], header[2], w_best, d_best, h_best, best_losses, best_cd_tols);
+    }
+
+   private:
+    static void writeModel(std::ofstream& f, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h,
+                           const std::vector<double>& losses, const std::vector<double>& cd_tols) {
+        f.write((const char*)w.data(), w.size() * sizeof(double));
+        f.write((const char*)d.data(), d.size() * sizeof(double));
+        f.write((const char*)h.data(), h.size() * sizeof(double));
+        f.write((const char*)losses.data(), losses.size() * sizeof(double));
+        f.write((const char*)cd_tols.data(), cd_tols.size() * sizeof(double));
+    }
+
+    // read a model into "w", "d", "h", "losses" and "cd_tols", which are already sized for the losses and tolerances
+    static bool readModel(std::ifstream& f, const uint32_t k, const uint32_t rows, const uint32_t cols, Eigen::MatrixXd& w,
+                          Eigen::VectorXd& d, Eigen::MatrixXd& h, std::vector<double>& losses, std::vector<double>& cd_tols) {
+        w.resize(k, rows);
+        d.resize(k);
+        h.resize(k, cols);
+        return f.read((char*)w.data(), w.size() * sizeof(double)) && f.read((char*)d.data(), d.size() * sizeof(double)) &&
+               f.read((char*)h.data(), h.size() * sizeof(double)) && f.read((char*)losses.data(), losses.size() * sizeof(double)) &&
+               f.read((char*)cd_tols.data(), cd_tols.size() * sizeof(double));
+    }
+};
+
+// writes checkpoints on a separate thread, so that the fit continues while each checkpoint is written
+//  * the state is copied into "state" by the fitting thread, after "wait" returns for the last checkpoint
+class checkpointWriter {
+   public:
+    checkpoint state;
+
+    // wait for the last checkpoint to be written, returning false if it could not be
+    bool wait() { return pending.valid() ? pending.get() : true; }
+
+    // write "state" to "path" on a separate thread
+    void write(const std::string& path) { pending = std::async(std::launch::async, &checkpoint::write, &state, path); }
+
+   private:
+    std::future<bool> pending;
+};
+}  // namespace RcppML
+
+#endif
@@ -16,86 +16,460 @@
 #include <RcppML/bipartition.hpp>
 #endif
 
+// a cluster holds a range of the permutation of all samples in "clusterModel", and its center only while it may be split
+//   and distances are calculated. "iter" is the number of iterations in the bipartition that gave this cluster, and
+//   "w_parent" is the "w" of that bipartition while this cluster may be split with "warm_start".
 struct cluster {
     std::string id;
-    std::vector<unsigned int> samples;
-    std::vector<double> center;
+    unsigned int begin, end;
+    clusterCenter center;
     double dist;
     bool leaf;
     bool agg;
+    unsigned int iter;
+    std::shared_ptr<const sparseW> w_parent;
+};
+
+// rule of a successful bipartition at an internal node of the "dclust" tree, where the first child has "id" + "0", and
+//   the relative cosine distance "dist" of the bipartition, if it was calculated (see "rel_cosine")
+struct splitNode {
+    std::string id;
+    bipartitionRule rule;
+    double dist;
 };
 
-std::vector<unsigned int> indices_that_are_not_leaves(std::vector<cluster>& clusters) {
-    std::vector<unsigned int> ind;
-    for (unsigned int i = 0; i < clusters.size(); ++i) {
-        if (!clusters[i].leaf) ind.push_back(i);
+// leaf of a "dclust" tree with internal "nodes" that each column of "A" from column "first" on is routed to from the root
+//  * each internal node sends a column to its first or second child by its bipartition rule ("bipartitionFirst"),
+//      which is one rank-2 "nnls2" solve over the non-zeros of the column
+//  * columns are routed in parallel
+template <class T>
+std::vector<std::string> dclustRoute(T& A, const std::vector<splitNode>& nodes, const bool nonneg, const unsigned int threads,
+                                     const unsigned int first = 0) {
+    std::map<std::string, unsigned int> node_index;
+    for (unsigned int i = 0; i < nodes.size(); ++i) node_index[nodes[i].id] = i;
+    const unsigned int n = A.cols() > first ? A.cols() - first : 0;
+    std::vector<std::string> leaves(n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (unsigned int j = 0; j < n; ++j) {
+        std::string id = "0";
+        for (auto node = node_index.find(id); node != node_index.end(); node = node_index.find(id))
+            id += bipartitionFirst(nodes[node->second].rule, A, first + j, nonneg) ? "0" : "1";
+        leaves[j] = id;
+    }
+    return leaves;
+}
+
+// dot products "d" of column "j" of "A" with all columns of "centers", and the squared norm of the column
+inline double centerDots(Rcpp::SparseMatrix& A, const unsigned int j, const Eigen::MatrixXd& centers, Eigen::VectorXd& d) {
+    d.setZero();
+    double norm = 0;
+    for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+        d += it.value() * centers.row(it.row()).transpose();
+        norm += it.value() * it.value();
+    }
+    return norm;
+}
+
+inline double centerDots(const Eigen::Ref<const Eigen::MatrixXd>& A, const unsigned int j, const Eigen::MatrixXd& centers,
+                         Eigen::VectorXd& d) {
+    d.noalias() = centers.transpose() * A.col(j);
+    return A.col(j).squaredNorm();
+}
+
+// quality of the leaves of a clustering from their centers, without distances between samples
+//  * "a" and "b" are the cosine distances of each sample to the center of its own leaf and to the nearest center of any
+//      other leaf, and "silhouette" the simplified silhouette "(b - a) / max(a, b)" (Hruschka et al. 2004)
+//  * "within" and "between" are the means of "a" and "b" over the samples of each leaf
+struct clusterQuality {
+    Eigen::VectorXd a, b, silhouette, within, between;
+};
+
+// quality of "leaves" of the columns of "A" given as 0-based samples of each leaf, with their "centers" in columns
+//  * one parallel pass over the columns, each of which is dotted with all centers over its non-zeros in O(nnz * n_leaves)
+//  * samples with no non-zeros, and centers of all zeros, are at cosine distance 1
+template <class T>
+clusterQuality dclustQuality(T& A, const std::vector<std::vector<unsigned int>>& leaves, const Eigen::MatrixXd& centers,
+                             const unsigned int threads) {
+    const unsigned int n_leaves = leaves.size();
+    std::vector<int> leaf_of(A.cols(), -1);
+    for (unsigned int l = 0; l < n_leaves; ++l)
+        for (const unsigned int s : leaves[l]) leaf_of[s] = l;
+    const Eigen::VectorXd center_norms = centers.colwise().norm().transpose();
+
+    clusterQuality q;
+    q.a = Eigen::VectorXd::Ones(A.cols());
+    q.b = Eigen::VectorXd::Ones(A.cols());
+    q.silhouette = Eigen::VectorXd::Zero(A.cols());
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads == 0 ? omp_get_max_threads() : threads)
+#endif
+    {
+        Eigen::VectorXd d(n_leaves);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+        for (unsigned int j = 0; j < A.cols(); ++j) {
+            if (leaf_of[j] < 0) continue;
+            const double norm = std::sqrt(centerDots(A, j, centers, d));
+            double b = 1;
+            for (unsigned int l = 0; l < n_leaves; ++l) {
+                const double dist = (norm > 0 && center_norms(l) > 0) ? 1 - d(l) / (norm * center_norms(l)) : 1;
+                if (l == (unsigned int)leaf_of[j])
+                    q.a(j) = dist;
+                else if (dist < b)
+                    b = dist;
+            }
+            q.b(j) = n_leaves > 1 ? b : 0;
+            const double max_ab = std::max(q.a(j), q.b(j));
+            q.silhouette(j) = (n_leaves > 1 && max_ab > 0) ? (q.b(j) - q.a(j)) / max_ab : 0;
+        }
+    }
+    q.within = Eigen::VectorXd::Zero(n_leaves);
+    q.between = Eigen::VectorXd::Zero(n_leaves);
+    for (unsigned int l = 0; l < n_leaves; ++l) {
+        for (const unsigned int s : leaves[l]) {
+            q.within(l) += q.a(s);
+            q.between(l) += q.b(s);
+        }
+        if (!leaves[l].empty()) {
+            q.within(l) /= leaves[l].size();
+            q.between(l) /= leaves[l].size();
+        }
     }
-    return ind;
+    return q;
 }
 
 namespace RcppML {
+// "T" is "Rcpp::SparseMatrix" or "Eigen::Map<Eigen::MatrixXd>"
+template <class T>
 class clusterModel {
    public:
-    Rcpp::SparseMatrix A;
+    T A;
     unsigned int min_samples;
-    double min_dist, tol;
-    bool nonneg, verbose;
+    double min_dist, tol, switch_tol;
+    bool nonneg, verbose, warm_start, keep_dist;
     unsigned int seed, maxit, threads;
+    unsigned int subspace_iters;  // without "nonneg", bipartitions by subspace iteration (see "subspaceBipartition")
 
     // constructor requiring min_samples and min_dist. All other parameters must be set individually.
-    clusterModel(Rcpp::SparseMatrix& A, const unsigned int min_samples, const double min_dist) : A(A), min_samples(min_samples), min_dist(min_dist) {
+    clusterModel(T& A, const unsigned int min_samples, const double min_dist) : A(A), min_samples(min_samples), min_dist(min_dist) {
         nonneg = true;
         verbose = true;
+        warm_start = false;
+        keep_dist = false;
         tol = 1e-4;
+        switch_tol = 0;
         seed = 0;
         maxit = 100;
         threads = 0;
-        w = randomMatrix(2, A.rows(), seed);
+        subspace_iters = 0;
         calc_dist = (min_dist > 0);
     }
 
-    std::vector<cluster> getClusters() { return clusters; }
+    const std::vector<cluster>& getClusters() { return clusters; }
+
+    // bipartition rules of internal nodes, in no particular order (see "dclustRoute")
+    const std::vector<splitNode>& getNodes() { return nodes; }
 
+    // samples of a cluster, in increasing order
+    std::vector<unsigned int> getSamples(const cluster& c) {
+        return std::vector<unsigned int>(samples.begin() + c.begin, samples.begin() + c.end);
+    }
+
+    // center of a cluster, which is calculated when requested rather than stored for each cluster, over all features or
+    //   as "clusterCenter", which may be sparse
+    std::vector<double> getCenter(const cluster& c) { return getSparseCenter(c).dense(A.rows()); }
+
+    clusterCenter getSparseCenter(const cluster& c) { return centroid(A, samples.data() + c.begin, c.end - c.begin); }
+
+    // bipartition clusters until no cluster can be split, where clusters are scheduled as they are created:
+    //  * clusters with more than a thread's share of all samples are split one at a time, using all threads in
+    //      each bipartition (see "c_bipartition_inplace")
+    //  * smaller clusters are split as independent tasks, and each task spawns tasks for its children as soon as
+    //      it completes, rather than waiting for all clusters at the same depth
+    //  * leaves are returned in order of their "id", which does not depend on the order in which they were split
+    //  * clusters are ranges of one permutation of all samples, which each split partitions in place
+    //  * with "warm_start", bipartitions of child clusters begin from the "w" of the bipartition of their parent
+    //  * with "keep_dist", the relative cosine distance of every bipartition is calculated and kept in its node even if
+    //      "min_dist" is 0
     void dclust() {
-        if (verbose) Rprintf("\n# of divisions: ");
-        std::vector<unsigned int> samples = std::vector<unsigned int>(A.cols());
+        calc_dist = min_dist > 0 || keep_dist;
+        samples = std::vector<unsigned int>(A.cols());
         std::iota(samples.begin(), samples.end(), (int)0);
-        cluster parent_cluster{"0", samples, centroid(A, samples), 0, samples.size() < min_samples * 2, false};
-        clusters.push_back(parent_cluster);  // master cluster
-        unsigned int n_splits;
-        do {  // attempt to bipartition all clusters that have not yet been determined to be leaves
+        clusterCenter center = calc_dist ? centroid(A, samples.data(), samples.size()) : clusterCenter();
+        splitAll({cluster{"0", 0, (unsigned int)A.cols(), center, 0, samples.size() < min_samples * 2, false, 0, nullptr}});
+    }
+
+    // cluster columns appended to "A" after the "n_old" columns that a previous "dclust" assigned to "leaves" (with their
+    //   samples in "leaf_samples") and internal nodes "tree"
+    //  * new columns are routed to leaves by the tree (see "dclustRoute")
+    //  * only leaves that gained columns and may now be split (at least "2 * min_samples" samples) are bipartitioned again,
+    //      as in "dclust". All other leaves and internal nodes are kept as they were, so that the cost follows the
+    //      number of new columns rather than of all columns.
+    void dclust(const std::vector<cluster>& leaves, const std::vector<std::vector<unsigned int>>& leaf_samples,
+                const std::vector<splitNode>& tree, const unsigned int n_old) {
+        if (n_old > A.cols()) Rcpp::stop("'A' has fewer columns than the samples of 'clusters'");
+        calc_dist = min_dist > 0 || keep_dist;
+        std::map<std::string, unsigned int> leaf_index;
+        for (unsigned int i = 0; i < leaves.size(); ++i) leaf_index[leaves[i].id] = i;
+        std::vector<std::vector<unsigned int>> added(leaves.size());
+        const std::vector<std::string> routed = dclustRoute(A, tree, nonneg, threads, n_old);
+        for (unsigned int j = 0; j < routed.size(); ++j) {
+            auto leaf = leaf_index.find(routed[j]);
+            if (leaf == leaf_index.end())
+                Rcpp::stop("the tree of 'clusters' routes samples to '" + routed[j] + "', which is not one of its clusters");
+            added[leaf->second].push_back(n_old + j);
+        }
+
+        nodes = tree;
+        samples.clear();
+        samples.reserve(A.cols());
+        std::vector<bool> seen(n_old, false);
+        std::vector<cluster> roots;
+        for (unsigned int i = 0; i < leaves.size(); ++i) {
+            cluster c = leaves[i];
+            c.begin = samples.size();
+            for (const unsigned int s : leaf_samples[i]) {
+                if (s >= n_old || seen[s]) Rcpp::stop("samples of 'clusters' must be the first columns of 'A', each in one cluster");
+                seen[s] = true;
+                samples.push_back(s);
+            }
+            samples.insert(samples.end(), added[i].begin(), added[i].end());
+            c.end = samples.size();
+            if (!added[i].empty() && c.end - c.begin >= min_samples * 2) {
+                c.leaf = false;
+                c.dist = 0;
+                if (calc_dist) c.center = centroid(A, samples.data() + c.begin, c.end - c.begin);
+            }
+            roots.push_back(c);
+        }
+        if (samples.size() != A.cols()) Rcpp::stop("samples of 'clusters' must be the first columns of 'A', each in one cluster");
+        splitAll(roots);
+    }
+
+    // bipartition the cluster with the most samples until there are "n_leaves" clusters or no cluster can be split,
+    //   using all threads in each bipartition, as a tree of a given number of leaves rather than of a given resolution
+    //   (see "dclustInit")
+    void dclust(const unsigned int n_leaves) {
+        calc_dist = min_dist > 0 || keep_dist;
+        samples = std::vector<unsigned int>(A.cols());
+        std::iota(samples.begin(), samples.end(), (int)0);
+        const memoryLease permutation(MEM_CLUSTERS, (double)samples.size() * sizeof(unsigned int));
+        clusterCenter center = calc_dist ? centroid(A, samples.data(), samples.size()) : clusterCenter();
+        w = randomMatrix(2, A.rows(), seed);
+        n_splits = 0;
+        n_iter = 0;
+        std::vector<cluster> open = {cluster{"0", 0, (unsigned int)A.cols(), center, 0, samples.size() < min_samples * 2, false, 0, nullptr}};
+        while (!open.empty() && clusters.size() + open.size() < n_leaves) {
             Rcpp::checkUserInterrupt();
-            n_splits = 0;
-            std::vector<unsigned int> to_split = indices_that_are_not_leaves(clusters);
-            std::vector<cluster> new_clusters(to_split.size());
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-            for (unsigned int i = 0; i < to_split.size(); ++i) {
-                bipartitionModel p = c_bipartition_sparse(A, w, clusters[to_split[i]].samples, tol, nonneg, calc_dist, maxit, false);
-                bool successful_split = (p.size1 > min_samples && p.size2 > min_samples);
-                if (calc_dist && successful_split && p.dist < min_dist) successful_split = false;
-                if (successful_split) {  // bipartition was successful
-                    new_clusters[i] = cluster{clusters[to_split[i]].id + "1", p.samples2, p.center2, 0, p.size2 < min_samples * 2, false};
-                    clusters[to_split[i]] = cluster{clusters[to_split[i]].id + "0", p.samples1, p.center1, 0, p.size1 < min_samples * 2, false};
-                    ++n_splits;
-                } else {  // bipartition was unsuccessful
-                    clusters[to_split[i]].dist = p.dist;
-                    clusters[to_split[i]].leaf = true;
-                }
+            auto largest = std::max_element(open.begin(), open.end(), [](const cluster& c1, const cluster& c2) {
+                return c1.end - c1.begin < c2.end - c2.begin;
+            });
+            cluster c = *largest, child;
+            open.erase(largest);
+            std::vector<cluster> children = {c};
+            if (!c.leaf && split(children[0], child, nThreads())) children.push_back(child);
+            for (cluster& c_ : children) {
+                if (c_.leaf)
+                    addLeaf(c_);
+                else
+                    open.push_back(c_);
             }
-            for (unsigned int i = 0; i < new_clusters.size(); ++i)
-                if (new_clusters[i].id.size() > 0) clusters.push_back(new_clusters[i]);
-            if (verbose) Rprintf(", %u", n_splits);
-        } while (n_splits > 0);
-        if (verbose) Rprintf("\n");
+        }
+        for (cluster& c : open) addLeaf(c);
+        std::sort(clusters.begin(), clusters.end(), [](const cluster& c1, const cluster& c2) { return c1.id < c2.id; });
+        if (verbose) Rprintf("\n# of divisions: %u, total iterations: %u\n", n_splits, n_iter);
     }
 
    private:
     std::vector<cluster> clusters;
+    std::vector<splitNode> nodes;
+    std::vector<unsigned int> samples;
     Eigen::MatrixXd w;
     bool calc_dist;
+    unsigned int n_splits, n_iter;
+
+    unsigned int nThreads() const {
+#ifdef _OPENMP
+        return threads == 0 ? omp_get_max_threads() : threads;
+#else
+        return 1;
+#endif
+    }
+
+    // split "roots" and their children until no cluster can be split (see "dclust")
+    void splitAll(const std::vector<cluster>& roots) {
+        const memoryLease permutation(MEM_CLUSTERS, (double)samples.size() * sizeof(unsigned int));
+        const unsigned int n_threads = nThreads();
+        w = randomMatrix(2, A.rows(), seed);
+        const unsigned int max_task_samples = n_threads > 1 ? A.cols() / n_threads : A.cols();
+        std::vector<cluster> large(roots.rbegin(), roots.rend()), small;
+        n_splits = 0;
+        n_iter = 0;
+        while (!large.empty()) {
+            Rcpp::checkUserInterrupt();
+            cluster c = large.back(), child;
+            large.pop_back();
+            std::vector<cluster> children = {c};
+            if (!c.leaf && split(children[0], child, n_threads)) children.push_back(child);
+            for (cluster& c_ : children) {
+                if (c_.leaf)
+                    addLeaf(c_);
+                else
+                    (c_.end - c_.begin > max_task_samples ? large : small).push_back(c_);
+            }
+        }
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(n_threads)
+#pragma omp single
+#endif
+        for (unsigned int i = 0; i < small.size(); ++i) split_task(small[i]);
+
+        std::sort(clusters.begin(), clusters.end(), [](const cluster& c1, const cluster& c2) { return c1.id < c2.id; });
+        if (verbose) Rprintf("\n# of divisions: %u, total iterations: %u\n", n_splits, n_iter);
+    }
+
+    // bipartition "c", which on success becomes the first child and "child" the second, or otherwise becomes a leaf
+    bool split(cluster& c, cluster& child, const unsigned int threads_) {
+        // "w" and "h" of the bipartition, with the centers of its clusters
+        const memoryLease bipartition(MEM_CLUSTERS, (4.0 * A.rows() + 2.0 * (c.end - c.begin)) * sizeof(double));
+        bipartitionModel p = c_bipartition_inplace(A, w, samples.data() + c.begin, c.end - c.begin, tol, nonneg, calc_dist, maxit,
+                                                   false, threads_, c.center, c.w_parent.get(), switch_tol, subspace_iters, seed);
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        n_iter += p.iter;
+        bool successful_split = (p.size1 > min_samples && p.size2 > min_samples);
+        if (min_dist > 0 && successful_split && p.dist < min_dist) successful_split = false;
+        if (successful_split) {
+#ifdef _OPENMP
+#pragma omp critical(dclust_nodes)
+#endif
+            nodes.push_back(splitNode{c.id, p.rule, calc_dist ? p.dist : 0});
+            std::shared_ptr<const sparseW> w_p;
+            if (warm_start) w_p = std::make_shared<const sparseW>(std::move(p.w));
+            child = cluster{c.id + "1", c.begin + p.size1, c.end, p.center2, 0, p.size2 < min_samples * 2, false, p.iter, w_p};
+            c = cluster{c.id + "0", c.begin, c.begin + p.size1, p.center1, 0, p.size1 < min_samples * 2, false, p.iter, w_p};
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+            ++n_splits;
+        } else {
+            c.dist = p.dist;
+            c.leaf = true;
+        }
+        return successful_split;
+    }
+
+    // release the center of a leaf, and sort its samples, which splits may have permuted
+    void addLeaf(cluster& c) {
+        c.center = clusterCenter();
+        c.w_parent.reset();
+        std::sort(samples.begin() + c.begin, samples.begin() + c.end);
+#ifdef _OPENMP
+#pragma omp critical(dclust_leaves)
+#endif
+        clusters.push_back(c);
+    }
+
+    // split "c" on one thread, and spawn a task for each child that may be split further
+    void split_task(cluster c) {
+#ifdef _OPENMP
+#pragma omp task firstprivate(c)
+#endif
+        {
+            cluster child;
+            std::vector<cluster> children = {c};
+            if (split(children[0], child, 1)) children.push_back(child);
+            for (cluster& c_ : children) {
+                if (c_.leaf)
+                    addLeaf(c_);
+                else
+                    split_task(c_);
+            }
+        }
+    }
+};
+
+// initial "w" ("k x A.rows()") from the centers of "k" leaves of a divisive clustering of the columns of "A", with
+//   bipartitions initialized from "seed"
+//  * the cluster with the most samples is split until there are "k" leaves (see "clusterModel::dclust"), and each
+//      bipartition stops once its partition is stable, since only the centers of the leaves are used
+//  * zeros in "w" are set to the mean of "A", as in "nndsvd"
+//  * if fewer than "k" leaves can be split, the remaining factors are drawn uniformly from [0, 2 * mean) of "A"
+template <class T>
+Eigen::MatrixXd dclustInit(T& A, const unsigned int k, const uint32_t seed, const unsigned int threads) {
+    clusterModel<T> m(A, 1, 0);
+    m.verbose = false;
+    m.seed = seed;
+    m.threads = threads;
+    m.switch_tol = 1e-3;
+    m.dclust(k);
+    const std::vector<cluster>& leaves = m.getClusters();
+    Eigen::MatrixXd w(k, A.rows());
+    double fill = 0;
+    for (unsigned int l = 0; l < leaves.size(); ++l) {
+        const std::vector<double> center = m.getCenter(leaves[l]);
+        w.row(l) = Eigen::Map<const Eigen::RowVectorXd>(center.data(), center.size());
+        fill += w.row(l).sum() * (leaves[l].end - leaves[l].begin);
+    }
+    fill /= (double)A.rows() * A.cols();
+    for (unsigned int l = leaves.size(); l < k; ++l) w.row(l) = randomMatrix(1, A.rows(), seed + l, 0, 2 * fill);
+    for (unsigned int l = 0; l < leaves.size(); ++l)
+        for (unsigned int i = 0; i < A.rows(); ++i)
+            if (w(l, i) == 0) w(l, i) = fill;
+    return w;
+}
+
+// metacells of the columns of "A" for a coarse fit, from "n_cells" leaves of a divisive clustering (as in "dclustInit")
+//  * each leaf is summed into one column and divided by the square root of its number of samples, so that a least
+//      squares fit to the metacells is a fit to the center of each leaf weighted by its size, which is the fit to all
+//      of "A" up to the variance within leaves
+//  * metacells are returned as compressed sparse columns, with the 0-based metacell of each column of "A" in "leaf"
+struct metacellResult {
+    std::vector<int> p, i;
+    std::vector<double> x;
+    std::vector<int> leaf;
 };
+
+template <class T>
+metacellResult metacells(T& A, const unsigned int n_cells, const uint32_t seed, const unsigned int threads) {
+    clusterModel<T> m(A, 1, 0);
+    m.verbose = false;
+    m.seed = seed;
+    m.threads = threads;
+    m.switch_tol = 1e-3;
+    m.dclust(n_cells);
+    const std::vector<cluster>& leaves = m.getClusters();
+    const int n_leaves = leaves.size();
+    metacellResult res;
+    res.leaf.resize(A.cols());
+    std::vector<std::vector<int>> rows(n_leaves);
+    std::vector<std::vector<double>> values(n_leaves);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int l = 0; l < n_leaves; ++l) {
+        for (unsigned int s : m.getSamples(leaves[l])) res.leaf[s] = l;
+        const clusterCenter center = m.getSparseCenter(leaves[l]);
+        const double scale = std::sqrt((double)(leaves[l].end - leaves[l].begin));
+        for (unsigned int r = 0; r < center.values.size(); ++r) {
+            if (center.values[r] == 0) continue;
+            rows[l].push_back(center.sparse ? center.rows[r] : r);
+            values[l].push_back(center.values[r] * scale);
+        }
+    }
+    res.p.resize(n_leaves + 1, 0);
+    for (int l = 0; l < n_leaves; ++l) {
+        res.p[l + 1] = res.p[l] + rows[l].size();
+        res.i.insert(res.i.end(), rows[l].begin(), rows[l].end());
+        res.x.insert(res.x.end(), values[l].begin(), values[l].end());
+    }
+    return res;
+}
 }  // namespace RcppML
 
 #endif
\ No newline at end of file
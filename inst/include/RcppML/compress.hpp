@@ -0,0 +1,79 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_compress
+#define RcppML_compress
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+// COMPRESSED NON-NEGATIVE MATRIX FACTORIZATION
+//
+// Alternating least squares on random projections of "A" (Tepper and Sapiro (2016), "Compressed nonnegative matrix
+//   factorization is fast and accurate", IEEE Transactions on Signal Processing 64(9)):
+//  * orthonormal bases "L" ("A.rows() x s") and "R" ("A.cols() x s") of the ranges of the columns and rows of "A" are
+//     found once (see "rangeFinder"), along with the projections "L^T A" ("s x A.cols()") and "(AR)^T" ("s x A.rows()")
+//  * "h" is solved from "L^T A = (L^T w^T) h", and "w" from "(AR)^T = (hR)^T w", each by "projector" with the
+//     projected factor as its "w", so that each iteration reads "O((m + n) s)" values of the projections rather than
+//     all non-zeros of "A"
+//  * rows of "h" and "w" are scaled to sum to 1 after each update, and "tol" is the correlation distance between "w"
+//     across consecutive iterations, as in "nmf"
+//
+// The solution at full resolution is refined from the returned "w" by "nmf".
+namespace RcppML {
+struct compressedResult {
+    Eigen::MatrixXd w;  // factors (rows) by features (columns)
+    double tol;
+    unsigned int iter;
+};
+
+template <class MatrixA>
+compressedResult compressedNMF(MatrixA& A, Eigen::MatrixXd w, const unsigned int sketch_size, const unsigned int power_iters,
+                               const uint32_t seed, const double tol, const unsigned int maxit, const std::vector<double>& L1,
+                               const std::vector<double>& L2, const bool verbose, unsigned int threads) {
+#ifdef _OPENMP
+    if (threads == 0) threads = omp_get_max_threads();
+#endif
+    if (threads == 0) threads = 1;
+    const unsigned int s = std::min(sketch_size, std::min((unsigned int)A.rows(), (unsigned int)A.cols()));
+    auto t_A = transposeOf(A, threads);
+    const Eigen::MatrixXd Lt = rangeFinder(A, t_A, s, power_iters, seed, threads);
+    const Eigen::MatrixXd Rt = rangeFinder(t_A, A, s, power_iters, seed + 1, threads);
+    const Eigen::MatrixXd LtA = leftMultiply(Lt, A, threads), ARt = leftMultiply(Rt, t_A, threads);
+
+    compressedResult res{w, 1, 0};
+    if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+    for (; res.iter < maxit; ++res.iter) {
+        Eigen::MatrixXd w_it = res.w;
+        Eigen::MatrixXd h = projector<double>(res.w * Lt.transpose(), L1[1], L2[1]).project(LtA, threads);
+        for (int j = 0; j < h.rows(); ++j) {
+            const double d = h.row(j).sum();
+            if (d > 0) h.row(j) /= d;
+        }
+        res.w = projector<double>(h * Rt.transpose(), L1[0], L2[0]).project(ARt, threads);
+        for (int j = 0; j < res.w.rows(); ++j) {
+            const double d = res.w.row(j).sum();
+            if (d > 0) res.w.row(j) /= d;
+        }
+        res.tol = cor(res.w, w_it);
+        if (verbose) Rprintf("%4d | %8.2e\n", res.iter + 1, res.tol);
+        if (res.tol < tol) {
+            ++res.iter;
+            break;
+        }
+        Rcpp::checkUserInterrupt();
+    }
+    return res;
+}
+}  // namespace RcppML
+
+#endif
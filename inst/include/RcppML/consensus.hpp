@@ -0,0 +1,238 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_consensus
+#define RcppML_consensus
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// CONSENSUS CLUSTERING ACROSS RESTARTS
+//
+// Each sample is assigned to the factor of greatest weight in "h" of each of "R" models, and the consensus of samples
+//   "i" and "j" is the fraction of models in which they are assigned to the same factor. Summaries of the "n x n"
+//   consensus matrix are found without storing it:
+//  * sums of the consensus and of its square over all pairs are found from the contingency tables of assignments in
+//     each pair of models, since "sum_ij C_ij^2 = 1 / R^2 sum_rs sum_ab N_rs(a, b)^2", in "O(R^2 n)" time
+//  * samples with identical assignments in all models ("groups") have a consensus of 1 with each other and identical
+//     consensus with all other samples, so they are merged at height 0 by average linkage without changing the
+//     distances between clusters. Average linkage is therefore found exactly on the "u x u" consensus of distinct
+//     groups, weighted by their sizes, by the nearest-neighbor chain algorithm in "O(u^2)" time and memory.
+//  * the cophenetic correlation is the correlation of "1 - C_ij" with the height at which "i" and "j" are merged, over
+//     all pairs. Since the height of each merge of clusters "a" and "b" is the mean distance between their samples,
+//     the sum over pairs of the product of distance and height is the sum over merges of "n_a n_b height^2", and all
+//     terms of the correlation are found from the merge heights and the sums above.
+//
+// If there are more than "max_groups" groups, average linkage is found on a random subset of "max_groups" samples
+//   chosen with "rng", and the cophenetic correlation is an estimate.
+namespace RcppML {
+struct consensusResult {
+    Eigen::MatrixXi labels;      // factor assigned to each sample (rows) in each model (columns)
+    Eigen::VectorXd item;        // mean consensus of each sample with all other samples
+    double dispersion;           // dispersion coefficient of Kim and Park (2007)
+    double cophenetic;           // cophenetic correlation of average linkage on "1 - C"
+    unsigned int n_groups;       // number of samples with distinct assignments across models
+    bool sampled;                // whether the cophenetic correlation was found on a subset of samples
+};
+
+// sums of "C_ij" and "C_ij^2" over all ordered pairs "i, j" (including "i == j") of "samples", where "labels" gives
+//   the factor assigned to each sample (columns) in each model (rows) and "k" the number of factors in each model
+inline void consensusSums(const Eigen::MatrixXi& labels, const std::vector<int>& k, const std::vector<int>& samples, double& sum,
+                          double& sq_sum, const unsigned int threads) {
+    const int n_models = labels.rows();
+    std::vector<std::pair<int, int>> model_pairs;
+    for (int r = 0; r < n_models; ++r)
+        for (int s = r; s < n_models; ++s) model_pairs.push_back(std::make_pair(r, s));
+
+    // sum of squared counts in the contingency table of each pair of models
+    std::vector<double> table_sq_sums(model_pairs.size());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (size_t p = 0; p < model_pairs.size(); ++p) {
+        const int r = model_pairs[p].first, s = model_pairs[p].second;
+        std::vector<double> table((size_t)k[r] * k[s], 0);
+        for (const int i : samples) ++table[(size_t)labels(r, i) * k[s] + labels(s, i)];
+        double sq_sum_p = 0;
+        for (const double count : table) sq_sum_p += count * count;
+        table_sq_sums[p] = sq_sum_p;
+    }
+    sum = 0;
+    sq_sum = 0;
+    for (size_t p = 0; p < model_pairs.size(); ++p) {
+        if (model_pairs[p].first == model_pairs[p].second) {
+            sum += table_sq_sums[p];
+            sq_sum += table_sq_sums[p];
+        } else
+            sq_sum += 2 * table_sq_sums[p];
+    }
+    sum /= n_models;
+    sq_sum /= (double)n_models * n_models;
+}
+
+// heights and sizes "n_a * n_b" of each merge by average linkage of "groups" with "sizes" and consensus "C_gh" given
+//   by "labels", by the nearest-neighbor chain algorithm on the condensed matrix of distances "1 - C_gh"
+inline void averageLinkage(const Eigen::MatrixXi& labels, const std::vector<int>& groups, std::vector<double> sizes,
+                           std::vector<double>& heights, std::vector<double>& weights, const unsigned int threads) {
+    const int u = groups.size(), n_models = labels.rows();
+    auto index = [u](int a, int b) {
+        if (a > b) std::swap(a, b);
+        return (size_t)a * u - (size_t)a * (a + 1) / 2 + b - a - 1;
+    };
+    std::vector<double> dist((size_t)u * (u - 1) / 2);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int a = 0; a < u; ++a) {
+        for (int b = a + 1; b < u; ++b) {
+            int agree = 0;
+            for (int r = 0; r < n_models; ++r) agree += labels(r, groups[a]) == labels(r, groups[b]);
+            dist[index(a, b)] = 1 - (double)agree / n_models;
+        }
+    }
+
+    std::vector<char> active(u, 1);
+    std::vector<int> chain;
+    for (int n_active = u; n_active > 1;) {
+        if (chain.empty())
+            for (int a = 0; a < u; ++a)
+                if (active[a]) {
+                    chain.push_back(a);
+                    break;
+                }
+        // nearest active neighbor of the end of the chain, preferring the previous cluster in the chain on ties
+        const int a = chain.back();
+        int b = chain.size() > 1 ? chain[chain.size() - 2] : -1;
+        double nearest = b >= 0 ? dist[index(a, b)] : std::numeric_limits<double>::infinity();
+        for (int c = 0; c < u; ++c) {
+            if (!active[c] || c == a) continue;
+            if (dist[index(a, c)] < nearest) {
+                nearest = dist[index(a, c)];
+                b = c;
+            }
+        }
+        if (chain.size() < 2 || b != chain[chain.size() - 2]) {
+            chain.push_back(b);
+            continue;
+        }
+
+        // merge "b" into "a" by the Lance-Williams update for average linkage
+        chain.pop_back();
+        chain.pop_back();
+        heights.push_back(nearest);
+        weights.push_back(sizes[a] * sizes[b]);
+        for (int c = 0; c < u; ++c) {
+            if (!active[c] || c == a || c == b) continue;
+            dist[index(a, c)] = (sizes[a] * dist[index(a, c)] + sizes[b] * dist[index(b, c)]) / (sizes[a] + sizes[b]);
+        }
+        sizes[a] += sizes[b];
+        active[b] = 0;
+        --n_active;
+    }
+}
+
+// sort "samples" by their assignments in all models, and return the first sample of each group of samples with
+//   identical assignments, and the size of each group
+inline void groupSamples(const Eigen::MatrixXi& labels, std::vector<int>& samples, std::vector<int>& groups, std::vector<double>& sizes) {
+    const int n_models = labels.rows();
+    auto less = [&](const int i, const int j) {
+        for (int r = 0; r < n_models; ++r)
+            if (labels(r, i) != labels(r, j)) return labels(r, i) < labels(r, j);
+        return false;
+    };
+    std::sort(samples.begin(), samples.end(), less);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (i == 0 || less(samples[i - 1], samples[i])) {
+            groups.push_back(samples[i]);
+            sizes.push_back(0);
+        }
+        ++sizes.back();
+    }
+}
+
+// cophenetic correlation of average linkage on "1 - C" over all pairs of "samples"
+inline double copheneticCorrelation(const Eigen::MatrixXi& labels, const std::vector<int>& k, std::vector<int> samples,
+                                    const unsigned int threads) {
+    const double n = samples.size();
+    if (n < 2) return std::numeric_limits<double>::quiet_NaN();
+    std::vector<int> groups;
+    std::vector<double> sizes;
+    groupSamples(labels, samples, groups, sizes);
+    std::vector<double> heights, weights;
+    averageLinkage(labels, groups, sizes, heights, weights, threads);
+
+    // sums over pairs "i < j" of distance, squared distance, cophenetic distance and squared cophenetic distance, as
+    //   means over all pairs
+    double sum, sq_sum;
+    consensusSums(labels, k, samples, sum, sq_sum, threads);
+    const double n_pairs = n * (n - 1) / 2;
+    const double c_mean = (sum - n) / 2 / n_pairs, c_sq_mean = (sq_sum - n) / 2 / n_pairs;
+    const double d_mean = 1 - c_mean, d_sq_mean = 1 - 2 * c_mean + c_sq_mean;
+    double h_mean = 0, h_sq_mean = 0;
+    for (size_t m = 0; m < heights.size(); ++m) {
+        h_mean += weights[m] * heights[m] / n_pairs;
+        h_sq_mean += weights[m] * heights[m] * heights[m] / n_pairs;
+    }
+    return (h_sq_mean - d_mean * h_mean) / std::sqrt((d_sq_mean - d_mean * d_mean) * (h_sq_mean - h_mean * h_mean));
+}
+
+// consensus of assignments of samples to factors in each of "h", where "h" are "k x n" for any "k"
+template <class Matrix>
+consensusResult consensus(const std::vector<Matrix>& h, const unsigned int max_groups, const uint32_t seed, const unsigned int threads) {
+    const int n_models = h.size(), n = n_models > 0 ? h[0].cols() : 0;
+    std::vector<int> k(n_models);
+    for (int r = 0; r < n_models; ++r) k[r] = h[r].rows();
+
+    // labels are stored with all models of a sample contiguous, so that samples are compared and grouped in order
+    Eigen::MatrixXi labels(n_models, n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int r = 0; r < n_models; ++r)
+        for (int j = 0; j < n; ++j) h[r].col(j).maxCoeff(&labels(r, j));
+
+    consensusResult res;
+    res.labels = labels.transpose();
+
+    // mean consensus of each sample with all others is the mean fraction of other samples in the same cluster
+    res.item = Eigen::VectorXd::Zero(n);
+    for (int r = 0; r < n_models; ++r) {
+        std::vector<int> cluster_sizes(k[r], 0);
+        for (int j = 0; j < n; ++j) ++cluster_sizes[labels(r, j)];
+        for (int j = 0; j < n; ++j) res.item(j) += (cluster_sizes[labels(r, j)] - 1.0) / (n - 1) / n_models;
+    }
+
+    std::vector<int> samples(n);
+    std::iota(samples.begin(), samples.end(), 0);
+    double sum, sq_sum;
+    consensusSums(labels, k, samples, sum, sq_sum, threads);
+    res.dispersion = 4 * (sq_sum - sum) / ((double)n * n) + 1;
+
+    // count distinct groups before deciding whether to sample, since many samples usually share assignments
+    std::vector<int> groups;
+    std::vector<double> sizes;
+    groupSamples(labels, samples, groups, sizes);
+    res.n_groups = groups.size();
+    res.sampled = res.n_groups > max_groups;
+    if (res.sampled) {
+        // partial Fisher-Yates shuffle for a random subset of "max_groups" samples
+        rng<false> r(seed);
+        for (unsigned int i = 0; i < max_groups; ++i) std::swap(samples[i], samples[i + r.sample(i, 0, (uint32_t)(n - i))]);
+        samples.resize(max_groups);
+    }
+    res.cophenetic = copheneticCorrelation(labels, k, samples, threads);
+    return res;
+}
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,125 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_core
+#define RcppML_core
+
+// compile the compute core without R (see "RcppMLCommon.hpp")
+#ifndef RCPPML_NO_R
+#define RCPPML_NO_R 0
+#endif
+
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace RcppML {
+
+// errors and messages of the compute core
+//  * in the package, errors are R errors (through "Rcpp::stop") and messages are written to the R console
+//  * with "-DRCPPML_NO_R=1", errors are thrown as "std::runtime_error" and messages are written to stderr
+[[noreturn]] inline void fail(const std::string& msg) {
+#if RCPPML_NO_R
+    throw std::runtime_error(msg);
+#else
+    Rcpp::stop(msg);
+#endif
+}
+
+inline void message(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+#if RCPPML_NO_R
+    std::vfprintf(stderr, format, args);
+#else
+    Rvprintf(format, args);
+#endif
+    va_end(args);
+}
+
+// boundaries of consecutive chunks of columns with roughly equal numbers of non-zeros, given column pointers "p" of a
+//   compressed sparse column matrix (see "Rcpp::SparseMatrixOf::colChunks")
+inline std::vector<int> chunkColumns(const int* p, const int n_cols, const unsigned int max_cols) {
+    std::vector<int> chunks(1, 0);
+    const double max_nnz = (n_cols > 0) ? (double)max_cols * p[n_cols] / n_cols : 0;
+    unsigned int chunk_cols = 0;
+    for (int j = 0; j < n_cols; ++j) {
+        ++chunk_cols;
+        if (chunk_cols == max_cols || p[j + 1] - p[chunks.back()] >= max_nnz) {
+            chunks.push_back(j + 1);
+            chunk_cols = 0;
+        }
+    }
+    if (chunks.back() != n_cols) chunks.push_back(n_cols);
+    return chunks;
+}
+
+// non-owning view of a compressed sparse column matrix in memory owned by the caller (e.g. an Eigen::SparseMatrix, a
+//   scipy.sparse.csc_matrix, or arrays read from disk), which the compute core reads in place of "Rcpp::SparseMatrix"
+//   when compiled without R
+//  * "p" has "n_cols + 1" column pointers and "i" has sorted row indices of the non-zeros in each column
+//  * a null "x" is a pattern matrix, whose values are all 1
+//  * the interface is the subset of "Rcpp::SparseMatrixOf" used by projections (see "projector" and "predict")
+template <typename Value = double>
+class CscView {
+   public:
+    const int* p;
+    const int* i;
+    const Value* x;
+
+    CscView(const int n_rows, const int n_cols, const int* p, const int* i, const Value* x = nullptr)
+        : p(p), i(i), x(x), n_rows(n_rows), n_cols(n_cols) {}
+
+    unsigned int rows() const { return n_rows; }
+    unsigned int cols() const { return n_cols; }
+
+    class InnerIterator {
+       public:
+        InnerIterator(const CscView& ptr, int col) : ptr(ptr), col_(col), index(ptr.p[col]), max_index(ptr.p[col + 1]) {}
+        operator bool() const { return index < max_index; }
+        InnerIterator& operator++() {
+            ++index;
+            return *this;
+        }
+        double value() const { return ptr.x ? (double)ptr.x[index] : 1; }
+        int row() const { return ptr.i[index]; }
+        int col() const { return col_; }
+
+       private:
+        const CscView& ptr;
+        int col_, index, max_index;
+    };
+
+    // chunks of columns for load-balanced parallel loops, cached for each "max_cols" and shared by copies of this view
+    const std::vector<int>& colChunks(const unsigned int max_cols) {
+        std::vector<int>* chunks;
+#ifdef _OPENMP
+#pragma omp critical(RcppML_colChunks)
+#endif
+        {
+            chunks = &(*col_chunks)[max_cols];
+            if (chunks->empty()) *chunks = chunkColumns(p, n_cols, max_cols);
+        }
+        return *chunks;
+    }
+
+   private:
+    int n_rows, n_cols;
+    std::shared_ptr<std::map<unsigned int, std::vector<int>>> col_chunks = std::make_shared<std::map<unsigned int, std::vector<int>>>();
+};
+
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,117 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_dedup
+#define RcppML_dedup
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+// IDENTICAL COLUMNS OF SPARSE MATRICES
+//
+// Count matrices often hold many identical columns (e.g. near-empty droplets or duplicated barcodes), each of which
+//   "predict" would solve and "nmf" would accumulate into updates of "w" separately. Identical columns are found so
+//   that each is solved once, and "h" of its group expanded afterwards, or weighted by its multiplicity in a fit (see
+//   "nmf::fit_weighted"):
+//  * each column is hashed from its row indices and values, in parallel over columns
+//  * columns are sorted by hash, and columns of equal hash are compared in full, so that a collision never merges
+//      columns that differ. Values are compared exactly, so columns with NaN values are never merged.
+//  * the first column of each group represents it, and groups are numbered in order of their representatives
+namespace RcppML {
+
+struct columnGroups {
+    std::vector<int> unique;  // representative column of each group, in increasing order
+    std::vector<int> group;   // group of each column
+    std::vector<int> counts;  // number of columns in each group
+};
+
+// the finalizer of splitmix64
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+template <typename Value>
+uint64_t hashColumn(SparseOf<Value>& A, const int j) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (typename SparseOf<Value>::InnerIterator it(A, j); it; ++it) {
+        const double value = it.value();
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(double));
+        h = mix64(h ^ (uint64_t)it.row());
+        h = mix64(h ^ bits);
+    }
+    return h;
+}
+
+template <typename Value>
+bool equalColumns(SparseOf<Value>& A, const int j1, const int j2) {
+    typename SparseOf<Value>::InnerIterator it1(A, j1), it2(A, j2);
+    for (; it1 && it2; ++it1, ++it2)
+        if (it1.row() != it2.row() || (double)it1.value() != (double)it2.value()) return false;
+    return !it1 && !it2;
+}
+
+template <typename Value>
+columnGroups findColumnGroups(SparseOf<Value>& A, const unsigned int threads) {
+    const int n = A.cols();
+    std::vector<uint64_t> hashes(n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic, 256)
+#endif
+    for (int j = 0; j < n; ++j) hashes[j] = hashColumn(A, j);
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const int a, const int b) { return hashes[a] < hashes[b] || (hashes[a] == hashes[b] && a < b); });
+
+    // representative of each column, from the representatives of its run of equal hashes
+    std::vector<int> rep(n);
+    std::vector<int> reps;
+    for (int start = 0; start < n;) {
+        int end = start + 1;
+        while (end < n && hashes[order[end]] == hashes[order[start]]) ++end;
+        reps.clear();
+        for (int s = start; s < end; ++s) {
+            const int j = order[s];
+            rep[j] = j;
+            for (const int r : reps) {
+                if (equalColumns(A, r, j)) {
+                    rep[j] = r;
+                    break;
+                }
+            }
+            if (rep[j] == j) reps.push_back(j);
+        }
+        start = end;
+    }
+
+    columnGroups g;
+    g.group.resize(n);
+    for (int j = 0; j < n; ++j) {
+        if (rep[j] == j) {
+            g.group[j] = g.unique.size();
+            g.unique.push_back(j);
+            g.counts.push_back(0);
+        } else {
+            g.group[j] = g.group[rep[j]];
+        }
+        ++g.counts[g.group[j]];
+    }
+    return g;
+}
+
+}  // namespace RcppML
+
+#endif
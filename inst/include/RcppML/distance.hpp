@@ -12,105 +12,378 @@
 #include <RcppMLCommon.h>
 #endif
 
-// sparse/dense column-wise distance calculation between two matrices
-Eigen::MatrixXd distance(Rcpp::SparseMatrix& A, Eigen::MatrixXd& B, std::string method, const unsigned int threads) {
-    Eigen::MatrixXd dists(A.cols(), B.cols());
-    if (method == "euclidean") {
-#pragma omp parallel for num_threads(threads)
-        for (unsigned int i = 0; i < B.cols(); ++i) {
-            for (unsigned int j = 0; j < A.cols(); ++j) {
-                double dist = B.col(i).array().square().sum();
-                for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it)
-                    dist += std::pow(B(it.row(), i) - it.value(), 2) - std::pow(B(it.row(), i), 2);
-                dists(j, i) = dist;
+#ifndef RcppML_profile
+#include <RcppML/profile.hpp>
+#endif
+
+#include <fstream>
+#include <numeric>
+
+// all methods are computed from cross-products of columns, a'b, and column sums and squared norms computed once:
+//  * "euclidean": squared euclidean distance, ||a||^2 + ||b||^2 - 2 * a'b
+//  * "cosine":    cosine similarity, a'b / (||a|| * ||b||)
+//  * "cor":       Pearson correlation, the cosine similarity of centered columns
+//  * "inner":     inner product, a'b
+// cross-products are computed by tiles of the output, so that each tile is one sparse-dense or dense-dense product
+enum distanceMethod { DIST_EUCLIDEAN, DIST_COSINE, DIST_COR, DIST_INNER };
+
+inline distanceMethod getDistanceMethod(const std::string& method) {
+    if (method == "euclidean") return DIST_EUCLIDEAN;
+    if (method == "cosine") return DIST_COSINE;
+    if (method == "cor") return DIST_COR;
+    if (method == "inner") return DIST_INNER;
+    Rcpp::stop("'method' must be one of \"euclidean\", \"cosine\", \"cor\", or \"inner\"");
+}
+
+// column sums and squared euclidean norms
+struct colStats {
+    Eigen::VectorXd sums, sq_norms;
+};
+
+inline colStats columnStats(Rcpp::SparseMatrix& A) {
+    colStats s{Eigen::VectorXd::Zero(A.cols()), Eigen::VectorXd::Zero(A.cols())};
+    for (unsigned int col = 0; col < A.cols(); ++col) {
+        for (Rcpp::SparseMatrix::InnerIterator it(A, col); it; ++it) {
+            s.sums(col) += it.value();
+            s.sq_norms(col) += it.value() * it.value();
+        }
+    }
+    return s;
+}
+
+inline colStats columnStats(const Eigen::Ref<const Eigen::MatrixXd>& A) {
+    return colStats{A.colwise().sum().transpose(), A.colwise().squaredNorm().transpose()};
+}
+
+// distance from the cross-product of two columns and their statistics
+inline double distanceFromCross(const double cross, const double sum_a, const double sq_a, const double sum_b, const double sq_b,
+                                const unsigned int n, const distanceMethod method) {
+    switch (method) {
+        case DIST_EUCLIDEAN:
+            return std::max(sq_a + sq_b - 2 * cross, 0.0);
+        case DIST_COSINE: {
+            const double denom = std::sqrt(sq_a * sq_b);
+            return denom > 0 ? cross / denom : 0;
+        }
+        case DIST_COR: {
+            const double denom = std::sqrt(std::max(sq_a - sum_a * sum_a / n, 0.0) * std::max(sq_b - sum_b * sum_b / n, 0.0));
+            return denom > 0 ? (cross - sum_a * sum_b / n) / denom : 0;
+        }
+        default:
+            return cross;
+    }
+}
+
+// distances between all columns in "A" and "B" given a function returning cross-products for a tile of columns in
+//   each, "cross_tile(a_start, a_cols, b_start, b_cols)", as a matrix of "b_cols x a_cols". If "symmetric", "A" and "B"
+//   are the same matrix, and only tiles on or above the diagonal are computed.
+template <class CrossTile>
+Eigen::MatrixXd tiledDistance(const colStats& a, const colStats& b, const unsigned int n, const distanceMethod method, const bool symmetric,
+                              const unsigned int threads, const CrossTile& cross_tile) {
+    const int a_n = a.sums.size(), b_n = b.sums.size();
+    const RcppML::memoryLease dists_bytes(RcppML::MEM_DISTANCE, (double)a_n * b_n * sizeof(double));
+    Eigen::MatrixXd dists(a_n, b_n);
+    const int a_tiles = (a_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    const int b_tiles = (b_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int tile = 0; tile < a_tiles * b_tiles; ++tile) {
+        const int a_tile = tile / b_tiles, b_tile = tile % b_tiles;
+        if (symmetric && b_tile < a_tile) continue;
+        const int a_start = a_tile * PREDICT_TILE_SIZE, b_start = b_tile * PREDICT_TILE_SIZE;
+        const int a_cols = std::min((int)PREDICT_TILE_SIZE, a_n - a_start);
+        const int b_cols = std::min((int)PREDICT_TILE_SIZE, b_n - b_start);
+        const RcppML::memoryLease tile_bytes(RcppML::MEM_WORKSPACE, (double)a_cols * b_cols * sizeof(double));
+        const Eigen::MatrixXd cross = cross_tile(a_start, a_cols, b_start, b_cols);
+        for (int i = 0; i < b_cols; ++i) {
+            const int b_col = b_start + i;
+            for (int j = 0; j < a_cols; ++j) {
+                const int a_col = a_start + j;
+                dists(a_col, b_col) = distanceFromCross(cross(i, j), a.sums(a_col), a.sq_norms(a_col), b.sums(b_col), b.sq_norms(b_col), n, method);
+                if (symmetric) dists(b_col, a_col) = dists(a_col, b_col);
             }
         }
     }
     return dists;
 }
 
-// sparse/sparse column-wise distance calculation between two matrices
-Eigen::MatrixXd distance(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& B, std::string method, const unsigned int threads) {
-    Eigen::MatrixXd dists(A.cols(), B.cols());
-    if (method == "euclidean") {
-#pragma omp parallel for num_threads(threads)
-        for (unsigned int i = 0; i < B.cols(); ++i) {
-            for (unsigned int j = 0; j < A.cols(); ++j) {
-                double dist = 0;
-                for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it)
-                    dist += it.value() * it.value();
-                for (Rcpp::SparseMatrix::InnerIterator it(B, j); it; ++it)
-                    dist += it.value() * it.value();
-                Rcpp::SparseMatrix::InnerIterator it_A(A, j), it_B(B, i);
-                while (it_A && it_B) {
-                    if (it_A.row() < it_B.row())
-                        ++it_A;
-                    else if (it_A.row() > it_B.row())
-                        ++it_B;
-                    else {
-                        dist -= it_A.value() * it_A.value();
-                        dist -= it_B.value() * it_B.value();
-                        dist += std::pow(it_A.value() - it_B.value(), 2);
-                        ++it_A;
-                        ++it_B;
+// nearest columns in "B" to each column in "A", as "index" and "dist" of "k x A.cols()", nearest first. Distances are
+//   computed by the same tiles as "tiledDistance", but each thread computes all tiles for a tile of columns in "A" and
+//   streams them through one bounded heap per column, so that no more than "k" neighbors per column are ever stored.
+//   For similarity methods ("cosine", "cor", "inner"), "dist" holds the similarity and nearest columns are the most
+//   similar. If "symmetric", each column is not its own neighbor.
+struct knnResult {
+    Eigen::MatrixXi index;
+    Eigen::MatrixXd dist;
+};
+
+template <class CrossTile>
+knnResult tiledKnn(const colStats& a, const colStats& b, const unsigned int n, const distanceMethod method, unsigned int k, const bool symmetric,
+                   const unsigned int threads, const CrossTile& cross_tile) {
+    const int a_n = a.sums.size(), b_n = b.sums.size();
+    k = std::min((int)k, std::max(b_n - (int)symmetric, 0));
+    knnResult res{Eigen::MatrixXi(k, a_n), Eigen::MatrixXd(k, a_n)};
+    const bool similarity = method != DIST_EUCLIDEAN;
+    const int a_tiles = (a_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    const int b_tiles = (b_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    typedef std::pair<double, int> neighbor;  // (score, column in "B"), where greater scores are nearer
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int a_tile = 0; a_tile < a_tiles; ++a_tile) {
+        const int a_start = a_tile * PREDICT_TILE_SIZE, a_cols = std::min((int)PREDICT_TILE_SIZE, a_n - a_start);
+
+        // min-heaps of the "k" nearest neighbors found so far, so that the farthest is at the front
+        std::vector<std::vector<neighbor>> heaps(a_cols);
+        for (auto& heap : heaps) heap.reserve(k);
+        for (int b_tile = 0; b_tile < b_tiles; ++b_tile) {
+            const int b_start = b_tile * PREDICT_TILE_SIZE, b_cols = std::min((int)PREDICT_TILE_SIZE, b_n - b_start);
+            const Eigen::MatrixXd cross = cross_tile(a_start, a_cols, b_start, b_cols);
+            for (int j = 0; j < a_cols; ++j) {
+                const int a_col = a_start + j;
+                std::vector<neighbor>& heap = heaps[j];
+                for (int i = 0; i < b_cols; ++i) {
+                    const int b_col = b_start + i;
+                    if (symmetric && a_col == b_col) continue;
+                    double score = distanceFromCross(cross(i, j), a.sums(a_col), a.sq_norms(a_col), b.sums(b_col), b.sq_norms(b_col), n, method);
+                    if (!similarity) score = -score;
+                    if (heap.size() < k) {
+                        heap.push_back(neighbor(score, b_col));
+                        std::push_heap(heap.begin(), heap.end(), std::greater<neighbor>());
+                    } else if (k > 0 && score > heap.front().first) {
+                        std::pop_heap(heap.begin(), heap.end(), std::greater<neighbor>());
+                        heap.back() = neighbor(score, b_col);
+                        std::push_heap(heap.begin(), heap.end(), std::greater<neighbor>());
                     }
                 }
-                dists(j, i) = std::sqrt(dist);
+            }
+        }
+        for (int j = 0; j < a_cols; ++j) {
+            std::sort_heap(heaps[j].begin(), heaps[j].end(), std::greater<neighbor>());
+            for (unsigned int r = 0; r < k; ++r) {
+                res.index(r, a_start + j) = heaps[j][r].second;
+                res.dist(r, a_start + j) = similarity ? heaps[j][r].first : -heaps[j][r].first;
             }
         }
     }
-    return dists;
+    return res;
 }
 
-// dense/dense column-wise distance calculation between two matrices
-inline Eigen::MatrixXd distance(const Eigen::MatrixXd& A, const Eigen::MatrixXd& B, const std::string method, const unsigned int threads) {
-    Eigen::MatrixXd dists(A.cols(), B.cols());
-    if (method == "euclidean") {
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-        for (unsigned int i = 0; i < B.cols(); ++i) {
-            for (unsigned int j = 0; j < A.cols(); ++j) {
-                dists(j, i) = (A.col(j) - B.col(i)).array().square().sum();
+// cross-products of a tile of sparse columns with a tile of columns given by rows of "Bt", the transpose of "B", in
+//   which the values of all columns of a tile for one feature are contiguous
+template <class MatrixBt>
+Eigen::MatrixXd sparseCrossTile(Rcpp::SparseMatrix& A, const MatrixBt& Bt, const int a_start, const int a_cols, const int b_start, const int b_cols) {
+    Eigen::MatrixXd cross = Eigen::MatrixXd::Zero(b_cols, a_cols);
+    for (int j = 0; j < a_cols; ++j)
+        for (Rcpp::SparseMatrix::InnerIterator it(A, a_start + j); it; ++it)
+            cross.col(j) += it.value() * Bt.col(it.row()).segment(b_start, b_cols);
+    return cross;
+}
+
+// tiles of cross-products for sparse "A" and dense "B"
+struct sparseDenseCross {
+    Rcpp::SparseMatrix& A;
+    const Eigen::MatrixXd Bt;
+    Eigen::MatrixXd operator()(const int a_start, const int a_cols, const int b_start, const int b_cols) const {
+        return sparseCrossTile(A, Bt, a_start, a_cols, b_start, b_cols);
+    }
+};
+
+// tiles of cross-products for sparse "A" and "B" from an inverted index of "B", giving for each row the columns of "B"
+//   with a non-zero in that row and their values, in increasing order of columns. Each non-zero in "A" is multiplied
+//   only with the non-zeros of "B" in the same row and tile, so that no work is done for pairs of columns with no
+//   non-zeros in common.
+struct sparseSparseCross {
+    Rcpp::SparseMatrix& A;
+    std::vector<int> row_ptr, cols;
+    std::vector<double> values;
+
+    sparseSparseCross(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& B) : A(A), row_ptr(B.rows() + 1, 0) {
+        for (unsigned int col = 0; col < B.cols(); ++col)
+            for (Rcpp::SparseMatrix::InnerIterator it(B, col); it; ++it) ++row_ptr[it.row() + 1];
+        std::partial_sum(row_ptr.begin(), row_ptr.end(), row_ptr.begin());
+        cols.resize(row_ptr.back());
+        values.resize(row_ptr.back());
+        std::vector<int> pos(row_ptr.begin(), row_ptr.end() - 1);
+        for (unsigned int col = 0; col < B.cols(); ++col) {
+            for (Rcpp::SparseMatrix::InnerIterator it(B, col); it; ++it) {
+                cols[pos[it.row()]] = col;
+                values[pos[it.row()]++] = it.value();
+            }
+        }
+    }
+
+    Eigen::MatrixXd operator()(const int a_start, const int a_cols, const int b_start, const int b_cols) const {
+        Eigen::MatrixXd cross = Eigen::MatrixXd::Zero(b_cols, a_cols);
+        const int b_end = b_start + b_cols;
+        for (int j = 0; j < a_cols; ++j) {
+            for (Rcpp::SparseMatrix::InnerIterator it(A, a_start + j); it; ++it) {
+                const int row_end = row_ptr[it.row() + 1];
+                int k = std::lower_bound(cols.begin() + row_ptr[it.row()], cols.begin() + row_end, b_start) - cols.begin();
+                for (; k < row_end && cols[k] < b_end; ++k) cross(cols[k] - b_start, j) += it.value() * values[k];
             }
         }
+        return cross;
     }
+};
+
+// tiles of cross-products for dense "A" and "B"
+struct denseDenseCross {
+    const Eigen::Ref<const Eigen::MatrixXd>& A;
+    const Eigen::Ref<const Eigen::MatrixXd>& B;
+    Eigen::MatrixXd operator()(const int a_start, const int a_cols, const int b_start, const int b_cols) const {
+        Eigen::MatrixXd cross = B.middleCols(b_start, b_cols).transpose() * A.middleCols(a_start, a_cols);
+        return cross;
+    }
+};
+
+// sparse/dense column-wise distance calculation between two matrices
+Eigen::MatrixXd distance(Rcpp::SparseMatrix& A, const Eigen::Ref<const Eigen::MatrixXd>& B, std::string method,
+                         const unsigned int threads) {
+    const distanceMethod m = getDistanceMethod(method);
+    return tiledDistance(columnStats(A), columnStats(B), A.rows(), m, false, threads, sparseDenseCross{A, B.transpose()});
+}
+
+// sparse/sparse column-wise distance calculation between two matrices (see "sparseSparseCross"). Euclidean distances
+//   are not squared.
+Eigen::MatrixXd distance(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& B, std::string method, const unsigned int threads, const bool symmetric = false) {
+    const distanceMethod m = getDistanceMethod(method);
+    const colStats a = columnStats(A);
+    Eigen::MatrixXd dists = tiledDistance(a, symmetric ? a : columnStats(B), A.rows(), m, symmetric, threads, sparseSparseCross{A, B});
+    if (m == DIST_EUCLIDEAN) dists = dists.cwiseSqrt();
     return dists;
 }
 
-// sparse column-wise distance calculation between two matrices
+// dense/dense column-wise distance calculation between two matrices
+inline Eigen::MatrixXd distance(const Eigen::Ref<const Eigen::MatrixXd>& A, const Eigen::Ref<const Eigen::MatrixXd>& B, const std::string method,
+                                const unsigned int threads, const bool symmetric = false) {
+    const distanceMethod m = getDistanceMethod(method);
+    const colStats a = columnStats(A);
+    return tiledDistance(a, symmetric ? a : columnStats(B), A.rows(), m, symmetric, threads, denseDenseCross{A, B});
+}
+
+// sparse column-wise distance calculation between all columns of a matrix. Euclidean distances are not squared.
 inline Eigen::MatrixXd distance(Rcpp::SparseMatrix& A, std::string method, const unsigned int threads) {
-    Eigen::MatrixXd dists(A.cols(), A.cols());
-
-    if (method == "euclidean") {
-        Eigen::VectorXd sq_colsums(A.cols());
-        for (int col = 0; col < A.cols(); ++col)
-            for (Rcpp::SparseMatrix::InnerIterator it(A, col); it; ++it)
-                sq_colsums(col) += it.value() * it.value();
-
-#pragma omp parallel for num_threads(threads)
-        for (unsigned int i = 0; i < (A.cols() - 1); ++i) {
-            for (unsigned int j = (i + 1); j < A.cols(); ++j) {
-                double dist = sq_colsums(i) + sq_colsums(j);
-                Rcpp::SparseMatrix::InnerIterator it1(A, i), it2(A, j);
-                while (it1 && it2) {
-                    if (it1.row() < it2.row())
-                        ++it1;
-                    else if (it1.row() > it2.row())
-                        ++it2;
-                    else {
-                        dist -= it1.value() * it1.value();
-                        dist -= it2.value() * it2.value();
-                        dist += std::pow(it1.value() - it2.value(), 2);
-                        ++it1;
-                        ++it2;
-                    }
+    return distance(A, A, method, threads, true);
+}
+
+// "k" nearest columns in "B" to each column in "A", in the units of the corresponding "distance"
+inline knnResult knn(Rcpp::SparseMatrix& A, const Eigen::Ref<const Eigen::MatrixXd>& B, std::string method, const unsigned int k,
+                     const unsigned int threads) {
+    const distanceMethod m = getDistanceMethod(method);
+    return tiledKnn(columnStats(A), columnStats(B), A.rows(), m, k, false, threads, sparseDenseCross{A, B.transpose()});
+}
+
+inline knnResult knn(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& B, std::string method, const unsigned int k, const unsigned int threads,
+                     const bool symmetric = false) {
+    const distanceMethod m = getDistanceMethod(method);
+    const colStats a = columnStats(A);
+    knnResult res = tiledKnn(a, symmetric ? a : columnStats(B), A.rows(), m, k, symmetric, threads, sparseSparseCross{A, B});
+    if (m == DIST_EUCLIDEAN) res.dist = res.dist.cwiseSqrt();
+    return res;
+}
+
+inline knnResult knn(const Eigen::Ref<const Eigen::MatrixXd>& A, const Eigen::Ref<const Eigen::MatrixXd>& B, const std::string method,
+                     const unsigned int k, const unsigned int threads, const bool symmetric = false) {
+    const distanceMethod m = getDistanceMethod(method);
+    const colStats a = columnStats(A);
+    return tiledKnn(a, symmetric ? a : columnStats(B), A.rows(), m, k, symmetric, threads, denseDenseCross{A, B});
+}
+
+// distances between all columns in "A" and "B" in single precision, computed by blocks of "block_cols" columns in "B",
+//   each in parallel over its tiles, and passed to "write(block)" in order of blocks, where "block" is
+//   "A.cols() x block_cols" (or fewer columns, for the last block). Only one block is held in memory at a time, so
+//   distances may be written out of core. Euclidean distances are not squared.
+template <class CrossTile, class Writer>
+void blockedDistance(const colStats& a, const colStats& b, const unsigned int n, const distanceMethod method, const unsigned int block_cols,
+                     const unsigned int threads, const CrossTile& cross_tile, Writer& write) {
+    if (block_cols == 0) Rcpp::stop("number of columns in each block must be positive");
+    const int a_n = a.sums.size(), b_n = b.sums.size();
+    const int a_tiles = (a_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    Eigen::MatrixXf block;
+    for (int block_start = 0; block_start < b_n; block_start += block_cols) {
+        const int block_n = std::min((int)block_cols, b_n - block_start);
+        const int b_tiles = (block_n + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+        block.resize(a_n, block_n);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+        for (int tile = 0; tile < a_tiles * b_tiles; ++tile) {
+            const int a_start = (tile / b_tiles) * PREDICT_TILE_SIZE, b_offset = (tile % b_tiles) * PREDICT_TILE_SIZE;
+            const int a_cols = std::min((int)PREDICT_TILE_SIZE, a_n - a_start);
+            const int b_cols = std::min((int)PREDICT_TILE_SIZE, block_n - b_offset);
+            const Eigen::MatrixXd cross = cross_tile(a_start, a_cols, block_start + b_offset, b_cols);
+            for (int i = 0; i < b_cols; ++i) {
+                const int b_col = block_start + b_offset + i;
+                for (int j = 0; j < a_cols; ++j) {
+                    const int a_col = a_start + j;
+                    double dist = distanceFromCross(cross(i, j), a.sums(a_col), a.sq_norms(a_col), b.sums(b_col), b.sq_norms(b_col), n, method);
+                    if (method == DIST_EUCLIDEAN) dist = std::sqrt(dist);
+                    block(a_col, b_offset + i) = (float)dist;
                 }
-                dists(i, j) = std::sqrt(dist);
-                dists(j, i) = dists(i, j);
             }
         }
+        write(block);
+        Rcpp::checkUserInterrupt();
     }
-    dists.diagonal().array() = 1;
-    return dists;
 }
 
-#endif
\ No newline at end of file
+// writes blocks of "blockedDistance" to a file, in which all distances are single-precision values in native byte order
+//   and column-major order, as in an R matrix of "A.cols()" rows and "B.cols()" columns
+class distanceFileWriter {
+   public:
+    distanceFileWriter(const std::string& path) : path(path), f(path.c_str(), std::ios::binary | std::ios::trunc) {
+        if (!f) Rcpp::stop("could not open '" + path + "' for writing");
+    }
+
+    void operator()(const Eigen::MatrixXf& block) {
+        f.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(float));
+        if (!f) Rcpp::stop("could not write to '" + path + "'");
+    }
+
+   private:
+    const std::string path;
+    std::ofstream f;
+};
+
+// copies blocks of "blockedDistance" into consecutive columns of a single-precision buffer of "A.cols() x B.cols()"
+//   values in column-major order, such as the data of an R raw vector
+class distanceBufferWriter {
+   public:
+    distanceBufferWriter(float* data) : data(data){};
+
+    void operator()(const Eigen::MatrixXf& block) {
+        std::copy(block.data(), block.data() + block.size(), data + offset);
+        offset += block.size();
+    }
+
+   private:
+    float* data;
+    size_t offset = 0;
+};
+
+// single-precision distances between all columns in "A" and "B", passed to "write" by blocks of "block_cols" columns
+//   in "B" (see "blockedDistance")
+template <class Writer>
+inline void writeDistance(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& B, const std::string method, const unsigned int block_cols,
+                          const unsigned int threads, Writer& write) {
+    const distanceMethod m = getDistanceMethod(method);
+    blockedDistance(columnStats(A), columnStats(B), A.rows(), m, block_cols, threads, sparseSparseCross{A, B}, write);
+}
+
+template <class Writer>
+inline void writeDistance(Rcpp::SparseMatrix& A, const Eigen::Ref<const Eigen::MatrixXd>& B, const std::string method,
+                          const unsigned int block_cols, const unsigned int threads, Writer& write) {
+    const distanceMethod m = getDistanceMethod(method);
+    blockedDistance(columnStats(A), columnStats(B), A.rows(), m, block_cols, threads, sparseDenseCross{A, B.transpose()}, write);
+}
+
+template <class Writer>
+inline void writeDistance(const Eigen::Ref<const Eigen::MatrixXd>& A, const Eigen::Ref<const Eigen::MatrixXd>& B, const std::string method,
+                          const unsigned int block_cols, const unsigned int threads, Writer& write) {
+    const distanceMethod m = getDistanceMethod(method);
+    blockedDistance(columnStats(A), columnStats(B), A.rows(), m, block_cols, threads, denseDenseCross{A, B}, write);
+}
+
+#endif
@@ -0,0 +1,130 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_evaluate
+#define RcppML_evaluate
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <utility>
+#include <vector>
+
+namespace RcppML {
+
+// mean squared error of several factor models of the same sparse matrix in one pass over its non-zeros
+//  * "wd" is "w" scaled by "d", with factors in rows (as for "nmf"), and "h" is dense
+//  * non-zeros (and masked rows) of each column are read once and scored against all models
+//  * unmasked losses use the Gram identity (see "nmf::mse_gram"). Loss at masked entries is found in one merge of
+//      masked rows with the non-zeros of each column, and is subtracted from the total loss, or with "missing_only"
+//      is the loss itself
+//  * with "mask_zeros", only the non-zeros are evaluated
+inline Eigen::VectorXd mse_models(Rcpp::SparseMatrix& A, Rcpp::SparseMatrix& mask, const std::vector<Eigen::MatrixXd>& wd,
+                                  const std::vector<Eigen::MatrixXd>& h, const unsigned int threads, const bool mask_zeros,
+                                  const bool missing_only) {
+    const bool masking = !mask_zeros && mask.rows() == A.rows() && mask.cols() == A.cols();
+    if (missing_only && !masking) Rcpp::stop("a mask matrix must be specified to evaluate only masked values");
+    const int n_models = wd.size();
+    for (int m = 0; m < n_models; ++m) {
+        if (wd[m].cols() != A.rows() || h[m].cols() != A.cols() || wd[m].rows() != h[m].rows())
+            Rcpp::stop("dimensions of model " + std::to_string(m + 1) + " and 'A' are not compatible");
+    }
+
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    Eigen::MatrixXd losses = Eigen::MatrixXd::Zero(n_models, A.cols());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int chunk = 0; chunk < (int)chunks.size() - 1; ++chunk) {
+        std::vector<std::pair<int, double>> masked;
+        for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+            if (mask_zeros) {
+                for (Rcpp::SparseMatrix::InnerIterator iter(A, i); iter; ++iter)
+                    for (int m = 0; m < n_models; ++m)
+                        losses(m, i) += std::pow(wd[m].col(iter.row()).dot(h[m].col(i)) - iter.value(), 2);
+                continue;
+            }
+            if (!missing_only) {
+                // ||A.col(i)||^2 - 2 * A.col(i)^T (wdh).col(i), evaluated only at nonzeros
+                for (Rcpp::SparseMatrix::InnerIterator iter(A, i); iter; ++iter)
+                    for (int m = 0; m < n_models; ++m)
+                        losses(m, i) += iter.value() * (iter.value() - 2 * wd[m].col(iter.row()).dot(h[m].col(i)));
+            }
+            if (masking) {
+                masked.clear();
+                Rcpp::SparseMatrix::InnerIterator iter(A, i);
+                for (const int row : mask.InnerIndexView(i)) {
+                    while (iter && iter.row() < row) ++iter;
+                    masked.push_back({row, (iter && iter.row() == row) ? iter.value() : 0});
+                }
+                for (int m = 0; m < n_models; ++m) {
+                    double masked_loss = 0;
+                    for (const auto& entry : masked)
+                        masked_loss += std::pow(wd[m].col(entry.first).dot(h[m].col(i)) - entry.second, 2);
+                    losses(m, i) += missing_only ? masked_loss : -masked_loss;
+                }
+            }
+        }
+    }
+
+    // divide total loss by number of applicable measurements
+    double n = (double)A.rows() * A.cols();
+    if (mask_zeros)
+        n = n_nonzeros(A);
+    else if (missing_only)
+        n = mask.i.size();
+    else if (masking)
+        n -= mask.i.size();
+    Eigen::VectorXd mse(n_models);
+    for (int m = 0; m < n_models; ++m) {
+        double loss = losses.row(m).sum();
+        if (!mask_zeros && !missing_only)
+            loss += (gram(wd[m]).array() * gram(h[m]).array()).sum();
+        // cancellation can leave a tiny negative loss for near-exact models
+        mse(m) = std::max(loss, 0.0) / n;
+    }
+    return mse;
+}
+
+// mean squared error of "wh" at the held-out features of held-out samples "A", for bi-cross-validation (see
+//   "nmf::fit_cross_validate_samples")
+//  * "held_out" is 1 for held-out features (rows of "A") and 0 otherwise, "wd" has factors in rows, and "h" was
+//      projected from the other features
+//  * sparse "A" uses the Gram identity over the held-out features, so that its zeros are not read
+inline double mse_heldout(Rcpp::SparseMatrix& A, const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Eigen::VectorXd& held_out,
+                          const unsigned int threads) {
+    const Eigen::MatrixXd wd_out = wd * held_out.asDiagonal();
+    const Eigen::MatrixXd a = wd_out * wd_out.transpose();
+    double loss = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+ : loss)
+#endif
+    for (unsigned int j = 0; j < A.cols(); ++j) {
+        for (Rcpp::SparseMatrix::InnerIterator it(A, j); it; ++it)
+            if (held_out(it.row()) != 0) loss += it.value() * (it.value() - 2 * wd.col(it.row()).dot(h.col(j)));
+        loss += h.col(j).dot(a * h.col(j));
+    }
+    return std::max(loss, 0.0) / (held_out.sum() * A.cols());
+}
+
+template <class Derived>
+double mse_heldout(const Eigen::MatrixBase<Derived>& A, const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Eigen::VectorXd& held_out,
+                   const unsigned int threads) {
+    double loss = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+ : loss)
+#endif
+    for (int j = 0; j < (int)A.cols(); ++j)
+        for (int i = 0; i < (int)A.rows(); ++i)
+            if (held_out(i) != 0) loss += std::pow((double)A(i, j) - wd.col(i).dot(h.col(j)), 2);
+    return loss / (held_out.sum() * A.cols());
+}
+
+}  // namespace RcppML
+
+#endif
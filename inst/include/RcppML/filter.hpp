@@ -0,0 +1,272 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_filter
+#define RcppML_filter
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#ifndef RcppML_rng
+#include <RcppML/rng.hpp>
+#endif
+
+#include <algorithm>
+
+// FEATURE FILTERING AND SAMPLE NORMALIZATION OF SPARSE MATRICES
+//
+// Features (rows) and samples (columns) of a dgCMatrix or ngCMatrix are dropped by their numbers of non-zeros or the
+//   variance of features, and samples are scaled to a common sum or Euclidean norm, in a few passes over the
+//   non-zeros that write only the result:
+//  * samples are kept by their number of non-zeros, from the column pointers alone
+//  * features are kept by their number of non-zeros and variance over the kept samples, found in one pass over the
+//      non-zeros of kept samples in chunks of columns, each counting into its own accumulators
+//  * the scale of each kept sample is found over its kept features, and the kept non-zeros are then counted and
+//      written for each sample in parallel, with rows renumbered by the map from features to kept features
+// The result is a single compact copy, rather than one copy for each subset and scaling, and a model of it is
+//   mapped back to the original features and samples by "sparseFilter::rows" and "sparseFilter::cols".
+namespace RcppML {
+
+enum sample_normalization { NORMALIZE_NONE = 0,
+                            NORMALIZE_SUM = 1,
+                            NORMALIZE_L2 = 2 };
+
+// features and samples of a sparse matrix kept by "filterSparse", and the scale applied to each kept sample
+struct sparseFilter {
+    std::vector<int> rows, cols;
+    std::vector<double> scale;
+};
+
+// "A[rows, cols] %*% diag(scale)" for the features with at least "min_row_nnz" non-zeros and variance of at least
+//   "min_row_var" over samples with at least "min_col_nnz" non-zeros, in which each sample is scaled to the mean
+//   sum ("NORMALIZE_SUM") or Euclidean norm ("NORMALIZE_L2") of all kept samples, or not at all ("NORMALIZE_NONE")
+//  * samples without kept non-zeros are kept unscaled
+//  * a pattern matrix that is not scaled is returned as a pattern matrix
+inline Rcpp::S4 filterSparse(const Rcpp::S4& A, const unsigned int min_row_nnz, const unsigned int min_col_nnz,
+                             const double min_row_var, const int normalize, sparseFilter& kept, const unsigned int threads = 0) {
+    const Rcpp::IntegerVector A_i = A.slot("i"), A_p = A.slot("p"), Dim = A.slot("Dim");
+    const bool pattern = !A.hasSlot("x");
+    Rcpp::NumericVector A_x;
+    if (!pattern) A_x = A.slot("x");
+    const int n_rows = Dim[0], n_cols = Dim[1];
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+#endif
+
+    // samples by their number of non-zeros
+    kept.cols.clear();
+    for (int j = 0; j < n_cols; ++j)
+        if ((unsigned int)(A_p[j + 1] - A_p[j]) >= min_col_nnz) kept.cols.push_back(j);
+    const int n_kept_cols = kept.cols.size();
+
+    // features by their number of non-zeros, and variance over kept samples (including zeros)
+    const int n_chunks = std::max(1, std::min(n_threads, n_kept_cols));
+    std::vector<int> nnz((size_t)n_chunks * n_rows, 0);
+    std::vector<double> sums, sq_sums;
+    if (min_row_var > 0) {
+        sums.assign((size_t)n_chunks * n_rows, 0);
+        sq_sums.assign((size_t)n_chunks * n_rows, 0);
+    }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_chunks) schedule(static)
+#endif
+    for (int chunk = 0; chunk < n_chunks; ++chunk) {
+        const size_t offset = (size_t)chunk * n_rows;
+        for (int c = (int)((int64_t)chunk * n_kept_cols / n_chunks); c < (int)((int64_t)(chunk + 1) * n_kept_cols / n_chunks); ++c) {
+            const int j = kept.cols[c];
+            for (int it = A_p[j]; it < A_p[j + 1]; ++it) {
+                ++nnz[offset + A_i[it]];
+                if (min_row_var > 0) {
+                    const double v = pattern ? 1 : A_x[it];
+                    sums[offset + A_i[it]] += v;
+                    sq_sums[offset + A_i[it]] += v * v;
+                }
+            }
+        }
+    }
+    std::vector<int> row_map(n_rows, -1);
+    kept.rows.clear();
+    for (int r = 0; r < n_rows; ++r) {
+        unsigned int row_nnz = 0;
+        double sum = 0, sq_sum = 0;
+        for (int chunk = 0; chunk < n_chunks; ++chunk) {
+            row_nnz += nnz[(size_t)chunk * n_rows + r];
+            if (min_row_var > 0) {
+                sum += sums[(size_t)chunk * n_rows + r];
+                sq_sum += sq_sums[(size_t)chunk * n_rows + r];
+            }
+        }
+        if (row_nnz < min_row_nnz) continue;
+        if (min_row_var > 0 && (n_kept_cols < 2 || (sq_sum - sum * sum / n_kept_cols) / (n_kept_cols - 1) < min_row_var)) continue;
+        row_map[r] = kept.rows.size();
+        kept.rows.push_back(r);
+    }
+
+    // scale of each kept sample over kept features, and its number of kept non-zeros
+    kept.scale.assign(n_kept_cols, 1);
+    Rcpp::IntegerVector p(n_kept_cols + 1);
+    std::vector<double> norms(n_kept_cols, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+#endif
+    for (int c = 0; c < n_kept_cols; ++c) {
+        const int j = kept.cols[c];
+        int col_nnz = 0;
+        double norm = 0;
+        for (int it = A_p[j]; it < A_p[j + 1]; ++it) {
+            if (row_map[A_i[it]] < 0) continue;
+            ++col_nnz;
+            const double v = pattern ? 1 : A_x[it];
+            norm += (normalize == NORMALIZE_L2) ? v * v : v;
+        }
+        p[c + 1] = col_nnz;
+        norms[c] = (normalize == NORMALIZE_L2) ? std::sqrt(norm) : norm;
+    }
+    if (normalize != NORMALIZE_NONE) {
+        double mean_norm = 0;
+        int n_scaled = 0;
+        for (int c = 0; c < n_kept_cols; ++c) {
+            if (norms[c] > 0) {
+                mean_norm += norms[c];
+                ++n_scaled;
+            }
+        }
+        if (n_scaled > 0) mean_norm /= n_scaled;
+        for (int c = 0; c < n_kept_cols; ++c)
+            if (norms[c] > 0) kept.scale[c] = mean_norm / norms[c];
+    }
+    for (int c = 0; c < n_kept_cols; ++c) p[c + 1] += p[c];
+
+    // write kept non-zeros with renumbered rows, which remain sorted within each sample
+    const bool values = !pattern || normalize != NORMALIZE_NONE;
+    Rcpp::IntegerVector i(p[n_kept_cols]);
+    Rcpp::NumericVector x(values ? p[n_kept_cols] : 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+#endif
+    for (int c = 0; c < n_kept_cols; ++c) {
+        const int j = kept.cols[c];
+        int pos = p[c];
+        for (int it = A_p[j]; it < A_p[j + 1]; ++it) {
+            const int r = row_map[A_i[it]];
+            if (r < 0) continue;
+            i[pos] = r;
+            if (values) x[pos] = (pattern ? 1 : A_x[it]) * kept.scale[c];
+            ++pos;
+        }
+    }
+
+    Rcpp::S4 s(std::string(values ? "dgCMatrix" : "ngCMatrix"));
+    if (values) s.slot("x") = x;
+    s.slot("i") = i;
+    s.slot("p") = p;
+    s.slot("Dim") = Rcpp::IntegerVector::create((int)kept.rows.size(), n_kept_cols);
+    return s;
+}
+
+// FEATURE HASHING
+//
+// Features of very wide sparse matrices (e.g. k-mer counts or peaks, with tens of millions of rows) are mapped into a
+//   fixed number of buckets, so that a model of the hashed matrix has "buckets" features whatever the number of rows:
+//  * row "r" goes to bucket "rng(seed).rand(r, 0) % buckets", and with "signs", is added with the sign given by the
+//      lowest bit of "rng(seed).rand(r, 1)", so that inner products of hashed samples estimate those of the original
+//      samples without bias (Weinberger et al. 2009)
+//  * values of rows that share a bucket in a sample are added, so the hashed matrix has no more non-zeros than "A"
+//  * each sample is hashed, sorted and merged once to count its buckets and once to write them, in parallel over
+//      samples, and the map of rows to buckets is never stored, so memory follows the non-zeros and not the features
+
+// bucket of row "r", and its sign in signed hashing
+inline uint32_t featureBucket(const rng<false>& r, const uint32_t row, const uint32_t buckets) { return r.rand(row, 0) % buckets; }
+
+inline double featureSign(const rng<false>& r, const uint32_t row) { return (r.rand(row, 1) & 1) ? -1 : 1; }
+
+// buckets of the non-zeros of column "j" with their summed values, sorted by bucket, in "merged"
+//  * buckets whose values cancel in signed hashing are dropped
+inline void hashColumn(const Rcpp::IntegerVector& A_i, const Rcpp::NumericVector& A_x, const bool pattern, const int begin,
+                       const int end, const rng<false>& r, const uint32_t buckets, const bool signs,
+                       std::vector<std::pair<uint32_t, double>>& merged) {
+    merged.clear();
+    for (int it = begin; it < end; ++it) {
+        const double v = pattern ? 1 : A_x[it];
+        merged.push_back(std::make_pair(featureBucket(r, A_i[it], buckets), signs ? featureSign(r, A_i[it]) * v : v));
+    }
+    std::sort(merged.begin(), merged.end(), [](const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) {
+        return a.first < b.first;
+    });
+    size_t n = 0;
+    for (size_t k = 0; k < merged.size(); ++k) {
+        if (n > 0 && merged[n - 1].first == merged[k].first)
+            merged[n - 1].second += merged[k].second;
+        else
+            merged[n++] = merged[k];
+    }
+    merged.resize(n);
+    if (signs)
+        merged.erase(std::remove_if(merged.begin(), merged.end(), [](const std::pair<uint32_t, double>& b) { return b.second == 0; }),
+                     merged.end());
+}
+
+// "A" with its rows hashed into "buckets" rows, as a dgCMatrix
+inline Rcpp::S4 hashSparse(const Rcpp::S4& A, const uint32_t buckets, const bool signs, const uint32_t seed, const unsigned int threads = 0) {
+    const Rcpp::IntegerVector A_i = A.slot("i"), A_p = A.slot("p"), Dim = A.slot("Dim");
+    const bool pattern = !A.hasSlot("x");
+    Rcpp::NumericVector A_x;
+    if (!pattern) A_x = A.slot("x");
+    const int n_cols = Dim[1];
+    int n_threads = 1;
+#ifdef _OPENMP
+    n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+#endif
+    const rng<false> r(seed);
+
+    Rcpp::IntegerVector p(n_cols + 1);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(n_threads)
+#endif
+    {
+        std::vector<std::pair<uint32_t, double>> merged;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 256)
+#endif
+        for (int j = 0; j < n_cols; ++j) {
+            hashColumn(A_i, A_x, pattern, A_p[j], A_p[j + 1], r, buckets, signs, merged);
+            p[j + 1] = merged.size();
+        }
+    }
+    for (int j = 0; j < n_cols; ++j) p[j + 1] += p[j];
+
+    Rcpp::IntegerVector i(p[n_cols]);
+    Rcpp::NumericVector x(p[n_cols]);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(n_threads)
+#endif
+    {
+        std::vector<std::pair<uint32_t, double>> merged;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 256)
+#endif
+        for (int j = 0; j < n_cols; ++j) {
+            hashColumn(A_i, A_x, pattern, A_p[j], A_p[j + 1], r, buckets, signs, merged);
+            for (size_t k = 0; k < merged.size(); ++k) {
+                i[p[j] + k] = merged[k].first;
+                x[p[j] + k] = merged[k].second;
+            }
+        }
+    }
+
+    Rcpp::S4 s(std::string("dgCMatrix"));
+    s.slot("x") = x;
+    s.slot("i") = i;
+    s.slot("p") = p;
+    s.slot("Dim") = Rcpp::IntegerVector::create((int)buckets, n_cols);
+    return s;
+}
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,86 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_fitter
+#define RcppML_fitter
+
+#ifndef RcppML_nmfSparse
+#include <RcppML/nmf.hpp>
+#endif
+
+namespace RcppML {
+
+// an nmf fit that is advanced a few iterations at a time by its caller, which holds "A", the model, the transpose of
+//   "A" and every other buffer of the fit between steps, so that no step starts over or copies state in or out
+//  * each step is a call to "nmf::fit" with "maxit" raised by the iterations of the step, which continues from the
+//      iteration at which the last call stopped
+//  * the loss is tracked by the Gram identity at no extra cost ("loss_tol"), so that it can be read after every step
+//  * the threads of each step are given with it, so that cores can be moved between fitters from one step to the next
+//  * factors are not sorted between steps, which would reorder the state of the fit, but only when they are read
+class stepFit {
+   public:
+    virtual ~stepFit() {}
+
+    // fit up to "n" more iterations on "threads", or none if the fit has converged, and return the iterations fit
+    virtual unsigned int step(const unsigned int n, const unsigned int threads) = 0;
+
+    // iterations fit so far, and whether the last one met the tolerance of the fit
+    virtual unsigned int iter() = 0;
+    virtual bool converged() = 0;
+
+    // relative change in loss in the last iteration, and the mean squared error after each iteration
+    virtual double tol() = 0;
+    virtual std::vector<double> losses() = 0;
+
+    // factors of the model, as "w" (factors by features), "d" and "h"
+    virtual Eigen::MatrixXd matrixW() const = 0;
+    virtual Eigen::VectorXd vectorD() const = 0;
+    virtual Eigen::MatrixXd matrixH() const = 0;
+};
+
+// "T" is the input matrix type of "nmf", which the fitter owns so that it outlives every step. A sparse
+//   "Rcpp::SparseMatrix" refers to and protects the vectors of the R object it was constructed from, rather than
+//   copying them.
+template <class T>
+class nmfFitter : public stepFit {
+   public:
+    nmfFitter(const T& A_, const Eigen::MatrixXd& w_init) : A(A_), m(A, w_init) {
+        m.verbose = false;
+        m.sort_model = false;
+        m.loss_tol = true;
+    }
+
+    // the model, to set options before the first step
+    nmf<T>& model() { return m; }
+
+    unsigned int step(const unsigned int n, const unsigned int threads) {
+        if (converged() || n == 0) return 0;
+        const unsigned int start = iter();
+        m.threads = threads;
+        m.maxit = start + n;
+        m.fit();
+        return iter() - start;
+    }
+
+    // "fit" stops on convergence before it counts the iteration that converged
+    unsigned int iter() { return m.fit_iter() + (converged() ? 1 : 0); }
+    bool converged() { return m.fit_tol() >= 0 && m.fit_tol() < m.tol; }
+    double tol() { return m.fit_tol(); }
+    std::vector<double> losses() { return m.fit_losses(); }
+
+    Eigen::MatrixXd matrixW() const { return m.matrixW(); }
+    Eigen::VectorXd vectorD() const { return m.vectorD(); }
+    Eigen::MatrixXd matrixH() const { return m.matrixH(); }
+
+   private:
+    T A;
+    nmf<T> m;
+};
+
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,81 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2022 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_gram
+#define RcppML_gram
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+// Gram matrices "a = xx^T" of systems of equations in least squares updates
+//  * only the lower triangle is computed, by a symmetric rank-k update (SYRK), which halves the flops of "x * x.transpose()"
+//  * the cholesky factorization in "nnls.hpp" reads only the lower triangle. Coordinate descent reads whole columns
+//      of "a", so the lower triangle is mirrored once per system ("gramSymmetrize"), which costs k^2 / 2 copies
+//      rather than k^2 * n / 2 flops.
+
+// add "alpha * xx^T" to the lower triangle of "a"
+template <class MatrixA, class MatrixX>
+inline void gramUpdate(MatrixA& a, const Eigen::MatrixBase<MatrixX>& x, const typename MatrixA::Scalar alpha = 1) {
+    a.template selfadjointView<Eigen::Lower>().rankUpdate(x, alpha);
+}
+
+// subtract "s^2 * w.col(j) * w.col(j)^T" from the lower triangle of "a" for every row "j" in column "i" of "mask", where
+// "s" is the value of "mask" at "j" if "weighted", otherwise 1
+//  * masked columns of "w" are gathered into "w_", a block of a buffer that is reused across columns (see "workspace"
+//      in "predict.hpp"), for a single rank-k downdate. This is faster than rank-1 downdates read from "w" in place.
+template <class MatrixA, class MatrixW, class MatrixBuf>
+inline void gramDowndate(MatrixA& a, const MatrixW& w, RcppML::SparseOf<double>& mask, const int i, MatrixBuf w_, const bool weighted = true) {
+    typedef typename MatrixA::Scalar Scalar;
+    int j = 0;
+    for (RcppML::SparseOf<double>::InnerIterator it(mask, i); it; ++it, ++j) {
+        if (weighted)
+            w_.col(j) = w.col(it.row()) * (Scalar)it.value();
+        else
+            w_.col(j) = w.col(it.row());
+    }
+    gramUpdate(a, w_, (Scalar)-1);
+}
+
+// copy the strictly lower triangle of "a" to the upper triangle
+template <class MatrixA>
+inline void gramSymmetrize(MatrixA& a) {
+    for (int j = 1; j < a.cols(); ++j)
+        for (int i = 0; i < j; ++i)
+            a(i, j) = a(j, i);
+}
+
+// symmetric Gram matrix "xx^T"
+template <class MatrixX>
+inline Eigen::Matrix<typename MatrixX::Scalar, -1, -1> gram(const Eigen::MatrixBase<MatrixX>& x) {
+    Eigen::Matrix<typename MatrixX::Scalar, -1, -1> a = Eigen::Matrix<typename MatrixX::Scalar, -1, -1>::Zero(x.rows(), x.rows());
+    gramUpdate(a, x);
+    gramSymmetrize(a);
+    return a;
+}
+
+// symmetric Gram matrix "xx^T" on "threads" threads
+//  * Eigen runs rank updates on one thread, so a wide "x" (e.g. "w" of many features, or "h" of many samples) is split
+//      into blocks of at least GRAM_BLOCK_SIZE columns, and at most GRAM_MAX_BLOCKS blocks, which are updated in
+//      parallel (see "RcppML::forEach") and then added in order, so that "a" does not depend on "threads"
+template <class MatrixX>
+inline Eigen::Matrix<typename MatrixX::Scalar, -1, -1> gram(const Eigen::MatrixBase<MatrixX>& x, const unsigned int threads) {
+    typedef Eigen::Matrix<typename MatrixX::Scalar, -1, -1> MatrixA;
+    const int n_blocks = std::min((int)((x.cols() + GRAM_BLOCK_SIZE - 1) / GRAM_BLOCK_SIZE), GRAM_MAX_BLOCKS);
+    if (n_blocks < 2) return gram(x);
+    const int block_size = (x.cols() + n_blocks - 1) / n_blocks;
+    std::vector<MatrixA> blocks(n_blocks, MatrixA::Zero(x.rows(), x.rows()));
+    RcppML::forEach(n_blocks, threads, [&](const int b) {
+        const int start = b * block_size;
+        gramUpdate(blocks[b], x.middleCols(start, std::min(block_size, (int)x.cols() - start)));
+    });
+    for (int b = 1; b < n_blocks; ++b) blocks[0] += blocks[b];
+    gramSymmetrize(blocks[0]);
+    return blocks[0];
+}
+
+#endif
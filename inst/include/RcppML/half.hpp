@@ -0,0 +1,77 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_half
+#define RcppML_half
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <cstring>
+
+// HALF-PRECISION STORAGE OF FACTORS
+//
+// Factors such as "h" of many samples may be stored in 2 bytes per value rather than 8, as 16-bit values in
+//   column-major order:
+//  * "HALF_FLOAT16" is IEEE binary16 (see "Eigen::half"), with 11 bits of precision but only 5 bits of exponent, so
+//      values below 6.1e-5 lose precision as subnormals and values below 6e-8 are stored as zero
+//  * "HALF_BFLOAT16" is the upper half of an IEEE binary32 value, with only 8 bits of precision but the range of a
+//      float, which suits factors whose values span many orders of magnitude
+//  * values are rounded to nearest (ties to even) from single precision, and decoded to the float they represent
+namespace RcppML {
+
+enum half_format { HALF_NONE = 0,
+                   HALF_FLOAT16 = 1,
+                   HALF_BFLOAT16 = 2 };
+
+inline uint16_t floatToBfloat16(const float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(float));
+    if (std::isnan(x)) return (uint16_t)((bits >> 16) | 0x0040);
+    return (uint16_t)((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+}
+
+inline float bfloat16ToFloat(const uint16_t x) {
+    const uint32_t bits = (uint32_t)x << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+inline uint16_t toHalf(const float x, const int format) {
+    if (format == HALF_BFLOAT16) return floatToBfloat16(x);
+    return Eigen::half(x).x;
+}
+
+inline float fromHalf(const uint16_t x, const int format) {
+    if (format == HALF_BFLOAT16) return bfloat16ToFloat(x);
+    return (float)Eigen::half(Eigen::half_impl::raw_uint16_to_half(x));
+}
+
+// write "x" to "out" in half precision and column-major order, in parallel over columns
+template <class Derived>
+void encodeHalf(const Eigen::MatrixBase<Derived>& x, uint16_t* out, const int format, const unsigned int threads = 1) {
+    const Eigen::Index n_rows = x.rows();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+    for (Eigen::Index j = 0; j < x.cols(); ++j)
+        for (Eigen::Index i = 0; i < n_rows; ++i) out[j * n_rows + i] = toHalf((float)x(i, j), format);
+}
+
+// decode "n" values of "x" in half precision to "out"
+inline void decodeHalf(const uint16_t* x, const size_t n, double* out, const int format, const unsigned int threads = 1) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+    for (std::ptrdiff_t i = 0; i < (std::ptrdiff_t)n; ++i) out[i] = fromHalf(x[i], format);
+}
+
+}  // namespace RcppML
+
+#endif
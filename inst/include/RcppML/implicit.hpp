@@ -0,0 +1,202 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_implicit
+#define RcppML_implicit
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+// IMPLICIT-FEEDBACK NON-NEGATIVE MATRIX FACTORIZATION
+//
+// "A = w^T diag(d) h" for sparse "A" of implicit feedback (e.g. counts of views or purchases), in which every value is
+//   fit, but each non-zero "A_ij" with confidence "1 + alpha A_ij" and each zero with confidence 1 (Hu, Koren and
+//   Volinsky (2008), "Collaborative filtering for implicit feedback datasets", ICDM):
+//  * the system for sample "j" is "(ww^T + alpha w_j diag(A_j) w_j^T) h_j = w_j ((1 + alpha A_j) A_j)", where "w_j" are
+//     the columns of "w" at the non-zeros "A_j" of the sample. "ww^T" is computed once for all samples, and the
+//     correction over non-zeros is never formed: each product with the system costs "O(k^2 + k nnz_j)" rather than
+//     "O(k^2 nnz_j)" to form it, as in "mask_zeros" updates that form "w_j w_j^T" for every sample
+//  * each system is solved by conjugate gradients (Takacs, Pilaszy and Tikk (2011), "Applications of the conjugate
+//     gradient method for implicit feedback collaborative filtering", RecSys) on the variables that are positive or
+//     would increase, restarted whenever a variable reaches zero, so the solution is the exact non-negative solution
+//  * solutions are warm-started from the previous iteration, so only a few conjugate gradient steps are needed once the
+//     model stabilizes. Factors are scaled to sum to 1 between updates as in "nmf", and the scaling is restored before
+//     they warm-start the next update.
+//  * "w" is solved in the same way from the transpose of "A"
+namespace RcppML {
+template <typename Value>
+class implicitNMF {
+   public:
+    double tol = 1e-4, alpha = 1, mse = 0;
+    std::vector<double> L1 = {0, 0}, L2 = {0, 0};
+    unsigned int maxit = 100, iter = 0, threads = 0;
+    bool verbose = false, sort_model = true;
+
+    Eigen::MatrixXd w, h;
+    Eigen::VectorXd d;
+    double tol_ = 1;
+
+    implicitNMF(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w) : w(w), A(A) {
+        if (w.cols() != A.rows()) Rcpp::stop("number of columns in 'w' is not equal to the number of rows in 'A'");
+        h = Eigen::MatrixXd::Zero(w.rows(), A.cols());
+        d = Eigen::VectorXd::Ones(w.rows());
+    }
+
+    void fit() {
+        Rcpp::SparseMatrixOf<Value> t_A = transposeOf(A, nThreads());
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        for (iter = 0; iter < maxit; ++iter) {
+            Eigen::MatrixXd w_it = w;
+            h = d.asDiagonal() * h;
+            update(A, w, h, L1[1], L2[1]);
+            scale(h);
+            w = d.asDiagonal() * w;
+            update(t_A, h, w, L1[0], L2[0]);
+            scale(w);
+            tol_ = cor(w, w_it);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
+            if (tol_ < tol) {
+                ++iter;
+                break;
+            }
+            Rcpp::checkUserInterrupt();
+        }
+        mse = meanSquaredError();
+        if (sort_model) {
+            const std::vector<int> indx = sort_index(d);
+            w = reorder_rows(w, indx);
+            h = reorder_rows(h, indx);
+            d = reorder(d, indx);
+        }
+    }
+
+   private:
+    Rcpp::SparseMatrixOf<Value>& A;
+
+    unsigned int nThreads() const {
+#ifdef _OPENMP
+        return threads == 0 ? omp_get_max_threads() : threads;
+#endif
+        return 1;
+    }
+
+    // scale rows of "x" to sum to 1, with their sums in "d"
+    void scale(Eigen::MatrixXd& x) {
+        d = x.rowwise().sum();
+        d.array() += TINY_NUM;
+        for (int f = 0; f < x.rows(); ++f) x.row(f) /= d(f);
+    }
+
+    // solve each column of "h" from "w" and "A", warm-started from the current "h"
+    void update(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w, Eigen::MatrixXd& h, const double L1, const double L2) {
+        const unsigned int k = w.rows();
+        Eigen::MatrixXd a = gram(w);
+        a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nThreads())
+#endif
+        {
+            Eigen::MatrixXd w_;
+            Eigen::VectorXd c, b(k), x(k), r(k), p(k), q(k), free(k);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int j = 0; j < h.cols(); ++j) {
+                // gather the columns of "w" at non-zeros, their confidences less 1, and the right-hand side
+                int nnz = 0;
+                for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, j); it; ++it) ++nnz;
+                if (w_.cols() < nnz) {
+                    w_.resize(k, nnz);
+                    c.resize(nnz);
+                }
+                b.setConstant(-L1);
+                nnz = 0;
+                for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, j); it; ++it, ++nnz) {
+                    const double v = it.value();
+                    w_.col(nnz) = w.col(it.row());
+                    c(nnz) = alpha * v;
+                    b += (1 + alpha * v) * v * w_.col(nnz);
+                }
+                x = h.col(j);
+                solve(a, w_.leftCols(nnz), c.head(nnz), b, x, r, p, q, free);
+                h.col(j) = x;
+            }
+        }
+    }
+
+    // "q = (a + w_ diag(c) w_^T) p"
+    template <class MatrixW, class VectorC>
+    static void multiply(const Eigen::MatrixXd& a, const MatrixW& w_, const VectorC& c, const Eigen::VectorXd& p,
+                         Eigen::VectorXd& q) {
+        q.noalias() = a * p;
+        if (w_.cols() > 0) q.noalias() += w_ * (c.array() * (w_.transpose() * p).array()).matrix();
+    }
+
+    // non-negative solution of "(a + w_ diag(c) w_^T) x = b" from the initial "x", by conjugate gradients on the free
+    //   variables: those that are positive, or at zero with a positive residual. Steps are truncated where a variable
+    //   reaches zero, after which the free set is found again. At the solution, the residual of free variables is 0
+    //   and that of variables at zero is not positive.
+    template <class MatrixW, class VectorC>
+    static void solve(const Eigen::MatrixXd& a, const MatrixW& w_, const VectorC& c, const Eigen::VectorXd& b,
+                      Eigen::VectorXd& x, Eigen::VectorXd& r, Eigen::VectorXd& p, Eigen::VectorXd& q, Eigen::VectorXd& free) {
+        const int k = x.size();
+        const double eps = cd_tol<double>() * std::max(b.cwiseAbs().maxCoeff(), TINY_NUM);
+        multiply(a, w_, c, x, q);
+        r = b - q;
+        for (int restart = 0; restart < 3 * k; ++restart) {
+            for (int i = 0; i < k; ++i) free(i) = (x(i) > 0 || r(i) > eps) ? 1 : 0;
+            r.array() *= free.array();
+            double rr = r.squaredNorm();
+            if (std::sqrt(rr) <= eps) return;
+            p = r;
+            for (int it = 0; it < k; ++it) {
+                multiply(a, w_, c, p, q);
+                q.array() *= free.array();
+                const double pq = p.dot(q);
+                if (pq <= 0) break;
+                double step = rr / pq;
+                int hit = -1;
+                for (int i = 0; i < k; ++i) {
+                    if (p(i) < 0 && x(i) + step * p(i) < 0) {
+                        step = x(i) / -p(i);
+                        hit = i;
+                    }
+                }
+                x += step * p;
+                r -= step * q;
+                if (hit >= 0) {
+                    x(hit) = 0;
+                    break;
+                }
+                const double rr_new = r.squaredNorm();
+                if (std::sqrt(rr_new) <= eps) break;
+                p = r + (rr_new / rr) * p;
+                rr = rr_new;
+            }
+            // the residual is recomputed at each restart, so that rounding in the updates does not accumulate
+            x = x.cwiseMax(0);
+            multiply(a, w_, c, x, q);
+            r = b - q;
+        }
+    }
+
+    // unweighted mean squared error of "A = w^T diag(d) h" from "||A||^2 - 2 tr(h^T diag(d) wA) +
+    //   tr(h^T diag(d) ww^T diag(d) h)"
+    double meanSquaredError() {
+        const Eigen::MatrixXd wd = d.asDiagonal() * w, b = leftMultiply(wd, A, nThreads());
+        const double loss = squaredNorm(A) - 2 * b.cwiseProduct(h).sum() + (gram(wd) * h).cwiseProduct(h).sum();
+        return loss / ((double)A.rows() * A.cols());
+    }
+};
+}  // namespace RcppML
+
+#endif
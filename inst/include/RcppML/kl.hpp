@@ -0,0 +1,157 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_kl
+#define RcppML_kl
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+// KULLBACK-LEIBLER (POISSON) NON-NEGATIVE MATRIX FACTORIZATION
+//
+// "A = w^T diag(d) h" for sparse "A" of counts, minimizing the generalized Kullback-Leibler divergence
+//   "sum(A_ij log(A_ij / L_ij) - A_ij + L_ij)" of "A" from the model "L", which is the negative log-likelihood of a
+//   Poisson model up to a constant, by multiplicative updates (Lee and Seung (2001), "Algorithms for non-negative
+//   matrix factorization", NIPS):
+//  * "h_j <- h_j * (w (A_j / L_j)) / (w 1 + L1 + L2 h_j)", where the ratio "A_j / L_j" is 0 at zeros of "A", so only
+//     the model at the non-zeros of each sample is computed, and zeros contribute only through the row sums "w 1" of
+//     "w". Each update costs "O(k nnz)" and never forms the dense model.
+//  * samples are updated in parallel over tiles of columns with roughly equal numbers of non-zeros, as in "predict"
+//  * "w" is updated in the same way from the transpose of "A". Rows of "w" are then scaled to sum to 1 and their sums
+//     moved into "h", so that neither factor drifts in scale, and the model is returned with both scaled as in "nmf".
+//  * the divergence is found in the same way, since "sum(L) = sum(d)" when rows of "w" and "h" sum to 1
+namespace RcppML {
+template <typename Value>
+class klNMF {
+   public:
+    double tol = 1e-4, mse = 0, kl = 0;
+    std::vector<double> L1 = {0, 0}, L2 = {0, 0};
+    unsigned int maxit = 100, iter = 0, threads = 0;
+    bool verbose = false, sort_model = true;
+
+    Eigen::MatrixXd w, h;
+    Eigen::VectorXd d;
+    double tol_ = 1;
+
+    klNMF(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w) : w(w), A(A) {
+        if (w.cols() != A.rows()) Rcpp::stop("number of columns in 'w' is not equal to the number of rows in 'A'");
+        // multiplicative updates never move a factor from zero, so "h" begins from ones
+        h = Eigen::MatrixXd::Ones(w.rows(), A.cols());
+        d = Eigen::VectorXd::Ones(w.rows());
+    }
+
+    void fit() {
+        Rcpp::SparseMatrixOf<Value> t_A = transposeOf(A, nThreads());
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        scale(w);
+        for (iter = 0; iter < maxit; ++iter) {
+            Eigen::MatrixXd w_it = w;
+            update(A, w, h, L1[1], L2[1]);
+            update(t_A, h, w, L1[0], L2[0]);
+            // move the scale of "w" into "h", which leaves the model unchanged
+            scale(w);
+            h = d.asDiagonal() * h;
+            tol_ = cor(w, w_it);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
+            if (tol_ < tol) {
+                ++iter;
+                break;
+            }
+            Rcpp::checkUserInterrupt();
+        }
+        scale(h);
+        kl = divergence();
+        mse = meanSquaredError();
+        if (sort_model) {
+            const std::vector<int> indx = sort_index(d);
+            w = reorder_rows(w, indx);
+            h = reorder_rows(h, indx);
+            d = reorder(d, indx);
+        }
+    }
+
+   private:
+    Rcpp::SparseMatrixOf<Value>& A;
+
+    unsigned int nThreads() const {
+#ifdef _OPENMP
+        return threads == 0 ? omp_get_max_threads() : threads;
+#endif
+        return 1;
+    }
+
+    // scale rows of "x" to sum to 1, with their sums in "d"
+    void scale(Eigen::MatrixXd& x) {
+        d = x.rowwise().sum();
+        d.array() += TINY_NUM;
+        for (int f = 0; f < x.rows(); ++f) x.row(f) /= d(f);
+    }
+
+    // one multiplicative update of each column of "h" from "w" and "A"
+    void update(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w, Eigen::MatrixXd& h, const double L1, const double L2) {
+        const unsigned int k = w.rows();
+        const Eigen::VectorXd w_sum = w.rowwise().sum().array() + L1;
+        const std::vector<int>& tiles = A.colChunks(PREDICT_TILE_SIZE);
+        const int num_tiles = tiles.size() - 1;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nThreads())
+#endif
+        {
+            Eigen::VectorXd num(k);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int tile = 0; tile < num_tiles; ++tile) {
+                for (int j = tiles[tile]; j < tiles[tile + 1]; ++j) {
+                    num.setZero();
+                    for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, j); it; ++it) {
+                        const double model = w.col(it.row()).dot(h.col(j)) + TINY_NUM;
+                        num += (it.value() / model) * w.col(it.row());
+                    }
+                    h.col(j).array() *= num.array() / (w_sum.array() + L2 * h.col(j).array());
+                }
+            }
+        }
+    }
+
+    // mean generalized Kullback-Leibler divergence of "A" from "w^T diag(d) h" over all values, from the non-zeros of "A"
+    //   and "sum(w^T diag(d) h) = sum(d)"
+    double divergence() {
+        const Eigen::MatrixXd wd = d.asDiagonal() * w;
+        const std::vector<int>& tiles = A.colChunks(PREDICT_TILE_SIZE);
+        const int num_tiles = tiles.size() - 1;
+        Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(num_tiles);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nThreads()) schedule(dynamic)
+#endif
+        for (int tile = 0; tile < num_tiles; ++tile) {
+            for (int j = tiles[tile]; j < tiles[tile + 1]; ++j) {
+                for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, j); it; ++it) {
+                    const double v = it.value(), model = wd.col(it.row()).dot(h.col(j)) + TINY_NUM;
+                    if (v > 0) losses(tile) += v * std::log(v / model) - v;
+                }
+            }
+        }
+        return (losses.sum() + d.sum()) / ((double)A.rows() * A.cols());
+    }
+
+    // unweighted mean squared error of "A = w^T diag(d) h" from "||A||^2 - 2 tr(h^T diag(d) wA) +
+    //   tr(h^T diag(d) ww^T diag(d) h)"
+    double meanSquaredError() {
+        const Eigen::MatrixXd wd = d.asDiagonal() * w, b = leftMultiply(wd, A, nThreads());
+        const double loss = squaredNorm(A) - 2 * b.cwiseProduct(h).sum() + (gram(wd) * h).cwiseProduct(h).sum();
+        return loss / ((double)A.rows() * A.cols());
+    }
+};
+}  // namespace RcppML
+
+#endif
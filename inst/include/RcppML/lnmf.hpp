@@ -0,0 +1,185 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_lnmf
+#define RcppML_lnmf
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+// LINKED NON-NEGATIVE MATRIX FACTORIZATION
+//
+// Datasets "A_d" with the same features are factorized as "A_d = w^T h_d + u_d^T v_d", where "w" ("k_wh x m") is
+//   shared by all datasets and "u_d" ("k_d x m") is unique to dataset "d". Factors are stacked as "x = [w; u_1; ...]"
+//   ("K x m", "K = k_wh + sum(k_d)"). The block structure of the model is used directly, so no linking matrix is
+//   formed and datasets are never concatenated:
+//  * samples of dataset "d" are solved from the reduced system of "[w; u_d]" of rank "k_wh + k_d" (see "projector"),
+//     since factors unique to other datasets are zero in these samples
+//  * features are solved from the full system of rank "K", in which the gram matrix "sum_d [h_d; v_d][h_d; v_d]^T" has
+//     zero blocks between the unique factors of different datasets. Right-hand sides are summed over datasets by
+//     column-wise products with the transpose of each dataset (see "leftMultiply").
+//  * shared rows of "h" are scaled to sum to 1 over all datasets, and unique rows over their own dataset
+namespace RcppML {
+template <class Matrix>
+class lnmf {
+   public:
+    double tol = 1e-4, mse = 0;
+    unsigned int maxit = 100, iter = 0, threads = 0;
+    std::vector<double> L1 = {0, 0}, L2 = {0, 0};
+    bool verbose = false;
+    int solver = NNLS_AUTO;
+
+    Eigen::MatrixXd x;               // stacked "w" and "u_d" ("K x m")
+    Eigen::VectorXd d;               // scaling diagonal of each factor
+    std::vector<Eigen::MatrixXd> h;  // "[h_d; v_d]" of each dataset ("(k_wh + k_d) x n_d")
+    double tol_ = 1;
+
+    lnmf(std::vector<Matrix>& A, const unsigned int k_wh, const std::vector<unsigned int>& k_uv, const Eigen::MatrixXd& x)
+        : x(x), d(Eigen::VectorXd::Ones(x.rows())), h(A.size()), A(A), k_wh(k_wh), k_uv(k_uv) {
+        if (A.size() != k_uv.size()) Rcpp::stop("number of ranks in 'k_uv' must equal the number of datasets");
+        offsets.push_back(k_wh);
+        for (size_t i = 0; i < A.size(); ++i) {
+            if (A[i].rows() != x.cols()) Rcpp::stop("all datasets must have the same number of rows as 'w'");
+            offsets.push_back(offsets.back() + k_uv[i]);
+        }
+        if (offsets.back() != (unsigned int)x.rows()) Rcpp::stop("rank of 'w' is not equal to 'k_wh + sum(k_uv)'");
+    }
+
+    // use "t(A)" of each dataset computed elsewhere (e.g. by the session cache, see "matrixCache"), rather than
+    //   transposing each dataset in "fit"
+    void setTranspose(const std::vector<Matrix>& t) {
+        if (t.size() != A.size()) Rcpp::stop("number of transposes is not equal to the number of datasets");
+        t_A = t;
+    }
+
+    void fit() {
+        if (t_A.size() != A.size()) {
+            t_A.clear();
+            for (size_t i = 0; i < A.size(); ++i) t_A.push_back(transposeOf(A[i], nThreads()));
+        }
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        for (iter = 0; iter < maxit; ++iter) {
+            Eigen::MatrixXd x_it = x;
+            predictH();
+            predictX();
+            tol_ = cor(x, x_it);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
+            if (tol_ < tol) {
+                ++iter;
+                break;
+            }
+            Rcpp::checkUserInterrupt();
+        }
+        mse = meanSquaredError();
+    }
+
+   private:
+    std::vector<Matrix>& A;
+    std::vector<Matrix> t_A;
+    const unsigned int k_wh;
+    const std::vector<unsigned int> k_uv;
+    std::vector<unsigned int> offsets;  // first row of "u_d" in "x" (and one past the last row of "u_D")
+
+    // "[w; u_d]", the factors that are non-zero in samples of dataset "i"
+    Eigen::MatrixXd factors(const size_t i) const {
+        Eigen::MatrixXd x_i(k_wh + k_uv[i], x.cols());
+        x_i.topRows(k_wh) = x.topRows(k_wh);
+        x_i.bottomRows(k_uv[i]) = x.middleRows(offsets[i], k_uv[i]);
+        return x_i;
+    }
+
+    unsigned int nThreads() const {
+#ifdef _OPENMP
+        return threads == 0 ? omp_get_max_threads() : threads;
+#endif
+        return 1;
+    }
+
+    // solve "[h_d; v_d]" of each dataset from its reduced system, and scale rows of "h" to sum to 1
+    void predictH() {
+        Eigen::VectorXd shared_sums = Eigen::VectorXd::Zero(k_wh);
+        for (size_t i = 0; i < A.size(); ++i) {
+            h[i] = projector<double>(factors(i), L1[1], L2[1], 0, solver).project(A[i], nThreads());
+            shared_sums += h[i].topRows(k_wh).rowwise().sum();
+        }
+        for (size_t i = 0; i < A.size(); ++i) {
+            for (unsigned int f = 0; f < k_wh; ++f)
+                if (shared_sums(f) > 0) h[i].row(f) /= shared_sums(f);
+            for (unsigned int f = k_wh; f < h[i].rows(); ++f) {
+                const double sum = h[i].row(f).sum();
+                d(offsets[i] + f - k_wh) = sum;
+                if (sum > 0) h[i].row(f) /= sum;
+            }
+        }
+        d.head(k_wh) = shared_sums;
+    }
+
+    // solve "x" for all features from the arrow-shaped system of all datasets, and scale rows of "x" to sum to 1
+    void predictX() {
+        const unsigned int K = x.rows();
+        Eigen::MatrixXd a = Eigen::MatrixXd::Zero(K, K), b = Eigen::MatrixXd::Zero(K, x.cols());
+        for (size_t i = 0; i < A.size(); ++i) {
+            const Eigen::MatrixXd g = h[i] * h[i].transpose(), b_i = leftMultiply(h[i], t_A[i], nThreads());
+            const unsigned int o = offsets[i], k = k_uv[i];
+            a.topLeftCorner(k_wh, k_wh) += g.topLeftCorner(k_wh, k_wh);
+            a.block(0, o, k_wh, k) += g.topRightCorner(k_wh, k);
+            a.block(o, 0, k, k_wh) += g.bottomLeftCorner(k, k_wh);
+            a.block(o, o, k, k) += g.bottomRightCorner(k, k);
+            b.topRows(k_wh) += b_i.topRows(k_wh);
+            b.middleRows(o, k) += b_i.bottomRows(k);
+        }
+        a.diagonal().array() += L2[0] + TINY_NUM_FOR_STABILITY;
+        if (L1[0] != 0) b.array() -= L1[0];
+        const cholesky<double> a_llt(a);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nThreads())
+#endif
+        {
+            Eigen::VectorXd b_j(K);
+            active_set<double, -1> as_solver(K);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int j = 0; j < x.cols(); ++j) {
+                x.col(j).setZero();
+                b_j = b.col(j);
+                if (a_llt.success) c_nnls_init(a_llt, a, b_j, x, j, 0);
+                if (useActiveSet(solver, K))
+                    as_solver.solve(a, b_j, x, j);
+                else
+                    c_nnls(a, b_j, x, j, CD_MAXIT, cd_tol<double>(), solver);
+            }
+        }
+        for (unsigned int f = 0; f < K; ++f) {
+            d(f) = x.row(f).sum();
+            if (d(f) > 0) x.row(f) /= d(f);
+        }
+    }
+
+    // mean squared error of the model over all values of all datasets, from "||A_j||^2 - 2 y^T (x_d A_j) + y^T G_d y"
+    //   for each sample "j", where "y" is the scaled solution of the sample and "G_d" the gram matrix of "x_d"
+    double meanSquaredError() {
+        double loss = 0, n_values = 0;
+        for (size_t i = 0; i < A.size(); ++i) {
+            Eigen::MatrixXd y = h[i];
+            for (unsigned int f = 0; f < k_wh; ++f) y.row(f) *= d(f);
+            for (unsigned int f = 0; f < k_uv[i]; ++f) y.row(k_wh + f) *= d(offsets[i] + f);
+            const Eigen::MatrixXd x_i = factors(i), b_i = leftMultiply(x_i, A[i], nThreads());
+            loss += squaredNorm(A[i]) - 2 * b_i.cwiseProduct(y).sum() + ((x_i * x_i.transpose()) * y).cwiseProduct(y).sum();
+            n_values += (double)A[i].rows() * A[i].cols();
+        }
+        return loss / n_values;
+    }
+};
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,156 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_matrixcache
+#define RcppML_matrixcache
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <list>
+#include <memory>
+
+// SESSION CACHE OF PREPARED SPARSE MATRICES
+//
+// Separate calls that fit the same dgCMatrix (e.g. "nmf" over ranks in a loop, "crossValidate", "lnmf") each transpose
+//   it, check whether it is symmetric and find its squared norm. With a memory limit (see "Rcpp_matrix_cache"), this
+//   work is kept between calls, like "prepare_matrix" but without changing the data that is passed:
+//  * a matrix is found by the addresses of its "i", "p" and "x" vectors, its dimensions and its number of non-zeros.
+//      The cache holds these vectors until the matrix is evicted, so their addresses are not reused by other matrices
+//      while it is cached. Cached values must not be modified in place (R copies them on modification).
+//  * each entry holds the transpose, symmetry and squared norm of the matrix, and shares with later fits the structure
+//      that fits cache for the matrix and its transpose (chunks of columns, row index and compressed indices)
+//  * entries are evicted in least recently used order once the transposes and structure held by the cache exceed the
+//      limit. A matrix larger than the limit on its own is not cached.
+//  * the cache is only used from the main R thread
+namespace RcppML {
+
+// structure of a sparse matrix for repeated fits (see "Rcpp_prepare_sparse")
+//  * "t_A" is empty if "A" is symmetric
+struct preparedSparse {
+    Rcpp::SparseMatrix A, t_A;
+    bool symmetric = false;
+    double sq_norm = 0;
+    bool has_na = false;
+
+    // NA values and the squared Frobenius norm are found in one parallel pass over the non-zeros, and the transpose is
+    //   only computed if "A" is not symmetric, from the row index built by the symmetry check of a square matrix
+    preparedSparse(const Rcpp::S4& s, const unsigned int threads) : A(s) {
+        const int nnz = A.p[A.cols()];
+        const double* x = (nnz > 0) ? &A.x[0] : nullptr;
+        int n_na = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) reduction(+ : sq_norm, n_na)
+#endif
+        for (int it = 0; it < nnz; ++it) {
+            if (std::isnan(x[it]))
+                ++n_na;
+            else
+                sq_norm += x[it] * x[it];
+        }
+        has_na = n_na > 0;
+        symmetric = A.isAppxSymmetric();
+        if (!symmetric) t_A = A.transpose(threads);
+    }
+
+    // bytes held for "A" other than its own vectors
+    size_t bytes() const {
+        const size_t own = (A.i.size() + A.p.size()) * sizeof(int) + A.i.size() * sizeof(double);
+        return A.bytes() - own + (symmetric ? 0 : t_A.bytes());
+    }
+};
+
+class matrixCache {
+   public:
+    size_t hits = 0, misses = 0;
+
+    // limit of the bytes held by the cache, or 0 if it is not used. Entries are evicted to fit a lower limit.
+    size_t limit() const { return limit_; }
+    void setLimit(const size_t limit) {
+        limit_ = limit;
+        evict();
+    }
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const {
+        size_t n = 0;
+        for (const entry& e : entries) n += e.prepared->bytes();
+        return n;
+    }
+
+    void clear() {
+        entries.clear();
+        hits = misses = 0;
+    }
+
+    // the prepared structure of dgCMatrix "s" from the cache, or computed and cached, or NULL if the cache is not used
+    //   or "s" is not a dgCMatrix
+    std::shared_ptr<preparedSparse> get(const Rcpp::S4& s, const unsigned int threads) {
+        if (limit_ == 0 || !s.hasSlot("x") || Rcpp::isRowCompressed(s)) return nullptr;
+        const matrixKey key(s);
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->key == key) {
+                entries.splice(entries.begin(), entries, it);
+                ++hits;
+                return entries.front().prepared;
+            }
+        }
+        ++misses;
+        entries.push_front({key, std::make_shared<preparedSparse>(s, threads)});
+        std::shared_ptr<preparedSparse> prepared = entries.front().prepared;
+        evict();
+        return prepared;
+    }
+
+   private:
+    struct matrixKey {
+        const void *i, *p, *x;
+        int rows, cols, nnz;
+        matrixKey(const Rcpp::S4& s) {
+            const Rcpp::IntegerVector i_ = s.slot("i"), p_ = s.slot("p"), Dim = s.slot("Dim");
+            const Rcpp::NumericVector x_ = s.slot("x");
+            i = i_.begin();
+            p = p_.begin();
+            x = x_.begin();
+            rows = Dim[0];
+            cols = Dim[1];
+            nnz = i_.size();
+        }
+        bool operator==(const matrixKey& other) const {
+            return i == other.i && p == other.p && x == other.x && rows == other.rows && cols == other.cols && nnz == other.nnz;
+        }
+    };
+
+    struct entry {
+        matrixKey key;
+        std::shared_ptr<preparedSparse> prepared;
+    };
+
+    size_t limit_ = 0;
+    std::list<entry> entries;  // most recently used first
+
+    // evict least recently used entries until the cache fits its limit. An entry that was just added is evicted last,
+    //   and only if it does not fit on its own, in which case it is still returned to the caller.
+    void evict() {
+        size_t n = bytes();
+        while (n > limit_ && !entries.empty()) {
+            n -= entries.back().prepared->bytes();
+            entries.pop_back();
+        }
+    }
+};
+
+// cache of the R session, which is never destroyed so that it does not release R objects after R has shut down
+inline matrixCache& sessionCache() {
+    static matrixCache* cache = new matrixCache();
+    return *cache;
+}
+
+}  // namespace RcppML
+
+#endif
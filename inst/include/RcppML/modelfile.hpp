@@ -0,0 +1,192 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_modelfile
+#define RcppML_modelfile
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#ifndef RcppML_half
+#include <RcppML/half.hpp>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define RCPPML_MODEL_MMAP
+#endif
+
+#define RCPPML_MODEL_MAGIC "RCPPMLMD"
+#define RCPPML_MODEL_VERSION 2
+#define RCPPML_MODEL_ALIGN 64
+
+namespace RcppML {
+
+// sections of a model file in addition to "w" and "d"
+enum model_file_flags { MODEL_GRAM = 1,
+                        MODEL_H = 2,
+                        MODEL_H_FLOAT16 = 4,
+                        MODEL_H_BFLOAT16 = 8 };
+
+// a factor model written to disk in a binary format that is read in place, so that models can be loaded to serve
+//   projections without parsing or copying them (see "projector")
+//  * file layout, in native byte order: "RCPPMLMD", uint32 version, k, features, samples, flags, then sections that each
+//      start at a multiple of 64 bytes: double w[k * features], d[k], "gram = ww^T" [k * k] if "MODEL_GRAM", and
+//      h[k * samples] if "MODEL_H", stored as 16-bit values rather than doubles if "MODEL_H_FLOAT16" or "MODEL_H_BFLOAT16"
+//      (see "half_format")
+//  * files without "h" in half precision are written as version 1, which earlier versions of RcppML also read
+//  * "w" is stored as factors by features, the layout in which projections gather it
+//  * where available, the file is memory-mapped read-only, so a loaded model is shared with the OS page cache and with
+//      other processes that load it. Otherwise, it is read into memory.
+//  * dimnames are not stored
+class modelFile {
+   public:
+    uint32_t k = 0, features = 0, samples = 0, flags = 0;
+
+    // read the header of "path" and map the file into memory
+    modelFile(const std::string& path) {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        if (!f) RcppML::fail("could not open '" + path + "'");
+        f.seekg(0, std::ios::end);
+        size = f.tellg();
+        f.seekg(0, std::ios::beg);
+        char magic[8];
+        uint32_t header[5];
+        if (!f.read(magic, 8) || !f.read((char*)header, sizeof(header)) || std::string(magic, 8) != RCPPML_MODEL_MAGIC)
+            RcppML::fail("'" + path + "' is not an RcppML model file");
+        if (header[0] < 1 || header[0] > RCPPML_MODEL_VERSION) RcppML::fail("'" + path + "' was written by an unsupported version of RcppML");
+        k = header[1];
+        features = header[2];
+        samples = header[3];
+        flags = header[4];
+        if (offset(SECTION_END) > size) RcppML::fail("'" + path + "' is truncated");
+        mapFile(path, f);
+    }
+
+    bool hasGram() const { return flags & MODEL_GRAM; }
+    bool hasH() const { return flags & MODEL_H; }
+
+    // format of "h" in half precision, or "HALF_NONE" if it is stored as doubles
+    int hFormat() const { return (flags & MODEL_H_FLOAT16) ? HALF_FLOAT16 : (flags & MODEL_H_BFLOAT16) ? HALF_BFLOAT16 : HALF_NONE; }
+
+    // sections of the file, or NULL if they were not written
+    const double* w() const { return section(SECTION_W); }
+    const double* d() const { return section(SECTION_D); }
+    const double* gram() const { return hasGram() ? section(SECTION_GRAM) : NULL; }
+    const double* h() const { return (hasH() && hFormat() == HALF_NONE) ? section(SECTION_H) : NULL; }
+    const uint16_t* hHalf() const { return (hasH() && hFormat() != HALF_NONE) ? (const uint16_t*)section(SECTION_H) : NULL; }
+
+    // the mapping or copy of the file, which keeps sections read in place valid for as long as it is held
+    std::shared_ptr<const char> data() const { return bytes; }
+
+    // true if the file is memory-mapped rather than read into memory
+    bool mapped() const { return is_mapped; }
+
+    // write "w" (factors by features), "d", "ww^T" if "gram", and "h" if not NULL to "path + '.tmp'", then rename it to
+    //   "path". This does not use the R API.
+    //  * "h_half" is "h" of "samples" columns already in half precision "h_format", written in place of "h"
+    static bool write(const std::string& path, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const bool gram,
+                      const Eigen::MatrixXd* h = NULL, const uint16_t* h_half = NULL, const uint32_t samples = 0,
+                      const int h_format = HALF_NONE) {
+        const uint32_t h_flags = h_half ? (MODEL_H | (h_format == HALF_FLOAT16 ? MODEL_H_FLOAT16 : MODEL_H_BFLOAT16)) : h ? MODEL_H : 0;
+        modelFile layout((uint32_t)w.rows(), (uint32_t)w.cols(), h_half ? samples : h ? (uint32_t)h->cols() : 0,
+                         (gram ? MODEL_GRAM : 0) | h_flags);
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream f(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!f) return false;
+            const uint32_t header[5] = {h_half ? 2u : 1u, layout.k, layout.features, layout.samples, layout.flags};
+            f.write(RCPPML_MODEL_MAGIC, 8);
+            f.write((const char*)header, sizeof(header));
+            layout.writeSection(f, SECTION_W, w.data(), w.size());
+            layout.writeSection(f, SECTION_D, d.data(), d.size());
+            if (gram) {
+                const Eigen::MatrixXd a = w * w.transpose();
+                layout.writeSection(f, SECTION_GRAM, a.data(), a.size());
+            }
+            if (h_half)
+                layout.writeSection(f, SECTION_H, h_half, (size_t)layout.k * samples);
+            else if (h)
+                layout.writeSection(f, SECTION_H, h->data(), h->size());
+            layout.writeSection(f, SECTION_END, (const double*)NULL, 0);
+            if (!f) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+   private:
+    enum section_id { SECTION_W,
+                      SECTION_D,
+                      SECTION_GRAM,
+                      SECTION_H,
+                      SECTION_END };
+
+    std::streamoff size = 0;
+    std::shared_ptr<const char> bytes;
+    bool is_mapped = false;
+
+    modelFile(const uint32_t k, const uint32_t features, const uint32_t samples, const uint32_t flags)
+        : k(k), features(features), samples(samples), flags(flags) {}
+
+    // offset of the start of section "s" in the file, after the header and all preceding sections
+    std::streamoff offset(const int s) const {
+        std::streamoff pos = 8 + 5 * sizeof(uint32_t);
+        const std::streamoff lengths[4] = {(std::streamoff)k * features, (std::streamoff)k, hasGram() ? (std::streamoff)k * k : 0,
+                                           hasH() ? (std::streamoff)k * samples : 0};
+        for (int i = 0; i < s; ++i) {
+            pos = aligned(pos);
+            pos += lengths[i] * ((i == SECTION_H && hFormat() != HALF_NONE) ? sizeof(uint16_t) : sizeof(double));
+        }
+        return s == SECTION_END ? pos : aligned(pos);
+    }
+
+    static std::streamoff aligned(const std::streamoff pos) {
+        return (pos + RCPPML_MODEL_ALIGN - 1) / RCPPML_MODEL_ALIGN * RCPPML_MODEL_ALIGN;
+    }
+
+    const double* section(const int s) const { return (const double*)(bytes.get() + offset(s)); }
+
+    // pad "f" to the start of section "s" and write "n" values to it
+    template <typename T>
+    void writeSection(std::ofstream& f, const int s, const T* x, const size_t n) const {
+        const std::streamoff pos = f.tellp(), start = offset(s);
+        for (std::streamoff i = pos; i < start; ++i) f.put(0);
+        if (n > 0) f.write((const char*)x, n * sizeof(T));
+    }
+
+    // map the file into memory, or read it if it cannot be mapped. Buffers from "new" are aligned for doubles.
+    void mapFile(const std::string& path, std::ifstream& f) {
+#ifdef RCPPML_MODEL_MMAP
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            void* addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (addr != MAP_FAILED) {
+                const size_t length = size;
+                bytes = std::shared_ptr<const char>((const char*)addr, [length](const char* a) { munmap((void*)a, length); });
+                is_mapped = true;
+                return;
+            }
+        }
+#endif
+        char* buffer = new char[(size_t)size];
+        bytes = std::shared_ptr<const char>(buffer, std::default_delete<const char[]>());
+        f.clear();
+        f.seekg(0, std::ios::beg);
+        if (!f.read(buffer, size)) RcppML::fail("could not read '" + path + "'");
+    }
+};
+
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,316 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_mtx
+#define RcppML_mtx
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RCPPML_MTX_MMAP
+#endif
+
+namespace RcppML {
+
+// PARALLEL READER OF MATRIX MARKET FILES
+//
+// A coordinate Matrix Market file (".mtx") is read into compressed sparse column arrays in two parallel passes over
+//   its text, rather than into triplets that are then sorted and compressed:
+//  * the file is memory-mapped where possible (and otherwise read once), and its entries are split into pieces of
+//      whole lines that threads parse independently
+//  * the first pass counts the entries of each column, from which the column pointers are found, and the second
+//      writes the row and value of each entry at the next free position of its column, so that the only memory
+//      used beyond the result is the text of the file and one counter for each column
+//  * entries of each column are then sorted by row (and duplicate entries by value), and duplicates are summed (as by
+//      "Matrix::readMM"), so that the result does not depend on the order in which threads wrote them
+//  * "real" and "integer" values are read as "double", and "pattern" files have no values. "symmetric" and
+//      "skew-symmetric" files are expanded to both triangles. Complex values and dense ("array") files are not read.
+class matrixMarket {
+   public:
+    uint32_t rows = 0, cols = 0;
+    size_t entries = 0;  // number of entries declared in the size line
+    bool pattern = false, symmetric = false, skew = false;
+
+    matrixMarket(const std::string& path) : path(path) {
+        mapFile();
+        const char* end = text + size;
+        if (size >= 2 && (unsigned char)text[0] == 0x1f && (unsigned char)text[1] == 0x8b)
+            RcppML::fail("'" + path + "' is compressed with gzip, and must be decompressed before it is read");
+        const char* line = text;
+        const char* next = nextLine(line, end);
+        std::string banner(line, next - line);
+        for (char& c : banner) c = std::tolower(c);
+        if (banner.compare(0, 14, "%%matrixmarket") != 0) RcppML::fail("'" + path + "' is not a Matrix Market file");
+        if (banner.find(" coordinate") == std::string::npos)
+            RcppML::fail("'" + path + "' is a dense Matrix Market file, and only coordinate (sparse) files are read");
+        if (banner.find(" complex") != std::string::npos || banner.find(" hermitian") != std::string::npos)
+            RcppML::fail("'" + path + "' has complex values, which are not supported");
+        pattern = banner.find(" pattern") != std::string::npos;
+        skew = banner.find(" skew-symmetric") != std::string::npos;
+        symmetric = skew || banner.find(" symmetric") != std::string::npos;
+
+        // the size line follows the banner and any comments
+        for (line = next; line < end && (*line == '%' || blankLine(line, end)); line = nextLine(line, end)) {
+        }
+        if (line >= end) RcppML::fail("'" + path + "' has no size line");
+        const char* s = line;
+        unsigned long long dims[3];
+        for (unsigned long long& d : dims)
+            if (!readIndex(s, end, d)) RcppML::fail("'" + path + "' has an invalid size line");
+        if (dims[0] > (unsigned long long)std::numeric_limits<int>::max() || dims[1] > (unsigned long long)std::numeric_limits<int>::max())
+            RcppML::fail("'" + path + "' has more rows or columns than a sparse matrix can index");
+        if (symmetric && dims[0] != dims[1]) RcppML::fail("'" + path + "' is symmetric but not square");
+        rows = dims[0];
+        cols = dims[1];
+        entries = dims[2];
+        body = nextLine(line, end);
+    }
+
+    // column pointers of the matrix, found by counting the entries of each column in parallel, with both triangles of
+    //   symmetric files
+    std::vector<int> columnPointers(const unsigned int threads) {
+        std::vector<int> counts(cols + 1, 0);
+        const size_t n = forEachEntry(threads, [&](const uint32_t i, const uint32_t j, const double) {
+            countEntry(counts[j + 1]);
+            if (symmetric && i != j) countEntry(counts[i + 1]);
+        });
+        if (n != entries) RcppML::fail("'" + path + "' has " + std::to_string(n) + " entries, but declares " + std::to_string(entries));
+        size_t nnz = 0;
+        for (uint32_t j = 1; j <= cols; ++j) {
+            nnz += counts[j];
+            if (nnz > (size_t)std::numeric_limits<int>::max())
+                RcppML::fail("'" + path + "' has more non-zeros than a sparse matrix can index");
+            counts[j] = nnz;
+        }
+        return counts;
+    }
+
+    // fill the rows "i" and values "x" (unless "pattern") of all columns given their pointers "p" (see
+    //   "columnPointers"), with rows of each column in increasing order and duplicate entries summed, returning the
+    //   number of non-zeros after duplicates are summed, by which "p", "i" and "x" are updated in place
+    size_t fill(int* p, int* i, double* x, const unsigned int threads) {
+        std::vector<int> next(p, p + cols);
+        forEachEntry(threads, [&](const uint32_t r, const uint32_t c, const double v) {
+            int k;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+            k = next[c]++;
+            i[k] = r;
+            if (x) x[k] = v;
+            if (symmetric && r != c) {
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+                k = next[r]++;
+                i[k] = c;
+                if (x) x[k] = skew ? -v : v;
+            }
+        });
+        return sortColumns(p, i, x, threads);
+    }
+
+   private:
+    std::string path;
+    std::shared_ptr<const char> map;  // the text of the file, mapped or read
+    const char* text = nullptr;
+    const char* body = nullptr;  // first line after the size line
+    size_t size = 0;
+
+    // map the file into memory, or read it if it cannot be mapped
+    void mapFile() {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        if (!f) RcppML::fail("could not open '" + path + "'");
+        f.seekg(0, std::ios::end);
+        size = f.tellg();
+        if (size == 0) RcppML::fail("'" + path + "' is empty");
+#ifdef RCPPML_MTX_MMAP
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (addr != MAP_FAILED) {
+                madvise(addr, size, MADV_SEQUENTIAL);
+                const size_t length = size;
+                map = std::shared_ptr<const char>((const char*)addr, [length](const char* a) { munmap((void*)a, length); });
+            }
+        }
+#endif
+        if (!map) {
+            char* buffer = new char[size];
+            f.seekg(0, std::ios::beg);
+            if (!f.read(buffer, size)) {
+                delete[] buffer;
+                RcppML::fail("could not read '" + path + "'");
+            }
+            map = std::shared_ptr<const char>(buffer, std::default_delete<const char[]>());
+        }
+        text = map.get();
+    }
+
+    static const char* nextLine(const char* s, const char* end) {
+        const char* nl = (const char*)std::memchr(s, '\n', end - s);
+        return nl ? nl + 1 : end;
+    }
+
+    static bool blankLine(const char* s, const char* end) {
+        for (; s < end && *s != '\n'; ++s)
+            if (!std::isspace((unsigned char)*s)) return false;
+        return true;
+    }
+
+    static void skipSpaces(const char*& s, const char* end) {
+        while (s < end && (*s == ' ' || *s == '\t' || *s == '\r')) ++s;
+    }
+
+    // read an unsigned integer at "s", advancing past it
+    static bool readIndex(const char*& s, const char* end, unsigned long long& value) {
+        skipSpaces(s, end);
+        if (s >= end || *s < '0' || *s > '9') return false;
+        value = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; ++s) value = value * 10 + (*s - '0');
+        return true;
+    }
+
+    // read a real number at "s", advancing past it. The token is copied so that "strtod" never reads past the end of
+    //   the mapped text.
+    static bool readValue(const char*& s, const char* end, double& value) {
+        skipSpaces(s, end);
+        char token[64];
+        size_t n = 0;
+        while (s + n < end && n < sizeof(token) - 1 && !std::isspace((unsigned char)s[n])) {
+            token[n] = s[n];
+            ++n;
+        }
+        if (n == 0) return false;
+        token[n] = '\0';
+        char* parsed;
+        value = std::strtod(token, &parsed);
+        s += n;
+        return parsed == token + n;
+    }
+
+    static void countEntry(int& count) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+        ++count;
+    }
+
+    // call "f(i, j, x)" with the 0-based row, column and value of each entry, from pieces of whole lines of the body
+    //   parsed in parallel, returning the number of entries. Entries out of range or that cannot be parsed stop the
+    //   read after the parallel region, with the offset of the first such line.
+    template <class F>
+    size_t forEachEntry(const unsigned int threads, F f) {
+        const char* end = text + size;
+        const size_t length = end - body;
+        const int n_pieces = std::max(1, (int)std::min<size_t>(length / (1 << 20) + 1, 64 * std::max(1u, threads)));
+        std::vector<const char*> starts(n_pieces + 1, end);
+        starts[0] = body;
+        for (int k = 1; k < n_pieces; ++k) starts[k] = std::max(starts[k - 1], nextLine(body + length * k / n_pieces - 1, end));
+        size_t n = 0;
+        const char* bad = end;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) reduction(+ : n)
+#endif
+        for (int k = 0; k < n_pieces; ++k) {
+            for (const char* line = starts[k]; line < starts[k + 1]; line = nextLine(line, end)) {
+                if (*line == '%' || blankLine(line, end)) continue;
+                const char* s = line;
+                unsigned long long i, j;
+                double x = 1;
+                if (!readIndex(s, end, i) || !readIndex(s, end, j) || (!pattern && !readValue(s, end, x)) || i < 1 || j < 1 ||
+                    i > rows || j > cols) {
+#ifdef _OPENMP
+#pragma omp critical(RcppML_mtx_error)
+#endif
+                    bad = std::min(bad, line);
+                    break;
+                }
+                f((uint32_t)(i - 1), (uint32_t)(j - 1), x);
+                ++n;
+            }
+        }
+        if (bad != end) {
+            std::string line(bad, nextLine(bad, end) - bad);
+            while (!line.empty() && std::isspace((unsigned char)line.back())) line.pop_back();
+            RcppML::fail("'" + path + "' has an invalid entry at byte " + std::to_string(bad - text) + ": " + line);
+        }
+        return n;
+    }
+
+    // sort the rows of each column and sum duplicate entries, returning the number of non-zeros
+    size_t sortColumns(int* p, int* i, double* x, const unsigned int threads) {
+        std::vector<int> kept(cols, 0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+        {
+            std::vector<std::pair<int, double> > column;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 256)
+#endif
+            for (int j = 0; j < (int)cols; ++j) {
+                int* i_j = i + p[j];
+                const int n = p[j + 1] - p[j];
+                if (x) {
+                    column.resize(n);
+                    for (int k = 0; k < n; ++k) column[k] = std::make_pair(i_j[k], x[p[j] + k]);
+                    std::sort(column.begin(), column.end());
+                } else {
+                    std::sort(i_j, i_j + n);
+                }
+                int m = 0;
+                for (int k = 0; k < n; ++k) {
+                    const int r = x ? column[k].first : i_j[k];
+                    if (m > 0 && i_j[m - 1] == r) {
+                        if (x) x[p[j] + m - 1] += column[k].second;
+                        continue;
+                    }
+                    i_j[m] = r;
+                    if (x) x[p[j] + m] = column[k].second;
+                    ++m;
+                }
+                kept[j] = m;
+            }
+        }
+
+        // shift columns down over summed duplicates, if there were any
+        size_t nnz = 0;
+        for (uint32_t j = 0; j < cols; ++j) {
+            const int start = p[j];
+            if ((size_t)start != nnz) {
+                std::memmove(i + nnz, i + start, kept[j] * sizeof(int));
+                if (x) std::memmove(x + nnz, x + start, kept[j] * sizeof(double));
+            }
+            p[j] = nnz;
+            nnz += kept[j];
+        }
+        p[cols] = nnz;
+        return nnz;
+    }
+};
+
+}  // namespace RcppML
+
+#endif
@@ -12,50 +12,138 @@
 #include <RcppML/predict.hpp>
 #endif
 
+#ifndef RcppML_checkpoint
+#include <RcppML/checkpoint.hpp>
+#endif
+
+#ifndef RcppML_threads
+#include <RcppML/threads.hpp>
+#endif
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_evaluate
+#include <RcppML/evaluate.hpp>
+#endif
+
+#include <atomic>
+#include <future>
+
+#if RCPPML_MPI
+#include <mpi.h>
+#endif
+
 namespace RcppML {
-template <class T>
+// progress of a fit that runs on another thread (see "nmfJob"), to which "nmf::fit" reports the iteration and "tol_"
+//   after each iteration, and through which another thread may ask the fit to stop after its current iteration
+struct fitProgress {
+    std::atomic<unsigned int> iter{0};
+    std::atomic<double> tol{1};
+    std::atomic<bool> cancel{false};
+};
+
+#if RCPPML_MPI
+// sum of "n" values at "x" over all ranks of "comm", in place, as the "allreduce" of "nmf::fit_distributed"
+struct mpiAllreduce {
+    MPI_Comm comm;
+    explicit mpiAllreduce(MPI_Comm comm = MPI_COMM_WORLD) : comm(comm) {}
+    void operator()(double* x, const size_t n) const { MPI_Allreduce(MPI_IN_PLACE, x, (int)n, MPI_DOUBLE, MPI_SUM, comm); }
+    void operator()(float* x, const size_t n) const { MPI_Allreduce(MPI_IN_PLACE, x, (int)n, MPI_FLOAT, MPI_SUM, comm); }
+};
+#endif
+
+// "T" is the input matrix type, either a sparse Rcpp::SparseMatrixOf<Value> (e.g. Rcpp::SparseMatrix) or a dense
+//   Eigen::Matrix<Scalar, -1, -1>, or an Eigen::Map of one so that a dense matrix owned by R is never copied
+// "Scalar" is the precision of the factor model and all least squares solutions (double or float)
+template <class T, typename Scalar = double>
 class nmf {
+    template <class, typename>
+    friend class nmf;  // models of column subsets of "A" (see "fit_cross_validate_samples")
+
+   public:
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+    typedef Eigen::Matrix<Scalar, -1, -1, Eigen::RowMajor> RowMatrixS;
+
    private:
     T& A;
-    T t_A;
+    std::shared_ptr<T> t_A;  // shared between copies of this model that are fit concurrently
     Rcpp::SparseMatrix mask_matrix = Rcpp::SparseMatrix(), t_mask_matrix;
-    Rcpp::SparseMatrix link_matrix_w = Rcpp::SparseMatrix(), link_matrix_h = Rcpp::SparseMatrix();
-    Eigen::MatrixXd w;
-    Eigen::VectorXd d;
-    Eigen::MatrixXd h;
+    std::shared_ptr<const maskIndex> mask_index, t_mask_index;  // merged streams of sparse "A" and "mask_matrix" (see "indexMask")
+    std::vector<std::shared_ptr<const memoryLease> > leases;    // bytes of allocations shared by copies (see "lease")
+    hash_mask hashed_mask;  // masking matrix given by a hash of each position, if "mask_hash"
+    linkIndex link_matrix_w, link_matrix_h;  // linked factors of each column of "w" and "h", if "link"
+    MatrixS w;
+    VectorS d;
+    MatrixS h;
     double tol_ = -1, mse_ = 0;
+    std::vector<double> losses_;  // mean squared error after each iteration, if "loss_tol"
+    std::vector<double> cd_tols_;  // coordinate descent tolerance of each iteration, if "inexact"
+    double stop_tol_ = cd_tol<Scalar>();  // coordinate descent tolerance of the current iteration
+    std::vector<double> frozen_;   // fraction of columns of "h" and "w" that were frozen in each iteration, if "freeze_tol"
+    freezer<Scalar> frozen_h, frozen_w;
+    bool freezing = false;
     unsigned int iter_ = 0, best_model_ = 0;
-    bool mask = false, mask_zeros = false, symmetric = false, transposed = false;
+    bool mask = false, mask_zeros = false, mask_hash = false, symmetric = false, transposed = false;
+    bool placed = false;  // "A" has been copied to the NUMA nodes of the threads that read it (see "placeA")
 
    public:
     bool verbose = true;
     unsigned int maxit = 100, threads = 0;
+    unsigned int threads_h = 0, threads_w = 0;  // threads of updates of "h" and "w", or 0 to choose from "threads" (see "fitPlan")
+    unsigned int loss_tile = PREDICT_TILE_SIZE;  // columns in each tile of losses of dense "A" (see "lossTile")
     std::vector<double> L1 = std::vector<double>(2), L2 = std::vector<double>(2);
     std::vector<bool> link = {false, false};
     bool sort_model = true;
     double upper_bound = 0;  // set to 0 or negative to not impose upper bound limit
+    int solver = NNLS_AUTO;  // solver for least squares updates without an upper bound (see "useActiveSet")
 
     double tol = 1e-4;
+    bool loss_tol = false;  // stop on relative change in loss, rather than correlation of "w" across iterations
+    bool inexact = false;   // loosen coordinate descent tolerance in early iterations (see "inexactTol")
+    double freeze_tol = 0;  // skip updates of columns whose solutions change by less than this (see "freezer")
+    bool hals = false;      // update factors by hierarchical alternating least squares (see "predict_hals")
+    std::vector<bool> nonneg = {true, true};  // constrain "w" and "h" to be non-negative, or solve them exactly (see "predict_unconstrained")
+    bool compress_indices = false;   // iterate over sparse "A" and "t(A)" from compressed row indices (see "compressIndices")
+    bool transpose = true;           // update "w" from the cached "t(A)" of sparse "A", or from "A" in place (see "predictRows")
+    int robust = ROBUST_NONE;        // robust loss of residuals at non-zeros of sparse "A" (see "reweight")
+    double robust_c = 0;             // threshold of the robust loss in robust standard deviations, or 0 for that of the loss
+    unsigned int batch_size = 1000;  // number of columns in each minibatch of "fit_online"
+    double decay = 0.9;              // weight of sufficient statistics from previous minibatches in "fit_online"
+    unsigned int race = 0;           // iterations in each round of racing restarts, or 0 to fit each to convergence (see "fit_race")
+    double race_tol = 0;             // relative loss within which restarts are never dropped from a race
+    std::string checkpoint_path;     // file to which the state of the fit is written every "checkpoint_every" iterations
+    unsigned int checkpoint_every = 0;
+    bool accelerate = false;         // extrapolate "w" and "h" along their last step where it reduces the loss (see "fitExtrapolated")
+    unsigned int anderson = 0;       // number of past steps of "w" mixed by Anderson acceleration, or 0 (see "fitAnderson")
+    double subsample = 0;            // fraction of columns from which "w" is updated in each iteration of "fit_subsampled"
+    bool profile = false;            // record the time of each phase and the work done in each iteration of "fit" (see "fitProfile")
+    fitProgress* progress = NULL;    // reported to by "fit" after each iteration, if given (see "reportProgress")
+    Eigen::ArrayXd* col_losses = NULL;  // set by unmasked updates of "h" to the loss of each column, if given (see "predict_unmasked")
+    bool warm_h = false;  // "predictH" begins from "h" as given, such as that of an earlier projection (see "predict_unmasked")
+    double skip_tol = 0;  // with "warm_h", columns of "h" that already meet this tolerance are kept (see "c_nnls_converged")
 
     // CONSTRUCTORS
     // constructor for initialization with a randomly generated "w" matrix
     nmf(T& A, const unsigned int k, const unsigned int seed = 0) : A(A) {
-        w = randomMatrix(k, A.rows(), seed);
-        h = Eigen::MatrixXd(k, A.cols());
-        d = Eigen::VectorXd::Ones(k);
+        w = randomMatrix(k, A.rows(), seed).template cast<Scalar>();
+        h = MatrixS(k, A.cols());
+        d = VectorS::Ones(k);
         isSymmetric();
     }
 
     // constructor for initialization with an initial "w" matrix
-    nmf(T& A, Eigen::MatrixXd w) : A(A), w(w) {
+    nmf(T& A, MatrixS w) : A(A), w(w) {
         if (A.rows() != w.cols()) Rcpp::stop("number of rows in 'A' and columns in 'w' are not equal!");
-        d = Eigen::VectorXd::Ones(w.rows());
-        h = Eigen::MatrixXd(w.rows(), A.cols());
+        d = VectorS::Ones(w.rows());
+        h = MatrixS(w.rows(), A.cols());
         isSymmetric();
     }
 
     // constructor for initialization with a fully-specified model
-    nmf(T& A, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h) : A(A), w(w), d(d), h(h) {
+    nmf(T& A, MatrixS w, VectorS d, MatrixS h) : A(A), w(w), d(d), h(h) {
         if (A.rows() != w.cols()) Rcpp::stop("dimensions of 'w' and 'A' are not compatible");
         if (A.cols() != h.cols()) Rcpp::stop("dimensions of 'h' and 'A' are not compatible");
         if (w.rows() != h.rows()) Rcpp::stop("rank of 'w' and 'h' are not equal!");
@@ -64,14 +152,14 @@ class nmf {
     }
 
     // SETTERS
-    void isSymmetric();
+    void isSymmetric() { symmetric = isAppxSymmetric(A); }
     void maskZeros() {
-        if (mask) Rcpp::stop("a masking function has already been specified");
+        if (mask || mask_hash) Rcpp::stop("a masking function has already been specified");
         mask_zeros = true;
     }
 
     void maskMatrix(Rcpp::SparseMatrix& m) {
-        if (mask) Rcpp::stop("a masking function has already been specified");
+        if (mask || mask_hash) Rcpp::stop("a masking function has already been specified");
         if (m.rows() != A.rows() || m.cols() != A.cols()) Rcpp::stop("dimensions of masking matrix and 'A' are not equivalent");
         if (mask_zeros) Rcpp::stop("you already specified to mask zeros. You cannot also supply a masking matrix.");
         mask = true;
@@ -79,9 +167,18 @@ class nmf {
         if (symmetric) symmetric = mask_matrix.isAppxSymmetric();
     }
 
+    // mask values by a hash of their position rather than by a stored masking matrix (see "hash_mask")
+    void maskMatrix(const hash_mask& m) {
+        if (mask || mask_hash) Rcpp::stop("a masking function has already been specified");
+        if (mask_zeros) Rcpp::stop("you already specified to mask zeros. You cannot also supply a masking matrix.");
+        mask_hash = true;
+        hashed_mask = m;
+        symmetric = false;
+    }
+
     void linkH(Rcpp::SparseMatrix& l) {
         if (l.cols() == A.cols())
-            link_matrix_h = l;
+            link_matrix_h = linkIndex(l);
         else
             Rcpp::stop("dimensions of linking matrix and 'A' are not equivalent");
         link[1] = true;
@@ -89,7 +186,7 @@ class nmf {
 
     void linkW(Rcpp::SparseMatrix& l) {
         if (l.cols() == A.rows())
-            link_matrix_w = l;
+            link_matrix_w = linkIndex(l);
         else
             Rcpp::stop("dimensions of linking matrix and 'A' are not equivalent");
         link[0] = true;
@@ -100,21 +197,52 @@ class nmf {
         upper_bound = upperbound;
     }
 
+    // use a precomputed transpose of "A" (see "prepare_matrix" in R), rather than computing it on first use
+    void setTranspose(T& t) {
+        if (t.rows() != A.cols() || t.cols() != A.rows()) Rcpp::stop("dimensions of 't(A)' and 'A' are not compatible");
+        t_A = std::make_shared<T>(t);
+    }
+
+    // use a precomputed squared Frobenius norm of "A" for loss-based convergence, rather than computing it on first use
+    void setSquaredNorm(const double sq_norm) { A_sq = sq_norm; }
+
+    // resume "fit_online" from sufficient statistics of a previous fit
+    void onlineStats(MatrixS a, MatrixS B, VectorS hsum) {
+        if (a.rows() != w.rows() || a.cols() != w.rows() || B.rows() != w.rows() || B.cols() != A.rows() || hsum.size() != w.rows())
+            Rcpp::stop("dimensions of online sufficient statistics are not compatible with 'w' and 'A'");
+        online_a = a;
+        online_B = B;
+        online_hsum = hsum;
+    }
+
     // GETTERS
-    Eigen::MatrixXd matrixW() { return w; }
-    Eigen::VectorXd vectorD() { return d; }
-    Eigen::MatrixXd matrixH() { return h; }
+    //  * factors are returned by reference, so that they are copied once into R memory rather than first into a temporary
+    const MatrixS& matrixW() const { return w; }
+    const VectorS& vectorD() const { return d; }
+    const MatrixS& matrixH() const { return h; }
     double fit_tol() { return tol_; }
     unsigned int fit_iter() { return iter_; }
     double fit_mse() { return mse_; }
+    std::vector<double> fit_losses() { return losses_; }
+    std::vector<double> fit_cd_tols() { return cd_tols_; }
+    std::vector<double> fit_frozen() { return frozen_; }
     unsigned int best_model() { return best_model_; }
+    MatrixS onlineGramH() { return online_a; }
+    MatrixS onlineHAt() { return online_B; }
+    VectorS onlineSumH() { return online_hsum; }
+    const std::vector<Scalar>& robustWeights() const { return robust_w; }  // of non-zeros of "A" in column-major order
+    double robustScale() const { return robust_scale_; }
+    const fitProfile& fit_profile() {
+        profile_.flush();
+        return profile_;
+    }
 
     // FUNCTIONS
     void sortByDiagonal() {
         if (w.rows() == 2 && d(0) < d(1)) {
             w.row(1).swap(w.row(0));
             h.row(1).swap(h.row(0));
-            const double d1 = d(1);
+            const Scalar d1 = d(1);
             d(1) = d(0);
             d(0) = d1;
         } else if (w.rows() > 2) {
@@ -125,247 +253,2129 @@ class nmf {
         }
     }
 
-    // scale rows in "w" to sum to 1, where "d" is rowsums of "w"
-    void scaleW() {
-        d = w.rowwise().sum();
-        d.array() += TINY_NUM;
-        for (unsigned int i = 0; i < w.rows(); ++i)
-            for (unsigned int j = 0; j < w.cols(); ++j)
-                w(i, j) /= d(i);
-    };
+    // scale rows in "w" to sum to 1, where "d" is rowsums of "w" (see "scaleRows")
+    void scaleW() { scaleRows(w); }
 
-    // scale rows in "h" to sum to 1, where "d" is rowsums of "h"
-    void scaleH() {
-        d = h.rowwise().sum();
-        d.array() += TINY_NUM;
-        for (unsigned int i = 0; i < h.rows(); ++i)
-            for (unsigned int j = 0; j < h.cols(); ++j)
-                h(i, j) /= d(i);
-    };
+    // scale rows in "h" to sum to 1, where "d" is rowsums of "h" (see "scaleRows")
+    void scaleH() { scaleRows(h); }
 
     // project "w" onto "A" to solve for "h" in the equation "A = wh"
+    //  * in "hals" mode, "h" is warm-started from its last solution, rescaled by "d" to the scale of the new solution
+    //  * rank-1 models are solved by a single matrix-vector product (see "predict_rank1")
+    //  * an unconstrained "h" is solved exactly from one factorization of "ww^T" (see "predict_unconstrained")
+    //  * masked updates are warm-started from the last solution, rescaled in the same way (see "warmStart"), and all
+    //      updates from "h" as given with "warm_h"
     void predictH() {
-        predict(A, mask_matrix, link_matrix_h, w, h, L1[1], L2[1], threads, mask_zeros, mask, link[1], upper_bound);
+        phaseTimer timer(profiler(), PHASE_H);
+        if (profile) profile_.addValues(valuesIn(A));
+        const unsigned int n_threads = updateThreads(A.cols(), A.rows(), threads_h);
+        if (!nonneg[1]) {
+            predict_unconstrained(A, w, h, L1[1], L2[1], n_threads);
+            return;
+        }
+        if (hals) {
+            h.array().colwise() *= d.array();
+            predict_hals(A, w, h, L1[1], L2[1], n_threads, upper_bound);
+            return;
+        }
+        if (rank1()) {
+            predict_rank1(A, w, h, L1[1], L2[1], n_threads, upper_bound);
+            return;
+        }
+        const bool warm = warm_h || warmStart();
+        if (warm) h.array().colwise() *= d.array();
+        if (predictReweighted(A, robust_w, w, h, L1[1], L2[1], n_threads, warm)) return;
+        if (mask_hash) {
+            predict_hashed(A, hashed_mask, link_matrix_h, w, h, L1[1], L2[1], n_threads, link[1], upper_bound, solver, stop_tol_, warm);
+            return;
+        }
+        indexMask(A);
+        predict(A, mask_matrix, link_matrix_h, w, h, L1[1], L2[1], n_threads, mask_zeros, mask, link[1], upper_bound, solver, stop_tol_, NULL,
+                freezing ? &frozen_h : NULL, warm, mask_index.get(), col_losses, warm_h ? skip_tol : 0);
     }
 
     // project "h" onto "t(A)" to solve for "w"
-    void predictW() {
+    //  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2" (unmasked, unlinked models only)
+    void predictW(double* loss = NULL) {
+        if (!symmetric) transposeA();  // timed apart from the update (see "transposeA")
+        phaseTimer timer(profiler(), PHASE_W);
+        if (profile) profile_.addValues(valuesIn(A));
+        const unsigned int n_threads = updateThreads(A.rows(), A.cols(), threads_w);
+        if (!nonneg[0]) {
+            if (symmetric)
+                predict_unconstrained(A, h, w, L1[0], L2[0], n_threads, loss);
+            else
+                predict_unconstrained(transposedA(A), h, w, L1[0], L2[0], n_threads, loss);
+            return;
+        }
+        if (hals) {
+            w.array().colwise() *= d.array();
+            if (symmetric)
+                predict_hals(A, h, w, L1[0], L2[0], n_threads, upper_bound, loss);
+            else
+                predict_hals(transposedA(A), h, w, L1[0], L2[0], n_threads, upper_bound, loss);
+            return;
+        }
+        if (rank1()) {
+            if (symmetric)
+                predict_rank1(A, h, w, L1[0], L2[0], n_threads, upper_bound, loss);
+            else
+                predict_rank1(transposedA(A), h, w, L1[0], L2[0], n_threads, upper_bound, loss);
+            return;
+        }
+        if (predictRows(A, n_threads, loss)) return;
+        const bool warm = warmStart();
+        if (warm) w.array().colwise() *= d.array();
+        if (!t_robust_w.empty()) {
+            if (symmetric)
+                predictReweighted(A, t_robust_w, h, w, L1[0], L2[0], n_threads, warm);
+            else
+                predictReweighted(transposedA(A), t_robust_w, h, w, L1[0], L2[0], n_threads, warm);
+            return;
+        }
+        if (mask_hash) {
+            predict_hashed(transposedA(A), hashed_mask.transpose(), link_matrix_w, h, w, L1[0], L2[0], n_threads, link[0], upper_bound, solver,
+                           stop_tol_, warm);
+            return;
+        }
+        indexMask(A);
         if (symmetric)
-            predict(A, mask_matrix, link_matrix_w, h, w, L1[0], L2[0], threads, mask_zeros, mask, link[0], upper_bound);
+            predict(A, mask_matrix, link_matrix_w, h, w, L1[0], L2[0], n_threads, mask_zeros, mask, link[0], upper_bound, solver, stop_tol_,
+                    loss, freezing ? &frozen_w : NULL, warm, mask_index.get());
         else {
-            if (!transposed) {
-                t_A = A.transpose();
-                if (mask) t_mask_matrix = mask_matrix.transpose();
-                transposed = true;
-            }
-            predict(t_A, t_mask_matrix, link_matrix_w, h, w, L1[0], L2[0], threads, mask_zeros, mask, link[0], upper_bound);
+            predict(transposedA(A), t_mask_matrix, link_matrix_w, h, w, L1[0], L2[0], n_threads, mask_zeros, mask, link[0], upper_bound, solver,
+                    stop_tol_, loss, freezing ? &frozen_w : NULL, warm, t_mask_index.get());
         }
     };
 
     // requires specialized dense and sparse backends
-    double mse();
-    double mse_masked();
+    double mse() {
+        phaseTimer timer(profiler(), PHASE_MSE);
+        return mse(A);
+    }
+    double mse_masked() {
+        phaseTimer timer(profiler(), PHASE_MSE);
+        return mse_masked(A);
+    }
+
+    // resume from the checkpoint at "checkpoint_path" written by an interrupted fit of this model, if there is one
+    //  * the next "fit" (or the fit of the same restart in "fit_restarts") continues from the iteration after the
+    //      checkpoint, exactly as the interrupted fit would have
+    //  * returns false if there is no checkpoint. Checkpoints are renamed into place once they are fully written, so
+    //      a fit that is killed while writing leaves the last complete checkpoint.
+    //  * a checkpoint of another rank, dimensions, number of values, tolerance or penalties is not resumed, since its
+    //      fit would not continue to the model of this one
+    bool resume() {
+        std::shared_ptr<checkpoint> c = std::make_shared<checkpoint>();
+        if (!c->read(checkpoint_path)) return false;
+        if (c->w.rows() != w.rows() || c->w.cols() != A.rows() || c->h.cols() != A.cols())
+            Rcpp::stop("checkpoint '" + checkpoint_path + "' is not of a model with the rank and dimensions of this model");
+        double fingerprint[6];
+        checkpointFingerprint(fingerprint);
+        if (!std::equal(fingerprint, fingerprint + 6, c->fingerprint))
+            Rcpp::stop("checkpoint '" + checkpoint_path + "' is of a fit of other data, or with another 'tol', 'L1' or 'L2'");
+        resumed = c;
+        return true;
+    }
 
     // fit the model by alternating least squares projections
+    //  * if "freeze_tol" is given, columns of "h" and "w" whose solutions have stopped changing are skipped in
+    //      updates without masking (see "freezer"). The correlation of "w" across iterations and the loss include
+    //      frozen columns at their last solutions.
     void fit() {
+        if (!checked) checkFit();
+        if (resumed) {
+            if (resumed->restart != restart_) Rcpp::stop("checkpoint is of a restart that is not in 'seed'");
+            applyCheckpoint(*resumed);
+            resumed.reset();
+        }
         if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        const profileScope profiling(profile);
+        const numaPlacement placement(threadCosts().numa, threads);
+        placeA(A);
+        adviseHugePages(w);
+        adviseHugePages(h);
+        if (iter_ == 0) {
+            profile_.clear();
+            losses_.clear();
+            cd_tols_.clear();
+            frozen_.clear();
+            losses_.reserve(maxit);
+            cd_tols_.reserve(maxit);
+            frozen_.reserve(maxit);
+            frozen_h = freezer<Scalar>(freeze_tol, h.cols());
+            frozen_w = freezer<Scalar>(freeze_tol, w.cols());
+            h_ahead = false;
+            h_it.resize(0, 0);
+            beta_ = 0.5;
+            beta_max_ = 1;
+            anderson_g.clear();
+            anderson_f.clear();
+            last_loss_ = std::numeric_limits<double>::infinity();
+        }
+        freezing = freeze_tol > 0 && !mask && !mask_zeros && !mask_hash && !hals && robust == ROBUST_NONE && !rank1();
+        if (compress_indices) compressIndices(A);
 
         // alternating least squares updates
         for (; iter_ < maxit; ++iter_) {
-            Eigen::MatrixXd w_it = w;
-            predictH();  // update "h"
-            scaleH();
-            predictW();  // update "w"
-            scaleW();
-            tol_ = cor(w, w_it);  // correlation between "w" across consecutive iterations
+            if (rank1()) {
+                fitRank1();
+                if (profile) profile_.endIteration();
+                if (verbose) Rprintf("%4d | %8.2e\n", iter_ + 1, tol_);
+                if (reportProgress() || tol_ < tol) break;
+                if (checkpointDue()) writeCheckpoint();
+                if (interruptible) Rcpp::checkUserInterrupt();
+                continue;
+            }
+            if (inexact) {
+                stop_tol_ = inexactTol<Scalar>(cd_tols_.empty() ? 0 : cd_tols_.back(), tol_);
+                cd_tols_.push_back(stop_tol_);
+            }
+            if (freezing) frozen_.push_back((double)(frozen_h.n_frozen() + frozen_w.n_frozen()) / (h.cols() + w.cols()));
+            if (robust != ROBUST_NONE && iter_ > 0) reweight(A);
+            if (accelerate) {
+                fitExtrapolated();
+            } else if (anderson > 0) {
+                fitAnderson();
+            } else if (loss_tol) {
+                double loss = 0;
+                if (!h_ahead) {
+                    predictH();
+                    scaleH();
+                }
+                h_ahead = false;
+                frozen_h.scale = d;
+                predictW(lossFromGram() ? &loss : NULL);
+                scaleW();
+                frozen_w.scale = d;
+                if (lossAhead())
+                    updateLossAhead();  // as "updateLoss", while "h" of the next iteration is updated
+                else
+                    updateLoss(loss);  // relative change in loss across consecutive iterations
+            } else {
+                w_it = w;
+                predictH();  // update "h"
+                scaleH();
+                frozen_h.scale = d;
+                predictW(racing && lossFromGram() ? &race_loss_ : NULL);  // update "w"
+                tol_ = scaleRows(w, &w_it);  // correlation between "w" across consecutive iterations
+                frozen_w.scale = d;
+            }
+            if (profile) profile_.endIteration();
             if (verbose) Rprintf("%4d | %8.2e\n", iter_ + 1, tol_);
-            if (tol_ < tol) break;
-            Rcpp::checkUserInterrupt();
+            if (reportProgress() || tol_ < tol) break;
+            if (checkpointDue()) writeCheckpoint();
+            if (interruptible) Rcpp::checkUserInterrupt();
         }
+        if (checkpoint_writer && !checkpoint_writer->wait()) Rcpp::stop("could not write checkpoint to '" + checkpoint_path + "'");
 
         if (tol_ > tol && iter_ == maxit && verbose)
             Rprintf(" convergence not reached in %d iterations\n  (actual tol = %4.2e, target tol = %4.2e)\n", iter_, tol_, tol);
 
+        stop_tol_ = cd_tol<Scalar>();
+        freezing = false;
+        if (robust != ROBUST_NONE) reweight(A);  // weights of the returned model
         if (sort_model) sortByDiagonal();
     }
 
+    // stop if options of "fit" are not compatible
+    //  * drivers that fit copies of the model on worker threads call this on the main thread first and mark the copies
+    //      "checked", since "Rcpp::stop" cannot be called from a worker thread
+    void checkFit() {
+        if (hals && (mask || mask_zeros || mask_hash || link[0] || link[1]))
+            Rcpp::stop("hals updates do not support masking or linking");
+        if (checkpoint_every > 0 && freeze_tol > 0) Rcpp::stop("fits with 'freeze_tol' cannot be checkpointed");
+        if ((!nonneg[0] || !nonneg[1]) && (mask || mask_zeros || mask_hash || link[0] || link[1] || hals || upper_bound > 0 ||
+                                           freeze_tol > 0 || accelerate || anderson > 0))
+            Rcpp::stop("unconstrained updates do not support masking, linking, hals, 'upper_bound', 'freeze_tol' or acceleration");
+        if (accelerate && anderson > 0) Rcpp::stop("fits cannot be accelerated by both extrapolation and Anderson mixing");
+        if (!transpose && (mask || mask_zeros || mask_hash || link[0] || hals || !nonneg[0] || freeze_tol > 0))
+            Rcpp::stop("updates of 'w' without the transpose of 'A' do not support masking, linking of 'w', hals, unconstrained 'w' or 'freeze_tol'");
+        if ((accelerate || anderson > 0) && (!lossFromGram() || freeze_tol > 0 || checkpoint_every > 0))
+            Rcpp::stop("accelerated fits do not support masking, linking of 'w', 'freeze_tol' or checkpoints");
+        if (robust != ROBUST_NONE && (!sparseA(A) || mask || mask_zeros || mask_hash || link[0] || link[1] || hals || !nonneg[0] ||
+                                      !nonneg[1] || !transpose || compress_indices))
+            Rcpp::stop("robust losses are only supported for non-negative als updates of sparse 'A' with its transpose, without masking, linking or compressed indices");
+    }
+
+    // do everything in "fit" that needs the R API, so that "fit" can then run on a thread other than the main R thread
+    //   (see "nmfJob"): check options, and copy "A" to NUMA nodes and cache its transpose, which allocate R vectors
+    //  * "fit" then does not print or check for user interrupts, and cannot be checkpointed, profiled or resumed
+    void prepareThreaded() {
+        checkFit();
+        if (checkpoint_every > 0 || profile || resumed) Rcpp::stop("fits on another thread cannot be checkpointed, profiled or resumed");
+        verbose = false;
+        interruptible = false;
+        const numaPlacement placement(threadCosts().numa, threads);
+        placeA(A);
+        // rank-1 fits read "t(A)" too (see "fitRank1"), unless "A" is symmetric
+        if (!rank1() || !symmetric) transposeA();
+    }
+
     // fit the model multiple times and return the best one
     void fit_restarts(Rcpp::List& w_init) {
-        Eigen::MatrixXd w_best = w;
-        Eigen::MatrixXd h_best = h;
-        Eigen::VectorXd d_best = d;
+        checkFit();
+        // convert and check all initializations up front, since this requires the R API. Random initializations are
+        //   drawn from their seeds only when each restart is fit.
+        std::vector<initW> w_inits(w_init.length());
+        for (unsigned int i = 0; i < w_inits.size(); ++i) {
+            w_inits[i] = asInitW(w_init[i]);
+            if (w_inits[i].rank() != h.rows()) Rcpp::stop("rank of 'w' is not equal to rank of 'h'");
+            if (w_inits[i].w.size() > 0 && w_inits[i].w.cols() != A.rows()) Rcpp::stop("dimensions of 'w' and 'A' are not compatible");
+        }
+
+        // every restart begins from the same "h", so results do not depend on the order in which restarts are fit
+        const MatrixS h_init = h;
+        if (race > 0) {
+            if (checkpoint_every > 0) Rcpp::stop("raced restarts cannot be checkpointed");
+            fit_race(w_inits, h_init);
+            return;
+        }
+        // restarts are fit one at a time when checkpointing, so that each checkpoint is of a single restart
+        const unsigned int n_concurrent = (checkpoint_every == 0) ? concurrentRestarts(w_inits.size()) : 1;
+        if (n_concurrent > 1) {
+            fit_concurrent(w_inits, n_concurrent);
+            return;
+        }
+
+        // factors of the best restart are swapped out of the model rather than copied, since the next restart draws a new
+        //   "w" and begins from "h_init"
+        MatrixS w_best, h_best;
+        VectorS d_best = d;
+        const memoryLease best(MEM_RESTARTS, (double)(h_init.size() + w.size() + h.size() + d.size()) * sizeof(Scalar));
         double tol_best = tol_;
+        std::vector<double> losses_best = losses_, cd_tols_best = cd_tols_, frozen_best = frozen_;
         double mse_best = 0;
-        for (unsigned int i = 0; i < w_init.length(); ++i) {
+        bool has_best = false;
+        unsigned int first = 0;
+        if (resumed) {
+            // restarts before the checkpoint are not fit again, but the best of them is read from the checkpoint
+            if (resumed->restart >= w_inits.size()) Rcpp::stop("checkpoint is of a restart that is not in 'seed'");
+            first = resumed->restart;
+            if (resumed->best_restart >= 0) {
+                has_best = true;
+                best_model_ = resumed->best_restart;
+                w_best = resumed->w_best.template cast<Scalar>();
+                h_best = resumed->h_best.template cast<Scalar>();
+                d_best = resumed->d_best.template cast<Scalar>();
+                tol_best = resumed->best_tol;
+                mse_best = resumed->best_mse;
+                losses_best = resumed->best_losses;
+                cd_tols_best = resumed->best_cd_tols;
+            }
+        }
+        for (unsigned int i = first; i < w_inits.size(); ++i) {
             if (verbose) Rprintf("Fitting model %i/%i:", i + 1, w_init.length());
-            w = Rcpp::as<Eigen::MatrixXd>(w_init[i]);
+            w = w_inits[i].matrix(A.rows()).template cast<Scalar>();
+            h = h_init;
             tol_ = 1;
             iter_ = 0;
-            if (w.rows() != h.rows()) Rcpp::stop("rank of 'w' is not equal to rank of 'h'");
-            if (w.cols() != A.rows()) Rcpp::stop("dimensions of 'w' and 'A' are not compatible");
+            restart_ = i;
             fit();
             mse_ = mse();
             if (verbose) Rprintf("MSE: %8.4e\n\n", mse_);
-            if (i == 0 || mse_ < mse_best) {
+            if (!has_best || mse_ < mse_best) {
+                has_best = true;
                 best_model_ = i;
-                w_best = w;
-                h_best = h;
+                w_best.swap(w);
+                h_best.swap(h);
                 d_best = d;
                 tol_best = tol_;
                 mse_best = mse_;
+                losses_best = losses_;
+                cd_tols_best = cd_tols_;
+                frozen_best = frozen_;
+                if (checkpoint_every > 0) checkpointBest(w_best, d_best, h_best, tol_best, mse_best, losses_best, cd_tols_best);
             }
         }
-        if (best_model_ != (w_init.length() - 1)) {
-            w = w_best;
-            h = h_best;
-            d = d_best;
-            tol_ = tol_best;
-            mse_ = mse_best;
+        restart_ = 0;
+        w.swap(w_best);
+        h.swap(h_best);
+        d = d_best;
+        tol_ = tol_best;
+        mse_ = mse_best;
+        losses_.swap(losses_best);
+        cd_tols_.swap(cd_tols_best);
+        frozen_.swap(frozen_best);
+    }
+
+    // residual of column "j" of "A" given "wd", zero at values masked by "mask" or "mask_hash"
+    VectorS unmaskedResidual(const MatrixS& wd, const int j) {
+        VectorS r = residual(A, wd, j);
+        if (mask)
+            for (const int row : mask_matrix.InnerIndexView(j)) r(row) = 0;
+        else if (mask_hash)
+            for (unsigned int row = 0; row < r.size(); ++row)
+                if (hashed_mask(row, j)) r(row) = 0;
+        return r;
+    }
+
+    // add "n" factors to the model, seeded from the residual "A - wdh" of the samples it fits worst, so that it can be
+    //   refit at a higher rank from its current solution
+    //  * samples are ranked by their squared residual by the Gram identity, as in "mse_gram", or with "mask" or
+    //      "mask_hash" by their residual at unmasked values only, so that held-out values of cross-validation do not
+    //      choose the new factors
+    //  * each new row of "w" is the positive part of the residual of one of the "n" worst samples at unmasked values,
+    //      scaled to sum to 1. New rows of "h" are zero and are solved in the first update of "fit".
+    void addFactors(const unsigned int n) {
+        if (n == 0) return;
+        const unsigned int k = w.rows();
+        MatrixS wd = d.asDiagonal() * w;
+        Eigen::VectorXd norms;
+        if (mask || mask_hash) {
+            norms.resize(h.cols());
+            RcppML::forEach(h.cols(), threads, [&](const int j) { norms(j) = unmaskedResidual(wd, j).template cast<double>().squaredNorm(); });
+        } else {
+            norms = residualNorms(A, wd);
+        }
+        const std::vector<int> worst = sort_index(norms);
+        w.conservativeResize(k + n, Eigen::NoChange);
+        d.conservativeResize(k + n);
+        h.conservativeResize(k + n, Eigen::NoChange);
+        for (unsigned int f = 0; f < n; ++f) {
+            const int j = worst[f % worst.size()];
+            const VectorS r = unmaskedResidual(wd, j).cwiseMax((Scalar)0);
+            const Scalar r_sum = r.sum();
+            if (r_sum > TINY_NUM)
+                w.row(k + f) = r.transpose() / r_sum;
+            else
+                w.row(k + f).setConstant((Scalar)1 / w.cols());
+            d(k + f) = 1;
+            h.row(k + f).setZero();
         }
     }
-};
 
-// nmf class methods with specialized dense/sparse backends
-template <>
-void nmf<Rcpp::SparseMatrix>::isSymmetric() {
-    symmetric = A.isAppxSymmetric();
-}
-
-template <>
-void nmf<Eigen::MatrixXd>::isSymmetric() {
-    symmetric = isAppxSymmetric(A);
-}
-
-template <>
-double nmf<Rcpp::SparseMatrix>::mse() {
-    Eigen::MatrixXd w0 = w.transpose();
-    // multiply w by diagonal
-    for (unsigned int i = 0; i < w0.cols(); ++i)
-        for (unsigned int j = 0; j < w0.rows(); ++j)
-            w0(j, i) *= d(i);
+    // fit the model at each of the increasing "ranks", beginning from the current "w" at the first rank and warm-starting
+    //   each higher rank from the solution at the previous rank, with new factors seeded from the residual (see "addFactors")
+    //  * "t(A)", the transposed masking matrix and "||A||^2" are computed at most once for all ranks
+    //  * "fitted" is called with the model after it is fit at each rank
+    template <class Callback>
+    void fit_rank_path(const std::vector<unsigned int>& ranks, Callback fitted) {
+        for (unsigned int i = 0; i < ranks.size(); ++i) {
+            if (i > 0) addFactors(ranks[i] - ranks[i - 1]);
+            tol_ = 1;
+            iter_ = 0;
+            fit();
+            fitted(*this);
+        }
+    }
+
+    // fit the model at each of the penalties "L1s[i]" and "L2s[i]", sharing "A" and "t(A)" across all models
+    //  * with "path", penalties are fit in order, each warm-started from the model at the previous penalties as along a
+    //      rank path (see "fit_rank_path")
+    //  * otherwise, each is fit from the current "w" on copies of this model, concurrently as restarts are (see
+    //      "concurrentRestarts")
+    //  * "fitted" is called with the model at each penalty, in order, with its mean squared error
+    template <class Callback>
+    void fit_penalty_grid(const std::vector<std::vector<double> >& L1s, const std::vector<std::vector<double> >& L2s, const bool path,
+                          Callback fitted) {
+        checkFit();
+        if (path) {
+            for (unsigned int i = 0; i < L1s.size(); ++i) {
+                L1 = L1s[i];
+                L2 = L2s[i];
+                tol_ = 1;
+                iter_ = 0;
+                fit();
+                mse_ = mse();
+                fitted(*this);
+            }
+            return;
+        }
+        const unsigned int n_concurrent = concurrentRestarts(L1s.size());
+        if (!symmetric) transposeA();
+        if (verbose) Rprintf("Fitting %i models on %i concurrent threads\n", (int)L1s.size(), n_concurrent);
+        nmf<T, Scalar> init = *this;
+        init.verbose = false;
+        init.interruptible = n_concurrent == 1;
+        init.checked = true;
+        std::vector<nmf<T, Scalar> > models(L1s.size(), init);
+        RcppML::forSlots(models.size(), n_concurrent, threads, [&](const unsigned int i, const unsigned int) {
+            nmf<T, Scalar>& m = models[i];
+            m.L1 = L1s[i];
+            m.L2 = L2s[i];
+            m.fit();
+            m.mse_ = m.mse();
+        });
+        for (unsigned int i = 0; i < models.size(); ++i) {
+            if (verbose) Rprintf("model %i/%i: iter = %i, tol = %4.2e, MSE = %8.4e\n", i + 1, (int)models.size(), models[i].iter_, models[i].tol_, models[i].mse_);
+            fitted(models[i]);
+        }
+    }
+
+    // fit one model for each initialization in "w_inits", which may differ in rank, with masking matrix "masks[reps[i]]",
+    //   and return the mean squared error of each model at its masked values (the test set)
+    //  * all models share "A" and "t(A)", and each masking matrix is transposed once for all models that use it
+    //  * models are fit concurrently as restarts are (see "concurrentRestarts")
+    //  * with "rank_path" or "patience", the models of each replicate are fit in order, and replicates are fit concurrently.
+    //      With "rank_path", each model is warm-started from the previous model of its replicate (see "fit_rank_path")
+    //      rather than from its initialization. With "patience", a replicate stops once its test error has increased
+    //      across "patience" consecutive models, and models that were not fit have a test error of NaN.
+    //  * "Mask" is "Rcpp::SparseMatrix" or "hash_mask"
+    template <class Mask>
+    std::vector<double> fit_cross_validate(std::vector<Mask>& masks, const std::vector<MatrixS>& w_inits,
+                                           const std::vector<unsigned int>& reps, const bool rank_path = false,
+                                           const unsigned int patience = 0) {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("cross-validation does not support masking or linking");
+        if (hals) Rcpp::stop("hals updates do not support masking");
+        checkFit();
+        const bool sequential = rank_path || patience > 0;
+        std::vector<std::vector<unsigned int> > paths(masks.size());
+        for (unsigned int i = 0; i < w_inits.size(); ++i) {
+            if (w_inits[i].cols() != A.rows()) Rcpp::stop("dimensions of 'w' and 'A' are not compatible");
+            if (reps[i] >= masks.size()) Rcpp::stop("replicate of a model has no masking matrix");
+            if (rank_path && !paths[reps[i]].empty() && w_inits[i].rows() <= w_inits[paths[reps[i]].back()].rows())
+                Rcpp::stop("ranks of each replicate must be increasing along a rank path");
+            paths[reps[i]].push_back(i);
+        }
+
+        // one copy of this model for each replicate, with transposes computed here since this requires the R API
+        std::vector<nmf<T, Scalar> > replicates;
+        for (unsigned int r = 0; r < masks.size(); ++r) {
+            nmf<T, Scalar> m(*this);
+            m.maskMatrix(masks[r]);
+            m.checkFit();
+            m.checked = true;
+            if (!m.symmetric) {
+                m.transposeA();
+                t_A = m.t_A;
+            }
+            replicates.push_back(m);
+        }
+
+        // one model for each initialization, or for each replicate if models of a replicate are fit in order
+        const unsigned int n_concurrent = concurrentRestarts(sequential ? masks.size() : w_inits.size());
+        if (verbose) Rprintf("Fitting %i models on %i concurrent threads\n", (int)w_inits.size(), n_concurrent);
+        std::vector<nmf<T, Scalar> > models;
+        std::vector<unsigned int> model_reps;
+        for (unsigned int i = 0; i < w_inits.size(); ++i) {
+            if (sequential && i != paths[reps[i]][0]) continue;
+            models.push_back(replicates[reps[i]]);
+            model_reps.push_back(reps[i]);
+            nmf<T, Scalar>& m = models.back();
+            m.verbose = false;
+            m.interruptible = n_concurrent == 1;
+        }
+
+        std::vector<double> test_mse(w_inits.size(), std::numeric_limits<double>::quiet_NaN());
+        RcppML::forSlots(models.size(), n_concurrent, threads, [&](const unsigned int i, const unsigned int) {
+            nmf<T, Scalar>& m = models[i];
+            const std::vector<unsigned int> path = sequential ? paths[model_reps[i]] : std::vector<unsigned int>(1, i);
+            unsigned int n_increases = 0;
+            for (unsigned int step = 0; step < path.size(); ++step) {
+                const MatrixS& w_init = w_inits[path[step]];
+                if (rank_path && step > 0) {
+                    m.addFactors(w_init.rows() - m.w.rows());
+                } else {
+                    m.w = w_init;
+                    m.d = VectorS::Ones(w_init.rows());
+                    m.h = MatrixS(w_init.rows(), A.cols());
+                }
+                m.tol_ = 1;
+                m.iter_ = 0;
+                m.fit();
+                test_mse[path[step]] = m.mse_masked();
+                if (step > 0) n_increases = test_mse[path[step]] > test_mse[path[step - 1]] ? n_increases + 1 : 0;
+                if (patience > 0 && n_increases >= patience) break;
+            }
+        });
+        Rcpp::checkUserInterrupt();
+        return test_mse;
+    }
+
+    // fit one model for each initialization in "w_inits" to the training samples of replicate "reps[i]", and return the
+    //   mean squared error of each model on its held-out block by bi-cross-validation
+    //  * "splits[r]" holds out sample "j" where "splits[r](j, 0)" and feature "i" where "splits[r](i, 1)" (see "hash_mask")
+    //  * each model is fit without masking to the training samples, and "h" of the held-out samples is projected from
+    //      the training features alone (see "projector"). The test error is measured on the held-out features of the
+    //      held-out samples, which neither the fit nor the projection has seen (see "mse_heldout").
+    //  * the columns of each replicate are copied from "A" once, and its training columns are transposed once for all
+    //      models of the replicate
+    //  * models are fit concurrently, or with "patience", in order of each replicate as in "fit_cross_validate"
+    std::vector<double> fit_cross_validate_samples(const std::vector<hash_mask>& splits, const std::vector<MatrixS>& w_inits,
+                                                   const std::vector<unsigned int>& reps, const unsigned int patience = 0) {
+        typedef decltype(submat(A, Eigen::VectorXi())) ColsA;
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("cross-validation does not support masking or linking");
+        checkFit();
+        std::vector<std::vector<unsigned int> > paths(splits.size());
+        for (unsigned int i = 0; i < w_inits.size(); ++i) {
+            if (w_inits[i].cols() != A.rows()) Rcpp::stop("dimensions of 'w' and 'A' are not compatible");
+            if (reps[i] >= splits.size()) Rcpp::stop("replicate of a model has no held-out samples");
+            paths[reps[i]].push_back(i);
+        }
+
+        // training and held-out columns and held-out features of each replicate, and one model of each replicate with
+        //   its transpose computed here since this requires the R API
+        std::vector<ColsA> train, test;
+        train.reserve(splits.size());
+        test.reserve(splits.size());
+        std::vector<Eigen::VectorXd> held_out(splits.size());
+        std::vector<nmf<ColsA, Scalar> > replicates;
+        for (unsigned int r = 0; r < splits.size(); ++r) {
+            std::vector<int> train_cols, test_cols;
+            for (unsigned int j = 0; j < A.cols(); ++j) (splits[r](j, 0) ? test_cols : train_cols).push_back(j);
+            held_out[r] = Eigen::VectorXd::Zero(A.rows());
+            for (unsigned int i = 0; i < A.rows(); ++i)
+                if (splits[r](i, 1)) held_out[r](i) = 1;
+            if (train_cols.empty() || test_cols.empty() || held_out[r].sum() == 0 || held_out[r].sum() == A.rows())
+                Rcpp::stop("a replicate has no held-out or no training samples or features");
+            train.push_back(submat(A, Eigen::Map<Eigen::VectorXi>(train_cols.data(), train_cols.size())));
+            test.push_back(submat(A, Eigen::Map<Eigen::VectorXi>(test_cols.data(), test_cols.size())));
+            nmf<ColsA, Scalar> m(train.back(), paths[r].empty() ? MatrixS(MatrixS::Zero(1, A.rows())) : w_inits[paths[r][0]]);
+            m.tol = tol;
+            m.maxit = maxit;
+            m.L1 = L1;
+            m.L2 = L2;
+            m.threads = threads;
+            m.upper_bound = upper_bound;
+            m.solver = solver;
+            m.loss_tol = loss_tol;
+            m.inexact = inexact;
+            m.sort_model = false;
+            m.verbose = false;
+            m.checkFit();
+            m.checked = true;
+            if (!m.symmetric) m.transposeA();
+            replicates.push_back(m);
+        }
+
+        // one model for each initialization, or for each replicate if models of a replicate are fit in order
+        const unsigned int n_concurrent = concurrentRestarts(patience > 0 ? splits.size() : w_inits.size());
+        if (verbose) Rprintf("Fitting %i models on %i concurrent threads\n", (int)w_inits.size(), n_concurrent);
+        std::vector<nmf<ColsA, Scalar> > models;
+        std::vector<unsigned int> model_reps;
+        for (unsigned int i = 0; i < w_inits.size(); ++i) {
+            if (patience > 0 && i != paths[reps[i]][0]) continue;
+            models.push_back(replicates[reps[i]]);
+            model_reps.push_back(reps[i]);
+            models.back().interruptible = n_concurrent == 1;
+        }
+
+        std::vector<double> test_mse(w_inits.size(), std::numeric_limits<double>::quiet_NaN());
+        const unsigned int n_threads = kernelThreads(threads, std::numeric_limits<double>::infinity(), 0);
+        RcppML::forSlots(models.size(), n_concurrent, threads, [&](const unsigned int i, const unsigned int) {
+            nmf<ColsA, Scalar>& m = models[i];
+            const unsigned int r = model_reps[i];
+            const std::vector<unsigned int> path = patience > 0 ? paths[r] : std::vector<unsigned int>(1, i);
+            unsigned int n_increases = 0;
+            for (unsigned int step = 0; step < path.size(); ++step) {
+                const MatrixS& w_init = w_inits[path[step]];
+                m.w = w_init;
+                m.d = VectorS::Ones(w_init.rows());
+                m.h = MatrixS(w_init.rows(), train[r].cols());
+                m.tol_ = 1;
+                m.iter_ = 0;
+                m.fit();
+                const MatrixS wd = m.d.asDiagonal() * m.w;
+                projector<Scalar> p(wd * (1 - held_out[r].array()).matrix().template cast<Scalar>().asDiagonal(), L1[1], L2[1],
+                                    upper_bound, solver);
+                const Eigen::MatrixXd h_test = projectColumns(p, test[r], n_threads);
+                test_mse[path[step]] = mse_heldout(test[r], wd.template cast<double>(), h_test, held_out[r], n_threads);
+                if (step > 0) n_increases = test_mse[path[step]] > test_mse[path[step - 1]] ? n_increases + 1 : 0;
+                if (patience > 0 && n_increases >= patience) break;
+            }
+        });
+        Rcpp::checkUserInterrupt();
+        return test_mse;
+    }
+
+    // fit the model by online alternating least squares over random minibatches of "batch_size" columns
+    //  * "h" is solved for each minibatch against the current "w". Running sums of "hh^T", "hA^T" and the row sums of "h"
+    //      are then decayed by "decay" and updated with the minibatch, and "w" is solved from them after the same
+    //      scaling of "h" as in "fit", with "predict_gram"
+    //  * "tol_" is measured after each minibatch, so "w" may converge within a fraction of one pass (epoch) over "A".
+    //      "maxit" is the maximum number of epochs, and "iter_" is the number of minibatches
+    //  * "h" is solved for all columns of "A" after "w" has converged
+    //  * sufficient statistics are kept (see "onlineStats"), so a fitted model can be updated with new data
+    void fit_online(const unsigned int seed = 0) {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("online nmf does not support masking or linking");
+        if (hals || !nonneg[0] || !nonneg[1]) Rcpp::stop("online nmf does not support hals or unconstrained updates");
+        if (batch_size == 0) Rcpp::stop("'batch_size' must be greater than 0");
+        if (compress_indices) compressIndices(A);
+        const unsigned int k = w.rows(), n = A.cols();
+        if (online_a.size() == 0) {
+            online_a = MatrixS::Zero(k, k);
+            online_B = MatrixS::Zero(k, A.rows());
+            online_hsum = VectorS::Zero(k);
+        }
+        if (verbose) Rprintf("\n%5s | %7s | %8s \n-------------------------\n", "epoch", "batch", "tol");
+
+        std::vector<int> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        RcppML::rng<false> s(seed);
+        bool converged = false;
+        unsigned int epoch = 0;
+        for (; epoch < maxit && !converged; ++epoch) {
+            // shuffle columns by Fisher-Yates with the RcppML hash-based rng, for reproducibility across platforms
+            for (unsigned int i = n - 1; i > 0; --i)
+                std::swap(order[i], order[s.template sample<uint32_t>(epoch, i, i + 1)]);
+
+            for (unsigned int start = 0; start < n && !converged; start += batch_size, ++iter_) {
+                const unsigned int n_batch = std::min(batch_size, n - start);
+                Eigen::VectorXi cols = Eigen::Map<Eigen::VectorXi>(order.data() + start, n_batch);
+                std::sort(cols.data(), cols.data() + n_batch);
+                auto A_b = submat(A, cols);
+
+                // update "h" for the minibatch
+                MatrixS h_b(k, n_batch);
+                predict(A_b, mask_matrix, link_matrix_h, w, h_b, L1[1], L2[1], threads, false, false, false, upper_bound, solver);
+
+                // update sufficient statistics
+                online_a *= decay;
+                online_B *= decay;
+                online_hsum *= decay;
+                gramUpdate(online_a, h_b);
+                gramSymmetrize(online_a);
+                addHAt(A_b, h_b, online_B);
+                online_hsum += h_b.rowwise().sum();
+
+                // update "w" from sufficient statistics, scaled as if rows in "h" summed to 1
+                MatrixS a = online_a, B = online_B;
+                for (unsigned int i = 0; i < k; ++i) {
+                    const Scalar d_i = online_hsum(i) + TINY_NUM;
+                    B.row(i) /= d_i;
+                    a.row(i) /= d_i;
+                    a.col(i) /= d_i;
+                }
+                w_it = w;
+                predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver);
+                tol_ = scaleRows(w, &w_it);
+                if (tol_ < tol) converged = true;
+                if (interruptible) Rcpp::checkUserInterrupt();
+            }
+            if (verbose) Rprintf("%5d | %7d | %8.2e\n", epoch + 1, iter_, tol_);
+        }
+
+        if (!converged && verbose)
+            Rprintf(" convergence not reached in %d epochs\n  (actual tol = %4.2e, target tol = %4.2e)\n", epoch, tol_, tol);
+
+        // update "h" for all columns
+        predictH();
+        scaleH();
+        if (sort_model) {
+            // keep sufficient statistics in the same factor order as the model
+            std::vector<int> indx = sort_index(d);
+            sortByDiagonal();
+            online_a = reorder_rows(online_a, indx);
+            online_a = reorder_rows(MatrixS(online_a.transpose()), indx);
+            online_B = reorder_rows(online_B, indx);
+            online_hsum = reorder(online_hsum, indx);
+        }
+    }
+
+    // fit the model by alternating least squares in which "w" is updated from a random fraction "subsample" of columns
+    //   in each iteration, for "A" with very many columns
+    //  * columns are sampled by a hash of the iteration and column (see "rng"), so no permutation of all columns is kept,
+    //      and each iteration samples a different subset
+    //  * "h" is solved for the sampled columns against the current "w", and "w" is solved from "hh^T" and "hA^T" over
+    //      those columns with "predict_gram", after scaling rows of "h" to sum to 1 as in "fit" and "fit_online". Rows of
+    //      "h" over a fraction "f" of columns then sum to about "f" before scaling, so "hA^T" is that of all columns
+    //      while "hh^T" is "1/f" times it. "hh^T" is multiplied by "f" to match, so penalties have the same effect.
+    //  * "h" is solved for all columns of "A" after "w" has converged
+    void fit_subsampled(const unsigned int seed = 0) {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("subsampled nmf does not support masking or linking");
+        if (hals || !nonneg[0] || !nonneg[1]) Rcpp::stop("subsampled nmf does not support hals or unconstrained updates");
+        if (subsample <= 0 || subsample > 1) Rcpp::stop("'subsample' must be in the range (0, 1]");
+        if (compress_indices) compressIndices(A);
+        const unsigned int k = w.rows(), n = A.cols();
+        if (verbose) Rprintf("\n%4s | %8s | %8s \n-------------------------\n", "iter", "columns", "tol");
+        RcppML::rng<false> s(seed);
+        std::vector<int> sampled;
+        sampled.reserve((size_t)(subsample * n * 1.1) + 1);
+        for (; iter_ < maxit; ++iter_) {
+            sampled.clear();
+            for (unsigned int j = 0; j < n; ++j)
+                if (s.template runif<double>(iter_, j) < subsample) sampled.push_back(j);
+            if (sampled.empty()) continue;
+            auto A_b = submat(A, Eigen::Map<Eigen::VectorXi>(sampled.data(), sampled.size()));
+
+            // update "h" for the sampled columns
+            MatrixS h_b(k, sampled.size());
+            predict(A_b, mask_matrix, link_matrix_h, w, h_b, L1[1], L2[1], threads, false, false, false, upper_bound, solver);
+
+            // update "w" from sufficient statistics of the sampled columns, scaled as if rows in "h" summed to 1
+            const VectorS h_sum = h_b.rowwise().sum().array() + TINY_NUM;
+            h_b.array().colwise() /= h_sum.array();
+            MatrixS a = MatrixS::Zero(k, k), B = MatrixS::Zero(k, A.rows());
+            gramUpdate(a, h_b);
+            gramSymmetrize(a);
+            a *= (Scalar)sampled.size() / n;
+            addHAt(A_b, h_b, B);
+            w_it = w;
+            predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver);
+            tol_ = scaleRows(w, &w_it);
+            if (verbose) Rprintf("%4d | %8d | %8.2e\n", iter_ + 1, (int)sampled.size(), tol_);
+            if (tol_ < tol) break;
+            if (interruptible) Rcpp::checkUserInterrupt();
+        }
+        if (tol_ > tol && iter_ == maxit && verbose)
+            Rprintf(" convergence not reached in %d iterations\n  (actual tol = %4.2e, target tol = %4.2e)\n", iter_, tol_, tol);
+
+        // update "h" for all columns
+        predictH();
+        scaleH();
+        if (sort_model) sortByDiagonal();
+    }
+
+    // fit one model to each of "n_replicates" bootstrap replicates of the columns of "A", from the current "w"
+    //  * columns of replicate "r" are weighted by their multiplicities in a Poisson bootstrap, hashed from "seed", "r"
+    //      and the column (see "bootstrapWeights"), so that no replicate copies "A" (see "fitWeighted")
+    //  * replicates are fit concurrently on copies of this model that share "A" and "t(A)", as restarts are (see
+    //      "concurrentRestarts")
+    //  * "fitted" is called with the model of each replicate, in order, with its weighted mean squared error
+    template <class Callback>
+    void fit_bootstrap(const unsigned int n_replicates, const uint32_t seed, Callback fitted) {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("bootstrapped nmf does not support masking or linking");
+        if (hals || !nonneg[0] || !nonneg[1]) Rcpp::stop("bootstrapped nmf does not support hals or unconstrained updates");
+        checkFit();
+        const unsigned int n_concurrent = concurrentRestarts(n_replicates);
+        if (!symmetric) transposeA();
+        if (verbose) Rprintf("Fitting %i bootstrap replicates on %i concurrent threads\n", (int)n_replicates, n_concurrent);
+        nmf<T, Scalar> init = *this;
+        init.verbose = false;
+        init.interruptible = n_concurrent == 1;
+        std::vector<nmf<T, Scalar> > models(n_replicates, init);
+        RcppML::forSlots(n_replicates, n_concurrent, threads, [&](const unsigned int r, const unsigned int) {
+            models[r].fitWeighted(bootstrapWeights<Scalar>(seed, r, A.cols()));
+        });
+        for (unsigned int r = 0; r < n_replicates; ++r) {
+            if (verbose) Rprintf("replicate %i/%i: iter = %i, tol = %4.2e, MSE = %8.4e\n", r + 1, (int)n_replicates, models[r].iter_, models[r].tol_, models[r].mse_);
+            fitted(models[r]);
+        }
+    }
+
+    // fit the model with columns of "A" weighted by "c", such as the unique columns of a matrix weighted by their
+    //   multiplicities (see "findColumnGroups"), as if column "j" were repeated "c(j)" times (see "fitWeighted")
+    void fit_weighted(const VectorS& c) {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("weighted nmf does not support masking or linking");
+        if (hals || !nonneg[0] || !nonneg[1]) Rcpp::stop("weighted nmf does not support hals or unconstrained updates");
+        if ((int)c.size() != (int)A.cols()) Rcpp::stop("there must be one weight for each column of 'A'");
+        if (!symmetric) transposeA();
+        fitWeighted(c, true);
+    }
+
+    // set sufficient statistics "hh^T", "hA^T" and the row sums of "h" of the fitted model over all columns of "A", for
+    //   "h" at the scale of the model, so that the model can be updated with new samples (see "fit_update")
+    void keepStats() {
+        const MatrixS h_d = d.asDiagonal() * h;
+        online_a = MatrixS::Zero(w.rows(), w.rows());
+        gramUpdate(online_a, h_d);
+        gramSymmetrize(online_a);
+        online_B = MatrixS::Zero(w.rows(), A.rows());
+        addHAt(A, h_d, online_B);
+        online_hsum = h_d.rowwise().sum();
+    }
+
+    // update a fitted model with new samples in "A", from sufficient statistics of the samples it was fit to (see
+    //   "onlineStats"), so that the cost depends only on the new samples
+    //  * statistics of previous samples are weighted by "decay" once, and then held fixed
+    //  * each iteration solves "h" for all new samples against "w", and solves "w" from the previous statistics plus
+    //      those of the new samples, scaled as in "fit_online"
+    //  * statistics of the new samples in the final model are added to those that are kept, so the model can be
+    //      updated again
+    void fit_update() {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("updates of nmf do not support masking or linking");
+        if (hals || !nonneg[0] || !nonneg[1]) Rcpp::stop("updates of nmf do not support hals or unconstrained updates");
+        if (online_a.size() == 0) Rcpp::stop("updates of nmf require sufficient statistics of the fitted model");
+        if (compress_indices) compressIndices(A);
+        const unsigned int k = w.rows();
+        online_a *= decay;
+        online_B *= decay;
+        online_hsum *= decay;
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        for (; iter_ < maxit; ++iter_) {
+            predictH();
+            MatrixS a = online_a, B = online_B;
+            gramUpdate(a, h);
+            gramSymmetrize(a);
+            addHAt(A, h, B);
+            const VectorS h_sum = online_hsum + h.rowwise().sum();
+
+            // update "w" from sufficient statistics, scaled as if rows in "h" summed to 1
+            for (unsigned int i = 0; i < k; ++i) {
+                const Scalar d_i = h_sum(i) + TINY_NUM;
+                B.row(i) /= d_i;
+                a.row(i) /= d_i;
+                a.col(i) /= d_i;
+            }
+            w_it = w;
+            predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver);
+            tol_ = scaleRows(w, &w_it);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter_ + 1, tol_);
+            if (tol_ < tol) {
+                ++iter_;
+                break;
+            }
+            if (interruptible) Rcpp::checkUserInterrupt();
+        }
+        if (tol_ > tol && iter_ == maxit && verbose)
+            Rprintf(" convergence not reached in %d iterations\n  (actual tol = %4.2e, target tol = %4.2e)\n", iter_, tol_, tol);
+
+        // update "h" for the final "w", and add its statistics to those that are kept
+        predictH();
+        gramUpdate(online_a, h);
+        gramSymmetrize(online_a);
+        addHAt(A, h, online_B);
+        online_hsum += h.rowwise().sum();
+        scaleH();
+        if (sort_model) {
+            std::vector<int> indx = sort_index(d);
+            sortByDiagonal();
+            online_a = reorder_rows(online_a, indx);
+            online_a = reorder_rows(MatrixS(online_a.transpose()), indx);
+            online_B = reorder_rows(online_B, indx);
+            online_hsum = reorder(online_hsum, indx);
+        }
+    }
+
+    // fit the model over one partition of the columns of a matrix that is split across processes or nodes (e.g. MPI
+    //   ranks), where "A" and "h" hold the columns of this partition, and "w" is the same initialization in every
+    //   partition
+    //  * "allreduce(x, n)" must sum the "n" values at "x" over all partitions in place (see "mpiAllreduce")
+    //  * each iteration solves "h" for the columns of this partition with "predict", and "w" from "hh^T", "hA^T" and
+    //      the row sums of "h" summed over all partitions (see "partitionStats" and "updateFromStats"), so no transpose
+    //      of "A" and no global "h" is formed, and only "k * (k + m + 1)" values are reduced
+    //  * every partition then solves the same "w" and "tol_", and so stops at the same iteration
+    template <class Reducer>
+    void fit_distributed(Reducer allreduce) {
+        checkDistributed();
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        MatrixS stats;
+        for (; iter_ < maxit; ++iter_) {
+            partitionStats(stats);
+            allreduce(stats.data(), (size_t)stats.size());
+            const bool converged = updateFromStats(stats);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter_ + 1, tol_);
+            if (converged) {
+                ++iter_;
+                break;
+            }
+            if (interruptible) Rcpp::checkUserInterrupt();
+        }
+        if (tol_ > tol && iter_ == maxit && verbose)
+            Rprintf(" convergence not reached in %d iterations\n  (actual tol = %4.2e, target tol = %4.2e)\n", iter_, tol_, tol);
+        predictH();
+        VectorS h_sum = h.rowwise().sum();
+        allreduce(h_sum.data(), (size_t)h_sum.size());
+        scaleDistributedH(h_sum);
+        if (sort_model) sortByDiagonal();
+    }
+
+    // steps of "fit_distributed", for drivers that sum statistics over partitions themselves (e.g. partitions in one
+    //   process). "partitionStats" updates "h" and writes "[hh^T, hA^T, rowSums(h)]" of this partition to "stats"
+    //   as a "k x (k + m + 1)" matrix. "updateFromStats" solves "w" from those statistics summed over all partitions,
+    //   and returns true if the model has converged.
+    void checkDistributed() {
+        if (mask || mask_zeros || mask_hash || link[0] || link[1]) Rcpp::stop("distributed nmf does not support masking or linking");
+        if (hals) Rcpp::stop("distributed nmf does not support hals updates");
+        if (compress_indices) compressIndices(A);
+    }
+
+    void partitionStats(MatrixS& stats) {
+        const unsigned int k = w.rows(), m = A.rows();
+        predictH();
+        stats.setZero(k, k + m + 1);
+        MatrixS a = MatrixS::Zero(k, k), B = MatrixS::Zero(k, m);
+        gramUpdate(a, h);
+        gramSymmetrize(a);
+        addHAt(A, h, B);
+        stats.leftCols(k) = a;
+        stats.middleCols(k, m) = B;
+        stats.col(k + m) = h.rowwise().sum();
+    }
+
+    bool updateFromStats(const MatrixS& stats) {
+        const unsigned int k = w.rows(), m = A.rows();
+        if (stats.rows() != k || stats.cols() != k + m + 1) Rcpp::stop("dimensions of distributed statistics are not compatible with 'w' and 'A'");
+        // scaled as if rows in "h" summed to 1 over all partitions
+        MatrixS a = stats.leftCols(k), B = stats.middleCols(k, m);
+        for (unsigned int i = 0; i < k; ++i) {
+            const Scalar d_i = stats(i, k + m) + TINY_NUM;
+            B.row(i) /= d_i;
+            a.row(i) /= d_i;
+            a.col(i) /= d_i;
+        }
+        w_it = w;
+        predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver);
+        tol_ = scaleRows(w, &w_it);
+        return tol_ < tol;
+    }
+
+    // scale rows of "h" of this partition by the row sums "h_sum" of "h" over all partitions, which become "d"
+    void scaleDistributedH(const VectorS& h_sum) {
+        d = h_sum.array() + TINY_NUM;
+        h.array().colwise() /= d.array();
+    }
+
+   private:
+    MatrixS online_a, online_B;  // sufficient statistics "hh^T" and "hA^T" for "fit_online" and "fit_update"
+    VectorS online_hsum;
+    double A_sq = -1;  // squared Frobenius norm of "A", computed on first use
+
+    // buffers of "fit", which are allocated in the first iteration and reused in every other iteration
+    MatrixS w_it;               // "w" of the previous iteration
+    MatrixS B_rows;             // "hA^T" of updates of "w" without "t(A)" (see "predictRows")
+    std::vector<int> row_chunks;  // chunks of rows of sparse "A" for updates of "w" without "t(A)" (see "rowChunks")
+    std::vector<Scalar> robust_w, t_robust_w;  // weights of non-zeros of "A" and "t(A)" under a robust loss (see "reweight")
+    std::vector<int> t_order;     // position in "A" of each non-zero of "t(A)"
+    std::vector<double> abs_r;    // absolute residuals at non-zeros of "A", partially sorted for their median
+    double robust_scale_ = 0;     // robust standard deviation of residuals at non-zeros of "A" in the last reweighting
+    MatrixS block_d;            // sums over each row of each block of columns in "scaleRows"
+    Eigen::MatrixXd row_stats;  // sums over each row for the correlation distance in "scaleRows"
+    VectorS d_inv;              // "1 / d" in "scaleRows"
+
+    // scale rows in "x" to sum to 1, where "d" is rowsums of "x", by one pass over columns of "x" that sums its rows and
+    //   another that multiplies each column by "1 / d"
+    //  * if "x_last" is given, the correlation distance (see "cor") of the scaled "x" from "x_last" is returned from
+    //      sums of "x * x_last", "x^2", "x_last" and "x_last^2" over each row that are accumulated in the first pass,
+    //      and scaled by "1 / d" (or its square) for each row afterwards
+    //  * rows of an unconstrained factor (see "nonneg") may sum to zero, so they are scaled to unit Euclidean norm instead
+    //      and "d" is their norms. Their sums for the correlation distance are then accumulated apart from "d".
+    //  * both passes run in parallel over blocks of SCALE_BLOCK_SIZE columns. Sums of each block are added in order of
+    //      the blocks, so that results do not depend on the number of threads.
+    double scaleRows(MatrixS& x, const MatrixS* x_last = NULL) {
+        phaseTimer timer(profiler(), PHASE_SCALE);
+        const int k = x.rows(), n = x.cols();
+        const bool signed_rows = !nonneg[&x == &w ? 0 : 1];
+        const int n_sums = x_last ? (signed_rows ? 5 : 4) : 0;
+        const int n_blocks = std::max(1, (n + SCALE_BLOCK_SIZE - 1) / SCALE_BLOCK_SIZE);
+        const unsigned int n_threads = kernelThreads(threads, 2.0 * (n_sums + 2) * k * n, (x_last ? 3.0 : 2.0) * k * n * sizeof(Scalar));
+        block_d.setZero(k, n_blocks);
+        if (x_last) row_stats.setZero(k, n_sums * n_blocks);
+        RcppML::forEach(n_blocks, n_threads, [&](const int b) {
+            const int end = std::min(n, (b + 1) * SCALE_BLOCK_SIZE);
+            for (int j = b * SCALE_BLOCK_SIZE; j < end; ++j) {
+                if (signed_rows)
+                    block_d.col(b) += x.col(j).cwiseAbs2();
+                else
+                    block_d.col(b) += x.col(j);
+                if (!x_last) continue;
+                Eigen::Block<Eigen::MatrixXd, -1, -1, true> sums = row_stats.middleCols(b * n_sums, n_sums);
+                sums.col(0) += x.col(j).cwiseProduct(x_last->col(j)).template cast<double>();
+                sums.col(1) += x.col(j).cwiseAbs2().template cast<double>();
+                sums.col(2) += x_last->col(j).template cast<double>();
+                sums.col(3) += x_last->col(j).cwiseAbs2().template cast<double>();
+                if (signed_rows) sums.col(4) += x.col(j).template cast<double>();
+            }
+        });
+        d = block_d.col(0);
+        for (int b = 1; b < n_blocks; ++b) {
+            d += block_d.col(b);
+            if (x_last) row_stats.leftCols(n_sums) += row_stats.middleCols(b * n_sums, n_sums);
+        }
+        if (signed_rows) d = d.cwiseSqrt();
+        d.array() += TINY_NUM;
+        d_inv = d.cwiseInverse();
+        RcppML::forEach(n_blocks, n_threads, [&](const int b) {
+            const int end = std::min(n, (b + 1) * SCALE_BLOCK_SIZE);
+            for (int j = b * SCALE_BLOCK_SIZE; j < end; ++j) x.col(j).array() *= d_inv.array();
+        });
+        if (!x_last) return 0;
+        double sum_x = 0, sum_y = row_stats.col(2).sum(), sum_xy = 0, sum_x2 = 0, sum_y2 = row_stats.col(3).sum();
+        for (int i = 0; i < k; ++i) {
+            const double s = d_inv(i);
+            sum_x += (signed_rows ? row_stats(i, 4) : d(i) - TINY_NUM) * s;
+            sum_xy += row_stats(i, 0) * s;
+            sum_x2 += row_stats(i, 1) * s * s;
+        }
+        const double N = (double)k * n;
+        return 1 - (N * sum_xy - sum_x * sum_y) / std::sqrt((N * sum_x2 - sum_x * sum_x) * (N * sum_y2 - sum_y * sum_y));
+    }
 
-    // compute losses across all samples in parallel
-    Eigen::ArrayXd losses(h.cols());
+    // true if the loss of the model follows from the systems of equations solved in "predictW", by the Gram identity
+    //    "||A - wh||^2 = ||A||^2 - 2tr(w^T(hA^T)) + tr((w^Tw)(hh^T))"
+    bool lossFromGram() { return !mask && !mask_zeros && !mask_hash && !link[0] && robust == ROBUST_NONE; }
+
+    // masked (and reweighted) updates solve a different system for every column, which is not factorized once to
+    //   initialize them, so after the first iteration they begin from the previous solution at the scale of the other
+    //   factor in "d"
+    bool warmStart() { return iter_ > 0 && (mask || mask_zeros || mask_hash || robust != ROBUST_NONE); }
+
+    // rank-1 models without masking or linking are updated by "predict_rank1" rather than "predict"
+    bool rank1() {
+        return w.rows() == 1 && !mask && !mask_zeros && !mask_hash && !link[0] && !link[1] && !hals && nonneg[0] && nonneg[1] && transpose &&
+               robust == ROBUST_NONE;
+    }
+
+    // one iteration of rank-1 updates, each a single matrix-vector product with "A" or "t(A)" that returns the sum of
+    //   the updated factor, so that "h" is scaled in one more pass over "h", and "w" in one more pass over "w" that also
+    //   measures its correlation with "w" of the previous iteration
+    void fitRank1() {
+        double loss = 0;
+        {
+            phaseTimer timer(profiler(), PHASE_H);
+            d(0) = predict_rank1(A, w, h, L1[1], L2[1], threads, upper_bound);
+        }
+        scaleRank1(h, d(0));
+        w_it = w;
+        if (!symmetric) transposeA();
+        {
+            phaseTimer timer(profiler(), PHASE_W);
+            if (symmetric) {
+                d(0) = predict_rank1(A, h, w, L1[0], L2[0], threads, upper_bound, (loss_tol || racing) ? &loss : NULL);
+            } else {
+                d(0) = predict_rank1(transposedA(A), h, w, L1[0], L2[0], threads, upper_bound, (loss_tol || racing) ? &loss : NULL);
+            }
+        }
+        if (profile) profile_.addValues(2 * valuesIn(A));
+        race_loss_ = loss;
+        const double tol_w = scaleRank1(w, d(0), &w_it);
+        d(0) += TINY_NUM;
+        if (loss_tol)
+            updateLoss(loss);
+        else
+            tol_ = tol_w;
+    }
+
+    // acceleration of "fitExtrapolated" and "fitAnderson"
+    MatrixS h_it;                       // "h" solved in the previous iteration, before extrapolation
+    double beta_ = 0.5, beta_max_ = 1;  // step and greatest step of extrapolation
+    std::vector<MatrixS> anderson_g, anderson_f;  // last solutions of "w", and their steps from the "w" they were solved from
+    double last_loss_ = 0;              // squared error less "||A||^2" of the model after the previous iteration
+
+    // scale rows of "x" to sum to 1 and "d" by their sums, so that the model keeps the scale of "x" for warm starts of
+    //   "hals" updates
+    void scaleStep(MatrixS& x) {
+        const VectorS d_x = d;
+        scaleRows(x);
+        d.array() *= d_x.array();
+    }
+
+    // set "x" to its extrapolation "max(0, x + beta_ * (x - x_last))" along the step from "x_last", and "x_last" to "x"
+    //  * rows of "x" and "x_last" sum to 1, so rows of the extrapolation sum to at least 1 and are scaled by "scaleStep"
+    void extrapolate(MatrixS& x, MatrixS& x_last) {
+        x_last.swap(x);
+        x = ((Scalar)(1 + beta_) * x_last - (Scalar)beta_ * x).cwiseMax((Scalar)0);
+        scaleStep(x);
+    }
+
+    // repeat an iteration whose step was rejected from "w" of the previous iteration in "w_it", with "d" and (for "hals")
+    //   "h" of the previous iteration, setting "loss" to that of the plain update
+    void repeatIteration(const VectorS& d_last, MatrixS& h_last, double& loss) {
+        w = w_it;
+        d = d_last;
+        if (hals) h.swap(h_last);
+        predictH();
+        scaleH();
+        predictW(&loss);
+    }
+
+    // scale the solved "w" and set "tol_" from its correlation with "w_last", or from the loss
+    void endIteration(const double loss, const MatrixS& w_last) {
+        last_loss_ = loss;
+        if (loss_tol) {
+            scaleW();
+            updateLoss(loss);
+        } else {
+            tol_ = scaleRows(w, &w_last);
+        }
+    }
+
+    // one iteration of extrapolated alternating least squares (Ang and Gillis 2019): "h" is solved from "w" extrapolated
+    //   along its last step, and "w" from "h" extrapolated along its last step
+    //  * the loss of the updated model follows from the update of "w" by the Gram identity, so each step is checked at
+    //      no extra cost. A step that increases the loss is rejected, and the iteration is repeated from the model of
+    //      the previous iteration without extrapolation, so that the loss never increases as in plain updates.
+    //  * "beta_" grows by 5% after each accepted step, up to "beta_max_", which grows by 1% up to 1. A rejected step
+    //      divides "beta_" by 1.5 and sets "beta_max_" to the rejected step.
+    //  * the solved "w" and "h" of the previous iteration are kept in "w_it" and "h_it", and "tol_" is the correlation
+    //      of the solved "w" across iterations
+    void fitExtrapolated() {
+        const bool extrapolating = h_it.size() > 0;
+        // "hals" updates begin from the last solution, so a rejected step begins again from "h" of the previous iteration
+        const VectorS d_last = d;
+        MatrixS h_last;
+        if (hals) h_last = h;
+        if (extrapolating)
+            extrapolate(w, w_it);
+        else
+            w_it = w;
+        predictH();
+        scaleH();
+        if (extrapolating)
+            extrapolate(h, h_it);
+        else
+            h_it = h;
+        double loss = 0;
+        predictW(&loss);
+        if (loss > last_loss_) {
+            beta_max_ = beta_;
+            beta_ /= 1.5;
+            repeatIteration(d_last, h_last, loss);
+            h_it = h;
+        } else if (extrapolating) {
+            beta_ = std::min(beta_max_, beta_ * 1.05);
+            beta_max_ = std::min(1.0, beta_max_ * 1.01);
+        }
+        endIteration(loss, w_it);
+    }
+
+    // one iteration of Anderson accelerated alternating least squares (Walker and Ni 2011), treating an iteration as a
+    //   map "g(w)" whose fixed point is the solution: "h" is solved from a mixture of the last "anderson + 1" solutions
+    //   of "w", weighted to minimize the norm of the same mixture of their steps "f = g(w) - w", and projected to
+    //   non-negative values
+    //  * weights are found from the differences of consecutive steps by a least squares solve of "anderson" unknowns,
+    //      and the solutions and steps are kept in "anderson_g" and "anderson_f", in O(anderson * k * rows) memory
+    //  * a mixture that increases the loss (from the update of "w" by the Gram identity) is rejected, and the iteration
+    //      is repeated from "w" of the previous iteration with the history cleared, as in "fitExtrapolated"
+    //  * "tol_" is the correlation of the solved "w" with the "w" it was solved from, which is 1 only at a fixed point,
+    //      since solutions in consecutive iterations may be close while the mixture is far from converged
+    void fitAnderson() {
+        const VectorS d_last = d;
+        MatrixS h_last;
+        if (hals) h_last = h;
+        w_it = w;
+        const int n = anderson_g.size();
+        if (n > 1) {
+            Eigen::MatrixXd dF(w.size(), n - 1), dG(w.size(), n - 1);
+            for (int i = 0; i < n - 1; ++i) {
+                dF.col(i) = Eigen::Map<const VectorS>((anderson_f[i + 1] - anderson_f[i]).eval().data(), w.size()).template cast<double>();
+                dG.col(i) = Eigen::Map<const VectorS>((anderson_g[i + 1] - anderson_g[i]).eval().data(), w.size()).template cast<double>();
+            }
+            Eigen::MatrixXd a = dF.transpose() * dF;
+            a.diagonal().array() += 1e-10 * a.trace() + TINY_NUM;
+            const Eigen::VectorXd gamma = a.ldlt().solve(dF.transpose() * Eigen::Map<const VectorS>(anderson_f.back().data(), w.size()).template cast<double>());
+            const Eigen::VectorXd mixed = Eigen::Map<const VectorS>(anderson_g.back().data(), w.size()).template cast<double>() - dG * gamma;
+            w = Eigen::Map<const Eigen::MatrixXd>(mixed.data(), w.rows(), w.cols()).template cast<Scalar>().cwiseMax((Scalar)0);
+            scaleStep(w);
+        }
+        MatrixS w_from = w;
+        predictH();
+        scaleH();
+        double loss = 0;
+        predictW(&loss);
+        if (loss > last_loss_) {
+            anderson_g.clear();
+            anderson_f.clear();
+            repeatIteration(d_last, h_last, loss);
+            w_from = w_it;
+        }
+        endIteration(loss, w_from);
+        if (anderson_g.size() > anderson) {
+            anderson_g.erase(anderson_g.begin());
+            anderson_f.erase(anderson_f.begin());
+        }
+        anderson_g.push_back(w);
+        anderson_f.push_back(w - w_from);
+    }
+
+    // record the mean squared error of this iteration and set "tol_" to its relative change from the previous iteration
+    //  * "loss" is the squared error less "||A||^2" from "predictW" if "lossFromGram()", otherwise the loss is computed explicitly
+    void updateLoss(const double loss) {
+        double mse_it;
+        if (lossFromGram()) {
+            if (A_sq < 0) A_sq = squaredNorm(A);
+            mse_it = std::max(A_sq + loss, 0.0) / ((h.cols() * w.cols()));
+        } else {
+            mse_it = mse();
+        }
+        tol_ = losses_.empty() ? 1 : std::abs(losses_.back() - mse_it) / (losses_.back() + TINY_NUM);
+        losses_.push_back(mse_it);
+    }
+
+    // overlap the explicit loss of an iteration with the update of "h" in the next (see "updateLossAhead"), which
+    //  * needs the loss, and not its gram form from "predictW", and more than one thread
+    //  * is not done in the last iteration, or with freezing, "inexact" tolerances, profiling, checkpoints or robust
+    //      losses, which read the state of the model between iterations or the loss before the next update
+    bool lossAhead() {
+        if (lossFromGram() || freezing || inexact || profile || checkpoint_every > 0 || robust != ROBUST_NONE || iter_ + 1 >= maxit) return false;
 #ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
+        return !omp_in_parallel() && kernelThreads(threads, std::numeric_limits<double>::infinity(), 0) > 1;
+#else
+        return false;
 #endif
-    for (unsigned int i = 0; i < h.cols(); ++i) {
-        Eigen::VectorXd wh_i = w0 * h.col(i);
-        if (mask_zeros) {
-            for (Rcpp::SparseMatrix::InnerIterator iter(A, i); iter; ++iter)
-                losses(i) += std::pow(wh_i(iter.row()) - iter.value(), 2);
+    }
+
+    // record the loss of this iteration as "updateLoss" does, computed on a background thread from a snapshot of "h"
+    //   and "d" while the remaining threads update "h" of the next iteration
+    //  * threads are divided in proportion to the flops of the loss and of the update
+    //  * if the loss meets "tol", the update is undone, so the model is exactly that of the sequential fit. Otherwise
+    //      the next iteration begins from the updated "h" (see "h_ahead").
+    void updateLossAhead() {
+        h_loss = h;
+        d_loss = d;
+        const double k = w.rows(), values = (mask || mask_zeros || mask_hash) ? (double)A.rows() * A.cols() : valuesIn(A);
+        const double loss_flops = 2 * k * values, update_flops = 2 * k * valuesIn(A) + 2 * k * k * (A.rows() + 4.0 * A.cols());
+        const unsigned int n_threads = kernelThreads(threads, std::numeric_limits<double>::infinity(), 0);
+        loss_threads_ = std::max(1u, std::min(n_threads - 1, (unsigned int)std::lround(n_threads * loss_flops / (loss_flops + update_flops))));
+        update_threads_ = n_threads - loss_threads_;
+        evaluating = true;
+        std::future<double> loss = std::async(std::launch::async, [this]() { return mse(A); });
+        ++iter_;  // "h" is updated as in the next iteration (see "warmStart")
+        predictH();
+        scaleH();
+        --iter_;
+        const double mse_it = loss.get();
+        evaluating = false;
+        loss_threads_ = update_threads_ = 0;
+        tol_ = losses_.empty() ? 1 : std::abs(losses_.back() - mse_it) / (losses_.back() + TINY_NUM);
+        losses_.push_back(mse_it);
+        if (tol_ < tol) {
+            h.swap(h_loss);
+            d.swap(d_loss);
         } else {
-            for (Rcpp::SparseMatrix::InnerIterator iter(A, i); iter; ++iter)
-                wh_i(iter.row()) -= iter.value();
+            h_ahead = true;
+        }
+    }
+
+    bool interruptible = true;  // false for copies of the model fit on worker threads, which cannot call the R API
+    bool checked = false;       // true for copies whose options were checked on the main thread (see "checkFit")
+
+    // fit the model with columns of "A" weighted by "c", as if column "j" were repeated "c(j)" times
+    //  * "h" is solved for all columns against the current "w" (weights do not change the solution of a column), and
+    //      "w" is solved from "hCh^T" and "hCA^T" with "predict_gram", after scaling rows of "h" so that their weighted
+    //      sums are 1 as in "fit_subsampled". "hCA^T" is read from the cached "t(A)", so "A" is never resampled.
+    //  * "mse_" is the mean squared error of the fitted model over the columns weighted by "c"
+    //  * with "scale_weighted", rows of the final "h" are also scaled to weighted sums of 1, so that "d" is that of the
+    //      model of "A" with its columns repeated
+    void fitWeighted(const VectorS& c, const bool scale_weighted = false) {
+        const unsigned int k = w.rows();
+        const VectorS c_sqrt = c.cwiseSqrt();
+        for (; iter_ < maxit; ++iter_) {
+            predictH();
+            const VectorS h_sum = (h * c).array() + TINY_NUM;
+            MatrixS h_n = h;
+            h_n.array().colwise() /= h_sum.array();
+            MatrixS a = MatrixS::Zero(k, k), B = MatrixS::Zero(k, A.rows());
+            gramUpdate(a, h_n * c_sqrt.asDiagonal());
+            gramSymmetrize(a);
+            addHAtCached(A, h_n * c.asDiagonal(), B);
+            w_it = w;
+            predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver);
+            tol_ = scaleRows(w, &w_it);
+            if (tol_ < tol) break;
+            if (interruptible) Rcpp::checkUserInterrupt();
+        }
+        predictH();
+        if (scale_weighted) {
+            d = (h * c).array() + TINY_NUM;
+            d_inv = d.cwiseInverse();
+            h = d_inv.asDiagonal() * h;
+        } else {
+            scaleH();
+        }
+        if (sort_model) sortByDiagonal();
+        const MatrixS wd = d.asDiagonal() * w;
+        const Eigen::VectorXd sq = (columnLosses(A, wd, h, kernelThreads(threads, std::numeric_limits<double>::infinity(), 0)).matrix() +
+                                    colSquaredNorms(A)).cwiseMax(0);
+        mse_ = sq.dot(c.template cast<double>()) / (c.template cast<double>().sum() * A.rows());
+    }
+
+    // "h" of the columns of "A" projected by "p" (see "fit_cross_validate_samples")
+    Eigen::MatrixXd projectColumns(projector<Scalar>& p, Rcpp::SparseMatrix& A, const unsigned int n_threads) {
+        return p.project(A, n_threads);
+    }
+    template <class Derived>
+    Eigen::MatrixXd projectColumns(projector<Scalar>& p, const Eigen::MatrixBase<Derived>& A, const unsigned int n_threads) {
+        return p.project(Eigen::MatrixXd(A.template cast<double>()), n_threads);
+    }
+
+    // report the iteration just completed to "progress", and return true if the fit has been asked to stop
+    bool reportProgress() {
+        if (!progress) return false;
+        progress->iter = iter_ + 1;
+        progress->tol = tol_;
+        return progress->cancel;
+    }
+
+    // checkpoints of the fit (see "checkpoint")
+    unsigned int restart_ = 0;                            // index of the restart being fit by "fit_restarts"
+    std::shared_ptr<checkpointWriter> checkpoint_writer;  // created by the first checkpoint
+    std::shared_ptr<checkpoint> resumed;                  // checkpoint from which restart "restart_" resumes (see "resume")
+
+    bool checkpointDue() { return checkpoint_every > 0 && (iter_ + 1) % checkpoint_every == 0; }
+
+    // write the state of the fit after this iteration to "checkpoint_path" on a separate thread, after the last
+    //   checkpoint has been written. Only the factors are copied on this thread, which costs much less than an iteration.
+    void writeCheckpoint() {
+        if (!checkpoint_writer) checkpoint_writer = std::make_shared<checkpointWriter>();
+        if (!checkpoint_writer->wait()) Rcpp::stop("could not write checkpoint to '" + checkpoint_path + "'");
+        checkpoint& c = checkpoint_writer->state;
+        c.w = w.template cast<double>();
+        c.d = d.template cast<double>();
+        c.h = h.template cast<double>();
+        c.iter = iter_ + 1;
+        c.restart = restart_;
+        c.tol = tol_;
+        c.losses = losses_;
+        c.cd_tols = cd_tols_;
+        checkpointFingerprint(c.fingerprint);
+        checkpoint_writer->write(checkpoint_path);
+    }
+
+    // values of "A", target tolerance, and penalties on "w" and "h" of this fit, as recorded in checkpoints
+    void checkpointFingerprint(double* fingerprint) {
+        const double x[6] = {valuesIn(A), tol, L1[0], L1[1], L2[0], L2[1]};
+        std::copy(x, x + 6, fingerprint);
+    }
+
+    // record the best restart of "fit_restarts" so far in all later checkpoints
+    void checkpointBest(const MatrixS& w_best, const VectorS& d_best, const MatrixS& h_best, const double tol_best,
+                        const double mse_best, const std::vector<double>& losses_best, const std::vector<double>& cd_tols_best) {
+        if (!checkpoint_writer) checkpoint_writer = std::make_shared<checkpointWriter>();
+        if (!checkpoint_writer->wait()) Rcpp::stop("could not write checkpoint to '" + checkpoint_path + "'");
+        checkpoint& c = checkpoint_writer->state;
+        c.best_restart = best_model_;
+        c.w_best = w_best.template cast<double>();
+        c.d_best = d_best.template cast<double>();
+        c.h_best = h_best.template cast<double>();
+        c.best_tol = tol_best;
+        c.best_mse = mse_best;
+        c.best_losses = losses_best;
+        c.best_cd_tols = cd_tols_best;
+    }
+
+    // continue the fit from checkpoint "c"
+    void applyCheckpoint(const checkpoint& c) {
+        w = c.w.template cast<Scalar>();
+        d = c.d.template cast<Scalar>();
+        h = c.h.template cast<Scalar>();
+        iter_ = c.iter;
+        tol_ = c.tol;
+        losses_ = c.losses;
+        cd_tols_ = c.cd_tols;
+        frozen_.clear();
+    }
+
+    bool racing = false;     // true while restarts are raced in "fit_race"
+    double race_loss_ = 0;   // squared error less "||A||^2" from the last update of "w", while "racing"
+
+    // mean squared error of the model at the end of a round of "fit_race", from the last update of "w" by the Gram identity
+    //   where possible, so that no extra pass over "A" is needed to rank restarts
+    double raceLoss() {
+        if (loss_tol) return losses_.back();
+        if (!lossFromGram()) return mse();
+        if (A_sq < 0) A_sq = squaredNorm(A);
+        return std::max(A_sq + race_loss_, 0.0) / ((double)h.cols() * w.cols());
+    }
+
+    // fit restarts by successive halving: every restart is fit for "race" iterations, the half with the greatest loss
+    //   is dropped, and the rest are fit for another "race" iterations, until one restart remains and is fit to
+    //   convergence
+    //  * restarts are resumed exactly where they stopped, so a restart that is never dropped is fit exactly as it
+    //      would be without racing
+    //  * restarts with a loss within "race_tol" of the least loss (relative to it) are never dropped, so that
+    //      "race_tol = Inf" fits every restart to convergence
+    //  * restarts that converge are not fit further, but remain in the race. The best model is selected from the
+    //      remaining restarts by least MSE as in "fit_restarts".
+    void fit_race(const std::vector<initW>& w_inits, const MatrixS& h_init) {
+        if (freeze_tol > 0 || accelerate || anderson > 0) Rcpp::stop("restarts cannot be raced with 'freeze_tol' or acceleration");
+        struct racer {
+            MatrixS w, h;
+            VectorS d;
+            double tol, loss;
+            unsigned int iter;
+            std::vector<double> losses, cd_tols;
+        };
+        const unsigned int n = w_inits.size(), maxit_ = maxit;
+        const bool verbose_ = verbose, sort_model_ = sort_model;
+        const VectorS d_init = d;
+        std::vector<racer> racers(n);
+        std::vector<unsigned int> alive(n);
+        for (unsigned int i = 0; i < n; ++i) alive[i] = i;
+        verbose = false;
+        sort_model = false;
+        racing = true;
+        for (unsigned int round_end = 0, round = 1;; ++round) {
+            round_end = alive.size() == 1 ? maxit_ : std::min(round_end + race, maxit_);
+            bool converged = true;
+            for (const unsigned int i : alive) {
+                racer& r = racers[i];
+                if (round > 1 && r.tol < tol) continue;
+                if (round == 1) {
+                    w = w_inits[i].matrix(A.rows()).template cast<Scalar>();
+                    h = h_init;
+                    d = d_init;
+                    tol_ = 1;
+                    iter_ = 0;
+                } else {
+                    w.swap(r.w);
+                    h.swap(r.h);
+                    d.swap(r.d);
+                    losses_.swap(r.losses);
+                    cd_tols_.swap(r.cd_tols);
+                    tol_ = r.tol;
+                    iter_ = r.iter;
+                }
+                maxit = round_end;
+                fit();
+                r.loss = raceLoss();
+                r.tol = tol_;
+                r.iter = iter_;
+                w.swap(r.w);
+                h.swap(r.h);
+                d.swap(r.d);
+                losses_.swap(r.losses);
+                cd_tols_.swap(r.cd_tols);
+                if (r.tol >= tol) converged = false;
+            }
+            if (verbose_) {
+                Rprintf("round %i: %i models fit to iteration %i, MSE =", round, (int)alive.size(), round_end);
+                for (const unsigned int i : alive) Rprintf(" %8.4e", racers[i].loss);
+                Rprintf("\n");
+            }
+            if (round_end == maxit_ || converged || alive.size() == 1) break;
+
+            // keep the better half, ties resolved in favor of the earliest restart, and any restart within "race_tol" of the best
+            std::sort(alive.begin(), alive.end(), [&racers](const unsigned int a, const unsigned int b) {
+                return racers[a].loss < racers[b].loss || (racers[a].loss == racers[b].loss && a < b);
+            });
+            const double keep_loss = racers[alive[0]].loss + race_tol * std::abs(racers[alive[0]].loss);
+            unsigned int n_keep = (alive.size() + 1) / 2;
+            while (n_keep < alive.size() && racers[alive[n_keep]].loss <= keep_loss) ++n_keep;
+            alive.resize(n_keep);
+            std::sort(alive.begin(), alive.end());
+        }
+        racing = false;
+        maxit = maxit_;
+        verbose = verbose_;
+        sort_model = sort_model_;
+
+        // select the best remaining restart by MSE
+        double mse_best = 0;
+        for (const unsigned int i : alive) {
+            racer& r = racers[i];
+            w.swap(r.w);
+            h.swap(r.h);
+            d.swap(r.d);
+            const double mse_i = mse();
+            w.swap(r.w);
+            h.swap(r.h);
+            d.swap(r.d);
+            if (i == alive[0] || mse_i < mse_best) {
+                mse_best = mse_i;
+                best_model_ = i;
+            }
+        }
+        racer& r = racers[best_model_];
+        w.swap(r.w);
+        h.swap(r.h);
+        d.swap(r.d);
+        losses_.swap(r.losses);
+        cd_tols_.swap(r.cd_tols);
+        tol_ = r.tol;
+        iter_ = r.iter;
+        mse_ = mse_best;
+        frozen_.clear();
+        if (verbose) Rprintf("best model: %i/%i, iter = %i, MSE: %8.4e\n", best_model_ + 1, n, iter_, mse_);
+        if (sort_model) sortByDiagonal();
+    }
+
+    // compute "t(A)" (and the transposed masking matrix) once, and reuse it across all iterations and restarts
+    //  * "t(A)" may already have been given by "setTranspose"
+    //  * dense "A" is never transposed (see "transposedA")
+    //  * without "transpose", only the chunks of rows of sparse "A" from which "w" is updated are computed (see "predictRows")
+    void transposeA() {
+        if (!transposed) {
+            phaseTimer timer(profiler(), PHASE_TRANSPOSE);
+            if (transpose)
+                cacheTranspose(A);
+            else
+                cacheRowChunks(A);
             if (mask) {
-                std::vector<unsigned int> m = mask_matrix.InnerIndices(i);
-                for (unsigned int it = 0; it < m.size(); ++it)
-                    wh_i(m[it]) = 0;
+                t_mask_matrix = mask_matrix.transpose(threads);
+                lease(MEM_TRANSPOSE, t_mask_matrix.bytes());
             }
-            losses(i) += wh_i.array().square().sum();
+            transposed = true;
         }
+        indexMask(A);
     }
 
-    // divide total loss by number of applicable measurements
-    if (mask)
-        return losses.sum() / ((h.cols() * w.cols()) - mask_matrix.i.size());
-    else if (mask_zeros)
-        return losses.sum() / A.x.size();
-    return losses.sum() / ((h.cols() * w.cols()));
+    // merge sparse "A" with "mask_matrix", and "t(A)" with its transpose once it is computed, for masked updates and
+    //   "mse_masked" (see "maskIndex")
+    //  * built once per fit, on the calling thread before copies of this model are fit concurrently (see "transposeA"),
+    //      and shared by the copies like "t_A"
+    template <typename Value>
+    void indexMask(Rcpp::SparseMatrixOf<Value>& A) {
+        if (!mask) return;
+        if (!mask_index) {
+            mask_index = std::make_shared<const maskIndex>(A, mask_matrix, kernelThreads(threads, 0, 0));
+            lease(MEM_MASK, mask_index->bytes());
+        }
+        if (transposed && t_A && !t_mask_index) {
+            t_mask_index = std::make_shared<const maskIndex>(*t_A, t_mask_matrix, kernelThreads(threads, 0, 0));
+            lease(MEM_MASK, t_mask_index->bytes());
+        }
+    }
+    template <class Derived>
+    void indexMask(Eigen::MatrixBase<Derived>& A) {}
+
+    template <typename Value>
+    void cacheTranspose(Rcpp::SparseMatrixOf<Value>& A) {
+        if (!t_A) {
+            t_A = std::make_shared<T>(A.transpose(threads));
+            if (numaActive()) *t_A = placedCopy(*t_A, kernelThreads(threads, 0, 0));
+            adviseHugePages(*t_A);
+            lease(MEM_TRANSPOSE, t_A->bytes());
+        }
+        if (compress_indices) compressIndices(*t_A);
+    }
+    template <class Derived>
+    void cacheTranspose(Eigen::MatrixBase<Derived>& A) {}
+
+    // ITERATIVELY REWEIGHTED LEAST SQUARES
+    // weight each non-zero of sparse "A" by the robust loss "robust" of its residual in the current model, for the
+    //   updates of the next iteration (see "predict_weighted")
+    //  * the threshold of the loss is "robust_c" (1.345 for Huber, 4.685 for Tukey, if 0) times the robust standard
+    //      deviation "1.4826 median(|r|)" of the residuals "r" at non-zeros, and zeros of "A" are weighted by 1, so
+    //      that weights are held on the sparsity pattern of "A" alone
+    //  * weights of "t(A)" are gathered from those of "A" through the position in "A" of each non-zero of "t(A)", which
+    //      is found once by a counting sort of the rows of "A"
+    //  * residuals are found in parallel over columns, each from "diag(d) h" of its column dotted with "w" at each row
+    template <typename Value>
+    void reweight(Rcpp::SparseMatrixOf<Value>& A) {
+        const int n = A.cols(), nnz = A.p[n];
+        if (t_order.empty()) {
+            std::vector<int> next(A.rows() + 1, 0);
+            for (int k = 0; k < nnz; ++k) ++next[A.i[k] + 1];
+            for (int r = 0; r < A.rows(); ++r) next[r + 1] += next[r];
+            t_order.resize(nnz);
+            for (int j = 0; j < n; ++j)
+                for (int k = A.p[j]; k < A.p[j + 1]; ++k) t_order[next[A.i[k]]++] = k;
+            robust_w.resize(nnz);
+            t_robust_w.resize(nnz);
+            abs_r.resize(nnz);
+        }
+        const unsigned int n_threads = lossThreads(2.0 * w.rows() * nnz);
+        RcppML::taskCounter next_col(n);
+        RcppML::forWorkers(n_threads, [&](const int, const int) {
+            VectorS h_d(w.rows());
+            int j;
+            while (next_col.take(j)) {
+                h_d = h.col(j).cwiseProduct(d);
+                int k = A.p[j];
+                for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, j); it; ++it, ++k) {
+                    robust_w[k] = (Scalar)it.value() - w.col(it.row()).dot(h_d);
+                    abs_r[k] = std::abs(robust_w[k]);
+                }
+            }
+        });
+        if (nnz == 0) return;
+        std::nth_element(abs_r.begin(), abs_r.begin() + nnz / 2, abs_r.end());
+        robust_scale_ = 1.4826 * abs_r[nnz / 2];
+        const double delta = ((robust_c > 0) ? robust_c : (robust == ROBUST_HUBER) ? HUBER_C : TUKEY_C) * robust_scale_;
+        // each worker weights an equal range of non-zeros
+        RcppML::forWorkers(n_threads, [&](const int worker, const int n_workers) {
+            const int end = (int)((long long)nnz * (worker + 1) / n_workers);
+            for (int k = (int)((long long)nnz * worker / n_workers); k < end; ++k)
+                robust_w[k] = (delta > 0) ? (Scalar)robustWeight(robust_w[k], delta, robust) : 1;
+        });
+        RcppML::forWorkers(n_threads, [&](const int worker, const int n_workers) {
+            const int end = (int)((long long)nnz * (worker + 1) / n_workers);
+            for (int k = (int)((long long)nnz * worker / n_workers); k < end; ++k) t_robust_w[k] = robust_w[t_order[k]];
+        });
+    }
+    template <class Derived>
+    void reweight(Eigen::MatrixBase<Derived>& A) {}
+
+    // "predict_weighted" of "x" from "y" and "A" with "weights" of its non-zeros, or false if there are none (e.g. in the
+    //   first iteration, or for dense "A")
+    template <typename Value>
+    bool predictReweighted(Rcpp::SparseMatrixOf<Value>& A, const std::vector<Scalar>& weights, const MatrixS& y, MatrixS& x,
+                           const double L1, const double L2, const unsigned int n_threads, const bool warm) {
+        if (weights.empty()) return false;
+        predict_weighted(A, weights.data(), y, x, L1, L2, n_threads, upper_bound, solver, stop_tol_, warm);
+        return true;
+    }
+    template <class Derived>
+    bool predictReweighted(const Eigen::MatrixBase<Derived>& A, const std::vector<Scalar>& weights, const MatrixS& y, MatrixS& x,
+                           const double L1, const double L2, const unsigned int n_threads, const bool warm) {
+        return false;
+    }
+
+    template <typename Value>
+    static bool sparseA(Rcpp::SparseMatrixOf<Value>& A) { return true; }
+    template <class Derived>
+    static bool sparseA(Eigen::MatrixBase<Derived>& A) { return false; }
+
+    template <typename Value>
+    void cacheRowChunks(Rcpp::SparseMatrixOf<Value>& A) {
+        if (row_chunks.empty()) row_chunks = rowChunks(A, ROW_CHUNKS_PER_THREAD * kernelThreads(threads, 0, 0));
+    }
+    template <class Derived>
+    void cacheRowChunks(Eigen::MatrixBase<Derived>& A) {}
+
+    // update "w" from "hh^T" and "hA^T" of sparse "A" read in place, without "t(A)" (see "gramRhsRows"), if not "transpose"
+    //  * "hA^T" is held for all of "w" at once, so this holds "k x m" values rather than a copy of "A"
+    //  * "w" is solved as by "predict_gram", from the Cholesky solution of each row rather than from "w", and returns false
+    //      where "w" is updated from "t(A)" (or from "A" if symmetric)
+    template <typename Value>
+    bool predictRows(Rcpp::SparseMatrixOf<Value>& A, const unsigned int n_threads, double* loss) {
+        if (transpose || symmetric) return false;
+        const MatrixS a = gram(h, n_threads);
+        B_rows.setZero(w.rows(), A.rows());
+        gramRhsRows(A, h, B_rows, row_chunks, n_threads);
+        predict_gram(a, B_rows, w, L1[0], L2[0], n_threads, upper_bound, solver, stop_tol_, loss);
+        return true;
+    }
+    template <class Derived>
+    bool predictRows(Eigen::MatrixBase<Derived>& A, const unsigned int n_threads, double* loss) { return false; }
+
+    // hold "bytes" of subsystem "s" in the memory accounts (see "memoryLease") until this model and all of its copies
+    //   are destroyed, for allocations that they share
+    void lease(const memory_subsystem s, const double bytes) {
+        if (memoryAccounting().active()) leases.push_back(std::make_shared<const memoryLease>(s, bytes));
+    }
+
+    // with NUMA placement, replace sparse "A" by a copy whose columns are on the nodes of the threads that update them
+    //   (see "placedCopy"), once. The data given to the model is not changed.
+    template <typename Value>
+    void placeA(Rcpp::SparseMatrixOf<Value>& A) {
+        if (placed || !numaActive()) return;
+        A = placedCopy(A, kernelThreads(threads, 0, 0));
+        adviseHugePages(A);
+        placed = true;
+    }
+    template <class Derived>
+    void placeA(Eigen::MatrixBase<Derived>& A) {}
+
+    // "t(A)" for updates of "w": the cached transpose of sparse "A", or a transposed view of dense "A", which "predict"
+    //   reads in place by products over blocks of its rows, so that dense fits never hold a second copy of "A"
+    // loss of an iteration overlapped with the next update of "h" (see "updateLossAhead")
+    MatrixS h_loss;                 // snapshot of "h" of the iteration whose loss is computed
+    VectorS d_loss;                 // snapshot of "d" of that iteration
+    bool evaluating = false;        // losses are of the snapshot rather than the model
+    bool h_ahead = false;           // "h" of this iteration was updated with the loss of the last
+    unsigned int update_threads_ = 0, loss_threads_ = 0;  // threads of each while they overlap, or 0
+    const MatrixS& lossH() const { return evaluating ? h_loss : h; }
+    const VectorS& lossD() const { return evaluating ? d_loss : d; }
+
+    // profile of "fit", if "profile" (see "fitProfile")
+    fitProfile profile_;
+    fitProfile* profiler() { return profile ? &profile_ : NULL; }
+
+    // values of "A" read by an update of "h" or "w": the non-zeros of sparse "A", or all values of dense "A"
+    template <typename Value>
+    static double valuesIn(Rcpp::SparseMatrixOf<Value>& A) { return A.p[A.cols()]; }
+    template <class Derived>
+    static double valuesIn(Eigen::MatrixBase<Derived>& A) { return (double)A.rows() * A.cols(); }
+
+    // threads for an update of "n" columns of "h" (or "w") from "n_features" rows of "A", if "threads" is 0 (see "updateThreads")
+    //  * "planned" threads, if not 0, are used instead, but no more than "threads" (e.g. of each of concurrent restarts)
+    unsigned int updateThreads(const unsigned int n, const unsigned int n_features, const unsigned int planned = 0) {
+        if (update_threads_ > 0) return update_threads_;
+        if (planned > 0) return (threads > 0) ? std::min(planned, threads) : planned;
+        return RcppML::updateThreads(threads, valuesIn(A), w.rows(), n, n_features);
+    }
+
+    // threads for a loss of "flops" floating point operations over the values of "A", if "threads" is 0 (see "kernelThreads")
+    unsigned int lossThreads(const double flops) {
+        if (loss_threads_ > 0) return loss_threads_;
+        return kernelThreads(threads, flops, valuesIn(A) * sizeof(double) + (double)w.rows() * (A.rows() + A.cols()) * sizeof(Scalar));
+    }
+
+    template <typename Value>
+    Rcpp::SparseMatrixOf<Value>& transposedA(Rcpp::SparseMatrixOf<Value>& A) {
+        transposeA();
+        return *t_A;
+    }
+    template <class Derived>
+    Eigen::Transpose<Derived> transposedA(Eigen::MatrixBase<Derived>& A) {
+        transposeA();
+        return A.derived().transpose();
+    }
+
+    // decide how many restarts to fit concurrently, in tasks of one team of "threads" (see "RcppML::forSlots")
+    //  * updates of "h" and "w" are parallelized over columns and rows of "A", so each fit can keep roughly
+    //    one thread busy per RESTART_MIN_DIM_PER_THREAD columns/rows in the smaller dimension of "A"
+    //  * remaining threads are used to fit restarts concurrently. Threads of the team are not divided between fits:
+    //      threads that are not fitting a restart take tiles of the updates of any restart (see "RcppML::forWorkers"),
+    //      so that they are not left idle as fits finish or converge at different rates.
+    unsigned int concurrentRestarts(const unsigned int n_restarts) {
+        unsigned int n_threads = threads;
+#ifdef _OPENMP
+        if (n_threads == 0) n_threads = omp_get_max_threads();
+#else
+        n_threads = 1;
+#endif
+        if (n_restarts < 2 || n_threads < 2) return 1;
+        const unsigned int min_dim = std::min(A.rows(), A.cols());
+        const unsigned int threads_per_fit = std::max(1u, std::min(n_threads, min_dim / RESTART_MIN_DIM_PER_THREAD));
+        return std::max(1u, std::min(n_restarts, n_threads / threads_per_fit));
+    }
+
+    // fit restarts concurrently on copies of this model that share "A" and its cached transpose
+    //  * each of "n_concurrent" tasks fits restarts in turn on one working copy (see "RcppML::forSlots"), drawing "w" of
+    //      each restart as it begins, and keeps only the factors of its best restart so far, so that memory grows with
+    //      the number of concurrent fits rather than with the number of restarts
+    //  * the best restart of all tasks is selected by the least MSE, resolving ties in favor of the earliest restart
+    //      as in a serial fit, so that the selection does not depend on which task fit each restart
+    void fit_concurrent(const std::vector<initW>& w_inits, const unsigned int n_concurrent) {
+        if (!symmetric) transposeA();
+        if (verbose) Rprintf("Fitting %i models on %i concurrent threads\n", (int)w_inits.size(), n_concurrent);
+        nmf<T, Scalar> init = *this;
+        init.verbose = false;
+        init.interruptible = false;
+        init.checked = true;
+        std::vector<nmf<T, Scalar> > workers(n_concurrent, init);
+        // working copies and the best factors of each
+        const memoryLease copies(MEM_RESTARTS, 2.0 * n_concurrent * (w.size() + h.size() + d.size()) * sizeof(Scalar));
+        struct restart {
+            MatrixS w, h;
+            VectorS d;
+            double tol, mse;
+            unsigned int iter;
+            std::vector<double> losses, cd_tols, frozen;
+        };
+        std::vector<restart> best(n_concurrent);
+        std::vector<int> best_restart(n_concurrent, -1), iters(w_inits.size());
+        std::vector<double> tols(w_inits.size()), mses(w_inits.size());
+
+        RcppML::forSlots(w_inits.size(), n_concurrent, threads, [&](const unsigned int i, const unsigned int t) {
+            nmf<T, Scalar>& m = workers[t];
+            m.w = w_inits[i].matrix(A.rows()).template cast<Scalar>();
+            m.h = init.h;
+            m.d = init.d;
+            m.tol_ = 1;
+            m.iter_ = 0;
+            m.fit();
+            m.mse_ = m.mse();
+            iters[i] = m.iter_;
+            tols[i] = m.tol_;
+            mses[i] = m.mse_;
+            // factors are swapped out of the working copy, which draws a new "w" and resets "h" and "d" for its next restart
+            if (best_restart[t] < 0 || m.mse_ < best[t].mse) {
+                restart& b = best[t];
+                b.w.swap(m.w);
+                b.h.swap(m.h);
+                b.d.swap(m.d);
+                b.tol = m.tol_;
+                b.mse = m.mse_;
+                b.iter = m.iter_;
+                b.losses = m.losses_;
+                b.cd_tols = m.cd_tols_;
+                b.frozen = m.frozen_;
+                best_restart[t] = i;
+            }
+        });
+
+        if (verbose)
+            for (unsigned int i = 0; i < w_inits.size(); ++i)
+                Rprintf("model %i/%i: iter = %i, tol = %4.2e, MSE = %8.4e\n", i + 1, (int)w_inits.size(), iters[i], tols[i], mses[i]);
+        unsigned int t_best = 0;
+        for (unsigned int t = 1; t < n_concurrent; ++t) {
+            if (best_restart[t] < 0) continue;
+            if (best_restart[t_best] < 0 || best[t].mse < best[t_best].mse || (best[t].mse == best[t_best].mse && best_restart[t] < best_restart[t_best]))
+                t_best = t;
+        }
+        restart& r = best[t_best];
+        best_model_ = best_restart[t_best];
+        w.swap(r.w);
+        h.swap(r.h);
+        d.swap(r.d);
+        tol_ = r.tol;
+        iter_ = r.iter;
+        mse_ = r.mse;
+        losses_ = r.losses;
+        cd_tols_ = r.cd_tols;
+        frozen_ = r.frozen;
+        Rcpp::checkUserInterrupt();
+    }
+
+    template <typename Value>
+    Rcpp::SparseMatrixOf<Value> submat(Rcpp::SparseMatrixOf<Value>& A, const Eigen::VectorXi& cols) { return A.submat(cols); }
+    MatrixS submat(Eigen::Ref<MatrixS> A, const Eigen::VectorXi& cols) { return ::submat(A, cols); }
+
+    // add "hA^T" to "B"
+    template <typename Value>
+    void addHAt(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& h, MatrixS& B) {
+        if (!transpose) {
+            addHAtCached(A, h, B);
+            return;
+        }
+        Rcpp::SparseMatrixOf<Value> t_A = A.transpose(threads);
+        addHtA(t_A, h, B);
+    }
+    void addHAt(Eigen::Ref<MatrixS> A, const MatrixS& h, MatrixS& B) { B.noalias() += h * A.transpose(); }
+
+    // add "hA^T" to "B" for all of "A", from its cached transpose (see "transposeA"), so that it is safe on copies of
+    //   this model fit on worker threads
+    //  * without "transpose", from "A" in place (see "gramRhsRows")
+    template <typename Value>
+    void addHAtCached(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& h, MatrixS& B) {
+        if (!transpose && !symmetric) {
+            transposeA();
+            gramRhsRows(A, h, B, row_chunks, threads);
+        } else {
+            addHtA(symmetric ? A : transposedA(A), h, B);
+        }
+    }
+    void addHAtCached(Eigen::Ref<MatrixS> A, const MatrixS& h, MatrixS& B) { addHAt(A, h, B); }
+
+    // add "h t_A" to "B", given "t_A = A^T", over its columns so that threads never update the same column of "B"
+    template <typename Value>
+    void addHtA(Rcpp::SparseMatrixOf<Value>& t_A, const MatrixS& h, MatrixS& B) {
+        RcppML::forEach(t_A.cols(), threads, [&](const int j) {
+            for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(t_A, j); it; ++it)
+                B.col(j) += (Scalar)it.value() * h.col(it.row());
+        });
+    }
+    template <typename Value>
+    double mse(Rcpp::SparseMatrixOf<Value>& A);
+    double mse(Eigen::Ref<MatrixS> A);
+    template <typename Value>
+    double mse_gram(Rcpp::SparseMatrixOf<Value>& A);
+    template <typename Value>
+    double mse_masked(Rcpp::SparseMatrixOf<Value>& A);
+    double mse_masked(Eigen::Ref<MatrixS> A);
+    template <typename Value>
+    Eigen::VectorXd residualNorms(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& wd);
+    Eigen::VectorXd residualNorms(Eigen::Ref<MatrixS> A, const MatrixS& wd);
+    template <typename Value>
+    VectorS residual(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& wd, const int j);
+    VectorS residual(Eigen::Ref<MatrixS> A, const MatrixS& wd, const int j);
 };
 
-template <>
-double nmf<Eigen::MatrixXd>::mse() {
-    Eigen::MatrixXd w0 = w.transpose();
+// nmf class methods with specialized dense/sparse backends
+//  * losses are accumulated in double precision regardless of "Scalar"
+//  * losses are of the snapshot of "h" and "d" while the next "h" is updated (see "updateLossAhead")
+template <class T, typename Scalar>
+template <typename Value>
+double nmf<T, Scalar>::mse(Rcpp::SparseMatrixOf<Value>& A) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::InnerIterator InnerIteratorA;
+    const MatrixS& h_eval = lossH();
+    const VectorS& d_eval = lossD();
+    if (!mask && !mask_zeros && !mask_hash) return mse_gram(A);
+
+    MatrixS w0 = w.transpose();
     // multiply w by diagonal
     for (unsigned int i = 0; i < w0.cols(); ++i)
         for (unsigned int j = 0; j < w0.rows(); ++j)
-            w0(j, i) *= d(i);
+            w0(j, i) *= d_eval(i);
 
-    // compute losses across all samples in parallel
-    Eigen::ArrayXd losses(h.cols());
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-    for (unsigned int i = 0; i < h.cols(); ++i) {
-        Eigen::VectorXd wh_i = w0 * h.col(i);
-        if (mask_zeros) {
-            for (unsigned int iter = 0; iter < A.rows(); ++iter)
-                if (A(iter, i) != 0)
-                    losses(i) += std::pow(wh_i(iter) - A(iter, i), 2);
-        } else {
-            for (unsigned int iter = 0; iter < A.rows(); ++iter)
-                wh_i(iter) -= A(iter, i);
-            if (mask) {
-                std::vector<unsigned int> m = mask_matrix.InnerIndices(i);
-                for (unsigned int it = 0; it < m.size(); ++it)
-                    wh_i(m[it]) = 0;
+    // compute losses across all samples in parallel, over chunks of columns with similar numbers of non-zeros
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(h_eval.cols()), n_masked = Eigen::ArrayXd::Zero(h_eval.cols());
+    const unsigned int n_threads = lossThreads(2.0 * w.rows() * A.rows() * A.cols());
+    RcppML::forEach((int)chunks.size() - 1, n_threads, [&](const int chunk) {
+        for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+            VectorS wh_i = w0 * h_eval.col(i);
+            if (mask_zeros) {
+                for (InnerIteratorA iter(A, i); iter; ++iter)
+                    losses(i) += std::pow(wh_i(iter.row()) - iter.value(), 2);
+            } else {
+                for (InnerIteratorA iter(A, i); iter; ++iter)
+                    wh_i(iter.row()) -= (Scalar)iter.value();
+                if (mask)
+                    for (const int row : mask_matrix.InnerIndexView(i)) wh_i(row) = 0;
+                else if (mask_hash)
+                    for (unsigned int row = 0; row < wh_i.size(); ++row)
+                        if (hashed_mask(row, i)) {
+                            wh_i(row) = 0;
+                            ++n_masked(i);
+                        }
+                losses(i) += wh_i.template cast<double>().array().square().sum();
             }
-            losses(i) += wh_i.array().square().sum();
         }
-    }
+    });
 
     // divide total loss by number of applicable measurements
     if (mask)
-        return losses.sum() / ((h.cols() * w.cols()) - mask_matrix.i.size());
+        return losses.sum() / ((h_eval.cols() * w.cols()) - mask_matrix.i.size());
+    else if (mask_hash)
+        return losses.sum() / ((h_eval.cols() * w.cols()) - n_masked.sum());
     else if (mask_zeros)
         return losses.sum() / n_nonzeros(A);
-    return losses.sum() / ((h.cols() * w.cols()));
+    return losses.sum() / ((h_eval.cols() * w.cols()));
 };
 
-template <>
-double nmf<Rcpp::SparseMatrix>::mse_masked() {
-    if (!mask) Rcpp::stop("'mse_masked' can only be run when a masking matrix has been specified");
+// total squared error of an unmasked sparse model without computing the dense reconstruction:
+//   ||A - wdh||^2 = ||A||^2 - 2 * sum(A_ij * (wdh)_ij over nonzeros) + sum((wd(wd)^T) o (hh^T))
+//   in O(nnz * k + (m + n) * k^2) rather than the O(m * n * k) of the explicit reconstruction
+template <class T, typename Scalar>
+template <typename Value>
+double nmf<T, Scalar>::mse_gram(Rcpp::SparseMatrixOf<Value>& A) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::InnerIterator InnerIteratorA;
+    const MatrixS& h_eval = lossH();
+    const VectorS& d_eval = lossD();
+    Eigen::MatrixXd wd = w.template cast<double>();
+    for (unsigned int i = 0; i < wd.rows(); ++i)
+        wd.row(i) *= (double)d_eval(i);
+    const Eigen::MatrixXd h0 = h_eval.template cast<double>();
+
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    Eigen::ArrayXd cross = Eigen::ArrayXd::Zero(h_eval.cols());
+    const unsigned int n_threads = lossThreads(2.0 * w.rows() * valuesIn(A));
+    RcppML::forEach((int)chunks.size() - 1, n_threads, [&](const int chunk) {
+        for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+            // ||A.col(i)||^2 - 2 * A.col(i)^T (wdh).col(i), evaluated only at nonzeros
+            for (InnerIteratorA iter(A, i); iter; ++iter)
+                cross(i) += iter.value() * (iter.value() - 2 * wd.col(iter.row()).dot(h0.col(i)));
+        }
+    });
+
+    const Eigen::MatrixXd w_gram = gram(wd, n_threads);
+    const Eigen::MatrixXd h_gram = gram(h0, n_threads);
+    const double loss = cross.sum() + (w_gram.array() * h_gram.array()).sum();
+
+    // cancellation can leave a tiny negative loss for near-exact models
+    return std::max(loss, 0.0) / ((h_eval.cols() * w.cols()));
+};
 
-    Eigen::MatrixXd w0 = w.transpose();
+// residuals are computed by tiles of columns, as one GEMM of "w0" with a block of "h" followed by a fused subtract,
+//   square, and accumulate over the tile, on no more than the threads of the loss (see "eigenThreads")
+template <class T, typename Scalar>
+double nmf<T, Scalar>::mse(Eigen::Ref<MatrixS> A) {
+    const MatrixS& h_eval = lossH();
+    const VectorS& d_eval = lossD();
+    MatrixS w0 = w.transpose();
+    // multiply w by diagonal
     for (unsigned int i = 0; i < w0.cols(); ++i)
         for (unsigned int j = 0; j < w0.rows(); ++j)
-            w0(j, i) *= d(i);
+            w0(j, i) *= d_eval(i);
 
-    Eigen::ArrayXd losses(h.cols());
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-    for (unsigned int i = 0; i < h.cols(); ++i) {
-        std::vector<unsigned int> masked_rows = mask_matrix.InnerIndices(i);
-        if (masked_rows.size() > 0) {
-            for (Rcpp::SparseMatrix::InnerIteratorInRange iter(A, i, masked_rows); iter; ++iter) {
-                losses(i) += std::pow((w0.row(iter.row()) * h.col(i)) - iter.value(), 2);
+    // compute losses across all tiles of samples in parallel
+    const int tile_size = std::max(1u, loss_tile);
+    const int n_tiles = (h_eval.cols() + tile_size - 1) / tile_size;
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(n_tiles), n_masked = Eigen::ArrayXd::Zero(n_tiles);
+    const unsigned int n_threads = lossThreads(2.0 * w.rows() * A.rows() * A.cols());
+    const eigenThreads eigen_threads(n_threads);
+    RcppML::forEach(n_tiles, n_threads, [&](const int tile) {
+        const int start = tile * tile_size, cols = std::min(tile_size, (int)h_eval.cols() - start);
+        const memoryLease tile_bytes(MEM_WORKSPACE, (double)A.rows() * cols * sizeof(Scalar));
+        MatrixS wh = w0 * h_eval.middleCols(start, cols);
+        wh -= A.middleCols(start, cols);
+        if (mask_zeros)
+            wh.array() *= (A.middleCols(start, cols).array() != (Scalar)0).template cast<Scalar>();
+        else if (mask)
+            for (int j = 0; j < cols; ++j)
+                for (const int row : mask_matrix.InnerIndexView(start + j)) wh(row, j) = 0;
+        else if (mask_hash)
+            for (int j = 0; j < cols; ++j)
+                for (unsigned int row = 0; row < wh.rows(); ++row)
+                    if (hashed_mask(row, start + j)) {
+                        wh(row, j) = 0;
+                        ++n_masked(tile);
+                    }
+        losses(tile) = wh.template cast<double>().array().square().sum();
+    });
+
+    // divide total loss by number of applicable measurements
+    if (mask)
+        return losses.sum() / ((h_eval.cols() * w.cols()) - mask_matrix.i.size());
+    else if (mask_hash)
+        return losses.sum() / ((h_eval.cols() * w.cols()) - n_masked.sum());
+    else if (mask_zeros)
+        return losses.sum() / n_nonzeros(A);
+    return losses.sum() / ((h_eval.cols() * w.cols()));
+};
+
+template <class T, typename Scalar>
+template <typename Value>
+double nmf<T, Scalar>::mse_masked(Rcpp::SparseMatrixOf<Value>& A) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::InnerIterator InnerIteratorA;
+    const MatrixS& h_eval = lossH();
+    const VectorS& d_eval = lossD();
+    if (!mask && !mask_hash) Rcpp::stop("'mse_masked' can only be run when a masking matrix has been specified");
+    indexMask(A);
+
+    // row-major, so that the row of "w0" gathered for each masked entry is contiguous
+    RowMatrixS w0 = w.transpose();
+    for (unsigned int i = 0; i < w0.cols(); ++i)
+        w0.col(i) *= d_eval(i);
+
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(h_eval.cols()), n_masked = Eigen::ArrayXd::Zero(h_eval.cols());
+    const unsigned int n_threads = lossThreads(2.0 * w.rows() * (mask_hash ? (double)A.rows() * A.cols() : (double)mask_matrix.i.size()));
+    RcppML::forEach(h_eval.cols(), n_threads, [&](const int i) {
+        // masked rows and their values in "A.col(i)" are read from the merged stream of "A" and "mask_matrix"
+        if (mask_index && !mask_hash) {
+            const maskIndex& f = *mask_index;
+            for (int k = f.p[i]; k < f.p[i + 1]; ++k)
+                if (f.flags[k] & maskIndex::IN_MASK) losses(i) += std::pow(w0.row(f.i[k]).dot(h_eval.col(i)) - f.x[k], 2);
+            return;
+        }
+        InnerIteratorA iter(A, i);
+        if (mask_hash) {
+            for (unsigned int row = 0; row < w0.rows(); ++row) {
+                if (!hashed_mask(row, i)) continue;
+                while (iter && iter.row() < (int)row) ++iter;
+                const double a_ij = (iter && iter.row() == (int)row) ? iter.value() : 0;
+                losses(i) += std::pow(w0.row(row).dot(h_eval.col(i)) - a_ij, 2);
+                ++n_masked(i);
             }
-            // get masked rows that are also zero in A.col(i)
-            std::vector<unsigned int> zero_rows = A.emptyInnerIndices(i);
-            std::vector<unsigned int> masked_zero_rows;
-            std::set_intersection(zero_rows.begin(), zero_rows.end(),
-                                  masked_rows.begin(), masked_rows.end(),
-                                  std::back_inserter(masked_zero_rows));
-            for (unsigned int it = 0; it < masked_zero_rows.size(); ++it)
-                losses(i) += std::pow(w0.row(masked_zero_rows[it]) * h.col(i), 2);
+            return;
         }
-    }
-    return losses.sum() / mask_matrix.i.size();
+        for (const int row : mask_matrix.InnerIndexView(i)) {
+            while (iter && iter.row() < row) ++iter;
+            const double a_ij = (iter && iter.row() == row) ? iter.value() : 0;
+            losses(i) += std::pow(w0.row(row).dot(h_eval.col(i)) - a_ij, 2);
+        }
+    });
+    return losses.sum() / (mask_hash ? n_masked.sum() : mask_matrix.i.size());
 };
 
-template <>
-double nmf<Eigen::MatrixXd>::mse_masked() {
-    if (!mask) Rcpp::stop("'mse_masked' can only be run when a masking matrix has been specified");
+template <class T, typename Scalar>
+double nmf<T, Scalar>::mse_masked(Eigen::Ref<MatrixS> A) {
+    const MatrixS& h_eval = lossH();
+    const VectorS& d_eval = lossD();
+    if (!mask && !mask_hash) Rcpp::stop("'mse_masked' can only be run when a masking matrix has been specified");
 
-    Eigen::MatrixXd w0 = w.transpose();
+    RowMatrixS w0 = w.transpose();
     for (unsigned int i = 0; i < w0.cols(); ++i)
-        for (unsigned int j = 0; j < w0.rows(); ++j)
-            w0(j, i) *= d(i);
+        w0.col(i) *= d_eval(i);
 
-    Eigen::ArrayXd losses(h.cols());
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-    for (unsigned int i = 0; i < h.cols(); ++i) {
-        std::vector<unsigned int> masked_rows = mask_matrix.InnerIndices(i);
-        for (unsigned int it = 0; it < masked_rows.size(); ++it) {
-            const unsigned int row = masked_rows[it];
-            losses(i) += std::pow((w0.row(row) * h.col(i)) - A(row, i), 2);
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(h_eval.cols()), n_masked = Eigen::ArrayXd::Zero(h_eval.cols());
+    const unsigned int n_threads = lossThreads(2.0 * w.rows() * (mask_hash ? (double)A.rows() * A.cols() : (double)mask_matrix.i.size()));
+    RcppML::forEach(h_eval.cols(), n_threads, [&](const int i) {
+        if (mask_hash) {
+            for (unsigned int row = 0; row < A.rows(); ++row)
+                if (hashed_mask(row, i)) {
+                    losses(i) += std::pow(w0.row(row).dot(h_eval.col(i)) - A(row, i), 2);
+                    ++n_masked(i);
+                }
+            return;
         }
-    }
-    return losses.sum() / mask_matrix.i.size();
+        for (const int row : mask_matrix.InnerIndexView(i))
+            losses(i) += std::pow(w0.row(row).dot(h_eval.col(i)) - A(row, i), 2);
+    });
+    return losses.sum() / (mask_hash ? n_masked.sum() : mask_matrix.i.size());
+};
+
+// squared residual of each column of "A" given "wd", by the Gram identity (see "mse_gram"), or only at non-zeros if
+//   "mask_zeros"
+template <class T, typename Scalar>
+template <typename Value>
+Eigen::VectorXd nmf<T, Scalar>::residualNorms(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& wd) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::InnerIterator InnerIteratorA;
+    const MatrixS w_gram = gram(wd);
+    Eigen::VectorXd norms = Eigen::VectorXd::Zero(h.cols());
+    RcppML::forEach(h.cols(), threads, [&](const int i) {
+        for (InnerIteratorA iter(A, i); iter; ++iter) {
+            const double wh_ij = wd.col(iter.row()).dot(h.col(i));
+            norms(i) += mask_zeros ? std::pow(wh_ij - iter.value(), 2) : iter.value() * (iter.value() - 2 * wh_ij);
+        }
+        if (!mask_zeros) norms(i) += h.col(i).dot(w_gram * h.col(i));
+    });
+    return norms;
+};
+
+template <class T, typename Scalar>
+Eigen::VectorXd nmf<T, Scalar>::residualNorms(Eigen::Ref<MatrixS> A, const MatrixS& wd) {
+    Eigen::VectorXd norms(h.cols());
+    RcppML::forEach(h.cols(), threads, [&](const int i) {
+        VectorS r = A.col(i) - wd.transpose() * h.col(i);
+        if (mask_zeros) r.array() *= (A.col(i).array() != (Scalar)0).template cast<Scalar>();
+        norms(i) = r.template cast<double>().squaredNorm();
+    });
+    return norms;
+};
+
+// residual of column "j" of "A" given "wd", or zero at zeros in "A" if "mask_zeros"
+template <class T, typename Scalar>
+template <typename Value>
+typename nmf<T, Scalar>::VectorS nmf<T, Scalar>::residual(Rcpp::SparseMatrixOf<Value>& A, const MatrixS& wd, const int j) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::InnerIterator InnerIteratorA;
+    VectorS r = mask_zeros ? VectorS::Zero(A.rows()) : VectorS(-(wd.transpose() * h.col(j)));
+    for (InnerIteratorA iter(A, j); iter; ++iter)
+        r(iter.row()) = mask_zeros ? (Scalar)iter.value() - wd.col(iter.row()).dot(h.col(j)) : r(iter.row()) + (Scalar)iter.value();
+    return r;
+};
+
+template <class T, typename Scalar>
+typename nmf<T, Scalar>::VectorS nmf<T, Scalar>::residual(Eigen::Ref<MatrixS> A, const MatrixS& wd, const int j) {
+    VectorS r = A.col(j) - wd.transpose() * h.col(j);
+    if (mask_zeros) r.array() *= (A.col(j).array() != (Scalar)0).template cast<Scalar>();
+    return r;
 };
 }  // namespace RcppML
 
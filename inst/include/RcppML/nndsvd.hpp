@@ -0,0 +1,135 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_nndsvd
+#define RcppML_nndsvd
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+// NNDSVD INITIALIZATION
+//
+// Non-negative double singular value decomposition (Boutsidis and Gallopoulos (2008), "SVD based initialization: A head
+//   start for nonnegative matrix factorization", Pattern Recognition 41(4)) of the leading "k" singular triplets of "A",
+//   which are found by a randomized range finder (Halko, Martinsson and Tropp (2011), "Finding structure with
+//   randomness", SIAM Review 53(2)):
+//  * the range of "A" is found from a sketch of "k + 10" columns (see "rangeFinder")
+//  * the singular values and vectors of the small projection "B = Q^T A" are found from the eigenvectors of "B B^T",
+//     since only Eigen/Core is bundled with RcppML
+//  * each singular vector pair is split into positive and negative parts, and the part with the greater product of
+//     norms is the factor. Values of "w" that are zero are set to the mean of "A" (NNDSVDa), so that no factor is
+//     stuck at zero in alternating least squares.
+//
+// The initial "w" is "k x A.rows()", as in "nmf".
+namespace RcppML {
+template <typename Value>
+double meanOf(Rcpp::SparseMatrixOf<Value>& A) {
+    double sum = 0;
+    for (unsigned int i = 0; i < A.cols(); ++i)
+        for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, i); it; ++it) sum += it.value();
+    return sum / ((double)A.rows() * A.cols());
+}
+
+inline double meanOf(const Eigen::MatrixXd& A) { return A.mean(); }
+
+// eigenvalues (in decreasing order) and eigenvectors (in columns) of a small symmetric matrix "a", by cyclic Jacobi
+//   rotations
+inline void symmetricEigen(Eigen::MatrixXd a, Eigen::VectorXd& values, Eigen::MatrixXd& vectors) {
+    const int n = a.rows();
+    Eigen::MatrixXd v = Eigen::MatrixXd::Identity(n, n);
+    for (int sweep = 0; sweep < 100; ++sweep) {
+        double off = 0;
+        for (int p = 0; p < n; ++p)
+            for (int q = p + 1; q < n; ++q) off += a(p, q) * a(p, q);
+        if (off <= 1e-30 * a.squaredNorm()) break;
+        for (int p = 0; p < n; ++p) {
+            for (int q = p + 1; q < n; ++q) {
+                if (a(p, q) == 0) continue;
+                const double theta = (a(q, q) - a(p, p)) / (2 * a(p, q));
+                const double t = (theta >= 0 ? 1 : -1) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                const double c = 1 / std::sqrt(t * t + 1), s = t * c;
+                for (int r = 0; r < n; ++r) {
+                    const double a_rp = a(r, p), a_rq = a(r, q);
+                    a(r, p) = c * a_rp - s * a_rq;
+                    a(r, q) = s * a_rp + c * a_rq;
+                }
+                for (int r = 0; r < n; ++r) {
+                    const double a_pr = a(p, r), a_qr = a(q, r);
+                    a(p, r) = c * a_pr - s * a_qr;
+                    a(q, r) = s * a_pr + c * a_qr;
+                }
+                for (int r = 0; r < n; ++r) {
+                    const double v_rp = v(r, p), v_rq = v(r, q);
+                    v(r, p) = c * v_rp - s * v_rq;
+                    v(r, q) = s * v_rp + c * v_rq;
+                }
+            }
+        }
+    }
+    std::vector<int> order(n);
+    for (int i = 0; i < n; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](const int i, const int j) { return a(i, i) > a(j, j); });
+    values.resize(n);
+    vectors.resize(n, n);
+    for (int i = 0; i < n; ++i) {
+        values(i) = a(order[i], order[i]);
+        vectors.col(i) = v.col(order[i]);
+    }
+}
+
+// initial "w" ("k x A.rows()") by NNDSVDa of "A", with the sketch drawn from "seed"
+template <class MatrixA>
+Eigen::MatrixXd nndsvd(MatrixA& A, const unsigned int k, const unsigned int power_iters, const uint32_t seed, const unsigned int threads) {
+    const unsigned int l = std::min(k + 10, std::min((unsigned int)A.rows(), (unsigned int)A.cols()));
+    auto t_A = transposeOf(A, threads);
+    const Eigen::MatrixXd Qt = rangeFinder(A, t_A, l, power_iters, seed, threads);
+
+    // "B = Q^T A = U_b S V^T", where "B B^T = U_b S^2 U_b^T"
+    const Eigen::MatrixXd B = leftMultiply(Qt, A, threads);
+    Eigen::VectorXd s2;
+    Eigen::MatrixXd U_b;
+    symmetricEigen(B * B.transpose(), s2, U_b);
+    const Eigen::MatrixXd Ut = U_b.transpose() * Qt, Vt = U_b.transpose() * B;
+
+    const double fill = meanOf(A);
+    Eigen::MatrixXd w(k, A.rows());
+    for (unsigned int j = 0; j < k; ++j) {
+        const double s = j < l ? std::sqrt(std::max(s2(j), 0.0)) : 0;
+        if (s == 0) {
+            w.row(j).setZero();
+        } else if (j == 0) {
+            // the leading singular vectors of a non-negative matrix have the same sign
+            w.row(j) = std::sqrt(s) * Ut.row(j).cwiseAbs();
+        } else {
+            const Eigen::RowVectorXd u = Ut.row(j), v = Vt.row(j) / s;
+            const Eigen::RowVectorXd u_pos = u.cwiseMax(0), u_neg = (-u).cwiseMax(0);
+            const double u_pos_norm = u_pos.norm(), u_neg_norm = u_neg.norm();
+            const double v_pos_norm = v.cwiseMax(0).norm(), v_neg_norm = (-v).cwiseMax(0).norm();
+            const double m_pos = u_pos_norm * v_pos_norm, m_neg = u_neg_norm * v_neg_norm;
+            if (m_pos >= m_neg && m_pos > 0)
+                w.row(j) = std::sqrt(s * m_pos) / u_pos_norm * u_pos;
+            else if (m_neg > 0)
+                w.row(j) = std::sqrt(s * m_neg) / u_neg_norm * u_neg;
+            else
+                w.row(j).setZero();
+        }
+        for (unsigned int i = 0; i < A.rows(); ++i)
+            if (w(j, i) == 0) w(j, i) = fill;
+    }
+    return w;
+}
+}  // namespace RcppML
+
+#endif
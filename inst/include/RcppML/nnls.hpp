@@ -12,136 +12,678 @@
 #include <RcppMLCommon.hpp>
 #endif
 
+#ifndef RcppML_rng
+#include <RcppML/rng.hpp>
+#endif
+
+#ifndef RcppML_profile
+#include <RcppML/profile.hpp>
+#endif
+
+// coordinate descent cannot converge beyond the machine precision of the scalar type in which it is solved,
+// so single-precision solvers stop at float epsilon rather than CD_TOL
+template <typename Scalar>
+inline double cd_tol() {
+    return std::max((double)CD_TOL, (double)std::numeric_limits<Scalar>::epsilon());
+}
+
+// coordinate descent tolerance of the next iteration of inexact alternating least squares, in which early updates
+// are solved loosely because the next iteration replaces them anyway
+//  * "last_cd_tol" is the coordinate descent tolerance of the previous iteration, or 0 in the first iteration
+//  * "last_tol" is the outer tolerance (correlation distance or relative change in loss) of the previous iteration
+//  * starts at INEXACT_CD_TOL and tightens with INEXACT_CD_RATIO * "last_tol", but never loosens, and never
+//      tightens beyond "cd_tol", so that updates are exact by the time the model converges
+template <typename Scalar>
+inline double inexactTol(const double last_cd_tol, const double last_tol) {
+    const double cd_tol_it = (last_cd_tol <= 0) ? INEXACT_CD_TOL : std::min(last_cd_tol, INEXACT_CD_RATIO * last_tol);
+    return std::max(cd_tol_it, cd_tol<Scalar>());
+}
+
+// solvers for least squares systems without an upper bound, given by "solver" in "predict"
+//  * NNLS_AUTO uses the active set method for systems of rank ACTIVE_SET_MIN_RANK or greater, and coordinate descent otherwise
+//  * NNLS_CD_GREEDY and NNLS_CD_RANDOM are coordinate descent in greedy or random order of coordinates (see "c_nnls")
+enum nnls_solver { NNLS_AUTO = 0,
+                   NNLS_CD = 1,
+                   NNLS_ACTIVE_SET = 2,
+                   NNLS_CD_GREEDY = 3,
+                   NNLS_CD_RANDOM = 4 };
+
+// true if unbounded systems of rank "k" are solved by "active_set" rather than by coordinate descent
+inline bool useActiveSet(const int solver, const unsigned int k) {
+    return solver == NNLS_ACTIVE_SET || (solver == NNLS_AUTO && k >= ACTIVE_SET_MIN_RANK);
+}
+
+// All solvers are templated on the rank "K" of the system of equations, which is either known at compile-time
+// (see "predict") or Eigen::Dynamic (-1). Fixed-size systems avoid heap allocations and allow loop unrolling.
+
+// call "fn<Scalar, K>(...)" with "K" fixed to "rank" for common small ranks, otherwise with K = Eigen::Dynamic.
+//  * every fixed rank is a separate instantiation, so the set of ranks is kept small to bound compile time.
+//  * define RCPPML_NO_FIXED_RANK to always use the dynamic-size solvers
+#ifndef RCPPML_NO_FIXED_RANK
+#define RCPPML_DISPATCH_RANK(rank, fn, ...)          \
+    switch (rank) {                                  \
+        case 2: fn<Scalar, 2>(__VA_ARGS__); break;   \
+        case 3: fn<Scalar, 3>(__VA_ARGS__); break;   \
+        case 4: fn<Scalar, 4>(__VA_ARGS__); break;   \
+        case 5: fn<Scalar, 5>(__VA_ARGS__); break;   \
+        case 6: fn<Scalar, 6>(__VA_ARGS__); break;   \
+        case 8: fn<Scalar, 8>(__VA_ARGS__); break;   \
+        case 10: fn<Scalar, 10>(__VA_ARGS__); break; \
+        case 12: fn<Scalar, 12>(__VA_ARGS__); break; \
+        case 16: fn<Scalar, 16>(__VA_ARGS__); break; \
+        case 32: fn<Scalar, 32>(__VA_ARGS__); break; \
+        default: fn<Scalar, -1>(__VA_ARGS__);        \
+    }
+#else
+#define RCPPML_DISPATCH_RANK(rank, fn, ...) fn<Scalar, -1>(__VA_ARGS__);
+#endif
+
+// Cholesky factorization "a = LL^T" of a symmetric positive definite matrix, computed once for a system of equations
+// shared by many right-hand sides (only Eigen/Core is bundled with RcppML, so Eigen::LLT is not available)
+template <typename Scalar, int K = -1>
+class cholesky {
+   public:
+    bool success = false;
+
+    cholesky(const Eigen::Matrix<Scalar, K, K>& a) : L(Eigen::Matrix<Scalar, K, K>::Zero(a.rows(), a.cols())) {
+        const unsigned int n = a.rows();
+        for (unsigned int j = 0; j < n; ++j) {
+            const Scalar d = a(j, j) - L.row(j).head(j).squaredNorm();
+            if (d <= 0) return;
+            L(j, j) = std::sqrt(d);
+            for (unsigned int i = j + 1; i < n; ++i)
+                L(i, j) = (a(i, j) - L.row(i).head(j).dot(L.row(j).head(j))) / L(j, j);
+        }
+        success = true;
+    }
+
+    // solve ax = b, where "b" is replaced by "x"
+    //  * forward and back substitution are written out rather than using triangularView, which is far more
+    //      expensive to compile for each fixed rank
+    template <class VectorB>
+    void solveInPlace(VectorB& b) const {
+        const int n = b.size();
+        for (int i = 0; i < n; ++i)
+            b(i) = (b(i) - L.row(i).head(i).dot(b.head(i))) / L(i, i);
+        for (int i = n - 1; i >= 0; --i)
+            b(i) = (b(i) - L.col(i).tail(n - i - 1).dot(b.tail(n - i - 1))) / L(i, i);
+    }
+
+    // solve aX = B for all columns of "B" at once, where "B" is replaced by "X"
+    //  * each row of "B" is substituted across all columns by one product with the rows solved before it, so that the
+    //      triangular solves of many right-hand sides stream through "B" by rows rather than column by column
+    template <class MatrixB>
+    void solveColumnsInPlace(MatrixB& B) const {
+        const int n = B.rows();
+        for (int i = 0; i < n; ++i)
+            B.row(i) = (B.row(i) - L.row(i).head(i) * B.topRows(i)) / L(i, i);
+        for (int i = n - 1; i >= 0; --i)
+            B.row(i) = (B.row(i) - L.col(i).tail(n - i - 1).transpose() * B.bottomRows(n - i - 1)) / L(i, i);
+    }
+
+   private:
+    Eigen::Matrix<Scalar, K, K> L;
+};
+
+// initialize h.col(sample) for coordinate descent by the unconstrained least squares solution of ax = b, with
+// negative values (and values above "upper_bound", if positive) truncated to the feasible region.
+// "b" is replaced by the residual "b - ax", since coordinate descent updates the residual rather than "b".
+//  * "x" is solved in place in h.col(sample), so nothing is allocated when "K" is dynamic
+template <typename Scalar, int K>
+inline void c_nnls_init(const cholesky<Scalar, K>& a_llt, Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b,
+                        Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample, const double upper_bound = 0) {
+    typename Eigen::Matrix<Scalar, -1, -1>::ColXpr x = h.col(sample);
+    x = b;
+    a_llt.solveInPlace(x);
+    for (unsigned int i = 0; i < x.size(); ++i) {
+        if (x(i) < 0)
+            x(i) = 0;
+        else if (upper_bound > 0 && x(i) > upper_bound)
+            x(i) = upper_bound;
+    }
+    b.noalias() -= a * x;
+}
+
+// initialize any solver from the solution already in h.col(sample), such as that of the previous iteration of alternating
+//   least squares, clamped to the feasible region, by setting "b" to its residual. Used where "a" differs between samples
+//   (e.g. with masking), so that it is not factorized once for "c_nnls_init".
+template <typename Scalar, int K>
+inline void c_nnls_warm(const Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h,
+                        const unsigned int sample, const double upper_bound = 0) {
+    typename Eigen::Matrix<Scalar, -1, -1>::ColXpr x = h.col(sample);
+    for (unsigned int i = 0; i < x.size(); ++i) {
+        if (!(x(i) > 0))
+            x(i) = 0;
+        else if (upper_bound > 0 && x(i) > upper_bound)
+            x(i) = upper_bound;
+    }
+    b.noalias() -= a * x;
+}
+
+// true if a sweep of "c_nnls" from the warm start in h.col(sample) would already meet "stop_tol", given its residual "b"
+//   (see "c_nnls_warm"), so that the solve may be skipped
+//  * the relative step of each coordinate from the projected gradient "b / a_ii" is summed as in "c_nnls", without
+//      updating "b", and a step that sets a coordinate to zero is never converged
+template <typename Scalar, int K>
+inline bool c_nnls_converged(const Eigen::Matrix<Scalar, K, K>& a, const Eigen::Matrix<Scalar, K, 1>& b,
+                             const Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample, const double upper_bound,
+                             const double stop_tol) {
+    const int k = b.size();
+    double tol = 0;
+    for (int i = 0; i < k; ++i) {
+        const Scalar x = h(i, sample);
+        Scalar diff = std::max(b(i) / a(i, i), -x);
+        if (upper_bound > 0) diff = std::min(diff, (Scalar)upper_bound - x);
+        if (diff == 0) continue;
+        if (x + diff == 0) return false;
+        tol += std::abs(diff / (x + diff + TINY_NUM));
+    }
+    return tol / k <= stop_tol;
+}
+
+// coordinate descent of "c_nnls" in which each update is of the coordinate that most reduces the loss, "a_ii diff_i^2"
+//   for the step "diff_i" truncated at zero (the Gauss-Southwell-Lipschitz rule). Cyclic sweeps over correlated
+//   coordinates zig-zag between them, whereas greedy updates follow the largest remaining gradient.
+//  * steps follow from the residual "b", which is updated after each step as in "c_nnls", so choosing a coordinate costs
+//      O(k), as much as the update itself
+//  * "maxit" and "stop_tol" apply to rounds of "k" updates, as to sweeps in "c_nnls", and the solve stops early when
+//      no step reduces the loss
+template <typename Scalar, int K>
+inline void c_nnls_greedy(Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h,
+                          const unsigned int sample, const unsigned int maxit, const double stop_tol) {
+    const int k = h.rows();
+    double tol = 1;
+    unsigned int it = 0;
+    for (; it < maxit && (tol / k) > stop_tol; ++it) {
+        tol = 0;
+        for (int n = 0; n < k; ++n) {
+            int i_max = -1;
+            Scalar gain_max = 0, diff_max = 0;
+            for (int i = 0; i < k; ++i) {
+                const Scalar diff = std::max(b(i) / a(i, i), -h(i, sample));
+                const Scalar gain = diff * diff * a(i, i);
+                if (gain > gain_max) {
+                    gain_max = gain;
+                    diff_max = diff;
+                    i_max = i;
+                }
+            }
+            RCPPML_COUNT(COUNT_FLOPS, 4 * k);
+            if (i_max < 0) {
+                RcppML::countSolve(it + 1, false);
+                RCPPML_COUNT(COUNT_COLUMNS, 1);
+                RCPPML_COUNT(COUNT_SUPPORT, (h.col(sample).array() > 0).count());
+                return;
+            }
+            h(i_max, sample) += diff_max;
+            b -= a.col(i_max) * diff_max;
+            RCPPML_COUNT(COUNT_UPDATES, 1);
+            RCPPML_COUNT(COUNT_FLOPS, 2 * k);
+            tol += (h(i_max, sample) == 0) ? 1 : std::abs(diff_max / (h(i_max, sample) + TINY_NUM));
+        }
+    }
+    RcppML::countSolve(it, it == maxit);
+    RCPPML_COUNT(COUNT_COLUMNS, 1);
+    RCPPML_COUNT(COUNT_SUPPORT, (h.col(sample).array() > 0).count());
+}
+
+// coordinate descent of "c_nnls" in which each sweep updates all coordinates in a random order, which breaks the
+//   zig-zag of cyclic sweeps over correlated coordinates
+//  * orders are drawn from a hash of "sample", the sweep, and the position (see "rng"), so solutions do not depend on
+//      threading. Hashes of consecutive positions are scrambled (see "scramble"), since the shuffle combines several.
+template <typename Scalar, int K>
+inline void c_nnls_random(Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h,
+                          const unsigned int sample, const unsigned int maxit, const double stop_tol) {
+    const int k = h.rows();
+    const RcppML::rng<false> r(sample);
+    Eigen::Matrix<int, K, 1> order(k);
+    for (int i = 0; i < k; ++i) order(i) = i;
+    double tol = 1;
+    unsigned int it = 0;
+    for (; it < maxit && (tol / k) > stop_tol; ++it) {
+        for (int n = k - 1; n > 0; --n) std::swap(order(n), order(RcppML::scramble(r.rand(n, it)) % (n + 1)));
+        tol = 0;
+        for (int n = 0; n < k; ++n) {
+            const int i = order(n);
+            const Scalar diff = std::max(b(i) / a(i, i), -h(i, sample));
+            if (diff == 0) continue;
+            h(i, sample) += diff;
+            b -= a.col(i) * diff;
+            RCPPML_COUNT(COUNT_UPDATES, 1);
+            RCPPML_COUNT(COUNT_FLOPS, 2 * k);
+            tol += (h(i, sample) == 0) ? 1 : std::abs(diff / (h(i, sample) + TINY_NUM));
+        }
+    }
+    RcppML::countSolve(it, it == maxit);
+    RCPPML_COUNT(COUNT_COLUMNS, 1);
+    RCPPML_COUNT(COUNT_SUPPORT, (h.col(sample).array() > 0).count());
+}
+
+// cyclic sweeps of "c_nnls" over "x" of dynamic rank "k", given "a" in column-major order, compiled for the widest
+//   vectors of the CPU (see "RCPPML_TARGET_CLONES"). Returns the number of sweeps.
+//  * fixed ranks are not dispatched, since Eigen unrolls their updates and is as fast at any width up to rank 32
+template <typename Scalar>
+RCPPML_TARGET_CLONES unsigned int cdSweeps(const Scalar* a, Scalar* __restrict b, Scalar* __restrict x, const int k,
+                                           const unsigned int maxit, const double stop_tol) {
+    double tol = 1;
+    unsigned int it = 0;
+    for (; it < maxit && (tol / k) > stop_tol; ++it) {
+        tol = 0;
+        for (int i = 0; i < k; ++i) {
+            const Scalar* __restrict a_i = a + (size_t)i * k;
+            Scalar diff = b[i] / a_i[i];
+            if (-diff > x[i]) {
+                if (x[i] == 0) continue;
+                diff = -x[i];
+                x[i] = 0;
+                tol = 1;
+            } else if (diff != 0) {
+                x[i] += diff;
+                tol += std::abs(diff / (x[i] + TINY_NUM));
+            } else {
+                continue;
+            }
+            RCPPML_PRAGMA_SIMD
+            for (int r = 0; r < k; ++r) b[r] -= a_i[r] * diff;
+            RCPPML_COUNT(COUNT_UPDATES, 1);
+            RCPPML_COUNT(COUNT_FLOPS, 2 * k);
+        }
+    }
+    return it;
+}
+
 // Non-Negative Least Squares solver
 // solve ax = b given "a", "b", and h.col(sample) giving "x", subject to non-negativity. Coordinate descent.
-inline void c_nnls(Eigen::MatrixXd& a, Eigen::VectorXd& b, Eigen::MatrixXd& h, const unsigned int sample) {
+//  * "b" is the residual of the current solution in h.col(sample), so "b" must be initialized to "b - a * h.col(sample)"
+//      when h.col(sample) is non-zero (see "c_nnls_init")
+//  * "maxit" is the maximum number of iterations, which is less than CD_MAXIT when resuming a partial solve
+//  * "stop_tol" is the stopping criterion, the mean relative change in "x" across one iteration
+//  * coordinates are swept in cyclic order, or in greedy or random order for "solver" NNLS_CD_GREEDY or NNLS_CD_RANDOM
+template <typename Scalar, int K>
+inline void c_nnls(Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample,
+                   const unsigned int maxit = CD_MAXIT, const double stop_tol = cd_tol<Scalar>(), const int solver = NNLS_CD) {
+    if (solver == NNLS_CD_GREEDY) return c_nnls_greedy(a, b, h, sample, maxit, stop_tol);
+    if (solver == NNLS_CD_RANDOM) return c_nnls_random(a, b, h, sample, maxit, stop_tol);
     double tol = 1;
-    for (unsigned int it = 0; it < CD_MAXIT && (tol / b.size()) > CD_TOL; ++it) {
+    unsigned int it = 0;
+    if (K == Eigen::Dynamic) {
+        it = cdSweeps(a.data(), b.data(), &h(0, sample), (int)b.size(), maxit, stop_tol);
+        tol = 0;
+    }
+    for (; it < maxit && (tol / b.size()) > stop_tol; ++it) {
         tol = 0;
         for (unsigned int i = 0; i < h.rows(); ++i) {
-            double diff = b(i) / a(i, i);
+            Scalar diff = b(i) / a(i, i);
             if (-diff > h(i, sample)) {
                 if (h(i, sample) != 0) {
                     b -= a.col(i) * -h(i, sample);
                     tol = 1;
                     h(i, sample) = 0;
+                    RCPPML_COUNT(COUNT_UPDATES, 1);
+                    RCPPML_COUNT(COUNT_FLOPS, 2 * b.size());
                 }
             } else if (diff != 0) {
                 h(i, sample) += diff;
                 b -= a.col(i) * diff;
                 tol += std::abs(diff / (h(i, sample) + TINY_NUM));
+                RCPPML_COUNT(COUNT_UPDATES, 1);
+                RCPPML_COUNT(COUNT_FLOPS, 2 * b.size());
             }
         }
     }
+    RcppML::countSolve(it, it == maxit);
+    RCPPML_COUNT(COUNT_COLUMNS, 1);
+    RCPPML_COUNT(COUNT_SUPPORT, (h.col(sample).array() > 0).count());
 }
 
-// Upper-bounded Non-Negative Least Squares solver
-// solve ax = b given "a", "b", and h.col(sample) giving "x", subject to non-negativity. Coordinate descent.
-inline void c_bnnls2(Eigen::MatrixXd& a, Eigen::VectorXd& b, Eigen::MatrixXd& h, const unsigned int sample, const double upper_bound) {
-    double tol = 1;
-    for (unsigned int it = 0; it < CD_MAXIT && (tol / b.size()) > CD_TOL; ++it) {
-        tol = 0;
-        for (unsigned int i = 0; i < h.rows(); ++i) {
-            double diff = b(i) / a(i, i);
-            if (diff != 0) {
-                h(i, sample) += diff;
-                b -= a.col(i) * diff;
-                tol += std::abs(diff / h(i, sample) + TINY_NUM);
+// Non-Negative Least Squares solver for many right-hand sides of the same system, "L" at a time
+//  * "L" right-hand sides are interleaved in the rows of a row-major "b", so that each coordinate update of "c_nnls" is a
+//      single vector operation across samples rather than a length-k axpy for each sample, which barely fills a SIMD
+//      register for small k. "L" is one 256-bit register of "Scalar".
+//  * each sample stops updating once it has converged. Once half or fewer are still updating, the rest are finished
+//      one at a time by "c_nnls" from where they left off. Solutions are identical to those of "c_nnls".
+//  * usage: "push" the residual "b - a * h.col(sample)" of each sample (see "c_nnls_init"), then "finish" once all
+//      samples have been pushed
+//  * "stop_tol" is the stopping criterion of "c_nnls". Samples are solved one at a time by "c_nnls" in the order of
+//      coordinates given by "solver" if it is not cyclic.
+template <typename Scalar, int K>
+class nnls_lanes {
+   public:
+    static const int L = 32 / sizeof(Scalar);
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+    typedef Eigen::Matrix<Scalar, K, L, Eigen::RowMajor> MatrixKL;
+    typedef Eigen::Array<Scalar, 1, L> Lanes;
+
+    nnls_lanes(MatrixK& a, Eigen::Matrix<Scalar, -1, -1>& h, const double stop_tol = cd_tol<Scalar>(), const int solver = NNLS_CD)
+        : a(a), h(h), b(a.rows(), L), x(a.rows(), L), r(a.rows()), stop_tol(stop_tol), solver(solver) {}
+
+    template <class VectorB>
+    void push(const VectorB& b_sample, const int sample) {
+        if (solver == NNLS_CD_GREEDY || solver == NNLS_CD_RANDOM) {
+            r = b_sample;
+            c_nnls(a, r, h, sample, CD_MAXIT, stop_tol, solver);
+            return;
+        }
+        b.col(n) = b_sample;
+        samples[n++] = sample;
+        if (n == L) solve();
+    }
+
+    void finish() {
+        for (int l = 0; l < n; ++l) {
+            r = b.col(l);
+            c_nnls(a, r, h, samples[l], CD_MAXIT, stop_tol);
+        }
+        n = 0;
+    }
+
+   private:
+    MatrixK& a;
+    Eigen::Matrix<Scalar, -1, -1>& h;
+    MatrixKL b, x;
+    VectorK r;
+    const double stop_tol;
+    const int solver;
+    int samples[L];
+    int n = 0;
+
+    void solve() {
+        for (int l = 0; l < L; ++l) x.col(l) = h.col(samples[l]);
+        Lanes active = Lanes::Ones();
+        Eigen::Array<double, 1, L> tol;
+        int n_active = L;
+        unsigned int it = 0;
+        uint64_t sweeps = 0;
+        for (; it < CD_MAXIT && 2 * n_active > L; ++it) {
+            sweeps += n_active;
+            tol.setZero();
+            for (int i = 0; i < x.rows(); ++i) {
+                const Lanes x_i = x.row(i).array();
+                const Lanes diff = b.row(i).array() / a(i, i);
+                // "diff" is truncated to "-x_i" where "x_i + diff" would be negative, so "x_i" becomes exactly 0
+                const Lanes delta = diff.max(-x_i) * active;
+                const Lanes x_new = x_i + delta;
+                x.row(i) = x_new.matrix();
+                b.noalias() -= a.col(i) * delta.matrix();
+                RCPPML_COUNT(COUNT_UPDATES, (delta != 0).count());
+                RCPPML_COUNT(COUNT_FLOPS, 2 * x.rows() * L);
+                tol = (-diff > x_i && x_i != 0).select(1, tol + (delta.template cast<double>() / (x_new.template cast<double>() + TINY_NUM)).abs());
+            }
+            active = (tol / x.rows() > stop_tol).select(active, 0);
+            n_active = (active != 0).count();
+        }
+        for (int l = 0; l < L; ++l) h.col(samples[l]) = x.col(l);
+        RcppML::countSolve(sweeps, (it == CD_MAXIT) ? n_active : 0);
+        // samples that are finished by "c_nnls" are counted there
+        for (int l = 0; l < L; ++l) {
+            if (it < CD_MAXIT && active(l) != 0) continue;
+            RCPPML_COUNT(COUNT_COLUMNS, 1);
+            RCPPML_COUNT(COUNT_SUPPORT, (x.col(l).array() > 0).count());
+        }
+        if (it < CD_MAXIT) {
+            for (int l = 0; l < L; ++l) {
+                if (active(l) == 0) continue;
+                r = b.col(l);
+                c_nnls(a, r, h, samples[l], CD_MAXIT - it, stop_tol);
             }
+        }
+        n = 0;
+    }
+};
 
-            if (h(i, sample) < 0) {
-                h(i, sample) = 0;
-                tol = 1;
-            } else if (h(i, sample) > upper_bound) {
-                h(i, sample) = upper_bound;
-                tol = 1;
+// Non-Negative Least Squares solver by the active set method of Lawson and Hanson
+// solve ax = b given "a", "b", and h.col(sample) giving "x", subject to non-negativity, with the same arguments as "c_nnls"
+//  * variables are exchanged between a "passive" set, in which the system is solved exactly, and an "active" set fixed
+//      at zero. The Cholesky factor of "a" on the passive set is updated by one column when a variable is added and by
+//      Givens rotations when a variable is removed, so "a" is never refactorized.
+//  * positive values in h.col(sample) are the initial passive set, so a solve that begins from the truncated least
+//      squares solution (see "c_nnls_init") often needs few exchanges
+//  * each exchange costs O(k^2), and there are at most 3k, whereas coordinate descent needs more iterations to converge
+//      as k grows and often stops at CD_MAXIT for k >= 100
+//  * buffers are allocated once, so one solver should be constructed per thread
+template <typename Scalar, int K>
+class active_set {
+   public:
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+    typedef Eigen::Matrix<int, K, 1> IndexK;
+
+    active_set(const unsigned int k) : U(k, k), b0(k), c(k), x(k), z(k), idx(k), pos(k) {}
+
+    void solve(const MatrixK& a, VectorK& b, Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample, const double upper_bound = 0) {
+        const int k = b.size();
+        const bool bounded = upper_bound > 0;
+        const Scalar ub = bounded ? (Scalar)upper_bound : std::numeric_limits<Scalar>::infinity();
+        x = h.col(sample);
+        b0.noalias() = a * x;
+        b0 += b;
+        p = 0;
+        pos.setConstant(-1);
+        for (int i = 0; i < k; ++i)
+            if (x(i) > 0 && x(i) < ub && !add(a, i)) x(i) = 0;
+        const Scalar tol = cd_tol<Scalar>() * std::max(b0.cwiseAbs().maxCoeff(), (Scalar)TINY_NUM);
+        int entering = -1;
+        bool stalled = false;
+        for (int it = 0; it < 3 * k; ++it) {
+            // move "x" toward the unconstrained solution on the passive set, removing variables that reach a bound first
+            while (p > 0) {
+                // variables held at the upper bound are moved to the right-hand side
+                if (bounded) {
+                    c = b0;
+                    for (int i = 0; i < k; ++i)
+                        if (pos(i) < 0 && x(i) > 0) c -= a.col(i) * x(i);
+                }
+                const VectorK& rhs = bounded ? c : b0;
+                for (int q = 0; q < p; ++q) z(q) = rhs(idx(q));
+                solveInPlace();
+                Scalar alpha = 1;
+                int q_min = -1;
+                for (int q = 0; q < p; ++q) {
+                    const Scalar x_q = x(idx(q));
+                    const Scalar step = (z(q) <= 0) ? x_q / (x_q - z(q)) : (z(q) >= ub) ? (ub - x_q) / (z(q) - x_q) : 1;
+                    if (step < alpha) {
+                        alpha = step;
+                        q_min = q;
+                    }
+                }
+                for (int q = 0; q < p; ++q) x(idx(q)) += alpha * (z(q) - x(idx(q)));
+                if (q_min >= 0) x(idx(q_min)) = (z(q_min) <= 0) ? 0 : ub;
+                // rounding past either bound is clamped over all variables at once, without a branch per variable
+                x = x.cwiseMax((Scalar)0).cwiseMin(ub);
+                bool removed = false;
+                for (int q = p - 1; q >= 0; --q) {
+                    if (x(idx(q)) <= 0 || x(idx(q)) >= ub) {
+                        // a variable that leaves as soon as it enters cannot reduce the loss in working precision
+                        if (idx(q) == entering && alpha == 0) stalled = true;
+                        remove(q);
+                        removed = true;
+                    }
+                }
+                entering = -1;
+                if (!removed) break;
             }
+
+            // the residual is the negative gradient, so the variable with the largest residual most reduces the loss. A
+            //   variable held at the upper bound reduces the loss by decreasing, where its residual is negative.
+            b.noalias() = -(a * x);
+            b += b0;
+            RCPPML_COUNT(COUNT_FLOPS, 2 * k * k);
+            if (stalled) break;
+            Scalar b_max = tol;
+            for (int i = 0; i < k; ++i) {
+                const Scalar g = (x(i) > 0) ? -b(i) : b(i);
+                if (pos(i) < 0 && g > b_max) {
+                    b_max = g;
+                    entering = i;
+                }
+            }
+            if (entering < 0 || !add(a, entering)) break;
         }
+        h.col(sample) = x;
+        RCPPML_COUNT(COUNT_COLUMNS, 1);
+        RCPPML_COUNT(COUNT_SUPPORT, p);
     }
-}
+
+   private:
+    MatrixK U;          // upper Cholesky factor "a = U^TU" on the passive set, in the leading "p" rows and columns
+    VectorK b0, c, x, z;  // right-hand side, right-hand side less variables at the upper bound, solution, and passive set solution
+    IndexK idx, pos;    // variables in the passive set, and their positions in it (-1 if active)
+    int p = 0;          // size of the passive set
+
+    // add variable "i" to the passive set, appending a column to "U". Returns false if "i" is numerically dependent
+    // on the passive set.
+    bool add(const MatrixK& a, const int i) {
+        for (int q = 0; q < p; ++q)
+            U(q, p) = (a(idx(q), i) - U.col(q).head(q).dot(U.col(p).head(q))) / U(q, q);
+        const Scalar d = a(i, i) - U.col(p).head(p).squaredNorm();
+        if (d <= a(i, i) * std::numeric_limits<Scalar>::epsilon()) return false;
+        U(p, p) = std::sqrt(d);
+        idx(p) = i;
+        pos(i) = p++;
+        RCPPML_COUNT(COUNT_UPDATES, 1);
+        RCPPML_COUNT(COUNT_FLOPS, p * p);
+        return true;
+    }
+
+    // remove the variable at position "q" in the passive set. Removing column "q" of "U" leaves a subdiagonal in the
+    // following columns, which is rotated away.
+    void remove(const int q) {
+        pos(idx(q)) = -1;
+        for (int c = q; c < p - 1; ++c) {
+            U.col(c).head(c + 2) = U.col(c + 1).head(c + 2);
+            idx(c) = idx(c + 1);
+            pos(idx(c)) = c;
+        }
+        for (int c = q; c < p - 1; ++c) {
+            const Scalar r = std::sqrt(U(c, c) * U(c, c) + U(c + 1, c) * U(c + 1, c));
+            const Scalar cs = U(c, c) / r, sn = U(c + 1, c) / r;
+            for (int j = c; j < p - 1; ++j) {
+                const Scalar u = U(c, j), v = U(c + 1, j);
+                U(c, j) = cs * u + sn * v;
+                U(c + 1, j) = cs * v - sn * u;
+            }
+            U(c + 1, c) = 0;
+        }
+        RCPPML_COUNT(COUNT_UPDATES, 1);
+        RCPPML_COUNT(COUNT_FLOPS, 6 * (p - q) * (p - q));
+        --p;
+    }
+
+    // solve "U^TUz = z" on the passive set in place
+    void solveInPlace() {
+        for (int i = 0; i < p; ++i)
+            z(i) = (z(i) - U.col(i).head(i).dot(z.head(i))) / U(i, i);
+        for (int i = p - 1; i >= 0; --i)
+            z(i) = (z(i) - U.row(i).segment(i + 1, p - i - 1).dot(z.segment(i + 1, p - i - 1))) / U(i, i);
+        RCPPML_COUNT(COUNT_FLOPS, 2 * p * p);
+    }
+};
 
 // Upper-bounded Non-Negative Least Squares solver
 // solve ax = b given "a", "b", and h.col(sample) giving "x", subject to non-negativity. Coordinate descent.
-inline void c_bnnls(Eigen::MatrixXd& a, Eigen::VectorXd& b, Eigen::MatrixXd& h, const unsigned int sample, const double upper_bound = 1) {
+//  * "maxit" and "stop_tol" are as in "c_nnls"
+//  * returns true if the solve converged, which it may do in the last of "maxit" sweeps
+template <typename Scalar, int K>
+inline bool c_bnnls(Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample, const double upper_bound = 1,
+                    const unsigned int maxit = CD_MAXIT, const double stop_tol = cd_tol<Scalar>()) {
     double tol = 1;
-    for (unsigned int it = 0; it < CD_MAXIT && (tol / b.size()) > CD_TOL; ++it) {
+    unsigned int it = 0;
+    for (; it < maxit && (tol / b.size()) > stop_tol; ++it) {
         tol = 0;
         for (unsigned int i = 0; i < h.rows(); ++i) {
-            double diff = b(i) / a(i, i);
+            Scalar diff = b(i) / a(i, i);
             if (-diff > h(i, sample)) {
                 if (h(i, sample) != 0) {
                     b -= a.col(i) * -h(i, sample);
                     tol = 1;
                     h(i, sample) = 0;
+                    RCPPML_COUNT(COUNT_UPDATES, 1);
+                    RCPPML_COUNT(COUNT_FLOPS, 2 * b.size());
                 }
             } else if (diff != 0) {
                 if (h(i, sample) + diff > upper_bound) {
+                    diff = upper_bound - h(i, sample);
                     h(i, sample) = upper_bound;
                 } else {
                     h(i, sample) += diff;
                 }
                 b -= a.col(i) * diff;
                 tol += std::abs(diff / (h(i, sample) + TINY_NUM));
+                RCPPML_COUNT(COUNT_UPDATES, 1);
+                RCPPML_COUNT(COUNT_FLOPS, 2 * b.size());
             }
         }
     }
+    const bool converged = (tol / b.size()) <= stop_tol;
+    RcppML::countSolve(it, !converged);
+    RCPPML_COUNT(COUNT_COLUMNS, 1);
+    RCPPML_COUNT(COUNT_SUPPORT, (h.col(sample).array() > 0).count());
+    return converged;
 }
 
-// 2-variable Non-Negative Least Squares solver
-// solves ax_i = b for a two-variable system of equations, where the "i"th column in "x" contains the solution.
-// "denom" is a pre-conditioned denominator for solving by direct substition.
-inline void nnls2(const Eigen::Matrix2d& a, const Eigen::Vector2d& b, const double denom, Eigen::MatrixXd& x, const unsigned int i, const bool nonneg) {
-    // solve least squares
+// solve ax = b subject to "0 <= x <= upper_bound" given the residual "b" of the solution in h.col(sample), usually the
+//   clipped unconstrained solution (see "c_nnls_init"), as in "predict"
+//  * a few sweeps of coordinate descent converge at once where the clipped solution is nearly optimal, such as when most
+//      values are held at a bound. Otherwise coordinate descent oscillates against the bounds for many sweeps, and the
+//      system is solved from where it stopped by the active set method, with variables held at either bound.
+template <typename Scalar, int K>
+inline void bnnls(Eigen::Matrix<Scalar, K, K>& a, Eigen::Matrix<Scalar, K, 1>& b, Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int sample,
+                  const double upper_bound, active_set<Scalar, K>& as_solver, const double stop_tol = cd_tol<Scalar>()) {
+    if (!c_bnnls(a, b, h, sample, upper_bound, BNNLS_CD_MAXIT, stop_tol)) as_solver.solve(a, b, h, sample, upper_bound);
+}
+
+// solutions of 2-variable least squares systems "ax = b" for right-hand sides in "b0" and "b1", written to "x0" and "x1"
+//  * with "nonneg", the unconstrained solution is replaced by the solution with "x0 = 0" if its "x0" would be
+//      negative, or otherwise with "x1 = 0" if its "x1" would be negative
+//  * all candidate solutions are computed and one is selected, without branching, so that this vectorizes across
+//      right-hand sides given as arrays
+template <typename Scalar, class ArrayB>
+inline void nnls2Select(const Eigen::Matrix<Scalar, 2, 2>& a, const ArrayB& b0, const ArrayB& b1, ArrayB& x0, ArrayB& x1,
+                        const bool nonneg) {
+    const Scalar denom = a(0, 0) * a(1, 1) - a(0, 1) * a(0, 1);
+    const ArrayB a11b0 = a(1, 1) * b0, a01b1 = a(0, 1) * b1;
+    const ArrayB a00b1 = a(0, 0) * b1, a01b0 = a(0, 1) * b0;
+    x0 = (a11b0 - a01b1) / denom;
+    x1 = (a00b1 - a01b0) / denom;
     if (nonneg) {
-        const double a01b1 = a(0, 1) * b(1);
-        const double a11b0 = a(1, 1) * b(0);
-        if (a11b0 < a01b1) {
-            x(0, i) = 0;
-            x(1, i) = b(1) / a(1, 1);
-        } else {
-            const double a01b0 = a(0, 1) * b(0);
-            const double a00b1 = a(0, 0) * b(1);
-            if (a00b1 < a01b0) {
-                x(0, i) = b(0) / a(0, 0);
-                x(1, i) = 0;
-            } else {
-                x(0, i) = (a11b0 - a01b1) / denom;
-                x(1, i) = (a00b1 - a01b0) / denom;
-            }
-        }
-    } else {
-        x(0, i) = (a(1, 1) * b(0) - a(0, 1) * b(1)) / denom;
-        x(1, i) = (a(0, 0) * b(1) - a(0, 1) * b(0)) / denom;
+        x0 = (a11b0 < a01b1).select((Scalar)0, (a00b1 < a01b0).select((b0 / a(0, 0)).max((Scalar)0), x0));
+        x1 = (a11b0 < a01b1).select((b1 / a(1, 1)).max((Scalar)0), (a00b1 < a01b0).select((Scalar)0, x1));
     }
 }
 
-// solves ax = b for a two-variable system of equations, where "b" is given in the "i"th column of "w", and replaced with the solution "x".
-// "denom" is a pre-conditioned denominator for solving by direct substitution.
-inline void nnls2InPlace(const Eigen::Matrix2d& a, const double denom, Eigen::MatrixXd& w, const bool nonneg) {
-    for (unsigned int i = 0; i < w.cols(); ++i) {
-        if (nonneg) {
-            const double a01b1 = a(0, 1) * w(1, i);
-            const double a11b0 = a(1, 1) * w(0, i);
-            if (a11b0 < a01b1) {
-                w(0, i) = 0;
-                w(1, i) /= a(1, 1);
-            } else {
-                const double a01b0 = a(0, 1) * w(0, i);
-                const double a00b1 = a(0, 0) * w(1, i);
-                if (a00b1 < a01b0) {
-                    w(0, i) /= a(0, 0);
-                    w(1, i) = 0;
-                } else {
-                    w(0, i) = (a11b0 - a01b1) / denom;
-                    w(1, i) = (a00b1 - a01b0) / denom;
-                }
-            }
-        } else {
-            double b0 = w(0, i);
-            w(0, i) = (a(1, 1) * b0 - a(0, 1) * w(1, i)) / denom;
-            w(1, i) = (a(0, 0) * w(1, i) - a(0, 1) * b0) / denom;
-        }
+// 2-variable (Non-Negative) Least Squares solver for many right-hand sides of the same system
+// solves "ax = b" for each column "b" of the 2-row matrix "x", which is replaced by the solutions
+//  * columns are solved in packets of one 256-bit register of "Scalar" per row (see "nnls2Select")
+//  * "x" may be a block expression, and is written through "const_cast" as usual for Eigen expressions
+template <class MatrixX>
+inline void nnls2Batch(const Eigen::Matrix<typename MatrixX::Scalar, 2, 2>& a, const Eigen::MatrixBase<MatrixX>& x_, const bool nonneg) {
+    typedef typename MatrixX::Scalar Scalar;
+    static const int P = 32 / sizeof(Scalar);
+    typedef Eigen::Array<Scalar, 1, P> Packet;
+    typedef Eigen::Array<Scalar, 1, 1> Single;
+    Eigen::MatrixBase<MatrixX>& x = const_cast<Eigen::MatrixBase<MatrixX>&>(x_);
+    const Eigen::Index n = x.cols(), n_packed = n - n % P;
+    Packet b0, b1, x0, x1;
+    for (Eigen::Index j = 0; j < n_packed; j += P) {
+        b0 = x.row(0).segment(j, P).array();
+        b1 = x.row(1).segment(j, P).array();
+        nnls2Select(a, b0, b1, x0, x1, nonneg);
+        x.row(0).segment(j, P) = x0.matrix();
+        x.row(1).segment(j, P) = x1.matrix();
+    }
+    Single s0, s1, y0, y1;
+    for (Eigen::Index j = n_packed; j < n; ++j) {
+        s0(0) = x(0, j);
+        s1(0) = x(1, j);
+        nnls2Select(a, s0, s1, y0, y1, nonneg);
+        x(0, j) = y0(0);
+        x(1, j) = y1(0);
     }
+    // 4 products, 2 differences, and 2 quotients for the unconstrained solution, and 2 quotients for the constrained
+    RCPPML_COUNT(COUNT_COLUMNS, n);
+    RCPPML_COUNT(COUNT_FLOPS, (nonneg ? 10 : 8) * n);
+    RCPPML_COUNT(COUNT_SUPPORT, (x.array() > 0).count());
 }
 
 #endif
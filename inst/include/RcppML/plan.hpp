@@ -0,0 +1,176 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_plan
+#define RcppML_plan
+
+#ifndef RcppML_nnls
+#include <RcppML/nnls.hpp>
+#endif
+
+#ifndef RcppML_threads
+#include <RcppML/threads.hpp>
+#endif
+
+#include <fstream>
+#include <limits>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// PLANS OF NMF FITS
+//
+// The kernels and parameters of a fit are chosen once, before it starts, from the dimensions and non-zeros of "A", the
+//   rank, masking, and the machine, and are returned with the model so that the fit can be reproduced, or run again
+//   with some choices overridden:
+//  * the backend: "A" is fit as a dense matrix if it has fewer than a fraction "dense_zeros" of zeros, or as a sparse
+//      matrix if it has more than "sparse_zeros", as long as the copy into the other format fits in half of the
+//      available memory, or the fit fits within the memory limit
+//  * the solver: "auto" is resolved by rank (see "useActiveSet")
+//  * the threads of updates of "h" and "w" with "threads = 0", from the work of each (see "updateThreads")
+//  * with a memory limit ("RcppML.memory_limit" in R), the memory of the fit is estimated from its large allocations
+//      (see "fitBytes"), and the plan is fit to the limit: columns in each tile of dense losses are reduced (see
+//      "lossTile"), sparse "A" is fit by column blocks without its transpose (see "nmf_stream") if the sparse backend
+//      with its transpose does not fit, or otherwise "w" is updated from sparse "A" in place (see "nmf::predictRows"),
+//      and a fit that cannot fit in any way fails before it starts (see "fitsLimit")
+// Tile sizes of updates are compile-time constants (see "PREDICT_TILE_SIZE") and are not planned.
+namespace RcppML {
+
+// the input of a fit, as seen by the planner
+struct fitShape {
+    double rows = 0, cols = 0, nnz = 0;  // dimensions and non-zeros of "A"
+    unsigned int k = 0;
+    bool sparse = true;        // "A" is given as a sparse matrix
+    bool keep_sparse = false;  // "A" can only be fit by the sparse backend (e.g. "mask_zeros" or prepared matrices)
+    bool transposed = false;   // "t(A)" is given (e.g. prepared matrices), so the sparse backend does not allocate it
+    bool streamable = false;   // sparse "A" can be fit by column blocks without its transpose (one unmasked "als" model)
+    bool in_place = false;     // "w" can be updated from sparse "A" in place (unmasked "als" without linking of "w")
+};
+
+struct fitPlan {
+    bool dense = false;          // fit by the dense backend
+    int solver = NNLS_AUTO;      // solver of least squares updates (see "nnls_solver")
+    unsigned int threads_h = 0;  // threads of updates of "h"
+    unsigned int threads_w = 0;  // threads of updates of "w"
+    bool stream = false;         // fit sparse "A" by column blocks without its transpose (see "nmf_stream")
+    bool transpose = true;       // the sparse backend updates "w" from "t(A)", rather than from "A" in place
+    unsigned int loss_tile = PREDICT_TILE_SIZE;  // columns in each tile of losses of the dense backend
+    double bytes = 0;            // memory of "A" in the planned backend, with "t(A)" if sparse, and of the factors
+    double available = 0;        // available memory in bytes when the plan was made, or 0 if not known
+    double limit = 0;            // memory limit in bytes, or 0 if there is none
+};
+
+// bytes of physical memory available to new allocations, or 0 where this is not known
+//  * on Linux, "MemAvailable" of "/proc/meminfo", which unlike free pages ("_SC_AVPHYS_PAGES", or "MemFree") counts
+//      page cache and other memory that the kernel reclaims on demand. Free pages are used on older kernels without it.
+inline double availableMemory() {
+#ifdef __linux__
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    double kb;
+    while (meminfo >> key >> kb) {
+        if (key == "MemAvailable:") return kb * 1024;
+        meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+#ifdef _SC_AVPHYS_PAGES
+    const long pages = sysconf(_SC_AVPHYS_PAGES), page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0) return (double)pages * page_size;
+#endif
+#endif
+    return 0;
+}
+
+// bytes of "A" in the dense or sparse backend, with the transpose held by the sparse backend for updates of "w"
+inline double backendBytes(const fitShape& s, const bool dense) {
+    if (dense) return s.rows * s.cols * sizeof(double);
+    return 2 * (s.nnz * (sizeof(double) + sizeof(int))) + (s.rows + s.cols + 2) * sizeof(int);
+}
+
+// threads of a fit with "threads" (0 for all), which each hold their own buffers
+inline double planThreads(const unsigned int threads) {
+#ifdef _OPENMP
+    return (threads == 0) ? omp_get_max_threads() : threads;
+#else
+    return 1;
+#endif
+}
+
+// columns in each tile of losses of the dense backend, each a dense "rows x tile" block of the reconstruction on every
+//   thread, as many as "PREDICT_TILE_SIZE" but with all blocks within 1/8 of "limit" (if not 0)
+inline unsigned int lossTile(const fitShape& s, const unsigned int threads, const double limit) {
+    if (limit == 0 || s.rows == 0) return PREDICT_TILE_SIZE;
+    const double tile = limit / 8 / (planThreads(threads) * s.rows * sizeof(double));
+    return (unsigned int)std::max(1.0, std::min((double)PREDICT_TILE_SIZE, std::floor(tile)));
+}
+
+// estimated bytes of a fit under "plan": "A" in the backend of the plan (as given, or its copy in the other format),
+//   with "t(A)" held by the sparse backend unless it is given, the factors with the copy of "w" of the previous
+//   iteration, and the buffers of each thread
+//  * the dense backend holds a tile of the reconstruction on each thread while computing losses (see "lossTile")
+//  * fits by column blocks hold no transpose, but "hA^T" on each thread (see "nmf_stream::sweep")
+//  * updates of "w" from "A" in place hold no transpose, but one "hA^T" (see "nmf::predictRows")
+inline double fitBytes(const fitShape& s, const fitPlan& plan, const unsigned int threads) {
+    const double n_threads = planThreads(threads);
+    const double factors = (2 * s.rows + s.cols) * s.k * sizeof(double);
+    if (plan.dense) return backendBytes(s, true) + factors + n_threads * s.rows * plan.loss_tile * sizeof(double);
+    const double sparse = s.nnz * (sizeof(double) + sizeof(int)) + (s.cols + 1) * sizeof(int);
+    if (plan.stream) return sparse + factors + s.cols * s.k * sizeof(double) + (n_threads + 1) * s.rows * s.k * sizeof(double);
+    if (!plan.transpose) return sparse + factors + s.rows * s.k * sizeof(double);
+    return (s.transposed ? sparse : backendBytes(s, false)) + factors;
+}
+
+// true if "plan" is within its memory limit, if it has one
+inline bool fitsLimit(const fitPlan& plan) { return plan.limit == 0 || plan.bytes <= plan.limit; }
+
+// plan a fit of "s" with "threads" (0 to choose), "solver" (possibly NNLS_AUTO), fractions of zeros at which "A"
+//   is copied to the other backend, and a memory "limit" in bytes (0 for none)
+//  * without a limit, "A" is copied to the other backend only if the copy fits in half of the available memory. With a
+//      limit, it is copied only if the whole fit is within the limit.
+inline fitPlan planFit(const fitShape& s, const unsigned int threads, const int solver, const double dense_zeros,
+                       const double sparse_zeros, const double limit = 0, const double available = availableMemory()) {
+    fitPlan plan;
+    plan.available = available;
+    plan.limit = limit;
+    plan.loss_tile = lossTile(s, threads, limit);
+    const double n_values = s.rows * s.cols;
+    const double zeros = (n_values > 0) ? 1 - s.nnz / n_values : 0;
+    const auto fits = [&](const bool dense) {
+        if (limit == 0) return available == 0 || backendBytes(s, dense) <= available / 2;
+        fitPlan p = plan;
+        p.dense = dense;
+        if (fitBytes(s, p, threads) <= limit) return true;
+        p.stream = !dense && s.streamable;
+        if (p.stream && fitBytes(s, p, threads) <= limit) return true;
+        p.stream = false;
+        p.transpose = dense || !s.in_place || s.transposed;
+        return !p.transpose && fitBytes(s, p, threads) <= limit;
+    };
+    if (s.keep_sparse)
+        plan.dense = false;
+    else if (s.sparse)
+        plan.dense = n_values > 0 && zeros < dense_zeros && fits(true);
+    else
+        plan.dense = !(sparse_zeros < 1 && n_values > 0 && zeros > sparse_zeros && fits(false));
+    const bool over = !plan.dense && limit > 0 && fitBytes(s, plan, threads) > limit;
+    plan.stream = over && s.streamable;
+    if (over && s.in_place && !s.transposed && (!plan.stream || fitBytes(s, plan, threads) > limit)) {
+        plan.stream = false;
+        plan.transpose = false;
+    }
+    plan.solver = (solver == NNLS_AUTO) ? (useActiveSet(solver, s.k) ? NNLS_ACTIVE_SET : NNLS_CD) : solver;
+    const double values = plan.dense ? n_values : s.nnz;
+    plan.threads_h = updateThreads(threads, values, s.k, s.cols, s.rows);
+    plan.threads_w = updateThreads(threads, values, s.k, s.rows, s.cols);
+    plan.bytes = fitBytes(s, plan, threads);
+    return plan;
+}
+
+}  // namespace RcppML
+
+#endif
@@ -5,19 +5,6 @@
 // This source code is subject to the terms of the GNU
 // Public License v. 2.0.
 
-/* 5/10/2022
- * This approach to calculating w * w.transpose() significantly reduces compute time
- *
- * template <typename T>
- * Eigen::Matrix<T, -1, -1> AAt(Eigen::Matrix<T, -1, -1> A){
- *   Eigen::Matrix<T, -1, -1> a = Eigen::Matrix<T, -1, -1>::Zero(A.rows(), A.rows());
- *   a.selfadjointView<Eigen::Lower>().rankUpdate(A);
- *   a.triangularView<Eigen::Upper>() = a.transpose();
- *   return a;
- * }
- *
- */
-
 #ifndef RcppML_predict
 #define RcppML_predict
 
@@ -25,266 +12,1341 @@
 #include <RcppML/nnls.hpp>
 #endif
 
+#ifndef RcppML_threads
+#include <RcppML/threads.hpp>
+#endif
+
+#ifndef RcppML_tasks
+#include <RcppML/tasks.hpp>
+#endif
+
+#include <map>
+#include <vector>
+
+// contribution of one column to the squared error "||A.col(i) - wx||^2 - ||A.col(i)||^2 = x^T(ww^T)x - 2x^T(wA.col(i))",
+// given the system "ax = b" in which "a = ww^T + L2" and "b = wA.col(i) - L1" were solved for "x"
+template <typename Scalar, int K, class VectorB, class VectorX>
+inline double gram_loss(const Eigen::Matrix<Scalar, K, K>& a, const VectorB& b, const VectorX& x, const double L1, const double L2) {
+    const Eigen::Matrix<double, K, 1> x0 = x.template cast<double>();
+    const double xax = x0.dot(a.template cast<double>() * x0) - L2 * x0.squaredNorm();
+    const double xb = x0.dot(b.template cast<double>()) + L1 * x0.sum();
+    return xax - 2 * xb;
+}
+
+// right-hand sides "B.col(j) += wA.col(start + j)" for the first "n" columns of "B", given sparse "A"
+//  * each non-zero reads a column of "w" at a row of "A" that cannot be predicted, so its cache lines are prefetched
+//      "GATHER_PREFETCH_DISTANCE" non-zeros ahead by a second iterator over the same column of "A"
+//  * columns are gathered one at a time. Gathering several columns at once, one non-zero of each in turn, was slower
+//      than this because updates to several columns of "B" do not stay in registers.
+//  * columns with "skip[j]" are not gathered
+template <class SparseA, class MatrixW, class MatrixB>
+inline void gatherTile(SparseA& A, const MatrixW& w, MatrixB& B, const int start, const int n, const bool* skip = NULL) {
+    typedef typename SparseA::InnerIterator InnerIteratorA;
+    typedef typename MatrixB::Scalar Scalar;
+    const int line = std::max(64 / (int)sizeof(Scalar), 1), rows = w.rows();
+    for (int j = 0; j < n; ++j) {
+        if (skip && skip[j]) continue;
+        InnerIteratorA it(A, start + j), ahead(A, start + j);
+        for (int d = 0; d < GATHER_PREFETCH_DISTANCE && ahead; ++d) ++ahead;
+        for (; it; ++it) {
+            if (GATHER_PREFETCH_DISTANCE > 0 && ahead) {
+                const Scalar* w_col = &w.coeffRef(0, ahead.row());
+                for (int r = 0; r < rows; r += line) Eigen::internal::prefetch(w_col + r);
+                ++ahead;
+            }
+            B.col(j) += (Scalar)it.value() * w.col(it.row());
+        }
+    }
+}
+
+// buffers reused by one thread across all columns in the masked and linked paths of "predict", so that nothing is
+// allocated for each column once "w_" has grown to the largest number of rows gathered for any column
+template <typename Scalar>
+class workspace {
+   public:
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+
+    MatrixS a;                     // system of equations for one column
+    Eigen::Matrix<Scalar, -1, 1> b;  // right-hand side for one column
+
+    // reduced system, right-hand side, and solution over the factors linked to one column (see "linkedSolve"), which
+    //   are only reallocated when the number of linked factors changes between columns
+    MatrixS a_l, x_l;
+    Eigen::Matrix<Scalar, -1, 1> b_l;
+    active_set<Scalar, -1> as_l;
+
+    workspace(const unsigned int k) : a(k, k), b(k), as_l(k), w_(k, 0) {}
+
+    // the first "n" columns of a buffer for columns of "w" gathered at rows in one column of "A"
+    typename MatrixS::ColsBlockXpr cols(const unsigned int n) {
+        if (n > w_.cols()) w_.resize(w_.rows(), std::max((Eigen::Index)n, 2 * w_.cols()));
+        return w_.leftCols(n);
+    }
+
+   private:
+    MatrixS w_;
+};
+
+// columns of "h" whose solutions have stopped changing, which are skipped in unmasked updates of "predict"
+//  * a column is frozen for FREEZE_ITERS updates once the relative change in its solution in one update is less
+//      than "tol", and is then solved again to check that it has not started changing
+//  * "scale" is the vector by which rows of "h" were divided after the last update (see "nmf::scaleH"), if any, so that
+//      frozen columns are restored to the scale of new solutions
+template <typename Scalar>
+class freezer {
+   public:
+    double tol = 0;
+    Eigen::Matrix<Scalar, -1, 1> scale;
+
+    freezer() {}
+    freezer(const double tol, const unsigned int n) : tol(tol), count(n, 0) {}
+
+    // true if column "i" is frozen in this update. Only the thread that updates column "i" may call this.
+    bool skip(const int i) {
+        if (count[i] == 0) return false;
+        --count[i];
+        return true;
+    }
+
+    // column "x" of "h" as it was solved in the last update
+    template <class VectorX>
+    void restore(VectorX x) const {
+        if (scale.size() > 0) x.array() *= scale.array();
+    }
+
+    // freeze column "i" if its solution "x" changed by less than "tol" relative to its last solution "x_last"
+    template <class VectorX, class VectorY>
+    void update(const int i, const VectorX& x, const VectorY& x_last) {
+        const double change = (x - x_last).template lpNorm<1>() / (x_last.template lpNorm<1>() + TINY_NUM);
+        if (change < tol) count[i] = FREEZE_ITERS;
+    }
+
+    // number of columns that will be skipped in the next update
+    unsigned int n_frozen() const {
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < count.size(); ++i) n += (count[i] > 0);
+        return n;
+    }
+
+   private:
+    std::vector<unsigned char> count;  // number of updates for which each column remains frozen
+};
+
+// columns of a linking matrix "l" as plain vectors of the factors linked to each column of "h" and their link values
+//  * built once on the calling thread, so that linked updates read no R vectors and copies of a linked model can be
+//      fit concurrently
+//  * a column linked to all "k" factors is solved from the full system with "b" weighted by "weigh", and any other
+//      column from the reduced system of only its linked factors (see "linkedSolve")
+//  * columns linked to the same factors form a block, such as the features of one assay of multi-omics data that are
+//      tied to the factors of that assay, which shares one reduced system in unmasked updates (see "linkBlocks")
+class linkIndex {
+   public:
+    linkIndex() : p(1, 0) {}
+
+    linkIndex(RcppML::SparseOf<double>& l) : p(1, 0) {
+        const int n_cols = l.cols();
+        i.reserve(l.p[n_cols]);
+        x.reserve(l.p[n_cols]);
+        block_of.reserve(n_cols);
+        std::map<std::vector<int>, int> blocks;
+        for (int col = 0; col < n_cols; ++col) {
+            for (RcppML::SparseOf<double>::InnerIterator it(l, col); it; ++it) {
+                i.push_back(it.row());
+                x.push_back(it.value());
+            }
+            p.push_back(i.size());
+            const std::vector<int> linked(i.begin() + p[col], i.end());
+            const auto found = blocks.insert(std::make_pair(linked, (int)blocks.size()));
+            if (found.second) block_factors.push_back(linked);
+            block_of.push_back(found.first->second);
+        }
+    }
+
+    unsigned int size(const int col) const { return p[col + 1] - p[col]; }
+    const int* factors(const int col) const { return i.data() + p[col]; }
+    const double* values(const int col) const { return x.data() + p[col]; }
+
+    // blocks of columns linked to the same factors, in the order of their first column
+    unsigned int blocks() const { return block_factors.size(); }
+    int block(const int col) const { return block_of[col]; }
+    const std::vector<int>& blockFactors(const int b) const { return block_factors[b]; }
+
+    // true if column "col" is linked to fewer than all "k" factors, and must be solved from a reduced system
+    bool reduces(const int col, const unsigned int k) const { return size(col) < k; }
+
+    // multiply "b" by the link values of column "col", which is linked to all factors
+    template <class VectorB>
+    void weigh(const int col, VectorB& b) const {
+        for (unsigned int q = 0; q < size(col); ++q) b(q) *= x[p[col] + q];
+    }
+
+   private:
+    std::vector<int> p, i, block_of;
+    std::vector<double> x;
+    std::vector<std::vector<int> > block_factors;
+};
+
+// non-zeros of sparse "A" merged with a masking matrix of the same dimensions into one stream per column, so that
+//   masked kernels read a single stream rather than merging "A" with the mask in every column of every update
+//  * entry "k" of column "col" (from "p[col]" to "p[col + 1]") is at row "i[k]", with value "x[k]" in "A" (0 if not a
+//      non-zero of "A") and weight "m[k]" in the mask (0 if not masked), and "flags[k]" tells which of the two it is in
+//  * built once per fit for "A" and once for "t(A)" (see "nmf::indexMask"), in parallel over columns
+class maskIndex {
+   public:
+    enum { IN_A = 1, IN_MASK = 2 };
+    std::vector<int> p, i;
+    std::vector<double> x, m;
+    std::vector<unsigned char> flags;
+
+    maskIndex() {}
+
+    size_t bytes() const { return (p.size() + i.size()) * sizeof(int) + (x.size() + m.size()) * sizeof(double) + flags.size(); }
+
+    template <typename Value>
+    maskIndex(RcppML::SparseOf<Value>& A, RcppML::SparseOf<double>& mask_A, const unsigned int threads) : p(A.cols() + 1, 0) {
+        const int n_cols = A.cols();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+        for (int col = 0; col < n_cols; ++col) p[col + 1] = merge(A, mask_A, col, NULL);
+        for (int col = 0; col < n_cols; ++col) p[col + 1] += p[col];
+        i.resize(p[n_cols]);
+        x.resize(p[n_cols]);
+        m.resize(p[n_cols]);
+        flags.resize(p[n_cols]);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+        for (int col = 0; col < n_cols; ++col) merge(A, mask_A, col, this);
+    }
+
+    bool empty() const { return p.empty(); }
+
+   private:
+    // merge column "col" of "A" and "mask_A", writing entries to "index" at "p[col]" if given, and return their number
+    template <typename Value>
+    static int merge(RcppML::SparseOf<Value>& A, RcppML::SparseOf<double>& mask_A, const int col, maskIndex* index) {
+        typename RcppML::SparseOf<Value>::InnerIterator it_A(A, col);
+        RcppML::SparseOf<double>::InnerIterator it_mask(mask_A, col);
+        int k = index ? index->p[col] : 0, n = 0;
+        while (it_A || it_mask) {
+            const int row = (!it_mask || (it_A && it_A.row() < it_mask.row())) ? it_A.row() : it_mask.row();
+            const bool in_A = it_A && it_A.row() == row, in_mask = it_mask && it_mask.row() == row;
+            if (index) {
+                index->i[k] = row;
+                index->x[k] = in_A ? (double)it_A.value() : 0;
+                index->m[k] = in_mask ? it_mask.value() : 0;
+                index->flags[k++] = (in_A ? IN_A : 0) | (in_mask ? IN_MASK : 0);
+            }
+            if (in_A) ++it_A;
+            if (in_mask) ++it_mask;
+            ++n;
+        }
+        return n;
+    }
+};
+
+// as "gramDowndate", for the masked rows of column "col" read from "index"
+template <class MatrixA, class MatrixW, class MatrixBuf>
+inline void gramDowndate(MatrixA& a, const MatrixW& w, const maskIndex& index, const int col, MatrixBuf w_) {
+    typedef typename MatrixA::Scalar Scalar;
+    int j = 0;
+    for (int k = index.p[col]; k < index.p[col + 1]; ++k)
+        if (index.flags[k] & maskIndex::IN_MASK) w_.col(j++) = w.col(index.i[k]) * (Scalar)index.m[k];
+    gramUpdate(a, w_, (Scalar)-1);
+}
+
+// solve column "i" of "h" in "ax = b" over only the factors linked to it by "l", with "b" weighted by their link values
+//  * unlinked factors are zero in the solution, so they are dropped from the system rather than solved with "b = 0",
+//      and each coordinate descent iteration costs "n^2" rather than "k^2" for "n" linked factors
+//  * the reduced system is gathered into "ws"
+//  * returns false without solving if the column is linked to all factors, after weighting "b", so that the caller
+//      solves the full system as for an unlinked column
+template <typename Scalar, class MatrixA, class VectorB>
+inline bool linkedSolve(const linkIndex& l, const int i, const MatrixA& a, VectorB& b, Eigen::Matrix<Scalar, -1, -1>& h,
+                        workspace<Scalar>& ws, const double upper_bound, const bool active, const double stop_tol) {
+    if (!l.reduces(i, h.rows())) {
+        l.weigh(i, b);
+        return false;
+    }
+    const int n = l.size(i);
+    const int* f = l.factors(i);
+    const double* v = l.values(i);
+    h.col(i).setZero();
+    if (n == 0) return true;
+    ws.a_l.resize(n, n);
+    ws.b_l.resize(n);
+    ws.x_l.setZero(n, 1);
+    for (int q = 0; q < n; ++q) {
+        ws.b_l(q) = b(f[q]) * (Scalar)v[q];
+        for (int r = 0; r < n; ++r) ws.a_l(r, q) = a(f[r], f[q]);
+    }
+    if (upper_bound > 0)
+        bnnls(ws.a_l, ws.b_l, ws.x_l, 0, upper_bound, ws.as_l, stop_tol);
+    else if (active)
+        ws.as_l.solve(ws.a_l, ws.b_l, ws.x_l, 0);
+    else
+        c_nnls(ws.a_l, ws.b_l, ws.x_l, 0, CD_MAXIT, stop_tol);
+    for (int q = 0; q < n; ++q) h(f[q], i) = ws.x_l(q, 0);
+    return true;
+}
+
+// reduced systems of the blocks of a linking matrix (see "linkIndex"), gathered from "a" once per update rather than
+//   for each column, and factorized once to initialize coordinate descent from the clipped least squares solution of
+//   each column, as in unlinked columns, rather than from zero
+//  * each thread reads its own copy, as of the gram matrix
+//  * blocks linked to all factors are solved from the full system, and have no reduced system
+template <typename Scalar>
+class linkBlocks {
+   public:
+    linkBlocks() {}
+
+    template <class MatrixA>
+    linkBlocks(const linkIndex& l, const MatrixA& a) {
+        for (unsigned int b = 0; b < l.blocks(); ++b) {
+            const std::vector<int>& f = l.blockFactors(b);
+            const int n = (f.size() < (size_t)a.rows()) ? f.size() : 0;
+            a_b.push_back(Eigen::Matrix<Scalar, -1, -1>(n, n));
+            for (int q = 0; q < n; ++q)
+                for (int r = 0; r < n; ++r) a_b.back()(r, q) = a(f[r], f[q]);
+            llt_b.push_back(cholesky<Scalar, -1>(a_b.back()));
+        }
+    }
+
+    // solve column "i" of "h" as in "linkedSolve", from the reduced system of its block
+    template <class VectorB>
+    bool solve(const linkIndex& l, const int i, VectorB& b, Eigen::Matrix<Scalar, -1, -1>& h, workspace<Scalar>& ws,
+               const double upper_bound, const bool active, const double stop_tol) {
+        if (!l.reduces(i, h.rows())) {
+            l.weigh(i, b);
+            return false;
+        }
+        const int n = l.size(i), blk = l.block(i);
+        const int* f = l.factors(i);
+        const double* v = l.values(i);
+        h.col(i).setZero();
+        if (n == 0) return true;
+        ws.b_l.resize(n);
+        ws.x_l.setZero(n, 1);
+        for (int q = 0; q < n; ++q) ws.b_l(q) = b(f[q]) * (Scalar)v[q];
+        Eigen::Matrix<Scalar, -1, -1>& a = a_b[blk];
+        if (llt_b[blk].success) c_nnls_init(llt_b[blk], a, ws.b_l, ws.x_l, 0, upper_bound);
+        if (upper_bound > 0)
+            bnnls(a, ws.b_l, ws.x_l, 0, upper_bound, ws.as_l, stop_tol);
+        else if (active)
+            ws.as_l.solve(a, ws.b_l, ws.x_l, 0);
+        else
+            c_nnls(a, ws.b_l, ws.x_l, 0, CD_MAXIT, stop_tol);
+        for (int q = 0; q < n; ++q) h(f[q], i) = ws.x_l(q, 0);
+        return true;
+    }
+
+   private:
+    std::vector<Eigen::Matrix<Scalar, -1, -1> > a_b;
+    std::vector<cholesky<Scalar, -1> > llt_b;
+};
+
+// bytes of the buffers of each worker of "predict_unmasked" (see "memoryLease"): copies of the gram matrix and its
+//   factorization, right-hand sides of a tile, and with "frozen", the last solutions of a tile
+template <typename Scalar>
+inline double workerBytes(const unsigned int k, const bool frozen) {
+    return (2.0 * k * k + (frozen ? 2.0 : 1.0) * k * PREDICT_TILE_SIZE + 4.0 * k) * sizeof(Scalar);
+}
+
+// solve for 'h' given sparse 'A' in 'A = wh' where no values in "A" are masked
+//  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2", and if "col_losses" is
+//      given, it is set to that of each column, less "||A.col(i)||^2"
+//  * "K" is the rank of "w" if known at compile-time (see RCPPML_DISPATCH_RANK), otherwise Eigen::Dynamic (-1)
+//  * if "frozen" is given, frozen columns are not solved (see "freezer"), and their right-hand sides are only computed
+//      if "loss" or "col_losses" is given
+//  * if "warm", columns are solved from their solutions in "h" (see "c_nnls_warm"), such as those of an earlier projection
+//      onto a slightly different "w", and with "skip_tol > 0", columns that already meet it are kept (see "c_nnls_converged")
+template <typename Scalar, int K, typename Value>
+void predict_unmasked(RcppML::SparseOf<Value>& A, const linkIndex& mask_h, const Eigen::Matrix<Scalar, -1, -1>& w,
+                      Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2, const int threads,
+                      const bool masking_h, const double upper_bound, const int solver, const double stop_tol,
+                      double* loss, freezer<Scalar>* frozen, Eigen::ArrayXd* col_losses = NULL, const bool warm = false,
+                      const double skip_tol = 0) {
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, -1> MatrixKX;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+
+    MatrixK a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    const cholesky<Scalar, K> a_llt(a);
+    const bool active = useActiveSet(solver, h.rows());
+    // solve all systems of a tile at once (see "nnls2Batch")
+    const bool rank2 = K == 2 && upper_bound <= 0 && !active && !masking_h && !warm;
+    const linkBlocks<Scalar> blocks = masking_h ? linkBlocks<Scalar>(mask_h, a) : linkBlocks<Scalar>();
+
+    // right-hand sides "b = wA" are computed for a tile of columns in "A" before solving any of their systems, so
+    //   that "w" stays in cache while it is gathered against the nonzeros of many columns
+    //  * tiles have roughly equal numbers of non-zeros (see "colChunks"), so that threads are balanced when some
+    //      columns are much denser than others
+    //  * with NUMA placement, each thread updates a static block of tiles (see "RcppML::numaPlacement")
+    //  * within a team, e.g. of restarts fit concurrently, tiles are taken by workers that are tasks of that team (see
+    //      "RcppML::forWorkers"), and are not placed
+    const std::vector<int>& tiles = A.colChunks(PREDICT_TILE_SIZE);
+    const int num_tiles = tiles.size() - 1;
+    const bool numa = RcppML::numaActive() && !RcppML::inTeam();
+    const unsigned int n_groups = numa ? RcppML::numaGroups(threads) : 1;
+    std::vector<Eigen::Matrix<Scalar, -1, -1> > w_nodes(n_groups > 1 ? n_groups : 0);
+    const bool losses_ = loss || col_losses;
+    Eigen::ArrayXd losses;
+    if (losses_) losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::taskCounter next_tile(num_tiles);
+    RcppML::forWorkers(threads, [&](const int thread, const int n_threads) {
+        RCPPML_COUNTER_SCOPE;
+        // each thread reads its own copy of the gram matrix, and with NUMA placement, the copy of "w" on its node,
+        //   which is written by the first thread of the node
+        MatrixK a_t = a;
+        const cholesky<Scalar, K> a_llt_t = a_llt;
+        const unsigned int group = RcppML::numaGroup(thread, n_threads, n_groups);
+        if (n_groups > 1) {
+            if (thread == 0 || RcppML::numaGroup(thread - 1, n_threads, n_groups) != group) w_nodes[group] = w;
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+        }
+        const Eigen::Matrix<Scalar, -1, -1>& w_t = (n_groups > 1) ? w_nodes[group] : w;
+
+        // buffers are allocated once per thread
+        MatrixKX B(h.rows(), PREDICT_TILE_SIZE), X_last;
+        VectorK b(h.rows());
+        nnls_lanes<Scalar, K> lanes(a_t, h, stop_tol, solver);
+        active_set<Scalar, K> as_solver(h.rows());
+        workspace<Scalar> ws(masking_h ? h.rows() : 0);
+        linkBlocks<Scalar> blocks_t = blocks;
+        bool skipped[PREDICT_TILE_SIZE] = {false};
+        if (frozen) X_last = MatrixKX(h.rows(), PREDICT_TILE_SIZE);
+        Eigen::Matrix<Scalar, 2, -1> X2;
+        if (rank2) X2 = Eigen::Matrix<Scalar, 2, -1>(2, PREDICT_TILE_SIZE);
+        const RcppML::memoryLease workspace_bytes(RcppML::MEM_WORKSPACE, workerBytes<Scalar>(h.rows(), frozen != NULL));
+        const auto updateTile = [&](const int tile) {
+            const int start = tiles[tile];
+            const int tile_size = tiles[tile + 1] - start;
+            if (frozen)
+                for (int j = 0; j < tile_size; ++j) skipped[j] = frozen->skip(start + j);
+            if (rank2) X2.leftCols(tile_size).setZero();
+            B.leftCols(tile_size).setZero();
+            for (int j = 0; j < tile_size; ++j) {
+                if (skipped[j] && !losses_) continue;
+                RCPPML_COUNT(COUNT_GATHERED, A.p[start + j + 1] - A.p[start + j]);
+                RCPPML_COUNT(COUNT_FLOPS, 2 * h.rows() * (A.p[start + j + 1] - A.p[start + j]));
+            }
+            gatherTile(A, w_t, B, start, tile_size, losses_ ? NULL : skipped);
+            if (L1 != 0) B.leftCols(tile_size).array() -= L1;
+
+            for (int j = 0; j < tile_size; ++j) {
+                const int i = start + j;
+                if (frozen) {
+                    frozen->restore(h.col(i));
+                    if (skipped[j]) continue;
+                    X_last.col(j) = h.col(i);
+                }
+                if (!warm || A.p[i] == A.p[i + 1]) h.col(i).setZero();
+                if (A.p[i] == A.p[i + 1]) continue;
+                b = B.col(j);
+                if (masking_h && blocks_t.solve(mask_h, i, b, h, ws, upper_bound, active, stop_tol)) continue;
+                if (rank2) {
+                    X2.col(j) = b.template head<2>();
+                    continue;
+                }
+                if (warm) {
+                    c_nnls_warm(a_t, b, h, i, upper_bound);
+                    if (skip_tol > 0 && c_nnls_converged(a_t, b, h, i, upper_bound, skip_tol)) continue;
+                } else if (a_llt_t.success) {
+                    c_nnls_init(a_llt_t, a_t, b, h, i, upper_bound);
+                }
+                if (upper_bound > 0)
+                    bnnls(a_t, b, h, i, upper_bound, as_solver, stop_tol);
+                else if (active)
+                    as_solver.solve(a_t, b, h, i);
+                else
+                    lanes.push(b, i);
+            }
+            lanes.finish();
+            if (rank2) {
+                nnls2Batch(Eigen::Matrix<Scalar, 2, 2>(a_t.template topLeftCorner<2, 2>()), X2.leftCols(tile_size), true);
+                for (int j = 0; j < tile_size; ++j)
+                    if (!skipped[j]) h.col(start + j) = X2.col(j);
+            }
+            if (frozen)
+                for (int j = 0; j < tile_size; ++j)
+                    if (!skipped[j] && A.p[start + j] != A.p[start + j + 1]) frozen->update(start + j, h.col(start + j), X_last.col(j));
+            if (losses_)
+                for (int j = 0; j < tile_size; ++j)
+                    if (A.p[start + j] != A.p[start + j + 1])
+                        losses(start + j) = gram_loss(a_t, B.col(j), h.col(start + j), L1, L2 + TINY_NUM_FOR_STABILITY);
+        };
+        if (numa) {
+            int first, last;
+            RcppML::staticBlock(num_tiles, thread, n_threads, first, last);
+            for (int tile = first; tile < last; ++tile) updateTile(tile);
+        } else {
+            int tile;
+            while (next_tile.take(tile)) updateTile(tile);
+        }
+    });
+    if (loss) *loss = losses.sum();
+    if (col_losses) *col_losses = losses;
+}
+
+// solve for 'h' given dense 'A' in 'A = wh' where no values in "A" are masked
+//  * right-hand sides "b = wA" for a tile of columns are computed by a single matrix-matrix product, rather than a
+//      matrix-vector product for each column that reads all of "w" again. Linked columns are solved from these
+//      right-hand sides over only their linked factors (see "linkedSolve").
+//  * "A" may be a transposed view of a dense matrix (see "nmf::transposedA"), in which case each tile of columns is a
+//      block of rows of that matrix, read in place by the same product
+//  * if "frozen" is given, frozen columns are not solved (see "freezer")
+//  * "loss", "col_losses", "warm" and "skip_tol" are as for sparse "A"
+template <typename Scalar, int K, class Derived>
+void predict_unmasked(const Eigen::MatrixBase<Derived>& A, const linkIndex& l, const Eigen::Matrix<Scalar, -1, -1>& w,
+                      Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2, const unsigned int threads,
+                      const bool link, const double upper_bound, const int solver, const double stop_tol, double* loss,
+                      freezer<Scalar>* frozen, Eigen::ArrayXd* col_losses = NULL, const bool warm = false,
+                      const double skip_tol = 0) {
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, -1> MatrixKX;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+
+    MatrixK a = gram(w, threads);
+    a.diagonal().array() += TINY_NUM + L2;
+    const cholesky<Scalar, K> a_llt(a);
+    const bool active = useActiveSet(solver, h.rows());
+    // solve all systems of a tile at once (see "nnls2Batch")
+    const bool rank2 = K == 2 && upper_bound <= 0 && !active && !link && !warm;
+    const linkBlocks<Scalar> blocks = link ? linkBlocks<Scalar>(l, a) : linkBlocks<Scalar>();
+    if (!a_llt.success && !warm) h.setZero();
+    const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    const bool losses_ = loss || col_losses;
+    Eigen::ArrayXd losses;
+    if (losses_) losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::taskCounter next_tile(num_tiles);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        MatrixKX B(h.rows(), PREDICT_TILE_SIZE), X_last;
+        VectorK b(h.rows());
+        nnls_lanes<Scalar, K> lanes(a, h, stop_tol, solver);
+        active_set<Scalar, K> as_solver(h.rows());
+        workspace<Scalar> ws(link ? h.rows() : 0);
+        linkBlocks<Scalar> blocks_t = blocks;
+        bool skipped[PREDICT_TILE_SIZE] = {false};
+        if (frozen) X_last = MatrixKX(h.rows(), PREDICT_TILE_SIZE);
+        Eigen::Matrix<Scalar, 2, -1> X2;
+        if (rank2) X2 = Eigen::Matrix<Scalar, 2, -1>(2, PREDICT_TILE_SIZE);
+        const RcppML::memoryLease workspace_bytes(RcppML::MEM_WORKSPACE, workerBytes<Scalar>(h.rows(), frozen != NULL));
+        int tile;
+        while (next_tile.take(tile)) {
+            const int start = tile * PREDICT_TILE_SIZE;
+            const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+            if (frozen)
+                for (int j = 0; j < tile_size; ++j) skipped[j] = frozen->skip(start + j);
+
+            // calculate right-hand sides of systems of equations, "b", and subtract L1 penalty
+            B.leftCols(tile_size).noalias() = w * A.middleCols(start, tile_size);
+            if (L1 != 0) B.leftCols(tile_size).array() -= L1;
+
+            for (int j = 0; j < tile_size; ++j) {
+                const int i = start + j;
+                if (frozen) {
+                    frozen->restore(h.col(i));
+                    if (skipped[j]) continue;
+                    X_last.col(j) = h.col(i);
+                }
+                if (rank2) {
+                    X2.col(j) = B.col(j).template head<2>();
+                    continue;
+                }
+                b = B.col(j);
+                if (link && blocks_t.solve(l, i, b, h, ws, upper_bound, active, stop_tol)) continue;
+                if (warm) {
+                    c_nnls_warm(a, b, h, i, upper_bound);
+                    if (skip_tol > 0 && c_nnls_converged(a, b, h, i, upper_bound, skip_tol)) continue;
+                } else if (a_llt.success) {
+                    c_nnls_init(a_llt, a, b, h, i, upper_bound);
+                }
+                if (upper_bound > 0)
+                    bnnls(a, b, h, i, upper_bound, as_solver, stop_tol);
+                else if (active)
+                    as_solver.solve(a, b, h, i);
+                else
+                    lanes.push(b, i);
+            }
+            lanes.finish();
+            if (rank2) {
+                nnls2Batch(Eigen::Matrix<Scalar, 2, 2>(a.template topLeftCorner<2, 2>()), X2.leftCols(tile_size), true);
+                for (int j = 0; j < tile_size; ++j)
+                    if (!skipped[j]) h.col(start + j) = X2.col(j);
+            }
+            if (frozen)
+                for (int j = 0; j < tile_size; ++j)
+                    if (!skipped[j]) frozen->update(start + j, h.col(start + j), X_last.col(j));
+            if (losses_)
+                for (int j = 0; j < tile_size; ++j)
+                    losses(start + j) = gram_loss(a, B.col(j), h.col(start + j), L1, L2 + TINY_NUM);
+        }
+    });
+    if (loss) *loss = losses.sum();
+    if (col_losses) *col_losses = losses;
+}
+
 // solve for 'h' given sparse 'A' in 'A = wh'
-void predict(Rcpp::SparseMatrix A, Rcpp::SparseMatrix mask_A, Rcpp::SparseMatrix& mask_h, const Eigen::MatrixXd& w,
-             Eigen::MatrixXd& h, const double L1, const double L2, const int threads, const bool mask_zeros,
-             const bool masking_A, const bool masking_h, const double upper_bound) {
+//  * "Scalar" is the precision in which "w", "h", and all systems of equations are solved. Values in "A" are
+//      cast to "Scalar" as they are read.
+//  * "stop_tol" is the coordinate descent tolerance (see "c_nnls"), which may be loosened for inexact updates (see "nmf::inexact")
+//  * "frozen" columns are skipped in updates without masking of "A" (see "freezer")
+//  * if "warm", masked columns are solved from their solutions in "h" (see "c_nnls_warm"), such as those of the previous
+//      iteration of "nmf", rather than from zero. Columns without masked values are solved as in unmasked updates.
+//      Without masking, all columns are warm-started (see "predict_unmasked").
+//  * with "warm" and "skip_tol > 0", warm-started columns whose solutions in "h" already meet "skip_tol" are kept (see
+//      "c_nnls_converged")
+//  * with "masking_A", "A" and "mask_A" are read from their merged stream "mask_index", which is built here if not given
+//      (see "maskIndex")
+//  * "col_losses" is set only by unmasked updates (see "predict_unmasked")
+template <typename Scalar, typename Value>
+void predict(RcppML::SparseOf<Value>& A, RcppML::SparseOf<double>& mask_A, const linkIndex& mask_h, const Eigen::Matrix<Scalar, -1, -1>& w,
+             Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2, const int threads, const bool mask_zeros,
+             const bool masking_A, const bool masking_h, const double upper_bound, const int solver = NNLS_AUTO,
+             const double stop_tol = cd_tol<Scalar>(), double* loss = NULL, freezer<Scalar>* frozen = NULL,
+             const bool warm = false, const maskIndex* mask_index = NULL, Eigen::ArrayXd* col_losses = NULL,
+             const double skip_tol = 0) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+    typedef typename MatrixS::ColsBlockXpr ColsS;
+    typedef typename RcppML::SparseOf<Value>::InnerIterator InnerIteratorA;
+
+    // masked updates are scheduled over chunks of columns with roughly equal numbers of non-zeros (see "colChunks")
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    const int num_chunks = chunks.size() - 1;
+    const bool active = useActiveSet(solver, h.rows());
+    maskIndex local_index;
+    if (masking_A && !mask_index) {
+        local_index = maskIndex(A, mask_A, threads);
+        mask_index = &local_index;
+    }
+
     // set upper_bound = 0 to not impose an upper bound
-    if (!mask_zeros) {
+    if (!mask_zeros && !masking_A) {
+        RCPPML_DISPATCH_RANK(w.rows(), predict_unmasked, A, mask_h, w, h, L1, L2, threads, masking_h, upper_bound, solver, stop_tol,
+                             loss, frozen, col_losses, warm, skip_tol);
+    } else if (!mask_zeros) {
         // calculate "a"
         //  * calculate "a" for updates of all columns of "h"
         //  * if masking is applied to "A", we will subtract away the contributions of masked
         //       values in each column update
-        Eigen::MatrixXd a = w * w.transpose();
+        MatrixS a = gram(w, threads);
         a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
 
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads)
-#endif
-        for (int i = 0; i < h.cols(); ++i) {
-            // if there are no nonzeros in this column of "A", no need to solve anything
-            if (A.p[i] == A.p[i + 1]) continue;
-
-            // find the number of masked values in "A.col(i)"
-            int num_masked = 0;
-            if (masking_A)
-                num_masked = mask_A.p[i + 1] - mask_A.p[i];
-
-            Eigen::MatrixXd a_i;
-
-            // calculate "b"
-            Eigen::VectorXd b = Eigen::VectorXd::Zero(h.rows());
-            if (num_masked == 0) {
-                // calculate "b" without masking on "A"
-                for (Rcpp::SparseMatrix::InnerIterator it(A, i); it; ++it)
-                    b += it.value() * w.col(it.row());
-            } else {
-                // calculate "b" with weighted masking on "A"
-                //  * traverse both A.col(i) and mask_A.col(i) similar to a boost ForwardTraversalIterator
-                Rcpp::SparseMatrix::InnerIterator it_A(A, i), it_mask(mask_A, i);
-                while (it_A) {
-                    if (!it_mask || it_A.row() < it_mask.row()) {
-                        b += it_A.value() * w.col(it_A.row());
-                        ++it_A;
-                    } else if (it_mask && it_A.row() == it_mask.row()) {
-                        if (it_mask.value() < 1)
-                            b += ((it_A.value() * (1 - it_mask.value())) * w.col(it_A.row()));
-                        ++it_mask;
-                        ++it_A;
-                    } else if (it_mask) {
-                        ++it_mask;
+        // factorize "a" once to initialize coordinate descent in all columns without masked values
+        const cholesky<Scalar> a_llt(a);
+
+        RcppML::taskCounter next_chunk(num_chunks);
+        RcppML::forWorkers(threads, [&](const int, const int) {
+            RCPPML_COUNTER_SCOPE;
+            workspace<Scalar> ws(h.rows());
+            VectorS& b = ws.b;
+            active_set<Scalar, -1> as_solver(h.rows());
+            int chunk;
+            while (next_chunk.take(chunk)) {
+                for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+                    // if there are no nonzeros in this column of "A", no need to solve anything
+                    if (!warm || A.p[i] == A.p[i + 1]) h.col(i).setZero();
+                    if (A.p[i] == A.p[i + 1]) continue;
+
+                    // find the number of masked values in "A.col(i)"
+                    int num_masked = 0;
+                    if (masking_A)
+                        num_masked = mask_A.p[i + 1] - mask_A.p[i];
+
+                    // calculate "b"
+                    b.setZero();
+                    RCPPML_COUNT(COUNT_GATHERED, A.p[i + 1] - A.p[i]);
+                    RCPPML_COUNT(COUNT_FLOPS, 2 * h.rows() * (A.p[i + 1] - A.p[i]));
+                    if (num_masked == 0) {
+                        // calculate "b" without masking on "A"
+                        for (InnerIteratorA it(A, i); it; ++it)
+                            b += (Scalar)it.value() * w.col(it.row());
+                    } else {
+                        // calculate "b" with weighted masking on "A", from the merged stream of A.col(i) and mask_A.col(i)
+                        const maskIndex& f = *mask_index;
+                        for (int k = f.p[i]; k < f.p[i + 1]; ++k)
+                            if ((f.flags[k] & maskIndex::IN_A) && f.m[k] < 1) b += (Scalar)(f.x[k] * (1 - f.m[k])) * w.col(f.i[k]);
+                        // if masking values in A.col(i), subtract contributions of masked indices from "a"
+                        ws.a = a;
+                        gramDowndate(ws.a, w, f, i, ws.cols(num_masked));
+                        gramSymmetrize(ws.a);
                     }
-                }
-                // if masking values in A.col(i), subtract contributions of masked indices from "a"
-                //  * we only need to consider columns in "w" that correspond to non-zero rows in "A" because
-                //      this code block does not consider the masked_zeros case
-                Eigen::MatrixXd w_(w.rows(), num_masked);
-                int j = 0;
-                for (Rcpp::SparseMatrix::InnerIterator it(mask_A, i); it; ++it, ++j)
-                    w_.col(j) = w.col(it.row()) * it.value();
-                Eigen::MatrixXd a_ = w_ * w_.transpose();
-                a_i = a - a_;
-            }
 
-            // apply L1 penalty on "b"
-            if (L1 != 0) b.array() -= L1;
+                    // apply L1 penalty on "b"
+                    if (L1 != 0) b.array() -= L1;
 
-            // apply masking on "h"
-            if (masking_h) {
-                Rcpp::NumericVector mask_h_i = mask_h.col(i);
-                for (int k = 0; k < b.size(); ++k)
-                    b[k] *= mask_h_i[k];
-            }
+                    // apply masking on "h"
+                    if (masking_h && linkedSolve(mask_h, i, (num_masked == 0) ? a : ws.a, b, h, ws, upper_bound, active, stop_tol))
+                        continue;
 
-            // solve nnls equations
-            if (upper_bound > 0) {
-                (num_masked == 0) ? c_bnnls(a, b, h, i, upper_bound) : c_bnnls(a_i, b, h, i, upper_bound);
-            } else {
-                (num_masked == 0) ? c_nnls(a, b, h, i) : c_nnls(a_i, b, h, i);
+                    // solve nnls equations
+                    if (num_masked == 0 && a_llt.success) {
+                        c_nnls_init(a_llt, a, b, h, i, upper_bound);
+                    } else if (warm) {
+                        c_nnls_warm((num_masked == 0) ? a : ws.a, b, h, i, upper_bound);
+                        if (skip_tol > 0 && c_nnls_converged((num_masked == 0) ? a : ws.a, b, h, i, upper_bound, skip_tol)) continue;
+                    }
+                    if (upper_bound > 0) {
+                        bnnls((num_masked == 0) ? a : ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                    } else if (active) {
+                        as_solver.solve((num_masked == 0) ? a : ws.a, b, h, i);
+                    } else {
+                        c_nnls((num_masked == 0) ? a : ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
+                    }
+                }
             }
-        }
+        });
     } else {  // mask_zeros = true
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads)
-#endif
-        for (int i = 0; i < h.cols(); ++i) {
-            if (A.p[i] == A.p[i + 1]) continue;
-
-            int num_masked = 0;
-            if (masking_A)
-                num_masked = mask_A.p[i + 1] - mask_A.p[i];
-
-            Eigen::VectorXi nnz(A.p[i + 1] - A.p[i]);
-            for (int ind = A.p[i], j = 0; j < nnz.size(); ++ind, ++j)
-                nnz(j) = A.i[ind];
-            Eigen::MatrixXd w_ = submat(w, nnz);
-
-            Eigen::VectorXd b = Eigen::VectorXd::Zero(h.rows());
-            if (num_masked == 0) {
-                for (Rcpp::SparseMatrix::InnerIterator it(A, i); it; ++it)
-                    b += it.value() * w.col(it.row());
-            } else {
-                // subset "w" at non-masked indices in A.col(i) to calculate "a"
-                Rcpp::SparseMatrix::InnerIterator it_mask(mask_A, i), it_A(A, i);
-                int j = 0;
-                while (it_mask && it_A) {
-                    if (it_mask.row() == it_A.row()) {
-                        w_.col(j) *= (1 - it_mask.value());
-                        ++it_mask;
-                        ++it_A;
-                        ++j;
-                    } else if (it_mask.row() < it_A.row()) {
-                        ++it_mask;
+        RcppML::taskCounter next_chunk(num_chunks);
+        RcppML::forWorkers(threads, [&](const int, const int) {
+            RCPPML_COUNTER_SCOPE;
+            workspace<Scalar> ws(h.rows());
+            VectorS& b = ws.b;
+            active_set<Scalar, -1> as_solver(h.rows());
+            int chunk;
+            while (next_chunk.take(chunk)) {
+                for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+                    if (!warm || A.p[i] == A.p[i + 1]) h.col(i).setZero();
+                    if (A.p[i] == A.p[i + 1]) continue;
+
+                    int num_masked = 0;
+                    if (masking_A)
+                        num_masked = mask_A.p[i + 1] - mask_A.p[i];
+
+                    // gather "w" at non-zero rows in A.col(i)
+                    ColsS w_ = ws.cols(A.p[i + 1] - A.p[i]);
+                    for (int ind = A.p[i], j = 0; ind < A.p[i + 1]; ++ind, ++j)
+                        w_.col(j) = w.col(A.i[ind]);
+
+                    b.setZero();
+                    RCPPML_COUNT(COUNT_GATHERED, A.p[i + 1] - A.p[i]);
+                    RCPPML_COUNT(COUNT_FLOPS, 2 * h.rows() * (A.p[i + 1] - A.p[i]));
+                    if (num_masked == 0) {
+                        for (InnerIteratorA it(A, i); it; ++it)
+                            b += (Scalar)it.value() * w.col(it.row());
                     } else {
-                        ++it_A;
+                        // weight "w" at masked indices in A.col(i) to calculate "a", and calculate "b" with masking on
+                        //   "A", in one pass over the merged stream of A.col(i) and mask_A.col(i)
+                        const maskIndex& f = *mask_index;
+                        for (int k = f.p[i], j = 0; k < f.p[i + 1]; ++k) {
+                            if (!(f.flags[k] & maskIndex::IN_A)) continue;
+                            if (f.flags[k] & maskIndex::IN_MASK) w_.col(j) *= (Scalar)(1 - f.m[k]);
+                            if (f.m[k] < 1) b += (Scalar)(f.x[k] * (1 - f.m[k])) * w.col(f.i[k]);
+                            ++j;
+                        }
                     }
-                }
+                    ws.a.setZero();
+                    gramUpdate(ws.a, w_);
+                    gramSymmetrize(ws.a);
 
-                // calculate "b" with masking on "A"
-                Rcpp::SparseMatrix::InnerIterator it_mask2(mask_A, i), it_A2(A, i);
-                while (it_A) {
-                    if (!it_mask2 || it_A2.row() < it_mask2.row()) {
-                        b += it_A2.value() * w.col(it_A2.row());
-                        ++it_A2;
-                    } else if (it_mask2 && it_A2.row() == it_mask2.row()) {
-                        if (it_mask2.value() < 1)
-                            b += ((it_A2.value() * (1 - it_mask2.value())) * w.col(it_A2.row()));
-                        ++it_mask2;
-                        ++it_A2;
-                    } else if (it_mask2) {
-                        ++it_mask2;
+                    if (L1 != 0) b.array() -= L1;
+                    ws.a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+                    if (masking_h && linkedSolve(mask_h, i, ws.a, b, h, ws, upper_bound, active, stop_tol)) continue;
+                    if (warm) {
+                        c_nnls_warm(ws.a, b, h, i, upper_bound);
+                        if (skip_tol > 0 && c_nnls_converged(ws.a, b, h, i, upper_bound, skip_tol)) continue;
+                    }
+                    if (upper_bound > 0) {
+                        bnnls(ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                    } else if (active) {
+                        as_solver.solve(ws.a, b, h, i);
+                    } else {
+                        c_nnls(ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
                     }
                 }
             }
-            Eigen::MatrixXd a = w_ * w_.transpose();
+        });
+    }
+}
 
-            if (L1 != 0) b.array() -= L1;
-            a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
-            if (masking_h) {
-                Rcpp::NumericVector mask_h_i = mask_h.col(i);
-                for (int k = 0; k < b.size(); ++k)
-                    b[k] *= mask_h_i[k];
-            }
-            if (upper_bound > 0) {
-                c_bnnls(a, b, h, i, upper_bound);
-            } else {
-                c_nnls(a, b, h, i);
+// robust losses of residuals of sparse "A" fit by iteratively reweighted least squares (see "nmf::reweight")
+enum robust_loss { ROBUST_NONE, ROBUST_HUBER, ROBUST_TUKEY };
+
+// weight of a residual "r" in the next least squares update under robust loss "loss" with threshold "delta": 1 within
+//   "delta", and "delta / |r|" beyond it for the Huber loss, or the Tukey biweight "(1 - (r / delta)^2)^2", which is 0
+//   beyond "delta"
+inline double robustWeight(const double r, const double delta, const int loss) {
+    const double abs_r = std::abs(r);
+    if (loss == ROBUST_HUBER) return (abs_r <= delta) ? 1 : delta / abs_r;
+    if (abs_r >= delta) return 0;
+    const double u = 1 - (r / delta) * (r / delta);
+    return u * u;
+}
+
+// solve for 'h' given sparse 'A' in 'A = wh', where each non-zero of "A" is weighted in the squared error by
+//   "weights[k]" for the "k"-th non-zero of "A" in column-major order, and zeros of "A" by 1
+//  * a column whose weights are all 1 is solved from "ww^T", factorized once to initialize it as in unmasked updates.
+//      Any other column downdates "ww^T" by "(1 - c) w.col(j) w.col(j)^T" for each of its non-zeros "j" of weight "c"
+//      less than 1, as masked columns do (see "gramDowndate"), and is warm-started with "warm".
+//  * a weight of 0 is a masked value, so robust losses that reject outliers cost about as much as masking them
+template <typename Scalar, typename Value>
+void predict_weighted(RcppML::SparseOf<Value>& A, const Scalar* weights, const Eigen::Matrix<Scalar, -1, -1>& w,
+                      Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2, const int threads,
+                      const double upper_bound, const int solver = NNLS_AUTO, const double stop_tol = cd_tol<Scalar>(),
+                      const bool warm = false) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef typename MatrixS::ColsBlockXpr ColsS;
+    typedef typename RcppML::SparseOf<Value>::InnerIterator InnerIteratorA;
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    const int num_chunks = chunks.size() - 1;
+    const bool active = useActiveSet(solver, h.rows());
+    MatrixS a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    const cholesky<Scalar> a_llt(a);
+
+    RcppML::taskCounter next_chunk(num_chunks);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        workspace<Scalar> ws(h.rows());
+        Eigen::Matrix<Scalar, -1, 1>& b = ws.b;
+        active_set<Scalar, -1> as_solver(h.rows());
+        int chunk;
+        while (next_chunk.take(chunk)) {
+            for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+                if (!warm || A.p[i] == A.p[i + 1]) h.col(i).setZero();
+                if (A.p[i] == A.p[i + 1]) continue;
+
+                // weighted right-hand side, with columns of "w" at down-weighted non-zeros gathered for the downdate
+                b.setZero();
+                ColsS w_ = ws.cols(A.p[i + 1] - A.p[i]);
+                int n_down = 0, k = A.p[i];
+                RCPPML_COUNT(COUNT_GATHERED, A.p[i + 1] - A.p[i]);
+                for (InnerIteratorA it(A, i); it; ++it, ++k) {
+                    const Scalar c = weights[k];
+                    b += (c * (Scalar)it.value()) * w.col(it.row());
+                    if (c < 1) w_.col(n_down++) = w.col(it.row()) * std::sqrt(1 - c);
+                }
+                if (L1 != 0) b.array() -= L1;
+                if (n_down > 0) {
+                    ws.a = a;
+                    gramUpdate(ws.a, w_.leftCols(n_down), (Scalar)-1);
+                    gramSymmetrize(ws.a);
+                }
+                MatrixS& a_i = (n_down == 0) ? a : ws.a;
+                if (n_down == 0 && a_llt.success) {
+                    c_nnls_init(a_llt, a, b, h, i, upper_bound);
+                } else if (warm) {
+                    c_nnls_warm(a_i, b, h, i, upper_bound);
+                }
+                if (upper_bound > 0) {
+                    bnnls(a_i, b, h, i, upper_bound, as_solver, stop_tol);
+                } else if (active) {
+                    as_solver.solve(a_i, b, h, i);
+                } else {
+                    c_nnls(a_i, b, h, i, CD_MAXIT, stop_tol, solver);
+                }
             }
         }
-    }
+    });
 }
 
 // solve for 'h' given dense 'A' in 'A = wh'
-void predict(Eigen::MatrixXd& A, Rcpp::SparseMatrix& m, Rcpp::SparseMatrix& l, const Eigen::MatrixXd& w,
-             Eigen::MatrixXd& h, const double L1, const double L2,
-             const unsigned int threads, const bool mask_zeros, const bool mask, const bool link, const double upper_bound = 0) {
+//  * "A" may be a transposed view of a dense matrix (see "predict_unmasked"). Right-hand sides of masked updates are
+//      computed for a tile of columns at once for the same reason, and masked values are then subtracted.
+//  * products of tiles within Eigen run on no more than "threads" threads (see "eigenThreads")
+template <typename Scalar, class Derived>
+void predict(const Eigen::MatrixBase<Derived>& A, RcppML::SparseOf<double>& m, const linkIndex& l, const Eigen::Matrix<Scalar, -1, -1>& w,
+             Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2,
+             const unsigned int threads, const bool mask_zeros, const bool mask, const bool link, const double upper_bound = 0,
+             const int solver = NNLS_AUTO, const double stop_tol = cd_tol<Scalar>(), double* loss = NULL,
+             freezer<Scalar>* frozen = NULL, const bool warm = false, const maskIndex* mask_index = NULL,
+             Eigen::ArrayXd* col_losses = NULL, const double skip_tol = 0) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+    typedef typename MatrixS::ColsBlockXpr ColsS;
+    const RcppML::eigenThreads eigen_threads(threads);
+    const bool active = useActiveSet(solver, h.rows());
     if (!mask_zeros && !mask) {
-        // GENERAL RANK IMPLEMENTATION
-        Eigen::MatrixXd a = w * w.transpose();
-        a.diagonal().array() += TINY_NUM + L2;
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            // calculate right-hand side of system of equations, "b"
-            Eigen::VectorXd b = Eigen::VectorXd::Zero(h.rows());
-            if (link) {
-                for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                    for (unsigned int it = 0; it < A.rows(); ++it)
-                        b(j.row()) += A(it, i) * w(j.row(), it);
-                if (L1 != 0)
-                    for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                        b(j.row()) -= L1;
-            } else {
-                b += w * A.col(i);
-                // subtract L1 penalty from "b"
-                if (L1 != 0) b.array() -= L1;
-            }
-
-            (upper_bound > 0) ? c_bnnls(a, b, h, i, upper_bound) : c_nnls(a, b, h, i);
-        }
+        RCPPML_DISPATCH_RANK(w.rows(), predict_unmasked, A, l, w, h, L1, L2, threads, link, upper_bound, solver, stop_tol, loss, frozen,
+                             col_losses, warm, skip_tol);
     } else if (mask_zeros) {
-        h.setZero();
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            std::vector<unsigned int> nz = nonzeroRowsInCol(A, i);
-            if (nz.size() > 0) {
-                Eigen::VectorXi nnz(nz.size());
-                for (unsigned int j = 0; j < nz.size(); ++j)
-                    nnz(j) = (int)nz[j];
-                Eigen::MatrixXd w_ = submat(w, nnz);
-                Eigen::MatrixXd a = w_ * w_.transpose();
-                a.diagonal().array() += TINY_NUM + L2;
-                Eigen::VectorXd b = Eigen::VectorXd::Zero(h.rows());
-
-                if (link) {
-                    for (unsigned int it = 0; it < A.rows(); ++it) {
-                        const double val = A(it, i);
-                        if (val != 0)
-                            for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                                b(j.row()) += A(it, i) * w(j.row(), it);
-                    }
-                    if (L1 != 0)
-                        for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                            b(j.row()) -= L1;
+        if (!warm) h.setZero();
+        RcppML::taskCounter next_col(h.cols());
+        RcppML::forWorkers(threads, [&](const int, const int) {
+            RCPPML_COUNTER_SCOPE;
+            workspace<Scalar> ws(h.rows());
+            VectorS& b = ws.b;
+            active_set<Scalar, -1> as_solver(h.rows());
+            int i;
+            while (next_col.take(i)) {
+                // gather "w" at non-zero rows in A.col(i)
+                ColsS w_nz = ws.cols(A.rows());
+                unsigned int num_nonzero = 0;
+                for (unsigned int it = 0; it < A.rows(); ++it)
+                    if (A(it, i) != 0) w_nz.col(num_nonzero++) = w.col(it);
+                if (num_nonzero == 0) {
+                    h.col(i).setZero();
                 } else {
+                    ws.a.setZero();
+                    gramUpdate(ws.a, ws.cols(num_nonzero));
+                    gramSymmetrize(ws.a);
+                    ws.a.diagonal().array() += TINY_NUM + L2;
+                    b.setZero();
                     for (unsigned int it = 0; it < A.rows(); ++it) {
-                        const double val = A(it, i);
+                        const Scalar val = A(it, i);
                         if (val != 0) {
                             b += val * w.col(it);
                         }
                     }
                     if (L1 != 0) b.array() -= L1;
+                    if (link && linkedSolve(l, i, ws.a, b, h, ws, upper_bound, active, stop_tol)) continue;
+                    if (warm) {
+                        c_nnls_warm(ws.a, b, h, i, upper_bound);
+                        if (skip_tol > 0 && c_nnls_converged(ws.a, b, h, i, upper_bound, skip_tol)) continue;
+                    }
+                    if (upper_bound > 0)
+                        bnnls(ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                    else
+                        active ? as_solver.solve(ws.a, b, h, i) : c_nnls(ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
                 }
-                (upper_bound > 0) ? c_bnnls(a, b, h, i, upper_bound) : c_nnls(a, b, h, i);
             }
-        }
+        });
     } else if (mask) {
-        Eigen::MatrixXd a = w * w.transpose();
-        h.setZero();
-#ifdef _OPENMP
-#pragma omp parallel for num_threads(threads) schedule(dynamic)
-#endif
-        for (unsigned int i = 0; i < h.cols(); ++i) {
-            // subtract contribution of masked rows from "a"
-            std::vector<unsigned int> masked_rows_ = m.InnerIndices(i);
-            Eigen::VectorXi masked_rows(masked_rows_.size());
-            for (unsigned int j = 0; j < masked_rows.size(); ++j)
-                masked_rows(j) = (int)masked_rows_[j];
-            Eigen::MatrixXd w_ = submat(w, masked_rows);
-            Eigen::MatrixXd a_ = w_ * w_.transpose();
-            a_ = a - a_;
-            a_.diagonal().array() += TINY_NUM + L2;
-
-            // calculate "b" for all non-masked rows
-            Eigen::VectorXd b = Eigen::VectorXd::Zero(h.rows());
-            if (link) {
-                for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                    for (unsigned int it = 0; it < A.rows(); ++it)
-                        b(j.row()) += A(it, i) * w(j.row(), it);
-                // subtract contributions of masked rows from "b"
-                for (unsigned int it = 0; it < masked_rows_.size(); ++it)
-                    for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                        b(j.row()) -= A(masked_rows_[it], i) * w(j.row(), masked_rows_[it]);
-
-                if (L1 != 0) {
-                    for (Rcpp::SparseMatrix::InnerIterator j(l, i); j; ++j)
-                        b(j.row()) -= L1;
+        MatrixS a = gram(w, threads);
+        if (!warm) h.setZero();
+        const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+        RcppML::taskCounter next_tile(num_tiles);
+        RcppML::forWorkers(threads, [&](const int, const int) {
+            RCPPML_COUNTER_SCOPE;
+            workspace<Scalar> ws(h.rows());
+            VectorS& b = ws.b;
+            MatrixS B(h.rows(), PREDICT_TILE_SIZE);
+            active_set<Scalar, -1> as_solver(h.rows());
+            int tile;
+            while (next_tile.take(tile)) {
+                const int start = tile * PREDICT_TILE_SIZE;
+                const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+                B.leftCols(tile_size).noalias() = w * A.middleCols(start, tile_size);
+                for (int j = 0; j < tile_size; ++j) {
+                    const int i = start + j;
+                    // subtract contribution of masked rows from "a"
+                    ws.a = a;
+                    gramDowndate(ws.a, w, m, i, ws.cols(m.p[i + 1] - m.p[i]), false);
+                    gramSymmetrize(ws.a);
+                    ws.a.diagonal().array() += TINY_NUM + L2;
+
+                    // subtract contributions of masked rows from "b" of all rows
+                    b = B.col(j);
+                    for (RcppML::SparseOf<double>::InnerIterator it(m, i); it; ++it)
+                        b -= A(it.row(), i) * w.col(it.row());
+                    if (L1 != 0) b.array() -= L1;
+
+                    // solve system with least squares
+                    if (link && linkedSolve(l, i, ws.a, b, h, ws, upper_bound, active, stop_tol)) continue;
+                    if (warm) {
+                        c_nnls_warm(ws.a, b, h, i, upper_bound);
+                        if (skip_tol > 0 && c_nnls_converged(ws.a, b, h, i, upper_bound, skip_tol)) continue;
+                    }
+                    if (upper_bound > 0)
+                        bnnls(ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                    else
+                        active ? as_solver.solve(ws.a, b, h, i) : c_nnls(ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
                 }
-            } else {
-                b += w * A.col(i);
-                // subtract contributions of masked rows from "b"
-                for (unsigned int it = 0; it < masked_rows_.size(); ++it)
-                    b -= A(masked_rows_[it], i) * w.col(masked_rows_[it]);
+            }
+        });
+    }
+}
+
+// squared error of each column less "||A.col(i)||^2" (see "gram_loss"), in a pass over "A" for updates that do not find
+//   it as they solve (e.g. "predict_rank1")
+template <typename Scalar, typename Value>
+Eigen::ArrayXd columnLosses(RcppML::SparseOf<Value>& A, const Eigen::Matrix<Scalar, -1, -1>& w, const Eigen::Matrix<Scalar, -1, -1>& h,
+                            const unsigned int threads) {
+    const Eigen::Matrix<Scalar, -1, -1> a = gram(w, threads);
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(h.cols());
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    RcppML::forEach((int)chunks.size() - 1, threads, [&](const int chunk) {
+        Eigen::Matrix<Scalar, -1, 1> b(h.rows());
+        for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+            b.setZero();
+            for (typename RcppML::SparseOf<Value>::InnerIterator it(A, i); it; ++it) b += (Scalar)it.value() * w.col(it.row());
+            losses(i) = gram_loss(a, b, h.col(i), 0, 0);
+        }
+    });
+    return losses;
+}
+
+template <typename Scalar, class Derived>
+Eigen::ArrayXd columnLosses(const Eigen::MatrixBase<Derived>& A, const Eigen::Matrix<Scalar, -1, -1>& w,
+                            const Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int threads) {
+    const Eigen::Matrix<Scalar, -1, -1> a = gram(w, threads);
+    Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::forEach((int)h.cols(), threads, [&](const int i) {
+        const Eigen::Matrix<Scalar, -1, 1> b = w * A.col(i).template cast<Scalar>();
+        losses(i) = gram_loss(a, b, h.col(i), 0, 0);
+    });
+    return losses;
+}
+
+// subtract "w.col(j) * w.col(j)^T" from "a" for every row "j" of column "i" of "A" that is masked by "mask" (see
+//   "hash_mask"), gathering masked columns of "w" into "w_" in blocks of "w_.cols()" for rank-k downdates
+template <class MatrixA, class MatrixW, class MatrixBuf>
+inline void hashDowndate(MatrixA& a, const MatrixW& w, const RcppML::hash_mask& mask, const int i, MatrixBuf w_) {
+    typedef typename MatrixA::Scalar Scalar;
+    int n = 0;
+    for (int row = 0; row < w.cols(); ++row) {
+        if (!mask(row, i)) continue;
+        if (n == w_.cols()) {
+            gramUpdate(a, w_, (Scalar)-1);
+            n = 0;
+        }
+        w_.col(n++) = w.col(row);
+    }
+    if (n > 0) gramUpdate(a, w_.leftCols(n), (Scalar)-1);
+}
+
+// solve for 'h' given sparse 'A' in 'A = wh', where values of "A" masked by "mask" (see "hash_mask") are excluded
+//  * masked rows of each column are found by hashing every row, so no masking matrix is stored or merged with "A".
+//      This trades one hash per row for the memory and merge of a masking matrix.
+template <typename Scalar, typename Value>
+void predict_hashed(RcppML::SparseOf<Value>& A, const RcppML::hash_mask& mask, const linkIndex& mask_h,
+                    const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2,
+                    const int threads, const bool masking_h, const double upper_bound, const int solver = NNLS_AUTO,
+                    const double stop_tol = cd_tol<Scalar>(), const bool warm = false) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+    typedef typename RcppML::SparseOf<Value>::InnerIterator InnerIteratorA;
+
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+    const bool active = useActiveSet(solver, h.rows());
+    MatrixS a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    RcppML::taskCounter next_chunk((int)chunks.size() - 1);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        workspace<Scalar> ws(h.rows());
+        VectorS& b = ws.b;
+        active_set<Scalar, -1> as_solver(h.rows());
+        int chunk;
+        while (next_chunk.take(chunk)) {
+            for (int i = chunks[chunk]; i < chunks[chunk + 1]; ++i) {
+                if (!warm || A.p[i] == A.p[i + 1]) h.col(i).setZero();
+                if (A.p[i] == A.p[i + 1]) continue;
+                b.setZero();
+                RCPPML_COUNT(COUNT_GATHERED, A.p[i + 1] - A.p[i]);
+                RCPPML_COUNT(COUNT_FLOPS, 2 * h.rows() * (A.p[i + 1] - A.p[i]));
+                for (InnerIteratorA it(A, i); it; ++it)
+                    if (!mask(it.row(), i)) b += (Scalar)it.value() * w.col(it.row());
+                ws.a = a;
+                hashDowndate(ws.a, w, mask, i, ws.cols(PREDICT_TILE_SIZE));
+                gramSymmetrize(ws.a);
                 if (L1 != 0) b.array() -= L1;
+                if (masking_h && linkedSolve(mask_h, i, ws.a, b, h, ws, upper_bound, active, stop_tol)) continue;
+                if (warm) c_nnls_warm(ws.a, b, h, i, upper_bound);
+                if (upper_bound > 0)
+                    bnnls(ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                else
+                    active ? as_solver.solve(ws.a, b, h, i) : c_nnls(ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
             }
+        }
+    });
+}
 
-            // solve system with least squares
-            (upper_bound > 0) ? c_bnnls(a_, b, h, i, upper_bound) : c_nnls(a_, b, h, i);
+// solve for 'h' given dense 'A' in 'A = wh', where values of "A" masked by "mask" (see "hash_mask") are excluded
+//  * right-hand sides are computed for a tile of columns at once, and masked values are then subtracted, so that "A"
+//      may be a transposed view of a dense matrix (see "predict_unmasked")
+template <typename Scalar, class Derived>
+void predict_hashed(const Eigen::MatrixBase<Derived>& A, const RcppML::hash_mask& mask, const linkIndex& mask_h,
+                    const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1, const double L2,
+                    const int threads, const bool masking_h, const double upper_bound, const int solver = NNLS_AUTO,
+                    const double stop_tol = cd_tol<Scalar>(), const bool warm = false) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+
+    const bool active = useActiveSet(solver, h.rows());
+    MatrixS a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    if (!warm) h.setZero();
+    const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    RcppML::taskCounter next_tile(num_tiles);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        workspace<Scalar> ws(h.rows());
+        VectorS& b = ws.b;
+        MatrixS B(h.rows(), PREDICT_TILE_SIZE);
+        active_set<Scalar, -1> as_solver(h.rows());
+        int tile;
+        while (next_tile.take(tile)) {
+            const int start = tile * PREDICT_TILE_SIZE;
+            const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+            B.leftCols(tile_size).noalias() = w * A.middleCols(start, tile_size);
+            for (int j = 0; j < tile_size; ++j) {
+                const int i = start + j;
+                b = B.col(j);
+                for (unsigned int row = 0; row < A.rows(); ++row)
+                    if (mask(row, i)) b -= A(row, i) * w.col(row);
+                ws.a = a;
+                hashDowndate(ws.a, w, mask, i, ws.cols(PREDICT_TILE_SIZE));
+                gramSymmetrize(ws.a);
+                if (L1 != 0) b.array() -= L1;
+                if (masking_h && linkedSolve(mask_h, i, ws.a, b, h, ws, upper_bound, active, stop_tol)) continue;
+                if (warm) c_nnls_warm(ws.a, b, h, i, upper_bound);
+                if (upper_bound > 0)
+                    bnnls(ws.a, b, h, i, upper_bound, as_solver, stop_tol);
+                else
+                    active ? as_solver.solve(ws.a, b, h, i) : c_nnls(ws.a, b, h, i, CD_MAXIT, stop_tol, solver);
+            }
         }
+    });
+}
+
+// solve for 'h' in 'A = wh' given only the Gram matrix "a = ww^T" and right-hand sides "B = wA"
+//  * used when "B" is accumulated over parts of "A", such as chunks of columns that are never in memory together
+//  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2"
+template <typename Scalar, int K>
+void predict_gram_k(const Eigen::Matrix<Scalar, -1, -1>& a_, const Eigen::Matrix<Scalar, -1, -1>& B, Eigen::Matrix<Scalar, -1, -1>& h,
+                    const double L1, const double L2, const unsigned int threads, const double upper_bound, const int solver,
+                    const double stop_tol, double* loss) {
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+
+    MatrixK a = a_;
+    a.diagonal().array() += L2 + TINY_NUM;
+    const cholesky<Scalar, K> a_llt(a);
+    if (!a_llt.success) h.setZero();
+    const bool active = useActiveSet(solver, h.rows());
+    Eigen::ArrayXd losses;
+    if (loss) losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::taskCounter next_col(h.cols());
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        active_set<Scalar, K> as_solver(h.rows());
+        int i;
+        while (next_col.take(i)) {
+            VectorK b = B.col(i);
+            if (L1 != 0) b.array() -= L1;
+            const VectorK b0 = b;
+            if (a_llt.success) c_nnls_init(a_llt, a, b, h, i, upper_bound);
+            if (upper_bound > 0)
+                bnnls(a, b, h, i, upper_bound, as_solver, stop_tol);
+            else
+                active ? as_solver.solve(a, b, h, i) : c_nnls(a, b, h, i, CD_MAXIT, stop_tol, solver);
+            if (loss) losses(i) = gram_loss(a, b0, h.col(i), L1, L2 + TINY_NUM);
+        }
+    });
+    if (loss) *loss = losses.sum();
+}
+
+template <typename Scalar>
+void predict_gram(const Eigen::Matrix<Scalar, -1, -1>& a, const Eigen::Matrix<Scalar, -1, -1>& B, Eigen::Matrix<Scalar, -1, -1>& h,
+                  const double L1, const double L2, const unsigned int threads, const double upper_bound = 0,
+                  const int solver = NNLS_AUTO, const double stop_tol = cd_tol<Scalar>(), double* loss = NULL) {
+    RCPPML_DISPATCH_RANK(a.rows(), predict_gram_k, a, B, h, L1, L2, threads, upper_bound, solver, stop_tol, loss);
+}
+
+// right-hand sides "B = wA" of all columns in sparse "A", minus "L1"
+template <typename Scalar, typename Value>
+void gramRhs(RcppML::SparseOf<Value>& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& B, const double L1,
+         const unsigned int threads) {
+    const std::vector<int>& tiles = A.colChunks(PREDICT_TILE_SIZE);
+    const int num_tiles = tiles.size() - 1;
+    RcppML::forEach(num_tiles, threads, [&](const int tile) {
+        const int start = tiles[tile], tile_size = tiles[tile + 1] - start;
+        B.middleCols(start, tile_size).setConstant(-L1);
+        Eigen::Block<Eigen::Matrix<Scalar, -1, -1> > B_tile = B.middleCols(start, tile_size);
+        gatherTile(A, w, B_tile, start, tile_size);
+    });
+}
+
+// right-hand sides "B = wA" of all columns in dense "A", minus "L1"
+template <typename Scalar, class Derived>
+void gramRhs(const Eigen::MatrixBase<Derived>& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& B,
+         const double L1, const unsigned int threads) {
+    const RcppML::eigenThreads eigen_threads(threads);
+    const int num_tiles = (A.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    RcppML::forEach(num_tiles, threads, [&](const int tile) {
+        const int start = tile * PREDICT_TILE_SIZE;
+        const int tile_size = std::min(PREDICT_TILE_SIZE, (int)A.cols() - start);
+        B.middleCols(start, tile_size).noalias() = w * A.middleCols(start, tile_size);
+    });
+    if (L1 != 0) B.array() -= L1;
+}
+
+// boundaries of "n" consecutive chunks of rows of sparse "A" with roughly equal numbers of non-zeros: chunk "c" spans
+//   rows [chunks[c], chunks[c + 1]) (see "gramRhsRows")
+template <typename Value>
+std::vector<int> rowChunks(RcppML::SparseOf<Value>& A, const unsigned int n) {
+    const int n_rows = A.rows(), nnz = A.p[A.cols()];
+    std::vector<int> row_nnz(n_rows, 0), chunks(1, 0);
+    for (int it = 0; it < nnz; ++it) ++row_nnz[A.i[it]];
+    const double chunk_nnz = (double)nnz / std::max(n, 1u);
+    double sum = 0;
+    for (int r = 0; r < n_rows; ++r) {
+        sum += row_nnz[r];
+        if (sum >= chunk_nnz * chunks.size() && r + 1 < n_rows) chunks.push_back(r + 1);
+    }
+    chunks.push_back(n_rows);
+    return chunks;
+}
+
+// add "hA^T" to "B" for sparse "A", as right-hand sides of updates of "w" from "h", without the transpose of "A"
+//  * each chunk of rows of "A" (see "rowChunks") is taken by one thread, which scans every column of "A" from the
+//      first of its rows (by a binary search over the row indices of the column) to the last, so that no two threads
+//      update the same column of "B" and there is no reduction
+//  * every chunk reads all of "h" and searches every column of "A", so this costs more than a product with the
+//      transpose of "A" when "A" has few non-zeros in each column, but holds no copy of "A"
+template <typename Scalar, typename Value>
+void gramRhsRows(RcppML::SparseOf<Value>& A, const Eigen::Matrix<Scalar, -1, -1>& h, Eigen::Matrix<Scalar, -1, -1>& B,
+                 const std::vector<int>& chunks, const unsigned int threads) {
+    const int n_cols = A.cols(), num_chunks = chunks.size() - 1;
+    if (A.p[n_cols] == 0) return;
+    const int* rows = &A.i[0];
+    RcppML::forEach(num_chunks, threads, [&](const int c) {
+        const int first = chunks[c], last = chunks[c + 1];
+        for (int j = 0; j < n_cols; ++j) {
+            const int end = A.p[j + 1];
+            int it = (first == 0) ? A.p[j] : std::lower_bound(rows + A.p[j], rows + end, first) - rows;
+            for (; it < end && rows[it] < last; ++it) B.col(rows[it]) += (Scalar)A.x[it] * h.col(j);
+        }
+    });
+}
+
+// update 'h' in 'A = wh' by one sweep of hierarchical alternating least squares (HALS), without masking or linking
+//  * "B = wA" and "a = ww^T" are computed once, then each row of "h" is updated across all columns in turn, as
+//      "h.row(r) = max(0, h.row(r) + (B.row(r) - a.row(r) * h) / a(r, r))". Columns are independent, so the rows of
+//      each tile of columns are updated in turn by one worker while the tile is in cache, in parallel over tiles.
+//  * this is a single coordinate descent sweep over each column of "h" from its previous solution, so "h" is not
+//      solved exactly, but each outer iteration is far cheaper than solving every column to convergence
+//  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2"
+template <class T, typename Scalar>
+void predict_hals(T&& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1,
+                  const double L2, const unsigned int threads, const double upper_bound = 0, double* loss = NULL) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    MatrixS B(h.rows(), h.cols());
+    gramRhs(A, w, B, L1, threads);
+    MatrixS a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    Eigen::ArrayXd losses;
+    if (loss) losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::taskCounter next_tile(num_tiles);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        Eigen::Matrix<Scalar, 1, -1> g(PREDICT_TILE_SIZE);
+        int tile;
+        while (next_tile.take(tile)) {
+            const int start = tile * PREDICT_TILE_SIZE;
+            const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+            for (int r = 0; r < (int)h.rows(); ++r) {
+                g.head(tile_size).noalias() = a.row(r) * h.middleCols(start, tile_size);
+                auto h_r = h.row(r).segment(start, tile_size).array();
+                h_r = (h_r + (B.row(r).segment(start, tile_size).array() - g.head(tile_size).array()) / a(r, r)).max((Scalar)0);
+                if (upper_bound > 0) h_r = h_r.min((Scalar)upper_bound);
+            }
+            if (!loss) continue;
+            for (int i = start; i < start + tile_size; ++i) losses(i) = gram_loss(a, B.col(i), h.col(i), L1, L2 + TINY_NUM_FOR_STABILITY);
+        }
+    });
+    if (loss) *loss = losses.sum();
+}
+
+// solve 'h' in 'A = wh' exactly without a non-negativity constraint (as in semi-nmf), without masking or linking
+//  * "a = ww^T + L2" is shared by all columns, so it is factorized once by Cholesky decomposition, and "B = wA" is then
+//      solved by forward and back substitution across whole tiles of columns at a time (see "solveColumnsInPlace")
+//  * "L1" is subtracted from "B" (see "gramRhs"), which is only a lasso penalty for non-negative solutions
+//  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2"
+template <class T, typename Scalar>
+void predict_unconstrained(T&& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1,
+                           const double L2, const unsigned int threads, double* loss = NULL) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    MatrixS B(h.rows(), h.cols());
+    gramRhs(A, w, B, L1, threads);
+    MatrixS a = gram(w, threads);
+    a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+    const cholesky<Scalar> a_llt(a);
+    if (!a_llt.success) RcppML::fail("the Gram matrix of an unconstrained update is not positive definite");
+    const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    Eigen::ArrayXd losses;
+    if (loss) losses = Eigen::ArrayXd::Zero(h.cols());
+    RcppML::taskCounter next_tile(num_tiles);
+    RcppML::forWorkers(threads, [&](const int, const int) {
+        RCPPML_COUNTER_SCOPE;
+        int tile;
+        while (next_tile.take(tile)) {
+            const int start = tile * PREDICT_TILE_SIZE;
+            const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+            typename MatrixS::ColsBlockXpr h_tile = h.middleCols(start, tile_size);
+            h_tile = B.middleCols(start, tile_size);
+            a_llt.solveColumnsInPlace(h_tile);
+            if (!loss) continue;
+            for (int i = start; i < start + tile_size; ++i) losses(i) = gram_loss(a, B.col(i), h.col(i), L1, L2 + TINY_NUM_FOR_STABILITY);
+        }
+    });
+    if (loss) *loss = losses.sum();
+}
+
+// right-hand sides "wA" of a rank-1 "w" for "n" columns of "A" from "start", written to "b"
+//  * sparse columns are accumulated in double precision
+//  * dense columns are computed by one matrix-vector product, which reads a transposed view of a dense matrix (see
+//      "predict_unmasked") by contiguous blocks of rows rather than one strided row at a time
+template <typename Scalar, typename Value>
+inline void rank1Rhs(RcppML::SparseOf<Value>& A, const Eigen::Matrix<Scalar, -1, -1>& w, const int start, const int n, double* b) {
+    for (int j = 0; j < n; ++j) {
+        b[j] = 0;
+        for (typename RcppML::SparseOf<Value>::InnerIterator it(A, start + j); it; ++it) b[j] += (double)it.value() * w(0, it.row());
+    }
+}
+
+template <typename Scalar, class Derived>
+inline void rank1Rhs(const Eigen::MatrixBase<Derived>& A, const Eigen::Matrix<Scalar, -1, -1>& w, const int start, const int n,
+                     double* b) {
+    Eigen::Map<Eigen::Matrix<double, 1, -1> >(b, n) = (w.row(0) * A.middleCols(start, n)).template cast<double>();
+}
+
+// solve for 'h' given 'A' in 'A = wh' for a rank-1 model, without masking or linking
+//  * every system is the scalar equation "(ww^T + L2) h_j = wA_j - L1", so "h" is one matrix-vector product "wA",
+//      clamped to zero (and to "upper_bound", if positive) and divided by "ww^T + L2", without the per-column
+//      systems, solvers and buffers of "predict"
+//  * returns the sum of "h", accumulated in the same pass by tiles, which is the scaling diagonal of "h" (see "scaleRank1")
+//  * if "loss" is given, it is set to the squared error of the updated model less "||A||^2"
+template <class T, typename Scalar>
+double predict_rank1(T&& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1,
+                     const double L2, const unsigned int threads, const double upper_bound = 0, double* loss = NULL) {
+    const double ww = w.template cast<double>().squaredNorm(), a = ww + L2 + TINY_NUM_FOR_STABILITY;
+    const int num_tiles = (h.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+    Eigen::ArrayXd sums = Eigen::ArrayXd::Zero(num_tiles), losses = Eigen::ArrayXd::Zero(num_tiles);
+    RcppML::forEach(num_tiles, threads, [&](const int tile) {
+        const int start = tile * PREDICT_TILE_SIZE;
+        const int tile_size = std::min(PREDICT_TILE_SIZE, (int)h.cols() - start);
+        double b[PREDICT_TILE_SIZE];
+        rank1Rhs(A, w, start, tile_size, b);
+        for (int j = 0; j < tile_size; ++j) {
+            double x = std::max((b[j] - L1) / a, 0.0);
+            if (upper_bound > 0) x = std::min(x, upper_bound);
+            h(0, start + j) = (Scalar)x;
+            sums(tile) += x;
+            losses(tile) += x * (x * ww - 2 * b[j]);
+        }
+    });
+    if (loss) *loss = losses.sum();
+    return sums.sum();
+}
+
+// scale the single row of "x" to sum to 1 given its sum, and return the correlation distance (see "cor") of the scaled
+//   "x" from "x_last", accumulated in the same pass, if "x_last" is given
+template <typename Scalar>
+double scaleRank1(Eigen::Matrix<Scalar, -1, -1>& x, const double sum, const Eigen::Matrix<Scalar, -1, -1>* x_last = NULL) {
+    const Scalar s = (Scalar)(1 / (sum + TINY_NUM));
+    double sum_x = 0, sum_y = 0, sum_xy = 0, sum_x2 = 0, sum_y2 = 0;
+    const unsigned int n = x.size();
+    for (unsigned int i = 0; i < n; ++i) {
+        x(i) *= s;
+        if (!x_last) continue;
+        const double x_i = x(i), y_i = (*x_last)(i);
+        sum_x += x_i;
+        sum_y += y_i;
+        sum_xy += x_i * y_i;
+        sum_x2 += x_i * x_i;
+        sum_y2 += y_i * y_i;
     }
+    if (!x_last) return 0;
+    return 1 - (n * sum_xy - sum_x * sum_y) / std::sqrt((n * sum_x2 - sum_x * sum_x) * (n * sum_y2 - sum_y * sum_y));
 }
 
 #endif
@@ -0,0 +1,311 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_profile
+#define RcppML_profile
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// PROFILING OF NMF FITS
+//
+// Wall time of each phase of each iteration, and counts of the work done, recorded only while a profiled fit is running:
+//  * coordinate descent solvers add the number of sweeps of each solve, and whether it stopped at its iteration limit,
+//      to process-wide counters (see "countSolve"). Counters are relaxed atomics that are added to once per solve rather
+//      than once per coordinate update, and without a profiled fit each solve tests a single flag.
+//  * phases are timed by "phaseTimer" in the functions that run them, so that every way of fitting a model that calls
+//      them is covered
+//  * counters are process-wide, so solves of other models fit at the same time are counted as well
+namespace RcppML {
+
+// number of profiled fits that are running
+inline std::atomic<int>& profiledFits() {
+    static std::atomic<int> n(0);
+    return n;
+}
+
+// coordinate descent sweeps over all solves, and solves that stopped at their iteration limit (usually "CD_MAXIT")
+struct cdCounters {
+    std::atomic<uint64_t> sweeps, maxit;
+    cdCounters() : sweeps(0), maxit(0) {}
+};
+
+inline cdCounters& cdCounts() {
+    static cdCounters counts;
+    return counts;
+}
+
+// record coordinate descent solves of "sweeps" sweeps in all, of which "at_maxit" stopped at their iteration limit
+inline void countSolve(const uint64_t sweeps, const unsigned int at_maxit) {
+    if (profiledFits().load(std::memory_order_relaxed) == 0) return;
+    cdCounts().sweeps.fetch_add(sweeps, std::memory_order_relaxed);
+    if (at_maxit > 0) cdCounts().maxit.fetch_add(at_maxit, std::memory_order_relaxed);
+}
+
+// MEMORY ACCOUNTING
+//
+// Bytes of large allocations of each subsystem, recorded only while an accounting scope is open (a profiled fit, see
+//   "memoryScope"), for sizing jobs and checking memory-saving modes rather than for tracking every allocation:
+//  * allocations are recorded where they are made (e.g. "t(A)" in "nmf::transposeA", buffers of each worker of
+//      "predict") by a "memoryLease" that holds their bytes for its lifetime, or by "trackBytes" for allocations that
+//      are handed to R and outlive the fit (results)
+//  * "peak" is the most bytes held at once by each subsystem, and by all subsystems together. "steady" is the bytes
+//      held at the end of the last iteration of a fit (see "fitProfile::endIteration"), which is what a fit holds
+//      between iterations.
+//  * accounts are process-wide and reset when the first scope opens, so allocations of other work at the same time
+//      are counted as well
+enum memory_subsystem { MEM_TRANSPOSE = 0,  // transposes of "A" and of masking matrices
+                        MEM_MASK = 1,       // masking matrices, hashed masks and merged mask indexes
+                        MEM_WORKSPACE = 2,  // buffers of each worker of "predict", "distance" and "dclust"
+                        MEM_RESTARTS = 3,   // working copies of models fit concurrently, and the best factors of each
+                        MEM_RESULT = 4,     // results returned to R
+                        MEM_CLUSTERS = 5,   // permutations, centers and bipartition models of "dclust"
+                        MEM_DISTANCE = 6,   // matrices of distances
+                        N_SUBSYSTEMS = 7 };
+
+class memoryAccounts {
+   public:
+    std::array<std::atomic<int64_t>, N_SUBSYSTEMS> current, peak, steady;
+    std::atomic<int64_t> total, total_peak;
+    std::atomic<int> scopes;
+
+    memoryAccounts() : total(0), total_peak(0), scopes(0) { reset(); }
+
+    void reset() {
+        for (int s = 0; s < N_SUBSYSTEMS; ++s) current[s] = peak[s] = steady[s] = 0;
+        total = total_peak = 0;
+    }
+
+    bool active() const { return scopes.load(std::memory_order_relaxed) > 0; }
+
+    // open a scope, resetting the accounts if no other scope is open, or close one
+    void open() {
+        if (scopes.fetch_add(1) == 0) reset();
+    }
+    void close() {
+        if (scopes.load() > 0) scopes.fetch_sub(1);
+    }
+
+    void add(const memory_subsystem s, const int64_t bytes) {
+        const int64_t held = current[s].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        const int64_t all = total.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        raise(peak[s], held);
+        raise(total_peak, all);
+    }
+
+    // record the bytes now held as those held between iterations
+    void markSteady() {
+        for (int s = 0; s < N_SUBSYSTEMS; ++s) steady[s] = current[s].load(std::memory_order_relaxed);
+    }
+
+   private:
+    static void raise(std::atomic<int64_t>& max, const int64_t value) {
+        int64_t m = max.load(std::memory_order_relaxed);
+        while (value > m && !max.compare_exchange_weak(m, value, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+inline memoryAccounts& memoryAccounting() {
+    static memoryAccounts accounts;
+    return accounts;
+}
+
+// record "bytes" allocated (or freed, if negative) by subsystem "s", if an accounting scope is open
+inline void trackBytes(const memory_subsystem s, const double bytes) {
+    if (memoryAccounting().active()) memoryAccounting().add(s, (int64_t)bytes);
+}
+
+// holds "bytes" of subsystem "s" for its lifetime, if an accounting scope was open when it was made
+class memoryLease {
+   public:
+    memoryLease(const memory_subsystem s, const double bytes) : s(s), bytes(memoryAccounting().active() ? (int64_t)bytes : 0) {
+        if (this->bytes != 0) memoryAccounting().add(s, this->bytes);
+    }
+    ~memoryLease() {
+        if (bytes != 0) memoryAccounting().add(s, -bytes);
+    }
+    memoryLease(const memoryLease&) = delete;
+    memoryLease& operator=(const memoryLease&) = delete;
+
+   private:
+    const memory_subsystem s;
+    const int64_t bytes;
+};
+
+// opens an accounting scope for its lifetime if "on", resetting the accounts if no other scope is open
+class memoryScope {
+   public:
+    memoryScope(const bool on) : on(on) {
+        if (on) memoryAccounting().open();
+    }
+    ~memoryScope() {
+        if (on) memoryAccounting().close();
+    }
+
+   private:
+    const bool on;
+};
+
+enum profile_phase { PHASE_H = 0,
+                     PHASE_W = 1,
+                     PHASE_TRANSPOSE = 2,
+                     PHASE_SCALE = 3,
+                     PHASE_MSE = 4,
+                     N_PHASES = 5 };
+
+// wall time of each phase, coordinate descent sweeps, solves that stopped at "CD_MAXIT", and values of "A" read in
+//   updates, in each iteration of a fit
+//  * time and values recorded after the last iteration (e.g. the final loss) are added to the last iteration
+class fitProfile {
+   public:
+    std::vector<std::array<double, N_PHASES> > seconds;
+    std::vector<double> sweeps, maxit, values;
+
+    void clear() {
+        seconds.clear();
+        sweeps.clear();
+        maxit.clear();
+        values.clear();
+        current.fill(0);
+        current_values = 0;
+        mark();
+    }
+
+    void add(const profile_phase phase, const double s) { current[phase] += s; }
+    void addValues(const double n) { current_values += n; }
+
+    // close the record of an iteration, and begin the next
+    void endIteration() {
+        memoryAccounting().markSteady();
+        seconds.push_back(current);
+        sweeps.push_back((double)(cdCounts().sweeps.load() - sweeps_0));
+        maxit.push_back((double)(cdCounts().maxit.load() - maxit_0));
+        values.push_back(current_values);
+        current.fill(0);
+        current_values = 0;
+        mark();
+    }
+
+    // add what was recorded after the last iteration to the last iteration
+    void flush() {
+        if (seconds.empty()) return;
+        for (int p = 0; p < N_PHASES; ++p) seconds.back()[p] += current[p];
+        sweeps.back() += (double)(cdCounts().sweeps.load() - sweeps_0);
+        maxit.back() += (double)(cdCounts().maxit.load() - maxit_0);
+        values.back() += current_values;
+        current.fill(0);
+        current_values = 0;
+        mark();
+    }
+
+   private:
+    std::array<double, N_PHASES> current = std::array<double, N_PHASES>();
+    double current_values = 0;
+    uint64_t sweeps_0 = 0, maxit_0 = 0;
+
+    void mark() {
+        sweeps_0 = cdCounts().sweeps.load();
+        maxit_0 = cdCounts().maxit.load();
+    }
+};
+
+// counts solves while it is in scope (see "countSolve")
+class profileScope {
+   public:
+    profileScope(const bool on) : on(on) {
+        if (on) ++profiledFits();
+    }
+    ~profileScope() {
+        if (on) --profiledFits();
+    }
+
+   private:
+    const bool on;
+};
+
+// adds the wall time of its scope to "phase" of "profile", unless "profile" is NULL
+class phaseTimer {
+   public:
+    phaseTimer(fitProfile* profile, const profile_phase phase) : profile(profile), phase(phase) {
+        if (profile) start = std::chrono::steady_clock::now();
+    }
+    ~phaseTimer() {
+        if (profile) profile->add(phase, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+   private:
+    fitProfile* profile;
+    const profile_phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+// HOT-PATH COUNTERS
+//
+// Work done inside least squares solvers and right-hand side gathers, compiled only if RCPPML_COUNTERS is non-zero:
+//  * "columns": systems solved, by "c_nnls", "c_bnnls", "nnls_lanes", "active_set", or "nnls2Batch"
+//  * "updates": coordinate updates that changed a variable, or exchanges of variables by "active_set"
+//  * "support": sum of the number of positive variables in each solution (the size of its passive set)
+//  * "flops": floating point operations in updates, exchanges, 2-variable solves, and gathers
+//  * "gathered": non-zeros of a sparse "A" gathered against "w" into right-hand sides "b = wA"
+// Counts are added to a thread-local "hotCounters" and merged into "hotTotals" as each thread leaves the parallel
+//   region of a "predict" (see "counterScope"), so nothing is shared in the solvers themselves. Counts made outside of
+//   "predict" are merged by the next "predict" to run on that thread.
+enum hot_counter { COUNT_COLUMNS = 0,
+                   COUNT_UPDATES = 1,
+                   COUNT_SUPPORT = 2,
+                   COUNT_FLOPS = 3,
+                   COUNT_GATHERED = 4,
+                   N_COUNTERS = 5 };
+
+struct hotCounters {
+    uint64_t n[N_COUNTERS] = {0};
+};
+
+inline hotCounters& threadCounters() {
+    static thread_local hotCounters counts;
+    return counts;
+}
+
+inline std::array<std::atomic<uint64_t>, N_COUNTERS>& hotTotals() {
+    // zero-initialized, as for all static storage
+    static std::array<std::atomic<uint64_t>, N_COUNTERS> totals;
+    return totals;
+}
+
+// add the counts of this thread to "hotTotals"
+inline void mergeCounters() {
+    hotCounters& counts = threadCounters();
+    for (int c = 0; c < N_COUNTERS; ++c) {
+        if (counts.n[c] > 0) hotTotals()[c].fetch_add(counts.n[c], std::memory_order_relaxed);
+        counts.n[c] = 0;
+    }
+}
+
+// merges the counts of this thread when it goes out of scope
+class counterScope {
+   public:
+    ~counterScope() { mergeCounters(); }
+};
+}  // namespace RcppML
+
+#if RCPPML_COUNTERS
+#define RCPPML_COUNT(counter, count) (RcppML::threadCounters().n[RcppML::counter] += (uint64_t)(count))
+#define RCPPML_COUNTER_SCOPE const RcppML::counterScope counter_scope
+#else
+#define RCPPML_COUNT(counter, count) ((void)0)
+#define RCPPML_COUNTER_SCOPE ((void)0)
+#endif
+
+#endif
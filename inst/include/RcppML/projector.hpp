@@ -0,0 +1,410 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2022 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_projector
+#define RcppML_projector
+
+#ifndef RcppML_nnls
+#include <RcppML/nnls.hpp>
+#endif
+
+#ifndef RcppML_modelfile
+#include <RcppML/modelfile.hpp>
+#endif
+
+#include <algorithm>
+
+namespace RcppML {
+
+// storage of "w" in a projector
+//  * "PROJECT_INT8" stores each factor as 8-bit integers scaled by its largest absolute value, in 1/8 the memory
+//  * "PROJECT_FLOAT16" stores each factor as half precision scaled by its largest absolute value, in 1/4 the memory
+enum projector_storage { PROJECT_DOUBLE = 0,
+                         PROJECT_INT8 = 1,
+                         PROJECT_FLOAT16 = 2 };
+
+// solve "ax = b - L1" for h.col(i), as in "predict", given the cholesky factorization of "a"
+//  * if "warm", the solve begins from h.col(i) (see "c_nnls_warm"), and with "skip_tol > 0", is skipped if h.col(i)
+//      already meets it (see "c_nnls_converged")
+template <typename Scalar>
+inline void projectColumn(Eigen::Matrix<Scalar, -1, -1>& a, const cholesky<Scalar>& a_llt, Eigen::Matrix<Scalar, -1, 1>& b,
+                          Eigen::Matrix<Scalar, -1, -1>& h, const unsigned int i, const double L1, const double upper_bound,
+                          const int solver, active_set<Scalar, -1>& as_solver, const bool warm = false, const double skip_tol = 0) {
+    if (L1 != 0) b.array() -= L1;
+    if (warm) {
+        c_nnls_warm(a, b, h, i, upper_bound);
+        if (skip_tol > 0 && c_nnls_converged(a, b, h, i, upper_bound, skip_tol)) return;
+    } else if (a_llt.success) {
+        c_nnls_init(a_llt, a, b, h, i, upper_bound);
+    }
+    if (upper_bound > 0)
+        bnnls(a, b, h, i, upper_bound, as_solver);
+    else if (useActiveSet(solver, a.rows()))
+        as_solver.solve(a, b, h, i);
+    else
+        c_nnls(a, b, h, i, CD_MAXIT, cd_tol<Scalar>(), solver);
+}
+
+// a factor model "w" prepared once for many projections onto small batches of new samples
+//  * "a = ww^T + L2" and its cholesky factorization are computed when the projector is constructed, so each projection
+//      only computes "b = wA.col(i) - L1" and solves the nnls system for each sample
+//  * unmasked projections only. Masked projections change "a" for each sample and should use "predict".
+//  * "solver" is the solver for systems without an upper bound (see "useActiveSet")
+//  * a quantized "w" (see "projector_storage") is read for every right-hand side, which is the bandwidth-bound part of
+//      a projection. "a" is computed from the dequantized "w", so systems are solved exactly for the stored model.
+//      Per-factor scales are applied once to each right-hand side rather than to each value gathered.
+//  * a projector of a model file (see "modelFile") reads "w" in place from the mapped file if it is not quantized and
+//      "Scalar" is double, and reads "ww^T" from the file if it was written, so loading a model copies nothing
+template <typename Scalar = double>
+class projector {
+   public:
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+
+    const double L1, L2, upper_bound;
+    const int solver, storage;
+
+    // "w" is factors (rows) by features (columns)
+    projector(const MatrixS& w, const double L1 = 0, const double L2 = 0, const double upper_bound = 0, const int solver = NNLS_AUTO,
+              const int storage = PROJECT_DOUBLE)
+        : L1(L1), L2(L2), upper_bound(upper_bound), solver(solver), storage(storage), n_features(w.cols()),
+          w_(storage == PROJECT_DOUBLE ? w : MatrixS()), w(w_.data(), w_.rows(), w_.cols()), a(gram(quantize(w))),
+          a_llt(regularize(a, L2)) {}
+
+    projector(const modelFile& file, const double L1 = 0, const double L2 = 0, const double upper_bound = 0,
+              const int solver = NNLS_AUTO, const int storage = PROJECT_DOUBLE)
+        : L1(L1), L2(L2), upper_bound(upper_bound), solver(solver), storage(storage), n_features(file.features),
+          mapping(inPlace(storage) ? file.data() : NULL),
+          w_(storage == PROJECT_DOUBLE && !mapping ? fileMatrix(file.w(), file.k, file.features) : MatrixS()),
+          w(mapping ? (const Scalar*)file.w() : w_.data(), mapping ? file.k : w_.rows(), mapping ? file.features : w_.cols()),
+          a(storage == PROJECT_DOUBLE && file.hasGram() ? fileMatrix(file.gram(), file.k, file.k)
+                                                        : gram(quantize(fileMatrix(file.w(), file.k, file.features)))),
+          a_llt(regularize(a, L2)) {}
+
+    // "w" may be a view of memory owned by this projector or its mapping, which copies would not share
+    projector(const projector&) = delete;
+    projector& operator=(const projector&) = delete;
+
+    unsigned int rank() const { return a.rows(); }
+    unsigned int features() const { return n_features; }
+
+    // relative Frobenius norm of the difference between the stored and the given "w", which is 0 unless quantized
+    double error() const { return quantization_error; }
+
+    // true if "w" is read in place from a mapped model file
+    bool mapped() const { return (bool)mapping; }
+
+    // bytes of "w" as stored
+    double bytes() const {
+        return storage == PROJECT_INT8 ? w_int8.size() : storage == PROJECT_FLOAT16 ? 2.0 * w_half.size() : sizeof(Scalar) * (double)w.size();
+    }
+
+    // solve for "h" in "A = wh"
+    //  * if "h_init" is given, each sample is solved from its column of "h_init", such as its solution for an earlier
+    //      "w", and with "skip_tol > 0", samples whose columns already meet it are kept (see "projectColumn")
+    Eigen::MatrixXd project(RcppML::SparseOf<double>& A, const unsigned int threads = 1, const Eigen::MatrixXd* h_init = NULL,
+                            const double skip_tol = 0) {
+        if (A.rows() != features()) RcppML::fail("number of rows in 'data' is not equal to the number of features in the projector");
+        MatrixS h = initialH(A.cols(), h_init);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (A.cols() > 1)
+#endif
+        {
+            VectorS b(rank());
+            active_set<Scalar, -1> as_solver(rank());
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (unsigned int i = 0; i < A.cols(); ++i) projectSample(A, i, b, h, i, as_solver, h_init != NULL, skip_tol);
+        }
+        return h.template cast<double>();
+    }
+
+    Eigen::MatrixXd project(const Eigen::MatrixXd& A, const unsigned int threads = 1, const Eigen::MatrixXd* h_init = NULL,
+                            const double skip_tol = 0) {
+        if (A.rows() != features()) RcppML::fail("number of rows in 'data' is not equal to the number of features in the projector");
+        MatrixS h = initialH(A.cols(), h_init);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (A.cols() > 1)
+#endif
+        {
+            VectorS b(rank());
+            active_set<Scalar, -1> as_solver(rank());
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (unsigned int i = 0; i < A.cols(); ++i) projectSample(A, i, b, h, i, as_solver, h_init != NULL, skip_tol);
+        }
+        return h.template cast<double>();
+    }
+
+    // solve for "h" of one sample given by the rows "i" (counted from "base") and values "x" of its "nnz" non-zeros, for
+    //   queries of one sample at a time that should not build a sparse matrix around it
+    //  * the sample is solved on the calling thread from the shared factorization of "a", like any column of "project"
+    Eigen::VectorXd project(const int* i, const double* x, const unsigned int nnz, const int base = 0) {
+        VectorS b = VectorS::Zero(rank());
+        MatrixS h = MatrixS::Zero(rank(), 1);
+        for (unsigned int j = 0; j < nnz; ++j)
+            if (i[j] < base || (unsigned int)(i[j] - base) >= features())
+                RcppML::fail("row indices of the sample are not within the features of the projector");
+        if (nnz == 0) return Eigen::VectorXd::Zero(rank());
+        gather(nnz, [&](const unsigned int j) { return i[j] - base; }, [&](const unsigned int j) { return x[j]; }, b);
+        active_set<Scalar, -1> as_solver(rank());
+        solve(b, h, 0, as_solver, false, 0);
+        return h.col(0).template cast<double>();
+    }
+
+    // solve for "h" of each matrix in a batch of matrices of the same features, such as one matrix for each donor
+    //  * samples of all matrices are projected in one parallel loop, so that a batch of many small matrices starts one
+    //      team of threads and shares one "a", rather than paying for both with each matrix
+    //  * "A" is "SparseOf<double>" or "Eigen::MatrixXd" (or a map of one)
+    template <class Matrix>
+    std::vector<Eigen::MatrixXd> project(std::vector<Matrix>& A, const unsigned int threads = 1) {
+        std::vector<int> offsets(1, 0);  // first sample of each matrix in the batch
+        std::vector<MatrixS> h;
+        for (Matrix& A_m : A) {
+            if ((unsigned int)A_m.rows() != features())
+                RcppML::fail("number of rows in each matrix of 'data' is not equal to the number of features in the projector");
+            offsets.push_back(offsets.back() + A_m.cols());
+            h.push_back(MatrixS(rank(), A_m.cols()));
+        }
+        const int n = offsets.back();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (n > 1)
+#endif
+        {
+            VectorS b(rank());
+            active_set<Scalar, -1> as_solver(rank());
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int j = 0; j < n; ++j) {
+                const int m = std::upper_bound(offsets.begin(), offsets.end(), j) - offsets.begin() - 1, i = j - offsets[m];
+                projectSample(A[m], i, b, h[m], i, as_solver);
+            }
+        }
+        std::vector<Eigen::MatrixXd> h_d;
+        for (const MatrixS& h_m : h) h_d.push_back(h_m.template cast<double>());
+        return h_d;
+    }
+
+   private:
+    const unsigned int n_features;
+    const std::shared_ptr<const char> mapping;  // model file from which "w" is read in place, if any
+    const MatrixS w_;                            // "w" unless it is quantized or read in place
+    const Eigen::Map<const MatrixS> w;           // empty if quantized
+    Eigen::Matrix<int8_t, -1, -1> w_int8;
+    Eigen::Matrix<Eigen::half, -1, -1> w_half;
+    VectorS scale;  // of each factor in a quantized "w"
+    double quantization_error = 0;
+    MatrixS a;
+    const cholesky<Scalar> a_llt;
+
+    // store "w" as "storage" and return its dequantized values, from which "a" is computed
+    MatrixS quantize(const MatrixS& w_) {
+        if (storage == PROJECT_DOUBLE) return w_;
+        scale = w_.cwiseAbs().rowwise().maxCoeff();
+        for (int f = 0; f < scale.size(); ++f)
+            if (scale(f) == 0) scale(f) = 1;
+        MatrixS deq;
+        if (storage == PROJECT_INT8) {
+            scale /= 127;
+            w_int8 = (scale.cwiseInverse().asDiagonal() * w_).array().round().template cast<int8_t>();
+            deq = scale.asDiagonal() * w_int8.template cast<Scalar>();
+        } else {
+            w_half = (scale.cwiseInverse().asDiagonal() * w_).template cast<Eigen::half>();
+            deq = scale.asDiagonal() * w_half.template cast<Scalar>();
+        }
+        const double norm = w_.template cast<double>().norm();
+        quantization_error = norm > 0 ? (w_ - deq).template cast<double>().norm() / norm : 0;
+        return deq;
+    }
+
+    static bool inPlace(const int storage) { return storage == PROJECT_DOUBLE && std::is_same<Scalar, double>::value; }
+
+    static MatrixS fileMatrix(const double* x, const unsigned int rows, const unsigned int cols) {
+        return Eigen::Map<const Eigen::MatrixXd>(x, rows, cols).template cast<Scalar>();
+    }
+
+    // add the L2 penalty to the diagonal of "a" before it is factorized
+    static MatrixS& regularize(MatrixS& a, const double L2) {
+        a.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+        return a;
+    }
+
+    // "h" of "n" samples, from "h_init" if given
+    MatrixS initialH(const unsigned int n, const Eigen::MatrixXd* h_init) const {
+        if (!h_init) return MatrixS(rank(), n);
+        if ((unsigned int)h_init->rows() != rank() || (unsigned int)h_init->cols() != n)
+            RcppML::fail("dimensions of 'h_init' must be the rank of the projector by the number of samples in 'data'");
+        return h_init->template cast<Scalar>();
+    }
+
+    void solve(VectorS& b, MatrixS& h, const unsigned int i, active_set<Scalar, -1>& as_solver, const bool warm, const double skip_tol) {
+        projectColumn(a, a_llt, b, h, i, L1, upper_bound, solver, as_solver, warm, skip_tol);
+    }
+
+    // right-hand side "b" of a sample of "n" non-zeros, the "j"th of which is "value(j)" at feature "row(j)", gathered
+    //   from "w" in the precision in which it is stored and then scaled by the per-factor scales of quantized storage
+    template <class Row, class Value>
+    void gather(const unsigned int n, Row row, Value value, VectorS& b) const {
+        b.setZero();
+        if (storage == PROJECT_INT8) {
+            for (unsigned int j = 0; j < n; ++j) b += (Scalar)value(j) * w_int8.col(row(j)).template cast<Scalar>();
+        } else if (storage == PROJECT_FLOAT16) {
+            for (unsigned int j = 0; j < n; ++j) b += (Scalar)value(j) * w_half.col(row(j)).template cast<Scalar>();
+        } else {
+            for (unsigned int j = 0; j < n; ++j) b += (Scalar)value(j) * w.col(row(j));
+        }
+        if (storage != PROJECT_DOUBLE) b.array() *= scale.array();
+    }
+
+    // solve column "i" of "A" into column "col" of "h", from its value in "h" if "warm"
+    void projectSample(RcppML::SparseOf<double>& A, const unsigned int i, VectorS& b, MatrixS& h, const unsigned int col,
+                       active_set<Scalar, -1>& as_solver, const bool warm = false, const double skip_tol = 0) {
+        if (!warm || A.p[i] == A.p[i + 1]) h.col(col).setZero();
+        if (A.p[i] == A.p[i + 1]) return;
+        const int begin = A.p[i];
+        gather(A.p[i + 1] - begin, [&](const unsigned int j) { return (int)A.i[begin + j]; }, [&](const unsigned int j) { return (double)A.x[begin + j]; }, b);
+        solve(b, h, col, as_solver, warm, skip_tol);
+    }
+
+    template <class Derived>
+    void projectSample(const Eigen::MatrixBase<Derived>& A, const unsigned int i, VectorS& b, MatrixS& h, const unsigned int col,
+                       active_set<Scalar, -1>& as_solver, const bool warm = false, const double skip_tol = 0) {
+        if (!warm) h.col(col).setZero();
+        if (storage == PROJECT_DOUBLE) {
+            b.noalias() = w * A.col(i).template cast<Scalar>();
+        } else {
+            b.setZero();
+            for (unsigned int j = 0; j < features(); ++j) {
+                if (A(j, i) == 0) continue;
+                if (storage == PROJECT_INT8)
+                    b += (Scalar)A(j, i) * w_int8.col(j).template cast<Scalar>();
+                else
+                    b += (Scalar)A(j, i) * w_half.col(j).template cast<Scalar>();
+            }
+            b.array() *= scale.array();
+        }
+        solve(b, h, col, as_solver, warm, skip_tol);
+    }
+};
+
+// projections of many factor models of the same features onto the same samples, in one pass over the samples
+//  * "w" of all models are stacked into one matrix, so each non-zero of "A" is read once to gather the right-hand
+//      sides of all models, rather than once for each model
+//  * the systems of each model are then solved with its own "a = ww^T + L2" (see "projectColumn")
+template <typename Scalar = double>
+class stacked_projector {
+   public:
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+
+    const double L1, L2, upper_bound;
+    const int solver;
+
+    // each "w" is factors (rows) by features (columns)
+    stacked_projector(const std::vector<MatrixS>& w, const double L1 = 0, const double L2 = 0, const double upper_bound = 0,
+                      const int solver = NNLS_AUTO)
+        : L1(L1), L2(L2), upper_bound(upper_bound), solver(solver), offsets(1, 0) {
+        if (w.empty()) RcppML::fail("no models were given to project");
+        for (const MatrixS& w_m : w) {
+            if (w_m.cols() != w[0].cols()) RcppML::fail("all models must have the same number of features");
+            offsets.push_back(offsets.back() + w_m.rows());
+            MatrixS a_m = gram(w_m);
+            a_m.diagonal().array() += L2 + TINY_NUM_FOR_STABILITY;
+            a.push_back(a_m);
+            a_llt.push_back(cholesky<Scalar>(a_m));
+        }
+        w_stacked = MatrixS(offsets.back(), w[0].cols());
+        for (unsigned int m = 0; m < w.size(); ++m) w_stacked.middleRows(offsets[m], w[m].rows()) = w[m];
+    }
+
+    unsigned int models() const { return a.size(); }
+    unsigned int features() const { return w_stacked.cols(); }
+
+    // solve for "h" of each model in "A = wh"
+    std::vector<Eigen::MatrixXd> project(RcppML::SparseOf<double>& A, const unsigned int threads = 1) {
+        if (A.rows() != features()) RcppML::fail("number of rows in 'data' is not equal to the number of features in the models");
+        std::vector<MatrixS> h = allocate(A.cols());
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (A.cols() > 1)
+#endif
+        {
+            VectorS b(w_stacked.rows());
+            std::vector<active_set<Scalar, -1>> as_solvers = solvers();
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (unsigned int i = 0; i < A.cols(); ++i) {
+                b.setZero();
+                for (RcppML::SparseOf<double>::InnerIterator it(A, i); it; ++it)
+                    b += (Scalar)it.value() * w_stacked.col(it.row());
+                solve(b, h, i, A.p[i] == A.p[i + 1], as_solvers);
+            }
+        }
+        return cast(h);
+    }
+
+    std::vector<Eigen::MatrixXd> project(const Eigen::MatrixXd& A, const unsigned int threads = 1) {
+        if (A.rows() != features()) RcppML::fail("number of rows in 'data' is not equal to the number of features in the models");
+        std::vector<MatrixS> h = allocate(A.cols());
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) if (A.cols() > 1)
+#endif
+        {
+            VectorS b(w_stacked.rows());
+            std::vector<active_set<Scalar, -1>> as_solvers = solvers();
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (unsigned int i = 0; i < A.cols(); ++i) {
+                b.noalias() = w_stacked * A.col(i).template cast<Scalar>();
+                solve(b, h, i, false, as_solvers);
+            }
+        }
+        return cast(h);
+    }
+
+   private:
+    MatrixS w_stacked;
+    std::vector<int> offsets;  // first row of each model in "w_stacked"
+    std::vector<MatrixS> a;
+    std::vector<cholesky<Scalar>> a_llt;
+
+    std::vector<MatrixS> allocate(const int n) const {
+        std::vector<MatrixS> h;
+        for (unsigned int m = 0; m < models(); ++m) h.push_back(MatrixS::Zero(a[m].rows(), n));
+        return h;
+    }
+
+    std::vector<active_set<Scalar, -1>> solvers() const {
+        std::vector<active_set<Scalar, -1>> s;
+        for (unsigned int m = 0; m < models(); ++m) s.push_back(active_set<Scalar, -1>(a[m].rows()));
+        return s;
+    }
+
+    // solve column "i" of each model from its rows of the stacked right-hand side
+    void solve(VectorS& b, std::vector<MatrixS>& h, const unsigned int i, const bool empty,
+               std::vector<active_set<Scalar, -1>>& as_solvers) {
+        if (empty) return;
+        for (unsigned int m = 0; m < models(); ++m) {
+            VectorS b_m = b.segment(offsets[m], a[m].rows());
+            projectColumn(a[m], a_llt[m], b_m, h[m], i, L1, upper_bound, solver, as_solvers[m]);
+        }
+    }
+
+    static std::vector<Eigen::MatrixXd> cast(const std::vector<MatrixS>& h) {
+        std::vector<Eigen::MatrixXd> h_d;
+        for (const MatrixS& h_m : h) h_d.push_back(h_m.template cast<double>());
+        return h_d;
+    }
+};
+
+}  // namespace RcppML
+
+#endif
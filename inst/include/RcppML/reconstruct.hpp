@@ -0,0 +1,127 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_reconstruct
+#define RcppML_reconstruct
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <vector>
+
+namespace RcppML {
+
+// RECONSTRUCTION OF FACTOR MODELS
+//
+// "wdh" evaluated only where it is needed, rather than as a dense matrix of all features by all samples
+//  * "wd" is "w" scaled by "d", with factors in rows (as in "mse_models"), and "h" is factors by samples
+//  * at the non-zeros of a sparse pattern (e.g. "A" or a masking matrix), one dot product of rank "k" per entry, or as
+//      residuals of "A" at its non-zeros
+//  * on subsets of features and samples, as the product of the gathered columns of "wd" and "h"
+//  * by tiles of consecutive samples of a subset, each passed to a callback and then discarded
+
+// values of "wdh" at the non-zeros of "pattern", in the order of its non-zeros, written to "x"
+inline void reconstructPattern(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, RcppML::SparseOf<double>& pattern, double* x,
+                               const unsigned int threads) {
+    if (pattern.rows() != wd.cols() || pattern.cols() != h.cols()) RcppML::fail("dimensions of the pattern and the model are not identical");
+    const std::vector<int>& chunks = pattern.colChunks(PREDICT_TILE_SIZE);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int chunk = 0; chunk < (int)chunks.size() - 1; ++chunk) {
+        for (int j = chunks[chunk]; j < chunks[chunk + 1]; ++j) {
+            int k = pattern.p[j];
+            for (RcppML::SparseOf<double>::InnerIterator it(pattern, j); it; ++it, ++k)
+                x[k] = wd.col(it.row()).dot(h.col(j));
+        }
+    }
+}
+
+// residuals "A - wdh" at the non-zeros of "A", in the order of its non-zeros, written to "x", with the Euclidean norms
+//   of the residuals of each row and column over the non-zeros
+//  * residuals and column norms are found in one parallel pass over "A", and row norms in a second pass over "x"
+//      in order, so that all results are independent of the number of threads
+struct residualNorms {
+    Eigen::VectorXd rows, cols;
+};
+
+inline residualNorms reconstructResiduals(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, RcppML::SparseOf<double>& A, double* x,
+                                          const unsigned int threads) {
+    if (A.rows() != wd.cols() || A.cols() != h.cols()) RcppML::fail("dimensions of 'A' and the model are not identical");
+    residualNorms norms;
+    norms.rows = Eigen::VectorXd::Zero(A.rows());
+    norms.cols = Eigen::VectorXd::Zero(A.cols());
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int chunk = 0; chunk < (int)chunks.size() - 1; ++chunk) {
+        for (int j = chunks[chunk]; j < chunks[chunk + 1]; ++j) {
+            int k = A.p[j];
+            for (RcppML::SparseOf<double>::InnerIterator it(A, j); it; ++it, ++k) {
+                x[k] = it.value() - wd.col(it.row()).dot(h.col(j));
+                norms.cols(j) += x[k] * x[k];
+            }
+        }
+    }
+    for (unsigned int j = 0; j < A.cols(); ++j) {
+        int k = A.p[j];
+        for (RcppML::SparseOf<double>::InnerIterator it(A, j); it; ++it, ++k) norms.rows(it.row()) += x[k] * x[k];
+    }
+    norms.rows = norms.rows.cwiseSqrt();
+    norms.cols = norms.cols.cwiseSqrt();
+    return norms;
+}
+
+// columns "cols" of "x" in a new matrix
+inline Eigen::MatrixXd gatherColumns(const Eigen::MatrixXd& x, const std::vector<int>& cols) {
+    Eigen::MatrixXd x_(x.rows(), cols.size());
+    for (size_t j = 0; j < cols.size(); ++j) {
+        if (cols[j] < 0 || cols[j] >= x.cols()) RcppML::fail("indices of features or samples are out of range");
+        x_.col(j) = x.col(cols[j]);
+    }
+    return x_;
+}
+
+// "wdh" at features "rows" and samples "cols" (0-based), given the gathered "wd_rows = wd[, rows]"
+inline Eigen::MatrixXd reconstructTile(const Eigen::MatrixXd& wd_rows, const Eigen::MatrixXd& h, const std::vector<int>& cols,
+                                       const unsigned int threads) {
+    const Eigen::MatrixXd h_cols = gatherColumns(h, cols);
+    Eigen::MatrixXd tile(wd_rows.cols(), h_cols.cols());
+    const int n_blocks = (h_cols.cols() + PREDICT_TILE_SIZE - 1) / PREDICT_TILE_SIZE;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int b = 0; b < n_blocks; ++b) {
+        const int start = b * PREDICT_TILE_SIZE, n = std::min((int)PREDICT_TILE_SIZE, (int)h_cols.cols() - start);
+        tile.middleCols(start, n).noalias() = wd_rows.transpose() * h_cols.middleCols(start, n);
+    }
+    return tile;
+}
+
+inline Eigen::MatrixXd reconstructSubset(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows,
+                                         const std::vector<int>& cols, const unsigned int threads) {
+    return reconstructTile(gatherColumns(wd, rows), h, cols, threads);
+}
+
+// pass "wdh" at features "rows" and samples "cols" to "f(tile, start)" in tiles of "tile_size" samples, where "start"
+//   is the index in "cols" of the first sample in the tile
+template <typename F>
+inline void reconstructTiles(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows,
+                             const std::vector<int>& cols, const unsigned int tile_size, const unsigned int threads, F f) {
+    if (tile_size == 0) RcppML::fail("'tile_size' must be positive");
+    const Eigen::MatrixXd wd_rows = gatherColumns(wd, rows);
+    for (size_t start = 0; start < cols.size(); start += tile_size) {
+        const std::vector<int> tile_cols(cols.begin() + start, cols.begin() + std::min(cols.size(), start + tile_size));
+        f(reconstructTile(wd_rows, h, tile_cols, threads), (int)start);
+    }
+}
+
+}  // namespace RcppML
+
+#endif
@@ -12,20 +12,53 @@
 #include <RcppMLCommon.hpp>
 #endif
 
+#include <numeric>
+#include <unordered_map>
+
 namespace RcppML {
 template <bool transpose_identical>
 class rng {
    public:
     rng(uint32_t state) : state(state){};
 
-    inline uint32_t rand(uint32_t i, uint32_t j) {
+    inline uint32_t rand(uint32_t i, uint32_t j) const {
         // enforce transpose-identity
         if (transpose_identical) {
             if (j >= i) {
                 std::swap(i, j);
             }
         }
+        return hash(i, j);
+    }
+
+    template <typename T>
+    inline T sample(uint32_t i, uint32_t j, const T max) const {
+        return rand(i, j) % max;
+    }
+
+    template <typename T>
+    inline T runif(uint32_t i, uint32_t j) const {
+        return uniform<T>(rand(i, j));
+    }
+
+    // "runif<T>(i, j)" for "n" consecutive rows "i" from "i_start" in column "j", written to "out", e.g. a column of a
+    //   column-major matrix. Values are independent and computed without branches, so that the loop is vectorized, at
+    //   the widest vectors of the CPU (see "RCPPML_TARGET_CLONES"). Integer hashes and exact conversions give identical
+    //   values for any vector width.
+    template <typename T, typename Out>
+    RCPPML_TARGET_CLONES void runif(Out* out, const uint32_t i_start, const uint32_t n, const uint32_t j) const {
+        RCPPML_PRAGMA_SIMD
+        for (uint32_t k = 0; k < n; ++k) {
+            const uint32_t i = i_start + k;
+            // enforce transpose-identity, as in "rand"
+            const uint32_t a = (transpose_identical && j >= i) ? j : i;
+            const uint32_t b = (transpose_identical && j >= i) ? i : j;
+            out[k] = (Out)uniform<T>(hash(a, b));
+        }
+    }
 
+   private:
+    inline uint32_t hash(const uint32_t i, const uint32_t j) const {
         // generate a unique hash of i and j, using (max(i, j))(max(i, j) + 1) / 2 + min(i, j)
         // https://math.stackexchange.com/questions/882877/produce-unique-number-given-two-integers
         // credit to user @JimmyK4542, and whoever published the original intuition
@@ -47,52 +80,241 @@ class rng {
         return (uint32_t)((s + ij));
     }
 
+    // uniform value in [0, 1) from a random integer, as "(T)x / UINT32_MAX" less its integer part, without branches
+    //  * "x" is converted from two exact 16-bit halves, which are signed integers, since most vector instruction sets
+    //     convert only signed integers. The sum is rounded once, and so is identical to "(T)x".
+    //  * the integer part of a value in [0, 1] is found by truncation rather than "std::floor"
     template <typename T>
-    inline T sample(uint32_t i, uint32_t j, const T max) {
-        return rand(i, j) % max;
-    }
-
-    template <typename T>
-    inline T runif(uint32_t i, uint32_t j) {
-        T y = (T)rand(i, j) / UINT32_MAX;
-        return y - std::floor(y);
+    static inline T uniform(const uint32_t x) {
+        const T y = ((T)(int32_t)(x >> 16) * 65536 + (T)(int32_t)(x & 0xffff)) / UINT32_MAX;
+        return y - (T)(int32_t)y;
     }
 
-   private:
     const uint32_t state;
 };
-}  // namespace RcppML
 
-template <typename T>
-Eigen::Matrix<T, -1, -1> rti_matrix(uint32_t nrow, uint32_t ncol, uint32_t rng) {
-    Eigen::Matrix<T, -1, -1> m(nrow, ncol);
-    RcppML::rng<true> s(rng);
+// the finalizer of MurmurHash3, a bijection in which every bit of the result depends on every bit of "x". Hashes of
+//   neighboring counters by "rng" are not independent enough for draws that combine several of them, such as
+//   geometric gaps, rejection sampling or shuffling, and are scrambled first.
+inline uint32_t scramble(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+// positions in "[start, end)" at which trials succeed with "probability", appended to "positions" in increasing order.
+//   Rather than testing each trial, a geometric number of failures is skipped between successes, so time is
+//   proportional to the number of successes. The "t"-th gap of "stream" is drawn from "scramble(s.rand(stream, t))",
+//   so the positions of each stream from a given "start" do not depend on "end".
+inline void skipSample(const rng<false>& s, const uint32_t stream, uint64_t start, const uint64_t end, const double probability,
+                       std::vector<uint32_t>& positions) {
+    if (probability >= 1) {
+        for (; start < end; ++start) positions.push_back(start);
+        return;
+    }
+    if (probability <= 0) return;
+    const double log_q = std::log1p(-probability);
+    for (uint32_t t = 0; start < end; ++t) {
+        const double u = (scramble(s.rand(stream, t)) + 0.5) / 4294967296.0;  // in (0, 1)
+        const double gap = std::floor(std::log(u) / log_q);
+        if (gap >= (double)(end - start)) return;
+        start += (uint64_t)gap;
+        positions.push_back(start++);
+    }
+}
+
+// trials that succeed with probability "1 / inv_probability"
+inline void skipSample(const rng<false>& s, const uint32_t stream, const uint64_t start, const uint64_t end, const uint32_t inv_probability,
+                       std::vector<uint32_t>& positions) {
+    skipSample(s, stream, start, end, 1.0 / inv_probability, positions);
+}
 
-    // symmetric part first
-    uint32_t n_sym = (nrow < ncol) ? nrow : ncol;
+// number of successes in "size" trials that succeed with "probability", drawn directly from the binomial distribution
+//   rather than by testing each trial. The "t"-th uniform value of a draw for "stream" is "s.rand(stream, start + t)",
+//   scrambled (see "scramble") so that pairs of uniform values used in rejection sampling are independent.
+//  * for fewer than 30 expected successes (or failures), by inversion: a uniform value is compared to the cumulative
+//     distribution function, which is summed from 0 by the recurrence of binomial probabilities
+//  * otherwise by the BTPE algorithm of Kachitvichyanukul and Schmeiser (1988), "Binomial random variate generation",
+//     Communications of the ACM 31(2), a rejection sampler with a triangular, two parallelogram and two exponential
+//     regions, that takes a constant expected number of uniform values
+inline uint32_t binomialSample(const rng<false>& s, const uint32_t stream, uint32_t start, const uint32_t size, const double probability) {
+    if (probability >= 1) return size;
+    if (probability <= 0 || size == 0) return 0;
+    auto u = [&]() { return (scramble(s.rand(stream, start++)) + 0.5) / 4294967296.0; };  // in (0, 1)
 
-    for (uint32_t i = 0; i < n_sym; ++i) {
-        for (uint32_t j = (i + 1); j < n_sym; ++j) {
-            T tmp = s.runif<T>(i, j);
-            m(i, j) = tmp;
-            m(j, i) = tmp;
+    // count the rarer outcome
+    const double r = std::min(probability, 1 - probability), q = 1 - r, n = size;
+    const double nr = n * r;
+    double y;
+    if (nr < 30) {
+        const double s_ratio = r / q, a = (n + 1) * s_ratio, q_n = std::exp(n * std::log(q));
+        const double bound = std::min(n, nr + 10 * std::sqrt(nr * q + 1));
+        do {
+            double v = u(), px = q_n;
+            y = 0;
+            while (v > px && y <= bound) {
+                v -= px;
+                ++y;
+                px *= a / y - s_ratio;
+            }
+        } while (y > bound);
+    } else {
+        const double nrq = nr * q, fm = nr + r, m = std::floor(fm);
+        const double p1 = std::floor(2.195 * std::sqrt(nrq) - 4.6 * q) + 0.5;
+        const double xm = m + 0.5, xl = xm - p1, xr = xm + p1, c = 0.134 + 20.5 / (15.3 + m);
+        double a = (fm - xl) / (fm - xl * r);
+        const double lambda_l = a * (1 + a / 2);
+        a = (xr - fm) / (xr * q);
+        const double lambda_r = a * (1 + a / 2);
+        const double p2 = p1 * (1 + 2 * c), p3 = p2 + c / lambda_l, p4 = p3 + c / lambda_r;
+        for (;;) {
+            const double w = u() * p4;
+            double v = u();
+            if (w <= p1) {
+                // triangular region, accepted immediately
+                y = std::floor(xm - p1 * v + w);
+                break;
+            }
+            if (w <= p2) {
+                // parallelograms
+                const double x = xl + (w - p1) / c;
+                v = v * c + 1 - std::abs(m - x + 0.5) / p1;
+                if (v > 1) continue;
+                y = std::floor(x);
+            } else if (w <= p3) {
+                // left exponential tail
+                y = std::floor(xl + std::log(v) / lambda_l);
+                if (y < 0) continue;
+                v *= (w - p2) * lambda_l;
+            } else {
+                // right exponential tail
+                y = std::floor(xr - std::log(v) / lambda_r);
+                if (y > n) continue;
+                v *= (w - p3) * lambda_r;
+            }
+
+            const double k = std::abs(y - m);
+            if (k <= 20 || k >= nrq / 2 - 1) {
+                // explicit ratio of binomial probabilities at "y" and at the mode
+                const double s_ratio = r / q, a_ratio = s_ratio * (n + 1);
+                double f = 1;
+                if (m < y)
+                    for (double i = m + 1; i <= y; ++i) f *= a_ratio / i - s_ratio;
+                else
+                    for (double i = y + 1; i <= m; ++i) f /= a_ratio / i - s_ratio;
+                if (v <= f) break;
+                continue;
+            }
+
+            // squeeze, then the log ratio by Stirling's approximation
+            const double rho = (k / nrq) * ((k * (k / 3 + 0.625) + 1.0 / 6) / nrq + 0.5), t = -k * k / (2 * nrq);
+            const double log_v = std::log(v);
+            if (log_v < t - rho) break;
+            if (log_v > t + rho) continue;
+            const double x1 = y + 1, f1 = m + 1, z = n + 1 - m, w1 = n - y + 1;
+            auto stirling = [](const double x) {
+                const double x2 = x * x;
+                return (13860 - (462 - (132 - (99 - 140 / x2) / x2) / x2) / x2) / x / 166320;
+            };
+            if (log_v <= xm * std::log(f1 / x1) + (n - m + 0.5) * std::log(z / w1) + (y - m) * std::log(w1 * r / (x1 * q)) +
+                             stirling(f1) + stirling(z) + stirling(x1) + stirling(w1))
+                break;
         }
     }
+    return (uint32_t)(probability > 0.5 ? n - y : y);
+}
 
-    // populate the diagonal of the symmetric part
-    for (uint32_t i = 0; i < n_sym; ++i)
-        m(i, i) = s.runif<T>(i, i);
+// "size" distinct indices in "[0, n)" drawn by a partial Fisher-Yates shuffle, in which the "i"-th index is swapped with
+//   the index at "i + scramble(s.rand(i, stream)) % (n - i)". When "size" is much less than "n", only indices that have been
+//   displaced by a swap are stored, in a hash map, so that memory is proportional to "size" rather than to "n". Results
+//   are identical either way.
+inline std::vector<uint32_t> sampleWithoutReplacement(const rng<false>& s, const uint32_t stream, const uint32_t n, const uint32_t size) {
+    std::vector<uint32_t> result;
+    if ((uint64_t)size * 16 >= n) {
+        result.resize(n);
+        std::iota(result.begin(), result.end(), 0);
+        for (uint32_t i = 0; i < size; ++i) std::swap(result[i], result[i + scramble(s.rand(i, stream)) % (n - i)]);
+        result.resize(size);
+        return result;
+    }
+    result.resize(size);
+    std::unordered_map<uint32_t, uint32_t> displaced(2 * (size_t)size);
+    for (uint32_t i = 0; i < size; ++i) {
+        const uint32_t j = i + scramble(s.rand(i, stream)) % (n - i);
+        const auto at_i = displaced.find(i), at_j = displaced.find(j);
+        const uint32_t index_i = at_i == displaced.end() ? i : at_i->second;
+        result[i] = at_j == displaced.end() ? j : at_j->second;
+        // position "i" is never drawn again, so only position "j" needs to remember what it now holds
+        displaced[j] = index_i;
+    }
+    return result;
+}
+
+// multiplicities of "n" columns in bootstrap replicate "replicate", each drawn independently from Poisson(1) by the
+//   inverse of its distribution function at a hash of the replicate and column (the Poisson bootstrap), so that
+//   replicates are weights on the columns rather than resampled copies of them
+template <typename T>
+Eigen::Matrix<T, -1, 1> bootstrapWeights(const uint32_t seed, const uint32_t replicate, const uint32_t n) {
+    rng<false> s(seed);
+    Eigen::Matrix<T, -1, 1> c(n);
+    for (uint32_t j = 0; j < n; ++j) {
+        const double u = s.template runif<double>(replicate, j);
+        double p = std::exp(-1.0), cdf = p;
+        unsigned int k = 0;
+        while (u > cdf && k < 32) {
+            p /= ++k;
+            cdf += p;
+        }
+        c(j) = (T)k;
+    }
+    return c;
+}
 
-    // asymmetric part (but still transpose-identical)
-    if (nrow > ncol)
-        for (uint32_t i = n_sym; i < nrow; ++i)
-            for (uint32_t j = 0; j < ncol; ++j)
-                m(i, j) = s.runif<T>(i, j);
-    else if (ncol > nrow)
-        for (uint32_t i = 0; i < nrow; ++i)
-            for (uint32_t j = n_sym; j < ncol; ++j)
-                m(i, j) = s.runif<T>(i, j);
+// a masking matrix in which each value is masked with probability "1 / inv_probability", decided by a hash of its row
+//   and column (see "rng") wherever it is needed, rather than stored
+//  * "transpose()" is the same mask of the transposed matrix, with rows and columns swapped in the hash
+//  * "complement()" masks exactly the values that this mask does not, e.g. to fit on a test set
+class hash_mask {
+   public:
+    hash_mask(const uint32_t seed = 0, const uint32_t inv_probability = 1) : seed(seed), inv_probability(inv_probability) {
+        if (inv_probability == 0) RcppML::fail("'inv_probability' of a hashed mask must be positive");
+    }
+
+    // true if the value at "row" and "col" is masked
+    inline bool operator()(const uint32_t row, const uint32_t col) const {
+        rng<false> s(seed);
+        const bool masked = (transposed ? s.sample(col, row, inv_probability) : s.sample(row, col, inv_probability)) == 0;
+        return masked != complemented;
+    }
 
+    hash_mask transpose() const {
+        hash_mask m(*this);
+        m.transposed = !transposed;
+        return m;
+    }
+
+    hash_mask complement() const {
+        hash_mask m(*this);
+        m.complemented = !complemented;
+        return m;
+    }
+
+   private:
+    uint32_t seed, inv_probability;
+    bool transposed = false, complemented = false;
+};
+}  // namespace RcppML
+
+// random matrices are generated by columns, each in one batch of "runif". Since "rng<true>" is transpose-identical,
+//   filling all columns of "rti_matrix" gives the same values in its symmetric part as in the transposed positions.
+template <typename T>
+Eigen::Matrix<T, -1, -1> rti_matrix(uint32_t nrow, uint32_t ncol, uint32_t rng) {
+    Eigen::Matrix<T, -1, -1> m(nrow, ncol);
+    RcppML::rng<true> s(rng);
+    for (uint32_t j = 0; j < ncol; ++j) s.template runif<T>(m.col(j).data(), 0, nrow, j);
     return m;
 }
 
@@ -100,10 +322,60 @@ template <typename T>
 Eigen::Matrix<T, -1, -1> r_matrix(uint32_t nrow, uint32_t ncol, uint32_t rng) {
     Eigen::Matrix<T, -1, -1> m(nrow, ncol);
     RcppML::rng<false> s(rng);
-    for (uint32_t i = 0; i < nrow; ++i)
-        for (uint32_t j = 0; j < ncol; ++j)
-            m(i, j) = s.runif<T>(i, j);
+    for (uint32_t j = 0; j < ncol; ++j) s.template runif<T>(m.col(j).data(), 0, nrow, j);
+    return m;
+}
+
+// random matrix from "seed", uniform on "[min, max)", used to initialize models in C++ without the R random number
+//   generator, so that initializations can be drawn within fits on any thread
+inline Eigen::MatrixXd randomMatrix(const uint32_t nrow, const uint32_t ncol, const uint32_t seed, const double min = 0, const double max = 1) {
+    Eigen::MatrixXd m = r_matrix<double>(nrow, ncol, seed);
+    if (min != 0 || max != 1) m = (m.array() * (max - min) + min).matrix();
     return m;
 }
 
+// random matrix from "seed", normal with "mean" and "sd" by the Box-Muller transform of uniform values from "seed" and
+//   "~seed" at each position
+inline Eigen::MatrixXd randomNormalMatrix(const uint32_t nrow, const uint32_t ncol, const uint32_t seed, const double mean, const double sd) {
+    const Eigen::ArrayXXd u1 = r_matrix<double>(nrow, ncol, seed).array(), u2 = r_matrix<double>(nrow, ncol, ~seed).array();
+    return (mean + sd * (-2 * (1 - u1).log()).sqrt() * (6.283185307179586 * u2).cos()).matrix();
+}
+
+namespace RcppML {
+// initial "w" of an nmf model, given either as a matrix or drawn from "seed" at rank "k" for any number of features,
+//   uniform on "[a, b)" or normal with mean "a" and standard deviation "b"
+struct initW {
+    Eigen::MatrixXd w;
+    uint32_t k = 0, seed = 0;
+    bool normal = false;
+    double a = 0, b = 1;
+
+    int rank() const { return w.size() > 0 ? (int)w.rows() : (int)k; }
+
+    Eigen::MatrixXd matrix(const uint32_t n_features) const {
+        if (w.size() > 0) return w;
+        return normal ? randomNormalMatrix(k, n_features, seed, a, b) : randomMatrix(k, n_features, seed, a, b);
+    }
+};
+
+#if !RCPPML_NO_R
+// initialization given from R as a matrix, or as "c(k, seed, normal, a, b)" for a matrix drawn in C++ (see "initW")
+inline initW asInitW(const Rcpp::RObject& x) {
+    initW init;
+    if (Rf_isMatrix(x)) {
+        init.w = Rcpp::as<Eigen::MatrixXd>(x);
+        return init;
+    }
+    const Rcpp::NumericVector v = Rcpp::as<Rcpp::NumericVector>(x);
+    if (v.size() != 5) Rcpp::stop("an initialization of 'w' must be a matrix, or 'c(k, seed, normal, a, b)'");
+    init.k = v[0];
+    init.seed = (uint32_t)(int64_t)v[1];
+    init.normal = v[2] != 0;
+    init.a = v[3];
+    init.b = v[4];
+    return init;
+}
+#endif
+}  // namespace RcppML
+
 #endif
@@ -0,0 +1,475 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2022 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_serve
+#define RcppML_serve
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <numeric>
+
+#if RCPPML_NO_R && (defined(__unix__) || defined(__APPLE__))
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#define RCPPML_SERVE_SOCKET
+#endif
+
+#define RCPPML_TREE_MAGIC "RCPPMLTR"
+#define RCPPML_TREE_VERSION 1
+#define RCPPML_SERVE_REQUEST 0x51534d52u   // "RMSQ" in little-endian byte order
+#define RCPPML_SERVE_RESPONSE 0x50534d52u  // "RMSP"
+#define RCPPML_SERVE_MAX_NAME 1024         // longest model name of a request
+
+// SERVING MODELS OUTSIDE OF R
+//
+// Projectors of model files (see "modelFile") and the routing rules of "dclust" trees, held by a long-lived process
+//   that answers batches of new samples with the largest factors of their projections and the leaves that they are
+//   routed to. The server is compiled only with "-DRCPPML_NO_R=1" (see "inst/serve/serve.cpp"), and the package
+//   only writes tree files.
+namespace RcppML {
+
+// bipartition rule of an internal node of a "dclust" tree, as "bipartitionRule" without the R-dependent fitting code
+//  * "w" is 2 x "features" (or 2 x all features if "features" is empty), and "a = ww^T"
+struct routeNode {
+    std::string id;
+    std::vector<uint32_t> features;
+    Eigen::MatrixXd w;
+    Eigen::Matrix2d a;
+    Eigen::Vector2d h_scale;
+    bool first_factor;
+};
+
+// the internal nodes of a "dclust" tree, which route a sample from the root "0" to a leaf as "dclustRoute" does
+//  * tree file layout, in native byte order: "RCPPMLTR", uint32 version, number of nodes, and "nonneg", then for each
+//      node: uint32 length of "id" and its characters, uint32 number of "features" and their 0-based indices, uint32
+//      columns of "w" and its values (column-major), double h_scale[2], and uint32 "first_factor"
+//  * "write_dclust" writes the tree of a "dclust" result to a tree file
+class routingTree {
+   public:
+    bool nonneg = true;
+
+    routingTree() {}
+
+    explicit routingTree(const std::string& path) {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        if (!f) RcppML::fail("could not open '" + path + "'");
+        char magic[8];
+        uint32_t header[3];
+        if (!f.read(magic, 8) || !f.read((char*)header, sizeof(header)) || std::string(magic, 8) != RCPPML_TREE_MAGIC)
+            RcppML::fail("'" + path + "' is not an RcppML tree file");
+        if (header[0] != RCPPML_TREE_VERSION) RcppML::fail("'" + path + "' was written by an unsupported version of RcppML");
+        nonneg = header[2] != 0;
+        nodes.resize(header[1]);
+        for (routeNode& node : nodes) {
+            uint32_t length, n_features, w_cols, first_factor;
+            if (!f.read((char*)&length, sizeof(length))) break;
+            node.id.resize(length);
+            f.read(&node.id[0], length);
+            f.read((char*)&n_features, sizeof(n_features));
+            node.features.resize(n_features);
+            f.read((char*)node.features.data(), n_features * sizeof(uint32_t));
+            f.read((char*)&w_cols, sizeof(w_cols));
+            if (!f || (n_features > 0 && w_cols != n_features)) RcppML::fail("'" + path + "' is not a valid RcppML tree file");
+            node.w.resize(2, w_cols);
+            f.read((char*)node.w.data(), node.w.size() * sizeof(double));
+            f.read((char*)node.h_scale.data(), 2 * sizeof(double));
+            f.read((char*)&first_factor, sizeof(first_factor));
+            node.a = gram(node.w);
+            node.first_factor = first_factor != 0;
+        }
+        if (!f) RcppML::fail("'" + path + "' is truncated");
+        index();
+    }
+
+    // write "nodes" to "path + '.tmp'", then rename it to "path". This does not use the R API.
+    static bool write(const std::string& path, const std::vector<routeNode>& nodes, const bool nonneg) {
+        const std::string tmp = path + ".tmp";
+        {
+            std::ofstream f(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            if (!f) return false;
+            const uint32_t header[3] = {RCPPML_TREE_VERSION, (uint32_t)nodes.size(), nonneg ? 1u : 0u};
+            f.write(RCPPML_TREE_MAGIC, 8);
+            f.write((const char*)header, sizeof(header));
+            for (const routeNode& node : nodes) {
+                const uint32_t length = node.id.size(), n_features = node.features.size(), w_cols = node.w.cols(),
+                               first_factor = node.first_factor;
+                f.write((const char*)&length, sizeof(length));
+                f.write(node.id.data(), length);
+                f.write((const char*)&n_features, sizeof(n_features));
+                f.write((const char*)node.features.data(), n_features * sizeof(uint32_t));
+                f.write((const char*)&w_cols, sizeof(w_cols));
+                f.write((const char*)node.w.data(), node.w.size() * sizeof(double));
+                f.write((const char*)node.h_scale.data(), 2 * sizeof(double));
+                f.write((const char*)&first_factor, sizeof(first_factor));
+            }
+            if (!f) return false;
+        }
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    unsigned int size() const { return nodes.size(); }
+
+    // number of features that the tree routes, or 0 if every node has its own subset of features
+    unsigned int features() const { return n_features; }
+
+    // leaf that column "j" of "A" is routed to (see "bipartitionFirst")
+    std::string route(RcppML::SparseOf<double>& A, const unsigned int j) const {
+        std::string id = "0";
+        for (auto node = node_index.find(id); node != node_index.end(); node = node_index.find(id))
+            id += first(nodes[node->second], A, j) ? "0" : "1";
+        return id;
+    }
+
+   private:
+    std::vector<routeNode> nodes;
+    std::map<std::string, unsigned int> node_index;
+    unsigned int n_features = 0;
+
+    void index() {
+        for (unsigned int i = 0; i < nodes.size(); ++i) {
+            node_index[nodes[i].id] = i;
+            if (nodes[i].features.empty()) n_features = nodes[i].w.cols();
+        }
+    }
+
+    bool first(const routeNode& node, RcppML::SparseOf<double>& A, const unsigned int j) const {
+        Eigen::MatrixXd h = Eigen::MatrixXd::Zero(2, 1);
+        const std::vector<uint32_t>& f = node.features;
+        for (RcppML::SparseOf<double>::InnerIterator it(A, j); it; ++it) {
+            uint32_t r = it.row();
+            if (!f.empty()) {
+                r = std::lower_bound(f.begin(), f.end(), r) - f.begin();
+                if (r == f.size() || f[r] != (uint32_t)it.row()) continue;
+            } else if (r >= (uint32_t)node.w.cols()) {
+                continue;
+            }
+            h.col(0) += node.w.col(r) * it.value();
+        }
+        nnls2Batch(node.a, h, nonneg);
+        const double h0 = h(0, 0) / node.h_scale(0), h1 = h(1, 0) / node.h_scale(1);
+        return (node.first_factor ? h0 - h1 : h1 - h0) > 0;
+    }
+};
+
+#if RCPPML_NO_R
+
+// a batch of samples to serve, and the answer to it
+//  * "top_k" of 0 returns all factors
+//  * "index" and "value" hold the "top_k" largest factors of each sample in decreasing order, and "leaf" the leaf of
+//      each sample, or is empty if the model has no tree
+struct serveRequest {
+    std::string model;
+    uint32_t rows = 0, cols = 0, top_k = 0;
+    std::vector<int> p, i;
+    std::vector<double> x;
+};
+
+struct serveResponse {
+    uint32_t status = 0, cols = 0, top_k = 0;
+    std::string error;
+    std::vector<uint32_t> index;
+    std::vector<double> value;
+    std::vector<std::string> leaf;
+};
+
+// models held in memory for serving, each a projector of a model file and optionally the tree of a "dclust" of the
+//   same features
+//  * batches are answered one at a time, with samples of a batch projected and routed in parallel over "threads", so
+//      that the latency of a batch does not depend on other clients
+//  * buffers grow to the largest batch answered and are then reused, so steady traffic does not allocate
+class modelServer {
+   public:
+    unsigned int threads = 1;
+
+    // largest batch read from a socket, in columns and non-zeros (see "checkSize")
+    size_t max_cols = (size_t)1 << 24, max_nnz = (size_t)1 << 26;
+
+    void add(const std::string& name, const std::string& model_path, const std::string& tree_path = "", const double L1 = 0,
+             const double L2 = 0, const int storage = PROJECT_DOUBLE) {
+        servedModel m;
+        m.projector = std::make_shared<RcppML::projector<double>>(modelFile(model_path), L1, L2, 0, NNLS_AUTO, storage);
+        if (!tree_path.empty()) {
+            m.tree = std::make_shared<routingTree>(tree_path);
+            if (m.tree->features() != 0 && m.tree->features() != m.projector->features())
+                RcppML::fail("the tree in '" + tree_path + "' does not have the features of the model in '" + model_path + "'");
+        }
+        models[name] = m;
+    }
+
+    unsigned int size() const { return models.size(); }
+
+    // fail unless a batch of "rows" x "cols" with "nnz" non-zeros can be answered for "model", so that a request read
+    //   from a socket is sized against the served model before its buffers are allocated
+    void checkSize(const std::string& model, const uint32_t rows, const uint32_t cols, const uint32_t nnz) const {
+        auto m = models.find(model);
+        if (m == models.end()) RcppML::fail("no model is served as '" + model + "'");
+        if (rows != m->second.projector->features())
+            RcppML::fail("number of rows in the batch is not equal to the number of features of '" + model + "'");
+        if (cols > max_cols || nnz > max_nnz || (uint64_t)nnz > (uint64_t)rows * cols) RcppML::fail("the batch is larger than the server accepts");
+    }
+
+    // answer "q" in "r", with a non-zero "status" and an "error" if it cannot be answered
+    void answer(const serveRequest& q, serveResponse& r) {
+        r.status = 0;
+        r.error.clear();
+        r.cols = 0;
+        r.top_k = 0;
+        try {
+            auto m = models.find(q.model);
+            if (m == models.end()) RcppML::fail("no model is served as '" + q.model + "'");
+            validate(q);
+            RcppML::projector<double>& p = *m->second.projector;
+            if (q.rows != p.features()) RcppML::fail("number of rows in the batch is not equal to the number of features of '" + q.model + "'");
+            RcppML::CscView<double> A(q.rows, q.cols, q.p.data(), q.i.data(), q.x.data());
+            const Eigen::MatrixXd h = p.project(A, threads);
+            topK(h, q.top_k == 0 ? h.rows() : std::min<uint32_t>(q.top_k, h.rows()), r);
+            r.leaf.resize(m->second.tree ? q.cols : 0);
+            if (m->second.tree) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic) if (q.cols > 1)
+#endif
+                for (uint32_t j = 0; j < q.cols; ++j) r.leaf[j] = m->second.tree->route(A, j);
+            }
+        } catch (const std::exception& e) {
+            r.status = 1;
+            r.error = e.what();
+        }
+    }
+
+   private:
+    struct servedModel {
+        std::shared_ptr<RcppML::projector<double>> projector;
+        std::shared_ptr<routingTree> tree;
+    };
+    std::map<std::string, servedModel> models;
+
+    // batches come from other processes, so their column pointers and row indices are checked before they are read
+    static void validate(const serveRequest& q) {
+        if (q.p.size() != (size_t)q.cols + 1 || q.p[0] != 0 || (size_t)q.p[q.cols] != q.i.size() || q.x.size() != q.i.size())
+            RcppML::fail("the batch is not a valid compressed sparse column matrix");
+        for (uint32_t j = 0; j < q.cols; ++j)
+            if (q.p[j + 1] < q.p[j]) RcppML::fail("the batch is not a valid compressed sparse column matrix");
+        for (const int r : q.i)
+            if (r < 0 || (uint32_t)r >= q.rows) RcppML::fail("row indices of the batch are out of range");
+    }
+
+    // "k" largest values of each column of "h" in decreasing order, and their rows, with ties in order of rows
+    static void topK(const Eigen::MatrixXd& h, const uint32_t k, serveResponse& r) {
+        r.cols = h.cols();
+        r.top_k = k;
+        r.index.resize((size_t)k * h.cols());
+        r.value.resize((size_t)k * h.cols());
+        std::vector<uint32_t> order(h.rows());
+        for (Eigen::Index j = 0; j < h.cols(); ++j) {
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + k, order.end(),
+                              [&](const uint32_t a, const uint32_t b) { return h(a, j) > h(b, j) || (h(a, j) == h(b, j) && a < b); });
+            for (uint32_t l = 0; l < k; ++l) {
+                r.index[(size_t)j * k + l] = order[l];
+                r.value[(size_t)j * k + l] = h(order[l], j);
+            }
+        }
+    }
+};
+
+#ifdef RCPPML_SERVE_SOCKET
+
+// messages of a Unix domain stream socket, in native byte order since both ends are on one host
+//  * request: uint32 RCPPML_SERVE_REQUEST, length of the model name, rows, cols, non-zeros, top_k, then the name,
+//      int32 p[cols + 1], int32 i[nnz], double x[nnz]
+//  * response: uint32 RCPPML_SERVE_RESPONSE, status, cols, top_k, length of the error message, whether leaves follow,
+//      then the error message if "status" is not 0, or else uint32 index[cols * top_k], double value[cols * top_k],
+//      and for each column, if leaves follow, uint32 length of its leaf id and its characters
+//  * a connection may send any number of requests, each answered before the next is read
+namespace serve {
+
+inline bool readAll(const int fd, void* buf, size_t n) {
+    char* c = (char*)buf;
+    while (n > 0) {
+        const ssize_t got = recv(fd, c, n, 0);
+        if (got <= 0) return false;
+        c += got;
+        n -= got;
+    }
+    return true;
+}
+
+inline bool writeAll(const int fd, const void* buf, size_t n) {
+    const char* c = (const char*)buf;
+    while (n > 0) {
+        const ssize_t sent = send(fd, c, n, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        c += sent;
+        n -= sent;
+    }
+    return true;
+}
+
+template <typename T>
+inline bool readVector(const int fd, std::vector<T>& v, const size_t n) {
+    v.resize(n);
+    return readAll(fd, v.data(), n * sizeof(T));
+}
+
+// read a request, or return false if the connection is closed or does not send a request
+//  * sizes in the header are checked against "server" before anything is allocated for them, and fail if the request
+//      cannot be answered, leaving the rest of it unread
+inline bool readRequest(const int fd, serveRequest& q, const modelServer& server) {
+    uint32_t header[6];
+    if (!readAll(fd, header, sizeof(header)) || header[0] != RCPPML_SERVE_REQUEST) return false;
+    if (header[1] > RCPPML_SERVE_MAX_NAME) RcppML::fail("the model name of the batch is too long");
+    q.rows = header[2];
+    q.cols = header[3];
+    q.top_k = header[5];
+    q.model.resize(header[1]);
+    if (!readAll(fd, &q.model[0], header[1])) return false;
+    server.checkSize(q.model, q.rows, q.cols, header[4]);
+    return readVector(fd, q.p, (size_t)q.cols + 1) && readVector(fd, q.i, header[4]) && readVector(fd, q.x, header[4]);
+}
+
+inline bool writeResponse(const int fd, const serveResponse& r) {
+    const uint32_t header[6] = {RCPPML_SERVE_RESPONSE, r.status, r.cols, r.top_k, (uint32_t)r.error.size(), !r.leaf.empty()};
+    if (!writeAll(fd, header, sizeof(header))) return false;
+    if (r.status != 0) return writeAll(fd, r.error.data(), r.error.size());
+    if (!writeAll(fd, r.index.data(), r.index.size() * sizeof(uint32_t)) || !writeAll(fd, r.value.data(), r.value.size() * sizeof(double)))
+        return false;
+    for (const std::string& leaf : r.leaf) {
+        const uint32_t length = leaf.size();
+        if (!writeAll(fd, &length, sizeof(length)) || !writeAll(fd, leaf.data(), length)) return false;
+    }
+    return true;
+}
+
+inline bool readResponse(const int fd, serveResponse& r) {
+    uint32_t header[6];
+    if (!readAll(fd, header, sizeof(header)) || header[0] != RCPPML_SERVE_RESPONSE) return false;
+    r.status = header[1];
+    r.cols = header[2];
+    r.top_k = header[3];
+    r.error.resize(header[4]);
+    if (r.status != 0) return readAll(fd, &r.error[0], header[4]);
+    const size_t n = (size_t)r.cols * r.top_k;
+    if (!readVector(fd, r.index, n) || !readVector(fd, r.value, n)) return false;
+    r.leaf.resize(header[5] ? r.cols : 0);
+    for (std::string& leaf : r.leaf) {
+        uint32_t length;
+        if (!readAll(fd, &length, sizeof(length))) return false;
+        leaf.resize(length);
+        if (!readAll(fd, &leaf[0], length)) return false;
+    }
+    return true;
+}
+
+inline sockaddr_un address(const std::string& path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) RcppML::fail("socket path '" + path + "' is too long");
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+}  // namespace serve
+
+// answer requests on a Unix domain socket at "path" until "stop" is set (e.g. by a signal handler)
+//  * connections are answered one at a time, so a client that holds its connection open has the server to itself and
+//      sees steady latency. Clients that need concurrency should run servers on several sockets.
+//  * "stop" is checked at least every "poll_ms" milliseconds while no request is pending
+//  * a request that fails before it is answered (e.g. one larger than the server accepts, see "readRequest") is
+//      answered with its error if possible, and closes the connection of that client only
+inline void serveSocket(const std::string& path, modelServer& server, const volatile std::sig_atomic_t* stop = NULL,
+                        const int poll_ms = 100) {
+    const sockaddr_un addr = serve::address(path);
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) RcppML::fail("could not create a socket");
+    unlink(path.c_str());
+    if (bind(listener, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+        close(listener);
+        RcppML::fail("could not listen on '" + path + "'");
+    }
+    serveRequest q;
+    serveResponse r;
+    pollfd listening = {listener, POLLIN, 0};
+    while (!(stop && *stop)) {
+        if (poll(&listening, 1, poll_ms) <= 0) continue;
+        const int client = accept(listener, NULL, NULL);
+        if (client < 0) continue;
+        pollfd pending = {client, POLLIN, 0};
+        while (!(stop && *stop)) {
+            const int ready = poll(&pending, 1, poll_ms);
+            if (ready == 0) continue;
+            try {
+                if (ready < 0 || !serve::readRequest(client, q, server)) break;
+                server.answer(q, r);
+                if (!serve::writeResponse(client, r)) break;
+            } catch (const std::exception& e) {
+                r.status = 1;
+                r.cols = r.top_k = 0;
+                r.error = e.what();
+                serve::writeResponse(client, r);
+                break;
+            }
+        }
+        close(client);
+    }
+    close(listener);
+    unlink(path.c_str());
+}
+
+// a connection to a server started by "serveSocket"
+class serveClient {
+   public:
+    explicit serveClient(const std::string& path) {
+        const sockaddr_un addr = serve::address(path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            if (fd >= 0) close(fd);
+            RcppML::fail("could not connect to '" + path + "'");
+        }
+    }
+
+    ~serveClient() { close(fd); }
+
+    serveClient(const serveClient&) = delete;
+    serveClient& operator=(const serveClient&) = delete;
+
+    // answer of the server to the samples in "A" for "model"
+    void request(const std::string& model, const CscView<double>& A, const uint32_t top_k, serveResponse& r) {
+        const uint32_t nnz = A.p[A.cols()];
+        const uint32_t header[6] = {RCPPML_SERVE_REQUEST, (uint32_t)model.size(), A.rows(), A.cols(), nnz, top_k};
+        if (!serve::writeAll(fd, header, sizeof(header)) || !serve::writeAll(fd, model.data(), model.size()) ||
+            !serve::writeAll(fd, A.p, (A.cols() + 1) * sizeof(int)) || !serve::writeAll(fd, A.i, nnz * sizeof(int)) ||
+            !writeValues(A, nnz) || !serve::readResponse(fd, r))
+            RcppML::fail("the connection to the server was lost");
+    }
+
+   private:
+    int fd;
+    std::vector<double> ones;
+
+    // pattern matrices are sent with values of 1
+    bool writeValues(const CscView<double>& A, const uint32_t nnz) {
+        if (A.x) return serve::writeAll(fd, A.x, nnz * sizeof(double));
+        ones.assign(nnz, 1);
+        return serve::writeAll(fd, ones.data(), nnz * sizeof(double));
+    }
+};
+
+#endif
+
+#endif
+
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,68 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_simd
+#define RcppML_simd
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+// RUNTIME DISPATCH OF SIMD KERNELS
+//
+// The package is built for the baseline of the architecture (SSE2 on x86-64), without "-march=native", so Eigen and the
+//   loops that the compiler vectorizes use 128-bit registers even on machines with AVX2 or AVX-512. Kernels marked with
+//   "RCPPML_TARGET_CLONES" are also compiled for AVX2 and AVX-512, and the widest version that the CPU supports is
+//   chosen once, when the package is loaded (GCC "target_clones" resolves each kernel as an ifunc):
+//  * batches of the random number generator ("rng::runif"), which are integer hashes
+//  * cyclic coordinate descent NNLS of dynamic rank ("cdSweeps")
+// Eigen chooses its vector instructions when it is compiled, so it uses 128-bit registers even within a kernel compiled
+//   for AVX-512, and kernels are written instead as loops over arrays that the compiler vectorizes with "omp simd".
+//   Products and sums are not contracted into fused multiply-adds, and no sum is reordered, so every version of a
+//   kernel gives identical results.
+// Kernels that are limited by memory rather than by arithmetic, such as the gather of right-hand sides from sparse
+//   columns ("gatherTile") and sparse cross-products of distance tiles, were no faster with wider vectors and are not
+//   dispatched, nor are kernels built on Eigen packets ("nnls2Batch") or on Eigen products (dense distance tiles).
+// Dispatch is used with GCC on x86-64 Linux, unless the build already targets AVX-512 or RCPPML_NO_SIMD_DISPATCH is
+//   defined. NEON is part of the baseline of aarch64, so builds for ARM use it without dispatch.
+#if !defined(RCPPML_NO_SIMD_DISPATCH) && defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__) && \
+    defined(__linux__) && !defined(__AVX512F__)
+#define RCPPML_SIMD_DISPATCH 1
+#define RCPPML_TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default"), optimize("fp-contract=off")))
+#else
+#define RCPPML_SIMD_DISPATCH 0
+#define RCPPML_TARGET_CLONES
+#endif
+
+#if defined(_OPENMP)
+#define RCPPML_PRAGMA_SIMD _Pragma("omp simd")
+#else
+#define RCPPML_PRAGMA_SIMD
+#endif
+
+namespace RcppML {
+
+// width in bits of the vector registers used by dispatched kernels on this CPU, or 0 if not known
+inline unsigned int simdWidth() {
+#if RCPPML_SIMD_DISPATCH
+    if (__builtin_cpu_supports("avx512f")) return 512;
+    if (__builtin_cpu_supports("avx2")) return 256;
+    return 128;
+#elif defined(__AVX512F__)
+    return 512;
+#elif defined(__AVX2__)
+    return 256;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+    return 128;
+#else
+    return 0;
+#endif
+}
+
+}  // namespace RcppML
+
+#endif
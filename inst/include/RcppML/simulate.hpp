@@ -0,0 +1,154 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_simulate
+#define RcppML_simulate
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// SIMULATED NMF DATA
+//
+// "A = w h" of rank "k" with Gaussian noise and dropout, as simulated by "simulateNMF", generated as a sparse matrix
+//   without forming the dense product, so that matrices of any size with few enough non-zeros can be simulated:
+//  * each factor of "w" (and "h") has a number of non-zeros drawn from a normal distribution with mean "n / 2" and sd
+//     "n / 4" (at least 2), at random positions and with absolute values of a normal distribution with mean 1 and sd 1,
+//     and is scaled to sum to 1. Factors are generated in parallel.
+//  * values of "A" that are not dropped out are found by skipping geometric gaps between them (see "skipSample"), and
+//     only at those positions is "w h" computed and noise added. Values that are not positive are not stored.
+//  * blocks of columns of "A" are generated in parallel into their own buffers, and then copied to their offsets
+//
+// All values are given by "rng" hashes of their position, so results do not depend on the number of threads.
+namespace RcppML {
+// compressed sparse columns of an "nrow x ncol" matrix, where "p" may exceed the range of an R integer
+struct cscMatrix {
+    uint32_t nrow, ncol;
+    std::vector<size_t> p;
+    std::vector<uint32_t> i;
+    std::vector<double> x;
+};
+
+// standard normal value at "(i, j)", by the Box-Muller transform of uniform values of "u1" and "u2" at "(i, j)"
+inline double normalAt(const rng<false>& u1, const rng<false>& u2, const uint32_t i, const uint32_t j) {
+    return std::sqrt(-2 * std::log(1 - u1.runif<double>(i, j))) * std::cos(6.283185307179586 * u2.runif<double>(i, j));
+}
+
+// "k" sparse factors of length "n" drawn from "seed", as "n x k" compressed sparse columns
+inline cscMatrix simulateFactors(const uint32_t n, const uint32_t k, const uint32_t seed, const unsigned int threads) {
+    const rng<false> u1(seed), u2(~seed), positions(seed + 1);
+    std::vector<std::vector<uint32_t>> factor_i(k);
+    std::vector<std::vector<double>> factor_x(k);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t f = 0; f < k; ++f) {
+        const double nnz = std::round(n / 2.0 + n / 4.0 * normalAt(u1, u2, f, 0));
+        const uint32_t n_nonzero = (uint32_t)std::max(std::min(nnz, (double)n), std::min(2.0, (double)n));
+
+        // partial Fisher-Yates shuffle for "n_nonzero" random positions
+        std::vector<uint32_t> perm(n);
+        std::iota(perm.begin(), perm.end(), 0);
+        for (uint32_t t = 0; t < n_nonzero; ++t) std::swap(perm[t], perm[t + positions.sample(f, t, n - t)]);
+        perm.resize(n_nonzero);
+        std::sort(perm.begin(), perm.end());
+
+        std::vector<double> x(n_nonzero);
+        double sum = 0;
+        for (uint32_t t = 0; t < n_nonzero; ++t) {
+            x[t] = std::abs(1 + normalAt(u1, u2, f, perm[t] + 1));
+            sum += x[t];
+        }
+        if (sum > 0)
+            for (double& x_t : x) x_t /= sum;
+        factor_i[f] = std::move(perm);
+        factor_x[f] = std::move(x);
+    }
+
+    cscMatrix m{n, k, std::vector<size_t>(k + 1, 0), {}, {}};
+    for (uint32_t f = 0; f < k; ++f) m.p[f + 1] = m.p[f] + factor_i[f].size();
+    for (uint32_t f = 0; f < k; ++f) {
+        m.i.insert(m.i.end(), factor_i[f].begin(), factor_i[f].end());
+        m.x.insert(m.x.end(), factor_x[f].begin(), factor_x[f].end());
+    }
+    return m;
+}
+
+// transpose of compressed sparse columns "m"
+inline cscMatrix transposeCSC(const cscMatrix& m) {
+    cscMatrix t{m.ncol, m.nrow, std::vector<size_t>(m.nrow + 1, 0), std::vector<uint32_t>(m.i.size()), std::vector<double>(m.x.size())};
+    for (const uint32_t row : m.i) ++t.p[row + 1];
+    for (uint32_t row = 0; row < m.nrow; ++row) t.p[row + 1] += t.p[row];
+    std::vector<size_t> next(t.p.begin(), t.p.end() - 1);
+    for (uint32_t col = 0; col < m.ncol; ++col) {
+        for (size_t it = m.p[col]; it < m.p[col + 1]; ++it) {
+            t.i[next[m.i[it]]] = col;
+            t.x[next[m.i[it]]++] = m.x[it];
+        }
+    }
+    return t;
+}
+
+// simulated "A" ("nrow x ncol"), "w" ("nrow x k") and "h" ("k x ncol")
+inline void simulateNMF(const uint32_t nrow, const uint32_t ncol, const uint32_t k, const double noise, const double dropout,
+                        const uint32_t seed, cscMatrix& A, cscMatrix& w, cscMatrix& h, const unsigned int threads) {
+    w = simulateFactors(nrow, k, seed, threads);
+    h = transposeCSC(simulateFactors(ncol, k, seed + 2, threads));
+
+    // "w" by rows, so that all factors of a row are contiguous
+    Eigen::MatrixXd wt = Eigen::MatrixXd::Zero(k, nrow);
+    for (uint32_t f = 0; f < k; ++f)
+        for (size_t it = w.p[f]; it < w.p[f + 1]; ++it) wt(f, w.i[it]) = w.x[it];
+
+    const rng<false> kept(seed + 4), u1(seed + 5), u2(~(seed + 5));
+    const uint32_t n_blocks = (ncol + RANDOM_BLOCK_SIZE - 1) / RANDOM_BLOCK_SIZE;
+    std::vector<std::vector<uint32_t>> block_i(n_blocks);
+    std::vector<std::vector<double>> block_x(n_blocks);
+    A = cscMatrix{nrow, ncol, std::vector<size_t>(ncol + 1, 0), {}, {}};
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const uint32_t block_end = std::min(ncol, (block + 1) * RANDOM_BLOCK_SIZE);
+        std::vector<uint32_t> rows;
+        for (uint32_t col = block * RANDOM_BLOCK_SIZE; col < block_end; ++col) {
+            rows.clear();
+            skipSample(kept, col, 0, nrow, 1 - dropout, rows);
+            const size_t col_start = block_i[block].size();
+            for (const uint32_t row : rows) {
+                double value = 0;
+                for (size_t it = h.p[col]; it < h.p[col + 1]; ++it) value += wt(h.i[it], row) * h.x[it];
+                if (noise > 0) value += noise * normalAt(u1, u2, row, col);
+                if (value > 0) {
+                    block_i[block].push_back(row);
+                    block_x[block].push_back(value);
+                }
+            }
+            A.p[col + 1] = block_i[block].size() - col_start;
+        }
+    }
+    for (uint32_t col = 0; col < ncol; ++col) A.p[col + 1] += A.p[col];
+    A.i.resize(A.p[ncol]);
+    A.x.resize(A.p[ncol]);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const size_t offset = A.p[block * RANDOM_BLOCK_SIZE];
+        std::copy(block_i[block].begin(), block_i[block].end(), A.i.begin() + offset);
+        std::copy(block_x[block].begin(), block_x[block].end(), A.x.begin() + offset);
+        std::vector<uint32_t>().swap(block_i[block]);
+        std::vector<double>().swap(block_x[block]);
+    }
+}
+}  // namespace RcppML
+
+#endif
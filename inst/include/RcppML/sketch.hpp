@@ -0,0 +1,91 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_sketch
+#define RcppML_sketch
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+
+// RANDOMIZED SKETCHES
+//
+// Orthonormal bases of the range of "A" by a randomized range finder (Halko, Martinsson and Tropp (2011), "Finding
+//   structure with randomness", SIAM Review 53(2)), as used for NNDSVD initialization and compressed NMF:
+//  * "A" is multiplied by a Gaussian sketch drawn from "rng", and the range of the product is refined by "power_iters"
+//     multiplications by "A^T" and "A", each orthonormalized to keep small singular values
+//  * products with sparse "A" and its transpose are computed column by column in parallel, as right-hand sides are in
+//     "predict", so "A" is never dense
+//  * bases are stored by rows ("l x A.rows()"), so that projections of "A" are "leftMultiply" products
+namespace RcppML {
+// "Xt * A" for "Xt" of "l x A.rows()" and sparse "A", one column at a time
+template <typename Value>
+Eigen::MatrixXd leftMultiply(const Eigen::MatrixXd& Xt, Rcpp::SparseMatrixOf<Value>& A, const unsigned int threads) {
+    Eigen::MatrixXd out = Eigen::MatrixXd::Zero(Xt.rows(), A.cols());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (unsigned int i = 0; i < A.cols(); ++i)
+        for (typename Rcpp::SparseMatrixOf<Value>::InnerIterator it(A, i); it; ++it) out.col(i) += it.value() * Xt.col(it.row());
+    return out;
+}
+
+// "Xt * A" for dense "A", by blocks of columns
+inline Eigen::MatrixXd leftMultiply(const Eigen::MatrixXd& Xt, const Eigen::MatrixXd& A, const unsigned int threads) {
+    Eigen::MatrixXd out(Xt.rows(), A.cols());
+    const int block_size = 256, n_blocks = (A.cols() + block_size - 1) / block_size;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int block = 0; block < n_blocks; ++block) {
+        const int start = block * block_size, n = std::min(block_size, (int)A.cols() - start);
+        out.middleCols(start, n).noalias() = Xt * A.middleCols(start, n);
+    }
+    return out;
+}
+
+template <typename Value>
+Rcpp::SparseMatrixOf<Value> transposeOf(Rcpp::SparseMatrixOf<Value>& A, const unsigned int threads) {
+    return A.transpose(threads);
+}
+
+inline Eigen::MatrixXd transposeOf(const Eigen::MatrixXd& A, const unsigned int) { return A.transpose(); }
+
+// orthonormalize rows of "Xt" in place by Gram-Schmidt, twice, which is as stable as Householder QR for few rows.
+//   Rows that are linearly dependent on previous rows are set to zero.
+inline void orthonormalizeRows(Eigen::MatrixXd& Xt) {
+    for (int j = 0; j < Xt.rows(); ++j) {
+        const double norm0 = Xt.row(j).norm();
+        for (int pass = 0; pass < 2; ++pass)
+            for (int i = 0; i < j; ++i) Xt.row(j) -= Xt.row(i).dot(Xt.row(j)) * Xt.row(i);
+        const double norm = Xt.row(j).norm();
+        if (norm > 1e-10 * norm0 && norm > 0)
+            Xt.row(j) /= norm;
+        else
+            Xt.row(j).setZero();
+    }
+}
+
+// orthonormal basis of "l" rows spanning the range of the columns of "A", where "t_A" is the transpose of "A"
+template <class MatrixA, class MatrixAt>
+Eigen::MatrixXd rangeFinder(MatrixA& A, MatrixAt& t_A, const unsigned int l, const unsigned int power_iters, const uint32_t seed,
+                            const unsigned int threads) {
+    Eigen::MatrixXd Qt = leftMultiply(randomNormalMatrix(l, A.cols(), seed, 0, 1), t_A, threads);
+    orthonormalizeRows(Qt);
+    for (unsigned int iter = 0; iter < power_iters; ++iter) {
+        Eigen::MatrixXd Pt = leftMultiply(Qt, A, threads);
+        orthonormalizeRows(Pt);
+        Qt = leftMultiply(Pt, t_A, threads);
+        orthonormalizeRows(Qt);
+    }
+    return Qt;
+}
+}  // namespace RcppML
+
+#endif
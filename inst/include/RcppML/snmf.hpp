@@ -0,0 +1,141 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_snmf
+#define RcppML_snmf
+
+#ifndef RcppML_projector
+#include <RcppML/projector.hpp>
+#endif
+
+#ifndef RcppML_sketch
+#include <RcppML/sketch.hpp>
+#endif
+
+// SYMMETRIC NON-NEGATIVE MATRIX FACTORIZATION
+//
+// "A = w^T diag(d) w" for symmetric "A" ("m x m"), with one update of the factor in each iteration:
+//  * in "nmf", the update of "w" given "h" is the same problem as the update of "h" given "w" when "A = A^T", so two
+//     updates per iteration only pass the factors back and forth
+//  * instead, each iteration solves "h" from "min ||A - w^T h||^2 + alpha ||h - w||^2" and takes "h" as the next "w",
+//     where the coupling penalty "alpha" draws the two factors together (Kuang, Ding and Park (2012), "Symmetric
+//     nonnegative matrix factorization for graph clustering", SDM). At a fixed point, "h = w" and "A = w^T w".
+//  * "alpha" is the mean of the diagonal of "ww^T" in each iteration, so that the coupling has the same weight relative
+//     to the fit for any scale of "A". It is added to the diagonal of the system, and "alpha w" to its right-hand sides.
+//  * "w" is not scaled between iterations, since it must approach the square root of the scale of "A". The initial "w"
+//     is scaled so that "||w^T w|| = ||A||". Rows of the returned "w" and "h" are scaled to sum to 1, with the product
+//     of their sums in "d".
+namespace RcppML {
+template <class Matrix>
+class snmf {
+   public:
+    double tol = 1e-4, mse = 0, L1 = 0, L2 = 0;
+    unsigned int maxit = 100, iter = 0, threads = 0;
+    bool verbose = false, sort_model = true;
+    int solver = NNLS_AUTO;
+
+    Eigen::MatrixXd w, h;  // factors ("k x m") of the last two iterations
+    Eigen::VectorXd d;
+    double tol_ = 1;
+
+    snmf(Matrix& A, const Eigen::MatrixXd& w) : w(w), A(A) {
+        if (w.cols() != A.rows()) Rcpp::stop("number of columns in 'w' is not equal to the number of rows in 'A'");
+        if (!isAppxSymmetric(A)) Rcpp::stop("'A' is not symmetric");
+    }
+
+    void fit() {
+        const double A_sq = squaredNorm(A), ww_sq = (w * w.transpose()).squaredNorm();
+        if (ww_sq > 0) w *= std::pow(A_sq / ww_sq, 0.25);
+        Eigen::MatrixXd w_it = scaled(w);
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        for (iter = 0; iter < maxit; ++iter) {
+            update();
+            Eigen::MatrixXd h_it = scaled(h);
+            tol_ = cor(h_it, w_it);
+            if (verbose) Rprintf("%4d | %8.2e\n", iter + 1, tol_);
+            if (tol_ < tol || iter + 1 == maxit) {
+                ++iter;
+                break;
+            }
+            w.swap(h);
+            w_it = h_it;
+            Rcpp::checkUserInterrupt();
+        }
+        d = w.rowwise().sum().cwiseProduct(h.rowwise().sum());
+        mse = meanSquaredError();
+        w = scaled(w);
+        h = scaled(h);
+        if (sort_model) {
+            const std::vector<int> indx = sort_index(d);
+            w = reorder_rows(w, indx);
+            h = reorder_rows(h, indx);
+            d = reorder(d, indx);
+        }
+    }
+
+   private:
+    Matrix& A;
+
+    unsigned int nThreads() const {
+#ifdef _OPENMP
+        return threads == 0 ? omp_get_max_threads() : threads;
+#endif
+        return 1;
+    }
+
+    // copy of "x" with rows scaled to sum to 1
+    static Eigen::MatrixXd scaled(const Eigen::MatrixXd& x) {
+        Eigen::MatrixXd y = x;
+        for (int f = 0; f < y.rows(); ++f) {
+            const double sum = y.row(f).sum();
+            if (sum > 0) y.row(f) /= sum;
+        }
+        return y;
+    }
+
+    // solve "h" from "w" with the coupling penalty "alpha ||h - w||^2"
+    void update() {
+        const unsigned int k = w.rows();
+        Eigen::MatrixXd a = gram(w), b = leftMultiply(w, A, nThreads());
+        const double alpha = a.diagonal().mean();
+        a.diagonal().array() += alpha + L2 + TINY_NUM_FOR_STABILITY;
+        b += alpha * w;
+        if (L1 != 0) b.array() -= L1;
+        const cholesky<double> a_llt(a);
+        h.resize(k, w.cols());
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nThreads())
+#endif
+        {
+            Eigen::VectorXd b_j(k);
+            active_set<double, -1> as_solver(k);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int j = 0; j < h.cols(); ++j) {
+                h.col(j).setZero();
+                b_j = b.col(j);
+                if (a_llt.success) c_nnls_init(a_llt, a, b_j, h, j, 0);
+                if (useActiveSet(solver, k))
+                    as_solver.solve(a, b_j, h, j);
+                else
+                    c_nnls(a, b_j, h, j, CD_MAXIT, cd_tol<double>(), solver);
+            }
+        }
+    }
+
+    // mean squared error of "A = w^T diag(d) h" from "||A||^2 - 2 tr(h^T diag(d) wA) + tr(h^T diag(d) ww^T diag(d) h)",
+    //   for unscaled "w" and "h" (in which "d" is 1)
+    double meanSquaredError() {
+        const Eigen::MatrixXd b = leftMultiply(w, A, nThreads());
+        const double loss = squaredNorm(A) - 2 * b.cwiseProduct(h).sum() + (gram(w) * h).cwiseProduct(h).sum();
+        return loss / ((double)A.rows() * A.cols());
+    }
+};
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,51 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_spmm
+#define RcppML_spmm
+
+#ifndef RcppML_predict
+#include <RcppML/predict.hpp>
+#endif
+
+namespace RcppML {
+
+// PRODUCTS OF SPARSE AND DENSE MATRICES
+//
+// Products of sparse "A" with dense factors, by the kernel that gathers the right-hand sides of "predict" (see
+//   "gatherTile"), for the products around a fit (e.g. "crossprod(w, A)" or "A %*% t(h)") at the speed of the fit
+//  * each column of the result is gathered from the columns of the dense matrix (stored with factors in rows) at the
+//      non-zeros of a column of "A", in parallel over tiles of columns of "A" with roughly equal numbers of non-zeros
+//      (see "colChunks"), so that no two threads write the same column
+//  * "A %*% y" is "t(t(y) %*% t(A))", gathered over columns of "t(A)", which is given by the caller so that a transpose
+//      that is cached (see "matrixCache") or read in place from a row-compressed matrix is not computed again
+
+// "x_t %*% A" for dense "x_t" of "k" rows by the rows of "A", as "k" rows by the columns of "A"
+template <typename Value>
+Eigen::MatrixXd crossprodSparse(const Eigen::MatrixXd& x_t, RcppML::SparseOf<Value>& A, const unsigned int threads) {
+    if (x_t.cols() != A.rows()) RcppML::fail("dimensions of the dense and sparse matrices are not compatible");
+    Eigen::MatrixXd result = Eigen::MatrixXd::Zero(x_t.rows(), A.cols());
+    const std::vector<int>& chunks = A.colChunks(PREDICT_TILE_SIZE);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+    for (int chunk = 0; chunk < (int)chunks.size() - 1; ++chunk) {
+        auto tile = result.middleCols(chunks[chunk], chunks[chunk + 1] - chunks[chunk]);
+        gatherTile(A, x_t, tile, chunks[chunk], chunks[chunk + 1] - chunks[chunk]);
+    }
+    return result;
+}
+
+// "A %*% y" for dense "y" of the columns of "A" by "k" columns, given "t_A = t(A)"
+template <typename Value>
+Eigen::MatrixXd prodSparse(RcppML::SparseOf<Value>& t_A, const Eigen::MatrixXd& y, const unsigned int threads) {
+    return crossprodSparse(Eigen::MatrixXd(y.transpose()), t_A, threads).transpose();
+}
+
+}  // namespace RcppML
+
+#endif
@@ -0,0 +1,437 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_stream
+#define RcppML_stream
+
+#ifndef RcppML_predict
+#include <RcppML/predict.hpp>
+#endif
+
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define RCPPML_STREAM_MMAP
+#endif
+
+#define RCPPML_STREAM_MAGIC "RCPPMLSC"
+
+namespace RcppML {
+
+// a chunk of consecutive columns of a sparse matrix in compressed sparse column format, with row indices in "i" and
+// column pointers in "p" relative to the start of the chunk
+struct SparseChunk {
+    unsigned int start = 0, cols = 0;  // index of the first column of the chunk in the full matrix, and number of columns
+    std::vector<int> p, i;
+    std::vector<double> x;
+
+    // copy to R vectors, which requires the R API and must not be called from a worker thread
+    Rcpp::SparseMatrix toSparseMatrix(const unsigned int rows) const {
+        return Rcpp::SparseMatrix(Rcpp::NumericVector(x.begin(), x.end()), Rcpp::IntegerVector(i.begin(), i.end()),
+                                  Rcpp::IntegerVector(p.begin(), p.end()), Rcpp::IntegerVector::create(rows, cols));
+    }
+};
+
+// a sparse matrix stored on disk as a sequence of column chunks, so that it never needs to be in memory all at once
+//  * file layout, in native byte order: "RCPPMLSC", uint32 rows, then for each chunk
+//      uint32 cols, uint32 nnz, int32 p[cols + 1], int32 i[nnz], double x[nnz]
+//  * chunks may be appended to an existing file with "writeSparseStream"
+//  * where available, the file is memory-mapped read-only, so chunks are copied from the OS page cache without reading
+//      the file, and concurrent processes streaming the same file share one copy of it in memory. Otherwise, chunks
+//      are read with "std::ifstream".
+class SparseMatrixStream {
+   public:
+    SparseMatrixStream(const std::string& path) : path(path) {
+        std::ifstream f(path.c_str(), std::ios::binary);
+        if (!f) Rcpp::stop("could not open '" + path + "'");
+        f.seekg(0, std::ios::end);
+        size = f.tellg();
+        f.seekg(0, std::ios::beg);
+        mapFile();
+        char magic[8];
+        if (!readAt(f, 0, magic, 8) || !readAt(f, 8, &rows_, sizeof(uint32_t)) || std::string(magic, 8) != RCPPML_STREAM_MAGIC)
+            Rcpp::stop("'" + path + "' is not an RcppML sparse matrix stream");
+
+        // index chunks from their headers
+        std::streamoff pos = 8 + sizeof(uint32_t);
+        uint32_t header[2];
+        while (pos < size) {
+            if (!readAt(f, pos, header, sizeof(header))) Rcpp::stop("'" + path + "' is truncated");
+            const std::streamoff end = pos + sizeof(header) + ((std::streamoff)header[0] + 1 + header[1]) * sizeof(int32_t) +
+                                       (std::streamoff)header[1] * sizeof(double);
+            if (end > size) Rcpp::stop("'" + path + "' is truncated");
+            offsets.push_back(pos);
+            starts.push_back(cols_);
+            cols_ += header[0];
+            pos = end;
+        }
+    }
+
+    unsigned int rows() const { return rows_; }
+    unsigned int cols() const { return cols_; }
+    unsigned int n_chunks() const { return offsets.size(); }
+
+    // read chunk "c" into "chunk", returning false on failure. Does not use the R API, so may be called from any thread.
+    bool read(const unsigned int c, SparseChunk& chunk) const {
+        std::ifstream f;
+        if (!map) f.open(path.c_str(), std::ios::binary);
+        std::streamoff pos = offsets[c];
+        uint32_t header[2];
+        if (!readAt(f, pos, header, sizeof(header))) return false;
+        chunk.start = starts[c];
+        chunk.cols = header[0];
+        chunk.p.resize(header[0] + 1);
+        chunk.i.resize(header[1]);
+        chunk.x.resize(header[1]);
+        pos += sizeof(header);
+        if (!readAt(f, pos, chunk.p.data(), chunk.p.size() * sizeof(int32_t))) return false;
+        pos += chunk.p.size() * sizeof(int32_t);
+        if (!readAt(f, pos, chunk.i.data(), chunk.i.size() * sizeof(int32_t))) return false;
+        pos += chunk.i.size() * sizeof(int32_t);
+        return readAt(f, pos, chunk.x.data(), chunk.x.size() * sizeof(double));
+    }
+
+   private:
+    std::string path;
+    std::streamoff size = 0;
+    std::shared_ptr<const char> map;  // read-only mapping of the whole file, if any, unmapped with the last copy
+    uint32_t rows_ = 0;
+    unsigned int cols_ = 0;
+    std::vector<std::streamoff> offsets;
+    std::vector<unsigned int> starts;
+
+    // map the file into memory, leaving "map" empty if it cannot be mapped
+    void mapFile() {
+#ifdef RCPPML_STREAM_MMAP
+        if (size <= 0) return;
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        void* addr = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) return;
+        const size_t length = size;
+        map = std::shared_ptr<const char>((const char*)addr, [length](const char* a) { munmap((void*)a, length); });
+#endif
+    }
+
+    // copy "n" bytes at offset "pos" of the file into "dst", from the mapping if there is one and otherwise from "f"
+    bool readAt(std::ifstream& f, const std::streamoff pos, void* dst, const size_t n) const {
+        if (pos < 0 || pos + (std::streamoff)n > size) return false;
+        if (map) {
+            std::memcpy(dst, map.get() + pos, n);
+            return true;
+        }
+        f.seekg(pos);
+        return (bool)f.read((char*)dst, n);
+    }
+};
+
+// a sparse matrix held in memory as a sequence of column blocks (e.g. a list of "dgCMatrix" in R), each with 32-bit
+// indices, so that the total number of non-zeros may exceed what one "dgCMatrix" can index
+//  * blocks are views of the R vectors of each "dgCMatrix", so the list is never combined or copied (see "forEachChunk")
+//  * R vectors are captured on construction, so blocks may be read without the R API from any thread
+class SparseMatrixList {
+   public:
+    SparseMatrixList(const Rcpp::List& blocks) {
+        for (unsigned int c = 0; c < (unsigned int)blocks.length(); ++c) {
+            Rcpp::SparseMatrix b(Rcpp::as<Rcpp::S4>(blocks[c]));
+            if (c == 0) rows_ = b.rows();
+            if (b.rows() != rows_) Rcpp::stop("all blocks of 'data' must have the same number of rows");
+            starts.push_back(cols_);
+            cols_ += b.cols();
+            nnz_ += b.p[b.cols()];
+            blocks_.push_back(b);
+        }
+    }
+
+    unsigned int rows() const { return rows_; }
+    unsigned int cols() const { return cols_; }
+    unsigned int n_chunks() const { return blocks_.size(); }
+    uint64_t nonZeros() const { return nnz_; }
+
+    // block "c", and the index of its first column in the full matrix
+    Rcpp::SparseMatrix& block(const unsigned int c) { return blocks_[c]; }
+    unsigned int start(const unsigned int c) const { return starts[c]; }
+
+   private:
+    std::vector<Rcpp::SparseMatrix> blocks_;
+    unsigned int rows_ = 0, cols_ = 0;
+    uint64_t nnz_ = 0;
+    std::vector<unsigned int> starts;
+};
+
+// call "f(A_c, start)" on each chunk "A_c" of "A" in order, where "start" is the index of its first column in "A"
+//  * the next chunk of a stream is read on a separate thread while "f" is called on the current chunk
+template <class F>
+void forEachChunk(SparseMatrixStream& A, F f) {
+    SparseChunk chunk, next;
+    if (A.n_chunks() > 0 && !A.read(0, chunk)) Rcpp::stop("could not read chunk 1 of the stream");
+    for (unsigned int c = 0; c < A.n_chunks(); ++c) {
+        std::future<bool> prefetch;
+        if (c + 1 < A.n_chunks())
+            prefetch = std::async(std::launch::async, &SparseMatrixStream::read, &A, c + 1, std::ref(next));
+
+        Rcpp::SparseMatrix A_c = chunk.toSparseMatrix(A.rows());
+        f(A_c, chunk.start);
+
+        if (c + 1 < A.n_chunks()) {
+            if (!prefetch.get()) Rcpp::stop("could not read chunk " + std::to_string(c + 2) + " of the stream");
+            std::swap(chunk, next);
+        }
+    }
+}
+
+// as above, for blocks of a list, which are passed in place without copying
+template <class F>
+void forEachChunk(SparseMatrixList& A, F f) {
+    for (unsigned int c = 0; c < A.n_chunks(); ++c) f(A.block(c), A.start(c));
+}
+
+// write columns [start, start + cols) of "A" to "f" as one chunk of a sparse matrix stream
+inline void writeSparseChunk(std::ofstream& f, Rcpp::SparseMatrix& A, const unsigned int start, const uint32_t cols) {
+    const int p0 = A.p[start];
+    const uint32_t header[2] = {cols, (uint32_t)(A.p[start + cols] - p0)};
+    std::vector<int32_t> p(cols + 1);
+    for (unsigned int j = 0; j <= cols; ++j)
+        p[j] = A.p[start + j] - p0;
+    f.write((const char*)header, sizeof(header));
+    f.write((const char*)p.data(), p.size() * sizeof(int32_t));
+    f.write((const char*)(A.i.begin() + p0), header[1] * sizeof(int32_t));
+    f.write((const char*)(A.x.begin() + p0), header[1] * sizeof(double));
+}
+
+inline void writeSparseStreamHeader(std::ofstream& f, const uint32_t rows) {
+    f.write(RCPPML_STREAM_MAGIC, 8);
+    f.write((const char*)&rows, sizeof(uint32_t));
+}
+
+// write "A" to "path" as a sparse matrix stream in chunks of "chunk_size" columns, appending to an existing stream if "append"
+inline void writeSparseStream(Rcpp::SparseMatrix& A, const std::string& path, const unsigned int chunk_size, const bool append) {
+    if (chunk_size == 0) Rcpp::stop("'chunk_size' must be greater than 0");
+    if (append) {
+        SparseMatrixStream s(path);
+        if (s.rows() != A.rows()) Rcpp::stop("number of rows in 'A' is not equal to the number of rows in the stream");
+    }
+    std::ofstream f(path.c_str(), append ? (std::ios::binary | std::ios::app) : (std::ios::binary | std::ios::trunc));
+    if (!f) Rcpp::stop("could not open '" + path + "' for writing");
+    if (!append) writeSparseStreamHeader(f, A.rows());
+    for (unsigned int start = 0; start < A.cols(); start += chunk_size)
+        writeSparseChunk(f, A, start, std::min(chunk_size, A.cols() - start));
+    if (!f) Rcpp::stop("could not write to '" + path + "'");
+}
+
+// project "w" onto a sparse matrix streamed from disk (or a list of blocks) to solve for "h" in "A = wh", one chunk at a time
+template <typename Scalar, class Source>
+void predict_stream(Source& A, const Eigen::Matrix<Scalar, -1, -1>& w, Eigen::Matrix<Scalar, -1, -1>& h, const double L1,
+                    const double L2, const unsigned int threads, const double upper_bound, const int solver) {
+    Rcpp::SparseMatrix empty;
+    linkIndex no_link;
+    forEachChunk(A, [&](Rcpp::SparseMatrix& A_c, const unsigned int start) {
+        Eigen::Matrix<Scalar, -1, -1> h_c(h.rows(), A_c.cols());
+        predict(A_c, empty, no_link, w, h_c, L1, L2, threads, false, false, false, upper_bound, solver);
+        h.middleCols(start, A_c.cols()) = h_c;
+        Rcpp::checkUserInterrupt();
+    });
+}
+
+// mean squared error of "A = w^T diag(d) h" for a sparse matrix streamed from disk (or a list of blocks), from
+//   "||A_j||^2 - 2 (wd A_j)^T h_j + h_j^T (wd wd^T) h_j" for each sample "j", one chunk at a time
+template <class Source>
+double mse_stream(Source& A, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h, const unsigned int threads) {
+    if (A.rows() != w.cols() || A.cols() != h.cols()) Rcpp::stop("dimensions of 'w', 'h' and 'A' are not compatible");
+    const Eigen::MatrixXd wd = d.asDiagonal() * w, a = wd * wd.transpose();
+    double loss = 0;
+    forEachChunk(A, [&](Rcpp::SparseMatrix& A_c, const unsigned int start) {
+        Eigen::ArrayXd losses = Eigen::ArrayXd::Zero(A_c.cols());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+        for (int j = 0; j < (int)A_c.cols(); ++j) {
+            Eigen::VectorXd b = Eigen::VectorXd::Zero(w.rows());
+            for (Rcpp::SparseMatrix::InnerIterator it(A_c, j); it; ++it) {
+                b += it.value() * wd.col(it.row());
+                losses(j) += it.value() * it.value();
+            }
+            losses(j) += (a * h.col(start + j) - 2 * b).dot(h.col(start + j));
+        }
+        loss += losses.sum();
+    });
+    return loss / ((double)A.rows() * A.cols());
+}
+
+// nmf of a sparse matrix streamed from disk in column chunks
+//  * "h" is updated chunk by chunk, while "hh^T" and "hA^T" are accumulated for the update of "w", so neither "A"
+//      nor its transpose is ever in memory
+//  * the next chunk is read from disk on a separate thread while the current chunk is solved
+//  * masking and linking are not supported
+//  * "Source" may also be a "SparseMatrixList" of column blocks in memory, whose total number of non-zeros may exceed
+//      2^31 since only one block at a time is indexed, and which are read in place
+template <typename Scalar = double, class Source = SparseMatrixStream>
+class nmf_stream {
+   public:
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+
+   private:
+    Source& A;
+    MatrixS w;
+    VectorS d;
+    MatrixS h;
+    double tol_ = -1, A_sq = -1;
+    unsigned int iter_ = 0;
+    std::vector<double> losses_;
+    std::vector<double> cd_tols_;  // coordinate descent tolerance of each iteration, if "inexact"
+
+   public:
+    bool verbose = true;
+    unsigned int maxit = 100, threads = 0;
+    std::vector<double> L1 = std::vector<double>(2), L2 = std::vector<double>(2);
+    bool sort_model = true;
+    double upper_bound = 0;  // set to 0 or negative to not impose upper bound limit
+    int solver = NNLS_AUTO;  // solver for least squares updates without an upper bound (see "useActiveSet")
+    double tol = 1e-4;
+    bool loss_tol = false;  // stop on relative change in loss, rather than correlation of "w" across iterations
+    bool inexact = false;   // loosen coordinate descent tolerance in early iterations (see "inexactTol")
+
+    nmf_stream(Source& A, MatrixS w) : A(A), w(w) {
+        if (A.rows() != w.cols()) Rcpp::stop("number of rows in 'A' and columns in 'w' are not equal!");
+        d = VectorS::Ones(w.rows());
+        h = MatrixS(w.rows(), A.cols());
+    }
+
+    // GETTERS
+    const MatrixS& matrixW() const { return w; }
+    const VectorS& vectorD() const { return d; }
+    const MatrixS& matrixH() const { return h; }
+    double fit_tol() { return tol_; }
+    unsigned int fit_iter() { return iter_; }
+    std::vector<double> fit_losses() { return losses_; }
+    std::vector<double> fit_cd_tols() { return cd_tols_; }
+
+    void sortByDiagonal() {
+        if (w.rows() < 2) return;
+        std::vector<int> indx = sort_index(d);
+        w = reorder_rows(w, indx);
+        d = reorder(d, indx);
+        h = reorder_rows(h, indx);
+    }
+
+    // fit the model by alternating least squares, with one pass over "A" per iteration
+    void fit() {
+        if (verbose) Rprintf("\n%4s | %8s \n---------------\n", "iter", "tol");
+        for (; iter_ < maxit; ++iter_) {
+            MatrixS w_it;
+            if (!loss_tol) w_it = w;
+            double stop_tol = cd_tol<Scalar>();
+            if (inexact) {
+                stop_tol = inexactTol<Scalar>(cd_tols_.empty() ? 0 : cd_tols_.back(), tol_);
+                cd_tols_.push_back(stop_tol);
+            }
+
+            // update "h", accumulating "hh^T" and "hA^T"
+            MatrixS a = MatrixS::Zero(w.rows(), w.rows());
+            MatrixS B = MatrixS::Zero(w.rows(), w.cols());
+            sweep(a, B, stop_tol);
+
+            // scale rows in "h" to sum to 1, and scale the accumulated statistics to match
+            d = h.rowwise().sum();
+            d.array() += TINY_NUM;
+            for (unsigned int i = 0; i < h.rows(); ++i) {
+                h.row(i) /= d(i);
+                B.row(i) /= d(i);
+                for (unsigned int j = 0; j < h.rows(); ++j)
+                    a(i, j) /= d(i) * d(j);
+            }
+
+            // update "w"
+            double loss = 0;
+            predict_gram(a, B, w, L1[0], L2[0], threads, upper_bound, solver, stop_tol, loss_tol ? &loss : NULL);
+            d = w.rowwise().sum();
+            d.array() += TINY_NUM;
+            for (unsigned int i = 0; i < w.rows(); ++i)
+                w.row(i) /= d(i);
+
+            if (loss_tol) {
+                const double mse_it = std::max(A_sq + loss, 0.0) / ((h.cols() * w.cols()));
+                tol_ = losses_.empty() ? 1 : std::abs(losses_.back() - mse_it) / (losses_.back() + TINY_NUM);
+                losses_.push_back(mse_it);
+            } else {
+                tol_ = cor(w, w_it);
+            }
+            if (verbose) Rprintf("%4d | %8.2e\n", iter_ + 1, tol_);
+            if (tol_ < tol) break;
+            Rcpp::checkUserInterrupt();
+        }
+
+        if (tol_ > tol && iter_ == maxit && verbose)
+            Rprintf(" convergence not reached in %d iterations\n  (actual tol = %4.2e, target tol = %4.2e)\n", iter_, tol_, tol);
+
+        if (sort_model) sortByDiagonal();
+    }
+
+   private:
+    // update "h" for each chunk of "A" with coordinate descent tolerance "stop_tol", adding "hh^T" to "a" and "hA^T" to "B"
+    //  * "hA^T" is accumulated in one buffer per thread over a static partition of columns in each chunk, and the
+    //      buffers are summed in order at the end, so results do not depend on thread scheduling
+    //  * if "reproducible", each column of "hA^T" is instead accumulated by one thread over a transpose of each chunk,
+    //      in the order of columns in "A", so results do not depend on the number of threads either
+    void sweep(MatrixS& a, MatrixS& B, const double stop_tol) {
+        unsigned int n_threads = 1;
+#ifdef _OPENMP
+        n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+#endif
+        const bool by_row = reproducible();
+        std::vector<MatrixS> B_t(by_row ? 0 : n_threads, MatrixS::Zero(B.rows(), B.cols()));
+        const bool calc_norm = A_sq < 0;
+        double sq = 0;
+        Rcpp::SparseMatrix empty;
+        linkIndex no_link;
+        forEachChunk(A, [&](Rcpp::SparseMatrix& A_c, const unsigned int start) {
+            MatrixS h_c(h.rows(), A_c.cols());
+            predict(A_c, empty, no_link, w, h_c, L1[1], L2[1], threads, false, false, false, upper_bound, solver, stop_tol);
+            h.middleCols(start, A_c.cols()) = h_c;
+            gramUpdate(a, h_c);
+            if (by_row) {
+                Rcpp::SparseMatrix t_A_c = A_c.transpose(n_threads);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(dynamic)
+#endif
+                for (int i = 0; i < (int)t_A_c.cols(); ++i)
+                    for (Rcpp::SparseMatrix::InnerIterator it(t_A_c, i); it; ++it)
+                        B.col(i) += (Scalar)it.value() * h_c.col(it.row());
+                if (calc_norm) sq += squaredNorm(A_c);
+                return;
+            }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_threads) schedule(static)
+#endif
+            for (int j = 0; j < (int)A_c.cols(); ++j) {
+                unsigned int t = 0;
+#ifdef _OPENMP
+                t = omp_get_thread_num();
+#endif
+                for (Rcpp::SparseMatrix::InnerIterator it(A_c, j); it; ++it)
+                    B_t[t].col(it.row()) += (Scalar)it.value() * h_c.col(j);
+            }
+            if (calc_norm) sq += squaredNorm(A_c);
+        });
+        for (unsigned int t = 0; t < B_t.size(); ++t)
+            B += B_t[t];
+        gramSymmetrize(a);
+        if (calc_norm) A_sq = sq;
+    }
+};
+}  // namespace RcppML
+
+#endif
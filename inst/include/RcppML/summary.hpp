@@ -0,0 +1,101 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_summary
+#define RcppML_summary
+
+#ifndef RcppML_threads
+#include <RcppML/threads.hpp>
+#endif
+
+#include <vector>
+
+namespace RcppML {
+
+// sums and non-zeros of the values of each factor in each group of samples or features, and the size of each group
+//  * "sums" and "nonzeros" are factors (rows) by groups (columns)
+struct groupSummary {
+    Eigen::MatrixXd sums, nonzeros;
+    Eigen::VectorXd sizes;
+
+    groupSummary(const unsigned int k, const unsigned int n_groups)
+        : sums(Eigen::MatrixXd::Zero(k, n_groups)), nonzeros(Eigen::MatrixXd::Zero(k, n_groups)), sizes(Eigen::VectorXd::Zero(n_groups)) {}
+
+    groupSummary& operator+=(const groupSummary& other) {
+        sums += other.sums;
+        nonzeros += other.nonzeros;
+        return *this;
+    }
+};
+
+// call "f(row, value)" for each non-zero in column "j" of a dense or sparse matrix
+template <typename F>
+inline void forNonZeros(const Eigen::Ref<const Eigen::MatrixXd>& x, const int j, F f) {
+    for (int r = 0; r < x.rows(); ++r)
+        if (x(r, j) != 0) f(r, x(r, j));
+}
+
+template <typename F>
+inline void forNonZeros(RcppML::SparseOf<double>& x, const int j, F f) {
+    for (RcppML::SparseOf<double>::InnerIterator it(x, j); it; ++it)
+        if (it.value() != 0) f(it.row(), it.value());
+}
+
+// summarize groups of the columns (samples) of "h" or of the rows (features) of "w" in one pass over the model, without
+//   copying the values in each group
+//  * "x" is "h" (factors by samples) if "by_col", or otherwise "w" (features by factors), dense or sparse
+//  * "group" has the 0-based group of each sample or feature, or a negative value if it is in no group
+//  * columns of "h" are split into one block per thread, each summed into its own "groupSummary", and blocks are added
+//      in order, so results depend on "threads" only by rounding. Columns of "w" are factors, which are summarized in
+//      parallel without any reduction.
+template <typename Mat>
+inline groupSummary summarizeGroups(Mat& x, const std::vector<int>& group, const unsigned int n_groups, const bool by_col,
+                                    unsigned int threads) {
+    const unsigned int k = by_col ? x.rows() : x.cols();
+    if (group.size() != (size_t)(by_col ? x.cols() : x.rows())) RcppML::fail("length of 'group' is not equal to the number of samples or features");
+    groupSummary result(k, n_groups);
+    for (const int g : group)
+        if (g >= (int)n_groups) RcppML::fail("'group' has groups that are out of range");
+        else if (g >= 0) ++result.sizes(g);
+    const int n = x.cols();
+    if (threads == 0) threads = kernelThreads(0, (double)k * n, 8.0 * k * n);
+    if (!by_col) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+#endif
+        for (int f = 0; f < n; ++f) {
+            forNonZeros(x, f, [&](const int r, const double v) {
+                if (group[r] < 0) return;
+                result.sums(f, group[r]) += v;
+                ++result.nonzeros(f, group[r]);
+            });
+        }
+        return result;
+    }
+    threads = std::max(1u, std::min(threads, (unsigned int)n));
+    std::vector<groupSummary> blocks(threads, groupSummary(k, n_groups));
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1)
+#endif
+    for (unsigned int b = 0; b < threads; ++b) {
+        groupSummary& block = blocks[b];
+        for (int j = (int)((double)n * b / threads); j < (int)((double)n * (b + 1) / threads); ++j) {
+            const int g = group[j];
+            if (g < 0) continue;
+            forNonZeros(x, j, [&](const int f, const double v) {
+                block.sums(f, g) += v;
+                ++block.nonzeros(f, g);
+            });
+        }
+    }
+    for (const groupSummary& block : blocks) result += block;
+    return result;
+}
+
+}  // namespace RcppML
+
+#endif
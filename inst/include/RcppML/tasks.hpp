@@ -0,0 +1,128 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_tasks
+#define RcppML_tasks
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+
+// TASKS
+//
+// Drivers that fit many models at once (restarts, penalties, replicates and cross-validation of "nmf") and the
+//   kernels of each model share one team of threads through OpenMP tasks, rather than dividing threads between
+//   nested parallel regions, which either oversubscribe the machine or leave threads idle once some models finish:
+//  * a driver runs its models in tasks of one team of all of its threads (see "forSlots")
+//  * a kernel called from a task (see "inTeam") runs its workers as child tasks (see "forWorkers"), which idle threads
+//      of the team take from the runtime's task queues. The calling thread waits for them at a task scheduling point,
+//      where it runs those of its workers that no other thread has taken, and since tasks are tied it runs no task
+//      of another model in the meantime.
+//  * workers take items (e.g. tiles of columns with roughly equal numbers of non-zeros, see "colChunks") from a shared
+//      counter (see "taskCounter"), so they balance like "schedule(dynamic)" for any number of threads that take part
+//  * kernels that loop over independent items without per-worker state take them from "forEach"
+//  * a driver does not change the nesting of parallel regions, so any parallel region of a kernel called from a task
+//      that is not run by "forWorkers" is nested, and has one thread unless nesting was enabled by the user
+namespace RcppML {
+
+// true within a parallel region of more than one thread, such as in a task of "forSlots", where kernels run their
+//   workers as tasks of that team rather than in a nested parallel region
+inline bool inTeam() {
+#ifdef _OPENMP
+    return omp_in_parallel();
+#else
+    return false;
+#endif
+}
+
+// next item of [0, n) for workers that share it
+class taskCounter {
+   public:
+    taskCounter(const int n) : n(n), next(0) {}
+    bool take(int& i) {
+        i = next.fetch_add(1, std::memory_order_relaxed);
+        return i < n;
+    }
+
+   private:
+    const int n;
+    std::atomic<int> next;
+};
+
+// call "worker(w, n_workers)" for each of "n_workers" workers, which take their items from a shared "taskCounter"
+//  * within a team (see "inTeam"), each worker is a task of that team, and "n_workers" is at most the size of the team
+//  * otherwise, each worker is a thread of a new parallel region of "threads" threads, with "w" its thread number, so
+//      workers may synchronize at barriers
+template <class F>
+void forWorkers(const unsigned int threads, F worker) {
+#ifdef _OPENMP
+    const int n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+    if (n_threads > 1 && inTeam()) {
+        const int n_workers = std::min(n_threads, omp_get_num_threads());
+#pragma omp taskgroup
+        {
+            for (int w = 0; w < n_workers; ++w) {
+#pragma omp task firstprivate(w) shared(worker)
+                worker(w, n_workers);
+            }
+        }
+        return;
+    }
+#pragma omp parallel num_threads(n_threads)
+    worker(omp_get_thread_num(), omp_get_num_threads());
+#else
+    worker(0, 1);
+#endif
+}
+
+// call "f(i)" for each "i" in [0, n) from the workers of "forWorkers", like "parallel for" with "schedule(dynamic)"
+//   but within the team of a driver if called from one of its tasks
+template <class F>
+void forEach(const int n, const unsigned int threads, F f) {
+    taskCounter items(n);
+    forWorkers(threads, [&](const int, const int) {
+        int i;
+        while (items.take(i)) f(i);
+    });
+}
+
+// call "f(i, slot)" for each "i" in [0, n), from "n_slots" tasks of a team of "threads" threads that each take items in
+//   turn, so that no more than "n_slots" items are in progress at once and "slot" may index state reused by the items
+//   of one task
+//  * the team has all "threads" threads even if there are fewer slots, so that threads without a slot run the workers
+//      of kernels called by "f" (see "forWorkers")
+template <class F>
+void forSlots(const unsigned int n, unsigned int n_slots, const unsigned int threads, F f) {
+    n_slots = std::max(1u, std::min(n_slots, n));
+    taskCounter items(n);
+    const auto slot = [&](const unsigned int s) {
+        int i;
+        while (items.take(i)) f((unsigned int)i, s);
+    };
+#ifdef _OPENMP
+    const int n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+    if (n_threads > 1 && n_slots > 1 && !inTeam()) {
+#pragma omp parallel num_threads(n_threads)
+#pragma omp single
+        {
+            for (unsigned int s = 0; s < n_slots; ++s) {
+#pragma omp task firstprivate(s) shared(slot)
+                slot(s);
+            }
+        }
+        return;
+    }
+#endif
+    for (unsigned int s = 0; s < n_slots; ++s) slot(s);
+}
+
+}  // namespace RcppML
+
+#endif
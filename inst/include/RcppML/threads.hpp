@@ -0,0 +1,443 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2021 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+#ifndef RcppML_threads
+#define RcppML_threads
+
+#ifndef RcppML_common
+#include <RcppMLCommon.hpp>
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+// THREADS FOR EACH KERNEL CALL
+//
+// With "threads = 0", each update and loss of a model uses as many threads as its cost warrants, rather than all
+//   threads for every call:
+//  * each thread is given at least "min_work" floating point operations, below which forking and joining threads
+//      costs more than the work they share, as for small inputs on many cores
+//  * calls that do fewer than THREAD_MEMORY_BOUND_INTENSITY flops per byte read are limited by memory bandwidth, and
+//      use no more than "bandwidth_threads", the threads beyond which bandwidth no longer grows
+// Defaults do not depend on the machine. "calibrateThreads" measures both on this machine, once per session.
+// Tiles of columns are already scheduled dynamically and balanced by non-zeros (see "colChunks"), so only the number
+//   of threads is chosen. With NUMA placement, all threads are used (see below).
+namespace RcppML {
+
+struct threadModel {
+    double min_work = THREAD_MIN_WORK;   // flops per thread
+    unsigned int bandwidth_threads = 0;  // threads that saturate memory bandwidth, or 0 if not known
+    bool numa = false;                   // place threads and the data they read by NUMA node (see "numaPlacement")
+    bool reproducible = false;           // sums do not depend on the number of threads (see "setReproducible")
+    bool huge_pages = false;             // back large buffers of a fit with transparent huge pages (see "adviseHugePages")
+    int eigen_threads = 0;               // threads of products within Eigen, or 0 for all (see "eigenThreads")
+};
+
+inline threadModel& threadCosts() {
+    static threadModel model;
+    return model;
+}
+
+// REPRODUCIBLE REDUCTIONS
+//
+// Sums over the columns of "A" (losses, "hh^T", "hA^T") are accumulated into fixed blocks, such as one loss for each
+//   column or tile of columns, which are then added in order, so that they do not depend on the number of threads or
+//   on the schedule. Sums that would need a large buffer for each block are instead accumulated in one buffer per
+//   thread, unless "reproducible":
+//  * "hA^T" of streaming nmf is assembled one column at a time from a transpose of each chunk (see "nmfStream::sweep")
+//  * "w" of "bipartition" is updated on one thread
+//  * products within Eigen run on one thread, since Eigen blocks a product, and so orders its sums, differently when
+//      it runs on several threads, and it does so whenever it is called from outside a parallel region of more than
+//      one thread, such as one of "threads = 1"
+// A fit is then identical for any "threads" on the same machine and build. Sums over the partitions of
+//   "nmf::fit_distributed" still depend on the partitions and on the allreduce.
+inline bool reproducible() { return threadCosts().reproducible; }
+
+inline void setReproducible(const bool reproducible) {
+    threadCosts().reproducible = reproducible;
+    threadCosts().eigen_threads = reproducible ? 1 : 0;
+#ifdef _OPENMP
+    Eigen::setNbThreads(threadCosts().eigen_threads);
+#endif
+}
+
+// EIGEN'S THREADS
+//
+// Eigen runs a large product on threads of its own whenever it is called from outside a parallel region of more than one
+//   thread (see "Eigen::internal::parallelize_gemm"), on "Eigen::nbThreads()" threads, which are all cores unless set,
+//   whatever "threads" the call was given. Kernels with dense products therefore hold an "eigenThreads" scope, which
+//   gives Eigen the threads of the kernel and restores the last setting on exit:
+//  * products within parallel loops of several threads (e.g. "w * A" of each tile) run on one thread each, as Eigen
+//      already does, and products within loops of one thread, such as a loop over too little work to share or with
+//      "threads = 1", on no more threads than the kernel was given
+//  * BLAS-3 products outside parallel loops use all threads of the kernel. Gram matrices, which Eigen computes on one
+//      thread, are computed on the threads of the kernel in blocks of columns (see "gram").
+//  * with "reproducible", products run on one thread (see "setReproducible")
+// Eigen's threads are shared by all threads, so scopes entered within a parallel region change nothing. Scopes may
+//   also overlap, when nested or held by fits that run at once on threads of their own (e.g. "nmfAsync"), so they
+//   are counted under a lock: Eigen has the threads of the last scope to enter, and the setting before the first
+//   scope is restored when the last one exits, rather than each scope restoring a setting that another has changed.
+class eigenThreads {
+   public:
+    explicit eigenThreads(const unsigned int threads) {
+#ifdef _OPENMP
+        if (omp_in_parallel()) return;
+        active = true;
+        std::lock_guard<std::mutex> lock(scopes().mutex);
+        if (scopes().n++ == 0) scopes().previous = threadCosts().eigen_threads;
+        set(reproducible() ? 1 : (int)threads);
+#endif
+    }
+
+    ~eigenThreads() {
+        if (!active) return;
+        std::lock_guard<std::mutex> lock(scopes().mutex);
+        if (--scopes().n == 0) set(scopes().previous);
+    }
+
+    eigenThreads(const eigenThreads&) = delete;
+    eigenThreads& operator=(const eigenThreads&) = delete;
+
+   private:
+    bool active = false;
+
+    struct scopeCount {
+        std::mutex mutex;
+        unsigned int n = 0;
+        int previous = 0;
+    };
+
+    static scopeCount& scopes() {
+        static scopeCount count;
+        return count;
+    }
+
+    static void set(const int threads) {
+        threadCosts().eigen_threads = threads;
+#ifdef _OPENMP
+        Eigen::setNbThreads(threads);
+#endif
+    }
+};
+
+// NUMA PLACEMENT
+//
+// On machines with several NUMA nodes (e.g. sockets), memory is placed on the node of the thread that first writes it,
+//   and threads that read memory of another node pay for every cache miss. With "numa" (see "threadCosts"):
+//  * threads of "nmf" are pinned to the CPUs of a node for the duration of the fit, with consecutive threads on the
+//      same node (see "numaPlacement")
+//  * tiles of columns in sparse updates are divided statically among threads by their non-zeros (see "staticBlock"),
+//      rather than scheduled dynamically, so that each thread reads the same columns of "A" and "t(A)" and writes the
+//      same columns of "h" and "w" in every iteration
+//  * copies of "A" and "t(A)" are written by the threads that read them (see "placedCopy")
+//  * each node reads its own copy of "w", and each thread its own gram matrix, in sparse updates (see "predict_unmasked")
+// Nodes are read from sysfs on Linux. Elsewhere, or with one node, threads are not pinned and data is not copied.
+
+// CPUs listed as "0-3,8,10-11" in sysfs
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        const std::string range = list.substr(pos, end - pos);
+        const size_t dash = range.find('-');
+        if (!range.empty() && range.find_first_not_of("0123456789-\n ") == std::string::npos) {
+            const int first = std::atoi(range.c_str()), last = (dash == std::string::npos) ? first : std::atoi(range.c_str() + dash + 1);
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+// CPUs of each NUMA node that has any, read once
+inline const std::vector<std::vector<int> >& numaNodes() {
+    static const std::vector<std::vector<int> > nodes = []() {
+        std::vector<std::vector<int> > nodes;
+#ifdef __linux__
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string list;
+        if (online && std::getline(online, list)) {
+            for (const int node : parseCpuList(list)) {
+                std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                std::string cpus;
+                if (cpulist && std::getline(cpulist, cpus) && !parseCpuList(cpus).empty()) nodes.push_back(parseCpuList(cpus));
+            }
+        }
+#endif
+        return nodes;
+    }();
+    return nodes;
+}
+
+// NUMA placement is on, there are several nodes, and this is not a model fit within a parallel region (such as one of
+//   several restarts fit at once), whose copies of "A" and pinned threads would conflict with those of the others
+inline bool numaActive() {
+#ifdef _OPENMP
+    if (omp_in_parallel()) return false;
+#endif
+    return threadCosts().numa && numaNodes().size() > 1;
+}
+
+// number of groups of consecutive threads, one for each NUMA node, among "n_threads" threads in NUMA placement
+inline unsigned int numaGroups(const unsigned int n_threads) {
+    if (!numaActive()) return 1;
+    return std::max(1u, std::min((unsigned int)numaNodes().size(), n_threads));
+}
+
+// group of thread "thread" of "n_threads" in "n_groups" groups of consecutive threads
+inline unsigned int numaGroup(const unsigned int thread, const unsigned int n_threads, const unsigned int n_groups) {
+    return (unsigned int)((uint64_t)thread * n_groups / n_threads);
+}
+
+// first and last (exclusive) of "n" items owned by thread "thread" of "n_threads" in a static partition
+inline void staticBlock(const int n, const int thread, const int n_threads, int& first, int& last) {
+    first = (int)((int64_t)thread * n / n_threads);
+    last = (int)((int64_t)(thread + 1) * n / n_threads);
+}
+
+// pins each of "threads" threads (0 for all) to the CPUs of its NUMA node while in scope, if "numa", and restores
+//   the affinity of each thread when it goes out of scope
+//  * the OpenMP runtime keeps its threads across parallel regions, so regions of up to "threads" threads in scope
+//      run on the same CPUs
+//  * CPUs outside the affinity of a thread (e.g. given by "taskset") are never used
+class numaPlacement {
+   public:
+    numaPlacement(const bool numa, const unsigned int threads) {
+#if defined(_OPENMP) && defined(__linux__)
+        if (!numa || !numaActive()) return;
+        n_threads = (threads == 0) ? omp_get_max_threads() : threads;
+        saved.resize(n_threads);
+        const unsigned int n_groups = std::min((unsigned int)numaNodes().size(), n_threads);
+#pragma omp parallel num_threads(n_threads)
+        {
+            const unsigned int thread = omp_get_thread_num();
+            cpu_set_t& mask = saved[thread];
+            CPU_ZERO(&mask);
+            if (sched_getaffinity(0, sizeof(cpu_set_t), &mask) == 0) {
+                cpu_set_t node_mask;
+                CPU_ZERO(&node_mask);
+                for (const int cpu : numaNodes()[numaGroup(thread, omp_get_num_threads(), n_groups)])
+                    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &mask)) CPU_SET(cpu, &node_mask);
+                if (CPU_COUNT(&node_mask) > 0) sched_setaffinity(0, sizeof(cpu_set_t), &node_mask);
+            }
+        }
+#else
+        (void)numa;
+        (void)threads;
+#endif
+    }
+    ~numaPlacement() {
+#if defined(_OPENMP) && defined(__linux__)
+        if (saved.empty()) return;
+#pragma omp parallel num_threads(n_threads)
+        {
+            const cpu_set_t& mask = saved[omp_get_thread_num()];
+            if (CPU_COUNT(&mask) > 0) sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+        }
+#endif
+    }
+    numaPlacement(const numaPlacement&) = delete;
+    numaPlacement& operator=(const numaPlacement&) = delete;
+
+   private:
+#if defined(_OPENMP) && defined(__linux__)
+    unsigned int n_threads = 0;
+    std::vector<cpu_set_t> saved;
+#endif
+};
+
+// uninitialized storage for "n" values, so that each value is first written by the thread that will read it
+template <class Values>
+inline Values untouchedValues(const int n) { return Values(n); }
+#if !RCPPML_NO_R
+template <>
+inline Rcpp::NumericVector untouchedValues<Rcpp::NumericVector>(const int n) { return Rcpp::NumericVector(Rcpp::no_init(n)); }
+
+// copy of "A" whose non-zeros in each static block of tiles of columns (see "colChunks" and "staticBlock") are written
+//   by the thread of "threads" that updates them, which places them on the NUMA node of that thread
+//  * values stored as "double" and all row indices are placed. Compact values (see "SparseValues") are zeroed when
+//      they are allocated, which places them on the node of the calling thread, and pattern values are not stored.
+template <typename Value>
+Rcpp::SparseMatrixOf<Value> placedCopy(Rcpp::SparseMatrixOf<Value>& A, const unsigned int threads) {
+    typedef typename Rcpp::SparseMatrixOf<Value>::Values Values;
+    const int nnz = A.p[A.cols()];
+    const std::vector<int>& tiles = A.colChunks(PREDICT_TILE_SIZE);
+    const int num_tiles = tiles.size() - 1;
+    Values x = untouchedValues<Values>(nnz);
+    Rcpp::IntegerVector i = Rcpp::no_init(nnz);
+    const int* A_i = (nnz > 0) ? &A.i[0] : nullptr;
+    int* i_ = (nnz > 0) ? &i[0] : nullptr;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+    {
+        int thread = 0, n_threads = 1, first, last;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        n_threads = omp_get_num_threads();
+#endif
+        staticBlock(num_tiles, thread, n_threads, first, last);
+        for (int k = A.p[tiles[first]]; k < A.p[tiles[last]]; ++k) {
+            i_[k] = A_i[k];
+            Rcpp::copyValue(x, k, A.x, k);
+        }
+    }
+    return Rcpp::SparseMatrixOf<Value>(x, i, A.p, A.Dim);
+}
+#endif
+
+// HUGE PAGES
+//
+// Large buffers of a fit are read in an order that the TLB does not follow, such as "w.col(it.row())" for each non-zero
+//   of "A", so that with 4 KB pages most reads of a buffer of several GB also miss the TLB. With "huge_pages" (see
+//   "threadCosts"), buffers of at least HUGE_PAGE_MIN_BYTES that a fit owns ("w", "h", "t(A)" and copies of "A" placed
+//   by NUMA node) are backed by transparent huge pages of 2 MB:
+//  * the whole huge pages within a buffer are advised with "madvise(MADV_HUGEPAGE)", so that the kernel backs them with
+//      huge pages even where it is configured to do so only for advised memory
+//  * buffers have already been written when they are advised (Eigen zeroes new matrices, and R vectors are filled as
+//      they are allocated), so they are also collapsed into huge pages at once with "MADV_COLLAPSE" (Linux 6.1), rather
+//      than later by "khugepaged"
+//  * data given to a fit, and buffers that it shares with later fits (see "matrixCache"), are not advised
+// Huge pages are used on Linux only.
+
+// advise the huge pages within "bytes" at "p", and return the bytes advised
+inline size_t adviseHugePages(const void* p, const size_t bytes) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (!threadCosts().huge_pages || p == nullptr || bytes < HUGE_PAGE_MIN_BYTES) return 0;
+    const uintptr_t page = (uintptr_t)1 << 21;
+    const uintptr_t first = ((uintptr_t)p + page - 1) & ~(page - 1), last = ((uintptr_t)p + bytes) & ~(page - 1);
+    if (last <= first || madvise((void*)first, last - first, MADV_HUGEPAGE) != 0) return 0;
+#ifdef MADV_COLLAPSE
+    madvise((void*)first, last - first, MADV_COLLAPSE);  // fails where it is not supported, leaving it to "khugepaged"
+#endif
+    return last - first;
+#else
+    (void)p;
+    (void)bytes;
+    return 0;
+#endif
+}
+
+template <class Derived>
+inline size_t adviseHugePages(const Eigen::PlainObjectBase<Derived>& m) {
+    return adviseHugePages(m.data(), m.size() * sizeof(typename Derived::Scalar));
+}
+
+#if !RCPPML_NO_R
+inline size_t adviseValues(const Rcpp::NumericVector& x) { return adviseHugePages(x.begin(), x.size() * sizeof(double)); }
+template <typename Value>
+inline size_t adviseValues(Rcpp::SparseValues<Value>& x) { return (x.size() > 0) ? adviseHugePages(&x[0], x.size() * sizeof(Value)) : 0; }
+inline size_t adviseValues(Rcpp::SparseValues<Rcpp::SparsePattern>&) { return 0; }
+
+// row indices and values of sparse "A"
+template <typename Value>
+inline size_t adviseHugePages(Rcpp::SparseMatrixOf<Value>& A) {
+    return adviseHugePages(A.i.begin(), A.i.size() * sizeof(int)) + adviseValues(A.x);
+}
+#endif
+
+// threads for a call of "flops" floating point operations over "bytes" of input, or "threads" if it is not 0
+inline unsigned int kernelThreads(const unsigned int threads, const double flops, const double bytes) {
+    if (threads > 0) return threads;
+#ifdef _OPENMP
+    const threadModel& model = threadCosts();
+    if (numaActive()) return omp_get_max_threads();  // placement is by thread, so every call uses the same threads
+    unsigned int n = omp_get_max_threads();
+    n = (unsigned int)std::max(1.0, std::min((double)n, std::ceil(flops / model.min_work)));
+    if (model.bandwidth_threads > 0 && flops < THREAD_MEMORY_BOUND_INTENSITY * bytes) n = std::min(n, model.bandwidth_threads);
+    return n;
+#else
+    return 1;
+#endif
+}
+
+// threads for a least squares update of "n" columns of rank "k" from "values" values of "A" in "n_features" rows
+//  * right-hand sides take "2k" flops per value, the gram matrix "2k^2" per feature, and coordinate descent about
+//      "2k^2" per sweep of each column, of which there are usually a few
+inline unsigned int updateThreads(const unsigned int threads, const double values, const unsigned int k, const unsigned int n,
+                                  const unsigned int n_features) {
+    const double flops = 2.0 * k * values + 2.0 * k * k * (n_features + 4.0 * n);
+    const double bytes = values * (sizeof(double) + sizeof(int)) + (double)k * (n + n_features) * sizeof(double);
+    return kernelThreads(threads, flops, bytes);
+}
+
+// measure "threadCosts" on this machine for "max_threads" threads (0 for all)
+//  * "min_work" is the work that one thread does in ten times the time it takes to fork and join all threads
+//  * "bandwidth_threads" is the fewest threads that read a buffer much larger than cache at 90% of the fastest rate
+//      of any number of threads
+inline threadModel calibrateThreads(unsigned int max_threads = 0) {
+    threadModel model;
+#ifdef _OPENMP
+    if (max_threads == 0) max_threads = omp_get_max_threads();
+    typedef std::chrono::steady_clock clock;
+
+    // fork and join
+    const int n_forks = 200;
+    volatile int sink = 0;
+    clock::time_point start = clock::now();
+    for (int rep = 0; rep < n_forks; ++rep) {
+#pragma omp parallel num_threads(max_threads)
+        {
+            if (omp_get_thread_num() == 0) sink = sink + 1;
+        }
+    }
+    const double fork_seconds = std::chrono::duration<double>(clock::now() - start).count() / n_forks;
+
+    // flops of one thread in an axpy that stays in cache
+    const int n_axpy = 4096, axpy_reps = 2000;
+    std::vector<double> x(n_axpy, 1), y(n_axpy, 0);
+    start = clock::now();
+    for (int rep = 0; rep < axpy_reps; ++rep) {
+        const double alpha = 1e-9 * (rep + 1);
+        for (int i = 0; i < n_axpy; ++i) y[i] += alpha * x[i];
+    }
+    const double flop_rate = 2.0 * n_axpy * axpy_reps / std::chrono::duration<double>(clock::now() - start).count();
+    sink = sink + (y[n_axpy - 1] > 0);
+    model.min_work = std::max(10 * fork_seconds * flop_rate, 1e3);
+
+    // bandwidth of sums over a buffer much larger than cache, for doubling numbers of threads
+    const size_t n_buffer = (size_t)1 << 24;
+    std::vector<double> buffer(n_buffer, 1);
+    double best = 0;
+    std::vector<std::pair<unsigned int, double> > rates;
+    for (unsigned int t = 1;; t = std::min(2 * t, max_threads)) {
+        double fastest = 0;
+        for (int rep = 0; rep < 3; ++rep) {
+            double sum = 0;
+            start = clock::now();
+#pragma omp parallel for num_threads(t) schedule(static) reduction(+ : sum)
+            for (int64_t i = 0; i < (int64_t)n_buffer; ++i) sum += buffer[i];
+            fastest = std::max(fastest, n_buffer * sizeof(double) / std::chrono::duration<double>(clock::now() - start).count());
+            sink = sink + (sum > 0);
+        }
+        rates.push_back(std::make_pair(t, fastest));
+        best = std::max(best, fastest);
+        if (t == max_threads) break;
+    }
+    for (const std::pair<unsigned int, double>& rate : rates) {
+        if (rate.second >= 0.9 * best) {
+            model.bandwidth_threads = rate.first;
+            break;
+        }
+    }
+#else
+    (void)max_threads;
+#endif
+    return model;
+}
+
+}  // namespace RcppML
+
+#endif
@@ -29,13 +29,162 @@
 #define CD_MAXIT 100
 #endif
 
+// count the work of least squares solvers and right-hand side gathers in each thread (see "hotCounters"), which is
+// compiled only with "-DRCPPML_COUNTERS" (e.g. in PKG_CPPFLAGS), so that regressions in the solvers show up as changes
+// in counts rather than in timings alone
+#ifndef RCPPML_COUNTERS
+#define RCPPML_COUNTERS 0
+#endif
+
+// compile the compute core (least squares solvers, "predict" and "projector") without R, for linking into C++
+// programs that do not embed an R interpreter, with "-DRCPPML_NO_R=1"
+//  * sparse matrices are read through "RcppML::CscView" rather than "Rcpp::SparseMatrix" (see "RcppML::SparseOf")
+//  * errors are thrown as "std::runtime_error" and messages are written to stderr (see "RcppML::fail")
+#ifndef RCPPML_NO_R
+#define RCPPML_NO_R 0
+#endif
+
+// reduce statistics of distributed nmf over MPI ranks (see "mpiAllreduce" and "nmf::fit_distributed"), which is compiled
+// only with "-DRCPPML_MPI=1" against an MPI implementation, since the package does not depend on MPI
+#ifndef RCPPML_MPI
+#define RCPPML_MPI 0
+#endif
+
+// inexact alternating least squares (see "inexactTol"): coordinate descent tolerance in the first iteration, and the
+// ratio of coordinate descent tolerance to the outer tolerance of the previous iteration thereafter
+#ifndef INEXACT_CD_TOL
+#define INEXACT_CD_TOL 1e-2
+#endif
+
+#ifndef INEXACT_CD_RATIO
+#define INEXACT_CD_RATIO 1e-2
+#endif
+
+// minimum rank of least squares systems that are solved by the active set method rather than by coordinate descent,
+// unless a solver is specified (see "useActiveSet")
+#ifndef ACTIVE_SET_MIN_RANK
+#define ACTIVE_SET_MIN_RANK 100
+#endif
+
+// sweeps of coordinate descent in upper-bounded least squares before the active set method is used (see "bnnls")
+#ifndef BNNLS_CD_MAXIT
+#define BNNLS_CD_MAXIT 3
+#endif
+
+// minimum number of columns (or rows) of the input matrix per thread within a single nmf fit, beyond which
+// additional threads are used to fit random restarts concurrently
+#ifndef RESTART_MIN_DIM_PER_THREAD
+#define RESTART_MIN_DIM_PER_THREAD 256
+#endif
+
+// with "threads = 0", the fewest floating point operations given to each thread of an update or loss, and the fewest
+// flops per byte read of a call that is not limited by memory bandwidth (see "kernelThreads")
+#ifndef THREAD_MIN_WORK
+#define THREAD_MIN_WORK 1e6
+#endif
+
+#ifndef THREAD_MEMORY_BOUND_INTENSITY
+#define THREAD_MEMORY_BOUND_INTENSITY 1
+#endif
+
+// number of columns of a sparse input matrix for which right-hand sides of least squares updates are computed
+// together, before any of their systems are solved
+#ifndef PREDICT_TILE_SIZE
+#define PREDICT_TILE_SIZE 64
+#endif
+
+// number of non-zeros ahead of the one being gathered in a column of a sparse input matrix for which the column of the
+// model is prefetched (see "gatherTile"), or 0 to not prefetch
+#ifndef GATHER_PREFETCH_DISTANCE
+#define GATHER_PREFETCH_DISTANCE 16
+#endif
+
+// number of chunks of rows of a sparse input matrix for each thread of updates of "w" that read the matrix in place,
+// rather than its transpose (see "gramRhsRows")
+#ifndef ROW_CHUNKS_PER_THREAD
+#define ROW_CHUNKS_PER_THREAD 4
+#endif
+
+// thresholds of the Huber and Tukey losses of robust nmf in robust standard deviations of the residuals, which are 95%
+// efficient for normal residuals (see "nmf::reweight")
+#ifndef HUBER_C
+#define HUBER_C 1.345
+#endif
+
+#ifndef TUKEY_C
+#define TUKEY_C 4.685
+#endif
+
+// number of updates for which a column whose solution has stopped changing is skipped (see "freezer")
+#ifndef FREEZE_ITERS
+#define FREEZE_ITERS 5
+#endif
+
+// number of columns of a sparse factor (or of the input matrix, when projecting onto it) that are dense at any one
+// time when sparse factors are returned or evaluated
+#ifndef SPARSE_FACTOR_BLOCK_SIZE
+#define SPARSE_FACTOR_BLOCK_SIZE 8192
+#endif
+
+// fewest columns of each block of a Gram matrix that is computed on several threads, and the most blocks (see "gram")
+#ifndef GRAM_BLOCK_SIZE
+#define GRAM_BLOCK_SIZE 4096
+#endif
+
+#ifndef GRAM_MAX_BLOCKS
+#define GRAM_MAX_BLOCKS 64
+#endif
+
+// columns of each block of a factor that is scaled on one thread, whose row sums are added in order of the blocks (see
+// "nmf::scaleRows")
+#ifndef SCALE_BLOCK_SIZE
+#define SCALE_BLOCK_SIZE 4096
+#endif
+
+// centers of clusters of sparse samples are sparse if "SPARSE_CENTER_RATIO" times the non-zeros of their samples is
+// less than the number of features (see "clusterCenter")
+#ifndef SPARSE_CENTER_RATIO
+#define SPARSE_CENTER_RATIO 2
+#endif
+
+// fewest bytes of a buffer of a fit that is backed by transparent huge pages, with "huge_pages" (see "adviseHugePages")
+#ifndef HUGE_PAGE_MIN_BYTES
+#define HUGE_PAGE_MIN_BYTES 33554432
+#endif
+
+// number of columns of a random sparse matrix (or values of a random vector) that are generated together by one
+// thread, so that results do not depend on the number of threads
+#ifndef RANDOM_BLOCK_SIZE
+#define RANDOM_BLOCK_SIZE 256
+#endif
+
 #ifndef EIGEN_INITIALIZE_MATRICES_BY_ZERO
 #define EIGEN_INITIALIZE_MATRICES_BY_ZERO
 #endif
 
+#if RCPPML_NO_R
+#include "EigenCore"
+#include "RcppML/core.hpp"
+#else
 #include "RcppEigen_bits.h"
 #include "RcppML/SparseMatrix.h"
+#endif
+
+namespace RcppML {
+// sparse matrices read by the compute core: R memory in the package, or memory owned by the caller without R
+#if RCPPML_NO_R
+template <typename Value>
+using SparseOf = CscView<Value>;
+#else
+template <typename Value>
+using SparseOf = Rcpp::SparseMatrixOf<Value>;
+#endif
+}  // namespace RcppML
+
+#include "RcppML/simd.hpp"
 #include "RcppML/bits.hpp"
+#include "RcppML/tasks.hpp"
+#include "RcppML/gram.hpp"
 #include "RcppML/rng.hpp"
 
 #endif
@@ -0,0 +1,64 @@
+// This file is part of RcppML, a Rcpp Machine Learning library
+//
+// Copyright (C) 2022 Zach DeBruine <zacharydebruine@gmail.com>
+//
+// This source code is subject to the terms of the GNU
+// Public License v. 2.0.
+
+// MODEL SERVER
+//
+// A long-lived process that holds models written by "write_nmf", and optionally trees written by "write_dclust", and
+//   answers batches of sparse samples sent over a Unix domain socket with the "top_k" largest factors of each sample
+//   and the leaf of the tree that it is routed to (see "RcppML::serveSocket" for the messages). No R process is
+//   involved. This file is not part of the package build, and is compiled against the headers in "../include" as:
+//
+//     g++ -std=c++14 -O3 -march=native -fopenmp -DRCPPML_NO_R=1 -I ../include -I <path to Eigen> serve.cpp -o rcppml-serve
+//
+//   and run as:
+//
+//     rcppml-serve [--threads n] <socket> <name>=<model file>[,<tree file>] ...
+//
+//  * models are memory-mapped (see "RcppML::modelFile"), so servers of the same models share one copy of them
+//  * SIGINT and SIGTERM stop the server once the current batch is answered, and remove the socket
+
+#include <RcppMLCommon.hpp>
+#include <RcppML/serve.hpp>
+
+#include <iostream>
+
+static volatile std::sig_atomic_t stopped = 0;
+
+static void stop(int) { stopped = 1; }
+
+int main(int argc, char** argv) {
+    RcppML::modelServer server;
+    std::string socket_path;
+    try {
+        for (int a = 1; a < argc; ++a) {
+            const std::string arg = argv[a];
+            if (arg == "--threads" && a + 1 < argc) {
+                server.threads = std::max(1, std::atoi(argv[++a]));
+            } else if (socket_path.empty()) {
+                socket_path = arg;
+            } else {
+                const size_t eq = arg.find('='), comma = arg.find(',', eq);
+                if (eq == std::string::npos || eq == 0) throw std::runtime_error("models must be given as <name>=<model file>[,<tree file>]");
+                const std::string model = arg.substr(eq + 1, comma == std::string::npos ? std::string::npos : comma - eq - 1);
+                const std::string tree = comma == std::string::npos ? "" : arg.substr(comma + 1);
+                server.add(arg.substr(0, eq), model, tree);
+            }
+        }
+        if (socket_path.empty() || server.size() == 0) {
+            std::cerr << "usage: " << argv[0] << " [--threads n] <socket> <name>=<model file>[,<tree file>] ...\n";
+            return 2;
+        }
+        std::signal(SIGINT, stop);
+        std::signal(SIGTERM, stop);
+        std::cerr << "serving " << server.size() << " models on " << socket_path << " with " << server.threads << " threads\n";
+        RcppML::serveSocket(socket_path, server, &stopped);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -12,8 +12,8 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // Rcpp_predict_sparse
-Eigen::MatrixXd Rcpp_predict_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound);
-RcppExport SEXP _RcppML_Rcpp_predict_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP) {
+SEXP Rcpp_predict_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const bool sparse_output, const std::string solver, const unsigned int top_k, const double threshold, const bool squared_error, Eigen::MatrixXd h_init, const double skip_tol);
+RcppExport SEXP _RcppML_Rcpp_predict_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparse_outputSEXP, SEXP solverSEXP, SEXP top_kSEXP, SEXP thresholdSEXP, SEXP squared_errorSEXP, SEXP h_initSEXP, SEXP skip_tolSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -25,17 +25,25 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
     Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
     Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_sparse(A, mask, w, L1, L2, threads, mask_zeros, upper_bound));
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_output(sparse_outputSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type top_k(top_kSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const bool >::type squared_error(squared_errorSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h_init(h_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type skip_tol(skip_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_sparse(A, mask, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output, solver, top_k, threshold, squared_error, h_init, skip_tol));
     return rcpp_result_gen;
 END_RCPP
 }
 // Rcpp_predict_dense
-Eigen::MatrixXd Rcpp_predict_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound);
-RcppExport SEXP _RcppML_Rcpp_predict_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP) {
+SEXP Rcpp_predict_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const bool sparse_output, const std::string solver, const unsigned int top_k, const double threshold, const bool squared_error, Eigen::MatrixXd h_init, const double skip_tol);
+RcppExport SEXP _RcppML_Rcpp_predict_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparse_outputSEXP, SEXP solverSEXP, SEXP top_kSEXP, SEXP thresholdSEXP, SEXP squared_errorSEXP, SEXP h_initSEXP, SEXP skip_tolSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Eigen::MatrixXd& >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
     Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
     Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
@@ -43,7 +51,345 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
     Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
     Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_dense(A_, mask, w, L1, L2, threads, mask_zeros, upper_bound));
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_output(sparse_outputSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type top_k(top_kSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const bool >::type squared_error(squared_errorSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h_init(h_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type skip_tol(skip_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_dense(A_, mask, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output, solver, top_k, threshold, squared_error, h_init, skip_tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_predict_sink_sparse
+void Rcpp_predict_sink_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const bool sparse_output, const std::string solver, const unsigned int top_k, const double threshold, const unsigned int chunk_size, SEXP sink);
+RcppExport SEXP _RcppML_Rcpp_predict_sink_sparse(SEXP ASEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparse_outputSEXP, SEXP solverSEXP, SEXP top_kSEXP, SEXP thresholdSEXP, SEXP chunk_sizeSEXP, SEXP sinkSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_output(sparse_outputSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type top_k(top_kSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type chunk_size(chunk_sizeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type sink(sinkSEXP);
+    Rcpp_predict_sink_sparse(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output, solver, top_k, threshold, chunk_size, sink);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_predict_sink_dense
+void Rcpp_predict_sink_dense(Eigen::Map<Eigen::MatrixXd> A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const bool sparse_output, const std::string solver, const unsigned int top_k, const double threshold, const unsigned int chunk_size, SEXP sink);
+RcppExport SEXP _RcppML_Rcpp_predict_sink_dense(SEXP ASEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparse_outputSEXP, SEXP solverSEXP, SEXP top_kSEXP, SEXP thresholdSEXP, SEXP chunk_sizeSEXP, SEXP sinkSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_output(sparse_outputSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type top_k(top_kSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type chunk_size(chunk_sizeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type sink(sinkSEXP);
+    Rcpp_predict_sink_dense(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output, solver, top_k, threshold, chunk_size, sink);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_predict_half_sparse
+SEXP Rcpp_predict_half_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const std::string solver, const unsigned int chunk_size, const int h_format);
+RcppExport SEXP _RcppML_Rcpp_predict_half_sparse(SEXP ASEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP solverSEXP, SEXP chunk_sizeSEXP, SEXP h_formatSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type chunk_size(chunk_sizeSEXP);
+    Rcpp::traits::input_parameter< const int >::type h_format(h_formatSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_half_sparse(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, solver, chunk_size, h_format));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_predict_half_dense
+SEXP Rcpp_predict_half_dense(Eigen::Map<Eigen::MatrixXd> A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float, const std::string solver, const unsigned int chunk_size, const int h_format);
+RcppExport SEXP _RcppML_Rcpp_predict_half_dense(SEXP ASEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP solverSEXP, SEXP chunk_sizeSEXP, SEXP h_formatSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type chunk_size(chunk_sizeSEXP);
+    Rcpp::traits::input_parameter< const int >::type h_format(h_formatSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_half_dense(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, solver, chunk_size, h_format));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_projector
+SEXP Rcpp_projector(Eigen::MatrixXd w, const double L1, const double L2, const double upper_bound, const std::string solver, const std::string storage);
+RcppExport SEXP _RcppML_Rcpp_projector(SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP storageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type storage(storageSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_projector(w, L1, L2, upper_bound, solver, storage));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_projector_file
+SEXP Rcpp_projector_file(const std::string path, const double L1, const double L2, const double upper_bound, const std::string solver, const std::string storage);
+RcppExport SEXP _RcppML_Rcpp_projector_file(SEXP pathSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP storageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type storage(storageSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_projector_file(path, L1, L2, upper_bound, solver, storage));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_sparse
+Eigen::MatrixXd Rcpp_project_sparse(SEXP handle, const Rcpp::S4& A, const unsigned int threads, const Eigen::MatrixXd h_init, const double skip_tol);
+RcppExport SEXP _RcppML_Rcpp_project_sparse(SEXP handleSEXP, SEXP ASEXP, SEXP threadsSEXP, SEXP h_initSEXP, SEXP skip_tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd >::type h_init(h_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type skip_tol(skip_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_sparse(handle, A, threads, h_init, skip_tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_dense
+Eigen::MatrixXd Rcpp_project_dense(SEXP handle, const Eigen::Map<Eigen::MatrixXd> A, const unsigned int threads, const Eigen::MatrixXd h_init, const double skip_tol);
+RcppExport SEXP _RcppML_Rcpp_project_dense(SEXP handleSEXP, SEXP ASEXP, SEXP threadsSEXP, SEXP h_initSEXP, SEXP skip_tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd >::type h_init(h_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type skip_tol(skip_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_dense(handle, A, threads, h_init, skip_tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_sample
+Eigen::VectorXd Rcpp_project_sample(SEXP handle, const Rcpp::IntegerVector& rows, const Rcpp::NumericVector& values);
+RcppExport SEXP _RcppML_Rcpp_project_sample(SEXP handleSEXP, SEXP rowsSEXP, SEXP valuesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::IntegerVector& >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericVector& >::type values(valuesSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_sample(handle, rows, values));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_batch_sparse
+Rcpp::List Rcpp_project_batch_sparse(SEXP handle, const Rcpp::List& data, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_project_batch_sparse(SEXP handleSEXP, SEXP dataSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_batch_sparse(handle, data, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_batch_dense
+Rcpp::List Rcpp_project_batch_dense(SEXP handle, const Rcpp::List& data, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_project_batch_dense(SEXP handleSEXP, SEXP dataSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_batch_dense(handle, data, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_projector_info
+Rcpp::List Rcpp_projector_info(SEXP handle);
+RcppExport SEXP _RcppML_Rcpp_projector_info(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_projector_info(handle));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_write_model
+void Rcpp_write_model(const std::string path, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h, const Rcpp::RawVector h_half, const int h_format);
+RcppExport SEXP _RcppML_Rcpp_write_model(SEXP pathSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP h_halfSEXP, SEXP h_formatSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type d(dSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::RawVector >::type h_half(h_halfSEXP);
+    Rcpp::traits::input_parameter< const int >::type h_format(h_formatSEXP);
+    Rcpp_write_model(path, w, d, h, h_half, h_format);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_read_model
+Rcpp::List Rcpp_read_model(const std::string path);
+RcppExport SEXP _RcppML_Rcpp_read_model(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_read_model(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_half_encode
+SEXP Rcpp_half_encode(const Eigen::Map<Eigen::MatrixXd> x, const int format, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_half_encode(SEXP xSEXP, SEXP formatSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const int >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_half_encode(x, format, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_half_decode
+Rcpp::NumericMatrix Rcpp_half_decode(const Rcpp::RawVector x, const int n_rows, const int n_cols, const int format, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_half_decode(SEXP xSEXP, SEXP n_rowsSEXP, SEXP n_colsSEXP, SEXP formatSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RawVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_rows(n_rowsSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_cols(n_colsSEXP);
+    Rcpp::traits::input_parameter< const int >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_half_decode(x, n_rows, n_cols, format, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_half_subset
+SEXP Rcpp_half_subset(const Rcpp::RawVector x, const int n_rows, const Rcpp::IntegerVector rows, const Rcpp::IntegerVector cols, const int format);
+RcppExport SEXP _RcppML_Rcpp_half_subset(SEXP xSEXP, SEXP n_rowsSEXP, SEXP rowsSEXP, SEXP colsSEXP, SEXP formatSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RawVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const int >::type n_rows(n_rowsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::IntegerVector >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::IntegerVector >::type cols(colsSEXP);
+    Rcpp::traits::input_parameter< const int >::type format(formatSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_half_subset(x, n_rows, rows, cols, format));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_column_groups
+Rcpp::List Rcpp_column_groups(const Rcpp::S4& A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_column_groups(SEXP ASEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_column_groups(A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_hash_features
+Rcpp::S4 Rcpp_hash_features(const Rcpp::S4& A, const unsigned int buckets, const bool signs, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_hash_features(SEXP ASEXP, SEXP bucketsSEXP, SEXP signsSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type buckets(bucketsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type signs(signsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_hash_features(A, buckets, signs, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_stacked_sparse
+Rcpp::List Rcpp_project_stacked_sparse(const Rcpp::List& w, const Rcpp::S4& A, const double L1, const double L2, const double upper_bound, const std::string solver, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_project_stacked_sparse(SEXP wSEXP, SEXP ASEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_stacked_sparse(w, A, L1, L2, upper_bound, solver, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_project_stacked_dense
+Rcpp::List Rcpp_project_stacked_dense(const Rcpp::List& w, const Eigen::MatrixXd& A, const double L1, const double L2, const double upper_bound, const std::string solver, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_project_stacked_dense(SEXP wSEXP, SEXP ASEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_project_stacked_dense(w, A, L1, L2, upper_bound, solver, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -54,216 +400,1518 @@ BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
-    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_sparse(A, mask, w, d, h, threads, mask_zeros));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_dense
+double Rcpp_mse_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads, const bool mask_zeros);
+RcppExport SEXP _RcppML_Rcpp_mse_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_dense(A_, mask, w, d, h, threads, mask_zeros));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_missing_sparse
+double Rcpp_mse_missing_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_mse_missing_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_missing_sparse(A, mask, w, d, h, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_missing_dense
+double Rcpp_mse_missing_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_mse_missing_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_missing_dense(A_, mask, w, d, h, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_hashed_sparse
+double Rcpp_mse_hashed_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads, const unsigned int mask_seed, const unsigned int mask_inv_probability, const bool missing_only);
+RcppExport SEXP _RcppML_Rcpp_mse_hashed_sparse(SEXP ASEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_seedSEXP, SEXP mask_inv_probabilitySEXP, SEXP missing_onlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_seed(mask_seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< const bool >::type missing_only(missing_onlySEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_hashed_sparse(A, w, d, h, threads, mask_seed, mask_inv_probability, missing_only));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_hashed_dense
+double Rcpp_mse_hashed_dense(Eigen::Map<Eigen::MatrixXd> A_, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads, const unsigned int mask_seed, const unsigned int mask_inv_probability, const bool missing_only);
+RcppExport SEXP _RcppML_Rcpp_mse_hashed_dense(SEXP A_SEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_seedSEXP, SEXP mask_inv_probabilitySEXP, SEXP missing_onlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_seed(mask_seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< const bool >::type missing_only(missing_onlySEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_hashed_dense(A_, w, d, h, threads, mask_seed, mask_inv_probability, missing_only));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_blocked_sparse
+double Rcpp_mse_blocked_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, const Rcpp::S4& h, const unsigned int threads, const bool mask_zeros, const bool missing_only);
+RcppExport SEXP _RcppML_Rcpp_mse_blocked_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP missing_onlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const bool >::type missing_only(missing_onlySEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_blocked_sparse(A, mask, w, d, h, threads, mask_zeros, missing_only));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_blocked_dense
+double Rcpp_mse_blocked_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, const Rcpp::S4& h, const unsigned int threads, const bool mask_zeros, const bool missing_only);
+RcppExport SEXP _RcppML_Rcpp_mse_blocked_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP missing_onlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const bool >::type missing_only(missing_onlySEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_blocked_dense(A_, mask, w, d, h, threads, mask_zeros, missing_only));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_models_sparse
+Eigen::VectorXd Rcpp_mse_models_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Rcpp::List& models, const unsigned int threads, const bool mask_zeros, const bool missing_only);
+RcppExport SEXP _RcppML_Rcpp_mse_models_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP modelsSEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP, SEXP missing_onlySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List& >::type models(modelsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const bool >::type missing_only(missing_onlySEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_models_sparse(A, mask, models, threads, mask_zeros, missing_only));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_sparse
+Rcpp::List Rcpp_nmf_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound, const bool use_float, const bool loss_tol, const unsigned int batch_size, const double decay, Rcpp::List online_stats, const bool sparse_w, const bool sparse_h, const std::string solver, const bool inexact, const double freeze_tol, const std::string method, Rcpp::List prepared, const bool compress_indices, const unsigned int mask_seed, const unsigned int mask_inv_probability, Rcpp::IntegerVector ranks, const unsigned int race, const double race_tol, const double dense_zeros, const std::string checkpoint, const unsigned int checkpoint_every, const bool float_values, const bool accelerate, const unsigned int anderson, const double subsample, const bool keep_stats, const bool penalty_path, const unsigned int min_row_nnz, const unsigned int min_col_nnz, const double min_row_var, const std::string normalize, const bool profile, Rcpp::List plan, Rcpp::LogicalVector nonneg, Rcpp::List link_w, const unsigned int bootstrap, const unsigned int bootstrap_seed, const int h_precision, Rcpp::NumericVector col_weights);
+RcppExport SEXP _RcppML_Rcpp_nmf_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP link_matrix_hSEXP, SEXP mask_zerosSEXP, SEXP link_hSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP batch_sizeSEXP, SEXP decaySEXP, SEXP online_statsSEXP, SEXP sparse_wSEXP, SEXP sparse_hSEXP, SEXP solverSEXP, SEXP inexactSEXP, SEXP freeze_tolSEXP, SEXP methodSEXP, SEXP preparedSEXP, SEXP compress_indicesSEXP, SEXP mask_seedSEXP, SEXP mask_inv_probabilitySEXP, SEXP ranksSEXP, SEXP raceSEXP, SEXP race_tolSEXP, SEXP dense_zerosSEXP, SEXP checkpointSEXP, SEXP checkpoint_everySEXP, SEXP float_valuesSEXP, SEXP accelerateSEXP, SEXP andersonSEXP, SEXP subsampleSEXP, SEXP keep_statsSEXP, SEXP penalty_pathSEXP, SEXP min_row_nnzSEXP, SEXP min_col_nnzSEXP, SEXP min_row_varSEXP, SEXP normalizeSEXP, SEXP profileSEXP, SEXP planSEXP, SEXP nonnegSEXP, SEXP link_wSEXP, SEXP bootstrapSEXP, SEXP bootstrap_seedSEXP, SEXP h_precisionSEXP, SEXP col_weightsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type link_matrix_h(link_matrix_hSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const bool >::type link_h(link_hSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type batch_size(batch_sizeSEXP);
+    Rcpp::traits::input_parameter< const double >::type decay(decaySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type online_stats(online_statsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_w(sparse_wSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_h(sparse_hSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    Rcpp::traits::input_parameter< const double >::type freeze_tol(freeze_tolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type prepared(preparedSEXP);
+    Rcpp::traits::input_parameter< const bool >::type compress_indices(compress_indicesSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_seed(mask_seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type ranks(ranksSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type race(raceSEXP);
+    Rcpp::traits::input_parameter< const double >::type race_tol(race_tolSEXP);
+    Rcpp::traits::input_parameter< const double >::type dense_zeros(dense_zerosSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type checkpoint_every(checkpoint_everySEXP);
+    Rcpp::traits::input_parameter< const bool >::type float_values(float_valuesSEXP);
+    Rcpp::traits::input_parameter< const bool >::type accelerate(accelerateSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type anderson(andersonSEXP);
+    Rcpp::traits::input_parameter< const double >::type subsample(subsampleSEXP);
+    Rcpp::traits::input_parameter< const bool >::type keep_stats(keep_statsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type penalty_path(penalty_pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_row_nnz(min_row_nnzSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_col_nnz(min_col_nnzSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_row_var(min_row_varSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type normalize(normalizeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type plan(planSEXP);
+    Rcpp::traits::input_parameter< Rcpp::LogicalVector >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type link_w(link_wSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type bootstrap(bootstrapSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type bootstrap_seed(bootstrap_seedSEXP);
+    Rcpp::traits::input_parameter< const int >::type h_precision(h_precisionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type col_weights(col_weightsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_sparse(A, mask, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h, mask_zeros, link_h, sort_model, upper_bound, use_float, loss_tol, batch_size, decay, online_stats, sparse_w, sparse_h, solver, inexact, freeze_tol, method, prepared, compress_indices, mask_seed, mask_inv_probability, ranks, race, race_tol, dense_zeros, checkpoint, checkpoint_every, float_values, accelerate, anderson, subsample, keep_stats, penalty_path, min_row_nnz, min_col_nnz, min_row_var, normalize, profile, plan, nonneg, link_w, bootstrap, bootstrap_seed, h_precision, col_weights));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_dense
+Rcpp::List Rcpp_nmf_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound, const bool use_float, const bool loss_tol, const unsigned int batch_size, const double decay, Rcpp::List online_stats, const bool sparse_w, const bool sparse_h, const std::string solver, const bool inexact, const double freeze_tol, const std::string method, const unsigned int mask_seed, const unsigned int mask_inv_probability, Rcpp::IntegerVector ranks, const unsigned int race, const double race_tol, const double sparse_zeros, const std::string checkpoint, const unsigned int checkpoint_every, const bool float_values, const bool accelerate, const unsigned int anderson, const double subsample, const bool keep_stats, const bool penalty_path, const bool profile, Rcpp::List plan, Rcpp::LogicalVector nonneg, Rcpp::List link_w, const unsigned int bootstrap, const unsigned int bootstrap_seed, const int h_precision, Rcpp::NumericVector col_weights);
+RcppExport SEXP _RcppML_Rcpp_nmf_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP link_matrix_hSEXP, SEXP mask_zerosSEXP, SEXP link_hSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP batch_sizeSEXP, SEXP decaySEXP, SEXP online_statsSEXP, SEXP sparse_wSEXP, SEXP sparse_hSEXP, SEXP solverSEXP, SEXP inexactSEXP, SEXP freeze_tolSEXP, SEXP methodSEXP, SEXP mask_seedSEXP, SEXP mask_inv_probabilitySEXP, SEXP ranksSEXP, SEXP raceSEXP, SEXP race_tolSEXP, SEXP sparse_zerosSEXP, SEXP checkpointSEXP, SEXP checkpoint_everySEXP, SEXP float_valuesSEXP, SEXP accelerateSEXP, SEXP andersonSEXP, SEXP subsampleSEXP, SEXP keep_statsSEXP, SEXP penalty_pathSEXP, SEXP profileSEXP, SEXP planSEXP, SEXP nonnegSEXP, SEXP link_wSEXP, SEXP bootstrapSEXP, SEXP bootstrap_seedSEXP, SEXP h_precisionSEXP, SEXP col_weightsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type link_matrix_h(link_matrix_hSEXP);
+    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
+    Rcpp::traits::input_parameter< const bool >::type link_h(link_hSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type batch_size(batch_sizeSEXP);
+    Rcpp::traits::input_parameter< const double >::type decay(decaySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type online_stats(online_statsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_w(sparse_wSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_h(sparse_hSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    Rcpp::traits::input_parameter< const double >::type freeze_tol(freeze_tolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_seed(mask_seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type ranks(ranksSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type race(raceSEXP);
+    Rcpp::traits::input_parameter< const double >::type race_tol(race_tolSEXP);
+    Rcpp::traits::input_parameter< const double >::type sparse_zeros(sparse_zerosSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint(checkpointSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type checkpoint_every(checkpoint_everySEXP);
+    Rcpp::traits::input_parameter< const bool >::type float_values(float_valuesSEXP);
+    Rcpp::traits::input_parameter< const bool >::type accelerate(accelerateSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type anderson(andersonSEXP);
+    Rcpp::traits::input_parameter< const double >::type subsample(subsampleSEXP);
+    Rcpp::traits::input_parameter< const bool >::type keep_stats(keep_statsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type penalty_path(penalty_pathSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type plan(planSEXP);
+    Rcpp::traits::input_parameter< Rcpp::LogicalVector >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type link_w(link_wSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type bootstrap(bootstrapSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type bootstrap_seed(bootstrap_seedSEXP);
+    Rcpp::traits::input_parameter< const int >::type h_precision(h_precisionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type col_weights(col_weightsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_dense(A_, mask, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h, mask_zeros, link_h, sort_model, upper_bound, use_float, loss_tol, batch_size, decay, online_stats, sparse_w, sparse_h, solver, inexact, freeze_tol, method, mask_seed, mask_inv_probability, ranks, race, race_tol, sparse_zeros, checkpoint, checkpoint_every, float_values, accelerate, anderson, subsample, keep_stats, penalty_path, profile, plan, nonneg, link_w, bootstrap, bootstrap_seed, h_precision, col_weights));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_init_w
+Eigen::MatrixXd Rcpp_init_w(const Rcpp::RObject& init, const unsigned int n_features);
+RcppExport SEXP _RcppML_Rcpp_init_w(SEXP initSEXP, SEXP n_featuresSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::RObject& >::type init(initSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_features(n_featuresSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_init_w(init, n_features));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_gram
+Eigen::MatrixXd Rcpp_gram(const Eigen::Map<Eigen::MatrixXd> x, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_gram(SEXP xSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_gram(x, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nndsvd_sparse
+Eigen::MatrixXd Rcpp_nndsvd_sparse(const Rcpp::S4& A, const unsigned int k, const unsigned int power_iters, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_nndsvd_sparse(SEXP ASEXP, SEXP kSEXP, SEXP power_itersSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type power_iters(power_itersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nndsvd_sparse(A, k, power_iters, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nndsvd_dense
+Eigen::MatrixXd Rcpp_nndsvd_dense(const Eigen::MatrixXd& A, const unsigned int k, const unsigned int power_iters, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_nndsvd_dense(SEXP ASEXP, SEXP kSEXP, SEXP power_itersSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type power_iters(power_itersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nndsvd_dense(A, k, power_iters, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_init_sparse
+Eigen::MatrixXd Rcpp_dclust_init_sparse(const Rcpp::S4& A, const unsigned int k, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_dclust_init_sparse(SEXP ASEXP, SEXP kSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_init_sparse(A, k, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_init_dense
+Eigen::MatrixXd Rcpp_dclust_init_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int k, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_dclust_init_dense(SEXP ASEXP, SEXP kSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_init_dense(A, k, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_metacells_sparse
+Rcpp::List Rcpp_metacells_sparse(const Rcpp::S4& A, const unsigned int n_cells, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_metacells_sparse(SEXP ASEXP, SEXP n_cellsSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_cells(n_cellsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_metacells_sparse(A, n_cells, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_metacells_dense
+Rcpp::List Rcpp_metacells_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int n_cells, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_metacells_dense(SEXP ASEXP, SEXP n_cellsSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_cells(n_cellsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_metacells_dense(A, n_cells, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_compressed_nmf_sparse
+Rcpp::List Rcpp_compressed_nmf_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& w, const unsigned int sketch_size, const unsigned int power_iters, const unsigned int seed, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const bool verbose, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_compressed_nmf_sparse(SEXP ASEXP, SEXP wSEXP, SEXP sketch_sizeSEXP, SEXP power_itersSEXP, SEXP seedSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP verboseSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type sketch_size(sketch_sizeSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type power_iters(power_itersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_compressed_nmf_sparse(A, w, sketch_size, power_iters, seed, tol, maxit, L1, L2, verbose, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_compressed_nmf_dense
+Rcpp::List Rcpp_compressed_nmf_dense(const Eigen::MatrixXd& A, const Eigen::MatrixXd& w, const unsigned int sketch_size, const unsigned int power_iters, const unsigned int seed, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const bool verbose, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_compressed_nmf_dense(SEXP ASEXP, SEXP wSEXP, SEXP sketch_sizeSEXP, SEXP power_itersSEXP, SEXP seedSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP verboseSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type sketch_size(sketch_sizeSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type power_iters(power_itersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_compressed_nmf_dense(A, w, sketch_size, power_iters, seed, tol, maxit, L1, L2, verbose, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_snmf_sparse
+Rcpp::List Rcpp_snmf_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_snmf_sparse(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_snmf_sparse(A, w_init, tol, maxit, verbose, L1, L2, threads, sort_model, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_snmf_dense
+Rcpp::List Rcpp_snmf_dense(Eigen::MatrixXd& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_snmf_dense(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_snmf_dense(A, w_init, tol, maxit, verbose, L1, L2, threads, sort_model, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_implicit_nmf
+Rcpp::List Rcpp_implicit_nmf(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double alpha, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model);
+RcppExport SEXP _RcppML_Rcpp_implicit_nmf(SEXP ASEXP, SEXP w_initSEXP, SEXP alphaSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_implicit_nmf(A, w_init, alpha, tol, maxit, verbose, L1, L2, threads, sort_model));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_kl_nmf
+Rcpp::List Rcpp_kl_nmf(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model);
+RcppExport SEXP _RcppML_Rcpp_kl_nmf(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_kl_nmf(A, w_init, tol, maxit, verbose, L1, L2, threads, sort_model));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_lnmf_sparse
+Rcpp::List Rcpp_lnmf_sparse(const Rcpp::List& data, const unsigned int k_wh, const std::vector<unsigned int>& k_uv, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_lnmf_sparse(SEXP dataSEXP, SEXP k_whSEXP, SEXP k_uvSEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k_wh(k_whSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type k_uv(k_uvSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_lnmf_sparse(data, k_wh, k_uv, w_init, tol, maxit, verbose, L1, L2, threads, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_lnmf_dense
+Rcpp::List Rcpp_lnmf_dense(const Rcpp::List& data, const unsigned int k_wh, const std::vector<unsigned int>& k_uv, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_lnmf_dense(SEXP dataSEXP, SEXP k_whSEXP, SEXP k_uvSEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type data(dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k_wh(k_whSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type k_uv(k_uvSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_lnmf_dense(data, k_wh, k_uv, w_init, tol, maxit, verbose, L1, L2, threads, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_cross_validate_sparse
+std::vector<double> Rcpp_cross_validate_sparse(const Rcpp::S4& A, const std::vector<unsigned int> mask_seeds, const unsigned int mask_inv_probability, Rcpp::List w_init, const std::vector<unsigned int> reps, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const double upper_bound, const bool use_float, const bool loss_tol, const std::string solver, const bool inexact, const bool rank_path, const unsigned int patience, const bool holdout_samples);
+RcppExport SEXP _RcppML_Rcpp_cross_validate_sparse(SEXP ASEXP, SEXP mask_seedsSEXP, SEXP mask_inv_probabilitySEXP, SEXP w_initSEXP, SEXP repsSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP solverSEXP, SEXP inexactSEXP, SEXP rank_pathSEXP, SEXP patienceSEXP, SEXP holdout_samplesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int> >::type mask_seeds(mask_seedsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int> >::type reps(repsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    Rcpp::traits::input_parameter< const bool >::type rank_path(rank_pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type patience(patienceSEXP);
+    Rcpp::traits::input_parameter< const bool >::type holdout_samples(holdout_samplesSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_cross_validate_sparse(A, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2, threads, upper_bound, use_float, loss_tol, solver, inexact, rank_path, patience, holdout_samples));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_cross_validate_dense
+std::vector<double> Rcpp_cross_validate_dense(Eigen::Map<Eigen::MatrixXd> A_, const std::vector<unsigned int> mask_seeds, const unsigned int mask_inv_probability, Rcpp::List w_init, const std::vector<unsigned int> reps, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const double upper_bound, const bool use_float, const bool loss_tol, const std::string solver, const bool inexact, const bool rank_path, const unsigned int patience, const bool holdout_samples);
+RcppExport SEXP _RcppML_Rcpp_cross_validate_dense(SEXP A_SEXP, SEXP mask_seedsSEXP, SEXP mask_inv_probabilitySEXP, SEXP w_initSEXP, SEXP repsSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP solverSEXP, SEXP inexactSEXP, SEXP rank_pathSEXP, SEXP patienceSEXP, SEXP holdout_samplesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Eigen::Map<Eigen::MatrixXd> >::type A_(A_SEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int> >::type mask_seeds(mask_seedsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type mask_inv_probability(mask_inv_probabilitySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int> >::type reps(repsSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    Rcpp::traits::input_parameter< const bool >::type rank_path(rank_pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type patience(patienceSEXP);
+    Rcpp::traits::input_parameter< const bool >::type holdout_samples(holdout_samplesSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_cross_validate_dense(A_, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2, threads, upper_bound, use_float, loss_tol, solver, inexact, rank_path, patience, holdout_samples));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_prepare_sparse
+Rcpp::List Rcpp_prepare_sparse(const Rcpp::S4& A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_prepare_sparse(SEXP ASEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_prepare_sparse(A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_matrix_cache
+Rcpp::List Rcpp_matrix_cache(const double limit, const bool clear);
+RcppExport SEXP _RcppML_Rcpp_matrix_cache(SEXP limitSEXP, SEXP clearSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const double >::type limit(limitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type clear(clearSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_matrix_cache(limit, clear));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_memory_accounting
+Rcpp::DataFrame Rcpp_memory_accounting(const bool open);
+RcppExport SEXP _RcppML_Rcpp_memory_accounting(SEXP openSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const bool >::type open(openSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_memory_accounting(open));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_scan_sparse
+Rcpp::List Rcpp_scan_sparse(const Rcpp::S4& A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_scan_sparse(SEXP ASEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_scan_sparse(A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_scan_dense
+Rcpp::List Rcpp_scan_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_scan_dense(SEXP ASEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_scan_dense(A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_write_stream
+void Rcpp_write_stream(const Rcpp::S4& A, const std::string path, const unsigned int chunk_size, const bool append);
+RcppExport SEXP _RcppML_Rcpp_write_stream(SEXP ASEXP, SEXP pathSEXP, SEXP chunk_sizeSEXP, SEXP appendSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type chunk_size(chunk_sizeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type append(appendSEXP);
+    Rcpp_write_stream(A, path, chunk_size, append);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_stream_dim
+std::vector<double> Rcpp_stream_dim(const std::string path);
+RcppExport SEXP _RcppML_Rcpp_stream_dim(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_stream_dim(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_predict_stream
+SEXP Rcpp_predict_stream(const std::string path, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const double upper_bound, const bool use_float, const bool sparse, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_predict_stream(SEXP pathSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparseSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse(sparseSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_stream(path, w, L1, L2, threads, upper_bound, use_float, sparse, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_stream
+Rcpp::List Rcpp_nmf_stream(const std::string path, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Eigen::MatrixXd w_init, const bool sort_model, const double upper_bound, const bool use_float, const bool loss_tol, const bool sparse_w, const bool sparse_h, const std::string solver, const bool inexact);
+RcppExport SEXP _RcppML_Rcpp_nmf_stream(SEXP pathSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP sparse_wSEXP, SEXP sparse_hSEXP, SEXP solverSEXP, SEXP inexactSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_w(sparse_wSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_h(sparse_hSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_stream(path, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, use_float, loss_tol, sparse_w, sparse_h, solver, inexact));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_list
+Rcpp::List Rcpp_nmf_list(const Rcpp::List& blocks, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Eigen::MatrixXd w_init, const bool sort_model, const double upper_bound, const bool use_float, const bool loss_tol, const bool sparse_w, const bool sparse_h, const std::string solver, const bool inexact);
+RcppExport SEXP _RcppML_Rcpp_nmf_list(SEXP blocksSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP loss_tolSEXP, SEXP sparse_wSEXP, SEXP sparse_hSEXP, SEXP solverSEXP, SEXP inexactSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type blocks(blocksSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_w(sparse_wSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse_h(sparse_hSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const bool >::type inexact(inexactSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_list(blocks, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, use_float, loss_tol, sparse_w, sparse_h, solver, inexact));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_predict_list
+SEXP Rcpp_predict_list(const Rcpp::List& blocks, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads, const double upper_bound, const bool use_float, const bool sparse, const std::string solver);
+RcppExport SEXP _RcppML_Rcpp_predict_list(SEXP blocksSEXP, SEXP wSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP upper_boundSEXP, SEXP use_floatSEXP, SEXP sparseSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type blocks(blocksSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const bool >::type use_float(use_floatSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse(sparseSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_predict_list(blocks, w, L1, L2, threads, upper_bound, use_float, sparse, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_mse_list
+double Rcpp_mse_list(const Rcpp::List& blocks, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_mse_list(SEXP blocksSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type blocks(blocksSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const Eigen::VectorXd& >::type d(dSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_list(blocks, w, d, h, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_partitioned
+Rcpp::List Rcpp_nmf_partitioned(const Rcpp::List& blocks, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Eigen::MatrixXd w_init, const bool sort_model);
+RcppExport SEXP _RcppML_Rcpp_nmf_partitioned(SEXP blocksSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP sort_modelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type blocks(blocksSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_partitioned(blocks, tol, maxit, L1, L2, threads, w_init, sort_model));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_async_sparse
+SEXP Rcpp_nmf_async_sparse(const Rcpp::S4& A, Eigen::MatrixXd w_init, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model, const bool loss_tol);
+RcppExport SEXP _RcppML_Rcpp_nmf_async_sparse(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP, SEXP loss_tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_async_sparse(A, w_init, tol, maxit, L1, L2, threads, sort_model, loss_tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_async_dense
+SEXP Rcpp_nmf_async_dense(const Eigen::MatrixXd& A, Eigen::MatrixXd w_init, const double tol, const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model, const bool loss_tol);
+RcppExport SEXP _RcppML_Rcpp_nmf_async_dense(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP sort_modelSEXP, SEXP loss_tolSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    Rcpp::traits::input_parameter< const bool >::type loss_tol(loss_tolSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_async_dense(A, w_init, tol, maxit, L1, L2, threads, sort_model, loss_tol));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_async_progress
+Rcpp::List Rcpp_nmf_async_progress(SEXP handle);
+RcppExport SEXP _RcppML_Rcpp_nmf_async_progress(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_async_progress(handle));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_async_cancel
+void Rcpp_nmf_async_cancel(SEXP handle);
+RcppExport SEXP _RcppML_Rcpp_nmf_async_cancel(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp_nmf_async_cancel(handle);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_nmf_async_collect
+Rcpp::List Rcpp_nmf_async_collect(SEXP handle);
+RcppExport SEXP _RcppML_Rcpp_nmf_async_collect(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_async_collect(handle));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_fitter_sparse
+SEXP Rcpp_nmf_fitter_sparse(const Rcpp::S4& A, Eigen::MatrixXd w_init, const double tol, const std::vector<double> L1, const std::vector<double> L2);
+RcppExport SEXP _RcppML_Rcpp_nmf_fitter_sparse(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP L1SEXP, SEXP L2SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_fitter_sparse(A, w_init, tol, L1, L2));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_fitter_dense
+SEXP Rcpp_nmf_fitter_dense(const Eigen::MatrixXd& A, Eigen::MatrixXd w_init, const double tol, const std::vector<double> L1, const std::vector<double> L2);
+RcppExport SEXP _RcppML_Rcpp_nmf_fitter_dense(SEXP ASEXP, SEXP w_initSEXP, SEXP tolSEXP, SEXP L1SEXP, SEXP L2SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_fitter_dense(A, w_init, tol, L1, L2));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_step
+Rcpp::List Rcpp_nmf_step(SEXP handle, const unsigned int n, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_nmf_step(SEXP handleSEXP, SEXP nSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_step(handle, n, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nmf_fitter_model
+Rcpp::List Rcpp_nmf_fitter_model(SEXP handle, const bool sort_model);
+RcppExport SEXP _RcppML_Rcpp_nmf_fitter_model(SEXP handleSEXP, SEXP sort_modelSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_fitter_model(handle, sort_model));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_bipartition_sparse
+Rcpp::List Rcpp_bipartition_sparse(const Rcpp::S4& A, const double tol, const unsigned int maxit, const bool nonneg, const std::vector<unsigned int>& samples, const unsigned int seed, const Eigen::MatrixXd& w_init, const bool verbose, const bool calc_dist, const bool diag, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_bipartition_sparse(SEXP ASEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP samplesSEXP, SEXP seedSEXP, SEXP w_initSEXP, SEXP verboseSEXP, SEXP calc_distSEXP, SEXP diagSEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const bool >::type calc_dist(calc_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type diag(diagSEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_bipartition_sparse(A, tol, maxit, nonneg, samples, seed, w_init, verbose, calc_dist, diag, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_bipartition_dense
+Rcpp::List Rcpp_bipartition_dense(const Eigen::Map<Eigen::MatrixXd> A, const double tol, const unsigned int maxit, const bool nonneg, const std::vector<unsigned int>& samples, const unsigned int seed, const Eigen::MatrixXd& w_init, const bool verbose, const bool calc_dist, const bool diag, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_bipartition_dense(SEXP ASEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP samplesSEXP, SEXP seedSEXP, SEXP w_initSEXP, SEXP verboseSEXP, SEXP calc_distSEXP, SEXP diagSEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type w_init(w_initSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const bool >::type calc_dist(calc_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type diag(diagSEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_bipartition_dense(A, tol, maxit, nonneg, samples, seed, w_init, verbose, calc_dist, diag, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_sparse
+Rcpp::List Rcpp_dclust_sparse(const Rcpp::S4& A, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads, const bool warm_start, const bool quality, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_dclust_sparse(SEXP ASEXP, SEXP min_samplesSEXP, SEXP min_distSEXP, SEXP verboseSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP seedSEXP, SEXP threadsSEXP, SEXP warm_startSEXP, SEXP qualitySEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_samples(min_samplesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_dist(min_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const bool >::type quality(qualitySEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_sparse(A, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, quality, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_dense
+Rcpp::List Rcpp_dclust_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads, const bool warm_start, const bool quality, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_dclust_dense(SEXP ASEXP, SEXP min_samplesSEXP, SEXP min_distSEXP, SEXP verboseSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP seedSEXP, SEXP threadsSEXP, SEXP warm_startSEXP, SEXP qualitySEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_samples(min_samplesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_dist(min_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const bool >::type quality(qualitySEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_dense(A, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, quality, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_update_sparse
+Rcpp::List Rcpp_dclust_update_sparse(const Rcpp::S4& A, const Rcpp::List& clusters, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads, const bool warm_start, const bool quality, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_dclust_update_sparse(SEXP ASEXP, SEXP clustersSEXP, SEXP min_samplesSEXP, SEXP min_distSEXP, SEXP verboseSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP seedSEXP, SEXP threadsSEXP, SEXP warm_startSEXP, SEXP qualitySEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type clusters(clustersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_samples(min_samplesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_dist(min_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const bool >::type quality(qualitySEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_update_sparse(A, clusters, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, quality, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_update_dense
+Rcpp::List Rcpp_dclust_update_dense(const Eigen::Map<Eigen::MatrixXd> A, const Rcpp::List& clusters, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads, const bool warm_start, const bool quality, const double switch_tol, const unsigned int subspace_iters);
+RcppExport SEXP _RcppML_Rcpp_dclust_update_dense(SEXP ASEXP, SEXP clustersSEXP, SEXP min_samplesSEXP, SEXP min_distSEXP, SEXP verboseSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP seedSEXP, SEXP threadsSEXP, SEXP warm_startSEXP, SEXP qualitySEXP, SEXP switch_tolSEXP, SEXP subspace_itersSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type clusters(clustersSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type min_samples(min_samplesSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_dist(min_distSEXP);
+    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
+    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type warm_start(warm_startSEXP);
+    Rcpp::traits::input_parameter< const bool >::type quality(qualitySEXP);
+    Rcpp::traits::input_parameter< const double >::type switch_tol(switch_tolSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type subspace_iters(subspace_itersSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_update_dense(A, clusters, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, quality, switch_tol, subspace_iters));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_dclust_predict_sparse
+std::vector<std::string> Rcpp_dclust_predict_sparse(const Rcpp::List& tree, const Rcpp::S4& A, const bool nonneg, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_dclust_predict_sparse(SEXP treeSEXP, SEXP ASEXP, SEXP nonnegSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type tree(treeSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_sparse(A, mask, w, d, h, threads, mask_zeros));
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_predict_sparse(tree, A, nonneg, threads));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_mse_dense
-double Rcpp_mse_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads, const bool mask_zeros);
-RcppExport SEXP _RcppML_Rcpp_mse_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP, SEXP mask_zerosSEXP) {
+// Rcpp_dclust_predict_dense
+std::vector<std::string> Rcpp_dclust_predict_dense(const Rcpp::List& tree, const Eigen::Map<Eigen::MatrixXd> A, const bool nonneg, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_dclust_predict_dense(SEXP treeSEXP, SEXP ASEXP, SEXP nonnegSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Eigen::MatrixXd& >::type A_(A_SEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
-    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type tree(treeSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_dense(A_, mask, w, d, h, threads, mask_zeros));
+    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_predict_dense(tree, A, nonneg, threads));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_mse_missing_sparse
-double Rcpp_mse_missing_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads);
-RcppExport SEXP _RcppML_Rcpp_mse_missing_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP) {
+// Rcpp_write_tree
+void Rcpp_write_tree(const std::string path, const Rcpp::List& tree, const bool nonneg);
+RcppExport SEXP _RcppML_Rcpp_write_tree(SEXP pathSEXP, SEXP treeSEXP, SEXP nonnegSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type tree(treeSEXP);
+    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp_write_tree(path, tree, nonneg);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_route_tree
+std::vector<std::string> Rcpp_route_tree(const std::string path, const Rcpp::S4& A);
+RcppExport SEXP _RcppML_Rcpp_route_tree(SEXP pathSEXP, SEXP ASEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
-    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_missing_sparse(A, mask, w, d, h, threads));
+    rcpp_result_gen = Rcpp::wrap(Rcpp_route_tree(path, A));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_mse_missing_dense
-double Rcpp_mse_missing_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads);
-RcppExport SEXP _RcppML_Rcpp_mse_missing_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP wSEXP, SEXP dSEXP, SEXP hSEXP, SEXP threadsSEXP) {
+// Rcpp_distance_sparse
+SEXP Rcpp_distance_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const unsigned int threads, const bool symmetric, const unsigned int k);
+RcppExport SEXP _RcppML_Rcpp_distance_sparse(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP threadsSEXP, SEXP symmetricSEXP, SEXP kSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Eigen::MatrixXd& >::type A_(A_SEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type w(wSEXP);
-    Rcpp::traits::input_parameter< Eigen::VectorXd >::type d(dSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_mse_missing_dense(A_, mask, w, d, h, threads));
+    Rcpp::traits::input_parameter< const bool >::type symmetric(symmetricSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_sparse(A, B, method, threads, symmetric, k));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_nmf_sparse
-Rcpp::List Rcpp_nmf_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound);
-RcppExport SEXP _RcppML_Rcpp_nmf_sparse(SEXP ASEXP, SEXP maskSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP link_matrix_hSEXP, SEXP mask_zerosSEXP, SEXP link_hSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP) {
+// Rcpp_distance_sparse_dense
+SEXP Rcpp_distance_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const unsigned int threads, const unsigned int k);
+RcppExport SEXP _RcppML_Rcpp_distance_sparse_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP threadsSEXP, SEXP kSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
-    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
-    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type link_matrix_h(link_matrix_hSEXP);
-    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
-    Rcpp::traits::input_parameter< const bool >::type link_h(link_hSEXP);
-    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
-    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_sparse(A, mask, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h, mask_zeros, link_h, sort_model, upper_bound));
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_sparse_dense(A, B, method, threads, k));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_nmf_dense
-Rcpp::List Rcpp_nmf_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound);
-RcppExport SEXP _RcppML_Rcpp_nmf_dense(SEXP A_SEXP, SEXP maskSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP verboseSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP threadsSEXP, SEXP w_initSEXP, SEXP link_matrix_hSEXP, SEXP mask_zerosSEXP, SEXP link_hSEXP, SEXP sort_modelSEXP, SEXP upper_boundSEXP) {
+// Rcpp_distance_dense
+SEXP Rcpp_distance_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const unsigned int threads, const bool symmetric, const unsigned int k);
+RcppExport SEXP _RcppML_Rcpp_distance_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP threadsSEXP, SEXP symmetricSEXP, SEXP kSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Eigen::MatrixXd& >::type A_(A_SEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type mask(maskSEXP);
-    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
-    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    Rcpp::traits::input_parameter< const std::vector<double> >::type L1(L1SEXP);
-    Rcpp::traits::input_parameter< const std::vector<double> >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    Rcpp::traits::input_parameter< Rcpp::List >::type w_init(w_initSEXP);
-    Rcpp::traits::input_parameter< const Rcpp::S4& >::type link_matrix_h(link_matrix_hSEXP);
-    Rcpp::traits::input_parameter< const bool >::type mask_zeros(mask_zerosSEXP);
-    Rcpp::traits::input_parameter< const bool >::type link_h(link_hSEXP);
-    Rcpp::traits::input_parameter< const bool >::type sort_model(sort_modelSEXP);
-    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_nmf_dense(A_, mask, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h, mask_zeros, link_h, sort_model, upper_bound));
+    Rcpp::traits::input_parameter< const bool >::type symmetric(symmetricSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_dense(A, B, method, threads, symmetric, k));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_bipartition_sparse
-Rcpp::List Rcpp_bipartition_sparse(const Rcpp::S4& A, const double tol, const unsigned int maxit, const bool nonneg, const std::vector<unsigned int>& samples, const unsigned int seed, const bool verbose, const bool calc_dist, const bool diag);
-RcppExport SEXP _RcppML_Rcpp_bipartition_sparse(SEXP ASEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP samplesSEXP, SEXP seedSEXP, SEXP verboseSEXP, SEXP calc_distSEXP, SEXP diagSEXP) {
+// Rcpp_write_distance_sparse
+void Rcpp_write_distance_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const std::string path, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_write_distance_sparse(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP pathSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp_write_distance_sparse(A, B, method, path, block_cols, threads);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_write_distance_sparse_dense
+void Rcpp_write_distance_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const std::string path, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_write_distance_sparse_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP pathSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp_write_distance_sparse_dense(A, B, method, path, block_cols, threads);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_write_distance_dense
+void Rcpp_write_distance_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const std::string path, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_write_distance_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP pathSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp_write_distance_dense(A, B, method, path, block_cols, threads);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_distance_float_sparse
+Rcpp::RawVector Rcpp_distance_float_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_distance_float_sparse(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
-    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
-    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type samples(samplesSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
-    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    Rcpp::traits::input_parameter< const bool >::type calc_dist(calc_distSEXP);
-    Rcpp::traits::input_parameter< const bool >::type diag(diagSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_bipartition_sparse(A, tol, maxit, nonneg, samples, seed, verbose, calc_dist, diag));
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_float_sparse(A, B, method, block_cols, threads));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_bipartition_dense
-Rcpp::List Rcpp_bipartition_dense(const Eigen::MatrixXd& A, const double tol, const unsigned int maxit, const bool nonneg, const std::vector<unsigned int>& samples, const unsigned int seed, const bool verbose, const bool calc_dist, const bool diag);
-RcppExport SEXP _RcppML_Rcpp_bipartition_dense(SEXP ASEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP samplesSEXP, SEXP seedSEXP, SEXP verboseSEXP, SEXP calc_distSEXP, SEXP diagSEXP) {
+// Rcpp_distance_float_sparse_dense
+Rcpp::RawVector Rcpp_distance_float_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_distance_float_sparse_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
-    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
-    Rcpp::traits::input_parameter< const std::vector<unsigned int>& >::type samples(samplesSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_float_sparse_dense(A, B, method, block_cols, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_distance_float_dense
+Rcpp::RawVector Rcpp_distance_float_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const unsigned int block_cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_distance_float_dense(SEXP ASEXP, SEXP BSEXP, SEXP methodSEXP, SEXP block_colsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type B(BSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type block_cols(block_colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_distance_float_dense(A, B, method, block_cols, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_ann_build
+Rcpp::List Rcpp_ann_build(const Eigen::Map<Eigen::MatrixXd> x, const unsigned int n_trees, const unsigned int leaf_size, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_ann_build(SEXP xSEXP, SEXP n_treesSEXP, SEXP leaf_sizeSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_trees(n_treesSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type leaf_size(leaf_sizeSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
-    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    Rcpp::traits::input_parameter< const bool >::type calc_dist(calc_distSEXP);
-    Rcpp::traits::input_parameter< const bool >::type diag(diagSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_bipartition_dense(A, tol, maxit, nonneg, samples, seed, verbose, calc_dist, diag));
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_ann_build(x, n_trees, leaf_size, seed, threads));
     return rcpp_result_gen;
 END_RCPP
 }
-// Rcpp_dclust_sparse
-Rcpp::List Rcpp_dclust_sparse(const Rcpp::S4& A, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads);
-RcppExport SEXP _RcppML_Rcpp_dclust_sparse(SEXP ASEXP, SEXP min_samplesSEXP, SEXP min_distSEXP, SEXP verboseSEXP, SEXP tolSEXP, SEXP maxitSEXP, SEXP nonnegSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+// Rcpp_ann_query
+Rcpp::List Rcpp_ann_query(const Rcpp::List& index, const Eigen::Map<Eigen::MatrixXd> q, const unsigned int k, const unsigned int search_k, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_ann_query(SEXP indexSEXP, SEXP qSEXP, SEXP kSEXP, SEXP search_kSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type index(indexSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type q(qSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type search_k(search_kSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_ann_query(index, q, k, search_k, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_align_models
+Rcpp::List Rcpp_align_models(const Rcpp::List& w, const Eigen::Map<Eigen::MatrixXd> ref, const std::string method, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_align_models(SEXP wSEXP, SEXP refSEXP, SEXP methodSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type ref(refSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_align_models(w, ref, method, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_summarize_groups_dense
+Rcpp::List Rcpp_summarize_groups_dense(const Eigen::Map<Eigen::MatrixXd> x, const std::vector<int>& group, const unsigned int n_groups, const bool by_col, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_summarize_groups_dense(SEXP xSEXP, SEXP groupSEXP, SEXP n_groupsSEXP, SEXP by_colSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_groups(n_groupsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type by_col(by_colSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_summarize_groups_dense(x, group, n_groups, by_col, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_summarize_groups_sparse
+Rcpp::List Rcpp_summarize_groups_sparse(const Rcpp::S4& x, const std::vector<int>& group, const unsigned int n_groups, const bool by_col, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_summarize_groups_sparse(SEXP xSEXP, SEXP groupSEXP, SEXP n_groupsSEXP, SEXP by_colSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type x(xSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type n_groups(n_groupsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type by_col(by_colSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_summarize_groups_sparse(x, group, n_groups, by_col, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_reconstruct_pattern
+Rcpp::NumericVector Rcpp_reconstruct_pattern(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Rcpp::S4& pattern, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_reconstruct_pattern(SEXP wdSEXP, SEXP hSEXP, SEXP patternSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type wd(wdSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type pattern(patternSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_reconstruct_pattern(wd, h, pattern, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_reconstruct_residuals
+Rcpp::List Rcpp_reconstruct_residuals(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Rcpp::S4& A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_reconstruct_residuals(SEXP wdSEXP, SEXP hSEXP, SEXP ASEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type wd(wdSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
     Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type min_samples(min_samplesSEXP);
-    Rcpp::traits::input_parameter< const double >::type min_dist(min_distSEXP);
-    Rcpp::traits::input_parameter< const bool >::type verbose(verboseSEXP);
-    Rcpp::traits::input_parameter< const double >::type tol(tolSEXP);
-    Rcpp::traits::input_parameter< const unsigned int >::type maxit(maxitSEXP);
-    Rcpp::traits::input_parameter< const bool >::type nonneg(nonnegSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_reconstruct_residuals(wd, h, A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_reconstruct_subset
+Eigen::MatrixXd Rcpp_reconstruct_subset(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows, const std::vector<int>& cols, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_reconstruct_subset(SEXP wdSEXP, SEXP hSEXP, SEXP rowsSEXP, SEXP colsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type wd(wdSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type cols(colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_reconstruct_subset(wd, h, rows, cols, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_reconstruct_sink
+void Rcpp_reconstruct_sink(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows, const std::vector<int>& cols, const unsigned int tile_size, SEXP sink, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_reconstruct_sink(SEXP wdSEXP, SEXP hSEXP, SEXP rowsSEXP, SEXP colsSEXP, SEXP tile_sizeSEXP, SEXP sinkSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type wd(wdSEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type cols(colsSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type tile_size(tile_sizeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type sink(sinkSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp_reconstruct_sink(wd, h, rows, cols, tile_size, sink, threads);
+    return R_NilValue;
+END_RCPP
+}
+// Rcpp_read_mtx
+Rcpp::List Rcpp_read_mtx(const std::string& path, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_read_mtx(SEXP pathSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_read_mtx(path, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_crossprod_sparse
+Eigen::MatrixXd Rcpp_crossprod_sparse(const Eigen::MatrixXd& x_t, const Rcpp::S4& A, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_crossprod_sparse(SEXP x_tSEXP, SEXP ASEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type x_t(x_tSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_crossprod_sparse(x_t, A, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_prod_sparse
+Eigen::MatrixXd Rcpp_prod_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& y, Rcpp::List prepared, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_prod_sparse(SEXP ASEXP, SEXP ySEXP, SEXP preparedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type A(ASEXP);
+    Rcpp::traits::input_parameter< const Eigen::MatrixXd& >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type prepared(preparedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_prod_sparse(A, y, prepared, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_consensus
+Rcpp::List Rcpp_consensus(const Rcpp::List& h, const unsigned int max_groups, const unsigned int seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_consensus(SEXP hSEXP, SEXP max_groupsSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type h(hSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type max_groups(max_groupsSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type seed(seedSEXP);
     Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(Rcpp_dclust_sparse(A, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads));
+    rcpp_result_gen = Rcpp::wrap(Rcpp_consensus(h, max_groups, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_nnls
+SEXP Rcpp_nnls(const Eigen::Map<Eigen::MatrixXd> a, const Eigen::Map<Eigen::MatrixXd> b, const unsigned int cd_maxit, const double cd_tol, const double L1, const double L2, const double upper_bound, const std::string solver, const unsigned int threads, const bool sparse);
+RcppExport SEXP _RcppML_Rcpp_nnls(SEXP aSEXP, SEXP bSEXP, SEXP cd_maxitSEXP, SEXP cd_tolSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP threadsSEXP, SEXP sparseSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type a(aSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type b(bSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type cd_maxit(cd_maxitSEXP);
+    Rcpp::traits::input_parameter< const double >::type cd_tol(cd_tolSEXP);
+    Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
+    Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
+    Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse(sparseSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nnls(a, b, cd_maxit, cd_tol, L1, L2, upper_bound, solver, threads, sparse));
     return rcpp_result_gen;
 END_RCPP
 }
-// nnls
-Eigen::MatrixXd nnls(Eigen::MatrixXd a, Eigen::MatrixXd b, unsigned int cd_maxit, const double cd_tol, const double L1, const double L2, const double upper_bound);
-RcppExport SEXP _RcppML_nnls(SEXP aSEXP, SEXP bSEXP, SEXP cd_maxitSEXP, SEXP cd_tolSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP) {
+// Rcpp_nnls_sparse
+SEXP Rcpp_nnls_sparse(const Eigen::Map<Eigen::MatrixXd> a, const Rcpp::S4& b, const Eigen::Map<Eigen::MatrixXd> w, const unsigned int cd_maxit, const double cd_tol, const double L1, const double L2, const double upper_bound, const std::string solver, const unsigned int threads, const bool sparse);
+RcppExport SEXP _RcppML_Rcpp_nnls_sparse(SEXP aSEXP, SEXP bSEXP, SEXP wSEXP, SEXP cd_maxitSEXP, SEXP cd_tolSEXP, SEXP L1SEXP, SEXP L2SEXP, SEXP upper_boundSEXP, SEXP solverSEXP, SEXP threadsSEXP, SEXP sparseSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type a(aSEXP);
-    Rcpp::traits::input_parameter< Eigen::MatrixXd >::type b(bSEXP);
-    Rcpp::traits::input_parameter< unsigned int >::type cd_maxit(cd_maxitSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type a(aSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::S4& >::type b(bSEXP);
+    Rcpp::traits::input_parameter< const Eigen::Map<Eigen::MatrixXd> >::type w(wSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type cd_maxit(cd_maxitSEXP);
     Rcpp::traits::input_parameter< const double >::type cd_tol(cd_tolSEXP);
     Rcpp::traits::input_parameter< const double >::type L1(L1SEXP);
     Rcpp::traits::input_parameter< const double >::type L2(L2SEXP);
     Rcpp::traits::input_parameter< const double >::type upper_bound(upper_boundSEXP);
-    rcpp_result_gen = Rcpp::wrap(nnls(a, b, cd_maxit, cd_tol, L1, L2, upper_bound));
+    Rcpp::traits::input_parameter< const std::string >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const bool >::type sparse(sparseSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_nnls_sparse(a, b, w, cd_maxit, cd_tol, L1, L2, upper_bound, solver, threads, sparse));
     return rcpp_result_gen;
 END_RCPP
 }
 // c_rmatrix
-Rcpp::NumericMatrix c_rmatrix(uint32_t nrow, uint32_t ncol, uint32_t rng);
-RcppExport SEXP _RcppML_c_rmatrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP rngSEXP) {
+Rcpp::NumericMatrix c_rmatrix(uint32_t nrow, uint32_t ncol, uint32_t rng, const unsigned int threads);
+RcppExport SEXP _RcppML_c_rmatrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP rngSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< uint32_t >::type nrow(nrowSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type ncol(ncolSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type rng(rngSEXP);
-    rcpp_result_gen = Rcpp::wrap(c_rmatrix(nrow, ncol, rng));
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_rmatrix(nrow, ncol, rng, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // c_rtimatrix
-Rcpp::NumericMatrix c_rtimatrix(uint32_t nrow, uint32_t ncol, uint32_t rng);
-RcppExport SEXP _RcppML_c_rtimatrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP rngSEXP) {
+Rcpp::NumericMatrix c_rtimatrix(uint32_t nrow, uint32_t ncol, uint32_t rng, const unsigned int threads);
+RcppExport SEXP _RcppML_c_rtimatrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP rngSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< uint32_t >::type nrow(nrowSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type ncol(ncolSEXP);
     Rcpp::traits::input_parameter< uint32_t >::type rng(rngSEXP);
-    rcpp_result_gen = Rcpp::wrap(c_rtimatrix(nrow, ncol, rng));
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_rtimatrix(nrow, ncol, rng, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // c_runif
-Rcpp::NumericVector c_runif(const uint32_t n, const float min, const float max, const uint32_t rng, const uint32_t rng2);
-RcppExport SEXP _RcppML_c_runif(SEXP nSEXP, SEXP minSEXP, SEXP maxSEXP, SEXP rngSEXP, SEXP rng2SEXP) {
+Rcpp::NumericVector c_runif(const uint32_t n, const float min, const float max, const uint32_t rng, const uint32_t rng2, const unsigned int threads);
+RcppExport SEXP _RcppML_c_runif(SEXP nSEXP, SEXP minSEXP, SEXP maxSEXP, SEXP rngSEXP, SEXP rng2SEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -272,13 +1920,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const float >::type max(maxSEXP);
     Rcpp::traits::input_parameter< const uint32_t >::type rng(rngSEXP);
     Rcpp::traits::input_parameter< const uint32_t >::type rng2(rng2SEXP);
-    rcpp_result_gen = Rcpp::wrap(c_runif(n, min, max, rng, rng2));
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_runif(n, min, max, rng, rng2, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // c_rbinom
-Rcpp::IntegerVector c_rbinom(const uint32_t n, uint32_t size, const uint32_t inv_probability, const uint32_t rng, const uint32_t rng2);
-RcppExport SEXP _RcppML_c_rbinom(SEXP nSEXP, SEXP sizeSEXP, SEXP inv_probabilitySEXP, SEXP rngSEXP, SEXP rng2SEXP) {
+Rcpp::IntegerVector c_rbinom(const uint32_t n, uint32_t size, const uint32_t inv_probability, const uint32_t rng, const uint32_t rng2, const unsigned int threads);
+RcppExport SEXP _RcppML_c_rbinom(SEXP nSEXP, SEXP sizeSEXP, SEXP inv_probabilitySEXP, SEXP rngSEXP, SEXP rng2SEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -287,7 +1936,8 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const uint32_t >::type inv_probability(inv_probabilitySEXP);
     Rcpp::traits::input_parameter< const uint32_t >::type rng(rngSEXP);
     Rcpp::traits::input_parameter< const uint32_t >::type rng2(rng2SEXP);
-    rcpp_result_gen = Rcpp::wrap(c_rbinom(n, size, inv_probability, rng, rng2));
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_rbinom(n, size, inv_probability, rng, rng2, threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -307,8 +1957,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // c_rtisparsematrix
-Rcpp::S4 c_rtisparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng);
-RcppExport SEXP _RcppML_c_rtisparsematrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP inv_probabilitySEXP, SEXP pattern_onlySEXP, SEXP rngSEXP) {
+Rcpp::S4 c_rtisparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng, const bool skip, const unsigned int threads);
+RcppExport SEXP _RcppML_c_rtisparsematrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP inv_probabilitySEXP, SEXP pattern_onlySEXP, SEXP rngSEXP, SEXP skipSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -317,13 +1967,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const uint32_t >::type inv_probability(inv_probabilitySEXP);
     Rcpp::traits::input_parameter< const bool >::type pattern_only(pattern_onlySEXP);
     Rcpp::traits::input_parameter< uint32_t >::type rng(rngSEXP);
-    rcpp_result_gen = Rcpp::wrap(c_rtisparsematrix(nrow, ncol, inv_probability, pattern_only, rng));
+    Rcpp::traits::input_parameter< const bool >::type skip(skipSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_rtisparsematrix(nrow, ncol, inv_probability, pattern_only, rng, skip, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 // c_rsparsematrix
-Rcpp::S4 c_rsparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng);
-RcppExport SEXP _RcppML_c_rsparsematrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP inv_probabilitySEXP, SEXP pattern_onlySEXP, SEXP rngSEXP) {
+Rcpp::S4 c_rsparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng, const bool skip, const unsigned int threads);
+RcppExport SEXP _RcppML_c_rsparsematrix(SEXP nrowSEXP, SEXP ncolSEXP, SEXP inv_probabilitySEXP, SEXP pattern_onlySEXP, SEXP rngSEXP, SEXP skipSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -332,7 +1984,66 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const uint32_t >::type inv_probability(inv_probabilitySEXP);
     Rcpp::traits::input_parameter< const bool >::type pattern_only(pattern_onlySEXP);
     Rcpp::traits::input_parameter< uint32_t >::type rng(rngSEXP);
-    rcpp_result_gen = Rcpp::wrap(c_rsparsematrix(nrow, ncol, inv_probability, pattern_only, rng));
+    Rcpp::traits::input_parameter< const bool >::type skip(skipSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(c_rsparsematrix(nrow, ncol, inv_probability, pattern_only, rng, skip, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_simulate_nmf
+Rcpp::List Rcpp_simulate_nmf(const uint32_t nrow, const uint32_t ncol, const uint32_t k, const double noise, const double dropout, const uint32_t seed, const unsigned int threads);
+RcppExport SEXP _RcppML_Rcpp_simulate_nmf(SEXP nrowSEXP, SEXP ncolSEXP, SEXP kSEXP, SEXP noiseSEXP, SEXP dropoutSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const uint32_t >::type nrow(nrowSEXP);
+    Rcpp::traits::input_parameter< const uint32_t >::type ncol(ncolSEXP);
+    Rcpp::traits::input_parameter< const uint32_t >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const double >::type noise(noiseSEXP);
+    Rcpp::traits::input_parameter< const double >::type dropout(dropoutSEXP);
+    Rcpp::traits::input_parameter< const uint32_t >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_simulate_nmf(nrow, ncol, k, noise, dropout, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_solver_counters
+Rcpp::NumericVector Rcpp_solver_counters(const bool reset);
+RcppExport SEXP _RcppML_Rcpp_solver_counters(SEXP resetSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const bool >::type reset(resetSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_solver_counters(reset));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_thread_costs
+Rcpp::NumericVector Rcpp_thread_costs(const bool measure, const double min_work, const int bandwidth_threads, const int numa, const int reproducible, const unsigned int threads, const int huge_pages);
+RcppExport SEXP _RcppML_Rcpp_thread_costs(SEXP measureSEXP, SEXP min_workSEXP, SEXP bandwidth_threadsSEXP, SEXP numaSEXP, SEXP reproducibleSEXP, SEXP threadsSEXP, SEXP huge_pagesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const bool >::type measure(measureSEXP);
+    Rcpp::traits::input_parameter< const double >::type min_work(min_workSEXP);
+    Rcpp::traits::input_parameter< const int >::type bandwidth_threads(bandwidth_threadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type numa(numaSEXP);
+    Rcpp::traits::input_parameter< const int >::type reproducible(reproducibleSEXP);
+    Rcpp::traits::input_parameter< const unsigned int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type huge_pages(huge_pagesSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_thread_costs(measure, min_work, bandwidth_threads, numa, reproducible, threads, huge_pages));
+    return rcpp_result_gen;
+END_RCPP
+}
+// Rcpp_kernel_threads
+unsigned int Rcpp_kernel_threads(const double flops, const double bytes);
+RcppExport SEXP _RcppML_Rcpp_kernel_threads(SEXP flopsSEXP, SEXP bytesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const double >::type flops(flopsSEXP);
+    Rcpp::traits::input_parameter< const double >::type bytes(bytesSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_kernel_threads(flops, bytes));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -347,28 +2058,140 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// Rcpp_bipartite_match_jv
+Rcpp::List Rcpp_bipartite_match_jv(Rcpp::NumericMatrix x);
+RcppExport SEXP _RcppML_Rcpp_bipartite_match_jv(SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(Rcpp_bipartite_match_jv(x));
+    return rcpp_result_gen;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_RcppML_Rcpp_predict_sparse", (DL_FUNC) &_RcppML_Rcpp_predict_sparse, 8},
-    {"_RcppML_Rcpp_predict_dense", (DL_FUNC) &_RcppML_Rcpp_predict_dense, 8},
+    {"_RcppML_Rcpp_predict_sparse", (DL_FUNC) &_RcppML_Rcpp_predict_sparse, 16},
+    {"_RcppML_Rcpp_predict_dense", (DL_FUNC) &_RcppML_Rcpp_predict_dense, 16},
+    {"_RcppML_Rcpp_predict_sink_sparse", (DL_FUNC) &_RcppML_Rcpp_predict_sink_sparse, 14},
+    {"_RcppML_Rcpp_predict_sink_dense", (DL_FUNC) &_RcppML_Rcpp_predict_sink_dense, 14},
+    {"_RcppML_Rcpp_predict_half_sparse", (DL_FUNC) &_RcppML_Rcpp_predict_half_sparse, 11},
+    {"_RcppML_Rcpp_predict_half_dense", (DL_FUNC) &_RcppML_Rcpp_predict_half_dense, 11},
+    {"_RcppML_Rcpp_projector", (DL_FUNC) &_RcppML_Rcpp_projector, 6},
+    {"_RcppML_Rcpp_projector_file", (DL_FUNC) &_RcppML_Rcpp_projector_file, 6},
+    {"_RcppML_Rcpp_project_sparse", (DL_FUNC) &_RcppML_Rcpp_project_sparse, 5},
+    {"_RcppML_Rcpp_project_dense", (DL_FUNC) &_RcppML_Rcpp_project_dense, 5},
+    {"_RcppML_Rcpp_project_sample", (DL_FUNC) &_RcppML_Rcpp_project_sample, 3},
+    {"_RcppML_Rcpp_project_batch_sparse", (DL_FUNC) &_RcppML_Rcpp_project_batch_sparse, 3},
+    {"_RcppML_Rcpp_project_batch_dense", (DL_FUNC) &_RcppML_Rcpp_project_batch_dense, 3},
+    {"_RcppML_Rcpp_projector_info", (DL_FUNC) &_RcppML_Rcpp_projector_info, 1},
+    {"_RcppML_Rcpp_write_model", (DL_FUNC) &_RcppML_Rcpp_write_model, 6},
+    {"_RcppML_Rcpp_read_model", (DL_FUNC) &_RcppML_Rcpp_read_model, 1},
+    {"_RcppML_Rcpp_half_encode", (DL_FUNC) &_RcppML_Rcpp_half_encode, 3},
+    {"_RcppML_Rcpp_half_decode", (DL_FUNC) &_RcppML_Rcpp_half_decode, 5},
+    {"_RcppML_Rcpp_half_subset", (DL_FUNC) &_RcppML_Rcpp_half_subset, 5},
+    {"_RcppML_Rcpp_column_groups", (DL_FUNC) &_RcppML_Rcpp_column_groups, 2},
+    {"_RcppML_Rcpp_hash_features", (DL_FUNC) &_RcppML_Rcpp_hash_features, 5},
+    {"_RcppML_Rcpp_project_stacked_sparse", (DL_FUNC) &_RcppML_Rcpp_project_stacked_sparse, 7},
+    {"_RcppML_Rcpp_project_stacked_dense", (DL_FUNC) &_RcppML_Rcpp_project_stacked_dense, 7},
     {"_RcppML_Rcpp_mse_sparse", (DL_FUNC) &_RcppML_Rcpp_mse_sparse, 7},
     {"_RcppML_Rcpp_mse_dense", (DL_FUNC) &_RcppML_Rcpp_mse_dense, 7},
     {"_RcppML_Rcpp_mse_missing_sparse", (DL_FUNC) &_RcppML_Rcpp_mse_missing_sparse, 6},
     {"_RcppML_Rcpp_mse_missing_dense", (DL_FUNC) &_RcppML_Rcpp_mse_missing_dense, 6},
-    {"_RcppML_Rcpp_nmf_sparse", (DL_FUNC) &_RcppML_Rcpp_nmf_sparse, 14},
-    {"_RcppML_Rcpp_nmf_dense", (DL_FUNC) &_RcppML_Rcpp_nmf_dense, 14},
-    {"_RcppML_Rcpp_bipartition_sparse", (DL_FUNC) &_RcppML_Rcpp_bipartition_sparse, 9},
-    {"_RcppML_Rcpp_bipartition_dense", (DL_FUNC) &_RcppML_Rcpp_bipartition_dense, 9},
-    {"_RcppML_Rcpp_dclust_sparse", (DL_FUNC) &_RcppML_Rcpp_dclust_sparse, 9},
-    {"_RcppML_nnls", (DL_FUNC) &_RcppML_nnls, 7},
-    {"_RcppML_c_rmatrix", (DL_FUNC) &_RcppML_c_rmatrix, 3},
-    {"_RcppML_c_rtimatrix", (DL_FUNC) &_RcppML_c_rtimatrix, 3},
-    {"_RcppML_c_runif", (DL_FUNC) &_RcppML_c_runif, 5},
-    {"_RcppML_c_rbinom", (DL_FUNC) &_RcppML_c_rbinom, 5},
+    {"_RcppML_Rcpp_mse_hashed_sparse", (DL_FUNC) &_RcppML_Rcpp_mse_hashed_sparse, 8},
+    {"_RcppML_Rcpp_mse_hashed_dense", (DL_FUNC) &_RcppML_Rcpp_mse_hashed_dense, 8},
+    {"_RcppML_Rcpp_mse_blocked_sparse", (DL_FUNC) &_RcppML_Rcpp_mse_blocked_sparse, 8},
+    {"_RcppML_Rcpp_mse_blocked_dense", (DL_FUNC) &_RcppML_Rcpp_mse_blocked_dense, 8},
+    {"_RcppML_Rcpp_mse_models_sparse", (DL_FUNC) &_RcppML_Rcpp_mse_models_sparse, 6},
+    {"_RcppML_Rcpp_nmf_sparse", (DL_FUNC) &_RcppML_Rcpp_nmf_sparse, 53},
+    {"_RcppML_Rcpp_nmf_dense", (DL_FUNC) &_RcppML_Rcpp_nmf_dense, 47},
+    {"_RcppML_Rcpp_init_w", (DL_FUNC) &_RcppML_Rcpp_init_w, 2},
+    {"_RcppML_Rcpp_gram", (DL_FUNC) &_RcppML_Rcpp_gram, 2},
+    {"_RcppML_Rcpp_nndsvd_sparse", (DL_FUNC) &_RcppML_Rcpp_nndsvd_sparse, 5},
+    {"_RcppML_Rcpp_nndsvd_dense", (DL_FUNC) &_RcppML_Rcpp_nndsvd_dense, 5},
+    {"_RcppML_Rcpp_dclust_init_sparse", (DL_FUNC) &_RcppML_Rcpp_dclust_init_sparse, 4},
+    {"_RcppML_Rcpp_dclust_init_dense", (DL_FUNC) &_RcppML_Rcpp_dclust_init_dense, 4},
+    {"_RcppML_Rcpp_metacells_sparse", (DL_FUNC) &_RcppML_Rcpp_metacells_sparse, 4},
+    {"_RcppML_Rcpp_metacells_dense", (DL_FUNC) &_RcppML_Rcpp_metacells_dense, 4},
+    {"_RcppML_Rcpp_compressed_nmf_sparse", (DL_FUNC) &_RcppML_Rcpp_compressed_nmf_sparse, 11},
+    {"_RcppML_Rcpp_compressed_nmf_dense", (DL_FUNC) &_RcppML_Rcpp_compressed_nmf_dense, 11},
+    {"_RcppML_Rcpp_snmf_sparse", (DL_FUNC) &_RcppML_Rcpp_snmf_sparse, 10},
+    {"_RcppML_Rcpp_snmf_dense", (DL_FUNC) &_RcppML_Rcpp_snmf_dense, 10},
+    {"_RcppML_Rcpp_implicit_nmf", (DL_FUNC) &_RcppML_Rcpp_implicit_nmf, 10},
+    {"_RcppML_Rcpp_kl_nmf", (DL_FUNC) &_RcppML_Rcpp_kl_nmf, 9},
+    {"_RcppML_Rcpp_lnmf_sparse", (DL_FUNC) &_RcppML_Rcpp_lnmf_sparse, 11},
+    {"_RcppML_Rcpp_lnmf_dense", (DL_FUNC) &_RcppML_Rcpp_lnmf_dense, 11},
+    {"_RcppML_Rcpp_cross_validate_sparse", (DL_FUNC) &_RcppML_Rcpp_cross_validate_sparse, 18},
+    {"_RcppML_Rcpp_cross_validate_dense", (DL_FUNC) &_RcppML_Rcpp_cross_validate_dense, 18},
+    {"_RcppML_Rcpp_prepare_sparse", (DL_FUNC) &_RcppML_Rcpp_prepare_sparse, 2},
+    {"_RcppML_Rcpp_matrix_cache", (DL_FUNC) &_RcppML_Rcpp_matrix_cache, 2},
+    {"_RcppML_Rcpp_memory_accounting", (DL_FUNC) &_RcppML_Rcpp_memory_accounting, 1},
+    {"_RcppML_Rcpp_scan_sparse", (DL_FUNC) &_RcppML_Rcpp_scan_sparse, 2},
+    {"_RcppML_Rcpp_scan_dense", (DL_FUNC) &_RcppML_Rcpp_scan_dense, 2},
+    {"_RcppML_Rcpp_write_stream", (DL_FUNC) &_RcppML_Rcpp_write_stream, 4},
+    {"_RcppML_Rcpp_stream_dim", (DL_FUNC) &_RcppML_Rcpp_stream_dim, 1},
+    {"_RcppML_Rcpp_predict_stream", (DL_FUNC) &_RcppML_Rcpp_predict_stream, 9},
+    {"_RcppML_Rcpp_nmf_stream", (DL_FUNC) &_RcppML_Rcpp_nmf_stream, 16},
+    {"_RcppML_Rcpp_nmf_list", (DL_FUNC) &_RcppML_Rcpp_nmf_list, 16},
+    {"_RcppML_Rcpp_predict_list", (DL_FUNC) &_RcppML_Rcpp_predict_list, 9},
+    {"_RcppML_Rcpp_mse_list", (DL_FUNC) &_RcppML_Rcpp_mse_list, 5},
+    {"_RcppML_Rcpp_nmf_partitioned", (DL_FUNC) &_RcppML_Rcpp_nmf_partitioned, 8},
+    {"_RcppML_Rcpp_nmf_async_sparse", (DL_FUNC) &_RcppML_Rcpp_nmf_async_sparse, 9},
+    {"_RcppML_Rcpp_nmf_async_dense", (DL_FUNC) &_RcppML_Rcpp_nmf_async_dense, 9},
+    {"_RcppML_Rcpp_nmf_async_progress", (DL_FUNC) &_RcppML_Rcpp_nmf_async_progress, 1},
+    {"_RcppML_Rcpp_nmf_async_cancel", (DL_FUNC) &_RcppML_Rcpp_nmf_async_cancel, 1},
+    {"_RcppML_Rcpp_nmf_async_collect", (DL_FUNC) &_RcppML_Rcpp_nmf_async_collect, 1},
+    {"_RcppML_Rcpp_nmf_fitter_sparse", (DL_FUNC) &_RcppML_Rcpp_nmf_fitter_sparse, 5},
+    {"_RcppML_Rcpp_nmf_fitter_dense", (DL_FUNC) &_RcppML_Rcpp_nmf_fitter_dense, 5},
+    {"_RcppML_Rcpp_nmf_step", (DL_FUNC) &_RcppML_Rcpp_nmf_step, 3},
+    {"_RcppML_Rcpp_nmf_fitter_model", (DL_FUNC) &_RcppML_Rcpp_nmf_fitter_model, 2},
+    {"_RcppML_Rcpp_bipartition_sparse", (DL_FUNC) &_RcppML_Rcpp_bipartition_sparse, 12},
+    {"_RcppML_Rcpp_bipartition_dense", (DL_FUNC) &_RcppML_Rcpp_bipartition_dense, 12},
+    {"_RcppML_Rcpp_dclust_sparse", (DL_FUNC) &_RcppML_Rcpp_dclust_sparse, 13},
+    {"_RcppML_Rcpp_dclust_dense", (DL_FUNC) &_RcppML_Rcpp_dclust_dense, 13},
+    {"_RcppML_Rcpp_dclust_update_sparse", (DL_FUNC) &_RcppML_Rcpp_dclust_update_sparse, 14},
+    {"_RcppML_Rcpp_dclust_update_dense", (DL_FUNC) &_RcppML_Rcpp_dclust_update_dense, 14},
+    {"_RcppML_Rcpp_dclust_predict_sparse", (DL_FUNC) &_RcppML_Rcpp_dclust_predict_sparse, 4},
+    {"_RcppML_Rcpp_dclust_predict_dense", (DL_FUNC) &_RcppML_Rcpp_dclust_predict_dense, 4},
+    {"_RcppML_Rcpp_write_tree", (DL_FUNC) &_RcppML_Rcpp_write_tree, 3},
+    {"_RcppML_Rcpp_route_tree", (DL_FUNC) &_RcppML_Rcpp_route_tree, 2},
+    {"_RcppML_Rcpp_distance_sparse", (DL_FUNC) &_RcppML_Rcpp_distance_sparse, 6},
+    {"_RcppML_Rcpp_distance_sparse_dense", (DL_FUNC) &_RcppML_Rcpp_distance_sparse_dense, 5},
+    {"_RcppML_Rcpp_distance_dense", (DL_FUNC) &_RcppML_Rcpp_distance_dense, 6},
+    {"_RcppML_Rcpp_write_distance_sparse", (DL_FUNC) &_RcppML_Rcpp_write_distance_sparse, 6},
+    {"_RcppML_Rcpp_write_distance_sparse_dense", (DL_FUNC) &_RcppML_Rcpp_write_distance_sparse_dense, 6},
+    {"_RcppML_Rcpp_write_distance_dense", (DL_FUNC) &_RcppML_Rcpp_write_distance_dense, 6},
+    {"_RcppML_Rcpp_distance_float_sparse", (DL_FUNC) &_RcppML_Rcpp_distance_float_sparse, 5},
+    {"_RcppML_Rcpp_distance_float_sparse_dense", (DL_FUNC) &_RcppML_Rcpp_distance_float_sparse_dense, 5},
+    {"_RcppML_Rcpp_distance_float_dense", (DL_FUNC) &_RcppML_Rcpp_distance_float_dense, 5},
+    {"_RcppML_Rcpp_ann_build", (DL_FUNC) &_RcppML_Rcpp_ann_build, 5},
+    {"_RcppML_Rcpp_ann_query", (DL_FUNC) &_RcppML_Rcpp_ann_query, 5},
+    {"_RcppML_Rcpp_align_models", (DL_FUNC) &_RcppML_Rcpp_align_models, 4},
+    {"_RcppML_Rcpp_summarize_groups_dense", (DL_FUNC) &_RcppML_Rcpp_summarize_groups_dense, 5},
+    {"_RcppML_Rcpp_summarize_groups_sparse", (DL_FUNC) &_RcppML_Rcpp_summarize_groups_sparse, 5},
+    {"_RcppML_Rcpp_reconstruct_pattern", (DL_FUNC) &_RcppML_Rcpp_reconstruct_pattern, 4},
+    {"_RcppML_Rcpp_reconstruct_residuals", (DL_FUNC) &_RcppML_Rcpp_reconstruct_residuals, 4},
+    {"_RcppML_Rcpp_reconstruct_subset", (DL_FUNC) &_RcppML_Rcpp_reconstruct_subset, 5},
+    {"_RcppML_Rcpp_reconstruct_sink", (DL_FUNC) &_RcppML_Rcpp_reconstruct_sink, 7},
+    {"_RcppML_Rcpp_read_mtx", (DL_FUNC) &_RcppML_Rcpp_read_mtx, 2},
+    {"_RcppML_Rcpp_crossprod_sparse", (DL_FUNC) &_RcppML_Rcpp_crossprod_sparse, 3},
+    {"_RcppML_Rcpp_prod_sparse", (DL_FUNC) &_RcppML_Rcpp_prod_sparse, 4},
+    {"_RcppML_Rcpp_consensus", (DL_FUNC) &_RcppML_Rcpp_consensus, 4},
+    {"_RcppML_Rcpp_nnls", (DL_FUNC) &_RcppML_Rcpp_nnls, 10},
+    {"_RcppML_Rcpp_nnls_sparse", (DL_FUNC) &_RcppML_Rcpp_nnls_sparse, 11},
+    {"_RcppML_c_rmatrix", (DL_FUNC) &_RcppML_c_rmatrix, 4},
+    {"_RcppML_c_rtimatrix", (DL_FUNC) &_RcppML_c_rtimatrix, 4},
+    {"_RcppML_c_runif", (DL_FUNC) &_RcppML_c_runif, 6},
+    {"_RcppML_c_rbinom", (DL_FUNC) &_RcppML_c_rbinom, 6},
     {"_RcppML_c_sample", (DL_FUNC) &_RcppML_c_sample, 5},
-    {"_RcppML_c_rtisparsematrix", (DL_FUNC) &_RcppML_c_rtisparsematrix, 5},
-    {"_RcppML_c_rsparsematrix", (DL_FUNC) &_RcppML_c_rsparsematrix, 5},
+    {"_RcppML_c_rtisparsematrix", (DL_FUNC) &_RcppML_c_rtisparsematrix, 7},
+    {"_RcppML_c_rsparsematrix", (DL_FUNC) &_RcppML_c_rsparsematrix, 7},
+    {"_RcppML_Rcpp_simulate_nmf", (DL_FUNC) &_RcppML_Rcpp_simulate_nmf, 7},
+    {"_RcppML_Rcpp_solver_counters", (DL_FUNC) &_RcppML_Rcpp_solver_counters, 1},
+    {"_RcppML_Rcpp_thread_costs", (DL_FUNC) &_RcppML_Rcpp_thread_costs, 7},
+    {"_RcppML_Rcpp_kernel_threads", (DL_FUNC) &_RcppML_Rcpp_kernel_threads, 2},
     {"_RcppML_Rcpp_bipartite_match", (DL_FUNC) &_RcppML_Rcpp_bipartite_match, 1},
+    {"_RcppML_Rcpp_bipartite_match_jv", (DL_FUNC) &_RcppML_Rcpp_bipartite_match_jv, 1},
     {NULL, NULL, 0}
 };
 
@@ -9,397 +9,2918 @@
 #include "../inst/include/RcppML/SparseMatrix.h"
 
 // #include <RcppML.h>
+#include "../inst/include/RcppML/ann.hpp"
+#include "../inst/include/RcppML/assignment.hpp"
+#include "../inst/include/RcppML/async.hpp"
 #include "../inst/include/RcppML/bipartition.hpp"
 #include "../inst/include/RcppML/cluster.hpp"
+#include "../inst/include/RcppML/compress.hpp"
+#include "../inst/include/RcppML/consensus.hpp"
+#include "../inst/include/RcppML/dedup.hpp"
 #include "../inst/include/RcppML/distance.hpp"
+#include "../inst/include/RcppML/evaluate.hpp"
+#include "../inst/include/RcppML/filter.hpp"
+#include "../inst/include/RcppML/fitter.hpp"
+#include "../inst/include/RcppML/half.hpp"
+#include "../inst/include/RcppML/implicit.hpp"
+#include "../inst/include/RcppML/kl.hpp"
+#include "../inst/include/RcppML/lnmf.hpp"
+#include "../inst/include/RcppML/matrixcache.hpp"
+#include "../inst/include/RcppML/mtx.hpp"
 #include "../inst/include/RcppML/nmf.hpp"
+#include "../inst/include/RcppML/nndsvd.hpp"
+#include "../inst/include/RcppML/plan.hpp"
+#include "../inst/include/RcppML/projector.hpp"
+#include "../inst/include/RcppML/reconstruct.hpp"
+#include "../inst/include/RcppML/serve.hpp"
+#include "../inst/include/RcppML/simulate.hpp"
+#include "../inst/include/RcppML/snmf.hpp"
+#include "../inst/include/RcppML/spmm.hpp"
+#include "../inst/include/RcppML/stream.hpp"
+#include "../inst/include/RcppML/summary.hpp"
+// least squares solver given by name in R (see "useActiveSet")
+int nnlsSolver(const std::string& solver) {
+    if (solver == "auto") return NNLS_AUTO;
+    if (solver == "cd") return NNLS_CD;
+    if (solver == "active_set") return NNLS_ACTIVE_SET;
+    if (solver == "cd_greedy") return NNLS_CD_GREEDY;
+    if (solver == "cd_random") return NNLS_CD_RANDOM;
+    Rcpp::stop("'solver' must be one of \"auto\", \"cd\", \"cd_greedy\", \"cd_random\", or \"active_set\"");
+}
+
+// robust loss of "method" in R, or "ROBUST_NONE" for methods that fit the squared error (see "RcppML::nmf::reweight")
+int robustLoss(const std::string& method) {
+    if (method == "huber") return RcppML::ROBUST_HUBER;
+    if (method == "tukey") return RcppML::ROBUST_TUKEY;
+    return RcppML::ROBUST_NONE;
+}
+
+// name of a solver, as given to "nnlsSolver"
+std::string solverName(const int solver) {
+    switch (solver) {
+        case NNLS_CD: return "cd";
+        case NNLS_ACTIVE_SET: return "active_set";
+        case NNLS_CD_GREEDY: return "cd_greedy";
+        case NNLS_CD_RANDOM: return "cd_random";
+        default: return "auto";
+    }
+}
+
+// normalization of samples given by name in R (see "RcppML::filterSparse")
+int sampleNormalization(const std::string& normalize) {
+    if (normalize == "none") return RcppML::NORMALIZE_NONE;
+    if (normalize == "sum") return RcppML::NORMALIZE_SUM;
+    if (normalize == "l2") return RcppML::NORMALIZE_L2;
+    Rcpp::stop("'normalize' must be one of \"none\", \"sum\", or \"l2\"");
+}
+
+// SPARSE FACTORS
+
+// "x" as a dgCMatrix if "sparse", otherwise as a dense matrix
+//  * "x" may be an expression such as "w.transpose()", which is evaluated directly into the R matrix that is returned,
+//      so factors are copied only once, in double precision and in the layout that R expects
+template <class MatrixX>
+SEXP wrapFactor(const Eigen::MatrixBase<MatrixX>& x, const bool sparse) {
+    if (sparse) return Rcpp::SparseMatrix(x).wrap();
+    Rcpp::NumericMatrix x_(Rcpp::no_init(x.rows(), x.cols()));
+    Eigen::Map<Eigen::MatrixXd>(x_.begin(), x.rows(), x.cols()) = x.template cast<double>();
+    return x_;
+}
+
+// raw vector "x" of values in half precision "format" as a "halfMatrix" of "n_rows" by "n_cols"
+SEXP halfMatrix(Rcpp::RawVector x, const int n_rows, const int n_cols, const int format) {
+    x.attr("dims") = Rcpp::IntegerVector::create(n_rows, n_cols);
+    x.attr("format") = (format == RcppML::HALF_FLOAT16) ? "float16" : "bfloat16";
+    x.attr("class") = "halfMatrix";
+    return x;
+}
+
+// "x" in half precision "format" (see "RcppML::half_format") as a "halfMatrix", a raw vector of 2 bytes per value
+template <class MatrixX>
+SEXP wrapHalf(const Eigen::MatrixBase<MatrixX>& x, const int format, const unsigned int threads = 1) {
+    Rcpp::RawVector x_(Rcpp::no_init(2 * x.size()));
+    if (x.size() > 0) RcppML::encodeHalf(x, (uint16_t*)x_.begin(), format, threads);
+    return halfMatrix(x_, x.rows(), x.cols(), format);
+}
+
+// columns [start, start + n) of an input matrix
+template <typename Value>
+Rcpp::SparseMatrixOf<Value> colBlock(Rcpp::SparseMatrixOf<Value>& A, const int start, const int n) {
+    return A.submat(Eigen::VectorXi::LinSpaced(n, start, start + n - 1));
+}
+
+template <typename Scalar>
+Eigen::Matrix<Scalar, -1, -1> colBlock(Eigen::Matrix<Scalar, -1, -1>& A, const int start, const int n) {
+    return A.middleCols(start, n);
+}
+
+// columns of a mapped dense matrix are contiguous, so a block is mapped rather than copied
+template <typename Scalar>
+Eigen::Map<Eigen::Matrix<Scalar, -1, -1> > colBlock(Eigen::Map<Eigen::Matrix<Scalar, -1, -1> >& A, const int start, const int n) {
+    return Eigen::Map<Eigen::Matrix<Scalar, -1, -1> >(A.data() + (size_t)start * A.rows(), A.rows(), n);
+}
+
 // PROJECT LINEAR FACTOR MODELS
 
-//[[Rcpp::export]]
-Eigen::MatrixXd Rcpp_predict_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2,
-                                    const unsigned int threads, const bool mask_zeros, const double upper_bound = 0) {
-    Rcpp::SparseMatrix A_(A);
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Rcpp::SparseMatrix> m(A_, w);
+// project "w" onto "A" in the precision given by "Scalar", returning the model so that "h" is read from it in place
+//  * if "errors" is given, it is set to the squared error "||A.col(i) - wh.col(i)||^2" of each column, from the Gram
+//      identity as each column is solved (see "predict_unmasked"), or in a second pass over "A" by updates that do not
+//      find them (e.g. rank-1 models). Masked projections are not supported.
+//  * if "h_init" is given, coordinate descent begins from it rather than from zero, and with "skip_tol > 0", columns
+//      that already meet "skip_tol" are kept (see "nmf::warm_h")
+template <class T, typename Scalar>
+RcppML::nmf<T, Scalar> c_predict(T& A_, Rcpp::SparseMatrix& mask_, Eigen::MatrixXd& w, const double L1, const double L2,
+                                 const unsigned int threads, const bool mask_zeros, const double upper_bound, const int solver,
+                                 Eigen::VectorXd* errors = NULL, const Eigen::MatrixXd* h_init = NULL, const double skip_tol = 0) {
+    typedef Eigen::Matrix<Scalar, -1, 1> VectorS;
+    RcppML::nmf<T, Scalar> m = h_init ? RcppML::nmf<T, Scalar>(A_, w.template cast<Scalar>(), VectorS::Ones(w.rows()),
+                                                               h_init->template cast<Scalar>())
+                                      : RcppML::nmf<T, Scalar>(A_, w.template cast<Scalar>());
+    m.warm_h = h_init != NULL;
+    m.skip_tol = skip_tol;
+    const bool masking = mask_.rows() == A_.rows() && mask_.cols() == A_.cols();
+    if (errors && (mask_zeros || masking)) Rcpp::stop("squared errors of each sample are not supported with masking");
     if (mask_zeros)
         m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
+    else if (masking)
         m.maskMatrix(mask_);
     m.threads = threads;
     m.L1[1] = L1;
     m.L2[1] = L2;
     m.upper_bound = upper_bound;
+    m.solver = solver;
+    Eigen::ArrayXd losses;
+    if (errors) m.col_losses = &losses;
     m.predictH();
-    return m.matrixH();
+    m.col_losses = NULL;
+    if (errors) {
+        if (losses.size() != m.matrixH().cols()) losses = columnLosses(A_, m.matrixW(), m.matrixH(), threads);
+        *errors = (losses.matrix() + colSquaredNorms(A_)).cwiseMax(0);
+    }
+    return m;
+}
+
+// a dgCMatrix of factor columns, appended one dense block of columns at a time
+//  * with "top_k > 0", only the "top_k" largest values of each column are kept (ties are broken by lower row), and
+//      with "threshold > 0", only values greater than "threshold"
+//  * each block is counted in one parallel pass, which finds the smallest value kept in each column, and written into
+//      space allocated from the counts in a second parallel pass
+class sparseFactor {
+   public:
+    sparseFactor(const int n_rows, const unsigned int top_k = 0, const double threshold = 0)
+        : n_rows(n_rows), top_k(top_k), threshold(threshold), p(1, 0) {}
+
+    template <class MatrixH>
+    void append(const MatrixH& h, const unsigned int threads) {
+        const int n = h.cols(), offset = p.size() - 1;
+        std::vector<double> cutoff(n, 0);
+        std::vector<int> n_ties(n, 0);
+        p.resize(p.size() + n);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+        {
+            std::vector<double> values;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (int j = 0; j < n; ++j) {
+                values.clear();
+                for (int k = 0; k < n_rows; ++k)
+                    if (h(k, j) > threshold || (threshold == 0 && h(k, j) != 0)) values.push_back(h(k, j));
+                int count = values.size();
+                cutoff[j] = -std::numeric_limits<double>::infinity();
+                if (top_k > 0 && count > (int)top_k) {
+                    // the "top_k"-th largest value, and how many of the values equal to it are kept
+                    std::nth_element(values.begin(), values.begin() + top_k - 1, values.end(), std::greater<double>());
+                    cutoff[j] = values[top_k - 1];
+                    n_ties[j] = top_k - std::count_if(values.begin(), values.end(), [&](const double v) { return v > cutoff[j]; });
+                    count = top_k;
+                }
+                p[offset + j + 1] = count;
+            }
+        }
+        for (int j = 0; j < n; ++j) p[offset + j + 1] += p[offset + j];
+        i.resize(p.back());
+        x.resize(p.back());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static)
+#endif
+        for (int j = 0; j < n; ++j) {
+            int it = p[offset + j], ties = n_ties[j];
+            for (int k = 0; k < n_rows && it < p[offset + j + 1]; ++k) {
+                const double v = h(k, j);
+                if (!(v > threshold || (threshold == 0 && v != 0)) || v < cutoff[j]) continue;
+                if (v == cutoff[j] && ties-- <= 0) continue;
+                i[it] = k;
+                x[it++] = v;
+            }
+        }
+    }
+
+    Rcpp::S4 wrap() const {
+        return Rcpp::SparseMatrix(Rcpp::NumericVector(x.begin(), x.end()), Rcpp::IntegerVector(i.begin(), i.end()),
+                                  Rcpp::IntegerVector(p.begin(), p.end()), Rcpp::IntegerVector::create(n_rows, (int)p.size() - 1))
+            .wrap();
+    }
+
+   private:
+    const int n_rows;
+    const unsigned int top_k;
+    const double threshold;
+    std::vector<int> i, p;
+    std::vector<double> x;
+};
+
+// project "w" onto "A" as in "c_predict", returning "h" as a dgCMatrix that is assembled from projections onto blocks
+// of columns in "A", so that no more than SPARSE_FACTOR_BLOCK_SIZE columns of "h" are ever dense
+//  * with "top_k" or "threshold", only the largest values of each column of "h" are kept (see "sparseFactor")
+//  * each block is warm-started from its columns of "h_init", if given (see "c_predict")
+template <class T, typename Scalar>
+Rcpp::S4 c_predict_sparse(T& A_, Rcpp::SparseMatrix& mask_, Eigen::MatrixXd& w, const double L1, const double L2,
+                          const unsigned int threads, const bool mask_zeros, const double upper_bound, const int solver,
+                          const unsigned int top_k = 0, const double threshold = 0, Eigen::VectorXd* errors = NULL,
+                          const Eigen::MatrixXd* h_init = NULL, const double skip_tol = 0) {
+    const bool masking = mask_.rows() == A_.rows() && mask_.cols() == A_.cols();
+    const int n_cols = A_.cols();
+    sparseFactor h(w.rows(), top_k, threshold);
+    if (errors) errors->resize(n_cols);
+    for (int start = 0; start < n_cols; start += SPARSE_FACTOR_BLOCK_SIZE) {
+        const int n = std::min(SPARSE_FACTOR_BLOCK_SIZE, n_cols - start);
+        T A_b = colBlock(A_, start, n);
+        Rcpp::SparseMatrix mask_b = masking ? colBlock(mask_, start, n) : mask_;
+        Eigen::VectorXd errors_b;
+        const Eigen::MatrixXd h_init_b = h_init ? Eigen::MatrixXd(h_init->middleCols(start, n)) : Eigen::MatrixXd();
+        const RcppML::nmf<T, Scalar> m = c_predict<T, Scalar>(A_b, mask_b, w, L1, L2, threads, mask_zeros, upper_bound, solver,
+                                                              errors ? &errors_b : NULL, h_init ? &h_init_b : NULL, skip_tol);
+        h.append(m.matrixH(), threads);
+        if (errors) errors->segment(start, n) = errors_b;
+    }
+    return h.wrap();
+}
+
+// "h", or with "errors", a list of "h" and the squared error of each sample
+SEXP withErrors(SEXP h, const Eigen::VectorXd* errors) {
+    if (!errors) return h;
+    return Rcpp::List::create(Rcpp::Named("h") = h, Rcpp::Named("squared_error") = Rcpp::wrap(*errors));
+}
+
+// project "w" onto sparse "A" with non-zero values stored as "Value"
+template <typename Value>
+SEXP c_predict_values(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd& w, const double L1, const double L2,
+                      const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float,
+                      const bool sparse_output, const int solver, const unsigned int top_k, const double threshold,
+                      const bool squared_error, const Eigen::MatrixXd* h_init, const double skip_tol) {
+    typedef Rcpp::SparseMatrixOf<Value> SparseA;
+    SparseA A_ = SparseA::columnCompressed(A, threads);
+    Rcpp::SparseMatrix mask_(mask);
+    Eigen::VectorXd errors;
+    Eigen::VectorXd* errors_ = squared_error ? &errors : NULL;
+    if (sparse_output) {
+        if (use_float)
+            return withErrors(c_predict_sparse<SparseA, float>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver, top_k,
+                                                               threshold, errors_, h_init, skip_tol),
+                              errors_);
+        return withErrors(c_predict_sparse<SparseA, double>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver, top_k,
+                                                            threshold, errors_, h_init, skip_tol),
+                          errors_);
+    }
+    if (use_float)
+        return withErrors(wrapFactor(c_predict<SparseA, float>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver, errors_,
+                                                               h_init, skip_tol)
+                                         .matrixH(),
+                                     false),
+                          errors_);
+    return withErrors(wrapFactor(c_predict<SparseA, double>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver, errors_,
+                                                            h_init, skip_tol)
+                                     .matrixH(),
+                                 false),
+                      errors_);
+}
+
+// "A" may be a pattern matrix (e.g. Matrix::ngCMatrix), whose values are not allocated, or compressed by rows (e.g.
+//   Matrix::dgRMatrix), which is transposed once in C++ (see "Rcpp::SparseMatrixOf::columnCompressed")
+//  * a non-empty "h_init" warm-starts the projection (see "c_predict")
+//[[Rcpp::export]]
+SEXP Rcpp_predict_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, const double L1, const double L2,
+                         const unsigned int threads, const bool mask_zeros, const double upper_bound = 0, const bool use_float = false,
+                         const bool sparse_output = false, const std::string solver = "auto", const unsigned int top_k = 0,
+                         const double threshold = 0, const bool squared_error = false, Eigen::MatrixXd h_init = Eigen::MatrixXd(),
+                         const double skip_tol = 0) {
+    const Eigen::MatrixXd* h_init_ = h_init.size() > 0 ? &h_init : NULL;
+    if (!A.hasSlot("x"))
+        return c_predict_values<Rcpp::SparsePattern>(A, mask, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output,
+                                                     nnlsSolver(solver), top_k, threshold, squared_error, h_init_, skip_tol);
+    return c_predict_values<double>(A, mask, w, L1, L2, threads, mask_zeros, upper_bound, use_float, sparse_output, nnlsSolver(solver),
+                                    top_k, threshold, squared_error, h_init_, skip_tol);
+}
+
+// with "mask_zeros", only the non-zeros of dense "A" are used, so they are copied once into a sparse matrix rather than
+//   found again in every column of every update (see "Rcpp_nmf_dense")
+//[[Rcpp::export]]
+SEXP Rcpp_predict_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w,
+                        const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound = 0,
+                        const bool use_float = false, const bool sparse_output = false, const std::string solver = "auto",
+                        const unsigned int top_k = 0, const double threshold = 0, const bool squared_error = false,
+                        Eigen::MatrixXd h_init = Eigen::MatrixXd(), const double skip_tol = 0) {
+    if (mask_zeros)
+        return Rcpp_predict_sparse(Rcpp::SparseMatrix(A_).wrap(), mask, w, L1, L2, threads, mask_zeros, upper_bound, use_float,
+                                   sparse_output, solver, top_k, threshold, squared_error, h_init, skip_tol);
+    Rcpp::SparseMatrix mask_(mask);
+    const int solver_ = nnlsSolver(solver);
+    Eigen::VectorXd errors;
+    Eigen::VectorXd* errors_ = squared_error ? &errors : NULL;
+    const Eigen::MatrixXd* h_init_ = h_init.size() > 0 ? &h_init : NULL;
+    if (use_float) {
+        Eigen::MatrixXf A_f = A_.cast<float>();
+        if (sparse_output)
+            return withErrors(c_predict_sparse<Eigen::MatrixXf, float>(A_f, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver_,
+                                                                       top_k, threshold, errors_, h_init_, skip_tol),
+                              errors_);
+        return withErrors(wrapFactor(c_predict<Eigen::MatrixXf, float>(A_f, mask_, w, L1, L2, threads, mask_zeros, upper_bound, solver_,
+                                                                       errors_, h_init_, skip_tol)
+                                         .matrixH(),
+                                     false),
+                          errors_);
+    }
+    if (sparse_output)
+        return withErrors(c_predict_sparse<Eigen::Map<Eigen::MatrixXd>, double>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound,
+                                                                                solver_, top_k, threshold, errors_, h_init_, skip_tol),
+                          errors_);
+    return withErrors(wrapFactor(c_predict<Eigen::Map<Eigen::MatrixXd>, double>(A_, mask_, w, L1, L2, threads, mask_zeros, upper_bound,
+                                                                                 solver_, errors_, h_init_, skip_tol)
+                                     .matrixH(),
+                                 false),
+                      errors_);
+}
+
+// destination of consecutive chunks of columns of "h" from "c_predict_sink", which is written on the R thread in order of columns
+//  * a path: dense chunks are appended as 4-byte floats in column-major order (as in "write_distance"), and sparse
+//      chunks as chunks of a sparse matrix stream (see "RcppML::SparseMatrixStream")
+//  * an R function: called as "f(h, start)" with each chunk "h" as a matrix, or a dgCMatrix if "sparse", and the
+//      1-based index "start" of its first column
+//  * sparse chunks keep only the "top_k" largest values or values greater than "threshold" of each column (see "sparseFactor")
+//  * in memory, in half precision "h_format": each chunk is encoded into its columns of a "halfMatrix" of all columns,
+//      returned by "half()", so that "h" is never held in double precision
+class factorSink {
+   public:
+    factorSink(const int n_rows, const int n_cols, const int h_format)
+        : n_rows(n_rows), sparse(false), top_k(0), threshold(0), h_format(h_format), h_half(Rcpp::no_init(2 * (size_t)n_rows * n_cols)) {
+        halfMatrix(h_half, n_rows, n_cols, h_format);
+    }
+
+    factorSink(SEXP sink, const int n_rows, const bool sparse, const unsigned int top_k, const double threshold)
+        : sink(sink), n_rows(n_rows), sparse(sparse), top_k(top_k), threshold(threshold) {
+        if (Rf_isString(sink)) {
+            const std::string path = Rcpp::as<std::string>(sink);
+            f.open(path.c_str(), std::ios::binary | std::ios::trunc);
+            if (!f) Rcpp::stop("could not open '" + path + "' for writing");
+            if (sparse) RcppML::writeSparseStreamHeader(f, n_rows);
+        } else if (!Rf_isFunction(sink)) {
+            Rcpp::stop("'sink' must be a path or a function");
+        }
+    }
+
+    template <typename Scalar>
+    void write(const Eigen::Matrix<Scalar, -1, -1>& h, const int start, const unsigned int threads) {
+        if (h_format != RcppML::HALF_NONE) {
+            RcppML::encodeHalf(h, (uint16_t*)h_half.begin() + (size_t)start * n_rows, h_format, threads);
+        } else if (sparse) {
+            sparseFactor h_(n_rows, top_k, threshold);
+            h_.append(h, threads);
+            if (f.is_open()) {
+                Rcpp::SparseMatrix h_s(h_.wrap());
+                RcppML::writeSparseChunk(f, h_s, 0, h.cols());
+            } else {
+                Rcpp::Function(sink)(h_.wrap(), start + 1);
+            }
+        } else if (f.is_open()) {
+            const Eigen::MatrixXf h_f = h.template cast<float>();
+            f.write((const char*)h_f.data(), h_f.size() * sizeof(float));
+        } else {
+            Rcpp::Function(sink)(wrapFactor(h, false), start + 1);
+        }
+        if (f.is_open() && !f) Rcpp::stop("could not write to 'sink'");
+    }
+
+    SEXP half() const { return h_half; }
+
+   private:
+    Rcpp::RObject sink;
+    const int n_rows;
+    const bool sparse;
+    const unsigned int top_k;
+    const double threshold;
+    const int h_format = RcppML::HALF_NONE;
+    Rcpp::RawVector h_half;
+    std::ofstream f;
+};
+
+// columns [start, start + n) of "A" for "c_predict_sink", in the precision of the solve. Sparse blocks allocate R
+//   vectors, and so are taken on the R thread.
+template <typename Scalar, typename Value>
+Rcpp::SparseMatrixOf<Value> sinkBlock(Rcpp::SparseMatrixOf<Value>& A, const int start, const int n) {
+    return colBlock(A, start, n);
+}
+
+template <typename Scalar>
+Eigen::Matrix<Scalar, -1, -1> sinkBlock(Eigen::Map<Eigen::MatrixXd>& A, const int start, const int n) {
+    return colBlock(A, start, n).template cast<Scalar>();
+}
+
+// project "w" onto "A" one chunk of "chunk_size" columns at a time, passing each chunk of "h" to "sink", so that no
+//   more than two chunks of "h" are ever held in memory
+//  * chunk "t" is solved on a worker thread, which never calls R, while chunk "t - 1" is written to "sink" on the R thread
+template <typename Scalar, class T>
+void c_predict_sink(T& A, Eigen::MatrixXd& w, const double L1, const double L2, const unsigned int threads, const bool mask_zeros,
+                    const double upper_bound, const int solver, const int chunk_size, factorSink& sink) {
+    typedef Eigen::Matrix<Scalar, -1, -1> MatrixS;
+    const MatrixS w_ = w.cast<Scalar>();
+    Rcpp::SparseMatrix no_mask;
+    const linkIndex no_link;
+    const int n_cols = A.cols();
+    MatrixS h_last;
+    int last = 0;
+    for (int start = 0; start < n_cols; start += chunk_size) {
+        const int n = std::min(chunk_size, n_cols - start);
+        auto A_c = sinkBlock<Scalar>(A, start, n);
+        MatrixS h_c(w_.rows(), n);
+        std::future<void> solve = std::async(std::launch::async, [&]() {
+            predict(A_c, no_mask, no_link, w_, h_c, L1, L2, threads, mask_zeros, false, false, upper_bound, solver);
+        });
+        if (start > 0) sink.write(h_last, last, threads);
+        solve.get();
+        h_last.swap(h_c);
+        last = start;
+        Rcpp::checkUserInterrupt();
+    }
+    if (n_cols > 0) sink.write(h_last, last, threads);
+}
+
+template <typename Value>
+void c_predict_sink_values(const Rcpp::S4& A, Eigen::MatrixXd& w, const double L1, const double L2, const unsigned int threads,
+                           const bool mask_zeros, const double upper_bound, const bool use_float, const int solver,
+                           const int chunk_size, factorSink& sink) {
+    Rcpp::SparseMatrixOf<Value> A_ = Rcpp::SparseMatrixOf<Value>::columnCompressed(A, threads);
+    if (use_float)
+        c_predict_sink<float>(A_, w, L1, L2, threads, mask_zeros, upper_bound, solver, chunk_size, sink);
+    else
+        c_predict_sink<double>(A_, w, L1, L2, threads, mask_zeros, upper_bound, solver, chunk_size, sink);
+}
+
+// projections of "w" onto chunks of "A" passed to a path or R function "sink" (see "factorSink") rather than returned
+//  * "A" may be a pattern matrix or compressed by rows, as in "Rcpp_predict_sparse"
+//[[Rcpp::export]]
+void Rcpp_predict_sink_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads,
+                              const bool mask_zeros, const double upper_bound, const bool use_float, const bool sparse_output,
+                              const std::string solver, const unsigned int top_k, const double threshold,
+                              const unsigned int chunk_size, SEXP sink) {
+    if (chunk_size == 0) Rcpp::stop("'chunk_size' must be greater than 0");
+    factorSink sink_(sink, w.rows(), sparse_output, top_k, threshold);
+    if (!A.hasSlot("x"))
+        c_predict_sink_values<Rcpp::SparsePattern>(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, nnlsSolver(solver),
+                                                   chunk_size, sink_);
+    else
+        c_predict_sink_values<double>(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, nnlsSolver(solver), chunk_size, sink_);
+}
+
+//[[Rcpp::export]]
+void Rcpp_predict_sink_dense(Eigen::Map<Eigen::MatrixXd> A, Eigen::MatrixXd w, const double L1, const double L2,
+                             const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float,
+                             const bool sparse_output, const std::string solver, const unsigned int top_k, const double threshold,
+                             const unsigned int chunk_size, SEXP sink) {
+    if (chunk_size == 0) Rcpp::stop("'chunk_size' must be greater than 0");
+    factorSink sink_(sink, w.rows(), sparse_output, top_k, threshold);
+    if (use_float)
+        c_predict_sink<float>(A, w, L1, L2, threads, mask_zeros, upper_bound, nnlsSolver(solver), chunk_size, sink_);
+    else
+        c_predict_sink<double>(A, w, L1, L2, threads, mask_zeros, upper_bound, nnlsSolver(solver), chunk_size, sink_);
+}
+
+// projections of "w" onto "A" returned as a "halfMatrix" in half precision "h_format", encoded from each chunk of
+//   "chunk_size" columns as it is solved (see "factorSink")
+//[[Rcpp::export]]
+SEXP Rcpp_predict_half_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads,
+                              const bool mask_zeros, const double upper_bound, const bool use_float, const std::string solver,
+                              const unsigned int chunk_size, const int h_format) {
+    if (chunk_size == 0) Rcpp::stop("'chunk_size' must be greater than 0");
+    const Rcpp::IntegerVector Dim = A.slot("Dim");
+    factorSink sink_(w.rows(), Dim[1], h_format);
+    if (!A.hasSlot("x"))
+        c_predict_sink_values<Rcpp::SparsePattern>(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, nnlsSolver(solver),
+                                                   chunk_size, sink_);
+    else
+        c_predict_sink_values<double>(A, w, L1, L2, threads, mask_zeros, upper_bound, use_float, nnlsSolver(solver), chunk_size, sink_);
+    return sink_.half();
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_predict_half_dense(Eigen::Map<Eigen::MatrixXd> A, Eigen::MatrixXd w, const double L1, const double L2,
+                             const unsigned int threads, const bool mask_zeros, const double upper_bound, const bool use_float,
+                             const std::string solver, const unsigned int chunk_size, const int h_format) {
+    if (chunk_size == 0) Rcpp::stop("'chunk_size' must be greater than 0");
+    factorSink sink_(w.rows(), A.cols(), h_format);
+    if (use_float)
+        c_predict_sink<float>(A, w, L1, L2, threads, mask_zeros, upper_bound, nnlsSolver(solver), chunk_size, sink_);
+    else
+        c_predict_sink<double>(A, w, L1, L2, threads, mask_zeros, upper_bound, nnlsSolver(solver), chunk_size, sink_);
+    return sink_.half();
+}
+
+// persistent projectors of "w" for repeated projections onto small batches of samples, returned to R as an external pointer
+//  * "storage" is "double", or "int8" or "float16" for a quantized "w" (see "RcppML::projector_storage")
+//[[Rcpp::export]]
+SEXP Rcpp_projector(Eigen::MatrixXd w, const double L1, const double L2, const double upper_bound = 0,
+                    const std::string solver = "auto", const std::string storage = "double") {
+    const int storage_ = storage == "int8" ? RcppML::PROJECT_INT8 : storage == "float16" ? RcppML::PROJECT_FLOAT16 : RcppML::PROJECT_DOUBLE;
+    Rcpp::XPtr<RcppML::projector<double>> ptr(new RcppML::projector<double>(w, L1, L2, upper_bound, nnlsSolver(solver), storage_), true);
+    return ptr;
+}
+
+// projector of a model file written by "Rcpp_write_model", whose "w" is read in place from the mapped file
+//[[Rcpp::export]]
+SEXP Rcpp_projector_file(const std::string path, const double L1, const double L2, const double upper_bound = 0,
+                         const std::string solver = "auto", const std::string storage = "double") {
+    const int storage_ = storage == "int8" ? RcppML::PROJECT_INT8 : storage == "float16" ? RcppML::PROJECT_FLOAT16 : RcppML::PROJECT_DOUBLE;
+    const RcppML::modelFile file(path);
+    Rcpp::XPtr<RcppML::projector<double>> ptr(new RcppML::projector<double>(file, L1, L2, upper_bound, nnlsSolver(solver), storage_), true);
+    return ptr;
+}
+
+Rcpp::List wrapModels(const std::vector<Eigen::MatrixXd>& h) {
+    Rcpp::List h_(h.size());
+    for (size_t m = 0; m < h.size(); ++m) h_[m] = Rcpp::wrap(h[m]);
+    return h_;
+}
+
+RcppML::projector<double>* projectorPtr(SEXP handle) {
+    if (TYPEOF(handle) != EXTPTRSXP || R_ExternalPtrAddr(handle) == NULL)
+        Rcpp::stop("projector is not valid (projectors cannot be saved and reloaded, create a new projector)");
+    return (RcppML::projector<double>*)R_ExternalPtrAddr(handle);
+}
+
+// a non-empty "h_init" warm-starts the projection (see "RcppML::projector::project")
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_project_sparse(SEXP handle, const Rcpp::S4& A, const unsigned int threads,
+                                    const Eigen::MatrixXd h_init = Eigen::MatrixXd(), const double skip_tol = 0) {
+    Rcpp::SparseMatrix A_(A);
+    return projectorPtr(handle)->project(A_, threads, h_init.size() > 0 ? &h_init : NULL, skip_tol);
+}
+
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_project_dense(SEXP handle, const Eigen::Map<Eigen::MatrixXd> A, const unsigned int threads,
+                                   const Eigen::MatrixXd h_init = Eigen::MatrixXd(), const double skip_tol = 0) {
+    return projectorPtr(handle)->project(A, threads, h_init.size() > 0 ? &h_init : NULL, skip_tol);
+}
+
+// projection of one sparse sample given by the 1-based "rows" and "values" of its non-zeros, which builds no sparse
+//   matrix or S4 object, for queries of one sample at a time
+//[[Rcpp::export]]
+Eigen::VectorXd Rcpp_project_sample(SEXP handle, const Rcpp::IntegerVector& rows, const Rcpp::NumericVector& values) {
+    if (rows.size() != values.size()) Rcpp::stop("'i' and 'x' must be of equal length");
+    return projectorPtr(handle)->project(rows.begin(), values.begin(), rows.size(), 1);
+}
+
+// projections of a batch of matrices of the same features in one parallel loop over all of their samples (see
+//   "RcppML::projector::project"), where "data" is a list of "dgCMatrix" or of dense matrices
+//[[Rcpp::export]]
+Rcpp::List Rcpp_project_batch_sparse(SEXP handle, const Rcpp::List& data, const unsigned int threads) {
+    std::vector<Rcpp::SparseMatrix> A;
+    for (int m = 0; m < data.size(); ++m) A.push_back(Rcpp::SparseMatrix(Rcpp::as<Rcpp::S4>(data[m])));
+    return wrapModels(projectorPtr(handle)->project(A, threads));
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_project_batch_dense(SEXP handle, const Rcpp::List& data, const unsigned int threads) {
+    std::vector<Eigen::Map<Eigen::MatrixXd>> A;
+    for (int m = 0; m < data.size(); ++m) {
+        Rcpp::NumericMatrix A_m = data[m];
+        A.push_back(Eigen::Map<Eigen::MatrixXd>(A_m.begin(), A_m.nrow(), A_m.ncol()));
+    }
+    return wrapModels(projectorPtr(handle)->project(A, threads));
+}
+
+// rank of a projector, relative error of its stored "w" and its size in bytes, and whether it is read from a mapped file
+//[[Rcpp::export]]
+Rcpp::List Rcpp_projector_info(SEXP handle) {
+    const RcppML::projector<double>* p = projectorPtr(handle);
+    return Rcpp::List::create(Rcpp::Named("rank") = p->rank(), Rcpp::Named("error") = p->error(), Rcpp::Named("bytes") = p->bytes(),
+                              Rcpp::Named("mapped") = p->mapped());
+}
+
+// write "w" (factors by features), "d", "ww^T", and "h" if it has columns, to a model file (see "RcppML::modelFile")
+//[[Rcpp::export]]
+void Rcpp_write_model(const std::string path, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h,
+                      const Rcpp::RawVector h_half, const int h_format) {
+    bool written;
+    if (h_format != RcppML::HALF_NONE)
+        written = RcppML::modelFile::write(path, w, d, true, NULL, (const uint16_t*)h_half.begin(), h_half.size() / 2 / w.rows(), h_format);
+    else
+        written = RcppML::modelFile::write(path, w, d, true, h.cols() > 0 ? &h : NULL);
+    if (!written) Rcpp::stop("could not write '" + path + "'");
+}
+
+// factors of a model file, with "h" as a "halfMatrix" if it was written in half precision
+//[[Rcpp::export]]
+Rcpp::List Rcpp_read_model(const std::string path) {
+    const RcppML::modelFile file(path);
+    const Eigen::MatrixXd w = Eigen::Map<const Eigen::MatrixXd>(file.w(), file.k, file.features);
+    const Eigen::VectorXd d = Eigen::Map<const Eigen::VectorXd>(file.d(), file.k);
+    if (file.hFormat() != RcppML::HALF_NONE) {
+        Rcpp::RawVector h(2 * (size_t)file.k * file.samples);
+        std::memcpy(h.begin(), file.hHalf(), h.size());
+        return Rcpp::List::create(Rcpp::Named("w") = w, Rcpp::Named("d") = d,
+                                  Rcpp::Named("h") = halfMatrix(h, file.k, file.samples, file.hFormat()));
+    }
+    Eigen::MatrixXd h(file.k, 0);
+    if (file.hasH()) h = Eigen::Map<const Eigen::MatrixXd>(file.h(), file.k, file.samples);
+    return Rcpp::List::create(Rcpp::Named("w") = w, Rcpp::Named("d") = d, Rcpp::Named("h") = h);
+}
+
+// HALF-PRECISION MATRICES
+
+// "halfMatrix" of "x" in half precision "format"
+//[[Rcpp::export]]
+SEXP Rcpp_half_encode(const Eigen::Map<Eigen::MatrixXd> x, const int format, const unsigned int threads) {
+    return wrapHalf(x, format, threads);
+}
+
+// values of a "halfMatrix" "x" of "n_rows" by "n_cols" in double precision
+//[[Rcpp::export]]
+Rcpp::NumericMatrix Rcpp_half_decode(const Rcpp::RawVector x, const int n_rows, const int n_cols, const int format,
+                                     const unsigned int threads) {
+    if ((size_t)x.size() != 2 * (size_t)n_rows * n_cols) Rcpp::stop("'x' does not hold 2 bytes for each value of its dimensions");
+    Rcpp::NumericMatrix result(Rcpp::no_init(n_rows, n_cols));
+    RcppML::decodeHalf((const uint16_t*)x.begin(), result.size(), result.begin(), format, threads);
+    return result;
+}
+
+// rows "rows" and columns "cols" (0-based) of a "halfMatrix" "x" with "n_rows" rows, still in half precision
+//[[Rcpp::export]]
+SEXP Rcpp_half_subset(const Rcpp::RawVector x, const int n_rows, const Rcpp::IntegerVector rows, const Rcpp::IntegerVector cols,
+                      const int format) {
+    Rcpp::RawVector result(Rcpp::no_init(2 * (size_t)rows.size() * cols.size()));
+    const uint16_t* x_ = (const uint16_t*)x.begin();
+    uint16_t* out = (uint16_t*)result.begin();
+    for (int j = 0; j < cols.size(); ++j)
+        for (int i = 0; i < rows.size(); ++i) out[(size_t)j * rows.size() + i] = x_[(size_t)cols[j] * n_rows + rows[i]];
+    return halfMatrix(result, rows.size(), cols.size(), format);
+}
+
+// groups of identical columns of "A" (see "RcppML::findColumnGroups"), with 1-based representatives and groups
+//[[Rcpp::export]]
+Rcpp::List Rcpp_column_groups(const Rcpp::S4& A, const unsigned int threads) {
+    RcppML::columnGroups g;
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        g = RcppML::findColumnGroups(A_, threads);
+    } else {
+        Rcpp::SparseMatrix A_(A);
+        g = RcppML::findColumnGroups(A_, threads);
+    }
+    Rcpp::IntegerVector unique(g.unique.begin(), g.unique.end()), group(g.group.begin(), g.group.end());
+    return Rcpp::List::create(Rcpp::Named("unique") = unique + 1, Rcpp::Named("group") = group + 1,
+                              Rcpp::Named("counts") = Rcpp::wrap(g.counts));
+}
+
+// rows of "A" hashed into "buckets" rows (see "RcppML::hashSparse")
+//[[Rcpp::export]]
+Rcpp::S4 Rcpp_hash_features(const Rcpp::S4& A, const unsigned int buckets, const bool signs, const unsigned int seed,
+                            const unsigned int threads) {
+    return RcppML::hashSparse(A, buckets, signs, seed, threads);
+}
+
+// projections of several models onto the same samples in one pass over "A" (see "RcppML::stacked_projector"), where
+//   "w" is a list of matrices of factors (rows) by features (columns)
+RcppML::stacked_projector<double> stackedProjector(const Rcpp::List& w, const double L1, const double L2,
+                                                   const double upper_bound, const std::string solver) {
+    std::vector<Eigen::MatrixXd> w_;
+    for (int m = 0; m < w.size(); ++m) w_.push_back(Rcpp::as<Eigen::MatrixXd>(w[m]));
+    return RcppML::stacked_projector<double>(w_, L1, L2, upper_bound, nnlsSolver(solver));
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_project_stacked_sparse(const Rcpp::List& w, const Rcpp::S4& A, const double L1, const double L2,
+                                       const double upper_bound, const std::string solver, const unsigned int threads) {
+    Rcpp::SparseMatrix A_ = Rcpp::SparseMatrix::columnCompressed(A, threads);
+    return wrapModels(stackedProjector(w, L1, L2, upper_bound, solver).project(A_, threads));
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_project_stacked_dense(const Rcpp::List& w, const Eigen::MatrixXd& A, const double L1, const double L2,
+                                      const double upper_bound, const std::string solver, const unsigned int threads) {
+    return wrapModels(stackedProjector(w, L1, L2, upper_bound, solver).project(A, threads));
+}
+
+// MEAN SQUARED ERROR LOSS OF FACTORIZATION
+//
+// Sparse "A" may be a pattern matrix or compressed by rows, as in "Rcpp_predict_sparse"
+
+// mean squared error of a model of sparse "A" with non-zero values stored as "Value", at all values, or only at masked
+//   values if "missing_only"
+template <typename Value>
+double c_mse_values(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd& w, Eigen::VectorXd& d, Eigen::MatrixXd& h,
+                    const unsigned int threads, const bool mask_zeros, const bool missing_only) {
+    Rcpp::SparseMatrixOf<Value> A_ = Rcpp::SparseMatrixOf<Value>::columnCompressed(A, threads);
+    Rcpp::SparseMatrix mask_(mask);
+    RcppML::nmf<Rcpp::SparseMatrixOf<Value> > m(A_, w, d, h);
+    m.threads = threads;
+    if (missing_only) {
+        m.maskMatrix(mask_);
+        return m.mse_masked();
+    }
+    if (mask_zeros)
+        m.maskZeros();
+    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
+        m.maskMatrix(mask_);
+    return m.mse();
+}
+
+double c_mse_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd& w, Eigen::VectorXd& d, Eigen::MatrixXd& h,
+                    const unsigned int threads, const bool mask_zeros, const bool missing_only) {
+    if (!A.hasSlot("x")) return c_mse_values<Rcpp::SparsePattern>(A, mask, w, d, h, threads, mask_zeros, missing_only);
+    return c_mse_values<double>(A, mask, w, d, h, threads, mask_zeros, missing_only);
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
+                       const unsigned int threads, const bool mask_zeros) {
+    return c_mse_sparse(A, mask, w, d, h, threads, mask_zeros, false);
+}
+
+// with "mask_zeros", the loss of dense "A" is computed over its non-zeros only, as in "Rcpp_mse_sparse"
+//[[Rcpp::export]]
+double Rcpp_mse_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
+                      const unsigned int threads, const bool mask_zeros) {
+    if (mask_zeros) return Rcpp_mse_sparse(Rcpp::SparseMatrix(A_).wrap(), mask, w, d, h, threads, mask_zeros);
+    Rcpp::SparseMatrix mask_(mask);
+    RcppML::nmf<Eigen::Map<Eigen::MatrixXd> > m(A_, w, d, h);
+    if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols()) m.maskMatrix(mask_);
+    m.threads = threads;
+    return m.mse();
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_missing_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
+                               const unsigned int threads) {
+    return c_mse_sparse(A, mask, w, d, h, threads, false, true);
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_missing_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
+                              const unsigned int threads) {
+    Rcpp::SparseMatrix mask_(mask);
+    RcppML::nmf<Eigen::Map<Eigen::MatrixXd> > m(A_, w, d, h);
+    m.maskMatrix(mask_);
+    m.threads = threads;
+    return m.mse_masked();
+}
+
+// mean squared error of a model with values masked by a hash of their position (see "hash_mask"), either excluding masked
+// values or, if "missing_only", at masked values only
+//[[Rcpp::export]]
+double Rcpp_mse_hashed_sparse(const Rcpp::S4& A, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads,
+                              const unsigned int mask_seed, const unsigned int mask_inv_probability, const bool missing_only) {
+    Rcpp::SparseMatrix A_(A);
+    RcppML::nmf<Rcpp::SparseMatrix> m(A_, w, d, h);
+    m.maskMatrix(RcppML::hash_mask(mask_seed, mask_inv_probability));
+    m.threads = threads;
+    return missing_only ? m.mse_masked() : m.mse();
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_hashed_dense(Eigen::Map<Eigen::MatrixXd> A_, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h, const unsigned int threads,
+                             const unsigned int mask_seed, const unsigned int mask_inv_probability, const bool missing_only) {
+    RcppML::nmf<Eigen::Map<Eigen::MatrixXd> > m(A_, w, d, h);
+    m.maskMatrix(RcppML::hash_mask(mask_seed, mask_inv_probability));
+    m.threads = threads;
+    return missing_only ? m.mse_masked() : m.mse();
+}
+
+// mean squared error of a model with a sparse "h", accumulated over blocks of columns so that no more than
+// SPARSE_FACTOR_BLOCK_SIZE columns of "h" are ever dense. Blocks are weighted by their number of measurements.
+template <class T>
+double c_mse_blocked(T& A_, Rcpp::SparseMatrix& mask_, Eigen::MatrixXd& w, Eigen::VectorXd& d, Rcpp::SparseMatrix& h_,
+                     const unsigned int threads, const bool mask_zeros, const bool missing_only) {
+    const bool masking = mask_.rows() == A_.rows() && mask_.cols() == A_.cols();
+    if (missing_only && !masking) Rcpp::stop("a mask matrix must be specified to evaluate only masked values");
+    if (h_.rows() != w.rows() || h_.cols() != A_.cols()) Rcpp::stop("dimensions of 'h' and 'A' are not compatible");
+    const int n_cols = A_.cols();
+    double loss = 0, n = 0;
+    for (int start = 0; start < n_cols; start += SPARSE_FACTOR_BLOCK_SIZE) {
+        const int cols = std::min(SPARSE_FACTOR_BLOCK_SIZE, n_cols - start);
+        T A_b = colBlock(A_, start, cols);
+        Eigen::MatrixXd h_b = Eigen::MatrixXd::Zero(h_.rows(), cols);
+        for (int j = 0; j < cols; ++j)
+            for (Rcpp::SparseMatrix::InnerIterator it(h_, start + j); it; ++it)
+                h_b(it.row(), j) = it.value();
+        RcppML::nmf<T> m(A_b, w, d, h_b);
+        m.threads = threads;
+        double n_b = (double)A_.rows() * cols, loss_b;
+        Rcpp::SparseMatrix mask_b;
+        if (missing_only) {
+            mask_b = colBlock(mask_, start, cols);
+            m.maskMatrix(mask_b);
+            n_b = mask_b.i.size();
+            if (n_b == 0) continue;
+            loss_b = m.mse_masked();
+        } else {
+            if (mask_zeros) {
+                m.maskZeros();
+                n_b = n_nonzeros(A_b);
+            } else if (masking) {
+                mask_b = colBlock(mask_, start, cols);
+                m.maskMatrix(mask_b);
+                n_b -= mask_b.i.size();
+            }
+            if (n_b == 0) continue;
+            loss_b = m.mse();
+        }
+        loss += loss_b * n_b;
+        n += n_b;
+    }
+    return loss / n;
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_blocked_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, const Rcpp::S4& h,
+                               const unsigned int threads, const bool mask_zeros, const bool missing_only) {
+    Rcpp::SparseMatrix A_(A), mask_(mask), h_(h);
+    return c_mse_blocked(A_, mask_, w, d, h_, threads, mask_zeros, missing_only);
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_blocked_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, const Rcpp::S4& h,
+                              const unsigned int threads, const bool mask_zeros, const bool missing_only) {
+    Rcpp::SparseMatrix mask_(mask), h_(h);
+    return c_mse_blocked(A_, mask_, w, d, h_, threads, mask_zeros, missing_only);
+}
+
+// mean squared error of a list of models, each given as a list of "w" (transposed), "d", and dense "h"
+//[[Rcpp::export]]
+Eigen::VectorXd Rcpp_mse_models_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Rcpp::List& models, const unsigned int threads,
+                                       const bool mask_zeros, const bool missing_only) {
+    Rcpp::SparseMatrix A_(A), mask_(mask);
+    std::vector<Eigen::MatrixXd> wd, h;
+    for (int m = 0; m < models.size(); ++m) {
+        Rcpp::List model = Rcpp::as<Rcpp::List>(models[m]);
+        Eigen::MatrixXd w_m = Rcpp::as<Eigen::MatrixXd>(model["w"]);
+        Eigen::VectorXd d_m = Rcpp::as<Eigen::VectorXd>(model["d"]);
+        for (unsigned int i = 0; i < w_m.rows(); ++i)
+            w_m.row(i) *= d_m(i);
+        wd.push_back(w_m);
+        h.push_back(Rcpp::as<Eigen::MatrixXd>(model["h"]));
+    }
+    return RcppML::mse_models(A_, mask_, wd, h, threads, mask_zeros, missing_only);
+}
+
+// NON_NEGATIVE MATRIX FACTORIZATION
+
+// factors and fitting statistics of an nmf model, with factors in double precision, or "h" in half precision "h_format"
+template <class Model>
+Rcpp::List nmfResult(Model& m, const bool sparse_w, const bool sparse_h, const int h_format = RcppML::HALF_NONE) {
+    return Rcpp::List::create(Rcpp::Named("w") = wrapFactor(m.matrixW().transpose(), sparse_w),
+                              Rcpp::Named("d") = m.vectorD().template cast<double>(),
+                              Rcpp::Named("h") = (h_format == RcppML::HALF_NONE) ? wrapFactor(m.matrixH(), sparse_h)
+                                                                                 : wrapHalf(m.matrixH(), h_format),
+                              Rcpp::Named("tol") = m.fit_tol(),
+                              Rcpp::Named("iter") = m.fit_iter(),
+                              Rcpp::Named("mse") = m.fit_mse(),
+                              Rcpp::Named("loss") = m.fit_losses(),
+                              Rcpp::Named("cd_tol") = m.fit_cd_tols(),
+                              Rcpp::Named("frozen") = m.fit_frozen(),
+                              Rcpp::Named("best_model") = m.best_model());
+}
+
+// time in seconds of each phase of each iteration of a profiled fit, with counts of coordinate descent sweeps, solves that
+//   stopped at "CD_MAXIT", and values of "A" read in updates (see "RcppML::fitProfile")
+Rcpp::DataFrame profileFrame(const RcppML::fitProfile& p) {
+    const int n = p.seconds.size();
+    Rcpp::IntegerVector iter(n);
+    Rcpp::NumericMatrix seconds(n, RcppML::N_PHASES);
+    for (int i = 0; i < n; ++i) {
+        iter[i] = i + 1;
+        for (int phase = 0; phase < RcppML::N_PHASES; ++phase) seconds(i, phase) = p.seconds[i][phase];
+    }
+    return Rcpp::DataFrame::create(Rcpp::Named("iter") = iter,
+                                   Rcpp::Named("h") = Rcpp::NumericVector(seconds.column(RcppML::PHASE_H)),
+                                   Rcpp::Named("w") = Rcpp::NumericVector(seconds.column(RcppML::PHASE_W)),
+                                   Rcpp::Named("transpose") = Rcpp::NumericVector(seconds.column(RcppML::PHASE_TRANSPOSE)),
+                                   Rcpp::Named("scale") = Rcpp::NumericVector(seconds.column(RcppML::PHASE_SCALE)),
+                                   Rcpp::Named("mse") = Rcpp::NumericVector(seconds.column(RcppML::PHASE_MSE)),
+                                   Rcpp::Named("cd_sweeps") = p.sweeps,
+                                   Rcpp::Named("cd_maxit") = p.maxit,
+                                   Rcpp::Named("values") = p.values);
+}
+
+// peak and steady bytes of each subsystem in the memory accounts, with their total (see "RcppML::memoryAccounts")
+Rcpp::DataFrame memoryFrame() {
+    const RcppML::memoryAccounts& m = RcppML::memoryAccounting();
+    const char* names[RcppML::N_SUBSYSTEMS] = {"transpose", "mask", "workspace", "restarts", "result", "clusters", "distance"};
+    Rcpp::CharacterVector subsystem(RcppML::N_SUBSYSTEMS + 1);
+    Rcpp::NumericVector peak(RcppML::N_SUBSYSTEMS + 1), steady(RcppML::N_SUBSYSTEMS + 1);
+    for (int s = 0; s < RcppML::N_SUBSYSTEMS; ++s) {
+        subsystem[s] = names[s];
+        peak[s] = (double)m.peak[s].load();
+        steady[s] = (double)m.steady[s].load();
+        steady[RcppML::N_SUBSYSTEMS] += steady[s];
+    }
+    subsystem[RcppML::N_SUBSYSTEMS] = "total";
+    peak[RcppML::N_SUBSYSTEMS] = (double)m.total_peak.load();
+    return Rcpp::DataFrame::create(Rcpp::Named("subsystem") = subsystem, Rcpp::Named("peak") = peak, Rcpp::Named("steady") = steady,
+                                   Rcpp::Named("stringsAsFactors") = false);
+}
+
+// plan of a fit as returned to R (see "RcppML::fitPlan")
+Rcpp::List planList(const RcppML::fitPlan& plan) {
+    return Rcpp::List::create(Rcpp::Named("backend") = plan.dense ? "dense" : "sparse",
+                              Rcpp::Named("solver") = solverName(plan.solver),
+                              Rcpp::Named("threads_h") = plan.threads_h,
+                              Rcpp::Named("threads_w") = plan.threads_w,
+                              Rcpp::Named("stream") = plan.stream,
+                              Rcpp::Named("transpose") = plan.transpose,
+                              Rcpp::Named("loss_tile") = plan.loss_tile,
+                              Rcpp::Named("memory") = plan.bytes,
+                              Rcpp::Named("memory_available") = plan.available,
+                              Rcpp::Named("memory_limit") = plan.limit);
+}
+
+// plan of a fit of "shape" (see "RcppML::planFit") within the "memory_limit" in "given", in which "backend", "stream",
+//   "transpose", "loss_tile", "solver", "threads_h" and "threads_w" are overridden by those in "given", such as the plan of a
+//   previous fit
+//  * fails before the fit starts if its estimated memory is over the limit
+RcppML::fitPlan nmfPlan(const Rcpp::List& given, const RcppML::fitShape& shape, const unsigned int threads, const std::string& solver,
+                        const double dense_zeros, const double sparse_zeros) {
+    const double limit = given.containsElementNamed("memory_limit") ? Rcpp::as<double>(given["memory_limit"]) : 0;
+    if (limit < 0) Rcpp::stop("'RcppML.memory_limit' must be a non-negative number of bytes");
+    RcppML::fitPlan plan = RcppML::planFit(shape, threads, nnlsSolver(solver), dense_zeros, sparse_zeros, limit);
+    if (given.containsElementNamed("backend")) {
+        const std::string backend = Rcpp::as<std::string>(given["backend"]);
+        if (backend != "dense" && backend != "sparse") Rcpp::stop("the backend of 'plan' must be either \"dense\" or \"sparse\"");
+        if (backend == "dense" && shape.keep_sparse) Rcpp::stop("this fit is only supported by the sparse backend, and not by the backend of 'plan'");
+        plan.dense = backend == "dense";
+        if (plan.dense) plan.stream = false;
+    }
+    if (given.containsElementNamed("stream")) {
+        plan.stream = Rcpp::as<bool>(given["stream"]);
+        if (plan.stream && (plan.dense || !shape.streamable))
+            Rcpp::stop("this fit is not supported by column blocks without the transpose of 'A', as in the 'stream' of 'plan'");
+    }
+    if (given.containsElementNamed("transpose")) {
+        // dense "A" is never transposed
+        plan.transpose = Rcpp::as<bool>(given["transpose"]) || plan.dense;
+        if (!plan.transpose && !plan.stream && !shape.in_place)
+            Rcpp::stop("this fit does not support updates of 'w' without the transpose of 'A', as in the 'transpose' of 'plan'");
+    }
+    if (given.containsElementNamed("loss_tile")) plan.loss_tile = std::max(1u, Rcpp::as<unsigned int>(given["loss_tile"]));
+    if (given.containsElementNamed("solver")) plan.solver = nnlsSolver(Rcpp::as<std::string>(given["solver"]));
+    if (given.containsElementNamed("threads_h")) plan.threads_h = Rcpp::as<unsigned int>(given["threads_h"]);
+    if (given.containsElementNamed("threads_w")) plan.threads_w = Rcpp::as<unsigned int>(given["threads_w"]);
+    plan.bytes = RcppML::fitBytes(shape, plan, threads);
+    if (!RcppML::fitsLimit(plan)) {
+        std::string hint = " Write 'data' to disk with 'write_stream' and fit the stream";
+        if (!plan.dense && !shape.streamable && !shape.in_place) hint = " Fits without masking, linking, multiple initializations or rank paths can be fit without the transpose of 'data', or write 'data' to disk with 'write_stream' and fit the stream";
+        Rcpp::stop("the fit is estimated to need %.3g GB (%s backend%s), more than 'RcppML.memory_limit' of %.3g GB.%s, or use fewer threads.",
+                   plan.bytes / 1e9, plan.dense ? "dense" : "sparse", plan.stream ? " without transpose" : "", plan.limit / 1e9, hint);
+    }
+    return plan;
+}
+
+// true if a fit with these options is one unmasked, unlinked "als" model of all values of "A", which may be fit by
+//   column blocks without the transpose of "A" (see "RcppML::nmf_stream")
+bool streamableFit(const Rcpp::S4& mask, const unsigned int mask_inv_probability, const bool linked, const Rcpp::List& w_init,
+                   const Rcpp::IntegerVector& ranks, const std::vector<double>& L1, const std::vector<double>& L2, const std::string& method,
+                   const unsigned int batch_size, const Rcpp::List& online_stats, const double freeze_tol, const unsigned int race,
+                   const std::string& checkpoint, const bool accelerate, const unsigned int anderson, const double subsample,
+                   const bool keep_stats, const bool profile, const Rcpp::LogicalVector& nonneg) {
+    const Rcpp::IntegerVector mask_dim = mask.slot("Dim");
+    return mask_dim[0] == 0 && mask_inv_probability == 0 && !linked && w_init.length() == 1 && ranks.length() <= 1 && L1.size() <= 2 &&
+           L2.size() <= 2 && method == "als" && batch_size == 0 && online_stats.length() != 3 && freeze_tol == 0 && race == 0 &&
+           checkpoint.empty() && !accelerate && anderson == 0 && subsample == 0 && !keep_stats && !profile && nonneg[0] && nonneg[1];
+}
+
+// true if "w" of a fit with these options can be updated from sparse "A" in place, without its transpose: "als" models
+//   without masking, linking of "w", unconstrained "w", or "freeze_tol", and not online, updated or subsampled (see
+//   "nmf::predictRows")
+bool inPlaceFit(const Rcpp::S4& mask, const unsigned int mask_inv_probability, const bool mask_zeros, const bool link_w,
+                const std::string& method, const unsigned int batch_size, const Rcpp::List& online_stats, const double freeze_tol,
+                const double subsample, const Rcpp::LogicalVector& nonneg) {
+    const Rcpp::IntegerVector mask_dim = mask.slot("Dim");
+    return mask_dim[0] == 0 && mask_inv_probability == 0 && !mask_zeros && !link_w && method == "als" && batch_size == 0 &&
+           online_stats.length() != 3 && freeze_tol == 0 && subsample == 0 && nonneg[0];
+}
+
+// true if "A" is fit by the sparse backend
+template <typename Value>
+bool isSparse(const Rcpp::SparseMatrixOf<Value>& A) { return true; }
+template <class Derived>
+bool isSparse(const Eigen::MatrixBase<Derived>& A) { return false; }
+
+// fit an nmf model in the precision given by "Scalar", returning all factors in double precision
+//  * with more than one of "ranks", a list of models is returned, fit along a rank path (see "nmf::fit_rank_path")
+//  * with more than two values in "L1" or "L2", which are then pairs of penalties on "w" and "h" of equal number, a
+//      list of models is returned, one for each pair (see "nmf::fit_penalty_grid")
+//  * with "bootstrap" replicates, a list of models is returned, one fit to each replicate of the samples drawn from
+//      "bootstrap_seed" (see "nmf::fit_bootstrap"), the seed of the initialization, from which subsampled fits also draw
+//      their columns (see "nmf::fit_subsampled")
+//  * with "col_weights", columns of "A" are weighted as if column "j" were repeated "col_weights[j]" times, as are unique
+//      columns by their multiplicities (see "nmf::fit_weighted")
+//  * with "h_format", "h" of every returned model is encoded in half precision directly from the fit (see "wrapHalf")
+template <class T, typename Scalar>
+Rcpp::List c_nmf(T& A_, Rcpp::SparseMatrix& mask_, const double tol, const unsigned int maxit, const bool verbose,
+                 const std::vector<double>& L1, const std::vector<double>& L2, const unsigned int threads, Rcpp::List& w_init,
+                 Rcpp::SparseMatrix& link_matrix_h_, const bool mask_zeros, const bool link_h, const bool sort_model,
+                 const double upper_bound, const bool loss_tol, const unsigned int batch_size, const double decay,
+                 Rcpp::List& online_stats, const bool sparse_w, const bool sparse_h, const int solver,
+                 const bool inexact, const double freeze_tol, const std::string& method, const bool compress_indices = false,
+                 const unsigned int mask_seed = 0, const unsigned int mask_inv_probability = 0,
+                 const std::vector<unsigned int>& ranks = std::vector<unsigned int>(), const unsigned int race = 0,
+                 const double race_tol = 0, const std::string& checkpoint_path = "", const unsigned int checkpoint_every = 0,
+                 const bool accelerate = false, const unsigned int anderson = 0, const double subsample = 0,
+                 const bool keep_stats = false, const bool penalty_path = false, const bool profile = false,
+                 const RcppML::fitPlan* plan = NULL, const std::vector<bool>& nonneg = std::vector<bool>(2, true),
+                 const unsigned int bootstrap = 0, const unsigned int bootstrap_seed = 0, const int h_format = RcppML::HALF_NONE,
+                 const std::vector<double>& col_weights = std::vector<double>(), Rcpp::SparseMatrix* link_matrix_w_ = NULL, T* t_A_ = NULL, const double A_sq = -1) {
+    const RcppML::memoryScope accounting(profile);
+    Eigen::MatrixXd w_ = RcppML::asInitW(w_init[0]).matrix(A_.rows());
+    RcppML::nmf<T, Scalar> m(A_, w_.template cast<Scalar>());
+
+    // set model parameters
+    m.tol = tol;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.upper_bound = upper_bound;
+    m.solver = solver;
+    m.loss_tol = loss_tol;
+    m.inexact = inexact;
+    m.freeze_tol = freeze_tol;
+    m.hals = method == "hals";
+    m.robust = robustLoss(method);
+    m.nonneg = nonneg;
+    m.compress_indices = compress_indices;
+    m.race = race;
+    m.race_tol = race_tol;
+    m.checkpoint_path = checkpoint_path;
+    m.checkpoint_every = checkpoint_every;
+    m.accelerate = accelerate;
+    m.anderson = anderson;
+    m.subsample = subsample;
+    m.profile = profile;
+    // the solver and threads of a plan are those of its rank, and not of the other ranks of a rank path
+    if (plan && ranks.size() <= 1) {
+        m.solver = plan->solver;
+        m.threads_h = plan->threads_h;
+        m.threads_w = plan->threads_w;
+    }
+    if (plan) m.loss_tile = plan->loss_tile;
+    if (plan) m.transpose = plan->transpose || !isSparse(A_);
+    if (t_A_) m.setTranspose(*t_A_);
+    if (A_sq >= 0) m.setSquaredNorm(A_sq);
+    if (link_h) m.linkH(link_matrix_h_);
+    if (link_matrix_w_) m.linkW(*link_matrix_w_);
+    if (mask_zeros)
+        m.maskZeros();
+    else if (mask_inv_probability > 0)
+        m.maskMatrix(RcppML::hash_mask(mask_seed, mask_inv_probability));
+    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
+        m.maskMatrix(mask_);
+
+    const std::string backend = isSparse(A_) ? "sparse" : "dense";
+    if (checkpoint_every > 0) {
+        if (ranks.size() > 1 || batch_size > 0 || subsample > 0)
+            Rcpp::stop("rank paths, online and subsampled nmf cannot be checkpointed");
+        if (m.resume() && verbose) Rprintf("resuming from checkpoint '%s'\n", checkpoint_path.c_str());
+    }
+    if (profile && (ranks.size() > 1 || L1.size() > 2 || L2.size() > 2 || batch_size > 0 || online_stats.length() == 3 || subsample > 0))
+        Rcpp::stop("only single fits can be profiled, and not rank paths, penalty grids, or online, updated or subsampled fits");
+    if (bootstrap > 0 && (ranks.size() > 1 || L1.size() > 2 || L2.size() > 2))
+        Rcpp::stop("bootstrap replicates cannot be fit along a rank path or penalty grid");
+    if (!col_weights.empty() && (ranks.size() > 1 || L1.size() > 2 || L2.size() > 2 || bootstrap > 0))
+        Rcpp::stop("weighted columns cannot be fit along a rank path or penalty grid, or in bootstrap replicates");
+    if (ranks.size() > 1) {
+        if (batch_size > 0 || subsample > 0 || w_init.length() > 1 || link_h || link_matrix_w_ || keep_stats || online_stats.length() == 3)
+            Rcpp::stop("a rank path supports only a single initialization in 'seed', without online, subsampled or updated fits or linking");
+        Rcpp::List results(ranks.size());
+        unsigned int step = 0;
+        m.fit_rank_path(ranks, [&](RcppML::nmf<T, Scalar>& fitted) {
+            Rcpp::List result = nmfResult(fitted, sparse_w, sparse_h, h_format);
+            result["backend"] = backend;
+            results[step++] = result;
+        });
+        return results;
+    }
+    if (L1.size() > 2 || L2.size() > 2) {
+        if (L1.size() != L2.size() || L1.size() % 2 != 0) Rcpp::stop("'L1' and 'L2' must give the same number of pairs of penalties");
+        if (batch_size > 0 || subsample > 0 || w_init.length() > 1 || keep_stats || online_stats.length() == 3 || checkpoint_every > 0)
+            Rcpp::stop("a penalty grid supports only a single initialization in 'seed', without online, subsampled or updated fits or checkpoints");
+        std::vector<std::vector<double> > L1s, L2s;
+        for (unsigned int i = 0; i < L1.size(); i += 2) {
+            L1s.push_back(std::vector<double>(L1.begin() + i, L1.begin() + i + 2));
+            L2s.push_back(std::vector<double>(L2.begin() + i, L2.begin() + i + 2));
+        }
+        Rcpp::List results(L1s.size());
+        unsigned int step = 0;
+        m.fit_penalty_grid(L1s, L2s, penalty_path, [&](RcppML::nmf<T, Scalar>& fitted) {
+            Rcpp::List result = nmfResult(fitted, sparse_w, sparse_h, h_format);
+            result["backend"] = backend;
+            if (plan) result["plan"] = planList(*plan);
+            result["L1"] = L1s[step];
+            result["L2"] = L2s[step];
+            results[step++] = result;
+        });
+        return results;
+    }
+    if (bootstrap > 0) {
+        if (batch_size > 0 || subsample > 0 || w_init.length() > 1 || keep_stats || online_stats.length() == 3 || checkpoint_every > 0)
+            Rcpp::stop("bootstrap replicates support only a single initialization in 'seed', without online, subsampled or updated fits or checkpoints");
+        Rcpp::List results(bootstrap);
+        unsigned int step = 0;
+        m.fit_bootstrap(bootstrap, bootstrap_seed, [&](RcppML::nmf<T, Scalar>& fitted) {
+            Rcpp::List result = nmfResult(fitted, sparse_w, sparse_h, h_format);
+            result["backend"] = backend;
+            if (plan) result["plan"] = planList(*plan);
+            result["bootstrap"] = step + 1;
+            results[step++] = result;
+        });
+        return results;
+    }
+
+    if (!col_weights.empty()) {
+        if (batch_size > 0 || subsample > 0 || w_init.length() > 1 || keep_stats || online_stats.length() == 3 || checkpoint_every > 0 ||
+            accelerate || anderson > 0)
+            Rcpp::stop("weighted columns support only a single initialization in 'seed', without online, subsampled, updated or accelerated fits or checkpoints");
+        m.fit_weighted(Eigen::Map<const Eigen::VectorXd>(col_weights.data(), col_weights.size()).template cast<Scalar>());
+    } else if (batch_size > 0) {
+        if (w_init.length() > 1) Rcpp::stop("only a single initialization in 'seed' is supported for online nmf");
+        if (accelerate || anderson > 0) Rcpp::stop("online nmf cannot be accelerated");
+        m.batch_size = batch_size;
+        m.decay = decay;
+        if (online_stats.length() == 3)
+            m.onlineStats(Rcpp::as<Eigen::MatrixXd>(online_stats[0]).template cast<Scalar>(),
+                          Rcpp::as<Eigen::MatrixXd>(online_stats[1]).template cast<Scalar>(),
+                          Rcpp::as<Eigen::VectorXd>(online_stats[2]).template cast<Scalar>());
+        m.fit_online();
+    } else if (online_stats.length() == 3) {
+        // update a fitted model with new samples from its sufficient statistics
+        if (w_init.length() > 1) Rcpp::stop("only a single initialization in 'seed' is supported for updates of nmf");
+        if (accelerate || anderson > 0 || subsample > 0) Rcpp::stop("updates of nmf cannot be accelerated or subsampled");
+        m.decay = decay;
+        m.onlineStats(Rcpp::as<Eigen::MatrixXd>(online_stats[0]).template cast<Scalar>(),
+                      Rcpp::as<Eigen::MatrixXd>(online_stats[1]).template cast<Scalar>(),
+                      Rcpp::as<Eigen::VectorXd>(online_stats[2]).template cast<Scalar>());
+        m.fit_update();
+    } else if (subsample > 0) {
+        if (w_init.length() > 1) Rcpp::stop("only a single initialization in 'seed' is supported for subsampled nmf");
+        m.fit_subsampled(bootstrap_seed);
+    } else if (w_init.length() == 1)
+        m.fit();
+    else
+        m.fit_restarts(w_init);
+    if (checkpoint_every > 0) std::remove(checkpoint_path.c_str());
+    if (keep_stats && batch_size == 0 && online_stats.length() != 3) m.keepStats();
+
+    Rcpp::List result = nmfResult(m, sparse_w, sparse_h, h_format);
+    result["backend"] = backend;
+    if (plan) result["plan"] = planList(*plan);
+    if (m.robust != RcppML::ROBUST_NONE)
+        result["robust"] = Rcpp::List::create(Rcpp::Named("scale") = m.robustScale(),
+                                              Rcpp::Named("weights") = std::vector<double>(m.robustWeights().begin(), m.robustWeights().end()));
+    // multiple initializations are only profiled for memory, since their timings are of different models
+    if (profile && w_init.length() == 1) result["profile"] = profileFrame(m.fit_profile());
+    if (profile) {
+        RcppML::trackBytes(RcppML::MEM_RESULT, (double)(m.matrixW().size() + m.matrixH().size() + m.vectorD().size()) * sizeof(double));
+        result["memory"] = memoryFrame();
+    }
+    if (batch_size > 0 || keep_stats || online_stats.length() == 3)
+        result["online_stats"] = Rcpp::List::create(Rcpp::Named("a") = m.onlineGramH().template cast<double>(),
+                                                    Rcpp::Named("b") = m.onlineHAt().template cast<double>(),
+                                                    Rcpp::Named("h_sum") = m.onlineSumH().template cast<double>());
+    return result;
+}
+
+// open ("open = TRUE") or close a scope of the memory accounts (see "RcppML::memoryAccounts") for "memory_profile",
+//   returning the accounts
+//[[Rcpp::export]]
+Rcpp::DataFrame Rcpp_memory_accounting(const bool open) {
+    if (open)
+        RcppML::memoryAccounting().open();
+    else
+        RcppML::memoryAccounting().close();
+    return memoryFrame();
+}
+
+// "prepared" structure of a temporary copy of data, which is not looked up in or added to the session cache
+Rcpp::List uncached() { return Rcpp::List::create(Rcpp::Named("cache") = false); }
+
+// linking matrix of "w" (factors by features) given as the only item of "link_w", or an empty matrix if "w" is not linked
+Rcpp::SparseMatrix linkOf(const Rcpp::List& link_w) {
+    if (link_w.length() == 0) return Rcpp::SparseMatrix();
+    if (link_w.length() != 1) Rcpp::stop("'link_w' must be an empty list or a list of one linking matrix");
+    return Rcpp::SparseMatrix(Rcpp::as<Rcpp::S4>(link_w[0]));
+}
+
+// fit an nmf model of sparse "A" with non-zero values stored as "Value", where "args" are all other arguments to
+//   "c_nmf", and the structure of "A" may be precomputed by "Rcpp_prepare_sparse"
+//  * "A" compressed by rows (e.g. Matrix::dgRMatrix) is read in place as "t(A)", which updates of "w" read, and is
+//      transposed once with "threads" for updates of "h", rather than coerced in R and then transposed again
+//  * otherwise, if the session cache is used and "prepared" is empty, the structure of "A" and the structure that
+//      earlier fits cached for it are taken from the cache (see "RcppML::matrixCache")
+template <typename Value, typename Scalar, class... Args>
+Rcpp::List c_nmf_values(const Rcpp::S4& A, Rcpp::List& prepared, const unsigned int threads, Args&&... args) {
+    Rcpp::SparseMatrixOf<Value> A_, t_A_;
+    const std::shared_ptr<RcppML::preparedSparse> cached = (prepared.length() == 0) ? RcppML::sessionCache().get(A, threads) : nullptr;
+    if (cached) {
+        A_ = Rcpp::SparseMatrixOf<Value>::sharedCopy(cached->A);
+        if (!cached->symmetric) t_A_ = Rcpp::SparseMatrixOf<Value>::sharedCopy(cached->t_A);
+        return c_nmf<Rcpp::SparseMatrixOf<Value>, Scalar>(A_, std::forward<Args>(args)..., cached->symmetric ? NULL : &t_A_,
+                                                          cached->sq_norm);
+    }
+    if (Rcpp::isRowCompressed(A)) {
+        t_A_ = Rcpp::SparseMatrixOf<Value>::transposedView(A);
+        A_ = t_A_.transpose(threads);
+    } else {
+        A_ = Rcpp::SparseMatrixOf<Value>(A);
+    }
+    double A_sq = -1;
+    if (prepared.length() == 3) {
+        A_.setAppxSymmetric(Rcpp::as<bool>(prepared["symmetric"]));
+        A_sq = Rcpp::as<double>(prepared["sq_norm"]);
+        if (!A_.isAppxSymmetric()) t_A_ = Rcpp::SparseMatrixOf<Value>(Rcpp::as<Rcpp::S4>(prepared["t_data"]));
+    }
+    return c_nmf<Rcpp::SparseMatrixOf<Value>, Scalar>(A_, std::forward<Args>(args)..., (t_A_.Dim.size() == 2) ? &t_A_ : NULL, A_sq);
+}
+
+// fit an nmf model of sparse "A" with non-zero values stored in the most compact type that represents them exactly
+//   (see "Rcpp::sparseValueType"), so that updates read less memory for count and binary data
+//  * with "float_values", values that are not whole numbers are stored in single precision even for a model in double
+//      precision. Values are still read as "double", so all products and losses are accumulated in double precision.
+template <typename Scalar, class... Args>
+Rcpp::List c_nmf_sparse(const Rcpp::S4& A, Rcpp::List& prepared, const bool float_values, const unsigned int threads, Args&&... args) {
+    switch (Rcpp::sparseValueType(A, std::is_same<Scalar, float>::value || float_values)) {
+        case Rcpp::SPARSE_PATTERN:
+            return c_nmf_values<Rcpp::SparsePattern, Scalar>(A, prepared, threads, std::forward<Args>(args)...);
+        case Rcpp::SPARSE_UINT16:
+            return c_nmf_values<uint16_t, Scalar>(A, prepared, threads, std::forward<Args>(args)...);
+        case Rcpp::SPARSE_FLOAT:
+            return c_nmf_values<float, Scalar>(A, prepared, threads, std::forward<Args>(args)...);
+        default:
+            return c_nmf_values<double, Scalar>(A, prepared, threads, std::forward<Args>(args)...);
+    }
+}
+
+Rcpp::List Rcpp_nmf_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, const double tol, const unsigned int maxit,
+                          const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
+                          const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros,
+                          const bool link_h, const bool sort_model, const double upper_bound, const bool use_float,
+                          const bool loss_tol, const unsigned int batch_size, const double decay, Rcpp::List online_stats,
+                          const bool sparse_w, const bool sparse_h, const std::string solver, const bool inexact,
+                          const double freeze_tol, const std::string method, const unsigned int mask_seed,
+                          const unsigned int mask_inv_probability, Rcpp::IntegerVector ranks, const unsigned int race,
+                          const double race_tol, const double sparse_zeros, const std::string checkpoint,
+                          const unsigned int checkpoint_every, const bool float_values, const bool accelerate,
+                          const unsigned int anderson, const double subsample, const bool keep_stats,
+                          const bool penalty_path, const bool profile, Rcpp::List plan, Rcpp::LogicalVector nonneg, Rcpp::List link_w,
+                          const unsigned int bootstrap, const unsigned int bootstrap_seed, const int h_precision,
+                          Rcpp::NumericVector col_weights);
+
+template <typename Scalar, class Source>
+Rcpp::List c_nmf_stream(Source& A, const double tol, const unsigned int maxit, const bool verbose,
+                        const std::vector<double>& L1, const std::vector<double>& L2, const unsigned int threads,
+                        Eigen::MatrixXd& w_init, const bool sort_model, const double upper_bound, const bool loss_tol,
+                        const bool sparse_w, const bool sparse_h, const int solver, const bool inexact);
+
+// dense copy of an S4 sparse matrix, in which the non-zeros of a ngCMatrix are 1
+Rcpp::NumericMatrix denseOf(const Rcpp::S4& A) {
+    const Rcpp::IntegerVector i = A.slot("i"), p = A.slot("p"), Dim = A.slot("Dim");
+    const bool pattern = !A.hasSlot("x");
+    Rcpp::NumericVector x;
+    if (!pattern) x = A.slot("x");
+    Rcpp::NumericMatrix A_(Dim[0], Dim[1]);
+    for (int j = 0; j < Dim[1]; ++j)
+        for (int k = p[j]; k < p[j + 1]; ++k) A_(i[k], j) = pattern ? 1 : x[k];
+    return A_;
+}
+
+// with fewer than a fraction "dense_zeros" of zeros, "A" is fit as a dense matrix by products over blocks of columns,
+//   which is faster than iterating over nearly all values by their indices, and needs no transpose of "A"
+//  * "prepared" is the structure of "A" from "Rcpp_prepare_sparse", or empty to use the session cache (see
+//      "RcppML::matrixCache"), or "list(cache = FALSE)" for temporary copies of data, which are not cached
+//  * "A" is kept sparse if its transpose is given in "prepared" or it is compressed by rows, or with "compress_indices",
+//      "mask_zeros" or a robust "method" (whose weights are held on the non-zeros of "A"), or if its dense copy would not
+//      fit in memory
+//  * the backend, solver and threads are planned from the shape of "A" (see "RcppML::fitPlan"), or given in "plan", and
+//      the plan is returned with the model
+//  * with "min_row_nnz", "min_col_nnz", "min_row_var" or "normalize", the model is fit to the kept features and samples
+//      of "A" with normalized samples, written once by "RcppML::filterSparse", and every returned model gives the kept
+//      "features" and "samples" (1-based) and the "sample_scale" of each kept sample
+//  * with "h_precision" (see "RcppML::half_format"), "h" is returned as a "halfMatrix", and "A" is not streamed
+//  * with "col_weights", columns of "A" are weighted (see "c_nmf"), and "A" is not streamed
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, const double tol, const unsigned int maxit,
+                           const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
+                           const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h,
+                           const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound = 0,
+                           const bool use_float = false, const bool loss_tol = false, const unsigned int batch_size = 0,
+                           const double decay = 0.9, Rcpp::List online_stats = Rcpp::List::create(),
+                           const bool sparse_w = false, const bool sparse_h = false, const std::string solver = "auto",
+                           const bool inexact = false, const double freeze_tol = 0, const std::string method = "als",
+                           Rcpp::List prepared = Rcpp::List::create(), const bool compress_indices = false,
+                           const unsigned int mask_seed = 0, const unsigned int mask_inv_probability = 0,
+                           Rcpp::IntegerVector ranks = Rcpp::IntegerVector::create(), const unsigned int race = 0,
+                           const double race_tol = 0, const double dense_zeros = 0, const std::string checkpoint = "",
+                           const unsigned int checkpoint_every = 0, const bool float_values = false,
+                           const bool accelerate = false, const unsigned int anderson = 0, const double subsample = 0,
+                           const bool keep_stats = false, const bool penalty_path = false, const unsigned int min_row_nnz = 0,
+                           const unsigned int min_col_nnz = 0, const double min_row_var = 0, const std::string normalize = "none",
+                           const bool profile = false, Rcpp::List plan = Rcpp::List::create(),
+                           Rcpp::LogicalVector nonneg = Rcpp::LogicalVector::create(true, true),
+                           Rcpp::List link_w = Rcpp::List::create(), const unsigned int bootstrap = 0,
+                           const unsigned int bootstrap_seed = 0, const int h_precision = 0,
+                           Rcpp::NumericVector col_weights = Rcpp::NumericVector::create()) {
+    if (min_row_nnz > 0 || min_col_nnz > 0 || min_row_var > 0 || normalize != "none") {
+        const Rcpp::IntegerVector mask_dim = mask.slot("Dim");
+        if (prepared.length() == 3 || mask_dim[0] > 0 || mask_zeros || mask_inv_probability > 0 || link_h || link_w.length() == 1 ||
+            online_stats.length() == 3 || col_weights.size() > 0)
+            Rcpp::stop("filtering and normalization of 'A' is not supported with prepared matrices, masking, linking, weighted columns, or updates from 'online_stats'");
+        RcppML::sparseFilter kept;
+        const Rcpp::S4 A_kept = RcppML::filterSparse(A, min_row_nnz, min_col_nnz, min_row_var, sampleNormalization(normalize), kept, threads);
+
+        // initializations given as matrices are of all features
+        const int n_rows = Rcpp::as<Rcpp::IntegerVector>(A.slot("Dim"))[0];
+        Rcpp::List w_init_kept(w_init.length());
+        for (int i = 0; i < w_init.length(); ++i) {
+            if (Rf_isMatrix(w_init[i]) && Rcpp::as<Rcpp::NumericMatrix>(w_init[i]).ncol() == n_rows) {
+                const Eigen::MatrixXd w = Rcpp::as<Eigen::MatrixXd>(w_init[i]);
+                Eigen::MatrixXd w_kept(w.rows(), kept.rows.size());
+                for (unsigned int r = 0; r < kept.rows.size(); ++r) w_kept.col(r) = w.col(kept.rows[r]);
+                w_init_kept[i] = w_kept;
+            } else {
+                w_init_kept[i] = w_init[i];
+            }
+        }
+        Rcpp::List results = Rcpp_nmf_sparse(A_kept, mask, tol, maxit, verbose, L1, L2, threads, w_init_kept, link_matrix_h, mask_zeros,
+                                             link_h, sort_model, upper_bound, use_float, loss_tol, batch_size, decay, online_stats,
+                                             sparse_w, sparse_h, solver, inexact, freeze_tol, method, uncached(), compress_indices,
+                                             mask_seed, mask_inv_probability, ranks, race, race_tol, dense_zeros, checkpoint,
+                                             checkpoint_every, float_values, accelerate, anderson, subsample, keep_stats, penalty_path, 0, 0, 0,
+                                             "none", profile, plan, nonneg, Rcpp::List::create(), bootstrap, bootstrap_seed, h_precision, col_weights);
+        Rcpp::IntegerVector features(kept.rows.begin(), kept.rows.end()), samples(kept.cols.begin(), kept.cols.end());
+        features = features + 1;
+        samples = samples + 1;
+        const Rcpp::NumericVector sample_scale(kept.scale.begin(), kept.scale.end());
+        const bool single = results.containsElementNamed("w");
+        for (int i = 0; i < (single ? 1 : results.length()); ++i) {
+            Rcpp::List result = single ? results : Rcpp::as<Rcpp::List>(results[i]);
+            result["features"] = features;
+            result["samples"] = samples;
+            result["sample_scale"] = sample_scale;
+            if (single) return result;
+            results[i] = result;
+        }
+        return results;
+    }
+    const Rcpp::IntegerVector A_p = A.slot("p"), Dim = A.slot("Dim");
+    RcppML::fitShape shape;
+    shape.rows = Dim[0];
+    shape.cols = Dim[1];
+    shape.nnz = A_p[A_p.size() - 1];
+    shape.k = RcppML::asInitW(w_init[0]).rank();
+    shape.keep_sparse = prepared.length() == 3 || compress_indices || mask_zeros || Rcpp::isRowCompressed(A) || robustLoss(method) != RcppML::ROBUST_NONE;
+    shape.transposed = prepared.length() == 3;
+    shape.in_place = !shape.transposed && inPlaceFit(mask, mask_inv_probability, mask_zeros, link_w.length() == 1, method, batch_size,
+                                                     online_stats, freeze_tol, subsample, nonneg);
+    shape.streamable = A.hasSlot("x") && !shape.keep_sparse && !float_values && bootstrap == 0 && h_precision == 0 && col_weights.size() == 0 &&
+                       streamableFit(mask, mask_inv_probability, link_h || link_w.length() == 1, w_init, ranks, L1, L2, method,
+                                     batch_size, online_stats, freeze_tol, race, checkpoint, accelerate, anderson, subsample,
+                                     keep_stats, profile, nonneg);
+    const RcppML::fitPlan plan_ = nmfPlan(plan, shape, threads, solver, dense_zeros, 1);
+    if (plan_.stream) {
+        // one block of "A", read in place without its transpose (see "nmf_stream")
+        RcppML::SparseMatrixList A_blocks(Rcpp::List::create(A));
+        Eigen::MatrixXd w_ = RcppML::asInitW(w_init[0]).matrix(Dim[0]);
+        Rcpp::List result = use_float ? c_nmf_stream<float>(A_blocks, tol, maxit, verbose, L1, L2, threads, w_, sort_model, upper_bound,
+                                                            loss_tol, sparse_w, sparse_h, plan_.solver, inexact)
+                                      : c_nmf_stream<double>(A_blocks, tol, maxit, verbose, L1, L2, threads, w_, sort_model, upper_bound,
+                                                             loss_tol, sparse_w, sparse_h, plan_.solver, inexact);
+        result["backend"] = "sparse";
+        result["plan"] = planList(plan_);
+        return result;
+    }
+    if (plan_.dense) {
+        Rcpp::NumericMatrix A_dense = denseOf(A);
+        return Rcpp_nmf_dense(Eigen::Map<Eigen::MatrixXd>(A_dense.begin(), Dim[0], Dim[1]), mask, tol, maxit, verbose, L1, L2,
+                              threads, w_init, link_matrix_h, mask_zeros, link_h, sort_model, upper_bound, use_float, loss_tol,
+                              batch_size, decay, online_stats, sparse_w, sparse_h, solver, inexact, freeze_tol, method, mask_seed,
+                              mask_inv_probability, ranks, race, race_tol, 1, checkpoint, checkpoint_every, float_values,
+                              accelerate, anderson, subsample, keep_stats, penalty_path, profile, planList(plan_), nonneg, link_w,
+                              bootstrap, bootstrap_seed, h_precision, col_weights);
+    }
+    Rcpp::SparseMatrix mask_(mask), link_matrix_h_(link_matrix_h);
+    const std::vector<unsigned int> ranks_ = Rcpp::as<std::vector<unsigned int> >(ranks);
+    const std::vector<bool> nonneg_ = Rcpp::as<std::vector<bool> >(nonneg);
+    Rcpp::SparseMatrix link_matrix_w_ = linkOf(link_w);
+    Rcpp::SparseMatrix* link_w_ = (link_w.length() == 1) ? &link_matrix_w_ : NULL;
+    const std::vector<double> col_weights_ = Rcpp::as<std::vector<double> >(col_weights);
+    if (use_float)
+        return c_nmf_sparse<float>(A, prepared, float_values, threads, mask_, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h_,
+                                   mask_zeros, link_h, sort_model, upper_bound, loss_tol, batch_size, decay, online_stats,
+                                   sparse_w, sparse_h, nnlsSolver(solver), inexact, freeze_tol, method,
+                                   compress_indices, mask_seed, mask_inv_probability, ranks_, race, race_tol, checkpoint, checkpoint_every,
+                                   accelerate, anderson, subsample, keep_stats, penalty_path, profile, &plan_, nonneg_,
+                                   bootstrap, bootstrap_seed, h_precision, col_weights_, link_w_);
+    return c_nmf_sparse<double>(A, prepared, float_values, threads, mask_, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h_,
+                                mask_zeros, link_h, sort_model, upper_bound, loss_tol, batch_size, decay, online_stats,
+                                sparse_w, sparse_h, nnlsSolver(solver), inexact, freeze_tol, method,
+                                compress_indices, mask_seed, mask_inv_probability, ranks_, race, race_tol, checkpoint, checkpoint_every,
+                                accelerate, anderson, subsample, keep_stats, penalty_path, profile, &plan_, nonneg_,
+                                bootstrap, bootstrap_seed, h_precision, col_weights_, link_w_);
+}
+
+// with "mask_zeros", or more than a fraction "sparse_zeros" of zeros, dense "A" is fit as a sparse matrix: the non-zeros
+//   of each column are found once rather than in every update of "h" and "w", its transpose is cached for updates of
+//   "w", and with "mask_zeros" the loss is computed over the non-zeros
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_dense(Eigen::Map<Eigen::MatrixXd> A_, const Rcpp::S4& mask, const double tol, const unsigned int maxit,
+                          const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
+                          const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros,
+                          const bool link_h, const bool sort_model, const double upper_bound = 0, const bool use_float = false,
+                          const bool loss_tol = false, const unsigned int batch_size = 0, const double decay = 0.9,
+                          Rcpp::List online_stats = Rcpp::List::create(), const bool sparse_w = false,
+                          const bool sparse_h = false, const std::string solver = "auto", const bool inexact = false,
+                          const double freeze_tol = 0, const std::string method = "als", const unsigned int mask_seed = 0,
+                          const unsigned int mask_inv_probability = 0, Rcpp::IntegerVector ranks = Rcpp::IntegerVector::create(),
+                          const unsigned int race = 0, const double race_tol = 0, const double sparse_zeros = 1,
+                          const std::string checkpoint = "", const unsigned int checkpoint_every = 0,
+                          const bool float_values = false, const bool accelerate = false,
+                          const unsigned int anderson = 0, const double subsample = 0, const bool keep_stats = false,
+                          const bool penalty_path = false, const bool profile = false, Rcpp::List plan = Rcpp::List::create(),
+                          Rcpp::LogicalVector nonneg = Rcpp::LogicalVector::create(true, true),
+                          Rcpp::List link_w = Rcpp::List::create(), const unsigned int bootstrap = 0,
+                          const unsigned int bootstrap_seed = 0, const int h_precision = 0,
+                           Rcpp::NumericVector col_weights = Rcpp::NumericVector::create()) {
+    RcppML::fitShape shape;
+    shape.rows = A_.rows();
+    shape.cols = A_.cols();
+    shape.nnz = (sparse_zeros < 1 || plan.containsElementNamed("backend")) ? n_nonzeros(A_) : A_.size();
+    shape.k = RcppML::asInitW(w_init[0]).rank();
+    shape.sparse = false;
+    shape.keep_sparse = mask_zeros;
+    shape.in_place = inPlaceFit(mask, mask_inv_probability, mask_zeros, link_w.length() == 1, method, batch_size, online_stats, freeze_tol,
+                                subsample, nonneg);
+    shape.streamable = !mask_zeros && bootstrap == 0 && h_precision == 0 && col_weights.size() == 0 &&
+                       streamableFit(mask, mask_inv_probability, link_h || link_w.length() == 1, w_init, ranks, L1, L2, method,
+                                     batch_size, online_stats, freeze_tol, race, checkpoint, accelerate, anderson, subsample,
+                                     keep_stats, profile, nonneg);
+    const RcppML::fitPlan plan_ = nmfPlan(plan, shape, threads, solver, 0, sparse_zeros);
+    if (!plan_.dense)
+        return Rcpp_nmf_sparse(Rcpp::SparseMatrix(A_).wrap(), mask, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h,
+                               mask_zeros, link_h, sort_model, upper_bound, use_float, loss_tol, batch_size, decay, online_stats,
+                               sparse_w, sparse_h, solver, inexact, freeze_tol, method, uncached(), false, mask_seed,
+                               mask_inv_probability, ranks, race, race_tol, 0, checkpoint, checkpoint_every, float_values,
+                               accelerate, anderson, subsample, keep_stats, penalty_path, 0, 0, 0, "none", profile, planList(plan_),
+                               nonneg, link_w, bootstrap, bootstrap_seed, h_precision, col_weights);
+    Rcpp::SparseMatrix mask_(mask), link_matrix_h_(link_matrix_h);
+    const std::vector<unsigned int> ranks_ = Rcpp::as<std::vector<unsigned int> >(ranks);
+    const std::vector<bool> nonneg_ = Rcpp::as<std::vector<bool> >(nonneg);
+    Rcpp::SparseMatrix link_matrix_w_ = linkOf(link_w);
+    Rcpp::SparseMatrix* link_w_ = (link_w.length() == 1) ? &link_matrix_w_ : NULL;
+    const std::vector<double> col_weights_ = Rcpp::as<std::vector<double> >(col_weights);
+    if (use_float) {
+        Eigen::MatrixXf A_f = A_.cast<float>();
+        return c_nmf<Eigen::MatrixXf, float>(A_f, mask_, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h_,
+                                             mask_zeros, link_h, sort_model, upper_bound, loss_tol, batch_size, decay,
+                                             online_stats, sparse_w, sparse_h, nnlsSolver(solver), inexact, freeze_tol,
+                                             method, false, mask_seed, mask_inv_probability, ranks_, race, race_tol, checkpoint,
+                                          checkpoint_every, accelerate, anderson, subsample, keep_stats, penalty_path, profile, &plan_, nonneg_,
+                                          bootstrap, bootstrap_seed, h_precision, col_weights_, link_w_);
+    }
+    return c_nmf<Eigen::Map<Eigen::MatrixXd>, double>(A_, mask_, tol, maxit, verbose, L1, L2, threads, w_init, link_matrix_h_,
+                                          mask_zeros, link_h, sort_model, upper_bound, loss_tol, batch_size, decay,
+                                          online_stats, sparse_w, sparse_h, nnlsSolver(solver), inexact, freeze_tol,
+                                          method, false, mask_seed, mask_inv_probability, ranks_, race, race_tol, checkpoint,
+                                          checkpoint_every, accelerate, anderson, subsample, keep_stats, penalty_path, profile, &plan_, nonneg_,
+                                          bootstrap, bootstrap_seed, h_precision, col_weights_, link_w_);
+}
+
+// initial "w" with "n_features" columns, given as a matrix or drawn in C++ from "c(k, seed, normal, a, b)" exactly as
+//   within a fit (see "RcppML::initW"), for models that record their initialization or are fit from a permuted "w"
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_init_w(const Rcpp::RObject& init, const unsigned int n_features) {
+    return RcppML::asInitW(init).matrix(n_features);
+}
+
+// Gram matrix "xx^T" on "threads" threads (see "gram")
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_gram(const Eigen::Map<Eigen::MatrixXd> x, const unsigned int threads) {
+    return gram(x, threads);
+}
+
+// initial "w" by NNDSVD of "A" (see "RcppML::nndsvd"), as a "k x nrow(A)" matrix
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_nndsvd_sparse(const Rcpp::S4& A, const unsigned int k, const unsigned int power_iters, const unsigned int seed,
+                                   const unsigned int threads) {
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        return RcppML::nndsvd(A_, k, power_iters, seed, threads);
+    }
+    Rcpp::SparseMatrix A_(A);
+    return RcppML::nndsvd(A_, k, power_iters, seed, threads);
+}
+
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_nndsvd_dense(const Eigen::MatrixXd& A, const unsigned int k, const unsigned int power_iters, const unsigned int seed,
+                                  const unsigned int threads) {
+    return RcppML::nndsvd(A, k, power_iters, seed, threads);
+}
+
+// initial "w" from the centers of "k" leaves of a divisive clustering of "A" (see "RcppML::dclustInit"), as a
+//   "k x nrow(A)" matrix
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_dclust_init_sparse(const Rcpp::S4& A, const unsigned int k, const unsigned int seed, const unsigned int threads) {
+    Rcpp::SparseMatrix A_(A);
+    return RcppML::dclustInit(A_, k, seed, threads);
+}
+
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_dclust_init_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int k, const unsigned int seed,
+                                       const unsigned int threads) {
+    Eigen::Map<Eigen::MatrixXd> A_(A);
+    return RcppML::dclustInit(A_, k, seed, threads);
+}
+
+// metacells of "A" as a "dgCMatrix", with the 1-based metacell of each column (see "RcppML::metacells")
+Rcpp::List wrapMetacells(const RcppML::metacellResult& res, const int n_rows) {
+    Rcpp::S4 cells(std::string("dgCMatrix"));
+    cells.slot("Dim") = Rcpp::IntegerVector::create(n_rows, (int)res.p.size() - 1);
+    cells.slot("i") = Rcpp::wrap(res.i);
+    cells.slot("p") = Rcpp::wrap(res.p);
+    cells.slot("x") = Rcpp::wrap(res.x);
+    Rcpp::IntegerVector leaf(res.leaf.begin(), res.leaf.end());
+    return Rcpp::List::create(Rcpp::Named("data") = cells, Rcpp::Named("leaf") = leaf + 1);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_metacells_sparse(const Rcpp::S4& A, const unsigned int n_cells, const unsigned int seed, const unsigned int threads) {
+    Rcpp::SparseMatrix A_(A);
+    return wrapMetacells(RcppML::metacells(A_, n_cells, seed, threads), A_.rows());
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_metacells_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int n_cells, const unsigned int seed,
+                                const unsigned int threads) {
+    Eigen::Map<Eigen::MatrixXd> A_(A);
+    return wrapMetacells(RcppML::metacells(A_, n_cells, seed, threads), A_.rows());
+}
+
+// "w" of a compressed nmf of "A" from the initial "w" (see "RcppML::compressedNMF")
+Rcpp::List wrapCompressed(const RcppML::compressedResult& res) {
+    return Rcpp::List::create(Rcpp::Named("w") = res.w, Rcpp::Named("tol") = res.tol, Rcpp::Named("iter") = res.iter);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_compressed_nmf_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& w, const unsigned int sketch_size,
+                                      const unsigned int power_iters, const unsigned int seed, const double tol,
+                                      const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2,
+                                      const bool verbose, const unsigned int threads) {
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        return wrapCompressed(RcppML::compressedNMF(A_, w, sketch_size, power_iters, seed, tol, maxit, L1, L2, verbose, threads));
+    }
+    Rcpp::SparseMatrix A_(A);
+    return wrapCompressed(RcppML::compressedNMF(A_, w, sketch_size, power_iters, seed, tol, maxit, L1, L2, verbose, threads));
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_compressed_nmf_dense(const Eigen::MatrixXd& A, const Eigen::MatrixXd& w, const unsigned int sketch_size,
+                                     const unsigned int power_iters, const unsigned int seed, const double tol,
+                                     const unsigned int maxit, const std::vector<double> L1, const std::vector<double> L2,
+                                     const bool verbose, const unsigned int threads) {
+    return wrapCompressed(RcppML::compressedNMF(A, w, sketch_size, power_iters, seed, tol, maxit, L1, L2, verbose, threads));
+}
+
+// SYMMETRIC NON-NEGATIVE MATRIX FACTORIZATION
+
+// fit "RcppML::snmf" of symmetric "A" from the initial "w", with the penalties on "h"
+template <class Matrix>
+Rcpp::List c_snmf(Matrix& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose,
+                  const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model,
+                  const int solver) {
+    RcppML::snmf<Matrix> m(A, w_init);
+    m.tol = tol;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.L1 = L1[1];
+    m.L2 = L2[1];
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.solver = solver;
+    m.fit();
+    return Rcpp::List::create(Rcpp::Named("w") = m.w.transpose(), Rcpp::Named("d") = m.d, Rcpp::Named("h") = m.h,
+                              Rcpp::Named("tol") = m.tol_, Rcpp::Named("iter") = m.iter, Rcpp::Named("mse") = m.mse);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_snmf_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit,
+                            const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                            const bool sort_model, const std::string solver = "auto") {
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        return c_snmf(A_, w_init, tol, maxit, verbose, L1, L2, threads, sort_model, nnlsSolver(solver));
+    }
+    Rcpp::SparseMatrix A_(A);
+    return c_snmf(A_, w_init, tol, maxit, verbose, L1, L2, threads, sort_model, nnlsSolver(solver));
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_snmf_dense(Eigen::MatrixXd& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit,
+                           const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                           const bool sort_model, const std::string solver = "auto") {
+    return c_snmf(A, w_init, tol, maxit, verbose, L1, L2, threads, sort_model, nnlsSolver(solver));
+}
+
+// IMPLICIT-FEEDBACK NON-NEGATIVE MATRIX FACTORIZATION
+
+// fit "RcppML::implicitNMF" of sparse "A" from the initial "w", with confidence "1 + alpha A_ij" in non-zeros "A_ij"
+template <typename Value>
+Rcpp::List c_implicit_nmf(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w_init, const double alpha, const double tol,
+                          const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
+                          const unsigned int threads, const bool sort_model) {
+    RcppML::implicitNMF<Value> m(A, w_init);
+    m.alpha = alpha;
+    m.tol = tol;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.fit();
+    return Rcpp::List::create(Rcpp::Named("w") = m.w.transpose(), Rcpp::Named("d") = m.d, Rcpp::Named("h") = m.h,
+                              Rcpp::Named("tol") = m.tol_, Rcpp::Named("iter") = m.iter, Rcpp::Named("mse") = m.mse);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_implicit_nmf(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double alpha, const double tol,
+                             const unsigned int maxit, const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
+                             const unsigned int threads, const bool sort_model) {
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        return c_implicit_nmf(A_, w_init, alpha, tol, maxit, verbose, L1, L2, threads, sort_model);
+    }
+    Rcpp::SparseMatrix A_(A);
+    return c_implicit_nmf(A_, w_init, alpha, tol, maxit, verbose, L1, L2, threads, sort_model);
+}
+
+// KULLBACK-LEIBLER NON-NEGATIVE MATRIX FACTORIZATION
+
+// fit "RcppML::klNMF" of sparse "A" from the initial "w"
+template <typename Value>
+Rcpp::List c_kl_nmf(Rcpp::SparseMatrixOf<Value>& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit,
+                    const bool verbose, const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                    const bool sort_model) {
+    RcppML::klNMF<Value> m(A, w_init);
+    m.tol = tol;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.fit();
+    return Rcpp::List::create(Rcpp::Named("w") = m.w.transpose(), Rcpp::Named("d") = m.d, Rcpp::Named("h") = m.h,
+                              Rcpp::Named("tol") = m.tol_, Rcpp::Named("iter") = m.iter, Rcpp::Named("mse") = m.mse,
+                              Rcpp::Named("kl") = m.kl);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_kl_nmf(const Rcpp::S4& A, const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose,
+                       const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads, const bool sort_model) {
+    if (Rcpp::sparseValueType(A) == Rcpp::SPARSE_PATTERN) {
+        Rcpp::SparseMatrixOf<Rcpp::SparsePattern> A_(A);
+        return c_kl_nmf(A_, w_init, tol, maxit, verbose, L1, L2, threads, sort_model);
+    }
+    Rcpp::SparseMatrix A_(A);
+    return c_kl_nmf(A_, w_init, tol, maxit, verbose, L1, L2, threads, sort_model);
+}
+
+// LINKED NON-NEGATIVE MATRIX FACTORIZATION
+
+// fit "RcppML::lnmf" of "A" from the stacked initial "[w; u_1; ...]"
+template <class Matrix>
+Rcpp::List c_lnmf(std::vector<Matrix>& A, const unsigned int k_wh, const std::vector<unsigned int>& k_uv, const Eigen::MatrixXd& w_init,
+                  const double tol, const unsigned int maxit, const bool verbose, const std::vector<double> L1,
+                  const std::vector<double> L2, const unsigned int threads, const int solver, const std::vector<Matrix>* t_A = NULL) {
+    RcppML::lnmf<Matrix> m(A, k_wh, k_uv, w_init);
+    if (t_A) m.setTranspose(*t_A);
+    m.tol = tol;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.threads = threads;
+    m.solver = solver;
+    m.fit();
+    Rcpp::List h(A.size());
+    for (size_t i = 0; i < A.size(); ++i) h[i] = Rcpp::wrap(m.h[i]);
+    return Rcpp::List::create(Rcpp::Named("w") = m.x.transpose(), Rcpp::Named("d") = m.d, Rcpp::Named("h") = h,
+                              Rcpp::Named("tol") = m.tol_, Rcpp::Named("iter") = m.iter, Rcpp::Named("mse") = m.mse);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_lnmf_sparse(const Rcpp::List& data, const unsigned int k_wh, const std::vector<unsigned int>& k_uv,
+                            const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose,
+                            const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                            const std::string solver = "auto") {
+    // transposes are taken from the session cache only if every dataset is cached (see "RcppML::matrixCache")
+    std::vector<Rcpp::SparseMatrix> A, t_A;
+    for (int i = 0; i < data.length(); ++i) {
+        const Rcpp::S4 A_i = Rcpp::as<Rcpp::S4>(data[i]);
+        const std::shared_ptr<RcppML::preparedSparse> cached = RcppML::sessionCache().get(A_i, threads);
+        A.push_back(cached ? Rcpp::SparseMatrix::sharedCopy(cached->A) : Rcpp::SparseMatrix(A_i));
+        if (cached) t_A.push_back(Rcpp::SparseMatrix::sharedCopy(cached->symmetric ? cached->A : cached->t_A));
+    }
+    return c_lnmf(A, k_wh, k_uv, w_init, tol, maxit, verbose, L1, L2, threads, nnlsSolver(solver), (t_A.size() == A.size()) ? &t_A : NULL);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_lnmf_dense(const Rcpp::List& data, const unsigned int k_wh, const std::vector<unsigned int>& k_uv,
+                           const Eigen::MatrixXd& w_init, const double tol, const unsigned int maxit, const bool verbose,
+                           const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                           const std::string solver = "auto") {
+    std::vector<Eigen::MatrixXd> A;
+    for (int i = 0; i < data.length(); ++i) A.push_back(Rcpp::as<Eigen::MatrixXd>(data[i]));
+    return c_lnmf(A, k_wh, k_uv, w_init, tol, maxit, verbose, L1, L2, threads, nnlsSolver(solver));
+}
+
+// CROSS-VALIDATION OF NON-NEGATIVE MATRIX FACTORIZATION
+
+// test set mean squared error of an nmf model fit for each initialization in "w_init" with the masking matrix of
+// replicate "reps[i]", where masks are hashed from "mask_seeds" with "mask_inv_probability" (see "hash_mask")
+//  * with "rank_path", the initializations of each replicate are in increasing rank, and only the first is used
+//  * with "patience", models of a replicate that were not fit after its test error stopped improving have a NaN error
+//  * "t(A)" may be given in "t_A_", e.g. from the session cache (see "RcppML::matrixCache")
+//  * with "holdout_samples", the hashes of "mask_seeds" instead hold out samples and features for bi-cross-validation
+//      (see "nmf::fit_cross_validate_samples"), and "rank_path" is not supported
+template <class T, typename Scalar>
+std::vector<double> c_cross_validate(T& A_, const std::vector<unsigned int>& mask_seeds, const unsigned int mask_inv_probability,
+                                     Rcpp::List& w_init, const std::vector<unsigned int>& reps, const double tol,
+                                     const unsigned int maxit, const std::vector<double>& L1, const std::vector<double>& L2,
+                                     const unsigned int threads, const double upper_bound, const bool loss_tol, const int solver,
+                                     const bool inexact, const bool rank_path, const unsigned int patience, const bool holdout_samples,
+                                     T* t_A_ = NULL) {
+    if ((int)reps.size() != w_init.length()) Rcpp::stop("'reps' must give the replicate of each initialization in 'w_init'");
+    std::vector<RcppML::hash_mask> masks_;
+    for (unsigned int r = 0; r < mask_seeds.size(); ++r)
+        masks_.push_back(RcppML::hash_mask(mask_seeds[r], mask_inv_probability));
+    std::vector<RcppML::initW> inits;
+    for (int i = 0; i < w_init.length(); ++i) inits.push_back(RcppML::asInitW(w_init[i]));
+    std::vector<Eigen::Matrix<Scalar, -1, -1> > w_inits(inits.size());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (size_t i = 0; i < inits.size(); ++i) w_inits[i] = inits[i].matrix(A_.rows()).template cast<Scalar>();
+
+    RcppML::nmf<T, Scalar> m(A_, w_inits[0]);
+    m.tol = tol;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.maxit = maxit;
+    m.verbose = false;
+    m.threads = threads;
+    m.sort_model = false;
+    m.upper_bound = upper_bound;
+    m.solver = solver;
+    m.loss_tol = loss_tol;
+    m.inexact = inexact;
+    if (holdout_samples) {
+        if (rank_path) Rcpp::stop("'rank_path' is not supported when holding out samples");
+        return m.fit_cross_validate_samples(masks_, w_inits, reps, patience);
+    }
+    if (t_A_) m.setTranspose(*t_A_);
+    return m.fit_cross_validate(masks_, w_inits, reps, rank_path, patience);
+}
+
+//[[Rcpp::export]]
+std::vector<double> Rcpp_cross_validate_sparse(const Rcpp::S4& A, const std::vector<unsigned int> mask_seeds,
+                                               const unsigned int mask_inv_probability, Rcpp::List w_init,
+                                               const std::vector<unsigned int> reps, const double tol,
+                                               const unsigned int maxit, const std::vector<double> L1,
+                                               const std::vector<double> L2, const unsigned int threads,
+                                               const double upper_bound = 0, const bool use_float = false,
+                                               const bool loss_tol = false, const std::string solver = "auto",
+                                               const bool inexact = false, const bool rank_path = false,
+                                               const unsigned int patience = 0, const bool holdout_samples = false) {
+    const std::shared_ptr<RcppML::preparedSparse> cached = RcppML::sessionCache().get(A, threads);
+    Rcpp::SparseMatrix A_ = cached ? Rcpp::SparseMatrix::sharedCopy(cached->A) : Rcpp::SparseMatrix(A), t_A_;
+    if (cached && !cached->symmetric) t_A_ = Rcpp::SparseMatrix::sharedCopy(cached->t_A);
+    Rcpp::SparseMatrix* t_A = (t_A_.Dim.size() == 2) ? &t_A_ : NULL;
+    if (use_float)
+        return c_cross_validate<Rcpp::SparseMatrix, float>(A_, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2,
+                                                           threads, upper_bound, loss_tol, nnlsSolver(solver), inexact, rank_path, patience,
+                                                           holdout_samples, t_A);
+    return c_cross_validate<Rcpp::SparseMatrix, double>(A_, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2,
+                                                        threads, upper_bound, loss_tol, nnlsSolver(solver), inexact, rank_path, patience,
+                                                        holdout_samples, t_A);
+}
+
+//[[Rcpp::export]]
+std::vector<double> Rcpp_cross_validate_dense(Eigen::Map<Eigen::MatrixXd> A_, const std::vector<unsigned int> mask_seeds,
+                                              const unsigned int mask_inv_probability, Rcpp::List w_init,
+                                              const std::vector<unsigned int> reps, const double tol,
+                                              const unsigned int maxit, const std::vector<double> L1,
+                                              const std::vector<double> L2, const unsigned int threads,
+                                              const double upper_bound = 0, const bool use_float = false,
+                                              const bool loss_tol = false, const std::string solver = "auto",
+                                              const bool inexact = false, const bool rank_path = false,
+                                              const unsigned int patience = 0, const bool holdout_samples = false) {
+    if (use_float) {
+        Eigen::MatrixXf A_f = A_.cast<float>();
+        return c_cross_validate<Eigen::MatrixXf, float>(A_f, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2,
+                                                        threads, upper_bound, loss_tol, nnlsSolver(solver), inexact, rank_path, patience,
+                                                     holdout_samples);
+    }
+    return c_cross_validate<Eigen::Map<Eigen::MatrixXd>, double>(A_, mask_seeds, mask_inv_probability, w_init, reps, tol, maxit, L1, L2,
+                                                     threads, upper_bound, loss_tol, nnlsSolver(solver), inexact, rank_path, patience,
+                                                     holdout_samples);
+}
+
+// structure of a sparse matrix that "nmf", "predict", "evaluate" and "dclust" would otherwise recompute in each call
+//   (see "RcppML::preparedSparse")
+//[[Rcpp::export]]
+Rcpp::List Rcpp_prepare_sparse(const Rcpp::S4& A, const unsigned int threads) {
+    RcppML::preparedSparse prepared(A, threads);
+    return Rcpp::List::create(Rcpp::Named("t_data") = prepared.symmetric ? Rcpp::S4("dgCMatrix") : prepared.t_A.wrap(),
+                              Rcpp::Named("symmetric") = prepared.symmetric, Rcpp::Named("sq_norm") = prepared.sq_norm,
+                              Rcpp::Named("has_na") = prepared.has_na);
+}
+
+// limit in bytes of the session cache of prepared sparse matrices (see "RcppML::matrixCache"), set if "limit" is not
+//   negative, where 0 clears it and stops using it, and its state
+//[[Rcpp::export]]
+Rcpp::List Rcpp_matrix_cache(const double limit, const bool clear) {
+    RcppML::matrixCache& cache = RcppML::sessionCache();
+    if (clear) cache.clear();
+    if (limit >= 0) cache.setLimit((size_t)limit);
+    return Rcpp::List::create(Rcpp::Named("limit") = (double)cache.limit(), Rcpp::Named("bytes") = (double)cache.bytes(),
+                              Rcpp::Named("matrices") = (int)cache.size(), Rcpp::Named("hits") = (double)cache.hits,
+                              Rcpp::Named("misses") = (double)cache.misses);
+}
+
+// NA, infinite and negative values of a matrix, found in one parallel pass over its values that also collects the
+//   positions of NA values as the index of a sparse mask
+//  * outer vectors (columns, or rows of a matrix compressed by rows) are split into one contiguous range per thread, so
+//      the NA indices found in each range are concatenated in order without sorting
+//  * "idx" and "p" are the inner indices and outer pointers of a sparse matrix, or null for a dense matrix
+Rcpp::List scan_values(const double* x, const int* idx, const int* p, const int n_inner, const int n_outer,
+                       unsigned int threads) {
+#ifdef _OPENMP
+    if (threads == 0) threads = omp_get_max_threads();
+#endif
+    const int n_ranges = std::max(1, std::min((int)threads, n_outer));
+    std::vector<std::vector<int>> na_idx(n_ranges);
+    std::vector<int> na_count(n_outer + 1, 0);
+    int n_na = 0, n_inf = 0, n_negative = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(n_ranges) schedule(static, 1) reduction(+ : n_na, n_inf, n_negative)
+#endif
+    for (int r = 0; r < n_ranges; ++r) {
+        const int first = (int)((int64_t)n_outer * r / n_ranges), last = (int)((int64_t)n_outer * (r + 1) / n_ranges);
+        for (int j = first; j < last; ++j) {
+            const int64_t begin = p ? p[j] : (int64_t)j * n_inner, end = p ? p[j + 1] : (int64_t)(j + 1) * n_inner;
+            for (int64_t it = begin; it < end; ++it) {
+                const double v = x[it];
+                if (std::isnan(v)) {
+                    na_idx[r].push_back(idx ? idx[it] : (int)(it - begin));
+                    ++na_count[j + 1];
+                } else if (std::isinf(v)) {
+                    ++n_inf;
+                } else if (v < 0) {
+                    ++n_negative;
+                }
+            }
+        }
+        n_na += na_idx[r].size();
+    }
+    Rcpp::IntegerVector mask_p(n_outer + 1), mask_i(n_na);
+    for (int j = 0; j < n_outer; ++j) mask_p[j + 1] = mask_p[j] + na_count[j + 1];
+    int k = 0;
+    for (const auto& r : na_idx)
+        for (const int i : r) mask_i[k++] = i;
+    return Rcpp::List::create(Rcpp::Named("n_na") = n_na, Rcpp::Named("n_inf") = n_inf,
+                              Rcpp::Named("n_negative") = n_negative, Rcpp::Named("i") = mask_i, Rcpp::Named("p") = mask_p);
+}
+
+// validation of "data" before it is passed to "nmf", "predict" or "evaluate" (see "scan_input" in R), in place of scans
+//   for NA values in R that coerce dense matrices and allocate logical matrices
+//  * the mask of NA values has the same compression as "A", so a matrix compressed by rows gives a "dgRMatrix"
+//[[Rcpp::export]]
+Rcpp::List Rcpp_scan_sparse(const Rcpp::S4& A, const unsigned int threads) {
+    const bool by_rows = Rcpp::isRowCompressed(A);
+    const Rcpp::IntegerVector idx = A.slot(by_rows ? "j" : "i"), p = A.slot("p"), Dim = A.slot("Dim");
+    const Rcpp::NumericVector x = A.slot("x");
+    const int n_outer = p.size() - 1;
+    Rcpp::List s = scan_values(x.begin(), idx.begin(), p.begin(), by_rows ? Dim[1] : Dim[0], n_outer, threads);
+    const Rcpp::IntegerVector mask_i = s["i"];
+    Rcpp::S4 mask(std::string(by_rows ? "dgRMatrix" : "dgCMatrix"));
+    mask.slot(by_rows ? "j" : "i") = mask_i;
+    mask.slot("p") = s["p"];
+    mask.slot("x") = Rcpp::NumericVector(mask_i.size(), 1.0);
+    mask.slot("Dim") = Rcpp::clone(Dim);
+    return Rcpp::List::create(Rcpp::Named("n_na") = s["n_na"], Rcpp::Named("n_inf") = s["n_inf"],
+                              Rcpp::Named("n_negative") = s["n_negative"], Rcpp::Named("mask") = mask);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_scan_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int threads) {
+    Rcpp::List s = scan_values(A.data(), nullptr, nullptr, A.rows(), A.cols(), threads);
+    const Rcpp::IntegerVector mask_i = s["i"];
+    Rcpp::S4 mask(std::string("dgCMatrix"));
+    mask.slot("i") = mask_i;
+    mask.slot("p") = s["p"];
+    mask.slot("x") = Rcpp::NumericVector(mask_i.size(), 1.0);
+    mask.slot("Dim") = Rcpp::IntegerVector::create(A.rows(), A.cols());
+    return Rcpp::List::create(Rcpp::Named("n_na") = s["n_na"], Rcpp::Named("n_inf") = s["n_inf"],
+                              Rcpp::Named("n_negative") = s["n_negative"], Rcpp::Named("mask") = mask);
+}
+
+// STREAMING NON-NEGATIVE MATRIX FACTORIZATION OF SPARSE MATRICES ON DISK
+
+//[[Rcpp::export]]
+void Rcpp_write_stream(const Rcpp::S4& A, const std::string path, const unsigned int chunk_size, const bool append = false) {
+    Rcpp::SparseMatrix A_(A);
+    RcppML::writeSparseStream(A_, path, chunk_size, append);
+}
+
+//[[Rcpp::export]]
+std::vector<double> Rcpp_stream_dim(const std::string path) {
+    RcppML::SparseMatrixStream A(path);
+    return std::vector<double>{(double)A.rows(), (double)A.cols(), (double)A.n_chunks()};
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_predict_stream(const std::string path, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads,
+                         const double upper_bound = 0, const bool use_float = false, const bool sparse = false,
+                         const std::string solver = "auto") {
+    RcppML::SparseMatrixStream A(path);
+    if (A.rows() != w.cols()) Rcpp::stop("dimensions of 'w' and the stream are not compatible");
+    if (use_float) {
+        Eigen::MatrixXf h(w.rows(), A.cols());
+        RcppML::predict_stream(A, Eigen::MatrixXf(w.cast<float>()), h, L1, L2, threads, upper_bound, nnlsSolver(solver));
+        return wrapFactor(h.cast<double>(), sparse);
+    }
+    Eigen::MatrixXd h(w.rows(), A.cols());
+    RcppML::predict_stream(A, w, h, L1, L2, threads, upper_bound, nnlsSolver(solver));
+    return wrapFactor(h, sparse);
+}
+
+template <typename Scalar, class Source>
+Rcpp::List c_nmf_stream(Source& A, const double tol, const unsigned int maxit, const bool verbose,
+                        const std::vector<double>& L1, const std::vector<double>& L2, const unsigned int threads,
+                        Eigen::MatrixXd& w_init, const bool sort_model, const double upper_bound, const bool loss_tol,
+                        const bool sparse_w, const bool sparse_h, const int solver, const bool inexact) {
+    RcppML::nmf_stream<Scalar, Source> m(A, w_init.template cast<Scalar>());
+    m.tol = tol;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.maxit = maxit;
+    m.verbose = verbose;
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.upper_bound = upper_bound;
+    m.solver = solver;
+    m.loss_tol = loss_tol;
+    m.inexact = inexact;
+    m.fit();
+    return Rcpp::List::create(Rcpp::Named("w") = wrapFactor(m.matrixW().transpose(), sparse_w),
+                              Rcpp::Named("d") = m.vectorD().template cast<double>(),
+                              Rcpp::Named("h") = wrapFactor(m.matrixH(), sparse_h),
+                              Rcpp::Named("tol") = m.fit_tol(),
+                              Rcpp::Named("iter") = m.fit_iter(),
+                              Rcpp::Named("mse") = 0,
+                              Rcpp::Named("loss") = m.fit_losses(),
+                              Rcpp::Named("cd_tol") = m.fit_cd_tols(),
+                              Rcpp::Named("best_model") = 0);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_stream(const std::string path, const double tol, const unsigned int maxit, const bool verbose,
+                           const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                           Eigen::MatrixXd w_init, const bool sort_model, const double upper_bound = 0,
+                           const bool use_float = false, const bool loss_tol = false, const bool sparse_w = false,
+                           const bool sparse_h = false, const std::string solver = "auto",
+                           const bool inexact = false) {
+    RcppML::SparseMatrixStream A(path);
+    if (use_float)
+        return c_nmf_stream<float>(A, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, loss_tol,
+                                   sparse_w, sparse_h, nnlsSolver(solver), inexact);
+    return c_nmf_stream<double>(A, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, loss_tol,
+                                sparse_w, sparse_h, nnlsSolver(solver), inexact);
+}
+
+// nmf of a list of "dgCMatrix" column blocks, fit one block at a time like a stream so that their total number of
+// non-zeros may exceed what a single "dgCMatrix" can index
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_list(const Rcpp::List& blocks, const double tol, const unsigned int maxit, const bool verbose,
+                         const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                         Eigen::MatrixXd w_init, const bool sort_model, const double upper_bound = 0,
+                         const bool use_float = false, const bool loss_tol = false, const bool sparse_w = false,
+                         const bool sparse_h = false, const std::string solver = "auto", const bool inexact = false) {
+    RcppML::SparseMatrixList A(blocks);
+    if (use_float)
+        return c_nmf_stream<float>(A, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, loss_tol,
+                                   sparse_w, sparse_h, nnlsSolver(solver), inexact);
+    return c_nmf_stream<double>(A, tol, maxit, verbose, L1, L2, threads, w_init, sort_model, upper_bound, loss_tol,
+                                sparse_w, sparse_h, nnlsSolver(solver), inexact);
+}
+
+// projection of "w" onto a list of "dgCMatrix" column blocks, which are read in place rather than combined
+//[[Rcpp::export]]
+SEXP Rcpp_predict_list(const Rcpp::List& blocks, Eigen::MatrixXd w, const double L1, const double L2, const unsigned int threads,
+                       const double upper_bound = 0, const bool use_float = false, const bool sparse = false,
+                       const std::string solver = "auto") {
+    RcppML::SparseMatrixList A(blocks);
+    if (A.rows() != w.cols()) Rcpp::stop("dimensions of 'w' and the blocks of 'data' are not compatible");
+    if (use_float) {
+        Eigen::MatrixXf h(w.rows(), A.cols());
+        RcppML::predict_stream(A, Eigen::MatrixXf(w.cast<float>()), h, L1, L2, threads, upper_bound, nnlsSolver(solver));
+        return wrapFactor(h.cast<double>(), sparse);
+    }
+    Eigen::MatrixXd h(w.rows(), A.cols());
+    RcppML::predict_stream(A, w, h, L1, L2, threads, upper_bound, nnlsSolver(solver));
+    return wrapFactor(h, sparse);
+}
+
+//[[Rcpp::export]]
+double Rcpp_mse_list(const Rcpp::List& blocks, const Eigen::MatrixXd& w, const Eigen::VectorXd& d, const Eigen::MatrixXd& h,
+                     const unsigned int threads) {
+    RcppML::SparseMatrixList A(blocks);
+    return RcppML::mse_stream(A, w, d, h, threads);
+}
+
+// nmf of a list of "dgCMatrix" column blocks as partitions of distributed nmf (see "nmf::fit_distributed") within one
+//   process, where statistics of all partitions are summed in place of an allreduce over ranks
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_partitioned(const Rcpp::List& blocks, const double tol, const unsigned int maxit, const std::vector<double> L1,
+                                const std::vector<double> L2, const unsigned int threads, Eigen::MatrixXd w_init, const bool sort_model) {
+    std::vector<Rcpp::SparseMatrix> A;
+    for (unsigned int i = 0; i < blocks.size(); ++i) A.push_back(Rcpp::SparseMatrix(Rcpp::as<Rcpp::S4>(blocks[i])));
+    if (A.empty()) Rcpp::stop("'blocks' must contain at least one matrix");
+    std::vector<std::unique_ptr<RcppML::nmf<Rcpp::SparseMatrix> > > parts;
+    for (Rcpp::SparseMatrix& block : A) {
+        if (block.rows() != A[0].rows()) Rcpp::stop("all blocks must have the same number of rows");
+        parts.emplace_back(new RcppML::nmf<Rcpp::SparseMatrix>(block, w_init));
+        parts.back()->tol = tol;
+        parts.back()->maxit = maxit;
+        parts.back()->L1 = L1;
+        parts.back()->L2 = L2;
+        parts.back()->threads = threads;
+        parts.back()->checkDistributed();
+    }
+    Eigen::MatrixXd stats, stats_i;
+    unsigned int iter = 0;
+    double fit_tol = 1;
+    for (; iter < maxit;) {
+        for (unsigned int i = 0; i < parts.size(); ++i) {
+            parts[i]->partitionStats(stats_i);
+            if (i == 0)
+                stats = stats_i;
+            else
+                stats += stats_i;
+        }
+        bool converged = false;
+        for (auto& part : parts) converged = part->updateFromStats(stats);
+        fit_tol = parts[0]->fit_tol();
+        ++iter;
+        if (converged) break;
+        Rcpp::checkUserInterrupt();
+    }
+
+    // "h" of all columns, scaled by its row sums over all partitions
+    Eigen::VectorXd h_sum = Eigen::VectorXd::Zero(w_init.rows());
+    Eigen::Index n = 0;
+    for (auto& part : parts) {
+        part->predictH();
+        h_sum += part->matrixH().rowwise().sum();
+        n += part->matrixH().cols();
+    }
+    Eigen::MatrixXd h(w_init.rows(), n);
+    n = 0;
+    for (auto& part : parts) {
+        part->scaleDistributedH(h_sum);
+        h.middleCols(n, part->matrixH().cols()) = part->matrixH();
+        n += part->matrixH().cols();
+    }
+    Eigen::MatrixXd w = parts[0]->matrixW();
+    Eigen::VectorXd d = parts[0]->vectorD();
+    if (sort_model && w.rows() > 1) {
+        std::vector<int> indx = sort_index(d);
+        w = reorder_rows(w, indx);
+        d = reorder(d, indx);
+        h = reorder_rows(h, indx);
+    }
+    return Rcpp::List::create(Rcpp::Named("w") = Eigen::MatrixXd(w.transpose()), Rcpp::Named("d") = d, Rcpp::Named("h") = h,
+                              Rcpp::Named("tol") = fit_tol, Rcpp::Named("iter") = iter);
+}
+
+// NMF FITS ON A BACKGROUND THREAD
+
+// options of an nmf fit on a background thread, which is started before it is returned to R as an external pointer
+template <class T>
+SEXP startNmfJob(RcppML::nmfJob<T>* job, const double tol, const unsigned int maxit, const std::vector<double>& L1,
+                 const std::vector<double>& L2, const unsigned int threads, const bool sort_model, const bool loss_tol) {
+    Rcpp::XPtr<RcppML::asyncFit> ptr(job, true);
+    RcppML::nmf<T>& m = job->model();
+    m.tol = tol;
+    m.maxit = maxit;
+    m.L1 = L1;
+    m.L2 = L2;
+    m.threads = threads;
+    m.sort_model = sort_model;
+    m.loss_tol = loss_tol;
+    job->start();
+    return ptr;
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_nmf_async_sparse(const Rcpp::S4& A, Eigen::MatrixXd w_init, const double tol, const unsigned int maxit,
+                           const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                           const bool sort_model, const bool loss_tol = false) {
+    Rcpp::SparseMatrix A_(A);
+    return startNmfJob(new RcppML::nmfJob<Rcpp::SparseMatrix>(A_, w_init), tol, maxit, L1, L2, threads, sort_model, loss_tol);
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_nmf_async_dense(const Eigen::MatrixXd& A, Eigen::MatrixXd w_init, const double tol, const unsigned int maxit,
+                          const std::vector<double> L1, const std::vector<double> L2, const unsigned int threads,
+                          const bool sort_model, const bool loss_tol = false) {
+    return startNmfJob(new RcppML::nmfJob<Eigen::MatrixXd>(A, w_init), tol, maxit, L1, L2, threads, sort_model, loss_tol);
+}
+
+RcppML::asyncFit* asyncFitPtr(SEXP handle) {
+    if (TYPEOF(handle) != EXTPTRSXP || R_ExternalPtrAddr(handle) == NULL)
+        Rcpp::stop("fit is not valid (fits cannot be saved and reloaded, start a new fit)");
+    return (RcppML::asyncFit*)R_ExternalPtrAddr(handle);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_async_progress(SEXP handle) {
+    const RcppML::asyncFit* job = asyncFitPtr(handle);
+    const char* status[] = {"running", "done", "cancelled", "failed"};
+    return Rcpp::List::create(Rcpp::Named("status") = status[job->status()], Rcpp::Named("iter") = job->iter(),
+                              Rcpp::Named("tol") = job->tol());
+}
+
+//[[Rcpp::export]]
+void Rcpp_nmf_async_cancel(SEXP handle) { asyncFitPtr(handle)->cancel(); }
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_async_collect(SEXP handle) {
+    RcppML::asyncFit* job = asyncFitPtr(handle);
+    job->wait();
+    return Rcpp::List::create(Rcpp::Named("w") = Eigen::MatrixXd(job->matrixW().transpose()), Rcpp::Named("d") = job->vectorD(),
+                              Rcpp::Named("h") = job->matrixH(), Rcpp::Named("tol") = job->tol(), Rcpp::Named("iter") = job->iter(),
+                              Rcpp::Named("status") = job->status() == RcppML::asyncFit::CANCELLED ? "cancelled" : "done");
+}
+
+// NMF FITS ADVANCED STEP BY STEP
+
+// options of an nmf fit that is advanced by "Rcpp_nmf_step", returned to R as an external pointer before any iteration
+template <class T>
+SEXP newNmfFitter(RcppML::nmfFitter<T>* fitter, const double tol, const std::vector<double>& L1, const std::vector<double>& L2) {
+    Rcpp::XPtr<RcppML::stepFit> ptr(fitter, true);
+    RcppML::nmf<T>& m = fitter->model();
+    m.tol = tol;
+    m.L1 = L1;
+    m.L2 = L2;
+    return ptr;
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_nmf_fitter_sparse(const Rcpp::S4& A, Eigen::MatrixXd w_init, const double tol, const std::vector<double> L1,
+                            const std::vector<double> L2) {
+    Rcpp::SparseMatrix A_(A);
+    return newNmfFitter(new RcppML::nmfFitter<Rcpp::SparseMatrix>(A_, w_init), tol, L1, L2);
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_nmf_fitter_dense(const Eigen::MatrixXd& A, Eigen::MatrixXd w_init, const double tol, const std::vector<double> L1,
+                           const std::vector<double> L2) {
+    return newNmfFitter(new RcppML::nmfFitter<Eigen::MatrixXd>(A, w_init), tol, L1, L2);
+}
+
+RcppML::stepFit* stepFitPtr(SEXP handle) {
+    if (TYPEOF(handle) != EXTPTRSXP || R_ExternalPtrAddr(handle) == NULL)
+        Rcpp::stop("fitter is not valid (fitters cannot be saved and reloaded, create a new fitter)");
+    return (RcppML::stepFit*)R_ExternalPtrAddr(handle);
+}
+
+// advance a fitter by up to "n" iterations on "threads", and return its state after them
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_step(SEXP handle, const unsigned int n, const unsigned int threads) {
+    RcppML::stepFit* fitter = stepFitPtr(handle);
+    const unsigned int steps = fitter->step(n, threads);
+    const std::vector<double> losses = fitter->losses();
+    return Rcpp::List::create(Rcpp::Named("steps") = steps, Rcpp::Named("iter") = fitter->iter(), Rcpp::Named("tol") = fitter->tol(),
+                              Rcpp::Named("loss") = losses.empty() ? NA_REAL : losses.back(),
+                              Rcpp::Named("converged") = fitter->converged());
+}
+
+// the model of a fitter after its last step, with factors sorted by "d" if "sort_model"
+//[[Rcpp::export]]
+Rcpp::List Rcpp_nmf_fitter_model(SEXP handle, const bool sort_model) {
+    RcppML::stepFit* fitter = stepFitPtr(handle);
+    Eigen::MatrixXd w = fitter->matrixW(), h = fitter->matrixH();
+    Eigen::VectorXd d = fitter->vectorD();
+    if (sort_model && w.rows() > 1) {
+        std::vector<int> indx = sort_index(d);
+        w = reorder_rows(w, indx);
+        d = reorder(d, indx);
+        h = reorder_rows(h, indx);
+    }
+    return Rcpp::List::create(Rcpp::Named("w") = Eigen::MatrixXd(w.transpose()), Rcpp::Named("d") = d, Rcpp::Named("h") = h,
+                              Rcpp::Named("tol") = fitter->tol(), Rcpp::Named("iter") = fitter->iter(),
+                              Rcpp::Named("loss") = fitter->losses());
+}
+
+// BIPARTITION A SAMPLE SET BY RANK-2 NMF
+
+// initial "w" of a bipartition, drawn from "seed" unless given in "w_init"
+inline Eigen::MatrixXd bipartitionInit(const Eigen::MatrixXd& w_init, const unsigned int n_features, const unsigned int seed) {
+    if (w_init.size() == 0) return randomMatrix(2, n_features, seed);
+    if (w_init.rows() != 2 || w_init.cols() != n_features) Rcpp::stop("'w' must have two rows and a column for each feature");
+    return w_init;
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_bipartition_sparse(const Rcpp::S4& A, const double tol, const unsigned int maxit, const bool nonneg,
+                                   const std::vector<unsigned int>& samples, const unsigned int seed, const Eigen::MatrixXd& w_init,
+                                   const bool verbose = false, const bool calc_dist = false, const bool diag = true,
+                                   const double switch_tol = 0, const unsigned int subspace_iters = 0) {
+    Rcpp::SparseMatrix A_(A);
+    Eigen::MatrixXd w = bipartitionInit(w_init, A_.rows(), seed);
+    bipartitionModel m = c_bipartition_sparse(A_, w, samples, tol, nonneg, calc_dist, maxit, verbose, switch_tol, subspace_iters, seed);
+    return Rcpp::List::create(Rcpp::Named("v") = m.v, Rcpp::Named("dist") = m.dist, Rcpp::Named("size1") = m.size1,
+                              Rcpp::Named("size2") = m.size2, Rcpp::Named("samples1") = m.samples1, Rcpp::Named("samples2") = m.samples2,
+                              Rcpp::Named("center1") = m.center1.dense(A_.rows()), Rcpp::Named("center2") = m.center2.dense(A_.rows()),
+                              Rcpp::Named("w") = m.w.w,
+                              Rcpp::Named("iter") = m.iter);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_bipartition_dense(const Eigen::Map<Eigen::MatrixXd> A, const double tol, const unsigned int maxit, const bool nonneg,
+                                  const std::vector<unsigned int>& samples, const unsigned int seed, const Eigen::MatrixXd& w_init,
+                                  const bool verbose = false, const bool calc_dist = false, const bool diag = true,
+                                  const double switch_tol = 0, const unsigned int subspace_iters = 0) {
+    Eigen::MatrixXd w = bipartitionInit(w_init, A.rows(), seed);
+    bipartitionModel m = c_bipartition_dense(A, w, samples, tol, nonneg, calc_dist, maxit, verbose, switch_tol, subspace_iters, seed);
+    return Rcpp::List::create(Rcpp::Named("v") = m.v, Rcpp::Named("dist") = m.dist, Rcpp::Named("size1") = m.size1,
+                              Rcpp::Named("size2") = m.size2, Rcpp::Named("samples1") = m.samples1, Rcpp::Named("samples2") = m.samples2,
+                              Rcpp::Named("center1") = m.center1.dense(A.rows()), Rcpp::Named("center2") = m.center2.dense(A.rows()),
+                              Rcpp::Named("w") = m.w.w,
+                              Rcpp::Named("iter") = m.iter);
+}
+
+// DIVISIVE CLUSTERING BY RECURSIVE BIPARTITIONING
+
+// internal nodes of a "dclust" tree from the "tree" attribute of a "dclust" result
+inline std::vector<splitNode> dclustNodes(const Rcpp::List& tree) {
+    std::vector<splitNode> nodes(tree.size());
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        const Rcpp::List node = tree[i];
+        bipartitionRule& rule = nodes[i].rule;
+        nodes[i].id = Rcpp::as<std::string>(node["id"]);
+        rule.w = sparseW{Rcpp::as<std::vector<unsigned int>>(node["features"]), Rcpp::as<Eigen::MatrixXd>(node["w"])};
+        rule.a = gram(rule.w.w);
+        rule.h_scale = Rcpp::as<Eigen::VectorXd>(node["h_scale"]);
+        rule.first_factor = Rcpp::as<bool>(node["first_factor"]);
+        nodes[i].dist = node.containsElementNamed("dist") ? Rcpp::as<double>(node["dist"]) : 0;
+    }
+    return nodes;
+}
+
+// "T" is "Rcpp::SparseMatrix" or "Eigen::Map<Eigen::MatrixXd>"
+//  * if "previous" is a "dclust" result for the first columns of "A", the remaining columns are added to its clusters
+//      (see "clusterModel::dclust")
+//  * with "quality", the relative cosine distance of every bipartition is kept in the tree, and the quality of the
+//      leaves is returned in the attribute "quality" (see "dclustQuality")
+//  * with "switch_tol", each bipartition stops once its partition of samples is stable (see "c_bipartition_inplace")
+//  * with "subspace_iters" and without "nonneg", bipartitions are found by subspace iteration (see "subspaceBipartition")
+template <class T>
+Rcpp::List c_dclust(T& A, const unsigned int min_samples, const double min_dist, const bool verbose, const double tol,
+                    const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads,
+                    const bool warm_start, const Rcpp::List* previous = NULL, const bool quality = false,
+                    const double switch_tol = 0, const unsigned int subspace_iters = 0) {
+    RcppML::clusterModel<T> m(A, min_samples, min_dist);
+    m.nonneg = nonneg;
+    m.verbose = verbose;
+    m.tol = tol;
+    m.switch_tol = switch_tol;
+    m.min_dist = min_dist;
+    m.seed = seed;
+    m.maxit = maxit;
+    m.threads = threads;
+    m.min_samples = min_samples;
+    m.warm_start = warm_start;
+    m.keep_dist = quality;
+    m.subspace_iters = subspace_iters;
+
+    if (previous) {
+        std::vector<cluster> leaves(previous->size());
+        std::vector<std::vector<unsigned int>> leaf_samples(previous->size());
+        unsigned int n_old = 0;
+        for (unsigned int i = 0; i < leaves.size(); ++i) {
+            const Rcpp::List c = (*previous)[i];
+            leaf_samples[i] = Rcpp::as<std::vector<unsigned int>>(c["samples"]);
+            leaves[i] = cluster{Rcpp::as<std::string>(c["id"]), 0, 0, {}, Rcpp::as<double>(c["dist"]), true, false,
+                                Rcpp::as<unsigned int>(c["iter"]), nullptr};
+            n_old += leaf_samples[i].size();
+        }
+        const Rcpp::List tree = previous->attr("tree");
+        m.dclust(leaves, leaf_samples, dclustNodes(tree), n_old);
+    } else {
+        m.dclust();
+    }
+
+    const std::vector<cluster>& clusters = m.getClusters();
+
+    Rcpp::List result(clusters.size());
+    std::vector<std::vector<unsigned int>> samples(clusters.size());
+    Eigen::MatrixXd centers(A.rows(), clusters.size());
+    for (unsigned int i = 0; i < clusters.size(); ++i) {
+        samples[i] = m.getSamples(clusters[i]);
+        const std::vector<double> center = m.getCenter(clusters[i]);
+        centers.col(i) = Eigen::Map<const Eigen::VectorXd>(center.data(), center.size());
+        result[i] = Rcpp::List::create(Rcpp::Named("id") = clusters[i].id, Rcpp::Named("samples") = samples[i],
+                                       Rcpp::Named("center") = center, Rcpp::Named("dist") = clusters[i].dist,
+                                       Rcpp::Named("leaf") = clusters[i].leaf, Rcpp::Named("iter") = clusters[i].iter);
+    }
+
+    // bipartition rules of internal nodes, by which "predict" routes new samples to leaves
+    const std::vector<splitNode>& nodes = m.getNodes();
+    Rcpp::List tree(nodes.size());
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        const bipartitionRule& rule = nodes[i].rule;
+        tree[i] = Rcpp::List::create(Rcpp::Named("id") = nodes[i].id, Rcpp::Named("features") = rule.w.features,
+                                     Rcpp::Named("w") = rule.w.w, Rcpp::Named("h_scale") = rule.h_scale,
+                                     Rcpp::Named("first_factor") = rule.first_factor, Rcpp::Named("dist") = nodes[i].dist);
+    }
+    result.attr("tree") = tree;
+    if (quality) {
+        const clusterQuality q = dclustQuality(A, samples, centers, threads);
+        Rcpp::CharacterVector split_id(nodes.size());
+        Rcpp::NumericVector split_dist(nodes.size());
+        for (unsigned int i = 0; i < nodes.size(); ++i) {
+            split_id[i] = nodes[i].id;
+            split_dist[i] = nodes[i].dist;
+        }
+        result.attr("quality") = Rcpp::List::create(
+            Rcpp::Named("silhouette") = q.silhouette, Rcpp::Named("within") = q.within, Rcpp::Named("between") = q.between,
+            Rcpp::Named("splits") = Rcpp::DataFrame::create(Rcpp::Named("id") = split_id, Rcpp::Named("dist") = split_dist,
+                                                            Rcpp::Named("stringsAsFactors") = false));
+    }
+    result.attr("nonneg") = nonneg;
+    result.attr("class") = "dclust";
+    return result;
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_dclust_sparse(const Rcpp::S4& A, const unsigned int min_samples, const double min_dist, const bool verbose,
+                              const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads,
+                              const bool warm_start = false, const bool quality = false, const double switch_tol = 0,
+                              const unsigned int subspace_iters = 0) {
+    Rcpp::SparseMatrix A_(A);
+    return c_dclust(A_, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, NULL, quality, switch_tol,
+                    subspace_iters);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_dclust_dense(const Eigen::Map<Eigen::MatrixXd> A, const unsigned int min_samples, const double min_dist,
+                             const bool verbose, const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed,
+                             const unsigned int threads, const bool warm_start = false, const bool quality = false,
+                             const double switch_tol = 0, const unsigned int subspace_iters = 0) {
+    Eigen::Map<Eigen::MatrixXd> A_(A);
+    return c_dclust(A_, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, NULL, quality, switch_tol,
+                    subspace_iters);
+}
+
+// add columns of "A" after those clustered in "clusters", a "dclust" result, to its clusters
+//[[Rcpp::export]]
+Rcpp::List Rcpp_dclust_update_sparse(const Rcpp::S4& A, const Rcpp::List& clusters, const unsigned int min_samples, const double min_dist,
+                                     const bool verbose, const double tol, const unsigned int maxit, const bool nonneg,
+                                     const unsigned int seed, const unsigned int threads, const bool warm_start = false,
+                                     const bool quality = false, const double switch_tol = 0,
+                                    const unsigned int subspace_iters = 0) {
+    Rcpp::SparseMatrix A_(A);
+    return c_dclust(A_, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, &clusters, quality,
+                    switch_tol, subspace_iters);
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_dclust_update_dense(const Eigen::Map<Eigen::MatrixXd> A, const Rcpp::List& clusters, const unsigned int min_samples,
+                                    const double min_dist, const bool verbose, const double tol, const unsigned int maxit,
+                                    const bool nonneg, const unsigned int seed, const unsigned int threads, const bool warm_start = false,
+                                    const bool quality = false, const double switch_tol = 0,
+                                    const unsigned int subspace_iters = 0) {
+    Eigen::Map<Eigen::MatrixXd> A_(A);
+    return c_dclust(A_, min_samples, min_dist, verbose, tol, maxit, nonneg, seed, threads, warm_start, &clusters, quality,
+                    switch_tol, subspace_iters);
+}
+
+//[[Rcpp::export]]
+std::vector<std::string> Rcpp_dclust_predict_sparse(const Rcpp::List& tree, const Rcpp::S4& A, const bool nonneg, const unsigned int threads) {
+    Rcpp::SparseMatrix A_(A);
+    return dclustRoute(A_, dclustNodes(tree), nonneg, threads);
+}
+
+//[[Rcpp::export]]
+std::vector<std::string> Rcpp_dclust_predict_dense(const Rcpp::List& tree, const Eigen::Map<Eigen::MatrixXd> A, const bool nonneg,
+                                                   const unsigned int threads) {
+    const Eigen::Ref<const Eigen::MatrixXd> A_(A);
+    return dclustRoute(A_, dclustNodes(tree), nonneg, threads);
 }
+
+// write the internal nodes of a "dclust" tree to a tree file for serving outside of R (see "RcppML::routingTree")
 //[[Rcpp::export]]
-Eigen::MatrixXd Rcpp_predict_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w,
-                                   const double L1, const double L2, const unsigned int threads, const bool mask_zeros, const double upper_bound = 0) {
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Eigen::MatrixXd> m(A_, w);
-    if (mask_zeros)
-        m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
-        m.maskMatrix(mask_);
-    m.threads = threads;
-    m.L1[1] = L1;
-    m.L2[1] = L1;
-    m.upper_bound = upper_bound;
-    m.predictH();
-    return m.matrixH();
+void Rcpp_write_tree(const std::string path, const Rcpp::List& tree, const bool nonneg) {
+    const std::vector<splitNode> nodes = dclustNodes(tree);
+    std::vector<RcppML::routeNode> route(nodes.size());
+    for (unsigned int i = 0; i < nodes.size(); ++i) {
+        const bipartitionRule& rule = nodes[i].rule;
+        route[i] = RcppML::routeNode{nodes[i].id, std::vector<uint32_t>(rule.w.features.begin(), rule.w.features.end()), rule.w.w,
+                                     rule.a, rule.h_scale, rule.first_factor};
+    }
+    if (!RcppML::routingTree::write(path, route, nonneg)) Rcpp::stop("could not write '" + path + "'");
 }
 
-// MEAN SQUARED ERROR LOSS OF FACTORIZATION
+// leaves that the columns of "A" are routed to by a tree file, as the model server routes them
+//[[Rcpp::export]]
+std::vector<std::string> Rcpp_route_tree(const std::string path, const Rcpp::S4& A) {
+    Rcpp::SparseMatrix A_(A);
+    const RcppML::routingTree tree(path);
+    std::vector<std::string> leaves(A_.cols());
+    for (unsigned int j = 0; j < leaves.size(); ++j) leaves[j] = tree.route(A_, j);
+    return leaves;
+}
 
+// COLUMN-WISE DISTANCES AND SIMILARITIES
+
+// nearest neighbors with 1-based indices
+Rcpp::List wrapKnn(const knnResult& res) {
+    return Rcpp::List::create(Rcpp::Named("index") = Eigen::MatrixXi(res.index.array() + 1), Rcpp::Named("dist") = res.dist);
+}
+
+// all distances between columns of "A" and "B" if "k = 0", otherwise the "k" nearest columns in "B" to each column in "A"
 //[[Rcpp::export]]
-double Rcpp_mse_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
-                       const unsigned int threads, const bool mask_zeros) {
+SEXP Rcpp_distance_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const unsigned int threads, const bool symmetric,
+                          const unsigned int k = 0) {
+    Rcpp::SparseMatrix A_(A), B_(B);
+    if (k > 0) return wrapKnn(knn(A_, B_, method, k, threads, symmetric));
+    return Rcpp::wrap(distance(A_, B_, method, threads, symmetric));
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_distance_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const unsigned int threads,
+                                const unsigned int k = 0) {
     Rcpp::SparseMatrix A_(A);
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Rcpp::SparseMatrix> m(A_, w, d, h);
-    if (mask_zeros)
-        m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
-        m.maskMatrix(mask_);
-    m.threads = threads;
-    return m.mse();
+    if (k > 0) return wrapKnn(knn(A_, B, method, k, threads));
+    return Rcpp::wrap(distance(A_, B, method, threads));
 }
 
 //[[Rcpp::export]]
-double Rcpp_mse_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
-                      const unsigned int threads, const bool mask_zeros) {
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Eigen::MatrixXd> m(A_, w, d, h);
-    if (mask_zeros)
-        m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
-        m.maskMatrix(mask_);
-    m.threads = threads;
-    return m.mse();
+SEXP Rcpp_distance_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method,
+                         const unsigned int threads, const bool symmetric, const unsigned int k = 0) {
+    if (k > 0) return wrapKnn(knn(A, B, method, k, threads, symmetric));
+    return Rcpp::wrap(distance(A, B, method, threads, symmetric));
 }
 
+// write all distances between columns of "A" and "B" to "path" by blocks of "block_cols" columns of "B"
 //[[Rcpp::export]]
-double Rcpp_mse_missing_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
-                               const unsigned int threads) {
+void Rcpp_write_distance_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const std::string path,
+                                const unsigned int block_cols, const unsigned int threads) {
+    Rcpp::SparseMatrix A_(A), B_(B);
+    getDistanceMethod(method);  // before the file is truncated
+    distanceFileWriter write(path);
+    writeDistance(A_, B_, method, block_cols, threads, write);
+}
+
+//[[Rcpp::export]]
+void Rcpp_write_distance_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method, const std::string path,
+                                      const unsigned int block_cols, const unsigned int threads) {
     Rcpp::SparseMatrix A_(A);
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Rcpp::SparseMatrix> m(A_, w, d, h);
-    m.maskMatrix(mask_);
-    m.threads = threads;
-    return m.mse_masked();
+    getDistanceMethod(method);
+    distanceFileWriter write(path);
+    writeDistance(A_, B, method, block_cols, threads, write);
 }
 
 //[[Rcpp::export]]
-double Rcpp_mse_missing_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, Eigen::MatrixXd w, Eigen::VectorXd d, Eigen::MatrixXd h,
-                              const unsigned int threads) {
-    Rcpp::SparseMatrix mask_(mask);
-    RcppML::nmf<Eigen::MatrixXd> m(A_, w, d, h);
-    m.maskMatrix(mask_);
-    m.threads = threads;
-    return m.mse_masked();
+void Rcpp_write_distance_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method,
+                               const std::string path, const unsigned int block_cols, const unsigned int threads) {
+    getDistanceMethod(method);
+    distanceFileWriter write(path);
+    writeDistance(A, B, method, block_cols, threads, write);
 }
 
-// NON_NEGATIVE MATRIX FACTORIZATION
+// all distances between columns of "A" and "B" in single precision, computed by blocks of "block_cols" columns of "B",
+//   as the bytes of an R raw vector
+template <class MatrixA, class MatrixB>
+Rcpp::RawVector floatDistance(MatrixA& A, MatrixB& B, const std::string method, const unsigned int block_cols, const unsigned int threads) {
+    getDistanceMethod(method);
+    Rcpp::RawVector dists(Rcpp::no_init((R_xlen_t)A.cols() * B.cols() * sizeof(float)));
+    distanceBufferWriter write(reinterpret_cast<float*>(dists.begin()));
+    writeDistance(A, B, method, block_cols, threads, write);
+    return dists;
+}
 
 //[[Rcpp::export]]
-Rcpp::List Rcpp_nmf_sparse(const Rcpp::S4& A, const Rcpp::S4& mask, const double tol, const unsigned int maxit,
-                           const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
-                           const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h,
-                           const bool mask_zeros, const bool link_h, const bool sort_model, const double upper_bound = 0) {
+Rcpp::RawVector Rcpp_distance_float_sparse(const Rcpp::S4& A, const Rcpp::S4& B, const std::string method, const unsigned int block_cols,
+                                           const unsigned int threads) {
+    Rcpp::SparseMatrix A_(A), B_(B);
+    return floatDistance(A_, B_, method, block_cols, threads);
+}
+
+//[[Rcpp::export]]
+Rcpp::RawVector Rcpp_distance_float_sparse_dense(const Rcpp::S4& A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method,
+                                                 const unsigned int block_cols, const unsigned int threads) {
     Rcpp::SparseMatrix A_(A);
-    Rcpp::SparseMatrix mask_(mask), link_matrix_h_(link_matrix_h);
-    Eigen::MatrixXd w_ = Rcpp::as<Eigen::MatrixXd>(w_init[0]);
-    RcppML::nmf<Rcpp::SparseMatrix> m(A_, w_);
+    const Eigen::Ref<const Eigen::MatrixXd> B_(B);
+    return floatDistance(A_, B_, method, block_cols, threads);
+}
 
-    // set model parameters
-    m.tol = tol;
-    m.L1 = L1;
-    m.L2 = L2;
-    m.maxit = maxit;
-    m.verbose = verbose;
-    m.threads = threads;
-    m.sort_model = sort_model;
-    m.upper_bound = upper_bound;
-    if (link_h) m.linkH(link_matrix_h_);
-    if (mask_zeros)
-        m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
-        m.maskMatrix(mask_);
+//[[Rcpp::export]]
+Rcpp::RawVector Rcpp_distance_float_dense(const Eigen::Map<Eigen::MatrixXd> A, const Eigen::Map<Eigen::MatrixXd> B, const std::string method,
+                                          const unsigned int block_cols, const unsigned int threads) {
+    const Eigen::Ref<const Eigen::MatrixXd> A_(A), B_(B);
+    return floatDistance(A_, B_, method, block_cols, threads);
+}
 
-    if (w_init.length() == 1)
-        m.fit();
-    else
-        m.fit_restarts(w_init);
+// APPROXIMATE NEAREST NEIGHBORS
 
-    return Rcpp::List::create(Rcpp::Named("w") = m.matrixW().transpose(),
-                              Rcpp::Named("d") = m.vectorD(),
-                              Rcpp::Named("h") = m.matrixH(),
-                              Rcpp::Named("tol") = m.fit_tol(),
-                              Rcpp::Named("iter") = m.fit_iter(),
-                              Rcpp::Named("mse") = m.fit_mse(),
-                              Rcpp::Named("best_model") = m.best_model());
+//[[Rcpp::export]]
+Rcpp::List Rcpp_ann_build(const Eigen::Map<Eigen::MatrixXd> x, const unsigned int n_trees, const unsigned int leaf_size, const unsigned int seed,
+                          const unsigned int threads) {
+    const Eigen::MatrixXd x_(x);
+    RcppML::annForest f = RcppML::annBuild(x_, n_trees, leaf_size, seed, threads);
+    return Rcpp::List::create(Rcpp::Named("x") = x_, Rcpp::Named("sq_norms") = Eigen::VectorXd(x_.colwise().squaredNorm().transpose()),
+                              Rcpp::Named("planes") = f.planes, Rcpp::Named("children") = f.children, Rcpp::Named("roots") = f.roots,
+                              Rcpp::Named("leaf_start") = f.leaf_start, Rcpp::Named("items") = f.items);
 }
 
+// the index is read in place from the R list returned by "Rcpp_ann_build"
 //[[Rcpp::export]]
-Rcpp::List Rcpp_nmf_dense(Eigen::MatrixXd& A_, const Rcpp::S4& mask, const double tol, const unsigned int maxit,
-                          const bool verbose, const std::vector<double> L1, const std::vector<double> L2,
-                          const unsigned int threads, Rcpp::List w_init, const Rcpp::S4& link_matrix_h, const bool mask_zeros,
-                          const bool link_h, const bool sort_model, const double upper_bound = 0) {
-    Rcpp::SparseMatrix mask_(mask), link_matrix_h_(link_matrix_h);
-    Eigen::MatrixXd w_ = Rcpp::as<Eigen::MatrixXd>(w_init[0]);
-    RcppML::nmf<Eigen::MatrixXd> m(A_, w_);
+Rcpp::List Rcpp_ann_query(const Rcpp::List& index, const Eigen::Map<Eigen::MatrixXd> q, const unsigned int k, const unsigned int search_k,
+                          const unsigned int threads) {
+    const Eigen::Map<Eigen::MatrixXd> x = Rcpp::as<Eigen::Map<Eigen::MatrixXd>>(index["x"]);
+    const Eigen::Map<Eigen::MatrixXd> planes = Rcpp::as<Eigen::Map<Eigen::MatrixXd>>(index["planes"]);
+    const Eigen::Map<Eigen::VectorXd> sq_norms = Rcpp::as<Eigen::Map<Eigen::VectorXd>>(index["sq_norms"]);
+    const Eigen::Map<Eigen::MatrixXi> children = Rcpp::as<Eigen::Map<Eigen::MatrixXi>>(index["children"]);
+    const Eigen::Map<Eigen::VectorXi> roots = Rcpp::as<Eigen::Map<Eigen::VectorXi>>(index["roots"]);
+    const Eigen::Map<Eigen::VectorXi> leaf_start = Rcpp::as<Eigen::Map<Eigen::VectorXi>>(index["leaf_start"]);
+    const Eigen::Map<Eigen::VectorXi> items = Rcpp::as<Eigen::Map<Eigen::VectorXi>>(index["items"]);
+    if (q.rows() != x.rows()) Rcpp::stop("number of rows in 'data' and in the indexed samples are not equal");
+    return wrapKnn(RcppML::annQuery(x, sq_norms, planes, children, roots, leaf_start, items, Eigen::MatrixXd(q), k, search_k, threads));
+}
 
-    // set model parameters
-    m.tol = tol;
-    m.L1 = L1;
-    m.L2 = L2;
-    m.maxit = maxit;
-    m.verbose = verbose;
-    m.threads = threads;
-    m.sort_model = sort_model;
-    m.upper_bound = upper_bound;
-    if (link_h) m.linkH(link_matrix_h_);
-    if (mask_zeros)
-        m.maskZeros();
-    else if (mask_.rows() == A_.rows() && mask_.cols() == A_.cols())
-        m.maskMatrix(mask_);
+// ALIGNMENT OF FACTOR MODELS
 
-    if (w_init.length() == 1)
-        m.fit();
-    else
-        m.fit_restarts(w_init);
+// align factors in each of "w" to factors in "ref" by minimum-cost assignment on "1 - similarity" of factors, in
+//   parallel over models, and average aligned factors across models. Column "m" of "order" gives the factor in model
+//   "m" aligned to each factor in "ref".
+//[[Rcpp::export]]
+Rcpp::List Rcpp_align_models(const Rcpp::List& w, const Eigen::Map<Eigen::MatrixXd> ref, const std::string method, const unsigned int threads) {
+    getDistanceMethod(method);
+    const int n_models = w.size(), k = ref.cols();
+    std::vector<Eigen::Map<Eigen::MatrixXd>> models;
+    for (int m = 0; m < n_models; ++m) {
+        Rcpp::NumericMatrix w_m = w[m];
+        if (w_m.nrow() != ref.rows() || w_m.ncol() != k) Rcpp::stop("dimensions of model " + std::to_string(m + 1) + " and 'ref' are not identical");
+        models.push_back(Eigen::Map<Eigen::MatrixXd>(w_m.begin(), w_m.nrow(), w_m.ncol()));
+    }
 
-    return Rcpp::List::create(Rcpp::Named("w") = m.matrixW().transpose(),
-                              Rcpp::Named("d") = m.vectorD(),
-                              Rcpp::Named("h") = m.matrixH(),
-                              Rcpp::Named("tol") = m.fit_tol(),
-                              Rcpp::Named("iter") = m.fit_iter(),
-                              Rcpp::Named("mse") = m.fit_mse(),
-                              Rcpp::Named("best_model") = m.best_model());
+    const Eigen::MatrixXd ref_(ref);
+    Eigen::MatrixXi order(k, n_models);
+    Eigen::VectorXd costs(n_models);
+    bool feasible = true;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (int m = 0; m < n_models; ++m) {
+        // costs of all factors in the model for each factor in "ref" are contiguous
+        Eigen::MatrixXd cost = 1 - distance(Eigen::MatrixXd(models[m]), ref_, method, 1).array() + 1e-10;
+        cost = cost.cwiseMax(0);
+        const std::vector<int> assigned = RcppML::solveAssignment(cost.data(), k, k);
+        if (assigned.size() != (size_t)k) {
+            feasible = false;
+            continue;
+        }
+        costs(m) = 0;
+        for (int j = 0; j < k; ++j) {
+            order(j, m) = assigned[j];
+            costs(m) += cost(assigned[j], j);
+        }
+    }
+    if (!feasible) Rcpp::stop("factors could not be aligned, because similarities are not finite");
+
+    Eigen::MatrixXd consensus = Eigen::MatrixXd::Zero(ref.rows(), k);
+    for (int m = 0; m < n_models; ++m)
+        for (int j = 0; j < k; ++j) consensus.col(j) += models[m].col(order(j, m));
+    if (n_models > 0) consensus /= n_models;
+
+    return Rcpp::List::create(Rcpp::Named("w") = consensus, Rcpp::Named("order") = Eigen::MatrixXi(order.array() + 1),
+                              Rcpp::Named("cost") = costs);
 }
 
-// BIPARTITION A SAMPLE SET BY RANK-2 NMF
+// GROUPED SUMMARIES OF FACTOR MODELS
+
+// sums and non-zeros of each factor in groups of samples of "h" ("by_col") or features of "w", where "group" is the
+//   0-based group of each sample or feature, or negative for none (see "RcppML::summarizeGroups")
+Rcpp::List wrapSummary(const RcppML::groupSummary& s) {
+    return Rcpp::List::create(Rcpp::Named("sums") = s.sums, Rcpp::Named("nonzeros") = s.nonzeros, Rcpp::Named("sizes") = s.sizes);
+}
 
 //[[Rcpp::export]]
-Rcpp::List Rcpp_bipartition_sparse(const Rcpp::S4& A, const double tol, const unsigned int maxit, const bool nonneg,
-                                   const std::vector<unsigned int>& samples, const unsigned int seed, const bool verbose = false,
-                                   const bool calc_dist = false, const bool diag = true) {
-    Rcpp::SparseMatrix A_(A);
-    Eigen::MatrixXd w = randomMatrix(2, A_.rows(), seed);
-    bipartitionModel m = c_bipartition_sparse(A_, w, samples, tol, nonneg, calc_dist, maxit, verbose);
-    return Rcpp::List::create(Rcpp::Named("v") = m.v, Rcpp::Named("dist") = m.dist, Rcpp::Named("size1") = m.size1,
-                              Rcpp::Named("size2") = m.size2, Rcpp::Named("samples1") = m.samples1, Rcpp::Named("samples2") = m.samples2,
-                              Rcpp::Named("center1") = m.center1, Rcpp::Named("center2") = m.center2);
+Rcpp::List Rcpp_summarize_groups_dense(const Eigen::Map<Eigen::MatrixXd> x, const std::vector<int>& group, const unsigned int n_groups,
+                                       const bool by_col, const unsigned int threads) {
+    return wrapSummary(RcppML::summarizeGroups(x, group, n_groups, by_col, threads));
 }
 
 //[[Rcpp::export]]
-Rcpp::List Rcpp_bipartition_dense(const Eigen::MatrixXd& A, const double tol, const unsigned int maxit, const bool nonneg,
-                                  const std::vector<unsigned int>& samples, const unsigned int seed, const bool verbose = false,
-                                  const bool calc_dist = false, const bool diag = true) {
-    Eigen::MatrixXd w = randomMatrix(2, A.rows(), seed);
-    bipartitionModel m = c_bipartition_dense(A, w, samples, tol, nonneg, calc_dist, maxit, verbose);
-    return Rcpp::List::create(Rcpp::Named("v") = m.v, Rcpp::Named("dist") = m.dist, Rcpp::Named("size1") = m.size1,
-                              Rcpp::Named("size2") = m.size2, Rcpp::Named("samples1") = m.samples1, Rcpp::Named("samples2") = m.samples2,
-                              Rcpp::Named("center1") = m.center1, Rcpp::Named("center2") = m.center2);
+Rcpp::List Rcpp_summarize_groups_sparse(const Rcpp::S4& x, const std::vector<int>& group, const unsigned int n_groups,
+                                        const bool by_col, const unsigned int threads) {
+    Rcpp::SparseMatrix x_(x);
+    return wrapSummary(RcppML::summarizeGroups(x_, group, n_groups, by_col, threads));
 }
 
-// DIVISIVE CLUSTERING BY RECURSIVE BIPARTITIONING
+// RECONSTRUCTION OF FACTOR MODELS
 
+// "wdh" at the non-zeros of "pattern", where "wd" has factors in rows (see "RcppML::reconstructPattern")
 //[[Rcpp::export]]
-Rcpp::List Rcpp_dclust_sparse(const Rcpp::S4& A, const unsigned int min_samples, const double min_dist, const bool verbose,
-                              const double tol, const unsigned int maxit, const bool nonneg, const unsigned int seed, const unsigned int threads) {
+Rcpp::NumericVector Rcpp_reconstruct_pattern(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Rcpp::S4& pattern,
+                                             const unsigned int threads) {
+    Rcpp::SparseMatrix pattern_(pattern);
+    Rcpp::NumericVector x(pattern_.i.size());
+    RcppML::reconstructPattern(wd, h, pattern_, x.begin(), threads);
+    return x;
+}
+
+// residuals "A - wdh" at the non-zeros of "A", in the order of "A@x", and the norms of the residuals of each row and
+//   column (see "RcppML::reconstructResiduals")
+//[[Rcpp::export]]
+Rcpp::List Rcpp_reconstruct_residuals(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const Rcpp::S4& A, const unsigned int threads) {
     Rcpp::SparseMatrix A_(A);
+    Rcpp::NumericVector x(A_.i.size());
+    const RcppML::residualNorms norms = RcppML::reconstructResiduals(wd, h, A_, x.begin(), threads);
+    return Rcpp::List::create(Rcpp::Named("x") = x, Rcpp::Named("row_norms") = norms.rows, Rcpp::Named("col_norms") = norms.cols);
+}
 
-    RcppML::clusterModel m = RcppML::clusterModel(A_, min_samples, min_dist);
-    m.nonneg = nonneg;
-    m.verbose = verbose;
-    m.tol = tol;
-    m.min_dist = min_dist;
-    m.seed = seed;
-    m.maxit = maxit;
-    m.threads = threads;
-    m.min_samples = min_samples;
+// "wdh" at 0-based features "rows" and samples "cols"
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_reconstruct_subset(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows,
+                                        const std::vector<int>& cols, const unsigned int threads) {
+    return RcppML::reconstructSubset(wd, h, rows, cols, threads);
+}
 
-    m.dclust();
+// "wdh" at "rows" and "cols" passed to a path or R function "sink" in tiles of "tile_size" samples (see "factorSink")
+//[[Rcpp::export]]
+void Rcpp_reconstruct_sink(const Eigen::MatrixXd& wd, const Eigen::MatrixXd& h, const std::vector<int>& rows, const std::vector<int>& cols,
+                           const unsigned int tile_size, SEXP sink, const unsigned int threads) {
+    factorSink sink_(sink, rows.size(), false, 0, 0);
+    RcppML::reconstructTiles(wd, h, rows, cols, tile_size, threads, [&](const Eigen::MatrixXd& tile, const int start) {
+        sink_.write(tile, start, threads);
+        Rcpp::checkUserInterrupt();
+    });
+}
 
-    std::vector<cluster> clusters = m.getClusters();
+// MATRIX MARKET FILES
 
-    Rcpp::List result(clusters.size());
-    for (unsigned int i = 0; i < clusters.size(); ++i) {
-        result[i] = Rcpp::List::create(Rcpp::Named("id") = clusters[i].id, Rcpp::Named("samples") = clusters[i].samples,
-                                       Rcpp::Named("center") = clusters[i].center, Rcpp::Named("dist") = clusters[i].dist,
-                                       Rcpp::Named("leaf") = clusters[i].leaf);
+// the compressed sparse column arrays "i", "p" and "x" (empty for "pattern" files) and "Dim" of the coordinate Matrix
+//   Market file at "path", read in parallel (see "RcppML::matrixMarket")
+//[[Rcpp::export]]
+Rcpp::List Rcpp_read_mtx(const std::string& path, const unsigned int threads) {
+    RcppML::matrixMarket mm(path);
+    std::vector<int> p = mm.columnPointers(threads);
+    Rcpp::IntegerVector i(p[mm.cols]);
+    Rcpp::NumericVector x(mm.pattern ? 0 : p[mm.cols]);
+    const size_t nnz = mm.fill(p.data(), i.begin(), mm.pattern ? NULL : x.begin(), threads);
+    // summed duplicates leave unused space at the end of "i" and "x"
+    if (nnz < (size_t)i.size()) {
+        i = Rcpp::IntegerVector(i.begin(), i.begin() + nnz);
+        if (!mm.pattern) x = Rcpp::NumericVector(x.begin(), x.begin() + nnz);
     }
-    return result;
+    return Rcpp::List::create(Rcpp::Named("i") = i, Rcpp::Named("p") = Rcpp::IntegerVector(p.begin(), p.end()), Rcpp::Named("x") = x,
+                              Rcpp::Named("Dim") = Rcpp::IntegerVector::create(mm.rows, mm.cols), Rcpp::Named("pattern") = mm.pattern);
 }
 
-//' @title Non-negative least squares
-//'
-//' @description Solves the equation \code{a %*% x = b} for \code{x} subject to \eqn{x > 0}.
-//'
-//' @details
-//' This is a very fast implementation of sequential coordinate descent non-negative least squares (NNLS), suitable for very small or very large systems.
-//' The algorithm begins with a zero-filled initialization of \code{x}.
-//'
-//' Least squares by **sequential coordinate descent** is used to ensure the solution returned is exact. This algorithm was
-//' introduced by Franc et al. (2005), and our implementation is a vectorized and optimized rendition of that found in the NNLM R package by Xihui Lin (2020).
-//'
-//' @param a symmetric positive definite matrix giving coefficients of the linear system
-//' @param b matrix giving the right-hand side(s) of the linear system
-//' @param L1 L1/LASSO penalty to be subtracted from \code{b}
-//' @param L2 Ridge penalty by which to shrink the diagonal of \code{a}
-//' @param cd_maxit maximum number of coordinate descent iterations
-//' @param cd_tol stopping criteria, difference in \eqn{x} across consecutive solutions over the sum of \eqn{x}
-//' @param upper_bound maximum value permitted in solution, set to \code{0} to impose no upper bound
-//' @return vector or matrix giving solution for \code{x}
-//' @export
-//' @author Zach DeBruine
-//' @seealso \code{\link{nmf}}, \code{\link{project}}
-//' @md
-//'
-//' @references
-//'
-//' DeBruine, ZJ, Melcher, K, and Triche, TJ. (2021). "High-performance non-negative matrix factorization for large single-cell data." BioRXiv.
-//'
-//' Franc, VC, Hlavac, VC, and Navara, M. (2005). "Sequential Coordinate-Wise Algorithm for the Non-negative Least Squares Problem. Proc. Int'l Conf. Computer Analysis of Images and Patterns."
-//'
-//' Lin, X, and Boutros, PC (2020). "Optimization and expansion of non-negative matrix factorization." BMC Bioinformatics.
-//'
-//' Myre, JM, Frahm, E, Lilja DJ, and Saar, MO. (2017) "TNT-NN: A Fast Active Set Method for Solving Large Non-Negative Least Squares Problems". Proc. Computer Science.
-//'
-//' @examples
-//' \dontrun{
-//' # compare solution to base::solve for a random system
-//' X <- matrix(runif(100), 10, 10)
-//' a <- crossprod(X)
-//' b <- crossprod(X, runif(10))
-//' unconstrained_soln <- solve(a, b)
-//' nonneg_soln <- nnls(a, b)
-//' unconstrained_err <- mean((a %*% unconstrained_soln - b)^2)
-//' nonnegative_err <- mean((a %*% nonneg_soln - b)^2)
-//' unconstrained_err
-//' nonnegative_err
-//' all.equal(solve(a, b), nnls(a, b))
-//'
-//' # example adapted from multiway::fnnls example 1
-//' X <- matrix(1:100,50,2)
-//' y <- matrix(101:150,50,1)
-//' beta <- solve(crossprod(X)) %*% crossprod(X, y)
-//' beta
-//' beta <- nnls(crossprod(X), crossprod(X, y))
-//' beta
-//'
-//' # learn nmf model and do bvls projection
-//' data(hawaiibirds)
-//' w <- nmf(hawaiibirds$counts, 10)@w
-//' h <- project(w, hawaiibirds$counts)
-//' # now impose upper bound on solutions
-//' h2 <- project(w, hawaiibirds$counts, upper_bound = 2)
-//' }
-//[[Rcpp::export]]
-Eigen::MatrixXd nnls(Eigen::MatrixXd a, Eigen::MatrixXd b, unsigned int cd_maxit = 100,
-                     const double cd_tol = 1e-8, const double L1 = 0, const double L2 = 0, const double upper_bound = 0) {
-    if (a.rows() != a.cols()) Rcpp::stop("'a' is not symmetric");
-    if (a.rows() != b.rows()) Rcpp::stop("dimensions of 'b' and 'a' are not compatible!");
-    a.diagonal().array() *= (1 - L2);
-    b.array() -= L1;
-    Eigen::MatrixXd h(b.rows(), b.cols());
-    for (size_t sample = 0; sample < b.cols(); ++sample) {
-        double tol = 1;
-        for (unsigned int it = 0; it < cd_maxit && (tol / b.rows()) > cd_tol; ++it) {
-            tol = 0;
-            for (unsigned int i = 0; i < h.rows(); ++i) {
-                double diff = b(i, sample) / a(i, i);
-                if (-diff > h(i, sample)) {
-                    if (h(i, sample) != 0) {
-                        b.col(sample) -= a.col(i) * -h(i, sample);
-                        tol = 1;
-                        h(i, sample) = 0;
-                    }
-                } else if (diff != 0) {
-                    if (upper_bound > 0) {
-                        if (h(i, sample) + diff > upper_bound) {
-                            diff = upper_bound - h(i, sample);
-                            h(i, sample) = upper_bound;
-                        } else {
-                            h(i, sample) += diff;
-                        }
-                    } else {
-                        h(i, sample) += diff;
-                    }
-                    b.col(sample) -= a.col(i) * diff;
-                    tol += std::abs(diff / (h(i, sample) + TINY_NUM));
-                }
-            }
-        }
-    }
-    return h;
+// PRODUCTS OF SPARSE AND DENSE MATRICES
+
+// "crossprod(x, A)" of dense "x" given as "t(x)" and sparse "A" (see "RcppML::crossprodSparse")
+//[[Rcpp::export]]
+Eigen::MatrixXd Rcpp_crossprod_sparse(const Eigen::MatrixXd& x_t, const Rcpp::S4& A, const unsigned int threads) {
+    Rcpp::SparseMatrix A_ = Rcpp::isRowCompressed(A) ? Rcpp::SparseMatrix::transposedView(A).transpose(threads) : Rcpp::SparseMatrix(A);
+    return RcppML::crossprodSparse(x_t, A_, threads);
 }
 
+// "A %*% y" of sparse "A" and dense "y", over columns of "t(A)" (see "RcppML::prodSparse"), which is read in place from
+//   "A" compressed by rows, given in "prepared" (see "Rcpp_prepare_sparse") or taken from the session cache, and is
+//   otherwise computed once with "threads"
 //[[Rcpp::export]]
-Rcpp::NumericMatrix c_rmatrix(uint32_t nrow, uint32_t ncol, uint32_t rng) {
-    Rcpp::NumericMatrix m(nrow, ncol);
-    RcppML::rng<false> s(rng);
-    for (uint32_t i = 0; i < nrow; ++i)
-        for (uint32_t j = 0; j < ncol; ++j)
-            m(i, j) = s.runif<float>(i, j);
-    return m;
+Eigen::MatrixXd Rcpp_prod_sparse(const Rcpp::S4& A, const Eigen::MatrixXd& y, Rcpp::List prepared, const unsigned int threads) {
+    Rcpp::SparseMatrix t_A;
+    if (Rcpp::isRowCompressed(A)) {
+        t_A = Rcpp::SparseMatrix::transposedView(A);
+    } else if (prepared.length() == 3) {
+        t_A = Rcpp::SparseMatrix(Rcpp::as<Rcpp::S4>(Rcpp::as<bool>(prepared["symmetric"]) ? A : prepared["t_data"]));
+    } else {
+        const std::shared_ptr<RcppML::preparedSparse> cached = RcppML::sessionCache().get(A, threads);
+        if (cached)
+            t_A = Rcpp::SparseMatrix::sharedCopy(cached->symmetric ? cached->A : cached->t_A);
+        else
+            t_A = Rcpp::SparseMatrix(A).transpose(threads);
+    }
+    if (t_A.rows() != (unsigned int)y.rows()) Rcpp::stop("the number of rows of 'y' is not the number of columns of 'A'");
+    return RcppML::prodSparse(t_A, y, threads);
 }
 
+// CONSENSUS CLUSTERING
+
+// consensus of assignments of samples to factors of greatest weight in each of "h" (see "RcppML::consensus")
 //[[Rcpp::export]]
-Rcpp::NumericMatrix c_rtimatrix(uint32_t nrow, uint32_t ncol, uint32_t rng) {
-    Rcpp::NumericMatrix m(nrow, ncol);
-    RcppML::rng<true> s(rng);
+Rcpp::List Rcpp_consensus(const Rcpp::List& h, const unsigned int max_groups, const unsigned int seed, const unsigned int threads) {
+    if (h.size() == 0) Rcpp::stop("no models were given");
+    std::vector<Eigen::Map<Eigen::MatrixXd>> models;
+    for (int r = 0; r < h.size(); ++r) {
+        Rcpp::NumericMatrix h_r = h[r];
+        if (h_r.nrow() == 0) Rcpp::stop("model " + std::to_string(r + 1) + " has no factors");
+        if (r > 0 && h_r.ncol() != models[0].cols()) Rcpp::stop("all models must have the same number of samples");
+        models.push_back(Eigen::Map<Eigen::MatrixXd>(h_r.begin(), h_r.nrow(), h_r.ncol()));
+    }
+    if (max_groups < 2) Rcpp::stop("'max_groups' must be at least 2");
+    RcppML::consensusResult res = RcppML::consensus(models, max_groups, seed, threads);
+    return Rcpp::List::create(Rcpp::Named("labels") = Eigen::MatrixXi(res.labels.array() + 1), Rcpp::Named("item") = res.item,
+                              Rcpp::Named("dispersion") = res.dispersion, Rcpp::Named("cophenetic") = res.cophenetic,
+                              Rcpp::Named("n_groups") = res.n_groups, Rcpp::Named("sampled") = res.sampled);
+}
 
-    // symmetric part first
-    uint32_t n_sym = (nrow < ncol) ? nrow : ncol;
+// right-hand side of the system for column "i" of "b" in "nnls", for dense "b"
+template <class VectorB>
+inline void nnlsRhs(const Eigen::Map<Eigen::MatrixXd>& b, const int i, VectorB& b_i) {
+    b_i = b.col(i);
+}
+
+// right-hand side of the system for column "i" of "b" in "nnls", for sparse "b"
+template <class VectorB>
+inline void nnlsRhs(Rcpp::SparseMatrix& b, const int i, VectorB& b_i) {
+    b_i.setZero();
+    for (Rcpp::SparseMatrix::InnerIterator it(b, i); it; ++it) b_i(it.row()) = it.value();
+}
+
+// right-hand sides "b = w^TA" of "nnls" for sparse "A", formed one column at a time so that "b" is never stored
+struct crossprodRhs {
+    Eigen::MatrixXd w;  // transpose of "w", so that rows of "w" are contiguous
+    Rcpp::SparseMatrix& A;
+};
 
-    for (uint32_t i = 0; i < n_sym; ++i) {
-        for (uint32_t j = (i + 1); j < n_sym; ++j) {
-            float tmp = s.runif<float>(i, j);
-            m(i, j) = tmp;
-            m(j, i) = tmp;
+template <class VectorB>
+inline void nnlsRhs(crossprodRhs& b, const int i, VectorB& b_i) {
+    b_i.setZero();
+    for (Rcpp::SparseMatrix::InnerIterator it(b.A, i); it; ++it) b_i += it.value() * b.w.col(it.row());
+}
+
+// solve "ax = b" for each column of "b" by the same solvers as "predict", starting from "x = 0"
+template <typename Scalar, int K, class MatrixB>
+void c_nnls_cols(const Eigen::Matrix<Scalar, -1, -1>& a_, MatrixB& b, Eigen::Matrix<Scalar, -1, -1>& h,
+                 const unsigned int maxit, const double tol, const double L1, const double upper_bound, const int solver,
+                 const unsigned int threads) {
+    typedef Eigen::Matrix<Scalar, K, K> MatrixK;
+    typedef Eigen::Matrix<Scalar, K, 1> VectorK;
+
+    MatrixK a = a_;
+    const bool active = useActiveSet(solver, h.rows());
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+    {
+        active_set<Scalar, K> as_solver(h.rows());
+        VectorK b_i(h.rows());
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (unsigned int i = 0; i < h.cols(); ++i) {
+            nnlsRhs(b, i, b_i);
+            b_i.array() -= L1;
+            if (upper_bound > 0)
+                c_bnnls(a, b_i, h, i, upper_bound, maxit, tol);
+            else if (active)
+                as_solver.solve(a, b_i, h, i);
+            else
+                c_nnls(a, b_i, h, i, maxit, tol, solver);
         }
     }
+}
+
+// solve all columns of "b" in "nnls", where "b" has "n" columns
+template <class MatrixB>
+SEXP c_nnls_matrix(const Eigen::Map<Eigen::MatrixXd>& a, MatrixB& b, const unsigned int n, const unsigned int cd_maxit,
+            const double cd_tol, const double L1, const double L2, const double upper_bound, const std::string& solver,
+            const unsigned int threads, const bool sparse) {
+    typedef double Scalar;
+    Eigen::MatrixXd a_ = a;
+    a_.diagonal().array() *= (1 - L2);
+    Eigen::MatrixXd h = Eigen::MatrixXd::Zero(a.rows(), n);
+    RCPPML_DISPATCH_RANK(a.rows(), c_nnls_cols, a_, b, h, cd_maxit, cd_tol, L1, upper_bound, nnlsSolver(solver), threads);
+    return wrapFactor(h, sparse);
+}
+
+//[[Rcpp::export]]
+SEXP Rcpp_nnls(const Eigen::Map<Eigen::MatrixXd> a, const Eigen::Map<Eigen::MatrixXd> b, const unsigned int cd_maxit,
+               const double cd_tol, const double L1, const double L2, const double upper_bound, const std::string solver,
+               const unsigned int threads, const bool sparse = false) {
+    if (a.rows() != a.cols()) Rcpp::stop("'a' is not symmetric");
+    if (a.rows() != b.rows()) Rcpp::stop("dimensions of 'b' and 'a' are not compatible!");
+    return c_nnls_matrix(a, b, b.cols(), cd_maxit, cd_tol, L1, L2, upper_bound, solver, threads, sparse);
+}
+
+// "nnls" for sparse "b", or for "b = w^TA" given "w" and sparse "A" if "w" is not empty
+//[[Rcpp::export]]
+SEXP Rcpp_nnls_sparse(const Eigen::Map<Eigen::MatrixXd> a, const Rcpp::S4& b, const Eigen::Map<Eigen::MatrixXd> w,
+                      const unsigned int cd_maxit, const double cd_tol, const double L1, const double L2, const double upper_bound,
+                      const std::string solver, const unsigned int threads, const bool sparse = false) {
+    if (a.rows() != a.cols()) Rcpp::stop("'a' is not symmetric");
+    Rcpp::SparseMatrix b_(b);
+    if (w.size() == 0) {
+        if (a.rows() != b_.rows()) Rcpp::stop("dimensions of 'b' and 'a' are not compatible!");
+        return c_nnls_matrix(a, b_, b_.cols(), cd_maxit, cd_tol, L1, L2, upper_bound, solver, threads, sparse);
+    }
+    if (w.rows() != b_.rows()) Rcpp::stop("number of rows in 'w' and 'A' are not equal!");
+    if (a.rows() != w.cols()) Rcpp::stop("dimensions of 'w' and 'a' are not compatible!");
+    crossprodRhs rhs = {w.transpose(), b_};
+    return c_nnls_matrix(a, rhs, b_.cols(), cd_maxit, cd_tol, L1, L2, upper_bound, solver, threads, sparse);
+}
 
-    // populate the diagonal of the symmetric part
-    for (uint32_t i = 0; i < n_sym; ++i)
-        m(i, i) = s.runif<float>(i, i);
+// RANDOM MATRICES
+//
+// Values depend only on the seed and their position (see "RcppML::rng"), so columns (or blocks of values) are generated
+//   in parallel and results do not depend on the number of threads. Random matrices are filled by columns in batches
+//   (see "rng::runif"), with single-precision values as "r_matrix".
 
-    // asymmetric part (but still transpose-identical)
-    if (nrow > ncol)
-        for (uint32_t i = n_sym; i < nrow; ++i)
-            for (uint32_t j = 0; j < ncol; ++j)
-                m(i, j) = s.runif<float>(i, j);
-    else if (ncol > nrow)
-        for (uint32_t i = 0; i < nrow; ++i)
-            for (uint32_t j = n_sym; j < ncol; ++j)
-                m(i, j) = s.runif<float>(i, j);
+//[[Rcpp::export]]
+Rcpp::NumericMatrix c_rmatrix(uint32_t nrow, uint32_t ncol, uint32_t rng, const unsigned int threads = 0) {
+    Rcpp::NumericMatrix m(Rcpp::no_init(nrow, ncol));
+    double* data = m.begin();
+    RcppML::rng<false> s(rng);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(static)
+#endif
+    for (uint32_t j = 0; j < ncol; ++j) s.runif<float>(data + (size_t)j * nrow, 0, nrow, j);
+    return m;
+}
 
+//[[Rcpp::export]]
+Rcpp::NumericMatrix c_rtimatrix(uint32_t nrow, uint32_t ncol, uint32_t rng, const unsigned int threads = 0) {
+    Rcpp::NumericMatrix m(Rcpp::no_init(nrow, ncol));
+    double* data = m.begin();
+    RcppML::rng<true> s(rng);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(static)
+#endif
+    for (uint32_t j = 0; j < ncol; ++j) s.runif<float>(data + (size_t)j * nrow, 0, nrow, j);
     return m;
 }
 
 //[[Rcpp::export]]
-Rcpp::NumericVector c_runif(const uint32_t n, const float min, const float max, const uint32_t rng, const uint32_t rng2) {
-    Rcpp::NumericVector result(n);
+Rcpp::NumericVector c_runif(const uint32_t n, const float min, const float max, const uint32_t rng, const uint32_t rng2,
+                            const unsigned int threads = 0) {
+    Rcpp::NumericVector result(Rcpp::no_init(n));
+    double* data = result.begin();
     RcppML::rng<false> s(rng);
-    float scale = max - min;
-    for (uint32_t i = 0; i < n; ++i) {
-        result[i] = s.runif<float>(i, rng2) * scale + min;
+    const float scale = max - min;
+    const uint32_t n_blocks = (n + RANDOM_BLOCK_SIZE - 1) / RANDOM_BLOCK_SIZE;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(static)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const uint32_t block_start = block * RANDOM_BLOCK_SIZE, block_n = std::min((uint32_t)RANDOM_BLOCK_SIZE, n - block_start);
+        float values[RANDOM_BLOCK_SIZE];
+        s.runif<float>(values, block_start, block_n, rng2);
+        for (uint32_t i = 0; i < block_n; ++i) data[block_start + i] = values[i] * scale + min;
     }
     return result;
 }
 
 //[[Rcpp::export]]
-Rcpp::IntegerVector c_rbinom(const uint32_t n, uint32_t size, const uint32_t inv_probability, const uint32_t rng, const uint32_t rng2) {
+Rcpp::IntegerVector c_rbinom(const uint32_t n, uint32_t size, const uint32_t inv_probability, const uint32_t rng, const uint32_t rng2,
+                             const unsigned int threads = 0) {
     Rcpp::IntegerVector result(n);
+    int* data = result.begin();
     RcppML::rng<false> s(rng);
-    for (; size > 0; --size) {
-        for (uint32_t i = 0; i < n; ++i) {
-            if (s.sample(i, rng2, inv_probability) == 0)
-                ++result[i];
-        }
-    }
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(static)
+#endif
+    for (uint32_t i = 0; i < n; ++i)
+        data[i] = RcppML::binomialSample(s, i, rng2, size, 1.0 / inv_probability);
     return result;
 }
 
@@ -418,87 +2939,224 @@ std::vector<uint32_t> c_sample(const uint32_t n, const uint32_t size, const bool
     } else {
         if (size > n)
             Rcpp::stop("cannot take a sample larger than the population when 'replace = FALSE'");
-        std::vector<uint32_t> result(n);
-        std::iota(result.begin(), result.end(), 0);
-        for (uint32_t i = 0; i < size; ++i) {
-            std::swap(result[i], result[s.sample(i, rng2, n)]);
-        }
-        if (size < n)
-            result.resize(size);
-        return result;
+        return RcppML::sampleWithoutReplacement(s, rng2, n, size);
     }
 }
 
-//[[Rcpp::export]]
-Rcpp::S4 c_rtisparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng) {
-    RcppML::rng<true> s(rng);
-    Rcpp::S4 result = pattern_only ? Rcpp::S4(std::string("ngCMatrix")) : Rcpp::S4(std::string("dgCMatrix"));
-    Rcpp::IntegerVector p(ncol + 1);
-    std::vector<uint32_t> i;
-    i.reserve(nrow * ncol / inv_probability);
-    if (pattern_only) {
-        for (uint32_t col = 0; col < ncol; ++col) {
-            for (uint32_t row = 0; row < nrow; ++row) {
-                if (s.sample(row, col, inv_probability) == 0)
-                    i.push_back(row);
-            }
-            p[col + 1] = i.size();
-        }
-    } else {
-        std::vector<float> x;
-        x.reserve(nrow * ncol / inv_probability);
-        for (uint32_t col = 0; col < ncol; ++col) {
-            for (uint32_t row = 0; row < nrow; ++row) {
-                if (s.sample(row, col, inv_probability) == 0) {
-                    i.push_back(row);
-                    x.push_back(s.runif<float>(row, col));
-                }
-            }
-            p[col + 1] = i.size();
+// random sparse matrix of "nrow x ncol" given "col_rows(col, rows)", which appends rows of the non-zeros in "col" to
+//   "rows" in increasing order, with values "s.runif(row, col)" unless "pattern_only"
+//  * blocks of "RANDOM_BLOCK_SIZE" columns are generated in parallel, each into its own buffer, which counts the
+//      non-zeros in each column. Buffers are then copied in parallel to their offsets in "i", and values are filled.
+template <class Rng, class ColRows>
+Rcpp::S4 blockedSparseMatrix(const uint32_t nrow, const uint32_t ncol, const bool pattern_only, const Rng& s, ColRows col_rows,
+                             const unsigned int threads) {
+    const uint32_t n_blocks = (ncol + RANDOM_BLOCK_SIZE - 1) / RANDOM_BLOCK_SIZE;
+    std::vector<std::vector<uint32_t>> block_rows(n_blocks);
+    std::vector<size_t> col_nnz(ncol + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const uint32_t block_end = std::min(ncol, (block + 1) * RANDOM_BLOCK_SIZE);
+        for (uint32_t col = block * RANDOM_BLOCK_SIZE; col < block_end; ++col) {
+            const size_t col_start = block_rows[block].size();
+            col_rows(col, block_rows[block]);
+            col_nnz[col + 1] = block_rows[block].size() - col_start;
         }
-        Rcpp::NumericVector x_ = Rcpp::wrap(x);
-        result.slot("x") = x_;
     }
-    Rcpp::IntegerVector i_ = Rcpp::wrap(i);
+    for (uint32_t col = 0; col < ncol; ++col) col_nnz[col + 1] += col_nnz[col];
+    if (col_nnz[ncol] > (size_t)std::numeric_limits<int>::max()) Rcpp::stop("too many non-zeros for a 'dgCMatrix', generate the matrix in blocks of columns");
+
+    Rcpp::IntegerVector i(col_nnz[ncol]), p(ncol + 1);
+    Rcpp::NumericVector x(pattern_only ? 0 : col_nnz[ncol]);
+    int* i_data = i.begin();
+    double* x_data = x.begin();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const uint32_t block_start = block * RANDOM_BLOCK_SIZE, block_end = std::min(ncol, block_start + RANDOM_BLOCK_SIZE);
+        std::copy(block_rows[block].begin(), block_rows[block].end(), i_data + col_nnz[block_start]);
+        std::vector<uint32_t>().swap(block_rows[block]);
+        if (!pattern_only)
+            for (uint32_t col = block_start; col < block_end; ++col)
+                for (size_t it = col_nnz[col]; it < col_nnz[col + 1]; ++it) x_data[it] = s.template runif<float>(i_data[it], col);
+    }
+    for (uint32_t col = 0; col <= ncol; ++col) p[col] = col_nnz[col];
+    Rcpp::S4 result = pattern_only ? Rcpp::S4(std::string("ngCMatrix")) : Rcpp::S4(std::string("dgCMatrix"));
+    if (!pattern_only) result.slot("x") = x;
     result.slot("Dim") = Rcpp::IntegerVector::create(nrow, ncol);
-    result.slot("i") = i_;
+    result.slot("i") = i;
     result.slot("p") = p;
     return result;
 }
 
-//[[Rcpp::export]]
-Rcpp::S4 c_rsparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng) {
-    RcppML::rng<false> s(rng);
-    Rcpp::S4 result = pattern_only ? Rcpp::S4(std::string("ngCMatrix")) : Rcpp::S4(std::string("dgCMatrix"));
-    Rcpp::IntegerVector p(ncol + 1);
-    std::vector<uint32_t> i;
-    i.reserve(nrow * ncol / inv_probability);
-    if (pattern_only) {
-        for (uint32_t col = 0; col < ncol; ++col) {
-            for (uint32_t row = 0; row < nrow; ++row) {
-                if (s.sample(row, col, inv_probability) == 0)
-                    i.push_back(row);
-            }
-            p[col + 1] = i.size();
+// random sparse matrices in which each value is non-zero with probability "1 / inv_probability"
+//  * by default, each value is tested by a hash of its row and column
+//  * with "skip", the non-zeros of each column are found by skipping geometric gaps between them (see
+//      "RcppML::skipSample"), in time proportional to the number of non-zeros rather than of values. Gaps are drawn
+//      from a separate generator, and values of non-zeros are those of the default method.
+//  * for transpose-identical matrices with "skip", whether the values at "(a, b)" and "(b, a)" are non-zero is decided
+//      at position "max(a, b)" of the stream of "min(a, b)", so the stream of each column gives its non-zeros on or below
+//      the diagonal, and non-zeros of later columns in its row above the diagonal. Streams are drawn in parallel by
+//      blocks, then scattered to columns in order of streams, and values are filled in parallel by columns.
+Rcpp::S4 rtiSkipSparseMatrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng,
+                             const unsigned int threads) {
+    RcppML::rng<true> s(rng);
+    RcppML::rng<false> gaps(~rng);
+    const uint32_t n = std::max(nrow, ncol);
+    const uint32_t n_blocks = (n + RANDOM_BLOCK_SIZE - 1) / RANDOM_BLOCK_SIZE;
+    std::vector<std::vector<uint32_t>> block_positions(n_blocks);
+    std::vector<size_t> stream_start(n + 1, 0);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        const uint32_t block_end = std::min(n, (block + 1) * RANDOM_BLOCK_SIZE);
+        for (uint32_t b = block * RANDOM_BLOCK_SIZE; b < block_end; ++b) {
+            const uint64_t end = std::max(b < ncol ? nrow : 0, b < nrow ? ncol : 0);
+            const size_t b_start = block_positions[block].size();
+            RcppML::skipSample(gaps, b, b, end, inv_probability, block_positions[block]);
+            stream_start[b + 1] = block_positions[block].size() - b_start;
         }
-    } else {
-        std::vector<float> x;
-        x.reserve(nrow * ncol / inv_probability);
-        for (uint32_t col = 0; col < ncol; ++col) {
-            for (uint32_t row = 0; row < nrow; ++row) {
-                if (s.sample(row, col, inv_probability) == 0) {
-                    i.push_back(row);
-                    x.push_back(s.runif<float>(row, col));
-                }
-            }
-            p[col + 1] = i.size();
+    }
+    for (uint32_t b = 0; b < n; ++b) stream_start[b + 1] += stream_start[b];
+    std::vector<uint32_t> positions(stream_start[n]);
+    for (uint32_t block = 0; block < n_blocks; ++block) {
+        std::copy(block_positions[block].begin(), block_positions[block].end(), positions.begin() + stream_start[block * RANDOM_BLOCK_SIZE]);
+        std::vector<uint32_t>().swap(block_positions[block]);
+    }
+
+    std::vector<size_t> col_nnz(ncol + 1, 0);
+    for (uint32_t b = 0; b < n; ++b) {
+        for (size_t it = stream_start[b]; it < stream_start[b + 1]; ++it) {
+            const uint32_t a = positions[it];
+            if (b < ncol && a < nrow) ++col_nnz[b + 1];
+            if (a > b && b < nrow && a < ncol) ++col_nnz[a + 1];
+        }
+    }
+    for (uint32_t col = 0; col < ncol; ++col) col_nnz[col + 1] += col_nnz[col];
+    if (col_nnz[ncol] > (size_t)std::numeric_limits<int>::max()) Rcpp::stop("too many non-zeros for a 'dgCMatrix', generate the matrix in blocks of columns");
+
+    // streams are visited in order, so the non-zeros above the diagonal of each column are placed before its own stream
+    Rcpp::IntegerVector i(col_nnz[ncol]), p(ncol + 1);
+    int* i_data = i.begin();
+    std::vector<size_t> next(col_nnz.begin(), col_nnz.end() - 1);
+    for (uint32_t b = 0; b < n; ++b) {
+        for (size_t it = stream_start[b]; it < stream_start[b + 1]; ++it) {
+            const uint32_t a = positions[it];
+            if (b < ncol && a < nrow) i_data[next[b]++] = a;
+            if (a > b && b < nrow && a < ncol) i_data[next[a]++] = b;
         }
-        Rcpp::NumericVector x_ = Rcpp::wrap(x);
-        result.slot("x") = x_;
     }
-    Rcpp::IntegerVector i_ = Rcpp::wrap(i);
+    Rcpp::NumericVector x(pattern_only ? 0 : col_nnz[ncol]);
+    if (!pattern_only) {
+        double* x_data = x.begin();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads == 0 ? omp_get_max_threads() : threads) schedule(dynamic)
+#endif
+        for (uint32_t col = 0; col < ncol; ++col)
+            for (size_t it = col_nnz[col]; it < col_nnz[col + 1]; ++it) x_data[it] = s.runif<float>(i_data[it], col);
+    }
+    for (uint32_t col = 0; col <= ncol; ++col) p[col] = col_nnz[col];
+    Rcpp::S4 result = pattern_only ? Rcpp::S4(std::string("ngCMatrix")) : Rcpp::S4(std::string("dgCMatrix"));
+    if (!pattern_only) result.slot("x") = x;
     result.slot("Dim") = Rcpp::IntegerVector::create(nrow, ncol);
-    result.slot("i") = i_;
+    result.slot("i") = i;
     result.slot("p") = p;
     return result;
-}
\ No newline at end of file
+}
+
+//[[Rcpp::export]]
+Rcpp::S4 c_rtisparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng,
+                           const bool skip = false, const unsigned int threads = 0) {
+    if (skip) return rtiSkipSparseMatrix(nrow, ncol, inv_probability, pattern_only, rng, threads);
+    RcppML::rng<true> s(rng);
+    return blockedSparseMatrix(nrow, ncol, pattern_only, s, [&](const uint32_t col, std::vector<uint32_t>& rows) {
+        for (uint32_t row = 0; row < nrow; ++row)
+            if (s.sample(row, col, inv_probability) == 0) rows.push_back(row);
+    }, threads);
+}
+
+//[[Rcpp::export]]
+Rcpp::S4 c_rsparsematrix(const uint32_t nrow, const uint32_t ncol, const uint32_t inv_probability, const bool pattern_only, uint32_t rng,
+                         const bool skip = false, const unsigned int threads = 0) {
+    RcppML::rng<false> s(rng), gaps(~rng);
+    if (skip)
+        return blockedSparseMatrix(nrow, ncol, pattern_only, s, [&](const uint32_t col, std::vector<uint32_t>& rows) {
+            RcppML::skipSample(gaps, col, 0, nrow, inv_probability, rows);
+        }, threads);
+    return blockedSparseMatrix(nrow, ncol, pattern_only, s, [&](const uint32_t col, std::vector<uint32_t>& rows) {
+        for (uint32_t row = 0; row < nrow; ++row)
+            if (s.sample(row, col, inv_probability) == 0) rows.push_back(row);
+    }, threads);
+}
+
+// SIMULATED NMF DATA
+
+// "m" as a dgCMatrix
+inline Rcpp::S4 wrapCSC(const RcppML::cscMatrix& m) {
+    if (m.p.back() > (size_t)std::numeric_limits<int>::max()) Rcpp::stop("too many non-zeros for a 'dgCMatrix', simulate fewer columns");
+    Rcpp::S4 result(std::string("dgCMatrix"));
+    result.slot("Dim") = Rcpp::IntegerVector::create(m.nrow, m.ncol);
+    result.slot("p") = Rcpp::IntegerVector(m.p.begin(), m.p.end());
+    result.slot("i") = Rcpp::IntegerVector(m.i.begin(), m.i.end());
+    result.slot("x") = Rcpp::NumericVector(m.x.begin(), m.x.end());
+    return result;
+}
+
+//[[Rcpp::export]]
+Rcpp::List Rcpp_simulate_nmf(const uint32_t nrow, const uint32_t ncol, const uint32_t k, const double noise, const double dropout,
+                             const uint32_t seed, const unsigned int threads) {
+    RcppML::cscMatrix A, w, h;
+    RcppML::simulateNMF(nrow, ncol, k, noise, dropout, seed, A, w, h, threads);
+    return Rcpp::List::create(Rcpp::Named("A") = wrapCSC(A), Rcpp::Named("w") = wrapCSC(w), Rcpp::Named("h") = wrapCSC(h));
+}
+
+// HOT-PATH COUNTERS
+
+// work done by least squares solvers and right-hand side gathers since the last reset (see "RcppML::hotCounters"), or an
+//   empty vector if counters were not compiled (see RCPPML_COUNTERS)
+//[[Rcpp::export]]
+Rcpp::NumericVector Rcpp_solver_counters(const bool reset = false) {
+    if (!RCPPML_COUNTERS) return Rcpp::NumericVector(0);
+    RcppML::mergeCounters();
+    Rcpp::NumericVector result(RcppML::N_COUNTERS);
+    for (int c = 0; c < RcppML::N_COUNTERS; ++c)
+        result[c] = (double)(reset ? RcppML::hotTotals()[c].exchange(0) : RcppML::hotTotals()[c].load());
+    result.names() = Rcpp::CharacterVector::create("columns", "updates", "support", "flops", "gathered");
+    return result;
+}
+
+// THREADS FOR EACH KERNEL CALL
+
+// measure the costs that choose threads for each update and loss when "threads = 0" with up to "threads" threads (see
+//   "RcppML::calibrateThreads"), or set them where "min_work", "bandwidth_threads", "numa", "reproducible" or
+//   "huge_pages" are not negative, and return them with the number of NUMA nodes found
+//[[Rcpp::export]]
+Rcpp::NumericVector Rcpp_thread_costs(const bool measure, const double min_work, const int bandwidth_threads, const int numa,
+                                      const int reproducible, const unsigned int threads, const int huge_pages) {
+    RcppML::threadModel& model = RcppML::threadCosts();
+    if (measure) {
+        const bool placed = model.numa, ordered = model.reproducible, huge = model.huge_pages;
+        model = RcppML::calibrateThreads(threads);
+        model.numa = placed;
+        model.reproducible = ordered;
+        model.huge_pages = huge;
+    }
+    if (min_work >= 0) model.min_work = std::max(min_work, 1.0);
+    if (bandwidth_threads >= 0) model.bandwidth_threads = bandwidth_threads;
+    if (numa >= 0) model.numa = numa > 0;
+    if (reproducible >= 0) RcppML::setReproducible(reproducible > 0);
+    if (huge_pages >= 0) model.huge_pages = huge_pages > 0;
+    Rcpp::NumericVector result = Rcpp::NumericVector::create(model.min_work, model.bandwidth_threads, model.numa, model.reproducible,
+                                                             (double)RcppML::numaNodes().size(), (double)RcppML::simdWidth(), model.huge_pages);
+    result.names() = Rcpp::CharacterVector::create("min_work", "bandwidth_threads", "numa", "reproducible", "numa_nodes", "simd_bits", "huge_pages");
+    return result;
+}
+
+// threads that a call of "flops" over "bytes" of input uses when "threads = 0" (see "RcppML::kernelThreads")
+//[[Rcpp::export]]
+unsigned int Rcpp_kernel_threads(const double flops, const double bytes) {
+    return RcppML::kernelThreads(0, flops, bytes);
+}
@@ -1,5 +1,6 @@
 #include <Rcpp.h>
 #include <RcppHungarian.h>
+#include <RcppML/assignment.hpp>
 
 // [[Rcpp::export]]
 Rcpp::List Rcpp_bipartite_match(Rcpp::NumericMatrix x) {
@@ -21,4 +22,34 @@ Rcpp::List Rcpp_bipartite_match(Rcpp::NumericMatrix x) {
     Rcpp::Named("cost") = cost,
     Rcpp::Named("pairs") = pairs
   ));
-}
\ No newline at end of file
+}
+
+// [[Rcpp::export]]
+Rcpp::List Rcpp_bipartite_match_jv(Rcpp::NumericMatrix x) {
+  const int n_rows = x.nrow(), n_cols = x.ncol();
+  std::vector<int> pairs(n_rows, 0);
+  if (n_rows >= n_cols) {
+    // assign each column of "x" to a row, reading columns of "x" in place as rows of the transposed problem
+    std::vector<int> row4col = RcppML::solveAssignment(x.begin(), n_cols, n_rows);
+    if (row4col.size() != (size_t)n_cols) Rcpp::stop("no assignment of finite cost exists");
+    for (int j = 0; j < n_cols; ++j) pairs[row4col[j]] = j + 1;
+  } else {
+    // assign each row of "x" to a column, from a copy of "x" in which rows are contiguous
+    std::vector<double> x_rows((size_t)n_rows * n_cols);
+    for (int j = 0; j < n_cols; ++j)
+      for (int i = 0; i < n_rows; ++i)
+        x_rows[(size_t)i * n_cols + j] = x(i, j);
+    std::vector<int> col4row = RcppML::solveAssignment(x_rows.data(), n_rows, n_cols);
+    if (col4row.size() != (size_t)n_rows) Rcpp::stop("no assignment of finite cost exists");
+    for (int i = 0; i < n_rows; ++i) pairs[i] = col4row[i] + 1;
+  }
+
+  double cost = 0;
+  for (int i = 0; i < n_rows; ++i)
+    if (pairs[i] > 0) cost += x(i, pairs[i] - 1);
+
+  return(Rcpp::List::create(
+    Rcpp::Named("cost") = cost,
+    Rcpp::Named("pairs") = pairs
+  ));
+}